@@ -45,134 +45,57 @@
 #define DEG_TO_RAD      .0174532925199432958
 #include <string>
 
-int AspectImage::getline ( float* buffer, int line ) {
-    if ( !aspect ) {
-        generate();
-    }
-    return _getline ( buffer, line );
-}
-
-int AspectImage::getline ( uint16_t* buffer, int line ) {
-    if ( !aspect ) {
-        generate();
-    }
-    return _getline ( buffer, line );
-}
-
-int AspectImage::getline ( uint8_t* buffer, int line ) {
-    if ( !aspect ) {
-        generate();
-    }
-    return _getline ( buffer, line );
-}
-
 //definition des variables
 AspectImage::AspectImage (int width, int height, int channels, BoundingBox<double> bbox, Image* image,  float resolution, std::string algo, float minSlope) :
-    Image ( width, height, channels, bbox ),
-    origImage ( image ), aspect ( NULL ), resolution (resolution), algo (algo), minSlope (minSlope)
-    {
-
-    matrix[0] = 1 / (8.0*resolution) ;
-    matrix[1] = 2 / (8.0*resolution) ;
-    matrix[2] = 1 / (8.0*resolution) ;
-
-    matrix[3] = 2 / (8.0*resolution) ;
-    matrix[4] = 0 ;
-    matrix[5] = 2 / (8.0*resolution) ;
-
-    matrix[6] = 1 / (8.0*resolution) ;
-    matrix[7] = 2 / (8.0*resolution) ;
-    matrix[8] = 1 / (8.0*resolution) ;
-
-
-}
-
-AspectImage::~AspectImage() {
-    delete origImage;
-    if ( aspect ) delete[] aspect;
-}
-
-
-int AspectImage::_getline ( float* buffer, int line ) {
-    convert ( buffer, aspect + line * width, width );
-    return width;
-}
-
-int AspectImage::_getline ( uint16_t* buffer, int line ) {
-    convert ( buffer, aspect + line * width, width );
-    return width;
-}
+    TerrainImage ( width, height, channels, bbox, image ),
+    resolution (resolution), algo (algo), minSlope (minSlope)
+    {}
 
-int AspectImage::_getline ( uint8_t* buffer, int line ) {
-    memcpy ( buffer, aspect + line * width, width );
-    return width;
-}
-
-
-int AspectImage::getOrigLine ( uint8_t* buffer, int line ) {
-    return origImage->getline ( buffer,line );
-}
 
-int AspectImage::getOrigLine ( uint16_t* buffer, int line ) {
-    return origImage->getline ( buffer,line );
-}
+void AspectImage::computeLine() {
 
-int AspectImage::getOrigLine ( float* buffer, int line ) {
-    return origImage->getline ( buffer,line );
-}
-
-
-void AspectImage::generate() {
-    aspect = new float[width * height];
-    bufferTmp = new float[origImage->getWidth() * 3];
-    float* lineBuffer[3];
-    lineBuffer[0]= bufferTmp;
-    lineBuffer[1]= lineBuffer[0]+origImage->getWidth();
-    lineBuffer[2]= lineBuffer[1]+origImage->getWidth();
-
-    int line = 0;
-    int nextBuffer = 0;
-    int lineOrig = 0;
-    getOrigLine ( lineBuffer[0], lineOrig++ );
-    getOrigLine ( lineBuffer[1], lineOrig++ );
-    getOrigLine ( lineBuffer[2], lineOrig++ );
-    generateLine ( line++, lineBuffer[0],lineBuffer[1],lineBuffer[2] );
-
-    while ( line < height ) {
-        getOrigLine ( lineBuffer[nextBuffer], lineOrig++ );
-        generateLine ( line++, lineBuffer[ ( nextBuffer+1 ) %3],lineBuffer[ ( nextBuffer+2 ) %3],lineBuffer[nextBuffer] );
-        nextBuffer = ( nextBuffer+1 ) %3;
-    }
-    delete[] bufferTmp;
-}
+    hornGradient ( 8.0 * resolution, 8.0 * resolution );
 
-void AspectImage::generateLine ( int line, float* line1, float* line2, float* line3) {
-    float* currentLine =aspect + line * width;
-    //on commence a la premiere colonne
-    int columnOrig = 1;
+    //l'exposition est l'angle du vecteur (dzdx, -dzdy), ramené dans [0, 360]
     int column = 0;
-    //creation de la variable sur laquelle on travaille pour trouver le seuil
-    double value,value1,value2,slope;
-
-    //calcul de la variable sur toutes les autres colonnes
-    while ( column < width ) {
-
-        value1 = (matrix[2] * ( * ( line1+columnOrig+1 ) ) + matrix[5] * ( * ( line2+columnOrig+1 ) ) + matrix[8] * ( * ( line3+columnOrig+1 ) ) - matrix[0] * ( * ( line1+columnOrig-1 ) ) - matrix[3] * ( * ( line2+columnOrig-1 ) ) - matrix[6] * ( * ( line3+columnOrig-1 ) ));
-        value2 = (matrix[0] * ( * ( line1+columnOrig-1 ) ) + matrix[1] * ( * ( line1+columnOrig ) ) + matrix[2] * ( * ( line1+columnOrig+1 ) ) - matrix[6] * ( * ( line3+columnOrig-1 ) ) - matrix[7] * ( * ( line3+columnOrig ) ) - matrix[8] * ( * ( line3+columnOrig+1 ) ));
+#ifdef __SSE2__
+    const __m128 signMask = _mm_set1_ps ( -0.f );
+    for ( ; column + 4 <= width; column += 4 ) {
+        _mm_storeu_ps ( dzdy + column, _mm_xor_ps ( _mm_loadu_ps ( dzdy + column ), signMask ) );
+    }
+#endif
+    for ( ; column < width; column++ ) {
+        dzdy[column] = -dzdy[column];
+    }
 
-        //calcul de la pente pour ne pas afficher l'exposition en dessous d'une certaine valeur de pente
-        slope = sqrt(pow(value1,2.0)+pow(value2,2.0));
-        if (slope < minSlope) {
-            value = -1.0;
+    atan2_ps ( result, dzdx, dzdy, width );
+
+    //pas d'exposition en dessous d'une certaine valeur de pente
+    const float toDeg = 180.0 / M_PI;
+    const float pi = M_PI;
+    const float minSlope2 = minSlope * minSlope;
+    column = 0;
+#ifdef __SSE2__
+    const __m128 TODEG = _mm_set1_ps ( toDeg );
+    const __m128 PI = _mm_set1_ps ( pi );
+    const __m128 MIN2 = _mm_set1_ps ( minSlope2 );
+    const __m128 flat = _mm_set1_ps ( -1.f );
+    const __m128 zero = _mm_setzero_ps();
+    // minSlope négative : toutes les pentes sont au dessus
+    const __m128 always = minSlope < 0 ? _mm_castsi128_ps ( _mm_set1_epi32 ( -1 ) ) : zero;
+    for ( ; column + 4 <= width; column += 4 ) {
+        __m128 dx = _mm_loadu_ps ( dzdx + column );
+        __m128 dy = _mm_loadu_ps ( dzdy + column );
+        __m128 steep = _mm_or_ps ( always, _mm_cmpge_ps ( _mm_add_ps ( _mm_mul_ps ( dx, dx ), _mm_mul_ps ( dy, dy ) ), MIN2 ) );
+        __m128 value = _mm_mul_ps ( _mm_add_ps ( _mm_loadu_ps ( result + column ), PI ), TODEG );
+        _mm_storeu_ps ( result + column, _mm_or_ps ( _mm_and_ps ( steep, value ), _mm_andnot_ps ( steep, flat ) ) );
+    }
+#endif
+    for ( ; column < width; column++ ) {
+        if ( minSlope >= 0 && dzdx[column] * dzdx[column] + dzdy[column] * dzdy[column] < minSlope2 ) {
+            result[column] = -1.0;
         } else {
-            value = (atan2(value1,value2) + M_PI) * 180 / M_PI;
+            result[column] = ( result[column] + pi ) * toDeg;
         }
-
-        * ( currentLine+ ( column++ ) ) = ( value );
-        columnOrig++;
-
     }
-
 }
-
-
@@ -38,42 +38,14 @@
 #ifndef ASPECTIMAGE_H
 #define ASPECTIMAGE_H
 
-#include "Image.h"
+#include "TerrainImage.h"
 #include <string>
 
 
-class AspectImage : public Image {
+class AspectImage : public TerrainImage {
 
 private:
 
-    /** \~french
-    * \brief Image d'origine utilisée pour calculer l'exposition
-    ** \~english
-    * \brief Origin image used to compute the aspect
-    */
-    Image* origImage;
-
-    /** \~french
-    * \brief Buffer contenant l'exposition calculée
-    ** \~english
-    * \brief Buffer of the aspect
-    */
-    float* aspect;
-
-    /** \~french
-    * \brief Buffer temporaire
-    ** \~english
-    * \brief Temporary buffer
-    */
-    float* bufferTmp;
-
-    /** \~french
-    * \brief Matrice de convolution
-    ** \~english
-    * \brief Convolution matrix
-    */
-    float matrix[9];
-
     /** \~french
     * \brief Résolution de l'image d'origine et donc finale
     ** \~english
@@ -95,88 +67,15 @@ private:
     */
     float minSlope;
 
-
-
-
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    int _getline ( uint8_t* buffer, int line );
-
     /** \~french
-    * \brief Récupère la ligne
+    * \brief Calcule une ligne de l'image de l'exposition
     ** \~english
-    * \brief Get line
+    * \brief Compute one line of the aspect
     */
-    int _getline ( uint16_t* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    int _getline ( float* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne dans l'image d'origine
-    ** \~english
-    * \brief Get line in origin image
-    */
-    int getOrigLine ( uint8_t* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne dans l'image d'origine
-    ** \~english
-    * \brief Get line in origin image
-    */
-    int getOrigLine ( uint16_t* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne dans l'image d'origine
-    ** \~english
-    * \brief Get line in origin image
-    */
-    int getOrigLine ( float* buffer, int line );
-
-    /** \~french
-    * \brief Génére l'image de l'exposition
-    ** \~english
-    * \brief Generate aspect
-    */
-    void generate();
-
-    /** \~french
-    * \brief Génére une ligne de l'image de l'exposition
-    ** \~english
-    * \brief Generate one line of the aspect
-    */
-    void generateLine ( int line, float* line1, float* line2 , float* line3 );
+    void computeLine();
 
 public:
 
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    virtual int getline ( float* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    virtual int getline ( uint8_t* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    virtual int getline ( uint16_t* buffer, int line );
-
     /** \~french
     * \brief Constructeur
     ** \~english
@@ -189,7 +88,7 @@ public:
     ** \~english
     * \brief Destructor
     */
-    virtual ~AspectImage();
+    virtual ~AspectImage() {}
 
 };
 
@@ -47,11 +47,10 @@
 #define BOUNDINGBOX_H
 
 #include "Logger.h"
+#include "ProjCache.h"
 #include <proj_api.h>
 #include <sstream>
 
-static pthread_mutex_t mutex_proj = PTHREAD_MUTEX_INITIALIZER;
-
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french \brief Gestion d'un rectangle englobant
@@ -86,7 +85,7 @@ public:
 
     /** \~french
      * \brief Reprojette le rectangle englobant (SRS sous forme de chaîne de caractères)
-     * \details Pour reprojeter la bounding box, on va découper chaque côté du rectangle en N, et identifier les extrema parmi ces 4*N points reprojetés.
+     * \details Pour reprojeter la bounding box, on va découper chaque côté du rectangle en N, et identifier les extrema parmi ces 4*(N+1) points reprojetés (extrémités incluses).
      * \param[in] from_srs système spatial source, celui du rectangle englobant initialement
      * \param[in] to_srs système spatial de destination, celui dans lequel on veut le rectangle englobant
      * \param[in] nbSegment nombre de points intérmédiaire à reprojeter sur chaque bord. 256 par défaut.
@@ -94,43 +93,22 @@ public:
      */
     int reproject ( std::string from_srs, std::string to_srs , int nbSegment = 256 ) {
 
-        pthread_mutex_lock ( & mutex_proj );
-        projCtx ctx = pj_ctx_alloc();
-
-        projPJ pj_src, pj_dst;
-        if ( ! ( pj_src = pj_init_plus_ctx ( ctx, ( "+init=" + from_srs +" +wktext" ).c_str() ) ) ) {
-            // Initialisation du système de projection source
-            int err = pj_ctx_get_errno ( ctx );
-            char *msg = pj_strerrno ( err );
-            LOGGER_ERROR ( "erreur d initialisation " << from_srs << " " << msg );
-            pj_ctx_free ( ctx );
-            pthread_mutex_unlock ( & mutex_proj );
-            return false;
-        }
-        if ( ! ( pj_dst = pj_init_plus_ctx ( ctx, ( "+init=" + to_srs +" +wktext +over" ).c_str() ) ) ) {
-            // Initialisation du système de projection destination
-            int err = pj_ctx_get_errno ( ctx );
-            char *msg = pj_strerrno ( err );
-            LOGGER_ERROR ( "erreur d initialisation " << to_srs << " " << msg );
-            pj_free ( pj_src );
-            pj_ctx_free ( ctx );
-            pthread_mutex_unlock ( & mutex_proj );
-            return false;
+        // Les systèmes sont initialisés une fois pour toutes, et réutilisés d'une requête à l'autre
+        ProjCacheElement* proj = ProjCache::acquire ( from_srs, to_srs );
+        if ( proj == NULL ) {
+            return 1;
         }
 
-        int err = reproject ( pj_src, pj_dst, nbSegment );
+        int err = reproject ( proj->src, proj->dst, nbSegment );
 
-        pj_free ( pj_src );
-        pj_free ( pj_dst );
-        pj_ctx_free ( ctx );
-        pthread_mutex_unlock ( & mutex_proj );
+        ProjCache::release ( proj );
 
         return err;
     }
 
     /** \~french
      * \brief Reprojette le rectangle englobant (SRS sous forme d'objets PROJ)
-     * \details Pour reprojeter la bounding box, on va découper chaque côté du rectangle en N, et identifier les extrema parmi ces 4*N points reprojetés.
+     * \details Pour reprojeter la bounding box, on va découper chaque côté du rectangle en N, et identifier les extrema parmi ces 4*(N+1) points reprojetés (extrémités incluses).
      * \param[in] pj_src système spatial source, celui du rectangle englobant initialement
      * \param[in] pj_dst système spatial de destination, celui dans lequel on veut le rectangle englobant
      * \param[in] nbSegment nombre de points intérmédiaire à reprojeter sur chaque bord. 256 par défaut.
@@ -141,10 +119,12 @@ public:
         T stepX = ( xmax - xmin ) / T ( nbSegment );
         T stepY = ( ymax - ymin ) / T ( nbSegment );
 
-        T segX[nbSegment*4];
-        T segY[nbSegment*4];
+        // Les extrémités de chaque côté sont incluses, afin que les quatre coins soient reprojetés
+        int nbPoints = ( nbSegment + 1 ) * 4;
+        T segX[nbPoints];
+        T segY[nbPoints];
 
-        for ( int i = 0; i < nbSegment; i++ ) {
+        for ( int i = 0; i <= nbSegment; i++ ) {
             segX[4*i] = xmin + i*stepX;
             segY[4*i] = ymin;
 
@@ -159,20 +139,20 @@ public:
         }
 
         if ( pj_is_latlong ( pj_src ) )
-            for ( int i = 0; i < nbSegment*4; i++ ) {
+            for ( int i = 0; i < nbPoints; i++ ) {
                 segX[i] *= DEG_TO_RAD;
                 segY[i] *= DEG_TO_RAD;
             }
 
 
-        int code = pj_transform ( pj_src, pj_dst, nbSegment*4, 0, segX, segY, 0 );
+        int code = pj_transform ( pj_src, pj_dst, nbPoints, 0, segX, segY, 0 );
 
         if ( code != 0 ) {
             LOGGER_ERROR ( "Code erreur proj4 : " << code );
             return 1;
         }
 
-        for ( int i = 0; i < nbSegment*4; i++ ) {
+        for ( int i = 0; i < nbPoints; i++ ) {
             if ( segX[i] == HUGE_VAL || segY[i] == HUGE_VAL ) {
                 LOGGER_ERROR ( "Valeurs retournees par pj_transform invalides" );
                 return 1;
@@ -180,7 +160,7 @@ public:
         }
 
         if ( pj_is_latlong ( pj_dst ) )
-            for ( int i = 0; i < nbSegment*4; i++ ) {
+            for ( int i = 0; i < nbPoints; i++ ) {
                 segX[i] *= RAD_TO_DEG;
                 segY[i] *= RAD_TO_DEG;
             }
@@ -190,7 +170,7 @@ public:
         ymin = segY[0];
         ymax = segY[0];
 
-        for ( int i = 1; i < nbSegment*4; i++ ) {
+        for ( int i = 1; i < nbPoints; i++ ) {
             xmin = std::min ( xmin, segX[i] );
             xmax = std::max ( xmax, segX[i] );
             ymin = std::min ( ymin, segY[i] );
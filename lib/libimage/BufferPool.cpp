@@ -0,0 +1,193 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file BufferPool.cpp
+ ** \~french
+ * \brief Implémentation des classes BufferPool et PooledBuffer
+ ** \~english
+ * \brief Implements classes BufferPool and PooledBuffer
+ */
+
+#include "BufferPool.h"
+
+/********************************************** PooledBuffer */
+
+void PooledBuffer::release() {
+    if ( __sync_sub_and_fetch ( &references, 1 ) == 0 ) {
+        BufferPool::giveBack ( this );
+    }
+}
+
+/********************************************** BufferPool */
+
+const size_t BufferPool::classSizes[BUFFER_POOL_CLASSES] = {
+    4096, 6144, 8192, 12288, 16384, 24576, 32768, 49152, 65536, 98304, 131072,
+    196608, 262144, 393216, 524288, 786432, 1048576, 1572864, 2097152
+};
+
+std::vector<PooledBuffer*> BufferPool::available[BUFFER_POOL_CLASSES];
+pthread_mutex_t BufferPool::mtx[BUFFER_POOL_CLASSES] = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER
+};
+size_t BufferPool::maxMemory = 64 * 1024 * 1024;
+volatile size_t BufferPool::usedMemory = 0;
+volatile uint64_t BufferPool::acquisitions = 0;
+volatile uint64_t BufferPool::allocations = 0;
+
+// Compteurs propres à chaque thread, pour le suivi par requête
+static thread_local uint64_t threadAcquisitions = 0;
+static thread_local uint64_t threadAllocations = 0;
+
+int BufferPool::getSizeClass ( size_t size ) {
+    if ( size > classSizes[BUFFER_POOL_CLASSES - 1] ) return -1;
+    int c = 0;
+    while ( classSizes[c] < size ) c++;
+    return c;
+}
+
+PooledBuffer* BufferPool::acquire ( size_t size ) {
+    __sync_add_and_fetch ( &acquisitions, 1 );
+    threadAcquisitions++;
+
+    int c = getSizeClass ( size );
+    PooledBuffer* buffer = NULL;
+
+    if ( c >= 0 ) {
+        pthread_mutex_lock ( &mtx[c] );
+        if ( ! available[c].empty() ) {
+            buffer = available[c].back();
+            available[c].pop_back();
+        }
+        pthread_mutex_unlock ( &mtx[c] );
+    }
+
+    if ( buffer ) {
+        __sync_sub_and_fetch ( &usedMemory, buffer->capacity );
+    } else {
+        __sync_add_and_fetch ( &allocations, 1 );
+        threadAllocations++;
+        buffer = new PooledBuffer ( c >= 0 ? classSizes[c] : size, c );
+    }
+
+    buffer->references = 1;
+    return buffer;
+}
+
+void BufferPool::giveBack ( PooledBuffer* buffer ) {
+    int c = buffer->sizeClass;
+    if ( c < 0 || __sync_add_and_fetch ( &usedMemory, buffer->capacity ) > maxMemory ) {
+        // Trop grand pour être réutilisé, ou réserve pleine
+        if ( c >= 0 ) __sync_sub_and_fetch ( &usedMemory, buffer->capacity );
+        delete buffer;
+        return;
+    }
+
+    pthread_mutex_lock ( &mtx[c] );
+    available[c].push_back ( buffer );
+    pthread_mutex_unlock ( &mtx[c] );
+}
+
+void BufferPool::setPoolSize ( size_t bytes ) {
+    maxMemory = bytes;
+
+    // Les plus grands tampons sont supprimés en premier
+    for ( int c = BUFFER_POOL_CLASSES - 1; c >= 0 && usedMemory > maxMemory; c-- ) {
+        pthread_mutex_lock ( &mtx[c] );
+        while ( ! available[c].empty() && usedMemory > maxMemory ) {
+            PooledBuffer* buffer = available[c].back();
+            available[c].pop_back();
+            __sync_sub_and_fetch ( &usedMemory, buffer->capacity );
+            delete buffer;
+        }
+        pthread_mutex_unlock ( &mtx[c] );
+    }
+}
+
+uint64_t BufferPool::getAcquisitions () {
+    return acquisitions;
+}
+
+uint64_t BufferPool::getAllocations () {
+    return allocations;
+}
+
+uint64_t BufferPool::getThreadAcquisitions () {
+    return threadAcquisitions;
+}
+
+uint64_t BufferPool::getThreadAllocations () {
+    return threadAllocations;
+}
+
+void BufferPool::resetThreadCounters () {
+    threadAcquisitions = 0;
+    threadAllocations = 0;
+}
+
+size_t BufferPool::getUsedMemory () {
+    return usedMemory;
+}
+
+void BufferPool::printStats () {
+    int n = 0;
+    for ( int c = 0; c < BUFFER_POOL_CLASSES; c++ ) {
+        pthread_mutex_lock ( &mtx[c] );
+        n += available[c].size();
+        pthread_mutex_unlock ( &mtx[c] );
+    }
+    LOGGER_INFO ( "Réserve de tampons : " << n << " tampons disponibles, " << usedMemory << " / " << maxMemory << " octets" );
+    LOGGER_INFO ( "\t- demandes = " << acquisitions << ", allocations = " << allocations );
+}
+
+void BufferPool::cleanPool () {
+    for ( int c = 0; c < BUFFER_POOL_CLASSES; c++ ) {
+        pthread_mutex_lock ( &mtx[c] );
+        for ( size_t i = 0; i < available[c].size(); i++ ) {
+            __sync_sub_and_fetch ( &usedMemory, available[c].at ( i )->capacity );
+            delete available[c].at ( i );
+        }
+        available[c].clear();
+        pthread_mutex_unlock ( &mtx[c] );
+    }
+    acquisitions = 0;
+    allocations = 0;
+}
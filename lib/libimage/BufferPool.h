@@ -0,0 +1,409 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file BufferPool.h
+ ** \~french
+ * \brief Définition des classes BufferPool, PooledBuffer et PooledDataSource
+ ** \~english
+ * \brief Define classes BufferPool, PooledBuffer and PooledDataSource
+ */
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <stdint.h>// pour uint8_t
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "Logger.h"
+#include "Data.h"
+
+/**
+ * \~french \brief Nombre de classes de tailles des tampons réutilisés
+ * \details Les tailles vont de 4 Kio à 2 Mio, par pas alternés de x1,5 et x4/3
+ * \~english \brief Number of size classes of reused buffers
+ * \details Sizes go from 4 KiB to 2 MiB, by alternate steps of x1.5 and x4/3
+ */
+#define BUFFER_POOL_CLASSES 19
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Tampon mémoire partagé, compté par références
+ * \details Un tampon est obtenu avec BufferPool::acquire, avec une référence. Tant qu'il est partagé (cache des tuiles, réponse en cours d'envoi), son contenu ne doit plus être modifié. À la dernière libération, il retourne dans la réserve au lieu d'être supprimé.
+ * \~english
+ * \brief Shared memory buffer, reference counted
+ * \details A buffer is obtained with BufferPool::acquire, with one reference. As long as it is shared (tiles cache, response being sent), its content must not be modified anymore. At the last release, it goes back to the pool instead of being deleted.
+ */
+class PooledBuffer {
+
+    friend class BufferPool;
+
+private:
+
+    /**
+     * \~french \brief Données
+     * \~english \brief Data
+     */
+    uint8_t* data;
+
+    /**
+     * \~french \brief Taille allouée
+     * \~english \brief Allocated size
+     */
+    size_t capacity;
+
+    /**
+     * \~french \brief Classe de taille, négative si le tampon est trop grand pour être réutilisé
+     * \~english \brief Size class, negative if buffer is too big to be reused
+     */
+    int sizeClass;
+
+    /**
+     * \~french \brief Nombre de références
+     * \~english \brief References number
+     */
+    volatile int references;
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    PooledBuffer ( size_t c, int sc ) : capacity ( c ), sizeClass ( sc ), references ( 0 ) {
+        data = new uint8_t[capacity];
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~PooledBuffer() {
+        delete[] data;
+    }
+
+public:
+
+    /**
+     * \~french \brief Retourne les données
+     * \~english \brief Return data
+     */
+    uint8_t* getData() {
+        return data;
+    }
+
+    /**
+     * \~french \brief Retourne la taille allouée, au moins égale à la taille demandée
+     * \~english \brief Return allocated size, at least equal to the asked size
+     */
+    size_t getCapacity() {
+        return capacity;
+    }
+
+    /**
+     * \~french \brief Ajoute une référence
+     * \~english \brief Add a reference
+     */
+    void retain() {
+        __sync_add_and_fetch ( &references, 1 );
+    }
+
+    /**
+     * \~french \brief Supprime une référence
+     * \details À la dernière, le tampon retourne dans la réserve et ne doit plus être utilisé
+     * \~english \brief Remove a reference
+     * \details At the last one, buffer goes back to the pool and must not be used anymore
+     */
+    void release();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Réserve de tampons mémoire réutilisables
+ * \details Cette classe est statique : la réserve est partagée par tous les threads. Les tampons libérés sont gardés par classe de taille, dans la limite d'une occupation mémoire totale, et rendus aux demandes suivantes de taille proche : en régime établi, lire et envoyer une tuile n'alloue plus de mémoire.
+ *
+ * Des compteurs, globaux et propres à chaque thread, permettent de vérifier la part des demandes satisfaites sans allocation.
+ * \~english
+ * \brief Pool of reusable memory buffers
+ * \details This class is static : pool is shared by all threads. Released buffers are kept by size class, within a total memory limit, and given to following requests of close size : in steady state, reading and sending a tile does not allocate memory anymore.
+ *
+ * Counters, global and specific to each thread, allow to check the part of requests satisfied without allocation.
+ */
+class BufferPool {
+
+    friend class PooledBuffer;
+
+private:
+
+    /**
+     * \~french \brief Tailles des classes de tampons
+     * \~english \brief Buffers classes' sizes
+     */
+    static const size_t classSizes[BUFFER_POOL_CLASSES];
+
+    /**
+     * \~french \brief Tampons disponibles, par classe de taille
+     * \~english \brief Available buffers, by size class
+     */
+    static std::vector<PooledBuffer*> available[BUFFER_POOL_CLASSES];
+
+    /**
+     * \~french \brief Exclusion mutuelle, par classe de taille
+     * \~english \brief Mutex, by size class
+     */
+    static pthread_mutex_t mtx[BUFFER_POOL_CLASSES];
+
+    /**
+     * \~french \brief Occupation mémoire maximale des tampons disponibles, en octets
+     * \~english \brief Max memory used by available buffers, in bytes
+     */
+    static size_t maxMemory;
+
+    /**
+     * \~french \brief Occupation mémoire courante des tampons disponibles, en octets
+     * \~english \brief Current memory used by available buffers, in bytes
+     */
+    static volatile size_t usedMemory;
+
+    /**
+     * \~french \brief Statistiques : demandes, allocations
+     * \~english \brief Statistics : requests, allocations
+     */
+    static volatile uint64_t acquisitions, allocations;
+
+    /**
+     * \~french \brief Classe de taille d'une taille demandée
+     * \return Indice de la classe, négatif si la taille dépasse la plus grande classe
+     * \~english \brief Size class of an asked size
+     * \return Class' index, negative if size exceeds the biggest class
+     */
+    static int getSizeClass ( size_t size );
+
+    /**
+     * \~french \brief Reprend un tampon qui n'est plus référencé
+     * \~english \brief Take back a no more referenced buffer
+     */
+    static void giveBack ( PooledBuffer* buffer );
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \~english
+     * \brief Constructeur
+     */
+    BufferPool(){};
+
+public:
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \~english
+     * \brief Destructor
+     */
+    ~BufferPool(){};
+
+    /**
+     * \~french \brief Obtient un tampon d'au moins la taille demandée, avec une référence
+     * \details Un tampon disponible de la bonne classe est réutilisé, sinon un nouveau est alloué
+     * \param[in] size Taille voulue, en octets
+     * \~english \brief Get a buffer of at least asked size, with one reference
+     * \details An available buffer of the right class is reused, otherwise a new one is allocated
+     * \param[in] size Wanted size, in bytes
+     */
+    static PooledBuffer* acquire ( size_t size );
+
+    /**
+     * \~french \brief Définit l'occupation mémoire maximale des tampons disponibles
+     * \details Les tampons en trop sont supprimés. Une taille nulle désactive la réutilisation.
+     * \param[in] bytes Taille maximale, en octets
+     * \~english \brief Define max memory used by available buffers
+     * \details Buffers in excess are deleted. A null size disables reuse.
+     * \param[in] bytes Max size, in bytes
+     */
+    static void setPoolSize ( size_t bytes );
+
+    /**
+     * \~french \brief Retourne le nombre total de tampons demandés
+     * \~english \brief Return the total number of asked buffers
+     */
+    static uint64_t getAcquisitions ();
+
+    /**
+     * \~french \brief Retourne le nombre total de tampons alloués (demandes non satisfaites par la réserve)
+     * \~english \brief Return the total number of allocated buffers (requests not satisfied by the pool)
+     */
+    static uint64_t getAllocations ();
+
+    /**
+     * \~french \brief Retourne le nombre de tampons demandés par le thread courant depuis sa dernière remise à zéro
+     * \~english \brief Return the number of buffers asked by the current thread since its last reset
+     */
+    static uint64_t getThreadAcquisitions ();
+
+    /**
+     * \~french \brief Retourne le nombre de tampons alloués pour le thread courant depuis sa dernière remise à zéro
+     * \~english \brief Return the number of buffers allocated for the current thread since its last reset
+     */
+    static uint64_t getThreadAllocations ();
+
+    /**
+     * \~french \brief Remet à zéro les compteurs du thread courant, typiquement au début d'une requête
+     * \~english \brief Reset the current thread's counters, typically at a request's beginning
+     */
+    static void resetThreadCounters ();
+
+    /**
+     * \~french \brief Retourne l'occupation mémoire courante des tampons disponibles, en octets
+     * \~english \brief Return the current memory used by available buffers, in bytes
+     */
+    static size_t getUsedMemory ();
+
+    /**
+     * \~french \brief Affiche les statistiques de la réserve
+     * \~english \brief Print pool's statistics
+     */
+    static void printStats ();
+
+    /**
+     * \~french \brief Supprime tous les tampons disponibles et remet à zéro les statistiques
+     * \~english \brief Delete all available buffers and reset statistics
+     */
+    static void cleanPool ();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Source de données lisant un tampon partagé, sans copie
+ * \~english
+ * \brief Data source reading a shared buffer, without copy
+ */
+class PooledDataSource : public DataSource {
+
+private:
+
+    /**
+     * \~french \brief Tampon, dont la source détient une référence
+     * \~english \brief Buffer, whose the source holds a reference
+     */
+    PooledBuffer* buffer;
+
+    /**
+     * \~french \brief Taille utile des données
+     * \~english \brief Useful data size
+     */
+    size_t dataSize;
+
+    std::string type;
+    std::string encoding;
+
+    /**
+     * \~french \brief Identifiant et date de modification de la donnée
+     * \~english \brief Data's identifier and modification date
+     */
+    std::string tag;
+    time_t modification;
+
+public:
+
+    /**
+     * \~french \brief Constructeur
+     * \details Une référence au tampon est ajoutée
+     * \~english \brief Constructor
+     * \details A reference to the buffer is added
+     */
+    PooledDataSource ( PooledBuffer* b, size_t s, std::string t, std::string e, std::string tg = "", time_t m = 0 ) :
+        buffer ( b ), dataSize ( s ), type ( t ), encoding ( e ), tag ( tg ), modification ( m ) {
+        buffer->retain();
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \details La référence au tampon est supprimée
+     * \~english \brief Destructor
+     * \details Reference to the buffer is removed
+     */
+    virtual ~PooledDataSource() {
+        buffer->release();
+    }
+
+    const uint8_t* getData ( size_t &size ) {
+        size = dataSize;
+        return buffer->getData();
+    }
+
+    PooledBuffer* getBuffer ( size_t &size ) {
+        size = dataSize;
+        return buffer;
+    }
+
+    std::string getTag() {
+        return tag;
+    }
+
+    time_t getModification() {
+        return modification;
+    }
+
+    /**
+     * \~french \brief Le tampon est gardé jusqu'à la destruction de la source
+     * \~english \brief Buffer is kept until the source's destruction
+     */
+    bool releaseData() {
+        return false;
+    }
+
+    std::string getType() {
+        return type;
+    }
+
+    int getHttpStatus() {
+        return 200;
+    }
+
+    std::string getEncoding() {
+        return encoding;
+    }
+
+    unsigned int getLength() {
+        return dataSize;
+    }
+};
+
+#endif
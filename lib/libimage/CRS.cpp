@@ -45,6 +45,7 @@
 
 #include "CRS.h"
 #include "Logger.h"
+#include "ProjCache.h"
 #include <proj_api.h>
 
 /**
@@ -72,23 +73,12 @@ std::string toUpperCase ( std::string str ) {
  * \~english \brief Test whether the string represent a Proj compatible CRS
  */
 bool isCrsProj4Compatible ( std::string crs ) {
-    projCtx ctx = pj_ctx_alloc();
-    projPJ pj = pj_init_plus_ctx ( ctx, ( "+init=" + crs +" +wktext" ).c_str() );
-    if ( !pj ) {
-        int err = pj_ctx_get_errno ( ctx );
-        char *msg = pj_strerrno ( err );
-        // LOGGER_DEBUG(_("erreur d initialisation ") << crs << " " << msg);
-        pj_ctx_free ( ctx );
+    ProjCacheElement* proj = ProjCache::acquire ( crs, "", false );
+    if ( ! proj ) {
         return false;
     }
-    bool isCompatible;
-    if ( pj ) isCompatible=true;
-    else isCompatible=false;
-
-    pj_free ( pj );
-    pj_ctx_free ( ctx );
-
-    return isCompatible;
+    ProjCache::release ( proj );
+    return true;
 }
 
 /**
@@ -96,18 +86,12 @@ bool isCrsProj4Compatible ( std::string crs ) {
  * \~english \brief Test whether the string represent a geographic CRS
  */
 bool isCrsLongLat ( std::string crs ) {
-    projCtx ctx = pj_ctx_alloc();
-    projPJ pj=pj_init_plus_ctx ( ctx, ( "+init=" + crs +" +wktext" ).c_str() );
-    if ( !pj ) {
-        int err = pj_ctx_get_errno ( ctx );
-        char *msg = pj_strerrno ( err );
-        // LOGGER_DEBUG(_("erreur d initialisation ") << crs << " " << msg);
-        pj_ctx_free ( ctx );
+    ProjCacheElement* proj = ProjCache::acquire ( crs, "", false );
+    if ( ! proj ) {
         return false;
     }
-    bool isLongLat=pj_is_latlong ( pj );
-    pj_free ( pj );
-    pj_ctx_free ( ctx );
+    bool isLongLat=pj_is_latlong ( proj->src );
+    ProjCache::release ( proj );
     return isLongLat;
 }
 
@@ -139,20 +123,14 @@ CRS& CRS::operator= ( const CRS& other ) {
 
 
 void CRS::fetchDefinitionArea() {
-    projCtx ctx = pj_ctx_alloc();
-    projPJ pj=pj_init_plus_ctx ( ctx, ( "+init=" + proj4Code +" +wktext" ).c_str() );
-    if ( !pj ) {
-        int err = pj_ctx_get_errno ( ctx );
-        char *msg = pj_strerrno ( err );
-        // LOGGER_DEBUG(_("erreur d initialisation ") << crs << " " << msg);
-        pj_ctx_free ( ctx );
+    ProjCacheElement* proj = ProjCache::acquire ( proj4Code, "", false );
+    if ( ! proj ) {
         return;
     }
-    pj_get_def_area ( pj, & ( definitionArea.xmin ), & ( definitionArea.ymin ), & ( definitionArea.xmax ), & ( definitionArea.ymax ) );
+    pj_get_def_area ( proj->src, & ( definitionArea.xmin ), & ( definitionArea.ymin ), & ( definitionArea.xmax ), & ( definitionArea.ymax ) );
     //LOGGER_DEBUG(proj4Code);
     //definitionArea.print();
-    pj_free ( pj );
-    pj_ctx_free ( ctx );
+    ProjCache::release ( proj );
 }
 
 
@@ -360,21 +338,16 @@ BoundingBox< double > CRS::cropBBoxGeographic ( double minx, double miny, double
 
 std::string CRS::getProj4Def() {
    buildProj4Code();
-   projCtx ctx = pj_ctx_alloc();
-   projPJ pj=pj_init_plus_ctx ( ctx, ( "+init=" + getProj4Code() +" +wktext" ).c_str() );
-   if ( !pj ) {
-       int err = pj_ctx_get_errno ( ctx );
-       char *msg = pj_strerrno ( err );
-       LOGGER_DEBUG("erreur d initialisation " << getProj4Code() << " " << msg);
-       pj_ctx_free ( ctx );
+   ProjCacheElement* proj = ProjCache::acquire ( getProj4Code(), "", false );
+   if ( !proj ) {
+       LOGGER_DEBUG("erreur d initialisation " << getProj4Code() );
        return "";
    }
-   char * pjdef = pj_get_def( pj, 666 );
+   char * pjdef = pj_get_def( proj->src, 666 );
    std::string def( pjdef ); //666 option is to specify that we want all parameters (include towgs84 since we already have +nadgrids)
    pj_dalloc(pjdef);
    //LOGGER_DEBUG("Définition de " << getProj4Code() << " : " << def );
-   pj_free ( pj );
-   pj_ctx_free ( ctx );
+   ProjCache::release ( proj );
    
    return def;
 }
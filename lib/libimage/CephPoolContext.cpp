@@ -49,6 +49,7 @@
 
 #include "CephPoolContext.h"
 #include <stdlib.h>
+#include <errno.h>
 
 
 CephPoolContext::CephPoolContext (std::string pool) : Context(), pool_name(pool) {
@@ -164,6 +165,133 @@ int CephPoolContext::read(uint8_t* data, int offset, int size, std::string name)
 }
 
 
+/**
+ * \~french \brief État d'une lecture Ceph asynchrone
+ * \details Plusieurs lectures d'un même objet partagent la même opération et la même complétion, libérées par la première lecture du groupe
+ * \~english \brief Asynchronous Ceph reading's state
+ * \details Several readings in a same object share the same operation and completion, released by the group's first reading
+ */
+struct CephPendingRead {
+    rados_completion_t completion;
+    rados_read_op_t op;
+    size_t bytesRead;
+    int prval;
+    bool owner;
+    bool started;
+
+    CephPendingRead() : completion(NULL), op(NULL), bytesRead(0), prval(0), owner(false), started(false) {}
+};
+
+void CephPoolContext::submitReads(std::vector<ContextRead*>& reads) {
+
+    if (! connected) {
+        LOGGER_ERROR("Try to read using the unconnected ceph pool context " << pool_name);
+        return;
+    }
+
+    LOGGER_DEBUG("Ceph asynchronous read : " << reads.size() << " readings");
+
+    // Regroupement des lectures par objet
+    std::map<std::string, std::vector<ContextRead*> > objects;
+    for (int i = 0; i < reads.size(); i++) {
+        objects[reads.at(i)->name].push_back(reads.at(i));
+    }
+
+    std::map<std::string, std::vector<ContextRead*> >::iterator it;
+    for (it = objects.begin(); it != objects.end(); ++it) {
+        std::vector<ContextRead*>& group = it->second;
+
+        rados_completion_t completion;
+        if (rados_aio_create_completion(NULL, NULL, NULL, &completion) < 0) {
+            // Lectures non démarrées : elles seront faites de manière synchrone lors de l'attente
+            LOGGER_WARN("Cannot create asynchronous reading completion for the Ceph object " << it->first);
+            for (int i = 0; i < group.size(); i++) {
+                group.at(i)->pending = (void*) new CephPendingRead();
+            }
+            continue;
+        }
+
+        if (group.size() == 1) {
+            ContextRead* r = group.at(0);
+            CephPendingRead* pr = new CephPendingRead();
+            pr->completion = completion;
+            pr->owner = true;
+            r->pending = (void*) pr;
+            int ret = rados_aio_read(io_ctx, r->name.c_str(), completion, (char*) r->data, r->size, r->offset);
+            if (ret < 0) {
+                // La lecture sera refaite de manière synchrone lors de l'attente
+                LOGGER_WARN("Cannot start asynchronous reading in the Ceph object " << r->name << " : " << strerror(-ret));
+            } else {
+                pr->started = true;
+            }
+            continue;
+        }
+
+        // Plusieurs extraits du même objet : une seule opération
+        rados_read_op_t op = rados_create_read_op();
+        for (int i = 0; i < group.size(); i++) {
+            ContextRead* r = group.at(i);
+            CephPendingRead* pr = new CephPendingRead();
+            pr->completion = completion;
+            pr->op = op;
+            pr->owner = (i == 0);
+            r->pending = (void*) pr;
+            rados_read_op_read(op, r->offset, r->size, (char*) r->data, &(pr->bytesRead), &(pr->prval));
+        }
+        int ret = rados_aio_read_op_operate(op, io_ctx, completion, it->first.c_str(), 0);
+        if (ret < 0) {
+            LOGGER_WARN("Cannot start asynchronous reading operation in the Ceph object " << it->first << " : " << strerror(-ret));
+        } else {
+            for (int i = 0; i < group.size(); i++) {
+                ((CephPendingRead*) group.at(i)->pending)->started = true;
+            }
+        }
+    }
+}
+
+void CephPoolContext::waitReads(std::vector<ContextRead*>& reads) {
+
+    for (int i = 0; i < reads.size(); i++) {
+        ContextRead* r = reads.at(i);
+        if (r->pending == NULL) continue;
+        CephPendingRead* pr = (CephPendingRead*) r->pending;
+
+        int ret = -ECANCELED;
+        if (pr->started) {
+            rados_aio_wait_for_complete(pr->completion);
+            ret = rados_aio_get_return_value(pr->completion);
+        }
+
+        if (pr->op == NULL) {
+            r->result = ret;
+        } else if (ret < 0) {
+            r->result = ret;
+        } else if (pr->prval < 0) {
+            r->result = pr->prval;
+        } else {
+            r->result = pr->bytesRead;
+        }
+
+        if (r->result < 0) {
+            LOGGER_DEBUG("Asynchronous Ceph read failed (" << strerror(-r->result) << "), try again synchronously");
+            r->result = read(r->data, r->offset, r->size, r->name);
+        }
+    }
+
+    // Les opérations et complétions partagées ne sont libérées qu'une fois toutes les lectures traitées
+    for (int i = 0; i < reads.size(); i++) {
+        ContextRead* r = reads.at(i);
+        if (r->pending == NULL) continue;
+        CephPendingRead* pr = (CephPendingRead*) r->pending;
+        if (pr->owner) {
+            if (pr->op != NULL) rados_release_read_op(pr->op);
+            rados_aio_release(pr->completion);
+        }
+        delete pr;
+        r->pending = NULL;
+    }
+}
+
 bool CephPoolContext::write(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("Ceph write : " << size << " bytes (from the " << offset << " one) in the writing buffer " << name);
 
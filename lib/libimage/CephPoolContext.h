@@ -192,6 +192,34 @@ public:
      */
     int read(uint8_t* data, int offset, int size, std::string name);
 
+    /**
+     * \~french \brief Les lectures Ceph peuvent être menées en parallèle
+     * \~english \brief Ceph readings can be handled in parallel
+     */
+    bool asyncReads() {
+        return true;
+    }
+
+    /**
+     * \~french
+     * \brief Lance un lot de lectures Ceph asynchrones
+     * \details Les lectures d'un même objet sont regroupées en une seule opération librados, les autres sont lancées avec rados_aio_read
+     * \~english
+     * \brief Start a batch of asynchronous Ceph readings
+     * \details Readings in a same object are grouped in one librados operation, others are started with rados_aio_read
+     */
+    void submitReads(std::vector<ContextRead*>& reads);
+
+    /**
+     * \~french
+     * \brief Attend la fin d'un lot de lectures Ceph
+     * \details Les lectures en échec sont refaites une à une (#read), avec les tentatives supplémentaires
+     * \~english
+     * \brief Wait for a batch of Ceph readings
+     * \details Failed readings are done again one by one (#read), with additional attempts
+     */
+    void waitReads(std::vector<ContextRead*>& reads);
+
     /**
      * \~french
      * \brief Écrit de la donnée dans un objet Ceph
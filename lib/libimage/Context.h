@@ -49,7 +49,9 @@
 #define CONTEXT_H
 
 #include <map>
+#include <vector>
 #include <stdint.h>// pour uint8_t
+#include <time.h>
 #include "Logger.h"
 #include <string.h>
 #include <sstream>
@@ -84,6 +86,58 @@ std::string toString ( eContextType ct );
 
 }
 
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Lecture asynchrone d'une partie d'un objet
+ * \details Les lectures sont soumises par lot au contexte (Context::submitReads) puis attendues (Context::waitReads), depuis le même thread. Le résultat n'est valide qu'après l'attente.
+ * \~english
+ * \brief Asynchronous reading of a part of an object
+ * \details Readings are submitted as a batch to the context (Context::submitReads) then waited for (Context::waitReads), from the same thread. Result is valid only after the wait.
+ */
+class ContextRead {
+
+public:
+
+    /**
+     * \~french \brief Buffer où stocker la donnée lue, assez grand
+     * \~english \brief Buffer where to store read data, big enough
+     */
+    uint8_t* data;
+    /**
+     * \~french \brief À partir d'où on veut lire
+     * \~english \brief From where we want to read
+     */
+    int offset;
+    /**
+     * \~french \brief Nombre d'octet que l'on veut lire
+     * \~english \brief Number of bytes we want to read
+     */
+    int size;
+    /**
+     * \~french \brief Nom de l'objet que l'on veut lire
+     * \~english \brief Object's name we want to read
+     */
+    std::string name;
+    /**
+     * \~french \brief Taille effectivement lue, un nombre négatif en cas d'erreur
+     * \~english \brief Real size of read data, negative integer if an error occured
+     */
+    int result;
+    /**
+     * \~french \brief État propre au contexte pendant la lecture
+     * \~english \brief Context specific state during reading
+     */
+    void* pending;
+
+    /**
+     * \~french \brief Crée une lecture
+     * \~english \brief Create a reading
+     */
+    ContextRead ( uint8_t* data, int offset, int size, std::string name ) :
+        data ( data ), offset ( offset ), size ( size ), name ( name ), result ( -1 ), pending ( NULL ) {}
+};
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -170,6 +224,45 @@ public:
      */
     virtual int read(uint8_t* data, int offset, int size, std::string name) = 0;
 
+    /**
+     * \~french \brief Précise si le contexte sait mener plusieurs lectures en parallèle (cf #submitReads)
+     * \~english \brief Precise if context can handle several readings in parallel (see #submitReads)
+     */
+    virtual bool asyncReads() {
+        return false;
+    }
+
+    /**
+     * \~french \brief Lance un lot de lectures
+     * \details Par défaut, les lectures sont faites une à une, immédiatement. Les contextes sachant mener plusieurs lectures en parallèle les démarrent ici et rendent la main. Le lot doit être attendu avec #waitReads, depuis le même thread.
+     * \param[in,out] reads Lectures à faire
+     * \~english \brief Start a batch of readings
+     * \details By default, readings are done one by one, immediately. Contexts able to handle several readings in parallel start them here and return. Batch have to be waited for with #waitReads, from the same thread.
+     * \param[in,out] reads Readings to do
+     */
+    virtual void submitReads(std::vector<ContextRead*>& reads) {
+        for (size_t i = 0; i < reads.size(); i++) {
+            reads.at(i)->result = read(reads.at(i)->data, reads.at(i)->offset, reads.at(i)->size, reads.at(i)->name);
+        }
+    }
+
+    /**
+     * \~french \brief Attend la fin d'un lot de lectures lancé avec #submitReads
+     * \param[in,out] reads Lectures à attendre
+     * \~english \brief Wait for a batch of readings started with #submitReads
+     * \param[in,out] reads Readings to wait for
+     */
+    virtual void waitReads(std::vector<ContextRead*>& reads) { }
+
+    /**
+     * \~french \brief Lance un lot de lectures et attend leur fin
+     * \~english \brief Start a batch of readings and wait for them
+     */
+    void readAll(std::vector<ContextRead*>& reads) {
+        submitReads(reads);
+        waitReads(reads);
+    }
+
     /**
      * \~french \brief Écrit de la donnée dans l'objet
      * \param[in] data Buffer contenant la donnée à écrire
@@ -228,6 +321,32 @@ public:
      */
     virtual std::string getTray() = 0;
 
+    /**
+     * \~french \brief Retourne la date de modification d'un objet, si elle est connue sans requête au stockage
+     * \param[in] name Nom de l'objet
+     * \return 0 si la date n'est pas connue
+     * \~english \brief Return an object's modification date, if known without storage request
+     * \param[in] name Object's name
+     * \return 0 if date is unknown
+     */
+    virtual time_t getModification(std::string name) {
+        return 0;
+    }
+
+    /**
+     * \~french \brief Retourne la version courante d'un objet, pour détecter sa réécriture
+     * \details Les caches des index et des tuiles comparent cette version à celle de l'objet lors de leur remplissage.
+     * \param[in] name Nom de l'objet
+     * \return Chaîne vide si la version n'est pas connue
+     * \~english \brief Return an object's current version, to detect its rewriting
+     * \details Index and tile caches compare this version to the object's one when they were filled.
+     * \param[in] name Object's name
+     * \return Empty string if version is unknown
+     */
+    virtual std::string getVersion(std::string name) {
+        return "";
+    }
+
     /**
      * \~french \brief Retourne le chemin pour une tuile X/Y relatif à ce contexte
      * \~english \brief Return the path for a tile (X/Y) in this context
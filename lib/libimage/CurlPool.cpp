@@ -44,5 +44,100 @@
  */
 
 #include "CurlPool.h"
+#include "LibcurlStruct.h"
 
 std::map<pthread_t, CURL*> CurlPool::pool;
+std::map<pthread_t, CURLM*> CurlPool::multiPool;
+pthread_mutex_t CurlPool::mtx = PTHREAD_MUTEX_INITIALIZER;
+
+CURLM* CurlPool::getCurlMultiEnv() {
+    pthread_t i = pthread_self();
+
+    pthread_mutex_lock ( &mtx );
+    std::map<pthread_t, CURLM*>::iterator it = multiPool.find ( i );
+    if ( it != multiPool.end() ) {
+        CURLM* m = it->second;
+        pthread_mutex_unlock ( &mtx );
+        return m;
+    }
+
+    CURLM* m = curl_multi_init();
+#ifdef CURLPIPE_MULTIPLEX
+    if ( getenv ( ROK4_CURL_MULTIPLEX ) != NULL ) {
+        curl_multi_setopt ( m, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+    }
+#endif
+    multiPool.insert ( std::pair<pthread_t, CURLM*> ( i, m ) );
+    pthread_mutex_unlock ( &mtx );
+    return m;
+}
+
+void CurlPool::addRequest ( CurlRequest* req ) {
+    CURLM* multi = getCurlMultiEnv();
+
+    curl_easy_setopt ( req->curl, CURLOPT_PRIVATE, ( void* ) req );
+    curl_easy_setopt ( req->curl, CURLOPT_TCP_KEEPALIVE, 1L );
+#ifdef CURL_HTTP_VERSION_2TLS
+    if ( getenv ( ROK4_CURL_MULTIPLEX ) != NULL ) {
+        curl_easy_setopt ( req->curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS );
+        // On attend une connexion existante pouvant multiplexer plutôt que d'en ouvrir une nouvelle
+        curl_easy_setopt ( req->curl, CURLOPT_PIPEWAIT, 1L );
+    }
+#endif
+
+    req->done = false;
+    curl_multi_add_handle ( multi, req->curl );
+
+    // On démarre les transferts sans attendre
+    int running;
+    curl_multi_perform ( multi, &running );
+}
+
+int CurlPool::harvestRequests ( CURLM* multi, std::vector<CurlRequest*>& reqs ) {
+    int running;
+    curl_multi_perform ( multi, &running );
+
+    // On récupère les requêtes terminées, éventuellement démarrées par un autre lot du même thread
+    CURLMsg* msg;
+    int left;
+    while ( ( msg = curl_multi_info_read ( multi, &left ) ) ) {
+        if ( msg->msg != CURLMSG_DONE ) continue;
+
+        CurlRequest* req;
+        curl_easy_getinfo ( msg->easy_handle, CURLINFO_PRIVATE, ( char** ) &req );
+        req->code = msg->data.result;
+        req->done = true;
+        curl_multi_remove_handle ( multi, msg->easy_handle );
+    }
+
+    int nbDone = 0;
+    for ( size_t i = 0; i < reqs.size(); i++ ) {
+        if ( reqs.at ( i )->done ) nbDone++;
+    }
+    return nbDone;
+}
+
+void CurlPool::waitRequests ( std::vector<CurlRequest*>& reqs ) {
+    CURLM* multi = getCurlMultiEnv();
+
+    while ( ( size_t ) harvestRequests ( multi, reqs ) < reqs.size() ) {
+        curl_multi_wait ( multi, NULL, 0, 1000, NULL );
+    }
+}
+
+int CurlPool::pollRequests ( std::vector<CurlRequest*>& reqs, int milliseconds ) {
+    CURLM* multi = getCurlMultiEnv();
+
+    int nbDone = harvestRequests ( multi, reqs );
+    if ( nbDone > 0 || milliseconds <= 0 ) return nbDone;
+
+    curl_multi_wait ( multi, NULL, 0, milliseconds, NULL );
+    return harvestRequests ( multi, reqs );
+}
+
+void CurlPool::cancelRequest ( CurlRequest* req ) {
+    if ( req->done ) return;
+    curl_multi_remove_handle ( getCurlMultiEnv(), req->curl );
+    req->done = true;
+    req->code = CURLE_ABORTED_BY_CALLBACK;
+}
@@ -52,6 +52,14 @@
 #include <string.h>
 #include <sstream>
 #include <curl/curl.h>
+#include <pthread.h>
+#include <vector>
+
+#ifndef ROK4_CURL_MULTIPLEX
+#define ROK4_CURL_MULTIPLEX "ROK4_CURL_MULTIPLEX"
+#endif
+
+struct CurlRequest;
 
 
 /**
@@ -72,6 +80,38 @@ private:
      */
     static std::map<pthread_t, CURL*> pool;
 
+    /**
+     * \~french \brief Exclusion mutuelle pour l'accès à l'annuaire
+     * \details Des threads de travail (cf ThreadPool) peuvent demander leur objet curl en même temps
+     * \~english \brief Mutex for the book access
+     * \details Worker threads (see ThreadPool) can ask for their curl object at the same time
+     */
+    static pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Annuaire des objets Curl multiples
+     * \details La clé est l'identifiant du thread. Chaque objet conserve ses connexions ouvertes (keep-alive) d'un lot de requêtes à l'autre
+     * \~english \brief Curl multi object book
+     * \details Key is the thread's ID. Each object keeps its connections alive from a requests' batch to another
+     */
+    static std::map<pthread_t, CURLM*> multiPool;
+
+    /**
+     * \~french \brief Retourne un objet Curl multiple propre au thread appelant
+     * \details Si la variable d'environnement ROK4_CURL_MULTIPLEX est définie, les requêtes vers un même serveur sont multiplexées (HTTP/2)
+     * \~english \brief Get the curl multi object specific to the calling thread
+     * \details If environment variable ROK4_CURL_MULTIPLEX is defined, requests to a same server are multiplexed (HTTP/2)
+     */
+    static CURLM* getCurlMultiEnv();
+
+    /**
+     * \~french \brief Fait avancer les transferts et marque les requêtes terminées
+     * \return Nombre de requêtes de la liste terminées
+     * \~english \brief Drive transfers and flag done requests
+     * \return Number of done requests in the list
+     */
+    static int harvestRequests ( CURLM* multi, std::vector<CurlRequest*>& reqs );
+
     /**
      * \~french
      * \brief Constructeur
@@ -99,23 +139,65 @@ public:
     static CURL* getCurlEnv() {
         pthread_t i = pthread_self();
 
+        pthread_mutex_lock ( &mtx );
         std::map<pthread_t, CURL*>::iterator it = pool.find ( i );
         if ( it == pool.end() ) {
             CURL* c = curl_easy_init();
             pool.insert ( std::pair<pthread_t, CURL*>(i,c) );
+            pthread_mutex_unlock ( &mtx );
             return c;
         } else {
-            curl_easy_reset(it->second);
-            return it->second;
+            CURL* c = it->second;
+            pthread_mutex_unlock ( &mtx );
+            curl_easy_reset(c);
+            return c;
         }
     }
 
+    /**
+     * \~french \brief Démarre une requête, sans attendre sa fin
+     * \details La requête est ajoutée à l'objet Curl multiple du thread appelant, qui doit ensuite l'attendre (#waitRequests)
+     * \param[in] req Requête à démarrer, dont l'objet curl est configuré
+     * \~english \brief Start a request, without waiting for its end
+     * \details Request is added to the calling thread's curl multi object, which have then to wait for it (#waitRequests)
+     * \param[in] req Request to start, whose curl object is configured
+     */
+    static void addRequest ( CurlRequest* req );
+
+    /**
+     * \~french \brief Attend la fin de requêtes démarrées par #addRequest
+     * \~english \brief Wait for requests started with #addRequest
+     */
+    static void waitRequests ( std::vector<CurlRequest*>& reqs );
+
+    /**
+     * \~french \brief Fait avancer les requêtes démarrées par #addRequest, sans attendre leur fin à toutes
+     * \details Rend la main dès qu'au moins une requête de la liste est terminée, ou au bout du délai fourni
+     * \param[in] reqs Requêtes surveillées
+     * \param[in] milliseconds Attente maximale, en millisecondes
+     * \return Nombre de requêtes de la liste terminées
+     * \~english \brief Drive requests started with #addRequest, without waiting for all of them
+     * \details Return as soon as one request of the list is done, or after the provided delay
+     * \param[in] reqs Watched requests
+     * \param[in] milliseconds Maximal waiting time, in milliseconds
+     * \return Number of done requests in the list
+     */
+    static int pollRequests ( std::vector<CurlRequest*>& reqs, int milliseconds );
+
+    /**
+     * \~french \brief Abandonne une requête démarrée par #addRequest et pas encore terminée
+     * \~english \brief Give up a request started with #addRequest and not done yet
+     */
+    static void cancelRequest ( CurlRequest* req );
+
     /**
      * \~french \brief Affiche le nombre d'objet curl dans l'annuaire
      * \~english \brief Print the number of curl objects in the book
      */
     static void printNumCurls () {
+        pthread_mutex_lock ( &mtx );
         LOGGER_INFO("Nombre de contextes curl : " << pool.size());
+        pthread_mutex_unlock ( &mtx );
     }
 
     /**
@@ -123,11 +205,18 @@ public:
      * \~english \brief Clean all curl objects in the book and empty it
      */
     static void cleanCurlPool () {
+        pthread_mutex_lock ( &mtx );
         std::map<pthread_t, CURL*>::iterator it;
         for (it = pool.begin(); it != pool.end(); ++it) {
             curl_easy_cleanup(it->second);
         }
         pool.clear();
+        std::map<pthread_t, CURLM*>::iterator itm;
+        for (itm = multiPool.begin(); itm != multiPool.end(); ++itm) {
+            curl_multi_cleanup(itm->second);
+        }
+        multiPool.clear();
+        pthread_mutex_unlock ( &mtx );
     }
 
 };
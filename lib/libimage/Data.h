@@ -43,9 +43,12 @@
 #include <string>  // pour std::string
 #include <cstring> // pour memcpy
 #include <algorithm>
+#include <time.h>
 
 #include "Logger.h"
 
+class PooledBuffer;
+
 /**
  * Interface abstraite permetant d'encapsuler une source de données.
  * La gestion mémoire des données est à la charge des classes d'implémentation.
@@ -65,6 +68,38 @@ public:
      */
     virtual const uint8_t* getData ( size_t &size ) = 0;
 
+    /**
+     * Donne accès au tampon partagé (BufferPool) contenant les données, pour les transmettre sans copie.
+     *
+     * Le tampon doit être retenu (PooledBuffer::retain) pour être utilisé après destruction de la source.
+     *
+     * @return size Taille des données en octets
+     * @return Tampon contenant les données, NULL si elles ne sont pas dans un tampon partagé
+     */
+    virtual PooledBuffer* getBuffer ( size_t &size ) {
+        return NULL;
+    }
+
+    /**
+     * Donne un identifiant de la donnée (ETag HTTP), qui change dès que la donnée change.
+     *
+     * Il doit pouvoir être obtenu sans lire la donnée.
+     *
+     * @return Identifiant, vide s'il n'est pas connu
+     */
+    virtual std::string getTag() {
+        return "";
+    }
+
+    /**
+     * Indique la date de dernière modification de la donnée (Last-Modified HTTP).
+     *
+     * @return Date, 0 si elle n'est pas connue
+     */
+    virtual time_t getModification() {
+        return 0;
+    }
+
     /**
      * Libère les données mémoire allouées.
      *
@@ -197,6 +232,15 @@ public:
     inline const uint8_t* getData ( size_t &size ) {
         return getDataSource().getData ( size );
     }
+    inline PooledBuffer* getBuffer ( size_t &size ) {
+        return getDataSource().getBuffer ( size );
+    }
+    inline std::string getTag()                 {
+        return getDataSource().getTag();
+    }
+    inline time_t getModification()             {
+        return getDataSource().getModification();
+    }
     inline bool releaseData()                   {
         return getDataSource().releaseData();
     }
@@ -0,0 +1,591 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file DownsampledImage.cpp
+ ** \~french
+ * \brief Implémentation des classes DownsampledImage, DownsampledMask et DownsampledImageFactory
+ * \details
+ * \li DownsampledImage : image sous-échantillonnée 2 pixels par 2 à partir de 4 images disposées en carré
+ * \li DownsampledMask : masque associé à une image sous-échantillonnée
+ * \li DownsampledImageFactory : usine de création d'objet DownsampledImage
+ ** \~english
+ * \brief Implement classes DownsampledImage, DownsampledMask and DownsampledImageFactory
+ * \details
+ * \li DownsampledImage : image downsampled 2 pixels by 2 from 4 images arranged in a square
+ * \li DownsampledMask : mask associated to a downsampled image
+ * \li DownsampledImageFactory : factory to create DownsampledImage object
+ */
+
+#include "DownsampledImage.h"
+#include "Logger.h"
+#include "Utils.h"
+#include <cmath>
+#include <cstring>
+
+/********************************************** Noyaux de calcul ************************************************/
+
+/*
+ * Sur 8 bits, le calcul d'une ligne se fait en plusieurs passes sur des tableaux de travail, chacune sans branchement :
+ *  1. masques étendus à chaque canal (0 ou 0xFF par valeur) et nombre de pixels de donnée par pixel de sortie
+ *  2. somme vectorielle, pour chaque valeur i des lignes sources, des valeurs i et i + channels des 2 lignes, masquées :
+ *     à l'indice 2 * x * channels + c, c'est la somme des 4 pixels sources du pixel x en sortie
+ *  3. regroupement des sommes utiles (une copie de 4 valeurs par pixel, les copies se chevauchent)
+ *  4. moyenne vectorielle par la table de gamma, écrite là où au moins 2 pixels sont de la donnée
+ * En flottant et sur 16 bits, seul le cas d'un canal (MNT) est vectorisé, en une seule passe et sans tableau de travail.
+ * Dans les autres cas, on utilise la boucle de merge4tiff.
+ */
+
+/**
+ * \~french \brief Boucle de merge4tiff, pour plus de 4 canaux et sans SSE2
+ */
+template <typename T>
+static void downsampleReference ( T* to, uint8_t* toMask, const T* from1, const T* from2, const uint8_t* mask1, const uint8_t* mask2, int width, int channels, const uint8_t* merge ) {
+    float pix[channels];
+
+    for ( int x = 0; x < width; x++ ) {
+        int pixIn = 2 * x;
+        int sampleIn = pixIn * channels;
+        int nbData = 0;
+
+        memset ( pix, 0, channels * sizeof ( float ) );
+
+        if ( mask1[pixIn] ) {
+            nbData++;
+            for ( int c = 0; c < channels; c++ ) pix[c] += from1[sampleIn + c];
+        }
+        if ( mask1[pixIn + 1] ) {
+            nbData++;
+            for ( int c = 0; c < channels; c++ ) pix[c] += from1[sampleIn + channels + c];
+        }
+        if ( mask2[pixIn] ) {
+            nbData++;
+            for ( int c = 0; c < channels; c++ ) pix[c] += from2[sampleIn + c];
+        }
+        if ( mask2[pixIn + 1] ) {
+            nbData++;
+            for ( int c = 0; c < channels; c++ ) pix[c] += from2[sampleIn + channels + c];
+        }
+
+        if ( nbData > 1 ) {
+            toMask[x] = 255;
+            if ( sizeof ( T ) == 1 ) {
+                for ( int c = 0; c < channels; c++ ) to[x * channels + c] = merge[ ( int ) pix[c] * 4 / nbData];
+            } else if ( sizeof ( T ) == 2 ) {
+                for ( int c = 0; c < channels; c++ ) to[x * channels + c] = ( T ) ( pix[c] / ( float ) nbData + 0.5 );
+            } else {
+                for ( int c = 0; c < channels; c++ ) to[x * channels + c] = pix[c] / ( float ) nbData;
+            }
+        }
+    }
+}
+
+#ifdef __SSE2__
+
+/**
+ * \~french \brief Passe 1 : masques étendus à chaque canal et nombre de pixels de donnée, étendu à chaque canal
+ * \details Les écritures de 4 octets se chevauchent : les tableaux doivent avoir 4 octets de marge
+ */
+static void expandMasks ( uint8_t* expanded1, uint8_t* expanded2, uint8_t* number, uint8_t* toMask,
+                          const uint8_t* mask1, const uint8_t* mask2, int width, int channels ) {
+    for ( int p = 0; p < 2 * width; p++ ) {
+        uint32_t v1 = mask1[p] ? 0xFFFFFFFF : 0;
+        uint32_t v2 = mask2[p] ? 0xFFFFFFFF : 0;
+        memcpy ( expanded1 + p * channels, &v1, 4 );
+        memcpy ( expanded2 + p * channels, &v2, 4 );
+    }
+    for ( int x = 0; x < width; x++ ) {
+        uint32_t nb = ( mask1[2 * x] != 0 ) + ( mask1[2 * x + 1] != 0 ) + ( mask2[2 * x] != 0 ) + ( mask2[2 * x + 1] != 0 );
+        if ( nb > 1 ) toMask[x] = 255;
+        nb *= 0x01010101;
+        memcpy ( number + x * channels, &nb, 4 );
+    }
+}
+
+/**
+ * \~french \brief Passe 2 : sommes des 4 valeurs masquées, sur 16 bits
+ * \return nombre de valeurs traitées
+ */
+static int sumSSE2 ( uint16_t* to, const uint8_t* from1, const uint8_t* from2, const uint8_t* expanded1, const uint8_t* expanded2, int length, int shift ) {
+    if ( Simd::getLevel() >= Simd::AVX2 ) return avx2_downsample_sum ( to, from1, from2, expanded1, expanded2, length, shift );
+
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m128i a = _mm_and_si128 ( _mm_loadu_si128 ( ( const __m128i* ) ( from1 + i ) ), _mm_loadu_si128 ( ( const __m128i* ) ( expanded1 + i ) ) );
+        __m128i b = _mm_and_si128 ( _mm_loadu_si128 ( ( const __m128i* ) ( from1 + i + shift ) ), _mm_loadu_si128 ( ( const __m128i* ) ( expanded1 + i + shift ) ) );
+        __m128i c = _mm_and_si128 ( _mm_loadu_si128 ( ( const __m128i* ) ( from2 + i ) ), _mm_loadu_si128 ( ( const __m128i* ) ( expanded2 + i ) ) );
+        __m128i d = _mm_and_si128 ( _mm_loadu_si128 ( ( const __m128i* ) ( from2 + i + shift ) ), _mm_loadu_si128 ( ( const __m128i* ) ( expanded2 + i + shift ) ) );
+        __m128i lo = _mm_add_epi16 ( _mm_add_epi16 ( _mm_unpacklo_epi8 ( a, zero ), _mm_unpacklo_epi8 ( b, zero ) ),
+                                     _mm_add_epi16 ( _mm_unpacklo_epi8 ( c, zero ), _mm_unpacklo_epi8 ( d, zero ) ) );
+        __m128i hi = _mm_add_epi16 ( _mm_add_epi16 ( _mm_unpackhi_epi8 ( a, zero ), _mm_unpackhi_epi8 ( b, zero ) ),
+                                     _mm_add_epi16 ( _mm_unpackhi_epi8 ( c, zero ), _mm_unpackhi_epi8 ( d, zero ) ) );
+        _mm_storeu_si128 ( ( __m128i* ) ( to + i ), lo );
+        _mm_storeu_si128 ( ( __m128i* ) ( to + i + 8 ), hi );
+    }
+    return i;
+}
+
+/**
+ * \~french \brief Passe 4 : indice dans la table de gamma puis valeur, là où au moins 2 pixels sont de la donnée
+ * \details L'indice vaut somme * 4 / nombre. Pour 3 pixels, la division entière par 3 est une multiplication par 0xAAAB suivie d'un décalage de 17 bits, exacte sur 16 bits.
+ */
+static void meanSSE2 ( uint8_t* to, const uint16_t* sum, const uint8_t* number, const uint8_t* merge, int length ) {
+    int i = 0;
+    if ( Simd::getLevel() >= Simd::AVX2 ) i = avx2_downsample_mean ( to, sum, number, merge, length );
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16 ( 2 );
+    const __m128i three = _mm_set1_epi16 ( 3 );
+    const __m128i third = _mm_set1_epi16 ( ( short ) 0xAAAB );
+    uint16_t index[8];
+
+    for ( ; i + 8 <= length; i += 8 ) {
+        __m128i s = _mm_loadu_si128 ( ( const __m128i* ) ( sum + i ) );
+        __m128i n = _mm_unpacklo_epi8 ( _mm_loadl_epi64 ( ( const __m128i* ) ( number + i ) ), zero );
+        __m128i is2 = _mm_cmpeq_epi16 ( n, two );
+        __m128i is3 = _mm_cmpeq_epi16 ( n, three );
+        __m128i s3 = _mm_srli_epi16 ( _mm_mulhi_epu16 ( _mm_slli_epi16 ( s, 2 ), third ), 1 );
+        __m128i k = _mm_or_si128 ( _mm_andnot_si128 ( _mm_or_si128 ( is2, is3 ), s ),
+                                   _mm_or_si128 ( _mm_and_si128 ( is2, _mm_slli_epi16 ( s, 1 ) ), _mm_and_si128 ( is3, s3 ) ) );
+        _mm_storeu_si128 ( ( __m128i* ) index, k );
+        for ( int j = 0; j < 8; j++ ) {
+            if ( number[i + j] > 1 ) to[i + j] = merge[index[j]];
+        }
+    }
+    for ( ; i < length; i++ ) {
+        if ( number[i] > 1 ) to[i] = merge[sum[i] * 4 / number[i]];
+    }
+}
+
+/**
+ * \~french \brief Sous-échantillonnage vectorisé sur 8 bits, pour 4 canaux au plus
+ */
+static void downsampleSSE2 ( uint8_t* to, uint8_t* toMask, const uint8_t* from1, const uint8_t* from2, const uint8_t* mask1, const uint8_t* mask2, int width, int channels, const uint8_t* merge ) {
+    int length = 2 * width * channels;
+    int outLength = width * channels;
+
+    // Un seul bloc de travail : masques étendus, nombres, sommes et sommes regroupées, avec marges
+    size_t masksSize = ( size_t ) 2 * ( length + 4 ) + outLength + 4;
+    size_t sumsSize = ( size_t ) ( length + 4 ) + ( outLength + 4 );
+    uint8_t* work = new uint8_t[masksSize + sumsSize * sizeof ( uint16_t ) + 16];
+    uint8_t* expanded1 = work;
+    uint8_t* expanded2 = expanded1 + length + 4;
+    uint8_t* number = expanded2 + length + 4;
+    uint16_t* sums = ( uint16_t* ) ( ( ( uintptr_t ) ( number + outLength + 4 ) + 15 ) & ~ ( uintptr_t ) 15 );
+    uint16_t* grouped = sums + length + 4;
+
+    expandMasks ( expanded1, expanded2, number, toMask, mask1, mask2, width, channels );
+
+    // Sommes utiles : jusqu'à l'indice 2 * ( width - 1 ) * channels + channels - 1 = length - channels - 1
+    int useful = length - channels;
+    int i = sumSSE2 ( sums, from1, from2, expanded1, expanded2, useful, channels );
+    for ( ; i < useful; i++ ) {
+        sums[i] = ( expanded1[i] & from1[i] ) + ( expanded1[i + channels] & from1[i + channels] ) +
+                  ( expanded2[i] & from2[i] ) + ( expanded2[i + channels] & from2[i + channels] );
+    }
+
+    for ( int x = 0; x < width; x++ ) {
+        memcpy ( grouped + x * channels, sums + 2 * x * channels, 4 * sizeof ( uint16_t ) );
+    }
+
+    meanSSE2 ( to, grouped, number, merge, outLength );
+
+    delete[] work;
+}
+
+/**
+ * \~french \brief Sous-échantillonnage vectorisé en flottant, pour un canal
+ * \details On traite 4 pixels en sortie à la fois : les pixels de gauche et de droite sont séparés par des mélanges, les masques sont étendus à 32 bits. La somme se fait dans l'ordre de merge4tiff en partant de 0, pour avoir le même résultat, y compris le signe d'une somme nulle.
+ */
+static void downsampleSSE2 ( float* to, uint8_t* toMask, const float* from1, const float* from2, const uint8_t* mask1, const uint8_t* mask2, int width ) {
+    int x = 0;
+    if ( Simd::getLevel() >= Simd::AVX2 ) x = avx2_downsample ( to, toMask, from1, from2, mask1, mask2, width );
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i four = _mm_set1_epi32 ( 4 );
+    const __m128i one = _mm_set1_epi32 ( 1 );
+
+    for ( ; x + 4 <= width; x += 4 ) {
+        __m128 a = _mm_loadu_ps ( from1 + 2 * x );
+        __m128 b = _mm_loadu_ps ( from1 + 2 * x + 4 );
+        __m128 l1 = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 2, 0, 2, 0 ) );
+        __m128 r1 = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 3, 1, 3, 1 ) );
+        a = _mm_loadu_ps ( from2 + 2 * x );
+        b = _mm_loadu_ps ( from2 + 2 * x + 4 );
+        __m128 l2 = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 2, 0, 2, 0 ) );
+        __m128 r2 = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 3, 1, 3, 1 ) );
+
+        // Masques de non-donnée, sur 32 bits
+        __m128i m = _mm_cmpeq_epi8 ( _mm_loadl_epi64 ( ( const __m128i* ) ( mask1 + 2 * x ) ), zero );
+        m = _mm_unpacklo_epi8 ( m, m );
+        a = _mm_castsi128_ps ( _mm_unpacklo_epi16 ( m, m ) );
+        b = _mm_castsi128_ps ( _mm_unpackhi_epi16 ( m, m ) );
+        __m128 ml1 = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 2, 0, 2, 0 ) );
+        __m128 mr1 = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 3, 1, 3, 1 ) );
+        m = _mm_cmpeq_epi8 ( _mm_loadl_epi64 ( ( const __m128i* ) ( mask2 + 2 * x ) ), zero );
+        m = _mm_unpacklo_epi8 ( m, m );
+        a = _mm_castsi128_ps ( _mm_unpacklo_epi16 ( m, m ) );
+        b = _mm_castsi128_ps ( _mm_unpackhi_epi16 ( m, m ) );
+        __m128 ml2 = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 2, 0, 2, 0 ) );
+        __m128 mr2 = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 3, 1, 3, 1 ) );
+
+        __m128 s = _mm_add_ps ( _mm_setzero_ps(), _mm_andnot_ps ( ml1, l1 ) );
+        s = _mm_add_ps ( s, _mm_andnot_ps ( mr1, r1 ) );
+        s = _mm_add_ps ( s, _mm_andnot_ps ( ml2, l2 ) );
+        s = _mm_add_ps ( s, _mm_andnot_ps ( mr2, r2 ) );
+
+        // Un masque de non-donnée vaut -1 en entier
+        __m128i nb = _mm_add_epi32 ( _mm_add_epi32 ( _mm_castps_si128 ( ml1 ), _mm_castps_si128 ( mr1 ) ),
+                                     _mm_add_epi32 ( _mm_castps_si128 ( ml2 ), _mm_castps_si128 ( mr2 ) ) );
+        nb = _mm_add_epi32 ( nb, four );
+        __m128i keep = _mm_cmpgt_epi32 ( nb, one );
+        __m128 mean = _mm_div_ps ( s, _mm_cvtepi32_ps ( nb ) );
+        __m128 k = _mm_castsi128_ps ( keep );
+        _mm_storeu_ps ( to + x, _mm_or_ps ( _mm_and_ps ( k, mean ), _mm_andnot_ps ( k, _mm_loadu_ps ( to + x ) ) ) );
+
+        keep = _mm_packs_epi32 ( keep, keep );
+        keep = _mm_packs_epi16 ( keep, keep );
+        int tm;
+        memcpy ( &tm, toMask + x, 4 );
+        tm |= _mm_cvtsi128_si32 ( keep );
+        memcpy ( toMask + x, &tm, 4 );
+    }
+
+    if ( x < width ) downsampleReference ( to + x, toMask + x, from1 + 2 * x, from2 + 2 * x, mask1 + 2 * x, mask2 + 2 * x, width - x, 1, ( const uint8_t* ) NULL );
+}
+
+/**
+ * \~french \brief Sous-échantillonnage vectorisé sur 16 bits, pour un canal
+ * \details On traite 4 pixels en sortie à la fois : les valeurs de non-donnée sont annulées sur 16 bits, puis les pixels de gauche et de droite sont séparés sur 32 bits et sommés exactement en entier. La moyenne arrondie est calculée en flottant comme dans la boucle de référence (la somme est exacte, et la division par 3 ne tombe jamais sur une demi-unité).
+ */
+static void downsampleSSE2 ( uint16_t* to, uint8_t* toMask, const uint16_t* from1, const uint16_t* from2, const uint8_t* mask1, const uint8_t* mask2, int width ) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i low = _mm_set1_epi32 ( 0xFFFF );
+    const __m128i ones = _mm_set1_epi16 ( 1 );
+    const __m128i four = _mm_set1_epi32 ( 4 );
+    const __m128i one = _mm_set1_epi32 ( 1 );
+    const __m128i offset = _mm_set1_epi32 ( 32768 );
+    const __m128i sign = _mm_set1_epi16 ( ( short ) 0x8000 );
+    const __m128 half = _mm_set1_ps ( 0.5f );
+
+    int x = 0;
+    for ( ; x + 4 <= width; x += 4 ) {
+        // Masques de non-donnée, sur 16 bits (-1 pour la non-donnée)
+        __m128i m1 = _mm_cmpeq_epi8 ( _mm_loadl_epi64 ( ( const __m128i* ) ( mask1 + 2 * x ) ), zero );
+        m1 = _mm_unpacklo_epi8 ( m1, m1 );
+        __m128i m2 = _mm_cmpeq_epi8 ( _mm_loadl_epi64 ( ( const __m128i* ) ( mask2 + 2 * x ) ), zero );
+        m2 = _mm_unpacklo_epi8 ( m2, m2 );
+
+        __m128i a = _mm_andnot_si128 ( m1, _mm_loadu_si128 ( ( const __m128i* ) ( from1 + 2 * x ) ) );
+        __m128i b = _mm_andnot_si128 ( m2, _mm_loadu_si128 ( ( const __m128i* ) ( from2 + 2 * x ) ) );
+        __m128i s = _mm_add_epi32 ( _mm_add_epi32 ( _mm_and_si128 ( a, low ), _mm_srli_epi32 ( a, 16 ) ),
+                                    _mm_add_epi32 ( _mm_and_si128 ( b, low ), _mm_srli_epi32 ( b, 16 ) ) );
+
+        // Nombre de pixels de donnée : 4 moins les non-données, sommées par paires
+        __m128i nb = _mm_add_epi32 ( four, _mm_add_epi32 ( _mm_madd_epi16 ( m1, ones ), _mm_madd_epi16 ( m2, ones ) ) );
+        __m128i keep = _mm_cmpgt_epi32 ( nb, one );
+
+        __m128i mean = _mm_cvttps_epi32 ( _mm_add_ps ( _mm_div_ps ( _mm_cvtepi32_ps ( s ), _mm_cvtepi32_ps ( nb ) ), half ) );
+        mean = _mm_and_si128 ( keep, mean );
+        // Pas de saturation non signée 32 -> 16 bits en SSE2 : on décale dans l'intervalle signé
+        mean = _mm_xor_si128 ( _mm_packs_epi32 ( _mm_sub_epi32 ( mean, offset ), zero ), sign );
+
+        __m128i keep16 = _mm_packs_epi32 ( keep, keep );
+        __m128i old = _mm_loadl_epi64 ( ( const __m128i* ) ( to + x ) );
+        _mm_storel_epi64 ( ( __m128i* ) ( to + x ), _mm_or_si128 ( _mm_and_si128 ( keep16, mean ), _mm_andnot_si128 ( keep16, old ) ) );
+
+        keep = _mm_packs_epi16 ( keep16, keep16 );
+        int tm;
+        memcpy ( &tm, toMask + x, 4 );
+        tm |= _mm_cvtsi128_si32 ( keep );
+        memcpy ( toMask + x, &tm, 4 );
+    }
+
+    if ( x < width ) downsampleReference ( to + x, toMask + x, from1 + 2 * x, from2 + 2 * x, mask1 + 2 * x, mask2 + 2 * x, width - x, 1, ( const uint8_t* ) NULL );
+}
+
+#endif
+
+void downsample ( uint8_t* to, uint8_t* toMask, const uint8_t* from1, const uint8_t* from2, const uint8_t* mask1, const uint8_t* mask2, int width, int channels, const uint8_t* merge ) {
+#ifdef __SSE2__
+    if ( channels <= 4 ) return downsampleSSE2 ( to, toMask, from1, from2, mask1, mask2, width, channels, merge );
+#endif
+    downsampleReference ( to, toMask, from1, from2, mask1, mask2, width, channels, merge );
+}
+
+void downsample ( float* to, uint8_t* toMask, const float* from1, const float* from2, const uint8_t* mask1, const uint8_t* mask2, int width, int channels, const uint8_t* merge ) {
+#ifdef __SSE2__
+    if ( channels == 1 ) return downsampleSSE2 ( to, toMask, from1, from2, mask1, mask2, width );
+#endif
+    downsampleReference ( to, toMask, from1, from2, mask1, mask2, width, channels, merge );
+}
+
+void downsample ( uint16_t* to, uint8_t* toMask, const uint16_t* from1, const uint16_t* from2, const uint8_t* mask1, const uint8_t* mask2, int width, int channels, const uint8_t* merge ) {
+#ifdef __SSE2__
+    if ( channels == 1 ) return downsampleSSE2 ( to, toMask, from1, from2, mask1, mask2, width );
+#endif
+    downsampleReference ( to, toMask, from1, from2, mask1, mask2, width, channels, merge );
+}
+
+/********************************************** DownsampledImage ************************************************/
+
+void DownsampledImage::fillMergeTable ( uint8_t* merge, double gamma ) {
+    for ( int i = 0; i <= 1020; i++ ) merge[i] = 255 - ( uint8_t ) round ( pow ( double ( 1020 - i ) / 1020., gamma ) * 255. );
+    for ( int i = 1021; i < 1024; i++ ) merge[i] = 255;
+}
+
+DownsampledImage::DownsampledImage ( int width, int height, int channels, Image* images[4], Image* bg, int* nd, double gamma ) :
+    Image ( width, height, channels ), background ( bg ), memorizedMaskLine ( -1 ) {
+
+    for ( int i = 0; i < 4; i++ ) sourceImages[i] = images[i];
+
+    nodata = new int[channels];
+    memcpy ( nodata, nd, channels * sizeof ( int ) );
+
+    fillMergeTable ( merge, gamma );
+
+    sourceLines = new uint8_t[4 * width * channels * sizeof ( float )];
+    sourceMasks = new uint8_t[4 * width];
+    maskLine = new uint8_t[width];
+}
+
+bool DownsampledImage::readMasks ( int line ) {
+    int half = height / 2;
+    int y = line / half;
+    int h = line % half;
+
+    for ( int x = 0; x < 2; x++ ) {
+        Image* source = sourceImages[2 * y + x];
+        for ( int r = 0; r < 2; r++ ) {
+            uint8_t* m = sourceMasks + r * 2 * width + x * width;
+            if ( source == NULL ) {
+                memset ( m, 0, width );
+            } else if ( source->getMask() == NULL ) {
+                memset ( m, 255, width );
+            } else if ( source->getMask()->getline ( m, 2 * h + r ) == 0 ) {
+                LOGGER_ERROR ( "Cannot read source mask line " << 2 * h + r );
+                return false;
+            }
+        }
+    }
+
+    if ( background != NULL && background->getMask() != NULL ) {
+        if ( background->getMask()->getline ( maskLine, line ) == 0 ) {
+            LOGGER_ERROR ( "Cannot read background mask line " << line );
+            return false;
+        }
+    } else {
+        memset ( maskLine, background != NULL ? 255 : 0, width );
+    }
+
+    return true;
+}
+
+bool DownsampledImage::computeMaskLine ( int line ) {
+    if ( ! readMasks ( line ) ) return false;
+
+    const uint8_t* m1 = sourceMasks;
+    const uint8_t* m2 = sourceMasks + 2 * width;
+    for ( int x = 0; x < width; x++ ) {
+        int nb = ( m1[2 * x] != 0 ) + ( m1[2 * x + 1] != 0 ) + ( m2[2 * x] != 0 ) + ( m2[2 * x + 1] != 0 );
+        if ( nb > 1 ) maskLine[x] = 255;
+    }
+
+    memorizedMaskLine = line;
+    return true;
+}
+
+template <typename T>
+int DownsampledImage::_getline ( T* buffer, int line ) {
+
+    memorizedMaskLine = -1;
+
+    if ( ! readMasks ( line ) ) return 0;
+
+    // ------------------- le fond ------------------
+    if ( background != NULL ) {
+        if ( background->getline ( buffer, line ) == 0 ) {
+            LOGGER_ERROR ( "Cannot read background line " << line );
+            return 0;
+        }
+        for ( int x = 0; x < width; x++ ) {
+            if ( maskLine[x] == 0 ) {
+                for ( int c = 0; c < channels; c++ ) buffer[x * channels + c] = ( T ) nodata[c];
+            }
+        }
+    } else {
+        for ( int i = 0; i < width * channels; i++ ) buffer[i] = ( T ) nodata[i % channels];
+    }
+
+    // ------------------ les sources ---------------
+    int half = height / 2;
+    int y = line / half;
+    int h = line % half;
+    T* line1 = ( T* ) sourceLines;
+    T* line2 = line1 + 2 * width * channels;
+
+    for ( int x = 0; x < 2; x++ ) {
+        Image* source = sourceImages[2 * y + x];
+        for ( int r = 0; r < 2; r++ ) {
+            T* l = ( r == 0 ? line1 : line2 ) + x * width * channels;
+            if ( source == NULL ) {
+                memset ( l, 0, width * channels * sizeof ( T ) );
+            } else if ( source->getline ( l, 2 * h + r ) == 0 ) {
+                LOGGER_ERROR ( "Cannot read source line " << 2 * h + r );
+                return 0;
+            }
+        }
+    }
+
+    downsample ( buffer, maskLine, line1, line2, sourceMasks, sourceMasks + 2 * width, width, channels, merge );
+
+    memorizedMaskLine = line;
+    return width * channels;
+}
+
+/* Implementation de getline pour les uint8_t */
+int DownsampledImage::getline ( uint8_t* buffer, int line ) {
+    return _getline ( buffer, line );
+}
+
+/* Implementation de getline pour les uint16_t */
+int DownsampledImage::getline ( uint16_t* buffer, int line ) {
+    return _getline ( buffer, line );
+}
+
+/* Implementation de getline pour les float */
+int DownsampledImage::getline ( float* buffer, int line ) {
+    return _getline ( buffer, line );
+}
+
+/********************************************** DownsampledMask ************************************************/
+
+int DownsampledMask::getline ( uint8_t* buffer, int line ) {
+    // La ligne de masque est déjà calculée si on vient de lire la même ligne de l'image
+    if ( DI->memorizedMaskLine != line && ! DI->computeMaskLine ( line ) ) return 0;
+    memcpy ( buffer, DI->maskLine, width );
+    return width;
+}
+
+/* Implementation de getline pour les uint16_t */
+int DownsampledMask::getline ( uint16_t* buffer, int line ) {
+    uint8_t* buffer_t = new uint8_t[width*channels];
+    int ret = getline ( buffer_t,line );
+    convert ( buffer,buffer_t,width*channels );
+    delete [] buffer_t;
+    return ret;
+}
+
+/* Implementation de getline pour les float */
+int DownsampledMask::getline ( float* buffer, int line ) {
+    uint8_t* buffer_t = new uint8_t[width*channels];
+    int ret = getline ( buffer_t,line );
+    convert ( buffer,buffer_t,width*channels );
+    delete [] buffer_t;
+    return ret;
+}
+
+/********************************************** DownsampledImageFactory ************************************************/
+
+DownsampledImage* DownsampledImageFactory::createDownsampledImage ( Image* images[4], Image* background, int* nodata, double gamma ) {
+
+    Image* reference = background;
+    int position = -1;
+    for ( int i = 3; i >= 0; i-- ) {
+        if ( images[i] != NULL ) {
+            reference = images[i];
+            position = i;
+        }
+    }
+
+    if ( reference == NULL ) {
+        LOGGER_ERROR ( "No source image and no background to downsample" );
+        return NULL;
+    }
+
+    int width = reference->getWidth();
+    int height = reference->getHeight();
+    int channels = reference->getChannels();
+
+    if ( width % 2 != 0 || height % 2 != 0 ) {
+        LOGGER_ERROR ( "Downsampled images have to own even dimensions : " << width << " x " << height );
+        return NULL;
+    }
+
+    for ( int i = 0; i < 5; i++ ) {
+        Image* image = ( i < 4 ) ? images[i] : background;
+        if ( image == NULL ) continue;
+        if ( image->getWidth() != width || image->getHeight() != height || image->getChannels() != channels ) {
+            LOGGER_ERROR ( "All images to downsample have to own the same dimensions and samples number" );
+            return NULL;
+        }
+        if ( image->getMask() != NULL && ( image->getMask()->getWidth() != width || image->getMask()->getHeight() != height ) ) {
+            LOGGER_ERROR ( "Masks have to own images' dimensions" );
+            return NULL;
+        }
+    }
+
+    if ( gamma <= 0. ) {
+        LOGGER_ERROR ( "Gamma have to be positive : " << gamma );
+        return NULL;
+    }
+
+    DownsampledImage* DI = new DownsampledImage ( width, height, channels, images, background, nodata, gamma );
+
+    // Géoréférencement déduit de celui d'une source : résolution doublée
+    if ( position >= 0 ) {
+        double resx = 2. * reference->getResX();
+        double resy = 2. * reference->getResY();
+        double xmin = reference->getXmin() - ( position % 2 ) * width * reference->getResX();
+        double ymax = reference->getYmax() + ( position / 2 ) * height * reference->getResY();
+        DI->setDimensions ( width, height, BoundingBox<double> ( xmin, ymax - height * resy, xmin + width * resx, ymax ), resx, resy );
+    } else {
+        DI->setDimensions ( width, height, reference->getBbox(), reference->getResX(), reference->getResY() );
+    }
+    DI->setCRS ( reference->getCRS() );
+
+    DownsampledMask* DM = new DownsampledMask ( DI );
+    if ( ! DI->setMask ( DM ) ) {
+        LOGGER_ERROR ( "Cannot add mask to the downsampled image" );
+        delete DM;
+        delete DI;
+        return NULL;
+    }
+
+    return DI;
+}
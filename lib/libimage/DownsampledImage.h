@@ -0,0 +1,360 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file DownsampledImage.h
+ ** \~french
+ * \brief Définition des classes DownsampledImage, DownsampledMask et DownsampledImageFactory
+ * \details
+ * \li DownsampledImage : image sous-échantillonnée 2 pixels par 2 à partir de 4 images disposées en carré
+ * \li DownsampledMask : masque associé à une image sous-échantillonnée
+ * \li DownsampledImageFactory : usine de création d'objet DownsampledImage
+ ** \~english
+ * \brief Define classes DownsampledImage, DownsampledMask and DownsampledImageFactory
+ * \details
+ * \li DownsampledImage : image downsampled 2 pixels by 2 from 4 images arranged in a square
+ * \li DownsampledMask : mask associated to a downsampled image
+ * \li DownsampledImageFactory : factory to create DownsampledImage object
+ */
+
+#ifndef DOWNSAMPLED_IMAGE_H
+#define DOWNSAMPLED_IMAGE_H
+
+#include <stdint.h>
+#include "Logger.h"
+#include "Image.h"
+
+/**
+ * \~french
+ * \brief Sous-échantillonne 2 lignes 2 pixels par 2, comme merge4tiff
+ * \details Chaque pixel en sortie est la moyenne des pixels de donnée (masque non nul) parmi les 4 pixels sources correspondants. S'il y a moins de 2 pixels de donnée, le pixel en sortie, et son masque, ne sont pas modifiés : la sortie contient le fond en entrée.
+ *
+ * \li entier 8 bits : la moyenne passe par la table de gamma merge, indexée par somme * 4 / nombre de pixels de donnée
+ * \li flottant : somme dans l'ordre (haut gauche, haut droite, bas gauche, bas droite), divisée par le nombre de pixels de donnée
+ * \li entier 16 bits : comme en flottant, arrondi au plus proche
+ *
+ * Le calcul est vectorisé (SSE2, AVX2 quand il est disponible) pour 4 canaux au plus, et donne exactement le résultat de la boucle de merge4tiff.
+ * \param[in,out] to ligne de sortie, de width pixels, contenant le fond
+ * \param[in,out] toMask masque de la ligne de sortie, contenant le masque du fond
+ * \param[in] from1 première ligne source, de 2 * width pixels
+ * \param[in] from2 seconde ligne source, de 2 * width pixels
+ * \param[in] mask1 masque de la première ligne source
+ * \param[in] mask2 masque de la seconde ligne source
+ * \param[in] width largeur de la ligne de sortie, en pixel
+ * \param[in] channels nombre de canaux
+ * \param[in] merge table de gamma de 1024 valeurs (cf DownsampledImage::fillMergeTable), utilisée uniquement sur 8 bits
+ * \~english
+ * \brief Downsample 2 lines 2 pixels by 2, like merge4tiff
+ * \details Each output pixel is the average of data pixels (not null mask) among the 4 matching source pixels. If there are less than 2 data pixels, output pixel, and its mask, are not modified : output contains the input background.
+ *
+ * \li 8-bit integer : average goes through the gamma table merge, indexed by sum * 4 / data pixels number
+ * \li float : sum in the order (top left, top right, bottom left, bottom right), divided by the data pixels number
+ * \li 16-bit integer : like float, rounded to nearest
+ *
+ * Computing is vectorized (SSE2, AVX2 when available) for 4 channels at most, and gives exactly the merge4tiff loop's result.
+ */
+void downsample ( uint8_t* to, uint8_t* toMask, const uint8_t* from1, const uint8_t* from2, const uint8_t* mask1, const uint8_t* mask2, int width, int channels, const uint8_t* merge );
+void downsample ( uint16_t* to, uint8_t* toMask, const uint16_t* from1, const uint16_t* from2, const uint8_t* mask1, const uint8_t* mask2, int width, int channels, const uint8_t* merge );
+void downsample ( float* to, uint8_t* toMask, const float* from1, const float* from2, const uint8_t* mask1, const uint8_t* mask2, int width, int channels, const uint8_t* merge );
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Image sous-échantillonnée 2 pixels par 2 à partir de 4 images disposées en carré
+ * \details C'est le calcul de merge4tiff, sous forme d'image : les 4 images sources ont les dimensions de l'image finale, et sont disposées ainsi
+ * \code
+ * image 0 | image 1
+ * --------+--------
+ * image 2 | image 3
+ * \endcode
+ * Une image source peut être absente. Une image de fond peut être fournie : elle est conservée là où les sources n'apportent pas assez de donnée (moins de 2 pixels sur 4). Sans fond, on a la valeur de non-donnée.
+ *
+ * Le masque associé est une DownsampledMask : une ligne de masque demandée juste après la même ligne de l'image n'est pas recalculée.
+ * \~english
+ * \brief Image downsampled 2 pixels by 2 from 4 images arranged in a square
+ * \details It's the merge4tiff computing, as an image : the 4 source images own final image's dimensions, and are arranged like this
+ * \code
+ * image 0 | image 1
+ * --------+--------
+ * image 2 | image 3
+ * \endcode
+ * A source image can be missing. A background image can be provided : it is kept where sources don't bring enough data (less than 2 pixels out of 4). Without background, we have the nodata value.
+ *
+ * Associated mask is a DownsampledMask : a mask line asked just after the same image line is not computed again.
+ */
+class DownsampledImage : public Image {
+
+    friend class DownsampledImageFactory;
+    friend class DownsampledMask;
+
+private:
+
+    /**
+     * \~french \brief Images sources, NULL si absente
+     * \~english \brief Source images, NULL if missing
+     */
+    Image* sourceImages[4];
+
+    /**
+     * \~french \brief Image de fond, NULL si aucune
+     * \~english \brief Background image, NULL if none
+     */
+    Image* background;
+
+    /**
+     * \~french \brief Valeur de non-donnée, une par canal
+     * \~english \brief Nodata value, one per sample
+     */
+    int* nodata;
+
+    /**
+     * \~french \brief Table de gamma, pour les canaux entiers sur 8 bits
+     * \~english \brief Gamma table, for 8-bit integer samples
+     */
+    uint8_t merge[1024];
+
+    /**
+     * \~french \brief Lignes sources (2 lignes de 2 * width pixels, au format demandé)
+     * \~english \brief Source lines (2 lines of 2 * width pixels, with asked format)
+     */
+    uint8_t* sourceLines;
+
+    /**
+     * \~french \brief Masques des lignes sources
+     * \~english \brief Source lines' masks
+     */
+    uint8_t* sourceMasks;
+
+    /**
+     * \~french \brief Dernière ligne de masque calculée
+     * \~english \brief Last computed mask line
+     */
+    uint8_t* maskLine;
+
+    /**
+     * \~french \brief Indice de la ligne contenue dans #maskLine, -1 si aucune
+     * \~english \brief Index of the line in #maskLine, -1 if none
+     */
+    int memorizedMaskLine;
+
+    /**
+     * \~french \brief Lit les masques des 2 lignes sources et le masque du fond
+     * \param[in] line ligne de l'image sous-échantillonnée
+     * \return VRAI en cas de succès, FAUX sinon
+     * \~english \brief Read the 2 source lines' masks and the background mask
+     */
+    bool readMasks ( int line );
+
+    /** \~french
+     * \brief Retourne une ligne, flottante ou entière
+     * \param[in] buffer Tableau contenant au moins width*channels valeurs
+     * \param[in] line Indice de la ligne à retourner (0 <= line < height)
+     * \return taille utile du buffer, 0 si erreur
+     */
+    template<typename T>
+    int _getline ( T* buffer, int line );
+
+    /** \~french
+     * \brief Calcule une ligne du masque
+     * \details Seuls les masques sont lus
+     * \param[in] line Indice de la ligne
+     * \return VRAI en cas de succès, FAUX sinon
+     */
+    bool computeMaskLine ( int line );
+
+protected:
+
+    /** \~french
+     * \brief Crée un objet DownsampledImage à partir de tous ses éléments constitutifs
+     * \details Ce constructeur est protégé afin de n'être appelé que par l'usine DownsampledImageFactory, qui fera différents tests.
+     * \param[in] width largeur de l'image en pixel
+     * \param[in] height hauteur de l'image en pixel
+     * \param[in] channels nombre de canaux par pixel
+     * \param[in] images images sources, dans l'ordre haut gauche, haut droite, bas gauche, bas droite
+     * \param[in] bg image de fond, NULL si aucune
+     * \param[in] nd valeur de non-donnée
+     * \param[in] gamma gamma de la moyenne des canaux entiers sur 8 bits
+     ** \~english
+     * \brief Create a DownsampledImage object, from all attributes
+     * \param[in] width image width, in pixel
+     * \param[in] height image height, in pixel
+     * \param[in] channels number of samples per pixel
+     * \param[in] images source images, in order top left, top right, bottom left, bottom right
+     * \param[in] bg background image, NULL if none
+     * \param[in] nd nodata value
+     * \param[in] gamma gamma for the 8-bit integer samples' average
+     */
+    DownsampledImage ( int width, int height, int channels, Image* images[4], Image* bg, int* nd, double gamma );
+
+public:
+
+    /**
+     * \~french
+     * \brief Remplit la table de gamma de merge4tiff
+     * \details merge[i] = 255 - arrondi ( ( ( 1020 - i ) / 1020 ) ^ gamma * 255 ), pour i de 0 à 1020
+     * \~english
+     * \brief Fill merge4tiff gamma table
+     */
+    static void fillMergeTable ( uint8_t* merge, double gamma );
+
+    /**
+     * \~french \brief Retourne une image source
+     * \param[in] i position, de 0 (haut gauche) à 3 (bas droite)
+     * \~english \brief Return a source image
+     */
+    Image* getSourceImage ( int i ) {
+        return sourceImages[i];
+    }
+
+    int getline ( uint8_t* buffer, int line );
+    int getline ( uint16_t* buffer, int line );
+    int getline ( float* buffer, int line );
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \details Suppression des images sources et du fond
+     * \~english
+     * \brief Destructor
+     * \details Delete source images and background
+     */
+    virtual ~DownsampledImage() {
+        delete[] nodata;
+        delete[] sourceLines;
+        delete[] sourceMasks;
+        delete[] maskLine;
+        if ( ! isMask ) {
+            for ( int i = 0; i < 4; i++ ) delete sourceImages[i];
+            delete background;
+        }
+    }
+
+    /** \~french
+     * \brief Sortie des informations sur l'image sous-échantillonnée
+     ** \~english
+     * \brief Downsampled image description output
+     */
+    void print() {
+        LOGGER_INFO ( "" );
+        LOGGER_INFO ( "------ DownsampledImage -------" );
+        Image::print();
+        LOGGER_INFO ( "\t- Source images : " << ( sourceImages[0] != NULL ) << ( sourceImages[1] != NULL ) << ( sourceImages[2] != NULL ) << ( sourceImages[3] != NULL ) );
+        LOGGER_INFO ( "\t- With background : " << ( background != NULL ) );
+        LOGGER_INFO ( "" );
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Masque d'une image sous-échantillonnée
+ * \details Un pixel est de la donnée si au moins 2 des 4 pixels sources correspondants en sont, ou si le fond en est.
+ * \~english
+ * \brief Downsampled image's mask
+ * \details A pixel is data if at least 2 of the 4 matching source pixels are, or if the background is.
+ */
+class DownsampledMask : public Image {
+
+private:
+
+    /**
+     * \~french \brief Image sous-échantillonnée associée
+     * \~english \brief Associated downsampled image
+     */
+    DownsampledImage* DI;
+
+public:
+
+    /** \~french
+     * \brief Crée le masque d'une image sous-échantillonnée
+     * \param[in] DI image sous-échantillonnée
+     ** \~english
+     * \brief Create the mask of a downsampled image
+     * \param[in] DI downsampled image
+     */
+    DownsampledMask ( DownsampledImage* DI ) :
+        Image ( DI->getWidth(), DI->getHeight(), 1, DI->getResX(), DI->getResY(), DI->getBbox() ), DI ( DI ) {}
+
+    int getline ( uint8_t* buffer, int line );
+    int getline ( uint16_t* buffer, int line );
+    int getline ( float* buffer, int line );
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    virtual ~DownsampledMask() {}
+
+    /** \~french
+     * \brief Sortie des informations sur le masque
+     ** \~english
+     * \brief Mask description output
+     */
+    void print() {
+        LOGGER_INFO ( "" );
+        LOGGER_INFO ( "------ DownsampledMask -------" );
+        Image::print();
+    }
+};
+
+/** \~ \author Institut national de l'information géographique et forestière
+ ** \~french
+ * \brief Usine de création d'une image sous-échantillonnée
+ * \details Il est nécessaire de passer par cette classe pour créer des objets de la classe DownsampledImage. Cela permet de réaliser quelques tests en amont de l'appel au constructeur et de sortir en erreur en cas de problème.
+ */
+class DownsampledImageFactory {
+public:
+    /** \~french
+     * \brief Teste les images sources et crée un objet DownsampledImage, avec son masque
+     * \details Les images présentes (sources et fond) doivent avoir les mêmes dimensions, paires, et le même nombre de canaux. Le géoréférencement est déduit de celui des sources, s'il est renseigné.
+     * \param[in] images images sources, dans l'ordre haut gauche, haut droite, bas gauche, bas droite, NULL si absente
+     * \param[in] background image de fond, NULL si aucune
+     * \param[in] nodata valeur de non-donnée, une par canal
+     * \param[in] gamma gamma de la moyenne des canaux entiers sur 8 bits (1 : moyenne classique)
+     * \return un pointeur d'objet DownsampledImage, NULL en cas d'erreur
+     ** \~english
+     * \brief Check source images and create a DownsampledImage object, with its mask
+     * \param[in] images source images, in order top left, top right, bottom left, bottom right, NULL if missing
+     * \param[in] background background image, NULL if none
+     * \param[in] nodata nodata value, one per sample
+     * \param[in] gamma gamma for 8-bit integer samples' average (1 : usual average)
+     * \return a DownsampledImage object pointer, NULL if error
+     */
+    DownsampledImage* createDownsampledImage ( Image* images[4], Image* background, int* nodata, double gamma = 1. );
+};
+
+#endif
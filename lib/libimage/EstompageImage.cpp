@@ -45,140 +45,48 @@
 #define DEG_TO_RAD      .0174532925199432958
 
 
-int EstompageImage::getline ( float* buffer, int line ) {
-    if ( !estompage ) {
-        generate();
-    }
-    return _getline ( buffer, line );
-}
-
-int EstompageImage::getline ( uint16_t* buffer, int line ) {
-    if ( !estompage ) {
-        generate();
-    }
-    return _getline ( buffer, line );
-}
-
-int EstompageImage::getline ( uint8_t* buffer, int line ) {
-    if ( !estompage ) {
-        generate();
-    }
-    return _getline ( buffer, line );
-}
-
 EstompageImage::EstompageImage (int width, int height, int channels, BoundingBox<double> bbox, Image *image, float zenithDeg, float azimuthDeg, float zFactor , float resx, float resy) :
-    Image ( width, height, channels, bbox ),
-    origImage ( image ), estompage ( NULL ), zFactor (zFactor), resx (resx), resy (resy) {
+    TerrainImage ( width, height, channels, bbox, image ),
+    zFactor (zFactor), resx (resx), resy (resy) {
 
     zenith = 90.0 - zenithDeg * DEG_TO_RAD;
     azimuth = (360.0 - azimuthDeg ) * DEG_TO_RAD;
 
 }
 
-EstompageImage::~EstompageImage() {
-    delete origImage;
-    if ( estompage ) delete[] estompage;
-}
-
-
-int EstompageImage::_getline ( float* buffer, int line ) {
-    convert ( buffer, estompage + line * width, width );
-    return width;
-}
-
-int EstompageImage::_getline ( uint16_t* buffer, int line ) {
-    convert ( buffer, estompage + line * width, width );
-    return width;
-}
-
-int EstompageImage::_getline ( uint8_t* buffer, int line ) {
-    memcpy ( buffer, estompage + line * width, width );
-    return width;
-}
-
-
-int EstompageImage::getOrigLine ( uint8_t* buffer, int line ) {
-    return origImage->getline ( buffer,line );
-}
-
-int EstompageImage::getOrigLine ( uint16_t* buffer, int line ) {
-    return origImage->getline ( buffer,line );
-}
-
-int EstompageImage::getOrigLine ( float* buffer, int line ) {
-    return origImage->getline ( buffer,line );
-}
-
-
-void EstompageImage::generate() {
-    estompage = new uint8_t[width * height];
-    bufferTmp = new float[origImage->getWidth() * 3];
-    float* lineBuffer[3];
-    lineBuffer[0]= bufferTmp;
-    lineBuffer[1]= lineBuffer[0]+origImage->getWidth();
-    lineBuffer[2]= lineBuffer[1]+origImage->getWidth();
-
-    int line = 0;
-    int nextBuffer = 0;
-    int lineOrig = 0;
-    getOrigLine ( lineBuffer[0], lineOrig++ );
-    getOrigLine ( lineBuffer[1], lineOrig++ );
-    getOrigLine ( lineBuffer[2], lineOrig++ );
-    generateLine ( line++, lineBuffer[0],lineBuffer[1],lineBuffer[2] );
+void EstompageImage::computeLine() {
+    hornGradient ( 8 * resx, 8 * resy );
 
-    while ( line < height ) {
-        getOrigLine ( lineBuffer[nextBuffer], lineOrig++ );
-        generateLine ( line++, lineBuffer[ ( nextBuffer+1 ) %3],lineBuffer[ ( nextBuffer+2 ) %3],lineBuffer[nextBuffer] );
-        nextBuffer = ( nextBuffer+1 ) %3;
-    }
-    delete[] bufferTmp;
-}
-
-void EstompageImage::generateLine ( int line, float* line1, float* line2, float* line3 ) {
-    uint8_t* currentLine = estompage + line * width;
-    int columnOrig = 1;
+    // cos(zenith)cos(slope) + sin(zenith)sin(slope)cos(azimuth - aspect), avec slope = atan(zFactor * |grad|)
+    // et aspect = atan2(dzdy, -dzdx), se développe sans trigonométrie par pixel :
+    // (cos(zenith) + sin(zenith) * zFactor * (sin(azimuth) * dzdy - cos(azimuth) * dzdx)) / sqrt(1 + zFactor² * |grad|²)
+    float cz = 255.0 * cos ( zenith );
+    float szx = - 255.0 * sin ( zenith ) * zFactor * cos ( azimuth );
+    float szy = 255.0 * sin ( zenith ) * zFactor * sin ( azimuth );
+    float z2 = zFactor * zFactor;
     int column = 0;
-    double value;
-    float dzdx,dzdy,slope,aspect;
-    float a,b,c,d,e,f,g,h,i;
-
-    while ( column < width ) {
-
-        a = ( * ( line1+columnOrig-1 ) );
-        b = ( * ( line1+columnOrig ) );
-        c = ( * ( line1+columnOrig+1 ) );
-        d = ( * ( line2+columnOrig-1 ) );
-        e = ( * ( line2+columnOrig ) );
-        f = ( * ( line2+columnOrig+1 ) );
-        g = ( * ( line3+columnOrig-1 ) );
-        h = ( * ( line3+columnOrig ) );
-        i = ( * ( line3+columnOrig+1 ) );
-
-        dzdx = ((c + 2*f + i) - (a + 2*d + g)) / (8 * resx);
-        dzdy = ((g + 2*h + i) - (a + 2*b + c)) / (8 * resy);
-
-        slope = atan(zFactor * sqrt(dzdx*dzdx+dzdy*dzdy));
 
-        if (dzdx != 0) {
-            aspect = atan2(dzdy,-dzdx);
-            if (aspect < 0) {
-                aspect = 2 * M_PI + aspect;
-            } else {
-
-            }
-        } else {
-            if (dzdy > 0) {
-                aspect = M_PI_2;
-            } else {
-                aspect = 2 * M_PI - M_PI_2;
-            }
-        }
+#ifdef __SSE2__
+    const __m128 CZ = _mm_set1_ps ( cz );
+    const __m128 SZX = _mm_set1_ps ( szx );
+    const __m128 SZY = _mm_set1_ps ( szy );
+    const __m128 Z2 = _mm_set1_ps ( z2 );
+    const __m128 one = _mm_set1_ps ( 1.f );
+    const __m128 zero = _mm_setzero_ps();
+    for ( ; column + 4 <= width; column += 4 ) {
+        __m128 dx = _mm_loadu_ps ( dzdx + column );
+        __m128 dy = _mm_loadu_ps ( dzdy + column );
+        __m128 norm = _mm_sqrt_ps ( _mm_add_ps ( one, _mm_mul_ps ( Z2, _mm_add_ps ( _mm_mul_ps ( dx, dx ), _mm_mul_ps ( dy, dy ) ) ) ) );
+        __m128 value = _mm_div_ps ( _mm_add_ps ( CZ, _mm_add_ps ( _mm_mul_ps ( SZX, dx ), _mm_mul_ps ( SZY, dy ) ) ), norm );
+        // Valeurs positives : la troncature en entier est une conversion avec arrondi vers zéro
+        value = _mm_max_ps ( value, zero );
+        _mm_storeu_ps ( result + column, _mm_cvtepi32_ps ( _mm_cvttps_epi32 ( value ) ) );
+    }
+#endif
 
-        value = 255.0 * ((cos(zenith) * cos(slope)) + (sin(zenith) * sin(slope) * cos(azimuth - aspect)));
+    for ( ; column < width; column++ ) {
+        float value = ( cz + szx * dzdx[column] + szy * dzdy[column] ) / sqrt ( 1 + z2 * ( dzdx[column] * dzdx[column] + dzdy[column] * dzdy[column] ) );
         if (value<0) {value = 0;}
-
-        * ( currentLine+ ( column++ ) ) = ( int ) ( value );
-        columnOrig++;
+        result[column] = ( int ) ( value );
     }
-
 }
@@ -38,34 +38,21 @@
 #ifndef ESTOMPAGEIMAGE_H
 #define ESTOMPAGEIMAGE_H
 
-#include "Image.h"
+#include "TerrainImage.h"
 
-class EstompageImage : public Image {
+class EstompageImage : public TerrainImage {
 private:
-    Image* origImage;
-    uint8_t* estompage;
-    float* bufferTmp;
     float zenith;
     float azimuth;
     float resx;
     float resy;
     float zFactor;
 
-    int _getline ( uint8_t* buffer, int line );
-    int _getline ( uint16_t* buffer, int line );
-    int _getline ( float* buffer, int line );
-    int getOrigLine ( uint8_t* buffer, int line );
-    int getOrigLine ( uint16_t* buffer, int line );
-    int getOrigLine ( float* buffer, int line );
-    void generate();
-    void generateLine ( int line, float* line1, float* line2 , float* line3 );
+    void computeLine();
 
 public:
-    virtual int getline ( float* buffer, int line );
-    virtual int getline ( uint8_t* buffer, int line );
-    virtual int getline ( uint16_t* buffer, int line );
     EstompageImage (int width, int height, int channels, BoundingBox<double> bbox, Image* image, float zenithDeg, float azimuthDeg, float zFactor, float resx, float resy );
-    virtual ~EstompageImage();
+    virtual ~EstompageImage() {}
 };
 
 #endif // ESTOMPAGEIMAGE_H
@@ -66,24 +66,26 @@ int FileContext::read(uint8_t* data, int offset, int size, std::string name) {
     std::string fullName = root_dir + name;
     LOGGER_DEBUG("File read : " << size << " bytes (from the " << offset << " one) in the file " << fullName);
 
-    // Ouverture du fichier
-    int fildes = open( fullName.c_str(), O_RDONLY );
+    // Ouverture du fichier, ou récupération du descripteur déjà ouvert
+    FileDescriptorCacheElement* fdce;
+    int fildes = FileDescriptorCache::getFileDescriptor( fullName, fdce );
     if ( fildes < 0 ) {
         LOGGER_DEBUG ( "Can't open file " << fullName );
         return -1;
     }
 
-    size_t read_size = pread ( fildes, data, size, offset );
+    ssize_t read_size = pread ( fildes, data, size, offset );
+
+    FileDescriptorCache::release ( fdce );
 
     if ( read_size != size ) {
         LOGGER_ERROR ( "Impossible de lire la tuile dans le fichier " << fullName );
         if ( read_size<0 ) LOGGER_ERROR ( "Code erreur="<<errno );
-        close ( fildes );
+        // Le fichier a pu être réécrit : le prochain accès le rouvrira
+        FileDescriptorCache::invalidate ( fullName );
         return -1;
     }
 
-    close ( fildes );
-
     return read_size;
 }
 
@@ -52,6 +52,7 @@
 
 #include "Logger.h"
 #include "Context.h"
+#include "FileDescriptorCache.h"
 #include <iostream>
 #include <sys/stat.h>
 
@@ -108,6 +109,22 @@ public:
     ContextType::eContextType getType();
     std::string getTypeStr();
     std::string getTray();
+
+    /**
+     * \~french \brief Retourne la date de modification d'un fichier dont le descripteur est gardé ouvert (FileDescriptorCache)
+     * \~english \brief Return the modification date of a file whose descriptor is kept open (FileDescriptorCache)
+     */
+    time_t getModification(std::string name) {
+        return FileDescriptorCache::getModification ( root_dir + name );
+    }
+
+    /**
+     * \~french \brief Retourne la version d'un fichier : identifiant, date de modification et taille de son descripteur (FileDescriptorCache)
+     * \~english \brief Return a file's version : identifier, modification date and size of its descriptor (FileDescriptorCache)
+     */
+    std::string getVersion(std::string name) {
+        return FileDescriptorCache::getVersion ( root_dir + name );
+    }
  
     /**
      * \~french \brief Ouvre le flux #output
@@ -115,6 +132,8 @@ public:
      */
     virtual bool openToWrite(std::string name) {
         std::string fullName = root_dir + name;
+        // Un éventuel descripteur de lecture sur l'ancienne version du fichier est abandonné
+        FileDescriptorCache::invalidate ( fullName );
         output.open ( fullName.c_str(), std::ios_base::trunc | std::ios::binary );
         if (output.fail()) {
             return false;
@@ -129,6 +148,7 @@ public:
      */
     virtual bool closeToWrite(std::string name) {
         output.close();
+        FileDescriptorCache::invalidate ( root_dir + name );
         if (output.fail()) {
             return false;
         } else {
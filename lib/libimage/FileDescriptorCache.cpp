@@ -0,0 +1,278 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file FileDescriptorCache.cpp
+ ** \~french
+ * \brief Implémentation de la classe FileDescriptorCache
+ ** \~english
+ * \brief Implements class FileDescriptorCache
+ */
+
+#include "FileDescriptorCache.h"
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+std::list<FileDescriptorCacheElement*> FileDescriptorCache::mru;
+std::map<std::string, std::list<FileDescriptorCacheElement*>::iterator> FileDescriptorCache::book;
+pthread_mutex_t FileDescriptorCache::mtx = PTHREAD_MUTEX_INITIALIZER;
+int FileDescriptorCache::maxSize = 0;
+int FileDescriptorCache::validity = 0;
+bool FileDescriptorCache::randomAccess = false;
+uint64_t FileDescriptorCache::hits = 0;
+uint64_t FileDescriptorCache::misses = 0;
+uint64_t FileDescriptorCache::evictions = 0;
+
+void FileDescriptorCache::closeElement ( FileDescriptorCacheElement* fdce ) {
+    close ( fdce->fd );
+    delete fdce;
+}
+
+void FileDescriptorCache::removeElement ( std::list<FileDescriptorCacheElement*>::iterator it ) {
+    FileDescriptorCacheElement* fdce = *it;
+    book.erase ( fdce->path );
+    mru.erase ( it );
+    fdce->evicted = true;
+    if ( fdce->users == 0 ) closeElement ( fdce );
+}
+
+void FileDescriptorCache::fitSize () {
+    while ( mru.size() > maxSize && ! mru.empty() ) {
+        removeElement ( --mru.end() );
+        evictions++;
+    }
+}
+
+FileDescriptorCacheElement* FileDescriptorCache::openElement ( std::string path ) {
+    int fd = open ( path.c_str(), O_RDONLY );
+    if ( fd < 0 ) return NULL;
+
+    FileDescriptorCacheElement* fdce = new FileDescriptorCacheElement ( path, fd );
+
+    struct stat st;
+    if ( fstat ( fd, &st ) == 0 ) {
+        fdce->device = st.st_dev;
+        fdce->inode = st.st_ino;
+        fdce->modification = st.st_mtime;
+        fdce->size = st.st_size;
+    }
+
+    if ( randomAccess ) {
+        posix_fadvise ( fd, 0, 0, POSIX_FADV_RANDOM );
+    }
+
+    return fdce;
+}
+
+void FileDescriptorCache::setCacheSize ( int size ) {
+    if ( size < 0 ) size = 0;
+    pthread_mutex_lock ( &mtx );
+    maxSize = size;
+    fitSize();
+    pthread_mutex_unlock ( &mtx );
+}
+
+void FileDescriptorCache::setValidity ( int seconds ) {
+    if ( seconds < 0 ) seconds = 0;
+    pthread_mutex_lock ( &mtx );
+    validity = seconds;
+    pthread_mutex_unlock ( &mtx );
+}
+
+void FileDescriptorCache::setRandomAccess ( bool random ) {
+    pthread_mutex_lock ( &mtx );
+    randomAccess = random;
+    pthread_mutex_unlock ( &mtx );
+}
+
+bool FileDescriptorCache::isEnabled () {
+    return ( maxSize != 0 );
+}
+
+int FileDescriptorCache::getFileDescriptor ( std::string path, FileDescriptorCacheElement*& fdce ) {
+
+    pthread_mutex_lock ( &mtx );
+
+    if ( maxSize == 0 ) {
+        // Cache désactivé : le descripteur sera fermé dès qu'il sera rendu
+        pthread_mutex_unlock ( &mtx );
+        fdce = openElement ( path );
+        if ( fdce == NULL ) return -1;
+        fdce->evicted = true;
+        return fdce->fd;
+    }
+
+    std::map<std::string, std::list<FileDescriptorCacheElement*>::iterator>::iterator it = book.find ( path );
+    if ( it != book.end() ) {
+        fdce = * ( it->second );
+        fdce->users++;
+        // L'élément devient le plus récemment utilisé
+        mru.splice ( mru.begin(), mru, it->second );
+
+        time_t now = time ( NULL );
+        if ( validity == 0 || now - fdce->checkDate < validity ) {
+            hits++;
+            pthread_mutex_unlock ( &mtx );
+            return fdce->fd;
+        }
+
+        // Vérification que le fichier n'a pas été réécrit, hors de l'exclusion mutuelle (stat peut être lent sur NFS)
+        fdce->checkDate = now;
+        pthread_mutex_unlock ( &mtx );
+
+        struct stat st;
+        if ( stat ( path.c_str(), &st ) == 0 && st.st_dev == fdce->device && st.st_ino == fdce->inode &&
+             st.st_mtime == fdce->modification && st.st_size == fdce->size ) {
+            pthread_mutex_lock ( &mtx );
+            hits++;
+            pthread_mutex_unlock ( &mtx );
+            return fdce->fd;
+        }
+
+        LOGGER_DEBUG ( "Le fichier " << path << " a été modifié depuis son ouverture, il est rouvert" );
+        invalidate ( path );
+        release ( fdce );
+        pthread_mutex_lock ( &mtx );
+    }
+
+    misses++;
+    pthread_mutex_unlock ( &mtx );
+
+    fdce = openElement ( path );
+    if ( fdce == NULL ) return -1;
+
+    pthread_mutex_lock ( &mtx );
+    it = book.find ( path );
+    if ( it != book.end() ) {
+        // Un autre thread a pu ouvrir ce fichier entre temps : on conserve le descripteur le plus récent
+        removeElement ( it->second );
+    }
+    mru.push_front ( fdce );
+    book.insert ( std::pair<std::string, std::list<FileDescriptorCacheElement*>::iterator> ( path, mru.begin() ) );
+    fitSize();
+    pthread_mutex_unlock ( &mtx );
+
+    return fdce->fd;
+}
+
+void FileDescriptorCache::release ( FileDescriptorCacheElement* fdce ) {
+    if ( fdce == NULL ) return;
+    pthread_mutex_lock ( &mtx );
+    fdce->users--;
+    if ( fdce->evicted && fdce->users == 0 ) closeElement ( fdce );
+    pthread_mutex_unlock ( &mtx );
+}
+
+void FileDescriptorCache::invalidate ( std::string path ) {
+    pthread_mutex_lock ( &mtx );
+    std::map<std::string, std::list<FileDescriptorCacheElement*>::iterator>::iterator it = book.find ( path );
+    if ( it != book.end() ) {
+        removeElement ( it->second );
+    }
+    pthread_mutex_unlock ( &mtx );
+}
+
+time_t FileDescriptorCache::getModification ( std::string path ) {
+    time_t modification = 0;
+    pthread_mutex_lock ( &mtx );
+    std::map<std::string, std::list<FileDescriptorCacheElement*>::iterator>::iterator it = book.find ( path );
+    if ( it != book.end() ) {
+        modification = ( * ( it->second ) )->modification;
+    }
+    pthread_mutex_unlock ( &mtx );
+    return modification;
+}
+
+std::string FileDescriptorCache::getVersion ( std::string path ) {
+    FileDescriptorCacheElement* fdce;
+    if ( getFileDescriptor ( path, fdce ) < 0 ) return "";
+
+    // L'identité d'un descripteur ne change pas après son ouverture
+    std::ostringstream oss;
+    oss << fdce->device << ":" << fdce->inode << ":" << fdce->modification << ":" << fdce->size;
+
+    release ( fdce );
+    return oss.str();
+}
+
+int FileDescriptorCache::getSize () {
+    pthread_mutex_lock ( &mtx );
+    int n = mru.size();
+    pthread_mutex_unlock ( &mtx );
+    return n;
+}
+
+uint64_t FileDescriptorCache::getHits () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t h = hits;
+    pthread_mutex_unlock ( &mtx );
+    return h;
+}
+
+uint64_t FileDescriptorCache::getMisses () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t m = misses;
+    pthread_mutex_unlock ( &mtx );
+    return m;
+}
+
+uint64_t FileDescriptorCache::getEvictions () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t e = evictions;
+    pthread_mutex_unlock ( &mtx );
+    return e;
+}
+
+void FileDescriptorCache::printStats () {
+    pthread_mutex_lock ( &mtx );
+    LOGGER_INFO ( "Cache des descripteurs de fichier : " << mru.size() << " / " << maxSize << " fichiers ouverts" );
+    LOGGER_INFO ( "\t- succès = " << hits << ", échecs = " << misses << ", évictions = " << evictions );
+    pthread_mutex_unlock ( &mtx );
+}
+
+void FileDescriptorCache::cleanCache () {
+    pthread_mutex_lock ( &mtx );
+    while ( ! mru.empty() ) {
+        removeElement ( mru.begin() );
+    }
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    pthread_mutex_unlock ( &mtx );
+}
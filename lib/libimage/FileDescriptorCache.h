@@ -0,0 +1,342 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file FileDescriptorCache.h
+ ** \~french
+ * \brief Définition de la classe FileDescriptorCache
+ ** \~english
+ * \brief Define class FileDescriptorCache
+ */
+
+#ifndef FILEDESCRIPTORCACHE_H
+#define FILEDESCRIPTORCACHE_H
+
+#include <stdint.h>// pour uint8_t
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <list>
+#include <map>
+#include <string>
+#include "Logger.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Descripteur de fichier ouvert mémorisé dans le cache
+ * \~english
+ * \brief Open file descriptor stored in the cache
+ */
+class FileDescriptorCacheElement {
+
+public:
+
+    /**
+     * \~french \brief Chemin complet du fichier
+     * \~english \brief File's full path
+     */
+    std::string path;
+
+    /**
+     * \~french \brief Descripteur de fichier, ouvert en lecture
+     * \~english \brief File descriptor, open for reading
+     */
+    int fd;
+
+    /**
+     * \~french \brief Identifiant du fichier ouvert (périphérique et inode)
+     * \~english \brief Open file identifier (device and inode)
+     */
+    dev_t device;
+    ino_t inode;
+
+    /**
+     * \~french \brief Date de modification et taille du fichier à l'ouverture
+     * \~english \brief File's modification date and size when opened
+     */
+    time_t modification;
+    off_t size;
+
+    /**
+     * \~french \brief Date de la dernière vérification du fichier
+     * \~english \brief Date of the last file check
+     */
+    time_t checkDate;
+
+    /**
+     * \~french \brief Nombre de lectures en cours utilisant le descripteur
+     * \~english \brief Number of running readings using the descriptor
+     */
+    int users;
+
+    /**
+     * \~french \brief Le descripteur a-t-il été retiré du cache
+     * \details Il sera fermé dès qu'il ne sera plus utilisé
+     * \~english \brief Has descriptor been removed from the cache
+     * \details It will be closed as soon as it is no more used
+     */
+    bool evicted;
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    FileDescriptorCacheElement ( std::string p, int f ) :
+        path ( p ), fd ( f ), device ( 0 ), inode ( 0 ), modification ( 0 ), size ( 0 ), users ( 1 ), evicted ( false ) {
+        checkDate = time ( NULL );
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Cache des descripteurs de fichiers ouverts en lecture
+ * \details Les descripteurs sont conservés ouverts entre les lectures, partagés par tous les threads (pread ne modifie pas la position courante) et évincés selon la politique LRU quand leur nombre dépasse la taille du cache.
+ *
+ * Un fichier peut être réécrit par les outils de génération : son identifiant (périphérique, inode), sa date de modification et sa taille sont comparés à ceux du fichier ouvert au plus tard toutes les #validity secondes. S'ils diffèrent, le descripteur est remplacé. Une lecture en échec invalide aussi le descripteur (#invalidate).
+ *
+ * Un descripteur retiré du cache alors qu'il est utilisé n'est fermé qu'à la fin de la dernière lecture.
+ *
+ * Le cache est désactivé par défaut (taille nulle) : chaque lecture ouvre et ferme alors le fichier. Cette classe est prévue pour être utilisée sans instance.
+ * \~english
+ * \brief Cache of file descriptors open for reading
+ * \details Descriptors are kept open between readings, shared by all threads (pread does not modify current position) and evicted according to LRU policy when their number exceeds the cache's size.
+ *
+ * A file can be rewritten by generation tools : its identifier (device, inode), its modification date and its size are compared with the open file's ones at most every #validity seconds. If they differ, descriptor is replaced. A failed reading invalidates the descriptor too (#invalidate).
+ *
+ * A descriptor removed from the cache while used is closed only at the end of the last reading.
+ *
+ * Cache is disabled by default (null size) : each reading opens and closes the file. This class is designed to be used without instance.
+ */
+class FileDescriptorCache {
+
+private:
+
+    /**
+     * \~french \brief Descripteurs, du plus récemment utilisé au moins récemment utilisé
+     * \~english \brief Descriptors, from the most recently used to the least recently used
+     */
+    static std::list<FileDescriptorCacheElement*> mru;
+
+    /**
+     * \~french \brief Annuaire des descripteurs
+     * \details La clé est le chemin complet du fichier
+     * \~english \brief Descriptors' book
+     * \details Key is the file's full path
+     */
+    static std::map<std::string, std::list<FileDescriptorCacheElement*>::iterator> book;
+
+    /**
+     * \~french \brief Exclusion mutuelle pour l'accès au cache
+     * \~english \brief Mutex for cache access
+     */
+    static pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Nombre maximal de descripteurs ouverts dans le cache, 0 pour désactiver le cache
+     * \~english \brief Max number of open descriptors in the cache, 0 to disable the cache
+     */
+    static int maxSize;
+
+    /**
+     * \~french \brief Durée en secondes entre deux vérifications d'un fichier, 0 pour ne jamais vérifier
+     * \~english \brief Duration in seconds between two checks of a file, 0 to never check
+     */
+    static int validity;
+
+    /**
+     * \~french \brief Indique au noyau que les fichiers sont lus de manière aléatoire (posix_fadvise)
+     * \details La lecture anticipée est alors désactivée, ce qui évite de lire inutilement des données voisines de la tuile, en particulier sur NFS
+     * \~english \brief Tell the kernel files are randomly read (posix_fadvise)
+     * \details Readahead is then disabled, avoiding useless readings of data near the tile, especially with NFS
+     */
+    static bool randomAccess;
+
+    /**
+     * \~french \brief Statistiques du cache
+     * \~english \brief Cache's statistics
+     */
+    static uint64_t hits;
+    static uint64_t misses;
+    static uint64_t evictions;
+
+    /**
+     * \~french \brief Retire un descripteur du cache, et le ferme s'il n'est plus utilisé
+     * \details L'exclusion mutuelle doit être détenue par l'appelant
+     * \~english \brief Remove a descriptor from the cache, and close it if no more used
+     * \details Caller have to hold the mutex
+     */
+    static void removeElement ( std::list<FileDescriptorCacheElement*>::iterator it );
+
+    /**
+     * \~french \brief Ferme un descripteur et supprime l'élément
+     * \~english \brief Close a descriptor and delete the element
+     */
+    static void closeElement ( FileDescriptorCacheElement* fdce );
+
+    /**
+     * \~french \brief Évince les descripteurs les moins récemment utilisés jusqu'à respecter la taille maximale
+     * \~english \brief Evict the least recently used descriptors until max size is respected
+     */
+    static void fitSize ();
+
+    /**
+     * \~french \brief Ouvre un fichier en lecture et renseigne son identifiant
+     * \return L'élément, avec un utilisateur, NULL si le fichier n'a pas pu être ouvert
+     * \~english \brief Open a file for reading and fill its identifier
+     * \return Element, with one user, NULL if file could not be opened
+     */
+    static FileDescriptorCacheElement* openElement ( std::string path );
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    FileDescriptorCache(){};
+
+public:
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~FileDescriptorCache(){};
+
+    /**
+     * \~french \brief Définit le nombre maximal de descripteurs ouverts, 0 pour désactiver le cache
+     * \~english \brief Define the max number of open descriptors, 0 to disable the cache
+     */
+    static void setCacheSize ( int size );
+
+    /**
+     * \~french \brief Définit la durée entre deux vérifications d'un fichier, en secondes (0 pour ne jamais vérifier)
+     * \~english \brief Define the duration between two checks of a file, in seconds (0 to never check)
+     */
+    static void setValidity ( int seconds );
+
+    /**
+     * \~french \brief Active l'indication d'accès aléatoire aux fichiers ouverts
+     * \~english \brief Enable random access hint for open files
+     */
+    static void setRandomAccess ( bool random );
+
+    /**
+     * \~french \brief Précise si le cache est actif
+     * \~english \brief Precise if cache is enabled
+     */
+    static bool isEnabled ();
+
+    /**
+     * \~french \brief Fournit un descripteur de fichier ouvert en lecture
+     * \details Le descripteur doit être rendu avec #release une fois la lecture terminée, et ne doit pas être fermé par l'appelant
+     * \param[in] path Chemin complet du fichier
+     * \param[out] fdce Élément à rendre
+     * \return Le descripteur, négatif si le fichier ne peut pas être ouvert
+     * \~english \brief Provide a file descriptor open for reading
+     * \details Descriptor have to be released with #release once reading is over, and must not be closed by caller
+     * \param[in] path File's full path
+     * \param[out] fdce Element to release
+     * \return Descriptor, negative if file cannot be opened
+     */
+    static int getFileDescriptor ( std::string path, FileDescriptorCacheElement*& fdce );
+
+    /**
+     * \~french \brief Rend un descripteur obtenu avec #getFileDescriptor
+     * \~english \brief Release a descriptor got with #getFileDescriptor
+     */
+    static void release ( FileDescriptorCacheElement* fdce );
+
+    /**
+     * \~french \brief Retire du cache le descripteur d'un fichier
+     * \details À appeler lorsque le fichier est réécrit ou qu'une lecture échoue
+     * \~english \brief Remove a file's descriptor from the cache
+     * \details To call when file is rewritten or when a reading fails
+     */
+    static void invalidate ( std::string path );
+
+    /**
+     * \~french \brief Date de modification du fichier à l'ouverture de son descripteur, sans accès au système de fichiers
+     * \param[in] path Chemin complet du fichier
+     * \return 0 si le fichier n'est pas ouvert dans le cache
+     * \~english \brief File's modification date when its descriptor was opened, without file system access
+     * \param[in] path File's full path
+     * \return 0 if file is not open in the cache
+     */
+    static time_t getModification ( std::string path );
+
+    /**
+     * \~french \brief Version courante du fichier : périphérique, inode, date de modification et taille
+     * \details Le descripteur est obtenu comme pour une lecture (#getFileDescriptor) : la réécriture du fichier est détectée au plus tard après la durée de validité, et la version change alors.
+     * \param[in] path Chemin complet du fichier
+     * \return Chaîne vide si le fichier ne peut pas être ouvert
+     * \~english \brief File's current version : device, inode, modification date and size
+     * \details Descriptor is got as for a reading (#getFileDescriptor) : file's rewriting is detected at the latest after the validity duration, and version then changes.
+     * \param[in] path File's full path
+     * \return Empty string if file cannot be opened
+     */
+    static std::string getVersion ( std::string path );
+
+    /**
+     * \~french \brief Retourne le nombre de descripteurs dans le cache
+     * \~english \brief Return the number of descriptors in the cache
+     */
+    static int getSize ();
+
+    /**
+     * \~french \brief Statistiques du cache
+     * \~english \brief Cache's statistics
+     */
+    static uint64_t getHits ();
+    static uint64_t getMisses ();
+    static uint64_t getEvictions ();
+
+    /**
+     * \~french \brief Affiche l'état du cache
+     * \~english \brief Print cache's state
+     */
+    static void printStats ();
+
+    /**
+     * \~french \brief Ferme tous les descripteurs non utilisés, vide le cache et remet à zéro les statistiques
+     * \~english \brief Close all unused descriptors, empty the cache and reset statistics
+     */
+    static void cleanCache ();
+
+};
+
+#endif
@@ -270,6 +270,36 @@ public:
      */
     virtual int writeLine ( float* buffer, int line ) = 0;
 
+    /**
+     * \~french
+     * \brief Lit l'image à un niveau de résolution réduit, stocké dans le fichier
+     * \details On choisit le niveau réduit le plus grossier (vue d'ensemble TIFF, niveau d'ondelettes JPEG2000...) dont les résolutions restent au moins aussi fines que celles demandées. Dimensions, résolutions et emprise de l'image sont mises à jour en conséquence. Doit être appelée avant toute lecture, avant l'ajout d'un masque ou d'un convertisseur. Par défaut, la réduction n'est pas gérée et l'image reste à pleine résolution.
+     * \param[in] wantedResx résolution souhaitée dans le sens des X
+     * \param[in] wantedResy résolution souhaitée dans le sens des Y
+     * \return vrai si l'image a été réduite, faux si elle reste à pleine résolution
+     * \~english
+     * \brief Read image at a reduced resolution level, stored in the file
+     * \details We choose the coarsest reduced level (TIFF overview, JPEG2000 wavelet level...) whose resolutions stay at least as fine as the wanted ones. Image's dimensions, resolutions and bounding box are updated. Have to be called before any reading, before adding a mask or a converter. By default, reduction is not handled and image stays at full resolution.
+     * \param[in] wantedResx wanted X wise resolution
+     * \param[in] wantedResy wanted Y wise resolution
+     * \return true if image is reduced, false if it stays at full resolution
+     */
+    virtual bool reduceResolution ( double wantedResx, double wantedResy ) {
+        return false;
+    }
+
+    /**
+     * \~french
+     * \brief Restreint la lecture aux colonnes couvrant une emprise
+     * \details L'appelant n'utilisera que les pixels de cette emprise : les données hors de celle-ci peuvent ne pas être décodées, et valent alors 0 dans les lignes lues. Par défaut, toute la ligne est lue.
+     * \param[in] area emprise utile, dans le système de coordonnées de l'image
+     * \~english
+     * \brief Restrict reading to columns covering an area
+     * \details Caller will only use pixels of this area : data out of it may not be decoded, and are then 0 in read lines. By default, the whole line is read.
+     * \param[in] area useful area, in the image's coordinates system
+     */
+    virtual void setReadArea ( BoundingBox<double> area ) {}
+
     /**
      * \~french
      * \brief Retourne le chemin du fichier image
@@ -44,12 +44,13 @@
  */
 
 #include <proj_api.h>
-#include <pthread.h>
 
 #include "Grid.h"
 #include "Logger.h"
+#include "ProjCache.h"
 
 #include <algorithm>
+#include <vector>
 
 #ifndef __max
 #define __max(a, b)   ( ((a) > (b)) ? (a) : (b) )
@@ -58,15 +59,14 @@
 #define __min(a, b)   ( ((a) < (b)) ? (a) : (b) )
 #endif
 
-// Définit dans BoundingBox
-//static pthread_mutex_t mutex_proj = PTHREAD_MUTEX_INITIALIZER;
-
 Grid::Grid ( int width, int height, BoundingBox<double> bbox ) : width ( width ), height ( height ), bbox ( bbox ) {
 
     if (width == 0 || height == 0) {
         LOGGER_ERROR("One grid's dimension is null");
     }
 
+    transformedPoints = 0;
+
     nbxReg = 1 + ( width-1 ) /stepInt;
     nbyReg = 1 + ( height-1 ) /stepInt;
 
@@ -213,77 +213,235 @@ double Grid::getRatioX()
 }
 
 
-bool Grid::reproject ( std::string from_srs, std::string to_srs ) {
-    LOGGER_DEBUG ( from_srs<<" -> " <<to_srs );
-
-    pthread_mutex_lock ( & mutex_proj );
-    projCtx ctx = pj_ctx_alloc();
-
-    projPJ pj_src, pj_dst;
-    if ( ! ( pj_src = pj_init_plus_ctx ( ctx, ( "+init=" + from_srs +" +wktext" ).c_str() ) ) ) {
-        // Initialisation du système de projection source
-        int err = pj_ctx_get_errno ( ctx );
-        char *msg = pj_strerrno ( err );
-        LOGGER_ERROR ( "erreur d initialisation " << from_srs << " " << msg );
-        pj_ctx_free ( ctx );
-        pthread_mutex_unlock ( & mutex_proj );
-        return false;
-    }
-    if ( ! ( pj_dst = pj_init_plus_ctx ( ctx, ( "+init=" + to_srs +" +wktext +over" ).c_str() ) ) ) {
-        // Initialisation du système de projection destination
-        int err = pj_ctx_get_errno ( ctx );
-        char *msg = pj_strerrno ( err );
-        LOGGER_ERROR ( "erreur d initialisation " << to_srs << " " << msg );
-        pj_free ( pj_src );
-        pj_ctx_free ( ctx );
-        pthread_mutex_unlock ( & mutex_proj );
-        return false;
-    }
-
-    LOGGER_DEBUG ( "Avant (centre du pixel en haut à gauche) "<< gridX[0] << " " << gridY[0] );
-    LOGGER_DEBUG ( "Avant (centre du pixel en haut à droite) "<< gridX[nbx-1] << " " << gridY[nbx-1] );
-    LOGGER_DEBUG ( "Avant (centre du pixel en bas à gauche) "<< gridX[nbx*(nby-1)] << " " << gridY[nbx*(nby-1)] );
-    LOGGER_DEBUG ( "Avant (centre du pixel en bas à droite) "<< gridX[nbx*nby-1] << " " << gridY[nbx*nby-1] );
+bool Grid::transformPoints ( projPJ pj_src, projPJ pj_dst, int n, double* X, double* Y ) {
 
     // Note that geographic locations need to be passed in radians, not decimal degrees,
     // and will be returned similarly
 
     if ( pj_is_latlong ( pj_src ) )
-        for ( int i = 0; i < nbx*nby; i++ ) {
-            gridX[i] *= DEG_TO_RAD;
-            gridY[i] *= DEG_TO_RAD;
+        for ( int i = 0; i < n; i++ ) {
+            X[i] *= DEG_TO_RAD;
+            Y[i] *= DEG_TO_RAD;
         }
 
+    transformedPoints += n;
+
     // On reprojette toutes les coordonnées
-    int code = pj_transform ( pj_src, pj_dst, nbx*nby, 0, gridX, gridY, 0 );
+    int code = pj_transform ( pj_src, pj_dst, n, 0, X, Y, 0 );
 
     if ( code != 0 ) {
         LOGGER_ERROR ( "Code erreur proj4 : " << code );
-        pj_free ( pj_src );
-        pj_free ( pj_dst );
-        pj_ctx_free ( ctx );
-        pthread_mutex_unlock ( & mutex_proj );
         return false;
     }
 
     // On vérifie que le résultat renvoyé par la reprojection est valide
-    for ( int i = 0; i < nbx*nby; i++ ) {
-        if ( gridX[i] == HUGE_VAL || gridY[i] == HUGE_VAL ) {
+    for ( int i = 0; i < n; i++ ) {
+        if ( X[i] == HUGE_VAL || Y[i] == HUGE_VAL ) {
             LOGGER_ERROR ( "Valeurs retournees par pj_transform invalides" );
-            pj_free ( pj_src );
-            pj_free ( pj_dst );
-            pj_ctx_free ( ctx );
-            pthread_mutex_unlock ( & mutex_proj );
             return false;
         }
     }
 
     if ( pj_is_latlong ( pj_dst ) )
-        for ( int i = 0; i < nbx*nby; i++ ) {
-            gridX[i] *= RAD_TO_DEG;
-            gridY[i] *= RAD_TO_DEG;
+        for ( int i = 0; i < n; i++ ) {
+            X[i] *= RAD_TO_DEG;
+            Y[i] *= RAD_TO_DEG;
+        }
+
+    return true;
+}
+
+/**
+ * \~french \brief Bloc de la grille, délimité par les indices de ses points extrêmes (inclus)
+ * \~english \brief Grid's block, delimited by its extreme points' indices (included)
+ */
+struct GridBlock {
+    int x0, y0, x1, y1;
+    GridBlock ( int x0, int y0, int x1, int y1 ) : x0 ( x0 ), y0 ( y0 ), x1 ( x1 ), y1 ( y1 ) {}
+};
+
+/**
+ * \~french \brief État d'un point de la grille lors de la reprojection adaptative
+ * \~english \brief Grid point's state during adaptive reprojection
+ */
+enum GridPointState {
+    POINT_UNKNOWN = 0,
+    POINT_ASKED,
+    POINT_CONVERTED
+};
+
+/**
+ * \~french \brief Ajoute un point à la liste des points à convertir, s'il n'est pas déjà converti ou demandé
+ * \~english \brief Add a point to the list of points to convert, if not already converted or asked
+ */
+static inline void askPoint ( int i, std::vector<uint8_t>& state, std::vector<int>& asked ) {
+    if ( state[i] == POINT_UNKNOWN ) {
+        state[i] = POINT_ASKED;
+        asked.push_back ( i );
+    }
+}
+
+bool Grid::reprojectAdaptive ( projPJ pj_src, projPJ pj_dst, double tolerance ) {
+
+    int nb = nbx * nby;
+
+    // Coordonnées des points de la grille dans le système source, avant toute conversion
+    std::vector<double> srcX ( gridX, gridX + nb );
+    std::vector<double> srcY ( gridY, gridY + nb );
+
+    std::vector<uint8_t> state ( nb, POINT_UNKNOWN );
+    std::vector<int> asked;
+    std::vector<double> bufX, bufY;
+
+    std::vector<GridBlock> blocks, nextBlocks, leaves;
+    blocks.push_back ( GridBlock ( 0, 0, nbx - 1, nby - 1 ) );
+
+    while ( ! blocks.empty() ) {
+
+        // Points nécessaires à ce niveau de subdivision : coins, milieux des bords et centre de chaque bloc
+        asked.clear();
+        for ( unsigned int b = 0; b < blocks.size(); b++ ) {
+            GridBlock& B = blocks.at ( b );
+            int xm = ( B.x0 + B.x1 ) / 2, ym = ( B.y0 + B.y1 ) / 2;
+            askPoint ( B.y0 * nbx + B.x0, state, asked );
+            askPoint ( B.y0 * nbx + B.x1, state, asked );
+            askPoint ( B.y1 * nbx + B.x0, state, asked );
+            askPoint ( B.y1 * nbx + B.x1, state, asked );
+            askPoint ( B.y0 * nbx + xm, state, asked );
+            askPoint ( B.y1 * nbx + xm, state, asked );
+            askPoint ( ym * nbx + B.x0, state, asked );
+            askPoint ( ym * nbx + B.x1, state, asked );
+            askPoint ( ym * nbx + xm, state, asked );
+        }
+
+        /* Si la transformation est trop courbe pour que la subdivision soit rentable,
+         * on convertit directement tous les points restants */
+        bool all = ( transformedPoints + asked.size() > nb / 2 );
+        if ( all ) {
+            asked.clear();
+            for ( int i = 0; i < nb; i++ ) {
+                if ( state[i] != POINT_CONVERTED ) asked.push_back ( i );
+            }
+        }
+
+        // Une seule conversion PROJ par niveau
+        if ( ! asked.empty() ) {
+            bufX.resize ( asked.size() );
+            bufY.resize ( asked.size() );
+            for ( unsigned int k = 0; k < asked.size(); k++ ) {
+                bufX[k] = srcX[asked[k]];
+                bufY[k] = srcY[asked[k]];
+            }
+            if ( ! transformPoints ( pj_src, pj_dst, asked.size(), &bufX[0], &bufY[0] ) ) {
+                return false;
+            }
+            for ( unsigned int k = 0; k < asked.size(); k++ ) {
+                gridX[asked[k]] = bufX[k];
+                gridY[asked[k]] = bufY[k];
+                state[asked[k]] = POINT_CONVERTED;
+            }
+        }
+
+        if ( all ) {
+            return true;
         }
 
+        // On compare les points convertis aux valeurs interpolées depuis les coins
+        nextBlocks.clear();
+        for ( unsigned int b = 0; b < blocks.size(); b++ ) {
+            GridBlock& B = blocks.at ( b );
+            bool splitX = ( B.x1 - B.x0 > 1 );
+            bool splitY = ( B.y1 - B.y0 > 1 );
+            if ( ! splitX && ! splitY ) {
+                // Tous les points du bloc sont des coins, donc convertis
+                continue;
+            }
+
+            int xm = ( B.x0 + B.x1 ) / 2, ym = ( B.y0 + B.y1 ) / 2;
+            int px0 = pixelX ( B.x0 ), px1 = pixelX ( B.x1 ), py0 = pixelY ( B.y0 ), py1 = pixelY ( B.y1 );
+            int c00 = B.y0 * nbx + B.x0, c10 = B.y0 * nbx + B.x1, c01 = B.y1 * nbx + B.x0, c11 = B.y1 * nbx + B.x1;
+
+            int testX[5] = { xm, xm, B.x0, B.x1, xm };
+            int testY[5] = { B.y0, B.y1, ym, ym, ym };
+            double error = 0.;
+            for ( int t = 0; t < 5; t++ ) {
+                double u = ( px1 == px0 ) ? 0. : double ( pixelX ( testX[t] ) - px0 ) / double ( px1 - px0 );
+                double v = ( py1 == py0 ) ? 0. : double ( pixelY ( testY[t] ) - py0 ) / double ( py1 - py0 );
+                double ix = ( 1-v ) * ( ( 1-u ) * gridX[c00] + u * gridX[c10] ) + v * ( ( 1-u ) * gridX[c01] + u * gridX[c11] );
+                double iy = ( 1-v ) * ( ( 1-u ) * gridY[c00] + u * gridY[c10] ) + v * ( ( 1-u ) * gridY[c01] + u * gridY[c11] );
+                int p = testY[t] * nbx + testX[t];
+                error = std::max ( error, hypot ( gridX[p] - ix, gridY[p] - iy ) );
+            }
+
+            if ( error <= tolerance ) {
+                leaves.push_back ( B );
+            } else if ( splitX && splitY ) {
+                nextBlocks.push_back ( GridBlock ( B.x0, B.y0, xm, ym ) );
+                nextBlocks.push_back ( GridBlock ( xm, B.y0, B.x1, ym ) );
+                nextBlocks.push_back ( GridBlock ( B.x0, ym, xm, B.y1 ) );
+                nextBlocks.push_back ( GridBlock ( xm, ym, B.x1, B.y1 ) );
+            } else if ( splitX ) {
+                nextBlocks.push_back ( GridBlock ( B.x0, B.y0, xm, B.y1 ) );
+                nextBlocks.push_back ( GridBlock ( xm, B.y0, B.x1, B.y1 ) );
+            } else {
+                nextBlocks.push_back ( GridBlock ( B.x0, B.y0, B.x1, ym ) );
+                nextBlocks.push_back ( GridBlock ( B.x0, ym, B.x1, B.y1 ) );
+            }
+        }
+
+        blocks.swap ( nextBlocks );
+    }
+
+    // Les points non convertis sont interpolés depuis les coins du bloc les contenant
+    for ( unsigned int b = 0; b < leaves.size(); b++ ) {
+        GridBlock& B = leaves.at ( b );
+        int px0 = pixelX ( B.x0 ), px1 = pixelX ( B.x1 ), py0 = pixelY ( B.y0 ), py1 = pixelY ( B.y1 );
+        int c00 = B.y0 * nbx + B.x0, c10 = B.y0 * nbx + B.x1, c01 = B.y1 * nbx + B.x0, c11 = B.y1 * nbx + B.x1;
+        for ( int y = B.y0; y <= B.y1; y++ ) {
+            double v = ( py1 == py0 ) ? 0. : double ( pixelY ( y ) - py0 ) / double ( py1 - py0 );
+            for ( int x = B.x0; x <= B.x1; x++ ) {
+                int p = y * nbx + x;
+                if ( state[p] == POINT_CONVERTED ) continue;
+                double u = ( px1 == px0 ) ? 0. : double ( pixelX ( x ) - px0 ) / double ( px1 - px0 );
+                gridX[p] = ( 1-v ) * ( ( 1-u ) * gridX[c00] + u * gridX[c10] ) + v * ( ( 1-u ) * gridX[c01] + u * gridX[c11] );
+                gridY[p] = ( 1-v ) * ( ( 1-u ) * gridY[c00] + u * gridY[c10] ) + v * ( ( 1-u ) * gridY[c01] + u * gridY[c11] );
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Grid::reproject ( std::string from_srs, std::string to_srs, double tolerance ) {
+    LOGGER_DEBUG ( from_srs<<" -> " <<to_srs );
+
+    // Les systèmes sont initialisés une fois pour toutes, et réutilisés d'une requête à l'autre
+    ProjCacheElement* proj = ProjCache::acquire ( from_srs, to_srs );
+    if ( proj == NULL ) {
+        return false;
+    }
+    projPJ pj_src = proj->src, pj_dst = proj->dst;
+
+    LOGGER_DEBUG ( "Avant (centre du pixel en haut à gauche) "<< gridX[0] << " " << gridY[0] );
+    LOGGER_DEBUG ( "Avant (centre du pixel en haut à droite) "<< gridX[nbx-1] << " " << gridY[nbx-1] );
+    LOGGER_DEBUG ( "Avant (centre du pixel en bas à gauche) "<< gridX[nbx*(nby-1)] << " " << gridY[nbx*(nby-1)] );
+    LOGGER_DEBUG ( "Avant (centre du pixel en bas à droite) "<< gridX[nbx*nby-1] << " " << gridY[nbx*nby-1] );
+
+    transformedPoints = 0;
+
+    bool ok;
+    if ( tolerance > 0. ) {
+        ok = reprojectAdaptive ( pj_src, pj_dst, tolerance );
+    } else {
+        ok = transformPoints ( pj_src, pj_dst, nbx*nby, gridX, gridY );
+    }
+
+    if ( ! ok ) {
+        ProjCache::release ( proj );
+        return false;
+    }
+
+    LOGGER_DEBUG ( "Points convertis : " << transformedPoints << " sur " << nbx*nby );
     LOGGER_DEBUG ( "Apres (centre du pixel en haut à gauche) "<<gridX[0]<<" "<<gridY[0] );
     LOGGER_DEBUG ( "Apres (centre du pixel en haut à droite) "<<gridX[nbx-1]<<" "<<gridY[nbx-1] );
     LOGGER_DEBUG ( "Apres (centre du pixel en bas à gauche) "<<gridX[nbx*(nby-1)]<<" "<<gridY[nbx*(nby-1)] );
@@ -293,13 +451,15 @@ bool Grid::reproject ( std::string from_srs, std::string to_srs ) {
      * On n'utilise pas les coordonnées présentent dans les tableaux X et Y car celles ci correspondent
      * aux centres des pixels, et non au bords. On va donc reprojeter la bbox indépendemment.
      * On divise chaque côté de la bbox en la dimensions la plus grande.
+     * En mode adaptatif, on se contente d'autant de points par côté que la grille en compte : la bbox ne sert qu'à délimiter la zone source, avec une marge.
      */
-    if ( bbox.reproject ( pj_src, pj_dst ) ) {
+    int nbSegment = 256;
+    if ( tolerance > 0. ) {
+        nbSegment = std::min ( 256, std::max ( nbx, nby ) );
+    }
+    if ( bbox.reproject ( pj_src, pj_dst, nbSegment ) ) {
         LOGGER_ERROR ( "Erreur reprojection bbox" );
-        pj_free ( pj_src );
-        pj_free ( pj_dst );
-        pj_ctx_free ( ctx );
-        pthread_mutex_unlock ( & mutex_proj );
+        ProjCache::release ( proj );
         return false;
     }
 
@@ -308,10 +468,7 @@ bool Grid::reproject ( std::string from_srs, std::string to_srs ) {
     LOGGER_DEBUG ( "New first line Y-delta :" << deltaY );
 
     // Nettoyage
-    pj_free ( pj_src );
-    pj_free ( pj_dst );
-    pj_ctx_free ( ctx );
-    pthread_mutex_unlock ( & mutex_proj );
+    ProjCache::release ( proj );
 
     return true;
 }
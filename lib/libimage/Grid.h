@@ -69,7 +69,10 @@
  *
  * Cette grille peut enfin être fournie à l'objet ReprojectedImage.
  *
+ * Lors de la reprojection, on peut fournir une tolérance : la grille est alors reprojetée de manière adaptative. On ne convertit d'abord que les coins de la grille, puis on subdivise récursivement les blocs dont l'interpolation bilinéaire s'écarte de plus de la tolérance de la reprojection exacte (testée au centre et aux milieux des bords). Les points des blocs suffisamment linéaires sont interpolés. Pour une transformation quasi affine (petite emprise), une dizaine de points suffit au lieu de tous les points de la grille.
+ *
  * \~english \brief Reprojection grid management
+ * \details When reprojecting, a tolerance can be provided : grid is then reprojected adaptively. Only grid's corners are converted first, then blocks whose bilinear interpolation is farther than the tolerance from the exact reprojection (tested at the center and at the edges' middles) are recursively subdivided. Points of linear enough blocks are interpolated. For a nearly affine transformation (small extent), about ten points are enough instead of all grid's points.
  */
 class Grid {
 
@@ -138,6 +141,48 @@ private:
      */
     double *gridY;
 
+    /**
+     * \~french \brief Nombre de points convertis par PROJ lors de la dernière reprojection
+     * \~english \brief Number of points converted by PROJ during the last reprojection
+     */
+    int transformedPoints;
+    /**
+     * \~french \brief Colonne (en pixel) du point d'indice x de la grille
+     * \~english \brief Column (in pixel) of the grid point with indice x
+     */
+    int pixelX ( int x ) {
+        return ( x >= nbxReg ) ? width - 1 : x * stepInt;
+    }
+    /**
+     * \~french \brief Ligne (en pixel) du point d'indice y de la grille
+     * \~english \brief Line (in pixel) of the grid point with indice y
+     */
+    int pixelY ( int y ) {
+        return ( y >= nbyReg ) ? height - 1 : y * stepInt;
+    }
+    /**
+     * \~french \brief Convertit des coordonnées avec PROJ
+     * \details Les conversions degrés / radians sont faites si besoin. Les coordonnées converties sont comptées dans #transformedPoints.
+     * \param[in] pj_src système spatial source
+     * \param[in] pj_dst système spatial de destination
+     * \param[in] n nombre de points
+     * \param[in,out] X abscisses à convertir
+     * \param[in,out] Y ordonnées à convertir
+     * \return VRAI si succès, FAUX si PROJ échoue ou retourne des valeurs invalides
+     * \~english \brief Convert coordinates with PROJ
+     * \details Degrees / radians conversions are done if needed. Converted coordinates are counted in #transformedPoints.
+     * \return TRUE if success, FALSE if PROJ fails or returns invalid values
+     */
+    bool transformPoints ( projPJ pj_src, projPJ pj_dst, int n, double* X, double* Y );
+    /**
+     * \~french \brief Reprojette les points de la grille par subdivision adaptative
+     * \param[in] pj_src système spatial source
+     * \param[in] pj_dst système spatial de destination
+     * \param[in] tolerance écart maximal toléré entre un point interpolé et sa reprojection exacte, dans l'unité du système de destination
+     * \~english \brief Reproject grid's points with adaptive subdivision
+     * \param[in] tolerance maximal gap allowed between an interpolated point and its exact reprojection, in the destination system's unit
+     */
+    bool reprojectAdaptive ( projPJ pj_src, projPJ pj_dst, double tolerance );
     /**
      * \~french \brief Met à jour la valeur de deltaY
      * \details À appeler après une conversion apportées aux coordonnées
@@ -215,15 +260,27 @@ public:
      */
     double getRatioY();
 
+    /**
+     * \~french \brief Retourne le nombre de points convertis par PROJ lors de la dernière reprojection
+     * \~english \brief Return the number of points converted by PROJ during the last reprojection
+     */
+    int getTransformedPoints() {
+        return transformedPoints;
+    }
     /**
      * \~french \brief Reprojette les points de la grille
      * \details On fera particulièrement attentiotn à ce que les points de la grille appartiennent bien à la zone de définition du système spatial.
+     *
+     * Avec une tolérance nulle, tous les points de la grille sont convertis. Sinon, la grille est subdivisée de manière adaptative et seuls les points nécessaires sont convertis.
      * \param[in] from_srs système spatial source, celui de la grille initialement
      * \param[in] to_srs système spatial de destination, celui dans lequel on veut la grille
+     * \param[in] tolerance écart maximal toléré entre un point interpolé et sa reprojection exacte, dans l'unité du système de destination. 0 par défaut.
      * \return VRAI si succès, FAUX sinon.
      * \~english \brief Reproject grid's points
+     * \details With a null tolerance, all grid's points are converted. Otherwise, grid is adaptively subdivided and only needed points are converted.
+     * \param[in] tolerance maximal gap allowed between an interpolated point and its exact reprojection, in the destination system's unit. 0 by default.
      */
-    bool reproject ( std::string from_srs, std::string to_srs );
+    bool reproject ( std::string from_srs, std::string to_srs, double tolerance = 0. );
 
     /**
      * \~french \brief Applique une transformation affine
@@ -266,6 +323,7 @@ public:
         LOGGER_INFO ( "\t\t- X : " << endX );
         LOGGER_INFO ( "\t\t- Y : " << endY );
         LOGGER_INFO ( "\t- First line Y-delta :" << deltaY );
+        LOGGER_INFO ( "\t- Transformed points :" << transformedPoints );
     }
 
 };
@@ -0,0 +1,218 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file IndexCache.cpp
+ ** \~french
+ * \brief Implémentation de la classe IndexCache
+ ** \~english
+ * \brief Implements class IndexCache
+ */
+
+#include "IndexCache.h"
+
+std::list<IndexCacheElement*> IndexCache::mru;
+std::map<std::string, std::list<IndexCacheElement*>::iterator> IndexCache::book;
+pthread_mutex_t IndexCache::mtx = PTHREAD_MUTEX_INITIALIZER;
+size_t IndexCache::maxMemory = 0;
+size_t IndexCache::usedMemory = 0;
+int IndexCache::validity = 0;
+uint64_t IndexCache::hits = 0;
+uint64_t IndexCache::misses = 0;
+uint64_t IndexCache::evictions = 0;
+
+void IndexCache::removeElement ( std::list<IndexCacheElement*>::iterator it ) {
+    IndexCacheElement* ice = *it;
+    usedMemory -= ice->getMemorySize();
+    book.erase ( ice->key );
+    mru.erase ( it );
+    delete ice;
+}
+
+void IndexCache::fitMemory () {
+    while ( usedMemory > maxMemory && ! mru.empty() ) {
+        removeElement ( --mru.end() );
+        evictions++;
+    }
+}
+
+void IndexCache::setCacheSize ( size_t bytes ) {
+    pthread_mutex_lock ( &mtx );
+    maxMemory = bytes;
+    fitMemory();
+    pthread_mutex_unlock ( &mtx );
+}
+
+void IndexCache::setValidity ( int seconds ) {
+    if ( seconds < 0 ) seconds = 0;
+    pthread_mutex_lock ( &mtx );
+    validity = seconds;
+    pthread_mutex_unlock ( &mtx );
+}
+
+bool IndexCache::isEnabled () {
+    return ( maxMemory != 0 );
+}
+
+bool IndexCache::getTileIndex ( std::string key, int tileNumber, std::string& realName, uint32_t& tileOffset, uint32_t& tileSize, std::string version ) {
+
+    pthread_mutex_lock ( &mtx );
+
+    std::map<std::string, std::list<IndexCacheElement*>::iterator>::iterator it = book.find ( key );
+    if ( it == book.end() ) {
+        misses++;
+        pthread_mutex_unlock ( &mtx );
+        return false;
+    }
+
+    IndexCacheElement* ice = * ( it->second );
+
+    if ( ice->version != version || ( validity != 0 && time ( NULL ) - ice->date > validity ) ) {
+        // La dalle a été réécrite depuis la lecture de l'index, ou l'index est périmé : on le supprime
+        removeElement ( it->second );
+        evictions++;
+        misses++;
+        pthread_mutex_unlock ( &mtx );
+        return false;
+    }
+
+    if ( tileNumber < 0 || ( size_t ) tileNumber >= ice->offsets.size() ) {
+        misses++;
+        pthread_mutex_unlock ( &mtx );
+        return false;
+    }
+
+    // L'élément devient le plus récemment utilisé
+    mru.splice ( mru.begin(), mru, it->second );
+
+    realName = ice->name;
+    tileOffset = ice->offsets.at ( tileNumber );
+    tileSize = ice->sizes.at ( tileNumber );
+    hits++;
+
+    pthread_mutex_unlock ( &mtx );
+    return true;
+}
+
+void IndexCache::addSlabIndex ( std::string key, std::string realName, int tilesNumber, uint32_t* offsets, uint32_t* sizes, std::string version ) {
+
+    if ( ! isEnabled() ) return;
+
+    IndexCacheElement* ice = new IndexCacheElement ( key, realName, tilesNumber, offsets, sizes, version );
+
+    pthread_mutex_lock ( &mtx );
+
+    std::map<std::string, std::list<IndexCacheElement*>::iterator>::iterator it = book.find ( key );
+    if ( it != book.end() ) {
+        // Un autre thread a pu ajouter cette dalle entre temps : on remplace par l'index le plus récent
+        removeElement ( it->second );
+    }
+
+    mru.push_front ( ice );
+    book.insert ( std::pair<std::string, std::list<IndexCacheElement*>::iterator> ( key, mru.begin() ) );
+    usedMemory += ice->getMemorySize();
+
+    fitMemory();
+
+    pthread_mutex_unlock ( &mtx );
+}
+
+void IndexCache::invalidate ( std::string key ) {
+    pthread_mutex_lock ( &mtx );
+    std::map<std::string, std::list<IndexCacheElement*>::iterator>::iterator it = book.find ( key );
+    if ( it != book.end() ) {
+        removeElement ( it->second );
+    }
+    pthread_mutex_unlock ( &mtx );
+}
+
+uint64_t IndexCache::getHits () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t h = hits;
+    pthread_mutex_unlock ( &mtx );
+    return h;
+}
+
+uint64_t IndexCache::getMisses () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t m = misses;
+    pthread_mutex_unlock ( &mtx );
+    return m;
+}
+
+uint64_t IndexCache::getEvictions () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t e = evictions;
+    pthread_mutex_unlock ( &mtx );
+    return e;
+}
+
+int IndexCache::getSlabsNumber () {
+    pthread_mutex_lock ( &mtx );
+    int n = mru.size();
+    pthread_mutex_unlock ( &mtx );
+    return n;
+}
+
+size_t IndexCache::getUsedMemory () {
+    pthread_mutex_lock ( &mtx );
+    size_t u = usedMemory;
+    pthread_mutex_unlock ( &mtx );
+    return u;
+}
+
+void IndexCache::printStats () {
+    pthread_mutex_lock ( &mtx );
+    LOGGER_INFO ( "Cache des index : " << mru.size() << " dalles, " << usedMemory << " / " << maxMemory << " octets" );
+    LOGGER_INFO ( "\t- succès = " << hits << ", échecs = " << misses << ", évictions = " << evictions );
+    pthread_mutex_unlock ( &mtx );
+}
+
+void IndexCache::cleanCache () {
+    pthread_mutex_lock ( &mtx );
+    std::list<IndexCacheElement*>::iterator it;
+    for ( it = mru.begin(); it != mru.end(); ++it ) {
+        delete *it;
+    }
+    mru.clear();
+    book.clear();
+    usedMemory = 0;
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    pthread_mutex_unlock ( &mtx );
+}
@@ -0,0 +1,379 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file IndexCache.h
+ ** \~french
+ * \brief Définition de la classe IndexCache
+ ** \~english
+ * \brief Define class IndexCache
+ */
+
+#ifndef INDEXCACHE_H
+#define INDEXCACHE_H
+
+#include <stdint.h>// pour uint8_t
+#include <pthread.h>
+#include <time.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "Logger.h"
+#include "Context.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Index d'une dalle mémorisé dans le cache
+ * \~english
+ * \brief Slab's index stored in the cache
+ */
+class IndexCacheElement {
+
+public:
+
+    /**
+     * \~french \brief Clé de l'élément dans le cache (contexte et nom de la dalle demandée)
+     * \~english \brief Element's key in the cache (context and asked slab name)
+     */
+    std::string key;
+
+    /**
+     * \~french \brief Nom de la dalle contenant réellement les tuiles
+     * \details Diffère du nom demandé lorsque celui ci est une dalle symbolique
+     * \~english \brief Name of the slab really containing tiles
+     * \details Differs from the asked name when this one is a symbolic slab
+     */
+    std::string name;
+
+    /**
+     * \~french \brief Offsets des tuiles dans la dalle
+     * \~english \brief Tiles' offsets in the slab
+     */
+    std::vector<uint32_t> offsets;
+
+    /**
+     * \~french \brief Tailles des tuiles dans la dalle
+     * \~english \brief Tiles' sizes in the slab
+     */
+    std::vector<uint32_t> sizes;
+
+    /**
+     * \~french \brief Version de la dalle lorsque l'index a été lu (Context::getVersion)
+     * \details Pour un fichier : périphérique, inode, date de modification et taille. L'index est abandonné dès que la version de la dalle change.
+     * \~english \brief Slab's version when index was read (Context::getVersion)
+     * \details For a file : device, inode, modification date and size. Index is dropped as soon as slab's version changes.
+     */
+    std::string version;
+
+    /**
+     * \~french \brief Date d'ajout dans le cache
+     * \~english \brief Date of insertion in the cache
+     */
+    time_t date;
+
+    /**
+     * \~french \brief Constructeur
+     * \param[in] k Clé de l'élément
+     * \param[in] n Nom de la dalle réelle
+     * \param[in] tilesNumber Nombre de tuiles dans la dalle
+     * \param[in] o Offsets des tuiles
+     * \param[in] s Tailles des tuiles
+     * \param[in] v Version de la dalle
+     * \~english \brief Constructor
+     * \param[in] k Element's key
+     * \param[in] n Real slab's name
+     * \param[in] tilesNumber Number of tiles in the slab
+     * \param[in] o Tiles' offsets
+     * \param[in] s Tiles' sizes
+     * \param[in] v Slab's version
+     */
+    IndexCacheElement ( std::string k, std::string n, int tilesNumber, uint32_t* o, uint32_t* s, std::string v ) :
+        key ( k ), name ( n ), offsets ( o, o + tilesNumber ), sizes ( s, s + tilesNumber ), version ( v ) {
+        date = time ( NULL );
+    }
+
+    /**
+     * \~french \brief Estimation de l'occupation mémoire de l'élément, en octets
+     * \~english \brief Estimated memory used by the element, in bytes
+     */
+    size_t getMemorySize() {
+        return sizeof ( IndexCacheElement ) + key.size() + name.size() + version.size() + 2 * sizeof ( uint32_t ) * offsets.size();
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Cache des index de dalles, partagé par tous les threads
+ * \details Cette classe est prévue pour être utilisée sans instance, à la manière de CurlPool.
+ *
+ * Lire une tuile dans une dalle demande de lire l'en-tête et l'index de la dalle, puis la tuile. En mémorisant les index décodés (et la résolution des dalles symboliques), une dalle déjà rencontrée ne coûte plus qu'une lecture par tuile.
+ *
+ * Le cache est borné en mémoire (les éléments les moins récemment utilisés sont supprimés en premier) et chaque élément a une durée de validité, afin de prendre en compte les dalles réécrites. Une taille nulle désactive le cache.
+ * \~english
+ * \brief Slabs' indexes cache, shared by all threads
+ * \details This class is intended to be used without instance, like CurlPool.
+ *
+ * To read a tile in a slab, we have to read slab's header and index, then the tile. Memorizing decoded indexes (and symbolic slabs' resolution), an already met slab costs only one read per tile.
+ *
+ * Cache is memory bounded (least recently used elements are removed first) and each element has a validity period, to take into account rewritten slabs. A null size disables the cache.
+ */
+class IndexCache {
+
+private:
+
+    /**
+     * \~french \brief Liste des éléments, du plus récemment utilisé au plus ancien
+     * \~english \brief Elements list, from the most recently used to the oldest
+     */
+    static std::list<IndexCacheElement*> mru;
+
+    /**
+     * \~french \brief Annuaire des éléments, pour un accès par clé
+     * \~english \brief Elements book, for an access by key
+     */
+    static std::map<std::string, std::list<IndexCacheElement*>::iterator> book;
+
+    /**
+     * \~french \brief Exclusion mutuelle pour l'accès au cache
+     * \~english \brief Mutex for the cache access
+     */
+    static pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Occupation mémoire maximale du cache, en octets
+     * \~english \brief Max memory used by the cache, in bytes
+     */
+    static size_t maxMemory;
+
+    /**
+     * \~french \brief Occupation mémoire courante du cache, en octets
+     * \~english \brief Current memory used by the cache, in bytes
+     */
+    static size_t usedMemory;
+
+    /**
+     * \~french \brief Durée de validité d'un élément, en secondes
+     * \~english \brief Element's validity period, in seconds
+     */
+    static int validity;
+
+    /**
+     * \~french \brief Nombre de recherches fructueuses
+     * \~english \brief Number of successful lookups
+     */
+    static uint64_t hits;
+
+    /**
+     * \~french \brief Nombre de recherches infructueuses
+     * \~english \brief Number of unsuccessful lookups
+     */
+    static uint64_t misses;
+
+    /**
+     * \~french \brief Nombre d'éléments supprimés pour libérer de la mémoire ou car périmés
+     * \~english \brief Number of elements removed to free memory or because out of date
+     */
+    static uint64_t evictions;
+
+    /**
+     * \~french \brief Supprime un élément du cache
+     * \details L'appelant doit avoir verrouillé #mtx
+     * \~english \brief Remove an element from the cache
+     * \details Caller have to lock #mtx
+     */
+    static void removeElement ( std::list<IndexCacheElement*>::iterator it );
+
+    /**
+     * \~french \brief Supprime les éléments les plus anciens tant que la mémoire maximale est dépassée
+     * \details L'appelant doit avoir verrouillé #mtx
+     * \~english \brief Remove oldest elements while max memory is exceeded
+     * \details Caller have to lock #mtx
+     */
+    static void fitMemory ();
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \~english
+     * \brief Constructeur
+     */
+    IndexCache(){};
+
+public:
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \~english
+     * \brief Destructor
+     */
+    ~IndexCache(){};
+
+    /**
+     * \~french \brief Calcule la clé d'une dalle dans le cache
+     * \param[in] c Contexte de stockage de la dalle
+     * \param[in] name Nom de la dalle
+     * \~english \brief Compute the slab's key in the cache
+     * \param[in] c Slab's storage context
+     * \param[in] name Slab's name
+     */
+    static std::string getKey ( Context* c, std::string name ) {
+        return c->getTypeStr() + ":" + c->getTray() + ":" + name;
+    }
+
+    /**
+     * \~french \brief Définit l'occupation mémoire maximale du cache
+     * \details Les éléments en trop sont supprimés. Une taille nulle vide et désactive le cache.
+     * \param[in] bytes Taille maximale, en octets
+     * \~english \brief Define max memory used by the cache
+     * \details Elements in excess are removed. A null size empties and disables the cache.
+     * \param[in] bytes Max size, in bytes
+     */
+    static void setCacheSize ( size_t bytes );
+
+    /**
+     * \~french \brief Définit la durée de validité des éléments
+     * \param[in] seconds Durée en secondes, 0 pour une validité illimitée
+     * \~english \brief Define elements' validity period
+     * \param[in] seconds Period in seconds, 0 for unlimited validity
+     */
+    static void setValidity ( int seconds );
+
+    /**
+     * \~french \brief Précise si le cache est actif
+     * \~english \brief Precise if cache is enabled
+     */
+    static bool isEnabled ();
+
+    /**
+     * \~french \brief Récupère la position d'une tuile dans une dalle à partir du cache
+     * \param[in] key Clé de la dalle, obtenue avec #getKey
+     * \param[in] tileNumber Indice de la tuile dans la dalle
+     * \param[out] realName Nom de la dalle contenant réellement la tuile
+     * \param[out] tileOffset Offset de la tuile dans la dalle
+     * \param[out] tileSize Taille de la tuile
+     * \param[in] version Version courante de la dalle (Context::getVersion) : un index lu sur une autre version est supprimé
+     * \return Vrai si la dalle est présente et valide dans le cache, les sorties ne sont pas modifiées sinon
+     * \~english \brief Get the tile's position in a slab from the cache
+     * \param[in] key Slab's key, from #getKey
+     * \param[in] tileNumber Tile's indice in the slab
+     * \param[out] realName Name of the slab really containing the tile
+     * \param[out] tileOffset Tile's offset in the slab
+     * \param[out] tileSize Tile's size
+     * \param[in] version Slab's current version (Context::getVersion) : an index read on another version is removed
+     * \return True if slab is present and valid in the cache, outputs are not modified otherwise
+     */
+    static bool getTileIndex ( std::string key, int tileNumber, std::string& realName, uint32_t& tileOffset, uint32_t& tileSize, std::string version = "" );
+
+    /**
+     * \~french \brief Ajoute l'index d'une dalle dans le cache
+     * \details Si la dalle est déjà présente, son index est remplacé.
+     * \param[in] key Clé de la dalle, obtenue avec #getKey
+     * \param[in] realName Nom de la dalle contenant réellement les tuiles
+     * \param[in] tilesNumber Nombre de tuiles dans la dalle
+     * \param[in] offsets Offsets des tuiles, tels que lus dans la dalle
+     * \param[in] sizes Tailles des tuiles, telles que lues dans la dalle
+     * \param[in] version Version de la dalle avant la lecture de l'index (Context::getVersion)
+     * \~english \brief Add a slab's index in the cache
+     * \details If slab is already present, its index is replaced.
+     * \param[in] key Slab's key, from #getKey
+     * \param[in] realName Name of the slab really containing tiles
+     * \param[in] tilesNumber Number of tiles in the slab
+     * \param[in] offsets Tiles' offsets, as read in the slab
+     * \param[in] sizes Tiles' sizes, as read in the slab
+     * \param[in] version Slab's version before index reading (Context::getVersion)
+     */
+    static void addSlabIndex ( std::string key, std::string realName, int tilesNumber, uint32_t* offsets, uint32_t* sizes, std::string version = "" );
+
+    /**
+     * \~french \brief Supprime l'index d'une dalle du cache
+     * \details À utiliser lorsque la dalle a été réécrite ou que la lecture d'une tuile a échoué
+     * \param[in] key Clé de la dalle, obtenue avec #getKey
+     * \~english \brief Remove a slab's index from the cache
+     * \details To use when slab have been rewritten or when tile's reading failed
+     * \param[in] key Slab's key, from #getKey
+     */
+    static void invalidate ( std::string key );
+
+    /**
+     * \~french \brief Retourne le nombre de recherches fructueuses
+     * \~english \brief Return the number of successful lookups
+     */
+    static uint64_t getHits ();
+
+    /**
+     * \~french \brief Retourne le nombre de recherches infructueuses
+     * \~english \brief Return the number of unsuccessful lookups
+     */
+    static uint64_t getMisses ();
+
+    /**
+     * \~french \brief Retourne le nombre d'éléments supprimés pour libérer de la mémoire ou car périmés
+     * \~english \brief Return the number of elements removed to free memory or because out of date
+     */
+    static uint64_t getEvictions ();
+
+    /**
+     * \~french \brief Retourne le nombre de dalles dans le cache
+     * \~english \brief Return the number of slabs in the cache
+     */
+    static int getSlabsNumber ();
+
+    /**
+     * \~french \brief Retourne l'occupation mémoire courante du cache, en octets
+     * \~english \brief Return the current memory used by the cache, in bytes
+     */
+    static size_t getUsedMemory ();
+
+    /**
+     * \~french \brief Affiche les statistiques du cache
+     * \~english \brief Print cache's statistics
+     */
+    static void printStats ();
+
+    /**
+     * \~french \brief Vide le cache et remet les statistiques à zéro
+     * \~english \brief Empty the cache and reset statistics
+     */
+    static void cleanCache ();
+
+};
+
+#endif
@@ -47,6 +47,7 @@
 #define LIBCURL_STRUCT_H
 
 #include <stdlib.h>
+#include <curl/curl.h>
 
 struct HeaderStruct {
     char* url;
@@ -76,6 +77,31 @@ struct DataStruct {
     }
 };
 
+struct CurlRequest {
+    CURL* curl;
+    struct curl_slist* list;
+    DataStruct chunk;
+    bool done;
+    CURLcode code;
+
+    CurlRequest()
+    {
+        curl = curl_easy_init();
+        list = NULL;
+        chunk.nbPassage = 0;
+        chunk.data = (char*) malloc(1);
+        chunk.size = 0;
+        done = false;
+        code = CURLE_OK;
+    }
+
+    ~CurlRequest()
+    {
+        if (list) curl_slist_free_all(list);
+        if (curl) curl_easy_cleanup(curl);
+    }
+};
+
 
 static size_t header_callback(char *buffer, size_t nitems, size_t size, void *userp) {
 
@@ -54,8 +54,10 @@
 #include <ctype.h>
 
 #include "LibopenjpegImage.h"
+#include "Jpeg2000_library_config.h"
 #include "Logger.h"
 #include "Utils.h"
+#include "ThreadPool.h"
 
 /* ------------------------------------------------------------------------------------------------ */
 /* ------------------------------------------ CONVERSIONS ----------------------------------------- */
@@ -103,21 +105,93 @@ static void info_callback ( const char *msg, void *client_data ) {
     LOGGER_DEBUG ( msg );
 }
 
+/* ------------------------------------------------------------------------------------------------ */
+/* ------------------------------------------- DÉCODEUR ------------------------------------------- */
+
+/* Le décodage multi-thread est disponible à partir d'openjpeg 2.2 */
+#if defined(OPJ_VERSION_MAJOR) && ( OPJ_VERSION_MAJOR > 2 || ( OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 2 ) )
+#define OPJ_HAS_THREADS
+#endif
+
+/* A partir d'openjpeg 2.3, seule la zone demandée d'une tuile est décodée et un même décodeur peut décoder plusieurs zones successives.
+ * Avant, toute tuile touchée est décodée entièrement et le décodeur ne sert qu'une fois */
+#if defined(OPJ_VERSION_MAJOR) && ( OPJ_VERSION_MAJOR > 2 || ( OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 3 ) )
+#define OPJ_HAS_AREA_DECODING
+#endif
+
+/**
+ * \~french
+ * \brief Ouvre le fichier JPEG2000 et en lit les en-têtes
+ * \details Le décodeur est configuré pour ignorer les \b reduce niveaux de résolution les plus fins et pour utiliser autant de threads que le groupe de threads partagé, plus un (ThreadPool::getSharedPool), ou un seul s'il n'a pas été initialisé.
+ * \param[in] filename chemin du fichier image
+ * \param[in] format format du fichier (JP2 ou J2K)
+ * \param[in] reduce nombre de niveaux de résolution ignorés
+ * \param[out] stream flux de lecture
+ * \param[out] codec décodeur
+ * \param[out] image en-têtes de l'image
+ * \return vrai si succès, faux sinon (rien n'est alors à nettoyer)
+ */
+static bool openDecoder ( char* filename, OPJ_CODEC_FORMAT format, int reduce, opj_stream_t** stream, opj_codec_t** codec, opj_image_t** image ) {
+
+    opj_dparameters_t parameters;
+    opj_set_default_decoder_parameters ( &parameters );
+    parameters.cp_reduce = reduce;
+
+    *stream = NULL;
+    *image = NULL;
+    *codec = opj_create_decompress ( format );
+
+    /* catch events using our callbacks and give a local context */
+    opj_set_info_handler ( *codec, info_callback,00 );
+    opj_set_warning_handler ( *codec, warning_callback,00 );
+    opj_set_error_handler ( *codec, error_callback,00 );
+
+    /* Setup the decoder decoding parameters using user parameters */
+    if ( !opj_setup_decoder ( *codec, &parameters ) ) {
+        LOGGER_ERROR ( "Unable to setup the decoder for the JPEG2000 file " << filename );
+        opj_destroy_codec ( *codec );
+        return false;
+    }
+
+#ifdef OPJ_HAS_THREADS
+    if ( opj_has_thread_support() ) {
+        ThreadPool* pool = ThreadPool::getSharedPool();
+        int threads = ( pool == NULL ) ? 1 : pool->getThreadsNumber() + 1;
+        if ( threads > 1 && ! opj_codec_set_threads ( *codec, threads ) ) {
+            LOGGER_WARN ( "Unable to use " << threads << " threads to decode the JPEG2000 file " << filename );
+        }
+    }
+#endif
+
+    *stream = opj_stream_create_default_file_stream ( filename,1 );
+    if ( ! *stream ) {
+        LOGGER_ERROR ( "Unable to create the stream (to read) for the JPEG2000 file " << filename );
+        opj_destroy_codec ( *codec );
+        return false;
+    }
+
+    /* Read the main header of the codestream and if necessary the JP2 boxes*/
+    if ( ! opj_read_header ( *stream, *codec, image ) ) {
+        LOGGER_ERROR ( "Unable to read the header for the JPEG2000 file " << filename );
+        opj_stream_destroy ( *stream );
+        opj_destroy_codec ( *codec );
+        if ( *image ) opj_image_destroy ( *image );
+        return false;
+    }
+
+    return true;
+}
+
 /* ------------------------------------------------------------------------------------------------ */
 /* -------------------------------------------- USINES -------------------------------------------- */
 
 /* ----- Pour la lecture ----- */
 LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char* filename, BoundingBox< double > bbox, double resx, double resy ) {
 
-    // Set decoding parameters to default values
-    opj_dparameters_t parameters;                   /* decompression parameters */
     opj_image_t* image = NULL;
     opj_stream_t *l_stream = NULL;                          /* Stream */
     opj_codec_t* l_codec = NULL;                            /* Handle to a decompressor */
-    opj_codestream_index_t* cstr_index = NULL;
-
-    opj_set_default_decoder_parameters ( &parameters );
-    strncpy ( parameters.infile, filename, IMAGE_MAX_FILENAME_LENGTH * sizeof ( char ) );
+    OPJ_CODEC_FORMAT format;
 
     /************** INITIALISATION DES OBJETS OPENJPEG *********/
 
@@ -144,10 +218,10 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
 
     // Format MAGIC Code
     if ( memcmp ( magic_code, JP2_RFC3745_MAGIC, 12 ) == 0 || memcmp ( magic_code, JP2_MAGIC, 4 ) == 0 ) {
-        l_codec = opj_create_decompress ( OPJ_CODEC_JP2 );
+        format = OPJ_CODEC_JP2;
         LOGGER_DEBUG ( "Ok, use format JP2 !" );
     } else if ( memcmp ( magic_code, J2K_CODESTREAM_MAGIC, 4 ) == 0 ) {
-        l_codec = opj_create_decompress ( OPJ_CODEC_J2K );
+        format = OPJ_CODEC_J2K;
         LOGGER_DEBUG ( "Ok, use format J2K !" );
     } else {
         LOGGER_ERROR ( "Unhandled format for the JPEG2000 file " << filename );
@@ -158,34 +232,11 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
     // Nettoyage
     free ( magic_code );
 
-    /* catch events using our callbacks and give a local context */
-    opj_set_info_handler ( l_codec, info_callback,00 );
-    opj_set_warning_handler ( l_codec, warning_callback,00 );
-    opj_set_error_handler ( l_codec, error_callback,00 );
-
-    /* Setup the decoder decoding parameters using user parameters */
-    if ( !opj_setup_decoder ( l_codec, &parameters ) ) {
-        LOGGER_ERROR ( "Unable to setup the decoder for the JPEG2000 file " << filename );
-        opj_destroy_codec ( l_codec );
-        return NULL;
-    }
-
-    l_stream = opj_stream_create_default_file_stream ( filename,1 );
-    if ( !l_stream ) {
-        std::fclose ( file );
-        LOGGER_ERROR ( "Unable to create the stream (to read) for the JPEG2000 file " << filename );
+    // Seuls les en-têtes sont lus ici, les données seront décodées à la demande
+    if ( ! openDecoder ( filename, format, 0, &l_stream, &l_codec, &image ) ) {
         return NULL;
     }
 
-    /* Read the main header of the codestream and if necessary the JP2 boxes*/
-    if ( ! opj_read_header ( l_stream, l_codec, &image ) ) {
-        LOGGER_ERROR ( "Unable to read the header for the JPEG2000 file " << filename );
-        opj_stream_destroy ( l_stream );
-        opj_destroy_codec ( l_codec );
-        opj_image_destroy ( image );
-        return NULL;
-    }
-    
     /************** RECUPERATION DES INFORMATIONS **************/
 
     // BitsPerSample
@@ -193,19 +244,46 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
     int width = image->comps[0].w;
     int height = image->comps[0].h;
     int channels = image->numcomps;
+    int x0 = image->x0;
+    int y0 = image->y0;
     SampleFormat::eSampleFormat sf = SampleFormat::UINT;
     Photometric::ePhotometric ph = toROK4Photometric ( image->color_space , channels);
+
+    // On vérifie que toutes les composantes ont bien les mêmes carctéristiques
+    bool sameComponents = true;
+    for ( int i = 0; i < channels; i++ ) {
+        if ( bitspersample != image->comps[i].prec || width != image->comps[i].w || height != image->comps[i].h ||
+             image->comps[i].dx != 1 || image->comps[i].dy != 1 ) {
+            sameComponents = false;
+        }
+    }
+
+    // Niveaux de résolution et tuilage du codestream
+    int resolutions = 1;
+    int tileheight = 0;
+    opj_codestream_info_v2_t* cstr_info = opj_get_cstr_info ( l_codec );
+    if ( cstr_info ) {
+        if ( cstr_info->m_default_tile_info.tccp_info ) {
+            resolutions = cstr_info->m_default_tile_info.tccp_info[0].numresolutions;
+        }
+        if ( cstr_info->th > 1 ) {
+            tileheight = cstr_info->tdy;
+        }
+        opj_destroy_cstr_info ( &cstr_info );
+    }
+
+    opj_destroy_codec ( l_codec );
+    opj_stream_destroy ( l_stream );
+    opj_image_destroy ( image );
+
     if ( ph == Photometric::UNKNOWN ) {
-        LOGGER_ERROR ( "Unhandled color space (" << image->color_space << ") in the JPEG2000 image " << filename );
+        LOGGER_ERROR ( "Unhandled color space in the JPEG2000 image " << filename );
         return NULL;
     }
 
-    // On vérifie que toutes les composantes ont bien les mêmes carctéristiques
-    for ( int i = 1; i < channels; i++ ) {
-        if ( bitspersample != image->comps[i].prec || width != image->comps[i].w || height != image->comps[i].h ) {
-            LOGGER_ERROR ( "All components have to be the same in the JPEG image " << filename );
-            return NULL;
-        }
+    if ( ! sameComponents ) {
+        LOGGER_ERROR ( "All components have to be the same in the JPEG image " << filename );
+        return NULL;
     }
 
     /********************** CONTROLES **************************/
@@ -226,27 +304,13 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
         resx = 1.;
         resy = 1.;
     }
-    
-    /************** LECTURE DE L'IMAGE EN ENTIER ***************/
-
-    /* Get the decoded image */
-    if ( ! ( opj_decode ( l_codec, l_stream, image ) && opj_end_decompress ( l_codec, l_stream ) ) ) {
-        LOGGER_ERROR ( "Unable to decode JPEG2000 file " << filename );
-        opj_destroy_codec ( l_codec );
-        opj_stream_destroy ( l_stream );
-        opj_image_destroy ( image );
-        return NULL;
-    }
-
-    opj_destroy_codec ( l_codec );
-    opj_stream_destroy ( l_stream );
 
     /******************** CRÉATION DE L'OBJET ******************/
 
     return new LibopenjpegImage (
         width, height, resx, resy, channels, bbox, filename,
         sf, bitspersample, ph, Compression::JPEG2000,
-        image
+        format, x0, y0, resolutions, tileheight
     );
 
 }
@@ -257,26 +321,172 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
 LibopenjpegImage::LibopenjpegImage (
     int width,int height, double resx, double resy, int channels, BoundingBox<double> bbox, char* name,
     SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression,
-    opj_image_t *jp2ptr ) :
+    OPJ_CODEC_FORMAT format, int x0, int y0, int resolutions, int tileheight ) :
 
     Jpeg2000Image ( width, height, resx, resy, channels, bbox, name, sampleformat, bitspersample, photometric, compression ),
 
-    jp2image ( jp2ptr ) {
+    format ( format ), fullwidth ( width ), fullheight ( height ), gridx0 ( x0 ), gridy0 ( y0 ), tileheight ( tileheight ),
+    resolutions ( resolutions ), reduce ( 0 ), strip_codec ( NULL ), strip_stream ( NULL ), strip_image ( NULL ), current_strip ( -1 ) {
+
+    computeRowsPerStrip();
+}
+
+void LibopenjpegImage::computeRowsPerStrip () {
+
+    // Hauteur des tuiles à la résolution de lecture
+    int reducedTileHeight = ( tileheight + ( 1 << reduce ) - 1 ) >> reduce;
+
+#ifndef OPJ_HAS_AREA_DECODING
+    // Les tuiles touchées par une bande sont décodées entièrement, et une image non tuilée est une seule tuile :
+    // on ne décode chaque tuile qu'une fois, quitte à garder en mémoire toute une rangée de tuiles, voire toute l'image
+    rowsperstrip = ( tileheight > 0 ) ? reducedTileHeight : height;
+#else
+    if ( tileheight > 0 && reducedTileHeight <= 1024 ) {
+        rowsperstrip = reducedTileHeight;
+    } else if (width <= 10000) {
+        rowsperstrip = 256;
+    } else if (width <= 20000) {
+        rowsperstrip = 192;
+    } else {
+        rowsperstrip = 128;
+    }
+#endif
 
+    if ( rowsperstrip > height ) {
+        rowsperstrip = height;
+    }
+}
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ------------------------------------------ RÉDUCTION ------------------------------------------- */
+
+bool LibopenjpegImage::reduceResolution ( double wantedResx, double wantedResy ) {
+
+    if ( current_strip != -1 || converter || mask || reduce != 0 ) {
+        // L'image a déjà été lue, convertie, masquée ou réduite : on ne touche plus à ses dimensions
+        return false;
+    }
+
+    if ( gridx0 != 0 || gridy0 != 0 ) {
+        // Les dimensions réduites ne se déduisent simplement des pleines que pour une origine nulle
+        return false;
+    }
+
+    int r = 0;
+    while ( r + 1 < resolutions ) {
+        double rx = resx * ( 1 << ( r + 1 ) );
+        double ry = resy * ( 1 << ( r + 1 ) );
+        if ( rx > wantedResx + rx / 1000. || ry > wantedResy + ry / 1000. ) {
+            break;
+        }
+        r++;
+    }
+
+    if ( r == 0 ) {
+        return false;
+    }
+
+    reduce = r;
+    width = ( fullwidth + ( 1 << reduce ) - 1 ) >> reduce;
+    height = ( fullheight + ( 1 << reduce ) - 1 ) >> reduce;
+    resx *= ( 1 << reduce );
+    resy *= ( 1 << reduce );
+
+    // Le dernier pixel réduit peut déborder de l'image pleine résolution
+    bbox.xmax = bbox.xmin + width * resx;
+    bbox.ymin = bbox.ymax - height * resy;
+
+    computeRowsPerStrip();
+
+    LOGGER_DEBUG ( "JPEG2000 image " << filename << " read with " << reduce << " discarded resolution level(s) : " << width << " x " << height );
+
+    return true;
 }
 
 /* ------------------------------------------------------------------------------------------------ */
 /* ------------------------------------------- LECTURE -------------------------------------------- */
 
+void LibopenjpegImage::closeDecoder () {
+    if ( strip_codec ) {
+        opj_destroy_codec ( strip_codec );
+        strip_codec = NULL;
+    }
+    if ( strip_stream ) {
+        opj_stream_destroy ( strip_stream );
+        strip_stream = NULL;
+    }
+}
+
+bool LibopenjpegImage::_loadstrip() {
+
+    int L0 = rowsperstrip * current_strip;
+    int NLines = __min ( rowsperstrip, height - L0 );
+
+    if ( ! strip_codec ) {
+        // Les en-têtes ne sont relus que si le décodeur n'a pas pu être conservé depuis la bande précédente
+        if ( strip_image ) {
+            opj_image_destroy ( strip_image );
+            strip_image = NULL;
+        }
+        if ( ! openDecoder ( filename, format, reduce, &strip_stream, &strip_codec, &strip_image ) ) {
+            strip_codec = NULL;
+            return false;
+        }
+    }
+
+    // La zone à décoder est exprimée dans la grille de référence, c'est-à-dire à pleine résolution
+    int areay0 = gridy0 + ( L0 << reduce );
+    int areay1 = __min ( gridy0 + fullheight, gridy0 + ( ( L0 + NLines ) << reduce ) );
+
+    bool ok = opj_set_decode_area ( strip_codec, strip_image, gridx0, areay0, gridx0 + fullwidth, areay1 ) &&
+              opj_decode ( strip_codec, strip_stream, strip_image );
+
+#ifndef OPJ_HAS_AREA_DECODING
+    // Le décodeur ne peut pas décoder une seconde zone : la bande suivante rouvrira le fichier
+    ok = ok && opj_end_decompress ( strip_codec, strip_stream );
+    closeDecoder();
+#endif
+
+    if ( ! ok ) {
+        LOGGER_ERROR ( "Unable to decode lines " << L0 << " to " << L0 + NLines - 1 << " of the JPEG2000 file " << filename );
+        closeDecoder();
+        opj_image_destroy ( strip_image );
+        strip_image = NULL;
+        return false;
+    }
+
+    for ( int j = 0; j < channels; j++ ) {
+        if ( strip_image->comps[j].w != width || strip_image->comps[j].h != NLines || ! strip_image->comps[j].data ) {
+            LOGGER_ERROR ( "Unexpected decoded area (" << strip_image->comps[j].w << " x " << strip_image->comps[j].h << " instead of "
+                           << width << " x " << NLines << ") for the JPEG2000 file " << filename );
+            closeDecoder();
+            opj_image_destroy ( strip_image );
+            strip_image = NULL;
+            return false;
+        }
+    }
+
+    return true;
+}
+
 template<typename T>
 int LibopenjpegImage::_getline ( T* buffer, int line ) {
 
+    if ( line / rowsperstrip != current_strip || ! strip_image ) {
+        // Les données n'ont pas encore été lues depuis l'image (strip pas en mémoire)
+        current_strip = line / rowsperstrip;
+        if ( ! _loadstrip() ) {
+            return 0;
+        }
+    }
+
     T buffertmp[width * channels];
 
+    int offset = width * ( line % rowsperstrip );
     for (int i = 0; i < width; i++) {
-        int index = width * line + i;
+        int index = offset + i;
         for (int j = 0; j < channels; j++) {
-            buffertmp[i*channels + j] = jp2image->comps[j].data[index];
+            buffertmp[i*channels + j] = strip_image->comps[j].data[index];
         }
     }
 
@@ -68,8 +68,8 @@
  * \~french
  * \brief Manipulation d'une image JPEG2000, avec la librarie openjpeg
  * \details Une image JPEG2000 est une vraie image dans ce sens où elle est rattachée à un fichier, pour la lecture de données au format JPEG2000. La librairie utilisée est openjpeg (open source et intégrée statiquement dans le projet ROK4).
- * 
- * \todo Lire au fur et à mesure l'image JPEG2000 et ne pas la charger intégralement en mémoire lors de la création de l'objet LibopenjpegImage.
+ *
+ * Seuls les en-têtes sont lus à la création de l'objet. Les données sont ensuite décodées à la demande, par bandes de #rowsperstrip lignes (restriction de la zone de décodage avec opj_set_decode_area), et seule la bande courante est conservée en mémoire. A partir d'openjpeg 2.3, le même décodeur sert à toutes les bandes. Avec une version antérieure, toute tuile touchée par la zone est décodée entièrement et le décodeur ne sert qu'une fois : les bandes sont alors les rangées de tuiles du codestream, ou toute l'image si elle n'est pas tuilée. Le décodage utilise plusieurs threads lorsque la version d'openjpeg le permet et que le groupe de threads partagé (ThreadPool::getSharedPool) a été initialisé, avec un thread de plus que lui (le thread appelant). L'image peut enfin être lue à un niveau de résolution réduit (#reduceResolution), sans décoder les niveaux d'ondelettes plus fins.
  */
 class LibopenjpegImage : public Jpeg2000Image {
     
@@ -78,10 +78,97 @@ friend class LibopenjpegImageFactory;
 private:
 
     /**
-     * \~french \brief Stockage de l'image entière, décompressée
-     * \~english \brief Full uncompressed image storage
+     * \~french \brief Format du fichier (JP2 ou codestream J2K)
+     * \~english \brief File format (JP2 or J2K codestream)
+     */
+    OPJ_CODEC_FORMAT format;
+
+    /**
+     * \~french \brief Largeur de l'image à pleine résolution, en pixel
+     * \~english \brief Full resolution image width, in pixel
+     */
+    int fullwidth;
+    /**
+     * \~french \brief Hauteur de l'image à pleine résolution, en pixel
+     * \~english \brief Full resolution image height, in pixel
+     */
+    int fullheight;
+    /**
+     * \~french \brief Abscisse de l'origine de l'image dans la grille de référence JPEG2000
+     * \~english \brief Image origin's X in the JPEG2000 reference grid
+     */
+    int gridx0;
+    /**
+     * \~french \brief Ordonnée de l'origine de l'image dans la grille de référence JPEG2000
+     * \~english \brief Image origin's Y in the JPEG2000 reference grid
+     */
+    int gridy0;
+    /**
+     * \~french \brief Hauteur des tuiles du codestream à pleine résolution, 0 si l'image n'est pas tuilée
+     * \~english \brief Codestream's tiles height at full resolution, 0 if image is not tiled
+     */
+    int tileheight;
+
+    /**
+     * \~french \brief Nombre de niveaux de résolution disponibles dans le codestream
+     * \~english \brief Number of resolution levels available in the codestream
+     */
+    int resolutions;
+    /**
+     * \~french \brief Nombre de niveaux de résolution ignorés au décodage (0 pour la pleine résolution)
+     * \~english \brief Number of resolution levels discarded when decoding (0 for full resolution)
+     */
+    int reduce;
+
+    /**
+     * \~french \brief Nombre de ligne dans un strip
+     * \~english \brief Number of line in one strip
+     */
+    int rowsperstrip;
+    /**
+     * \~french \brief Décodeur conservé d'une bande à l'autre (openjpeg 2.3 et plus), NULL sinon
+     * \~english \brief Decoder kept from a strip to the next one (openjpeg 2.3 and later), NULL otherwise
+     */
+    opj_codec_t* strip_codec;
+    /**
+     * \~french \brief Flux de lecture associé à #strip_codec
+     * \~english \brief Reading stream associated to #strip_codec
      */
-    opj_image_t* jp2image;
+    opj_stream_t* strip_stream;
+    /**
+     * \~french \brief Strip courant, décodé
+     * \details Seule la zone du strip est décodée, à la résolution réduite
+     * \~english \brief Current decoded strip
+     * \details Only the strip area is decoded, at the reduced resolution
+     */
+    opj_image_t* strip_image;
+    /**
+     * \~french \brief Indice du strip en mémoire dans strip_image
+     * \~english \brief Memorized strip indice, in strip_image
+     */
+    int current_strip;
+
+    /**
+     * \~french \brief Calcule la hauteur des strips
+     * \details On s'aligne sur les tuiles du codestream quand elles ne sont pas trop grandes, pour ne pas décoder plusieurs fois une même tuile. Avant openjpeg 2.3, on s'aligne sur les tuiles quelle que soit leur taille, et une image non tuilée forme une seule bande.
+     * \~english \brief Compute strip height
+     * \details We align strips on codestream's tiles when they are not too big, not to decode a tile several times. Before openjpeg 2.3, we align on tiles whatever their size, and a not tiled image is a single strip.
+     */
+    void computeRowsPerStrip ();
+
+    /**
+     * \~french \brief Détruit le décodeur #strip_codec et son flux
+     * \~english \brief Destroy decoder #strip_codec and its stream
+     */
+    void closeDecoder ();
+
+    /**
+     * \~french \brief Décode le strip #current_strip dans #strip_image
+     * \return vrai si succès, faux sinon
+     * \~english \brief Decode strip #current_strip in #strip_image
+     * \return true if success, false otherwise
+     */
+    bool _loadstrip ();
 
     /** \~french
      * \brief Retourne une ligne, flottante ou entière
@@ -108,7 +195,11 @@ protected:
      * \param[in] bitspersample nombre de bits par canal
      * \param[in] photometric photométrie des données
      * \param[in] compression compression des données
-     * \param[in] jp2ptr pointeur vers l'image JPEG2000
+     * \param[in] format format du fichier (JP2 ou J2K)
+     * \param[in] x0 abscisse de l'origine de l'image dans la grille de référence
+     * \param[in] y0 ordonnée de l'origine de l'image dans la grille de référence
+     * \param[in] resolutions nombre de niveaux de résolution dans le codestream
+     * \param[in] tileheight hauteur des tuiles du codestream, 0 si non tuilé
      ** \~english
      * \brief Create a LibopenjpegImage object, from all attributes
      * \param[in] width image width, in pixel
@@ -122,12 +213,16 @@ protected:
      * \param[in] bitspersample number of bits per sample
      * \param[in] photometric data photometric
      * \param[in] compression data compression
-     * \param[in] jp2ptr JPEG2000 image's pointer
+     * \param[in] format file format (JP2 or J2K)
+     * \param[in] x0 image origin's X in the reference grid
+     * \param[in] y0 image origin's Y in the reference grid
+     * \param[in] resolutions number of resolution levels in the codestream
+     * \param[in] tileheight codestream's tiles height, 0 if not tiled
      */
     LibopenjpegImage (
         int width, int height, double resx, double resy, int channels, BoundingBox< double > bbox, char* name,
         SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression,
-        opj_image_t* jp2ptr
+        OPJ_CODEC_FORMAT format, int x0, int y0, int resolutions, int tileheight
     );
 
 public:
@@ -145,17 +240,20 @@ public:
     int getline ( uint8_t* buffer, int line );
     int getline ( uint16_t* buffer, int line );
     int getline ( float* buffer, int line );
+
+    bool reduceResolution ( double wantedResx, double wantedResy );
     
     /**
      * \~french
      * \brief Destructeur par défaut
-     * \details Suppression du buffer de lecture #m_data
+     * \details Suppression du décodeur et du strip décodé #strip_image
      * \~english
      * \brief Default destructor
-     * \details We remove read buffer #m_data
+     * \details We remove decoder and decoded strip #strip_image
      */
     ~LibopenjpegImage() {
-        opj_image_destroy(jp2image);
+        closeDecoder();
+        if (strip_image) opj_image_destroy(strip_image);
     }
 
     /** \~french
@@ -167,7 +265,8 @@ public:
         LOGGER_INFO ( "" );
         LOGGER_INFO ( "---------- LibopenjpegImage ------------" );
         FileImage::print();
-        //LOGGER_INFO ( "\t- info sup : " << info sup );
+        LOGGER_INFO ( "\t- Rows per strip : " << rowsperstrip );
+        LOGGER_INFO ( "\t- Reduced resolution levels : " << reduce << " / " << resolutions );
         LOGGER_INFO ( "" );
     }
 
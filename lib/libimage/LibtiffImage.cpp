@@ -53,6 +53,9 @@
 #include "Logger.h"
 #include "Utils.h"
 #include "OneBitConverter.h"
+#include "ThreadPool.h"
+#include <stdlib.h>
+#include <math.h>
 
 
 /* ------------------------------------------------------------------------------------------------ */
@@ -253,7 +256,17 @@ LibtiffImage* LibtiffImageFactory::createLibtiffImageToRead ( char* filename, Bo
         return NULL;
     }
 
-    if ( TIFFGetField ( tif, TIFFTAG_ROWSPERSTRIP,&rowsperstrip ) < 1 ) {
+    if ( TIFFIsTiled ( tif ) ) {
+        int tilewidth = 0, tileheight = 0;
+        if ( TIFFGetField ( tif, TIFFTAG_TILEWIDTH,&tilewidth ) < 1 || TIFFGetField ( tif, TIFFTAG_TILELENGTH,&tileheight ) < 1 ) {
+            LOGGER_ERROR ( "Unable to read tile size for file " << filename );
+            return NULL;
+        }
+        if ( tilewidth <= 0 || tileheight <= 0 ) {
+            LOGGER_ERROR ( "Tile size is not valid for file " << filename << " : " << tilewidth << " x " << tileheight );
+            return NULL;
+        }
+    } else if ( TIFFGetFieldDefaulted ( tif, TIFFTAG_ROWSPERSTRIP,&rowsperstrip ) < 1 ) {
         LOGGER_ERROR ( "Unable to read number of rows per strip for file " << filename );
         return NULL;
     }
@@ -436,7 +449,7 @@ LibtiffImage::LibtiffImage (
                 bps, toROK4Photometric( ph ), toROK4Compression( comp ), esType
               ),
 
-    tif ( tif ), rowsperstrip ( rowsperstrip ) {
+    tif ( tif ), directory ( 0 ), rowsperstrip ( rowsperstrip ), read_area ( 0, 0, 0, 0 ), has_read_area ( false ) {
     
     // Ce constructeur permet de déterminer si la conversion de 1 à 8 bits est nécessaire, et de savoir si 0 est blanc ou noir
     
@@ -457,14 +470,7 @@ LibtiffImage::LibtiffImage (
         oneTo8bits = 0;
     }
 
-    current_strip = -1;
-    int stripSize = width*rowsperstrip*pixelSize;
-    strip_buffer = new uint8_t[stripSize];
-    
-    if (oneTo8bits) {
-        // On a besoin d'un buffer supplémentaire pour faire la conversion à la volée à la lecture
-        oneTo8bits_buffer = new uint8_t[stripSize];
-    }
+    initReading();
 }
 
 LibtiffImage::LibtiffImage (
@@ -474,48 +480,376 @@ LibtiffImage::LibtiffImage (
 
     FileImage ( width, height, resx, resy, channels, bbox, name, sampleformat, bitspersample, photometric, compression, esType ),
 
-    tif ( tif ), rowsperstrip ( rowsperstrip ) {
+    tif ( tif ), directory ( 0 ), rowsperstrip ( rowsperstrip ), read_area ( 0, 0, 0, 0 ), has_read_area ( false ) {
         
     oneTo8bits = 0;
 
+    initReading();
+}
+
+void LibtiffImage::initReading () {
+
     current_strip = -1;
-    int stripSize = width*rowsperstrip*pixelSize;
-    strip_buffer = new uint8_t[stripSize];
+    current_tile_row = -1;
+    cache_clock = 0;
+    decoded_tiles = 0;
+    strip_buffer = NULL;
+    oneTo8bits_buffer = NULL;
+
+    tiled = ( TIFFIsTiled ( tif ) != 0 );
+
+    if ( ! tiled ) {
+        tilewidth = tileheight = tilesperrow = rawtilesize = 0;
+        first_tile_col = 0;
+        last_tile_col = -1;
+
+        // Sans précision, l'image est composée d'un seul strip
+        if ( rowsperstrip <= 0 || rowsperstrip > height ) rowsperstrip = height;
+
+        int stripSize = width*rowsperstrip*pixelSize;
+        strip_buffer = new uint8_t[stripSize];
+
+        if (oneTo8bits) {
+            // On a besoin d'un buffer supplémentaire pour faire la conversion à la volée à la lecture
+            oneTo8bits_buffer = new uint8_t[stripSize];
+        }
+        return;
+    }
+
+    TIFFGetField ( tif, TIFFTAG_TILEWIDTH, &tilewidth );
+    TIFFGetField ( tif, TIFFTAG_TILELENGTH, &tileheight );
+    tilesperrow = ( width + tilewidth - 1 ) / tilewidth;
+    rawtilesize = TIFFTileSize ( tif );
+
+    // Le cache contient deux lignes de tuiles : les noyaux d'interpolation peuvent être à cheval sur deux lignes
+    int capacity = 2 * tilesperrow;
+    int slotSize = __max ( rawtilesize, tilewidth * tileheight * pixelSize );
+    row_slots.assign ( tilesperrow, -1 );
+    cache_tiles.assign ( capacity, -1 );
+    cache_uses.assign ( capacity, 0 );
+    cache_data.assign ( capacity, ( uint8_t* ) NULL );
+    for ( int i = 0; i < capacity; i++ ) {
+        cache_data.at(i) = new uint8_t[slotSize];
+    }
+
+    computeReadColumns();
+}
+
+void LibtiffImage::computeReadColumns () {
+
+    first_tile_col = 0;
+    last_tile_col = tilesperrow - 1;
+    if ( ! has_read_area ) return;
+
+    // Colonnes de pixels couvrant l'emprise utile, puis colonnes de tuiles les contenant
+    int firstColumn = __max ( 0, ( int ) floor ( ( read_area.xmin - bbox.xmin ) / resx + 1e-6 ) );
+    int lastColumn = __min ( width - 1, ( int ) ceil ( ( read_area.xmax - bbox.xmin ) / resx - 1e-6 ) - 1 );
+
+    if ( firstColumn > lastColumn ) {
+        // Rien d'utile dans l'image : aucune tuile n'est lue
+        first_tile_col = 0;
+        last_tile_col = -1;
+        return;
+    }
+
+    first_tile_col = firstColumn / tilewidth;
+    last_tile_col = lastColumn / tilewidth;
+}
+
+void LibtiffImage::setReadArea ( BoundingBox<double> area ) {
+    read_area = area;
+    has_read_area = true;
+    if ( tiled ) {
+        computeReadColumns();
+        // La ligne de tuiles courante n'a peut-être pas toutes les colonnes désormais utiles
+        current_tile_row = -1;
+    }
+}
+
+void LibtiffImage::cleanReading () {
+
+    delete [] strip_buffer;
+    strip_buffer = NULL;
+    delete [] oneTo8bits_buffer;
+    oneTo8bits_buffer = NULL;
+
+    for ( size_t i = 0; i < cache_data.size(); i++ ) {
+        delete [] cache_data.at(i);
+    }
+    cache_data.clear();
+    cache_tiles.clear();
+    cache_uses.clear();
+    row_slots.clear();
+
+    for ( size_t i = 0; i < readers.size(); i++ ) {
+        TIFFClose ( readers.at(i) );
+    }
+    readers.clear();
+}
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ------------------------------------------ RÉDUCTION ------------------------------------------- */
+
+bool LibtiffImage::reduceResolution ( double wantedResx, double wantedResy ) {
+
+    if ( current_strip != -1 || current_tile_row != -1 || converter || mask || directory != 0 ) {
+        // L'image a déjà été lue, convertie, masquée ou réduite : on ne touche plus à ses dimensions
+        return false;
+    }
+
+    uint16_t fullChannels = 0, fullBps = 0;
+    TIFFGetFieldDefaulted ( tif, TIFFTAG_SAMPLESPERPIXEL, &fullChannels );
+    TIFFGetFieldDefaulted ( tif, TIFFTAG_BITSPERSAMPLE, &fullBps );
+
+    double extentX = bbox.xmax - bbox.xmin;
+    double extentY = bbox.ymax - bbox.ymin;
+
+    // Les vues d'ensemble sont les répertoires suivants, marqués comme images réduites
+    int nbDirectories = TIFFNumberOfDirectories ( tif );
+    int best = 0;
+    uint32_t bestWidth = width, bestHeight = height;
+
+    for ( int d = 1; d < nbDirectories; d++ ) {
+        if ( ! TIFFSetDirectory ( tif, d ) ) break;
+
+        uint32_t subfiletype = 0, w = 0, h = 0;
+        uint16_t spp = 0, bps = 0;
+        TIFFGetFieldDefaulted ( tif, TIFFTAG_SUBFILETYPE, &subfiletype );
+        if ( ! ( subfiletype & FILETYPE_REDUCEDIMAGE ) || ( subfiletype & FILETYPE_MASK ) ) continue;
+
+        TIFFGetField ( tif, TIFFTAG_IMAGEWIDTH, &w );
+        TIFFGetField ( tif, TIFFTAG_IMAGELENGTH, &h );
+        TIFFGetFieldDefaulted ( tif, TIFFTAG_SAMPLESPERPIXEL, &spp );
+        TIFFGetFieldDefaulted ( tif, TIFFTAG_BITSPERSAMPLE, &bps );
+        if ( w == 0 || h == 0 || spp != fullChannels || bps != fullBps ) continue;
+
+        double rx = extentX / w;
+        double ry = extentY / h;
+        if ( rx > wantedResx + rx / 1000. || ry > wantedResy + ry / 1000. ) continue;
+
+        if ( w < bestWidth ) {
+            best = d;
+            bestWidth = w;
+            bestHeight = h;
+        }
+    }
+
+    TIFFSetDirectory ( tif, best );
+
+    if ( best == 0 ) {
+        return false;
+    }
+
+    cleanReading();
+
+    directory = best;
+    width = bestWidth;
+    height = bestHeight;
+    resx = extentX / width;
+    resy = extentY / height;
+
+    rowsperstrip = 0;
+    if ( ! TIFFIsTiled ( tif ) ) {
+        TIFFGetFieldDefaulted ( tif, TIFFTAG_ROWSPERSTRIP, &rowsperstrip );
+    }
+
+    initReading();
+
+    LOGGER_DEBUG ( "TIFF image " << filename << " read from its overview " << directory << " : " << width << " x " << height );
+
+    return true;
 }
 
 /* ------------------------------------------------------------------------------------------------ */
 /* ------------------------------------------- LECTURE -------------------------------------------- */
 
+/**
+ * \~french \brief Lot de tuiles à décoder par une tâche du groupe de threads partagé, avec sa propre interface TIFF
+ * \~english \brief Tiles' batch to decode by a shared thread pool's task, with its own TIFF interface
+ */
+class TileDecodeTask : public ThreadTask {
+public:
+    TIFF* tif;
+    std::vector<int> tiles;
+    std::vector<uint8_t*> buffers;
+    std::vector<int> sizes;
+    bool ok;
+
+    TileDecodeTask ( TIFF* tif ) : tif ( tif ), ok ( true ) {}
+
+    void run() {
+        for ( size_t i = 0; i < tiles.size(); i++ ) {
+            sizes.at(i) = TIFFReadEncodedTile ( tif, tiles.at(i), buffers.at(i), -1 );
+            if ( sizes.at(i) < 0 ) {
+                ok = false;
+            }
+        }
+    }
+};
+
+bool LibtiffImage::_loadtilerow ( int row ) {
+
+    cache_clock++;
+    current_tile_row = -1;
+
+    // Tuiles déjà dans le cache
+    std::vector<int> missingColumns;
+    std::vector<int> missingTiles;
+    for ( int c = 0; c < tilesperrow; c++ ) {
+        row_slots.at(c) = -1;
+        // Colonne hors de l'emprise utile : la tuile n'est pas décodée
+        if ( c < first_tile_col || c > last_tile_col ) continue;
+        int tile = TIFFComputeTile ( tif, c * tilewidth, row * tileheight, 0, 0 );
+        for ( size_t s = 0; s < cache_tiles.size(); s++ ) {
+            if ( cache_tiles.at(s) == tile ) {
+                row_slots.at(c) = s;
+                cache_uses.at(s) = cache_clock;
+                break;
+            }
+        }
+        if ( row_slots.at(c) == -1 ) {
+            missingColumns.push_back ( c );
+            missingTiles.push_back ( tile );
+        }
+    }
+
+    if ( missingTiles.empty() ) {
+        current_tile_row = row;
+        return true;
+    }
+    decoded_tiles += missingTiles.size();
+
+    // Emplacements des tuiles manquantes : libres ou les moins récemment utilisés, hors ligne courante
+    for ( size_t m = 0; m < missingColumns.size(); m++ ) {
+        int slot = -1;
+        for ( size_t s = 0; s < cache_tiles.size(); s++ ) {
+            if ( cache_uses.at(s) == cache_clock ) continue;
+            if ( slot == -1 || cache_uses.at(s) < cache_uses.at(slot) ) slot = s;
+        }
+        cache_tiles.at(slot) = -1;
+        cache_uses.at(slot) = cache_clock;
+        row_slots.at(missingColumns.at(m)) = slot;
+    }
+
+    // Les tuiles sont réparties entre plusieurs tâches si le groupe de threads partagé est disponible,
+    // le thread qui attend participant aussi au décodage. Chaque tâche a sa propre interface TIFF.
+    ThreadPool* pool = ThreadPool::getSharedPool();
+    int threads = 1;
+    if ( pool != NULL ) {
+        threads = __min ( pool->getThreadsNumber() + 1, ( int ) missingTiles.size() );
+    }
+    while ( readers.size() < ( size_t ) ( threads - 1 ) ) {
+        TIFF* reader = TIFFOpen ( filename, "r" );
+        if ( reader == NULL || ! TIFFSetDirectory ( reader, directory ) ) {
+            LOGGER_WARN ( "Cannot open another TIFF interface to decode " << filename << " : " << readers.size() + 1 << " thread(s) used" );
+            if ( reader ) TIFFClose ( reader );
+            threads = readers.size() + 1;
+            break;
+        }
+        readers.push_back ( reader );
+    }
+
+    std::vector<TileDecodeTask*> jobs;
+    for ( int t = 0; t < threads; t++ ) {
+        jobs.push_back ( new TileDecodeTask ( ( t == 0 ) ? tif : readers.at(t-1) ) );
+    }
+    for ( size_t m = 0; m < missingTiles.size(); m++ ) {
+        TileDecodeTask& job = *( jobs.at(m % threads) );
+        job.tiles.push_back ( missingTiles.at(m) );
+        // Conversion 1 bit -> 8 bits : on décode dans un buffer intermédiaire
+        job.buffers.push_back ( oneTo8bits ? new uint8_t[rawtilesize] : cache_data.at(row_slots.at(missingColumns.at(m))) );
+        job.sizes.push_back ( 0 );
+    }
+
+    if ( threads == 1 ) {
+        jobs.at(0)->run();
+    } else {
+        ThreadTaskGroup group;
+        for ( int t = 0; t < threads; t++ ) {
+            pool->submit ( jobs.at(t), &group );
+        }
+        pool->wait ( &group );
+    }
+
+    bool ok = true;
+    for ( size_t m = 0; m < missingTiles.size(); m++ ) {
+        TileDecodeTask& job = *( jobs.at(m % threads) );
+        int i = m / threads;
+        int slot = row_slots.at(missingColumns.at(m));
+        if ( job.sizes.at(i) < 0 ) {
+            LOGGER_ERROR ( "Cannot read tile number " << missingTiles.at(m) << " of image " << filename );
+            ok = false;
+        } else {
+            if (oneTo8bits == 1) {
+                OneBitConverter::minwhiteToGray(cache_data.at(slot), job.buffers.at(i), job.sizes.at(i));
+            } else if (oneTo8bits == 2) {
+                OneBitConverter::minblackToGray(cache_data.at(slot), job.buffers.at(i), job.sizes.at(i));
+            }
+            cache_tiles.at(slot) = missingTiles.at(m);
+        }
+        if (oneTo8bits) delete [] job.buffers.at(i);
+    }
+    for ( int t = 0; t < threads; t++ ) {
+        delete jobs.at(t);
+    }
+
+    if ( ok ) current_tile_row = row;
+
+    return ok;
+}
+
 template<typename T>
 int LibtiffImage::_getline ( T* buffer, int line ) {
     // buffer doit déjà être alloué, et assez grand, en tenant compte de la conversion
-    
-    if ( line / rowsperstrip != current_strip ) {
-        
-        // Les données n'ont pas encore été lue depuis l'image (strip pas en mémoire).
-        current_strip = line / rowsperstrip;
-        int size = TIFFReadEncodedStrip ( tif, current_strip, strip_buffer, -1 );
-        if ( size < 0 ) {
-            LOGGER_ERROR ( "Cannot read strip number " << current_strip << " of image " << filename );
-            return 0;
+
+    T buffertmp[width * channels];
+
+    if ( tiled ) {
+
+        if ( line / tileheight != current_tile_row ) {
+            // Les tuiles de la ligne ne sont pas toutes dans le cache
+            if ( ! _loadtilerow ( line / tileheight ) ) {
+                return 0;
+            }
         }
-        
-        if (oneTo8bits == 1) {
-            OneBitConverter::minwhiteToGray(oneTo8bits_buffer, strip_buffer, size);
-        } else if (oneTo8bits == 2) {
-            OneBitConverter::minblackToGray(oneTo8bits_buffer, strip_buffer, size);
+
+        if ( first_tile_col > 0 || last_tile_col < tilesperrow - 1 ) {
+            // Les colonnes hors de l'emprise utile valent 0
+            memset ( buffertmp, 0, width * pixelSize );
         }
-    }
-    
 
-    T buffertmp[width * channels];
+        int offset = ( line % tileheight ) * tilewidth * pixelSize;
+        for ( int c = first_tile_col; c <= last_tile_col; c++ ) {
+            // La dernière tuile de la ligne peut déborder de l'image
+            int columns = __min ( tilewidth, width - c * tilewidth );
+            memcpy ( ( uint8_t* ) buffertmp + c * tilewidth * pixelSize, cache_data.at(row_slots.at(c)) + offset, columns * pixelSize );
+        }
 
-    /************* SI CONVERSION 1 bit -> 8 bits **************/
-    
-    if (oneTo8bits) {
-        memcpy ( buffertmp, oneTo8bits_buffer + ( line%rowsperstrip ) * width * pixelSize, width * pixelSize );
     } else {
-        memcpy ( buffertmp, strip_buffer + ( line%rowsperstrip ) * width * pixelSize, width * pixelSize );
+        if ( line / rowsperstrip != current_strip ) {
+
+            // Les données n'ont pas encore été lue depuis l'image (strip pas en mémoire).
+            current_strip = line / rowsperstrip;
+            int size = TIFFReadEncodedStrip ( tif, current_strip, strip_buffer, -1 );
+            if ( size < 0 ) {
+                LOGGER_ERROR ( "Cannot read strip number " << current_strip << " of image " << filename );
+                return 0;
+            }
+
+            if (oneTo8bits == 1) {
+                OneBitConverter::minwhiteToGray(oneTo8bits_buffer, strip_buffer, size);
+            } else if (oneTo8bits == 2) {
+                OneBitConverter::minblackToGray(oneTo8bits_buffer, strip_buffer, size);
+            }
+        }
+
+        /************* SI CONVERSION 1 bit -> 8 bits **************/
+
+        if (oneTo8bits) {
+            memcpy ( buffertmp, oneTo8bits_buffer + ( line%rowsperstrip ) * width * pixelSize, width * pixelSize );
+        } else {
+            memcpy ( buffertmp, strip_buffer + ( line%rowsperstrip ) * width * pixelSize, width * pixelSize );
+        }
     }
 
     /********************* SI ALPHA ASSOCIE *******************/
@@ -57,6 +57,7 @@
 #include <string.h>
 #include "Format.h"
 #include "FileImage.h"
+#include <vector>
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -68,7 +69,7 @@
  *
  * Si les images lues possèdent un canal alpha, celui-ci ne doit pas être associé, c'est-à-dire qu'on conserve la valeur des autres canaux. De même en écriture, on considère que s'il y a un canal alpha, il n'a pas été prémultiplié aux autres canaux lors des traitements et l'image écrite est en alpha non associé.
  *
- * \todo Utiliser le code de la classe TiffReader pour permettre à LibtiffImage de lire des images tuilées.
+ * En lecture, les images peuvent être organisées en strips ou en tuiles. Les tuiles décodées sont conservées dans un petit cache (deux lignes de tuiles) : une tuile n'est pas décodée deux fois tant qu'elle y reste. Lorsqu'on lit une ligne de l'image, toutes les tuiles de sa ligne de tuiles sont décodées, sauf si l'appelant a restreint la lecture à une emprise (#setReadArea) : seules les colonnes de tuiles la couvrant sont alors décodées. Les lignes de tuiles jamais lues ne sont pas décodées. Les tuiles d'une même ligne de tuiles peuvent être décodées en parallèle, en utilisant le groupe de threads partagé (ThreadPool::getSharedPool) s'il a été initialisé. Les vues d'ensemble internes (images réduites, comme dans un COG) peuvent être utilisées à la place de l'image pleine résolution (#reduceResolution).
  */
 class LibtiffImage : public FileImage {
 
@@ -81,11 +82,17 @@ private:
      */
     TIFF* tif;
 
+    /**
+     * \~french \brief Indice du répertoire TIFF lu (0 pour l'image pleine résolution)
+     * \~english \brief Read TIFF directory's indice (0 for the full resolution image)
+     */
+    uint16_t directory;
+
     /**
      * \~french \brief Nombre de ligne dans un strip
      * \~english \brief Number of line in one strip
      */
-    uint16_t rowsperstrip;
+    int rowsperstrip;
 
     /**
      * \~french \brief Buffer de lecture, de taille strip_size
@@ -96,7 +103,92 @@ private:
      * \~french \brief Indice du strip en mémoire dans strip_buffer
      * \~english \brief Memorized strip indice, in strip_buffer
      */
-    uint16_t current_strip;
+    int current_strip;
+
+    /**
+     * \~french \brief L'image est-elle tuilée ?
+     * \~english \brief Is image tiled ?
+     */
+    bool tiled;
+    /**
+     * \~french \brief Largeur d'une tuile, en pixel
+     * \~english \brief Tile width, in pixel
+     */
+    int tilewidth;
+    /**
+     * \~french \brief Hauteur d'une tuile, en pixel
+     * \~english \brief Tile height, in pixel
+     */
+    int tileheight;
+    /**
+     * \~french \brief Nombre de tuiles dans une ligne de tuiles
+     * \~english \brief Number of tiles in a tiles' row
+     */
+    int tilesperrow;
+    /**
+     * \~french \brief Taille d'une tuile décodée telle que lue dans le fichier, en octet
+     * \~english \brief Decoded tile size as read in the file, in bytes
+     */
+    int rawtilesize;
+    /**
+     * \~french \brief Ligne de tuiles dont toutes les tuiles sont dans le cache, et référencées par #row_slots
+     * \~english \brief Tiles' row whose all tiles are in the cache, and referenced by #row_slots
+     */
+    int current_tile_row;
+    /**
+     * \~french \brief Première et dernière colonnes de tuiles lues, couvrant l'emprise utile (#setReadArea)
+     * \~english \brief First and last read tiles' columns, covering the useful area (#setReadArea)
+     */
+    int first_tile_col, last_tile_col;
+    /**
+     * \~french \brief Emprise utile, si #has_read_area
+     * \~english \brief Useful area, if #has_read_area
+     */
+    BoundingBox<double> read_area;
+    /**
+     * \~french \brief La lecture est-elle restreinte à une emprise ?
+     * \~english \brief Is reading restricted to an area ?
+     */
+    bool has_read_area;
+    /**
+     * \~french \brief Emplacements dans le cache des tuiles de la ligne #current_tile_row
+     * \~english \brief Cache slots of #current_tile_row row's tiles
+     */
+    std::vector<int> row_slots;
+
+    /**
+     * \~french \brief Indices des tuiles présentes dans le cache, -1 pour un emplacement libre
+     * \~english \brief Indices of tiles in cache, -1 for a free slot
+     */
+    std::vector<int> cache_tiles;
+    /**
+     * \~french \brief Données des tuiles du cache, décodées et converties (1 à 8 bits)
+     * \~english \brief Cached tiles' data, decoded and converted (1 to 8 bits)
+     */
+    std::vector<uint8_t*> cache_data;
+    /**
+     * \~french \brief Date de dernière utilisation des tuiles du cache
+     * \~english \brief Last use date of cached tiles
+     */
+    std::vector<unsigned long> cache_uses;
+    /**
+     * \~french \brief Horloge logique du cache, incrémentée à chaque ligne de tuiles chargée
+     * \~english \brief Cache logical clock, incremented for each loaded tiles' row
+     */
+    unsigned long cache_clock;
+    /**
+     * \~french \brief Nombre de tuiles décodées depuis le début de la lecture
+     * \~english \brief Number of tiles decoded since reading's beginning
+     */
+    unsigned long decoded_tiles;
+
+    /**
+     * \~french \brief Interfaces TIFF supplémentaires, une par thread de décodage au-delà du premier
+     * \details Une interface TIFF ne peut être utilisée que par un thread à la fois
+     * \~english \brief Additionnal TIFF interfaces, one per decoding thread beyond the first one
+     * \details A TIFF interface can be used by only one thread at a time
+     */
+    std::vector<TIFF*> readers;
     
     /**
      * \~french \brief Doit convertir les canaux de 1 à 8 bits
@@ -118,9 +210,45 @@ private:
      */
     uint8_t* oneTo8bits_buffer;
 
+    /** \~french
+     * \brief Prépare la lecture du répertoire TIFF courant
+     * \details On détermine l'organisation (strips ou tuiles) et on alloue les buffers de lecture en conséquence.
+     ** \~english
+     * \brief Prepare reading of the current TIFF directory
+     * \details We determine organization (strips or tiles) and allocate read buffers.
+     */
+    void initReading ();
+
+    /** \~french
+     * \brief Libère les buffers de lecture et les interfaces TIFF supplémentaires
+     ** \~english
+     * \brief Free read buffers and additionnal TIFF interfaces
+     */
+    void cleanReading ();
+
+    /** \~french
+     * \brief Calcule les colonnes de tuiles à lire, à partir de l'emprise utile
+     ** \~english
+     * \brief Compute tiles' columns to read, from the useful area
+     */
+    void computeReadColumns ();
+
+    /** \~french
+     * \brief Charge dans le cache les tuiles d'une ligne de tuiles, entre #first_tile_col et #last_tile_col
+     * \details Les tuiles déjà présentes dans le cache ne sont pas relues. Les autres sont décodées, en parallèle si le groupe de threads partagé existe, dans les emplacements les moins récemment utilisés.
+     * \param[in] row indice de la ligne de tuiles
+     * \return vrai si succès, faux sinon
+     ** \~english
+     * \brief Load in cache tiles of a tiles' row, between #first_tile_col and #last_tile_col
+     * \details Tiles already in cache are not read again. Others are decoded, in parallel if the shared thread pool exists, in the least recently used slots.
+     * \param[in] row tiles' row indice
+     * \return true if success, false otherwise
+     */
+    bool _loadtilerow ( int row );
+
     /** \~french
      * \brief Retourne une ligne, flottante ou entière
-     * \details Lorsque l'on veut récupérer une ligne d'une image TIFF, On fait appel à la fonction de la librairie TIFF TIFFReadEncodedStrip
+     * \details Lorsque l'on veut récupérer une ligne d'une image TIFF, On fait appel à la fonction de la librairie TIFF TIFFReadEncodedStrip, ou TIFFReadEncodedTile pour une image tuilée
      * \param[out] buffer Tableau contenant au moins width*channels valeurs
      * \param[in] line Indice de la ligne à retourner (0 <= line < height)
      * \return taille utile du buffer, 0 si erreur
@@ -185,7 +313,7 @@ protected:
      * \param[in] ph photométrie des données
      * \param[in] comp compression des données
      * \param[in] tiff interface de la librairie TIFF entre le fichier et l'objet
-     * \param[in] rowsperstrip taille de la bufferisation des données, en nombre de lignes
+     * \param[in] rowsperstrip taille de la bufferisation des données, en nombre de lignes (ignorée pour une image tuilée)
      * \param[in] esType type du canal supplémentaire, si présent.
      ** \~english
      * \brief Create a LibtiffImage object, from all attributes
@@ -201,7 +329,7 @@ protected:
      * \param[in] ph data photometric
      * \param[in] comp data compression
      * \param[in] tiff interface between file and object
-     * \param[in] rowsperstrip data buffering size, in line number
+     * \param[in] rowsperstrip data buffering size, in line number (ignored for a tiled image)
      * \param[in] esType extra sample type
      */
     LibtiffImage (
@@ -233,6 +361,18 @@ public:
     int getline ( uint16_t *buffer, int line );
     int getline ( float* buffer, int line );
 
+    bool reduceResolution ( double wantedResx, double wantedResy );
+
+    void setReadArea ( BoundingBox<double> area );
+
+    /**
+     * \~french \brief Nombre de tuiles décodées depuis le début de la lecture (ou la réduction de résolution)
+     * \~english \brief Number of tiles decoded since reading's beginning (or resolution reduction)
+     */
+    unsigned long getDecodedTiles() {
+        return decoded_tiles;
+    }
+
     /**
      * \~french
      * \brief Ecrit une image TIFF, à partir d'une image source
@@ -302,8 +442,7 @@ public:
      * \details We remove read buffer and TIFF interface
      */
     ~LibtiffImage() {
-        delete [] strip_buffer;
-        if (oneTo8bits) delete [] oneTo8bits_buffer;
+        cleanReading();
         TIFFClose ( tif );
     }
 
@@ -316,7 +455,12 @@ public:
         LOGGER_INFO ( "" );
         LOGGER_INFO ( "---------- LibtiffImage ------------" );
         FileImage::print();
-        LOGGER_INFO ( "\t- Rows per strip : " << rowsperstrip );
+        if (tiled) {
+            LOGGER_INFO ( "\t- Tiles : " << tilewidth << " x " << tileheight );
+        } else {
+            LOGGER_INFO ( "\t- Rows per strip : " << rowsperstrip );
+        }
+        if (directory) LOGGER_INFO ( "\t- Read overview : TIFF directory " << directory );
         if (oneTo8bits == 1) LOGGER_INFO ( "\t- We have to convert samples to 8 bits (min is white)");
         if (oneTo8bits == 2) LOGGER_INFO ( "\t- We have to convert samples to 8 bits (min is black)");
         LOGGER_INFO ( "" );
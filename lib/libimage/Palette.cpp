@@ -41,6 +41,9 @@
 #include <string.h>
 #include "byteswap.h"
 #include "Logger.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
 
 Colour::Colour ( uint8_t r, uint8_t g, uint8_t b, int a ) : r ( r ), g ( g ), b ( b ), a ( a ) {
 
@@ -68,12 +71,12 @@ bool Colour::operator!= ( const Colour& other ) const {
 
 
 
-Palette::Palette() : pngPaletteInitialised ( false ), rgbContinuous ( false ), alphaContinuous ( false ), noAlpha( false ) {
+Palette::Palette() : pngPaletteInitialised ( false ), rgbContinuous ( false ), alphaContinuous ( false ), noAlpha( false ), lutMin ( 0. ), lutInvStep ( 1. ), lutError ( 0. ) {
     pngPaletteSize = 0;
     pngPalette = NULL;
 }
 
-Palette::Palette ( size_t pngPaletteSize, uint8_t* pngPaletteData )  : pngPaletteSize ( pngPaletteSize ) ,pngPaletteInitialised ( true ), rgbContinuous ( false ), alphaContinuous ( false ), noAlpha( false ) {
+Palette::Palette ( size_t pngPaletteSize, uint8_t* pngPaletteData )  : pngPaletteSize ( pngPaletteSize ) ,pngPaletteInitialised ( true ), rgbContinuous ( false ), alphaContinuous ( false ), noAlpha( false ), lutMin ( 0. ), lutInvStep ( 1. ), lutError ( 0. ) {
     pngPalette = new uint8_t[pngPaletteSize];
     memcpy ( pngPalette,pngPaletteData,pngPaletteSize );
     LOGGER_DEBUG ( "Constructor ColourMapSize " << coloursMap.size() );
@@ -89,6 +92,11 @@ Palette::Palette ( const Palette& pal ) : pngPaletteSize ( 0 ) {
     alphaContinuous = pal.alphaContinuous;
     coloursMap = pal.coloursMap;
     noAlpha = pal.noAlpha;
+    lut = pal.lut;
+    lutSplit = pal.lutSplit;
+    lutMin = pal.lutMin;
+    lutInvStep = pal.lutInvStep;
+    lutError = pal.lutError;
     if ( pngPaletteSize !=0 ) {
         pngPalette = new uint8_t[pngPaletteSize];
         memcpy ( pngPalette,pal.pngPalette,pngPaletteSize );
@@ -104,6 +112,117 @@ Palette::Palette ( const Palette& pal ) : pngPaletteSize ( 0 ) {
  */
 Palette::Palette ( const std::map< double, Colour >& coloursMap, bool rgbContinuous, bool alphaContinuous, bool noAlpha ) : rgbContinuous ( rgbContinuous ), alphaContinuous ( alphaContinuous ), pngPaletteSize ( 0 ) ,pngPalette ( NULL ) ,pngPaletteInitialised ( false ) ,coloursMap ( coloursMap ), noAlpha( noAlpha ) {
     LOGGER_DEBUG ( "Constructor ColourMapSize " << coloursMap.size() );
+    buildLUT();
+}
+
+/**
+ * \~french \brief Empaquette une couleur comme dans la table de correspondance, l'alpha étant tronqué comme dans StyledImage
+ * \~english \brief Pack a colour like in the lookup table, alpha being truncated like in StyledImage
+ */
+static inline uint32_t packColour ( const Colour& c ) {
+    return ( uint32_t ) c.r | ( ( uint32_t ) c.g << 8 ) | ( ( uint32_t ) c.b << 16 ) | ( ( uint32_t ) ( uint8_t ) c.a << 24 );
+}
+
+void Palette::buildLUT() {
+    lut.clear();
+    lutSplit.clear();
+    lutMin = 0.;
+    lutInvStep = 1.;
+    lutError = 0.;
+
+    if ( coloursMap.empty() ) return;
+
+    double first = coloursMap.begin()->first;
+    double last = coloursMap.rbegin()->first;
+
+    // Pente maximale des canaux interpolés, en niveaux de couleur par unité
+    double slope = 0.;
+    std::map<double,Colour>::const_iterator it = coloursMap.begin();
+    std::map<double,Colour>::const_iterator next = it;
+    for ( next++; next != coloursMap.end(); it++, next++ ) {
+        double gap = next->first - it->first;
+        if ( rgbContinuous ) {
+            slope = std::max ( slope, std::fabs ( ( double ) next->second.r - it->second.r ) / gap );
+            slope = std::max ( slope, std::fabs ( ( double ) next->second.g - it->second.g ) / gap );
+            slope = std::max ( slope, std::fabs ( ( double ) next->second.b - it->second.b ) / gap );
+        }
+        if ( alphaContinuous ) {
+            slope = std::max ( slope, std::fabs ( ( double ) next->second.a - it->second.a ) / gap );
+        }
+    }
+
+    // Pas en puissance de 2 : les bornes des intervalles restent exactes et les entiers tombent sur des entrées
+    double step = 1.;
+    while ( slope * step > PALETTE_LUT_MAX_ERROR && ( last - first ) * 2. / step + 2. <= PALETTE_LUT_MAX_SIZE ) {
+        step /= 2.;
+    }
+    while ( ( last - std::floor ( first / step ) * step ) / step + 1. > PALETTE_LUT_MAX_SIZE ) {
+        step *= 2.;
+    }
+
+    lutMin = std::floor ( first / step ) * step;
+    lutInvStep = 1. / step;
+    lutError = slope * step;
+    size_t size = ( size_t ) ( ( last - lutMin ) * lutInvStep ) + 1;
+
+    lut.resize ( size );
+    for ( size_t k = 0; k < size; k++ ) {
+        lut[k] = packColour ( getColour ( lutMin + k * step ) );
+    }
+
+    // 3 octets de plus : le noyau AVX2 lit les marqueurs 4 octets par 4 octets
+    lutSplit.assign ( size + 3, 0 );
+    for ( it = ++coloursMap.begin(); it != coloursMap.end(); it++ ) {
+        double pos = ( it->first - lutMin ) * lutInvStep;
+        if ( pos != std::floor ( pos ) ) lutSplit[ ( size_t ) pos ] = 1;
+    }
+
+    LOGGER_DEBUG ( "Table de correspondance de la palette : " << size << " entrées, pas " << step << ", erreur maximale " << lutError );
+}
+
+void Palette::lookup ( uint32_t* to, const float* from, int length ) {
+    if ( lut.empty() ) {
+        for ( int i = 0; i < length; i++ ) to[i] = packColour ( getColour ( from[i] ) );
+        return;
+    }
+
+    bool vector = ( Simd::getLevel() >= Simd::AVX2 );
+    double size = lut.size();
+    int i = 0;
+    while ( i < length ) {
+        int end = length;
+        if ( vector ) {
+            // Le noyau s'arrête au premier groupe de 8 valeurs qu'il ne sait pas traiter : on le traite ici
+            i += avx2_lookup ( to + i, from + i, length - i, &lut[0], &lutSplit[0], lut.size(), lutMin, lutInvStep );
+            end = std::min ( i + 8, length );
+        }
+        for ( ; i < end; i++ ) {
+            double d = ( from[i] - lutMin ) * lutInvStep;
+            if ( d >= 0. && d < size ) {
+                size_t k = ( size_t ) d;
+                if ( ! lutSplit[k] ) {
+                    to[i] = lut[k];
+                    continue;
+                }
+            }
+            to[i] = packColour ( getColour ( from[i] ) );
+        }
+    }
+}
+
+void Palette::apply ( uint8_t* to, const float* from, int length, int channels ) {
+    uint32_t colours[512];
+    for ( int i = 0; i < length; i += 512 ) {
+        int n = std::min ( 512, length - i );
+        lookup ( colours, from + i, n );
+        uint8_t* pix = to + i * channels;
+        for ( int j = 0; j < n; j++, pix += channels ) {
+            pix[0] = colours[j];
+            pix[1] = colours[j] >> 8;
+            pix[2] = colours[j] >> 16;
+            if ( channels == 4 ) pix[3] = colours[j] >> 24;
+        }
+    }
 }
 
 void Palette::buildPalettePNG() {
@@ -207,6 +326,11 @@ Palette& Palette::operator= ( const Palette& pal ) {
         this->alphaContinuous = pal.alphaContinuous;
         this->coloursMap = pal.coloursMap;
         this->noAlpha = pal.noAlpha;
+        this->lut = pal.lut;
+        this->lutSplit = pal.lutSplit;
+        this->lutMin = pal.lutMin;
+        this->lutInvStep = pal.lutInvStep;
+        this->lutError = pal.lutError;
 
         if ( this->pngPaletteSize !=0 ) {
             this->pngPalette = new uint8_t[pngPaletteSize];
@@ -42,6 +42,18 @@
 #include <map>
 #include <stddef.h>
 
+/**
+ * \~french \brief Nombre maximal d'entrées de la table de correspondance d'une palette
+ * \~english \brief Max entries' number in a palette's lookup table
+ */
+#define PALETTE_LUT_MAX_SIZE 65536
+
+/**
+ * \~french \brief Erreur visée sur les canaux interpolés de la table de correspondance, en niveaux de couleur
+ * \~english \brief Aimed error on lookup table's interpolated channels, in colour levels
+ */
+#define PALETTE_LUT_MAX_ERROR 0.5
+
 class Colour {
 public:
     Colour ( uint8_t r=0, uint8_t g=0,uint8_t b=0, int a=0 );
@@ -67,6 +79,42 @@ private:
     bool alphaContinuous;
     bool noAlpha;
 
+    /**
+     * \~french
+     * \brief Table de correspondance valeur -> couleur, calculée au chargement
+     * \details L'entrée k contient la couleur RGBA (empaquetée, r dans l'octet de poids faible) de la valeur lutMin + k / lutInvStep. Le pas est une puissance de 2, au plus 1 quand la taille le permet : une valeur entière tombe alors exactement sur une entrée, et la table est exacte pour des données 8 ou 16 bits.
+     * \~english
+     * \brief Value -> colour lookup table, computed at load time
+     * \details Entry k contains RGBA colour (packed, r in the least significant byte) of value lutMin + k / lutInvStep. Step is a power of 2, at most 1 if size allows it : an integer value then falls exactly on an entry, and table is exact for 8 or 16-bit data.
+     */
+    std::vector<uint32_t> lut;
+    /**
+     * \~french \brief Vaut 1 pour les intervalles contenant une valeur de la palette ailleurs qu'à leur début : la couleur est alors calculée par getColour
+     * \~english \brief Is 1 for intervals containing a palette's value elsewhere than at their beginning : colour is then computed by getColour
+     */
+    std::vector<uint8_t> lutSplit;
+    /**
+     * \~french \brief Valeur de la première entrée de la table
+     * \~english \brief First table entry's value
+     */
+    double lutMin;
+    /**
+     * \~french \brief Inverse du pas de la table
+     * \~english \brief Table step's inverse
+     */
+    double lutInvStep;
+    /**
+     * \~french \brief Écart maximal, en niveaux de couleur, entre la table et getColour pour une valeur quelconque
+     * \~english \brief Max gap, in colour levels, between table and getColour for any value
+     */
+    double lutError;
+
+    /**
+     * \~french \brief Calcule la table de correspondance à partir des couleurs
+     * \~english \brief Compute the lookup table from colours
+     */
+    void buildLUT();
+
 public:
     /**
      *
@@ -104,6 +152,64 @@ public:
     }
     Colour getColour ( double index );
 
+    /**
+     * \~french
+     * \brief Couleurs RGBA empaquetées d'un tableau de valeurs, via la table de correspondance
+     * \details Les valeurs hors de la table ou dans un intervalle coupé par une valeur de la palette passent par getColour.
+     * \param[out] to couleurs, r dans l'octet de poids faible
+     * \param[in] from valeurs
+     * \param[in] length nombre de valeurs
+     * \~english
+     * \brief Packed RGBA colours of a values array, thanks to the lookup table
+     * \details Values out of the table or in an interval cut by a palette's value use getColour.
+     * \param[out] to colours, r in the least significant byte
+     * \param[in] from values
+     * \param[in] length values' number
+     */
+    void lookup ( uint32_t* to, const float* from, int length );
+
+    /**
+     * \~french
+     * \brief Colorise un tableau de valeurs
+     * \param[out] to pixels colorisés
+     * \param[in] from valeurs
+     * \param[in] length nombre de valeurs
+     * \param[in] channels nombre de canaux en sortie : 3 (RGB) ou 4 (RGBA)
+     * \~english
+     * \brief Colour a values array
+     * \param[out] to coloured pixels
+     * \param[in] from values
+     * \param[in] length values' number
+     * \param[in] channels output channels' number : 3 (RGB) or 4 (RGBA)
+     */
+    void apply ( uint8_t* to, const float* from, int length, int channels );
+
+    /**
+     * \~french \brief Nombre d'entrées de la table de correspondance
+     * \~english \brief Lookup table entries' number
+     */
+    size_t getLUTSize() {
+        return lut.size();
+    }
+    /**
+     * \~french \brief Pas de la table de correspondance
+     * \~english \brief Lookup table step
+     */
+    double getLUTStep() {
+        return 1. / lutInvStep;
+    }
+    /**
+     * \~french
+     * \brief Écart maximal entre la table de correspondance et getColour
+     * \details Borne, en niveaux de couleur avant troncature, de l'écart sur les canaux interpolés pour une valeur quelconque. Il est nul pour les valeurs entières tant que le pas vaut au plus 1.
+     * \~english
+     * \brief Max gap between lookup table and getColour
+     * \details Bound, in colour levels before truncation, of the gap on interpolated channels for any value. It is null for integer values as long as step is at most 1.
+     */
+    double getLUTError() {
+        return lutError;
+    }
+
 };
 
 
@@ -40,6 +40,7 @@
 #include "byteswap.h"
 #include "zlib.h"
 #include <string.h>
+#include <stdio.h>
 
 //TODO modification du header : 25 | Colour type  passage de 0 à 2
 //TODO ajout de la palette
@@ -118,6 +119,21 @@ const uint8_t* PaletteDataSource::getData ( size_t& size ) {
     return dataSource->getData ( size );
 }
 
+std::string PaletteDataSource::getTag ( ) {
+    return buildTag ( dataSource->getTag(), palette );
+}
+
+std::string PaletteDataSource::buildTag ( std::string tag, Palette* palette ) {
+    if ( tag.empty() || ! palette || palette->getPalettePNGSize() == 0 ) {
+        return tag;
+    }
+    uLong crc = crc32 ( 0, Z_NULL, 0 );
+    crc = crc32 ( crc, palette->getPalettePNG(), palette->getPalettePNGSize() );
+    char suffix[16];
+    snprintf ( suffix, sizeof ( suffix ), "-%08lx", ( unsigned long ) crc );
+    return tag + suffix;
+}
+
 unsigned int PaletteDataSource::getLength ( ) {
     if ( palette->getPalettePNGSize() !=0 ) {
         return dataSize;
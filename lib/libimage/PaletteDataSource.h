@@ -71,6 +71,19 @@ public:
     inline std::string getEncoding()                {
         return dataSource->getEncoding();
     }
+    inline time_t getModification()             {
+        return dataSource->getModification();
+    }
+    virtual std::string getTag();
+
+    /**
+     * Identifiant d'une tuile PNG une fois la palette appliquée.
+     * @param tag identifiant de la tuile source
+     * @param palette palette appliquée, peut être nulle
+     * @return identifiant de la source complété par l'empreinte de la palette (CRC du bloc PLTE), vide si celui de la source l'est
+     */
+    static std::string buildTag ( std::string tag, Palette* palette );
+
     virtual unsigned int getLength();
     virtual const uint8_t* getData ( size_t& size );
     virtual ~PaletteDataSource();
@@ -38,35 +38,14 @@
 #ifndef PENTEIMAGE_H
 #define PENTEIMAGE_H
 
-#include "Image.h"
+#include "TerrainImage.h"
 #include <string>
 
 
-class PenteImage : public Image {
+class PenteImage : public TerrainImage {
 
 private:
 
-    /** \~french
-    * \brief Image d'origine utilisée pour calculer la pente
-    ** \~english
-    * \brief Origin image used to compute the slope
-    */
-    Image* origImage;
-
-    /** \~french
-    * \brief Buffer contenant la pente calculée
-    ** \~english
-    * \brief Buffer of the slope
-    */
-    uint8_t* pente;
-
-    /** \~french
-    * \brief Buffer temporaire
-    ** \~english
-    * \brief Temporary buffer
-    */
-    float* bufferTmp;
-
     /** \~french
     * \brief Résolution de l'image d'origine et donc finale en X
     ** \~english
@@ -116,88 +95,15 @@ private:
     */
     int maxSlope;
 
-
-
-
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    int _getline ( uint8_t* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    int _getline ( uint16_t* buffer, int line );
-
     /** \~french
-    * \brief Récupère la ligne
+    * \brief Calcule une ligne de l'image de la pente
     ** \~english
-    * \brief Get line
+    * \brief Compute one line of the slope
     */
-    int _getline ( float* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne dans l'image d'origine
-    ** \~english
-    * \brief Get line in origin image
-    */
-    int getOrigLine ( uint8_t* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne dans l'image d'origine
-    ** \~english
-    * \brief Get line in origin image
-    */
-    int getOrigLine ( uint16_t* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne dans l'image d'origine
-    ** \~english
-    * \brief Get line in origin image
-    */
-    int getOrigLine ( float* buffer, int line );
-
-    /** \~french
-    * \brief Génére l'image de la pente
-    ** \~english
-    * \brief Generate slope
-    */
-    void generate();
-
-    /** \~french
-    * \brief Génére une ligne de l'image de la pente
-    ** \~english
-    * \brief Generate one line of the slope
-    */
-    void generateLine ( int line, float* line1, float* line2 , float* line3 );
+    void computeLine();
 
 public:
 
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    virtual int getline ( float* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    virtual int getline ( uint8_t* buffer, int line );
-
-    /** \~french
-    * \brief Récupère la ligne
-    ** \~english
-    * \brief Get line
-    */
-    virtual int getline ( uint16_t* buffer, int line );
-
     /** \~french
     * \brief Constructeur
     ** \~english
@@ -210,7 +116,7 @@ public:
     ** \~english
     * \brief Destructor
     */
-    virtual ~PenteImage();
+    virtual ~PenteImage() {}
 
 };
 
@@ -0,0 +1,208 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file ProjCache.cpp
+ ** \~french
+ * \brief Implémentation de la classe ProjCache
+ ** \~english
+ * \brief Implements class ProjCache
+ */
+
+#include "ProjCache.h"
+
+std::list<ProjCacheElement*> ProjCache::mru;
+std::multimap<std::string, std::list<ProjCacheElement*>::iterator> ProjCache::book;
+pthread_mutex_t ProjCache::mtx = PTHREAD_MUTEX_INITIALIZER;
+size_t ProjCache::maxSize = PROJ_CACHE_DEFAULT_SIZE;
+uint64_t ProjCache::hits = 0;
+uint64_t ProjCache::misses = 0;
+
+ProjCacheElement* ProjCache::create ( std::string from_srs, std::string to_srs, bool verbose ) {
+
+    ProjCacheElement* pce = new ProjCacheElement ( getKey ( from_srs, to_srs ) );
+
+    if ( ! ( pce->src = pj_init_plus_ctx ( pce->ctx, ( "+init=" + from_srs +" +wktext" ).c_str() ) ) ) {
+        // Initialisation du système de projection source
+        if ( verbose ) {
+            int err = pj_ctx_get_errno ( pce->ctx );
+            char *msg = pj_strerrno ( err );
+            LOGGER_ERROR ( "erreur d initialisation " << from_srs << " " << msg );
+        }
+        delete pce;
+        return NULL;
+    }
+
+    if ( to_srs != "" && ! ( pce->dst = pj_init_plus_ctx ( pce->ctx, ( "+init=" + to_srs +" +wktext +over" ).c_str() ) ) ) {
+        // Initialisation du système de projection destination
+        if ( verbose ) {
+            int err = pj_ctx_get_errno ( pce->ctx );
+            char *msg = pj_strerrno ( err );
+            LOGGER_ERROR ( "erreur d initialisation " << to_srs << " " << msg );
+        }
+        delete pce;
+        return NULL;
+    }
+
+    return pce;
+}
+
+void ProjCache::removeOldest () {
+    std::list<ProjCacheElement*>::iterator last = --mru.end();
+    ProjCacheElement* pce = *last;
+
+    std::pair<std::multimap<std::string, std::list<ProjCacheElement*>::iterator>::iterator,
+        std::multimap<std::string, std::list<ProjCacheElement*>::iterator>::iterator> range = book.equal_range ( pce->key );
+    for ( std::multimap<std::string, std::list<ProjCacheElement*>::iterator>::iterator it = range.first; it != range.second; it++ ) {
+        if ( it->second == last ) {
+            book.erase ( it );
+            break;
+        }
+    }
+
+    mru.erase ( last );
+    delete pce;
+}
+
+void ProjCache::setCacheSize ( int size ) {
+    if ( size < 0 ) size = 0;
+    pthread_mutex_lock ( &mtx );
+    maxSize = size;
+    while ( mru.size() > maxSize ) {
+        removeOldest();
+    }
+    pthread_mutex_unlock ( &mtx );
+}
+
+ProjCacheElement* ProjCache::acquire ( std::string from_srs, std::string to_srs, bool verbose ) {
+
+    pthread_mutex_lock ( &mtx );
+
+    std::multimap<std::string, std::list<ProjCacheElement*>::iterator>::iterator it = book.find ( getKey ( from_srs, to_srs ) );
+    if ( it != book.end() ) {
+        ProjCacheElement* pce = * ( it->second );
+        mru.erase ( it->second );
+        book.erase ( it );
+        hits++;
+        pthread_mutex_unlock ( &mtx );
+        return pce;
+    }
+
+    misses++;
+    pthread_mutex_unlock ( &mtx );
+
+    // L'initialisation, coûteuse, se fait hors verrou : chaque élément a son propre contexte PROJ
+    return create ( from_srs, to_srs, verbose );
+}
+
+void ProjCache::release ( ProjCacheElement* element ) {
+
+    if ( element == NULL ) return;
+
+    pthread_mutex_lock ( &mtx );
+
+    if ( maxSize == 0 ) {
+        pthread_mutex_unlock ( &mtx );
+        delete element;
+        return;
+    }
+
+    // Une erreur éventuelle de la dernière utilisation ne doit pas être vue par la suivante
+    pj_ctx_set_errno ( element->ctx, 0 );
+
+    mru.push_front ( element );
+    book.insert ( std::pair<std::string, std::list<ProjCacheElement*>::iterator> ( element->key, mru.begin() ) );
+
+    while ( mru.size() > maxSize ) {
+        removeOldest();
+    }
+
+    pthread_mutex_unlock ( &mtx );
+}
+
+bool ProjCache::warm ( std::string from_srs, std::string to_srs ) {
+
+    pthread_mutex_lock ( &mtx );
+    bool present = ( book.find ( getKey ( from_srs, to_srs ) ) != book.end() );
+    pthread_mutex_unlock ( &mtx );
+
+    if ( present ) return true;
+
+    ProjCacheElement* pce = create ( from_srs, to_srs, true );
+    if ( pce == NULL ) return false;
+
+    release ( pce );
+    return true;
+}
+
+uint64_t ProjCache::getHits () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t h = hits;
+    pthread_mutex_unlock ( &mtx );
+    return h;
+}
+
+uint64_t ProjCache::getMisses () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t m = misses;
+    pthread_mutex_unlock ( &mtx );
+    return m;
+}
+
+int ProjCache::getElementsNumber () {
+    pthread_mutex_lock ( &mtx );
+    int n = mru.size();
+    pthread_mutex_unlock ( &mtx );
+    return n;
+}
+
+void ProjCache::printStats () {
+    pthread_mutex_lock ( &mtx );
+    LOGGER_INFO ( "Cache des transformations PROJ : " << mru.size() << " / " << maxSize << " transformations disponibles" );
+    LOGGER_INFO ( "\t- réutilisations = " << hits << ", initialisations = " << misses );
+    pthread_mutex_unlock ( &mtx );
+}
+
+void ProjCache::cleanCache () {
+    pthread_mutex_lock ( &mtx );
+    while ( ! mru.empty() ) {
+        removeOldest();
+    }
+    hits = 0;
+    misses = 0;
+    pthread_mutex_unlock ( &mtx );
+}
@@ -0,0 +1,304 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file ProjCache.h
+ ** \~french
+ * \brief Définition des classes ProjCache et ProjCacheElement
+ ** \~english
+ * \brief Define classes ProjCache and ProjCacheElement
+ */
+
+#ifndef PROJCACHE_H
+#define PROJCACHE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <list>
+#include <map>
+#include <string>
+#include <proj_api.h>
+#include "Logger.h"
+
+/**
+ * \~french \brief Nombre maximal de transformations inutilisées gardées par défaut
+ * \~english \brief Default max number of kept unused transformations
+ */
+#define PROJ_CACHE_DEFAULT_SIZE 256
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Transformation PROJ initialisée
+ * \details Les systèmes source et destination sont initialisés dans un contexte PROJ propre à l'élément. Un élément n'est utilisé que par un thread à la fois, entre ProjCache::acquire et ProjCache::release.
+ *
+ * Si la destination est vide, seul le système source est initialisé (pour interroger un CRS).
+ * \~english
+ * \brief Initialized PROJ transformation
+ * \details Source and destination systems are initialized in a PROJ context owned by the element. An element is used by one thread at a time, between ProjCache::acquire and ProjCache::release.
+ *
+ * If destination is empty, only the source system is initialized (to query a CRS).
+ */
+class ProjCacheElement {
+
+    friend class ProjCache;
+
+private:
+
+    /**
+     * \~french \brief Clé de l'élément dans le cache
+     * \~english \brief Element's key in the cache
+     */
+    std::string key;
+
+    /**
+     * \~french \brief Contexte PROJ de l'élément
+     * \~english \brief Element's PROJ context
+     */
+    projCtx ctx;
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \details Les systèmes sont initialisés par ProjCache::create
+     * \~english
+     * \brief Constructor
+     * \details Systems are initialized by ProjCache::create
+     */
+    ProjCacheElement ( std::string k ) : key ( k ), src ( NULL ), dst ( NULL ) {
+        ctx = pj_ctx_alloc();
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~ProjCacheElement() {
+        if ( dst ) pj_free ( dst );
+        if ( src ) pj_free ( src );
+        pj_ctx_free ( ctx );
+    }
+
+public:
+
+    /**
+     * \~french \brief Système spatial source
+     * \~english \brief Source spatial reference system
+     */
+    projPJ src;
+
+    /**
+     * \~french \brief Système spatial destination, NULL si aucun n'a été demandé
+     * \~english \brief Destination spatial reference system, NULL if none was asked
+     */
+    projPJ dst;
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Cache des transformations PROJ initialisées, partagé par tous les threads
+ * \details Cette classe est prévue pour être utilisée sans instance, à la manière de IndexCache.
+ *
+ * Initialiser un système avec "+init=..." demande de relire et d'interpréter les fichiers de définitions de PROJ. En réutilisant les transformations d'une requête à l'autre, une reprojection ne coûte plus que les calculs de points.
+ *
+ * Les éléments sont identifiés par le couple (source, destination). Chaque élément n'étant utilisé que par un thread à la fois, plusieurs éléments peuvent exister pour un même couple : le cache en garde autant que de threads les ayant utilisés simultanément. Le nombre d'éléments inutilisés est borné, les moins récemment rendus sont supprimés en premier.
+ * \~english
+ * \brief Initialized PROJ transformations cache, shared by all threads
+ * \details This class is intended to be used without instance, like IndexCache.
+ *
+ * To initialize a system with "+init=...", PROJ has to read and parse definition files again. Reusing transformations from one request to another, a reprojection costs only the points' computation.
+ *
+ * Elements are identified by the couple (source, destination). Each element being used by only one thread at a time, several elements can exist for the same couple : cache keeps as many as threads using them simultaneously. Unused elements' number is bounded, least recently given back are removed first.
+ */
+class ProjCache {
+
+private:
+
+    /**
+     * \~french \brief Éléments inutilisés, du plus récemment rendu au plus ancien
+     * \~english \brief Unused elements, from the most recently given back to the oldest
+     */
+    static std::list<ProjCacheElement*> mru;
+
+    /**
+     * \~french \brief Annuaire des éléments inutilisés, pour un accès par clé
+     * \~english \brief Unused elements book, for an access by key
+     */
+    static std::multimap<std::string, std::list<ProjCacheElement*>::iterator> book;
+
+    /**
+     * \~french \brief Exclusion mutuelle pour l'accès au cache
+     * \~english \brief Mutex for the cache access
+     */
+    static pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Nombre maximal d'éléments inutilisés gardés
+     * \~english \brief Max number of kept unused elements
+     */
+    static size_t maxSize;
+
+    /**
+     * \~french \brief Nombre de transformations obtenues depuis le cache
+     * \~english \brief Number of transformations got from the cache
+     */
+    static uint64_t hits;
+
+    /**
+     * \~french \brief Nombre de transformations initialisées
+     * \~english \brief Number of initialized transformations
+     */
+    static uint64_t misses;
+
+    /**
+     * \~french \brief Calcule la clé d'une transformation
+     * \~english \brief Compute the transformation's key
+     */
+    static std::string getKey ( std::string from_srs, std::string to_srs ) {
+        return from_srs + " " + to_srs;
+    }
+
+    /**
+     * \~french \brief Initialise une nouvelle transformation, sans verrou
+     * \return La transformation, NULL si un des systèmes n'a pas pu être initialisé
+     * \~english \brief Initialize a new transformation, without lock
+     * \return The transformation, NULL if one of systems cannot be initialized
+     */
+    static ProjCacheElement* create ( std::string from_srs, std::string to_srs, bool verbose );
+
+    /**
+     * \~french \brief Supprime le plus ancien élément inutilisé
+     * \details L'appelant doit avoir verrouillé #mtx
+     * \~english \brief Remove the oldest unused element
+     * \details Caller have to lock #mtx
+     */
+    static void removeOldest ();
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \~english
+     * \brief Constructeur
+     */
+    ProjCache(){};
+
+public:
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \~english
+     * \brief Destructor
+     */
+    ~ProjCache(){};
+
+    /**
+     * \~french \brief Définit le nombre maximal d'éléments inutilisés gardés
+     * \details Les éléments en trop sont supprimés. Une taille nulle vide et désactive le cache : chaque transformation est alors initialisée puis libérée.
+     * \param[in] size Nombre d'éléments
+     * \~english \brief Define max number of kept unused elements
+     * \details Elements in excess are removed. A null size empties and disables the cache : each transformation is then initialized then freed.
+     * \param[in] size Elements' number
+     */
+    static void setCacheSize ( int size );
+
+    /**
+     * \~french \brief Obtient une transformation pour l'usage exclusif de l'appelant
+     * \details La transformation doit être rendue avec #release. Les systèmes sont initialisés avec les options "+wktext", la destination avec "+over" en plus.
+     * \param[in] from_srs Code PROJ du système source
+     * \param[in] to_srs Code PROJ du système destination, vide si seul le système source est voulu
+     * \param[in] verbose Précise si les erreurs d'initialisation sont à journaliser
+     * \return La transformation, NULL si un des systèmes n'a pas pu être initialisé
+     * \~english \brief Get a transformation for the caller's exclusive use
+     * \details Transformation have to be given back with #release. Systems are initialized with options "+wktext", destination with "+over" too.
+     * \param[in] from_srs Source system's PROJ code
+     * \param[in] to_srs Destination system's PROJ code, empty if only source system is wanted
+     * \param[in] verbose Precise if initialization errors have to be logged
+     * \return The transformation, NULL if one of systems cannot be initialized
+     */
+    static ProjCacheElement* acquire ( std::string from_srs, std::string to_srs = "", bool verbose = true );
+
+    /**
+     * \~french \brief Rend une transformation obtenue avec #acquire
+     * \~english \brief Give back a transformation from #acquire
+     */
+    static void release ( ProjCacheElement* element );
+
+    /**
+     * \~french \brief Prépare une transformation avant son utilisation
+     * \details Rien n'est fait si une transformation inutilisée existe déjà pour ce couple
+     * \return Vrai si les systèmes sont valides
+     * \~english \brief Prepare a transformation before its use
+     * \details Nothing is done if an unused transformation already exists for this couple
+     * \return True if systems are valid
+     */
+    static bool warm ( std::string from_srs, std::string to_srs = "" );
+
+    /**
+     * \~french \brief Retourne le nombre de transformations obtenues depuis le cache
+     * \~english \brief Return the number of transformations got from the cache
+     */
+    static uint64_t getHits ();
+
+    /**
+     * \~french \brief Retourne le nombre de transformations initialisées
+     * \~english \brief Return the number of initialized transformations
+     */
+    static uint64_t getMisses ();
+
+    /**
+     * \~french \brief Retourne le nombre d'éléments inutilisés gardés
+     * \~english \brief Return the number of kept unused elements
+     */
+    static int getElementsNumber ();
+
+    /**
+     * \~french \brief Affiche les statistiques du cache
+     * \~english \brief Print cache's statistics
+     */
+    static void printStats ();
+
+    /**
+     * \~french \brief Vide le cache et remet les statistiques à zéro
+     * \~english \brief Empty the cache and reset statistics
+     */
+    static void cleanCache ();
+
+};
+
+#endif
@@ -58,6 +58,7 @@
 #include "Logger.h"
 #include "Utils.h"
 #include "Data.h"
+#include "ThreadPool.h"
 #include <fcntl.h>
 #include <iostream>
 #include <string>
@@ -113,6 +114,95 @@ static const uint8_t PNG_HEADER[33] = {
 
 static const uint8_t white[4] = {255,255,255,255};
 
+/* ------------------------------------------------------------------------------------------------ */
+/* ------------------------------------------ COMPRESSION ----------------------------------------- */
+
+Rok4TileCompressor::Rok4TileCompressor ( Compression::eCompression compression, int rawTileSize, int tileWidth, int tileHeight ) :
+    zip_buffer ( NULL ), compression ( compression ) {
+
+    int quality = 0;
+    if ( compression == Compression::PNG) quality = 5;
+    if ( compression == Compression::DEFLATE ) quality = 6;
+    if ( compression == Compression::JPEG ) quality = 75;
+
+    // variables initalizations
+
+    BufferSize = 2*rawTileSize;
+    Buffer = new uint8_t[BufferSize];
+
+    //  z compression initalization
+    if ( compression == Compression::PNG || compression == Compression::DEFLATE ) {
+        if ( compression == Compression::PNG ) {
+            // Pour la compression PNG, on a besoin d'un octet par ligne ne plus : un 0 est ajouté au début de chaque ligne, avant la compression
+            zip_buffer = new uint8_t[rawTileSize + tileHeight];
+        } else {
+            zip_buffer = new uint8_t[rawTileSize];
+        }
+        zstream.zalloc = Z_NULL;
+        zstream.zfree  = Z_NULL;
+        zstream.opaque = Z_NULL;
+        zstream.data_type = Z_BINARY;
+        deflateInit ( &zstream, quality );
+    }
+
+    if ( compression == Compression::JPEG ) {
+        cinfo.err = jpeg_std_error ( &jerr );
+        jpeg_create_compress ( &cinfo );
+
+        cinfo.dest = new jpeg_destination_mgr;
+        cinfo.dest->init_destination = init_destination;
+        cinfo.dest->empty_output_buffer = empty_output_buffer;
+        cinfo.dest->term_destination = term_destination;
+
+        cinfo.image_width  = tileWidth;
+        cinfo.image_height = tileHeight;
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_RGB;
+
+        jpeg_set_defaults ( &cinfo );
+        jpeg_set_quality ( &cinfo, quality, true );
+    }
+}
+
+Rok4TileCompressor::~Rok4TileCompressor() {
+    delete[] Buffer;
+    if ( compression == Compression::PNG || compression == Compression::DEFLATE ) {
+        delete[] zip_buffer;
+        deflateEnd ( &zstream );
+    }
+    if ( compression == Compression::JPEG ) {
+        delete cinfo.dest;
+        jpeg_destroy_compress ( &cinfo );
+    }
+}
+
+/**
+ * \~french \brief Compression d'une tuile, exécutée par le groupe de threads partagé
+ * \details La tâche possède la tuile brute et son compresseur, réutilisés d'une ligne de tuiles à l'autre
+ * \~english \brief Compression of a tile, run by the shared threads pool
+ */
+class TileCompressionTask : public ThreadTask {
+public:
+    Rok4Image* image;
+    Rok4TileCompressor* compressor;
+    uint8_t* data;
+    bool crop;
+    size_t size;
+
+    TileCompressionTask ( Rok4Image* image, Rok4TileCompressor* compressor, int rawTileSize, bool crop ) :
+        image ( image ), compressor ( compressor ), crop ( crop ), size ( 0 ) {
+        data = new uint8_t[rawTileSize];
+    }
+
+    void run() {
+        size = image->compressTile ( compressor, data, crop );
+    }
+
+    ~TileCompressionTask() {
+        delete[] data;
+    }
+};
+
 /* ------------------------------------------------------------------------------------------------ */
 /* ------------------------------------------ CONVERSIONS ----------------------------------------- */
 
@@ -466,6 +556,10 @@ Rok4Image::Rok4Image (
 
     memorizedTilesLine = -1;
 
+    prefetch = true;
+    prefetchedTiles = NULL;
+    prefetchTask = NULL;
+    prefetchGroup = NULL;
 }
 
 Rok4Image::Rok4Image ( std::string n, int tpw, int tph, Context* c ) :
@@ -486,24 +580,130 @@ Rok4Image::Rok4Image ( std::string n, int tpw, int tph, Context* c ) :
     pixelSize = 0;
     rawTileSize = 0;
     rawTileLineSize = 0;
+
+    prefetch = false;
+    prefetchedTiles = NULL;
+    prefetchTask = NULL;
+    prefetchGroup = NULL;
 }
 
 /* ------------------------------------------------------------------------------------------------ */
 /* ------------------------------------------- LECTURE -------------------------------------------- */
 /* ------------------------------------------------------------------------------------------------ */
 
-boolean Rok4Image::memorizeRawTiles ( int tilesLine )
-{    
+/**
+ * \~french \brief Décompression d'une partie des tuiles d'une ligne de tuiles
+ * \details La tâche i décompresse les tuiles i, i + step, i + 2*step...
+ * \~english \brief Uncompression of a part of a tiles line's tiles
+ */
+class TileDecodingTask : public ThreadTask {
+public:
+    Rok4Image* image;
+    const uint8_t* encoded;
+    int firstTileIndex;
+    uint8_t* tiles;
+    int first, step;
+    bool ok, png;
+
+    TileDecodingTask ( Rok4Image* image, const uint8_t* encoded, int firstTileIndex, uint8_t* tiles, int first, int step ) :
+        image ( image ), encoded ( encoded ), firstTileIndex ( firstTileIndex ), tiles ( tiles ), first ( first ), step ( step ), ok ( true ), png ( false ) {}
+
+    void run() {
+        int firstTileOffset = image->tilesOffset[firstTileIndex];
+        for ( int i = first; i < image->tileWidthwise; i += step ) {
+            if (! image->decodeTile ( firstTileIndex + i, encoded + image->tilesOffset[firstTileIndex + i] - firstTileOffset, tiles + i * image->rawTileSize, png )) {
+                ok = false;
+            }
+        }
+    }
+};
 
-    if ( tilesLine < 0 || tilesLine >= tileHeightwise ) {
-        LOGGER_ERROR ( "Unvalid tiles' line indice (" << tilesLine << "). Have to be between 0 and " << tileHeightwise-1 );
+/**
+ * \~french \brief Lecture et décompression d'une ligne de tuiles en tâche de fond
+ * \~english \brief Read and uncompress a tiles line in background
+ */
+class TilesRowPrefetchTask : public ThreadTask {
+public:
+    Rok4Image* image;
+    int tilesLine;
+    uint8_t* tiles;
+    bool ok, png;
+
+    TilesRowPrefetchTask ( Rok4Image* image, int tilesLine, uint8_t* tiles ) :
+        image ( image ), tilesLine ( tilesLine ), tiles ( tiles ), ok ( false ), png ( false ) {}
+
+    void run() {
+        ok = image->loadTilesRow ( tilesLine, tiles, png );
+    }
+};
+
+bool Rok4Image::decodeTile ( int tileIndex, const uint8_t* encoded, uint8_t* raw, bool& png )
+{
+    RawDataSource* encDS = new RawDataSource ( encoded, tilesByteCounts[tileIndex]);
+
+    DataSource* decDS;
+    size_t tmpSize;
+
+    if ( compression == Compression::NONE ) {
+        decDS = encDS;
+    }
+    else if ( compression == Compression::JPEG ) {
+        decDS = new DataSourceDecoder<JpegDecoder> ( encDS );
+    }
+    else if ( compression == Compression::LZW ) {
+        decDS = new DataSourceDecoder<LzwDecoder> ( encDS );
+    }
+    else if ( compression == Compression::PACKBITS ) {
+        decDS = new DataSourceDecoder<PackBitsDecoder> ( encDS );
+    }
+    else if ( compression == Compression::DEFLATE || compression == Compression::PNG ) {
+        /* Avec une telle compression dans l'en-tête TIFF, on peut avoir :
+         *       - des tuiles compressée en deflate (format "officiel")
+         *       - des tuiles en PNG, format propre à ROK4
+         * Pour distinguer les deux cas (pas le même décodeur), on va tester la présence d'un en-tête PNG */
+        const uint8_t* header = encDS->getData(tmpSize);
+        if (header == NULL) {
+            LOGGER_ERROR ( "Cannot read header to discrimine PNG and DEFLATE" );
+            delete encDS;
+            return false;
+        }
+        if (memcmp(PNG_HEADER, header, 8)) {
+            decDS = new DataSourceDecoder<DeflateDecoder> ( encDS );
+        } else {
+            png = true;
+            decDS = new DataSourceDecoder<PngDecoder> ( encDS );
+        }
+    }
+    else {
+        LOGGER_ERROR ( "Unhandled compression : " << compression );
+        delete encDS;
         return false;
     }
 
-    if (memorizedTilesLine == tilesLine) {
-        return true;
+    const uint8_t* dec_data = decDS->getData(tmpSize);
+
+    if (! dec_data || tmpSize == 0) {
+        LOGGER_ERROR("Unable to decompress tile " << tileIndex);
+        delete decDS;
+        return false;
+    } else if (tmpSize != ( size_t ) rawTileSize) {
+        LOGGER_WARN("Raw tile size should have been " << rawTileSize << ", and not " << tmpSize);
+    }
+
+    if ( tmpSize < ( size_t ) rawTileSize ) {
+        // Tuile tronquée : on complète avec des zéros plutôt que de lire au-delà des données décodées
+        memcpy(raw, dec_data, tmpSize );
+        memset(raw + tmpSize, 0, rawTileSize - tmpSize );
+    } else {
+        memcpy(raw, dec_data, rawTileSize );
     }
 
+    delete decDS;
+    return true;
+}
+
+bool Rok4Image::loadTilesRow ( int tilesLine, uint8_t* tiles, bool& png )
+{
     /*
     On va récupérer l'offset de la première tuile de la ligne, ainsi que calculer la taille totale des tuiles de la ligne
     pour faire la lecture en une seule fois.
@@ -521,69 +721,116 @@ boolean Rok4Image::memorizeRawTiles ( int tilesLine )
     const uint8_t* enc_data = totalDS->getData(total_size);
     if (enc_data == NULL) {
         LOGGER_ERROR("Cannot read tiles line data");
+        delete totalDS;
         return false;
     }
 
-    // On va maintenant décompresser chaque tuile pour la stocker au format brut dans le buffer memorizedTiles
-    for (size_t i = 0; i < tileWidthwise; i++) {
-        // Pour avoir l'offset de lecture de la tuile à décoder dans le buffer total, on utilise l'offset dans la dalle, 
-        // en déduisant l'offset de la première tuile (qui correspond au 0 de notre buffer total)
-        RawDataSource* encDS = new RawDataSource ( enc_data + tilesOffset[firstTileIndex + i] - firstTileOffset, tilesByteCounts[firstTileIndex + i]);
-
-        DataSource* decDS;
-        size_t tmpSize;
+    // On va maintenant décompresser chaque tuile pour la stocker au format brut dans le buffer
+    // Les tuiles sont réparties entre plusieurs tâches si le groupe de threads partagé est disponible
+    ThreadPool* pool = ThreadPool::getSharedPool();
+    int nbTasks = 1;
+    if ( pool != NULL ) {
+        // Le thread qui attend participe aussi à la décompression
+        nbTasks = std::min ( tileWidthwise, pool->getThreadsNumber() + 1 );
+    }
 
-        if ( compression == Compression::NONE ) {
-            decDS = encDS;
-        }
-        else if ( compression == Compression::JPEG ) {
-            decDS = new DataSourceDecoder<JpegDecoder> ( encDS );
-        }
-        else if ( compression == Compression::LZW ) {
-            decDS = new DataSourceDecoder<LzwDecoder> ( encDS );
-        }
-        else if ( compression == Compression::PACKBITS ) {
-            decDS = new DataSourceDecoder<PackBitsDecoder> ( encDS );
-        }
-        else if ( compression == Compression::DEFLATE || compression == Compression::PNG ) {
-            /* Avec une telle compression dans l'en-tête TIFF, on peut avoir :
-             *       - des tuiles compressée en deflate (format "officiel")
-             *       - des tuiles en PNG, format propre à ROK4
-             * Pour distinguer les deux cas (pas le même décodeur), on va tester la présence d'un en-tête PNG */
-            const uint8_t* header = encDS->getData(tmpSize);
-            if (header == NULL) {
-                LOGGER_ERROR ( "Cannot read header to discrimine PNG and DEFLATE" );
-                return false;
-            }
-            if (memcmp(PNG_HEADER, header, 8)) {
-                decDS = new DataSourceDecoder<DeflateDecoder> ( encDS );
-            } else {
-                compression = Compression::PNG;
-                decDS = new DataSourceDecoder<PngDecoder> ( encDS );
-            }
+    bool ok = true;
+    if ( nbTasks == 1 ) {
+        TileDecodingTask task ( this, enc_data, firstTileIndex, tiles, 0, 1 );
+        task.run();
+        ok = task.ok;
+        png = png || task.png;
+    } else {
+        std::vector<TileDecodingTask*> tasks;
+        ThreadTaskGroup group;
+        for ( int i = 0; i < nbTasks; i++ ) {
+            TileDecodingTask* task = new TileDecodingTask ( this, enc_data, firstTileIndex, tiles, i, nbTasks );
+            tasks.push_back ( task );
+            pool->submit ( task, &group );
         }
-        else {
-            LOGGER_ERROR ( "Unhandled compression : " << compression );
-            return false;
+        pool->wait ( &group );
+        for ( int i = 0; i < nbTasks; i++ ) {
+            ok = ok && tasks.at(i)->ok;
+            png = png || tasks.at(i)->png;
+            delete tasks.at(i);
         }
+    }
 
-        const uint8_t* dec_data = decDS->getData(tmpSize);
-        
-        if (! dec_data || tmpSize == 0) {
-            LOGGER_ERROR("Unable to decompress tile " << i << " of tiles- line " << tilesLine);
-            return false;
-        } else if (tmpSize != rawTileSize) {
-            LOGGER_WARN("Raw tile size should have been " << rawTileSize << ", and not " << tmpSize);
-        }
+    delete totalDS;
 
-        memcpy(memorizedTiles + i * rawTileSize, dec_data, rawTileSize );
+    if (! ok) {
+        LOGGER_ERROR("Unable to decompress tiles line " << tilesLine);
+    }
+    return ok;
+}
 
-        delete decDS;
+void Rok4Image::waitPrefetch ( int& tilesLine, bool& png )
+{
+    tilesLine = -1;
+    if ( prefetchTask == NULL ) return;
+
+    // Si le groupe partagé a été supprimé entre temps, il a exécuté toutes ses tâches avant de s'arrêter
+    ThreadPool* pool = ThreadPool::getSharedPool();
+    if ( pool != NULL ) pool->wait ( prefetchGroup );
+    if ( prefetchTask->ok ) {
+        tilesLine = prefetchTask->tilesLine;
+        png = png || prefetchTask->png;
     }
+    delete prefetchTask;
+    delete prefetchGroup;
+    prefetchTask = NULL;
+    prefetchGroup = NULL;
+}
 
-    delete totalDS;
+boolean Rok4Image::memorizeRawTiles ( int tilesLine )
+{    
+
+    if ( tilesLine < 0 || tilesLine >= tileHeightwise ) {
+        LOGGER_ERROR ( "Unvalid tiles' line indice (" << tilesLine << "). Have to be between 0 and " << tileHeightwise-1 );
+        return false;
+    }
+
+    if (memorizedTilesLine == tilesLine) {
+        return true;
+    }
+
+    int previousTilesLine = memorizedTilesLine;
+    bool png = false;
+    bool ok;
+
+    // La ligne de tuiles a peut être été préparée en tâche de fond
+    int prefetchedTilesLine;
+    waitPrefetch ( prefetchedTilesLine, png );
+    if ( prefetchedTilesLine == tilesLine ) {
+        uint8_t* tmp = memorizedTiles;
+        memorizedTiles = prefetchedTiles;
+        prefetchedTiles = tmp;
+        ok = true;
+    } else {
+        ok = loadTilesRow ( tilesLine, memorizedTiles, png );
+    }
+
+    if ( png ) compression = Compression::PNG;
+
+    if (! ok) {
+        // Le buffer a pu être partiellement écrasé
+        memorizedTilesLine = -1;
+        return false;
+    }
 
     memorizedTilesLine = tilesLine;
+
+    // Lecture séquentielle : on prépare la ligne de tuiles suivante pendant la lecture de celle-ci
+    ThreadPool* pool = ThreadPool::getSharedPool();
+    if ( prefetch && pool != NULL && tilesLine == previousTilesLine + 1 && tilesLine + 1 < tileHeightwise ) {
+        if ( prefetchedTiles == NULL ) {
+            prefetchedTiles = new uint8_t[tileWidthwise * rawTileSize];
+        }
+        prefetchTask = new TilesRowPrefetchTask ( this, tilesLine + 1, prefetchedTiles );
+        prefetchGroup = new ThreadTaskGroup();
+        pool->submit ( prefetchTask, prefetchGroup );
+    }
+
     return true;
 }
 
@@ -718,104 +965,110 @@ int Rok4Image::writeImage ( Image* pIn, bool crop )
         return -1;
     }
 
-    int imageLineSize = width * channels;
-    int tileLineSize = tileWidth * channels;
-    uint8_t* tile = new uint8_t[tileHeight*rawTileLineSize];
-
     // Ecriture de l'image
+    bool ok = false;
     if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
-        uint8_t* lines = new uint8_t[tileHeight*imageLineSize];
+        ok = _writeImage<uint8_t> ( pIn, crop );
+    } else if ( bitspersample == 16 && sampleformat == SampleFormat::UINT ) {
+        ok = _writeImage<uint16_t> ( pIn, crop );
+    } else if ( bitspersample == 32 && sampleformat == SampleFormat::FLOAT ) {
+        ok = _writeImage<float> ( pIn, crop );
+    }
 
-        for ( int y = 0; y < tileHeightwise; y++ ) {
-            // On récupère toutes les lignes pour cette ligne de tuiles
-            for (int lig = 0; lig < tileHeight; lig++) {
-                if (pIn->getline(lines + lig*imageLineSize, y*tileHeight + lig) == 0) {
-                    LOGGER_ERROR("Error reading the source image's line " << y*tileHeight + lig);
-                    return -1;                    
-                }
-            }
-            for ( int x = 0; x < tileWidthwise; x++ ) {
-                // On constitue la tuile
-                for (int lig = 0; lig < tileHeight; lig++) {
-                    memcpy(tile + lig*rawTileLineSize, lines + lig*imageLineSize + x*tileLineSize, rawTileLineSize);
-                }
-                int tileInd = y*tileWidthwise + x;
+    if (! ok) {
+        cleanBuffers();
+        return -1;
+    }
 
-                if (! writeTile(tileInd, tile, crop)) {
-                    LOGGER_ERROR("Error writting tile " << tileInd << " for ROK4 image " << name);
-                    return -1;
-                }
+    if (! writeFinal()) {
+        LOGGER_ERROR("Cannot close the ROK4 images (write index) for " << name);
+        return -1;
+    }
+
+    if (! cleanBuffers()) {
+        LOGGER_ERROR("Cannot clean buffers for " << name);
+        return -1;
+    }
+    
+    return 0;
+}
+
+template<typename T>
+bool Rok4Image::_writeImage ( Image* pIn, bool crop )
+{
+    int imageLineSize = width * channels;
+    int tileLineSize = tileWidth * channels;
+    T* lines = new T[tileHeight*imageLineSize];
+
+    // Sans groupe de threads, une seule tâche exécutée sur place, avec le compresseur de l'image.
+    // Sinon, deux lignes de tuiles de tâches : l'une est compressée pendant que l'autre est écrite puis remplie
+    ThreadPool* pool = ThreadPool::getSharedPool();
+    bool parallel = ( pool != NULL && tilesNumber > 1 );
+    int nbTasks = parallel ? 2 * tileWidthwise : 1;
+    std::vector<TileCompressionTask*> tasks;
+    for ( int i = 0; i < nbTasks; i++ ) {
+        Rok4TileCompressor* c = ( i == 0 ) ? compressor : new Rok4TileCompressor ( compression, rawTileSize, tileWidth, tileHeight );
+        tasks.push_back ( new TileCompressionTask ( this, c, rawTileSize, crop ) );
+    }
+    ThreadTaskGroup groups[2];
+
+    bool ok = true;
+    for ( int y = 0; y < tileHeightwise && ok; y++ ) {
+        // On récupère toutes les lignes pour cette ligne de tuiles
+        for (int lig = 0; lig < tileHeight; lig++) {
+            if (pIn->getline(lines + lig*imageLineSize, y*tileHeight + lig) == 0) {
+                LOGGER_ERROR("Error reading the source image's line " << y*tileHeight + lig);
+                ok = false;
+                break;
             }
         }
-        
-        delete [] lines;
-    } else if ( bitspersample == 16 && sampleformat == SampleFormat::UINT ) {
-        uint16_t* lines = new uint16_t[tileHeight*imageLineSize];
-        
-        for ( int y = 0; y < tileHeightwise; y++ ) {
-            // On récupère toutes les lignes pour cette ligne de tuiles
+        if (! ok) break;
+
+        for ( int x = 0; x < tileWidthwise; x++ ) {
+            TileCompressionTask* task = parallel ? tasks.at ( ( y % 2 ) * tileWidthwise + x ) : tasks.at ( 0 );
+            // On constitue la tuile
             for (int lig = 0; lig < tileHeight; lig++) {
-                if (pIn->getline(lines + lig*imageLineSize, y*tileHeight + lig) == 0) {
-                    LOGGER_ERROR("Error reading the source image's line " << y*tileHeight + lig);
-                    return -1;                    
-                }
+                memcpy(task->data + lig*rawTileLineSize, lines + lig*imageLineSize + x*tileLineSize, rawTileLineSize);
             }
-            for ( int x = 0; x < tileWidthwise; x++ ) {
-                // On constitue la tuile
-                for (int lig = 0; lig < tileHeight; lig++) {
-                    memcpy(tile + lig*rawTileLineSize, lines + lig*imageLineSize + x*tileLineSize, rawTileLineSize);
-                }
 
-                int tileInd = y*tileWidthwise + x;
-
-                if (! writeTile(tileInd, tile, crop)) {
-                    LOGGER_ERROR("Error writting tile " << tileInd << " for ROK4 image " << name);
-                    return -1;
+            if ( parallel ) {
+                pool->submit ( task, &groups[y % 2] );
+            } else {
+                task->run();
+                if (! writeCompressedTile(y*tileWidthwise + x, task->compressor->Buffer, task->size)) {
+                    ok = false;
+                    break;
                 }
             }
         }
-        delete [] lines;
-    } else if ( bitspersample == 32 && sampleformat == SampleFormat::FLOAT ) {
-        float* lines = new float[tileHeight*imageLineSize];
-        
-        for ( int y = 0; y < tileHeightwise; y++ ) {
-            // On récupère toutes les lignes pour cette ligne de tuiles
-            for (int lig = 0; lig < tileHeight; lig++) {
-                if (pIn->getline(lines + lig*imageLineSize, y*tileHeight + lig) == 0) {
-                    LOGGER_ERROR("Error reading the source image's line " << y*tileHeight + lig);
-                    return -1;                    
-                }
-            }
-            for ( int x = 0; x < tileWidthwise; x++ ) {
-                // On constitue la tuile
-                for (int lig = 0; lig < tileHeight; lig++) {
-                    memcpy(tile + lig*rawTileLineSize, lines + lig*imageLineSize + x*tileLineSize, rawTileLineSize);
-                }
-
-                int tileInd = y*tileWidthwise + x;
 
-                if (! writeTile(tileInd, tile, crop)) {
-                    LOGGER_ERROR("Error writting tile " << tileInd << " for ROK4 image " << name);
-                    return -1;
-                }
+        // La ligne de tuiles précédente est écrite pendant la compression de celle-ci
+        if ( parallel && y > 0 ) {
+            pool->wait ( &groups[(y-1) % 2] );
+            for ( int x = 0; x < tileWidthwise && ok; x++ ) {
+                TileCompressionTask* task = tasks.at ( ( ( y-1 ) % 2 ) * tileWidthwise + x );
+                ok = writeCompressedTile((y-1)*tileWidthwise + x, task->compressor->Buffer, task->size);
             }
         }
-        delete [] lines;
     }
-    
-    delete [] tile;
 
-    if (! writeFinal()) {
-        LOGGER_ERROR("Cannot close the ROK4 images (write index) for " << name);
-        return -1;
+    if ( parallel ) {
+        pool->wait ( &groups[0] );
+        pool->wait ( &groups[1] );
+        int y = tileHeightwise - 1;
+        for ( int x = 0; x < tileWidthwise && ok; x++ ) {
+            TileCompressionTask* task = tasks.at ( ( y % 2 ) * tileWidthwise + x );
+            ok = writeCompressedTile(y*tileWidthwise + x, task->compressor->Buffer, task->size);
+        }
     }
 
-    if (! cleanBuffers()) {
-        LOGGER_ERROR("Cannot clean buffers for " << name);
-        return -1;
+    for ( int i = 0; i < nbTasks; i++ ) {
+        if ( i != 0 ) delete tasks.at(i)->compressor;
+        delete tasks.at(i);
     }
-    
-    return 0;
+    delete [] lines;
+
+    return ok;
 }
 
 int Rok4Image::writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory )
@@ -998,48 +1251,7 @@ bool Rok4Image::prepareBuffers()
     position = ROK4_IMAGE_HEADER_SIZE + 8 * tilesNumber;
 
     if (! isVector) {
-        int quality = 0;
-        if ( compression == Compression::PNG) quality = 5;
-        if ( compression == Compression::DEFLATE ) quality = 6;
-        if ( compression == Compression::JPEG ) quality = 75;
-
-        // variables initalizations
-
-        BufferSize = 2*rawTileSize;
-        Buffer = new uint8_t[BufferSize];
-
-        //  z compression initalization
-        if ( compression == Compression::PNG || compression == Compression::DEFLATE ) {
-            if ( compression == Compression::PNG ) {
-                // Pour la compression PNG, on a besoin d'un octet par ligne ne plus : un 0 est ajouté au début de chaque ligne, avant la compression
-                zip_buffer = new uint8_t[rawTileSize + tileHeight];
-            } else {
-                zip_buffer = new uint8_t[rawTileSize];            
-            }
-            zstream.zalloc = Z_NULL;
-            zstream.zfree  = Z_NULL;
-            zstream.opaque = Z_NULL;
-            zstream.data_type = Z_BINARY;
-            deflateInit ( &zstream, quality );
-        }
-
-        if ( compression == Compression::JPEG ) {
-            cinfo.err = jpeg_std_error ( &jerr );
-            jpeg_create_compress ( &cinfo );
-
-            cinfo.dest = new jpeg_destination_mgr;
-            cinfo.dest->init_destination = init_destination;
-            cinfo.dest->empty_output_buffer = empty_output_buffer;
-            cinfo.dest->term_destination = term_destination;
-
-            cinfo.image_width  = tileWidth;
-            cinfo.image_height = tileHeight;
-            cinfo.input_components = 3;
-            cinfo.in_color_space = JCS_RGB;
-
-            jpeg_set_defaults ( &cinfo );
-            jpeg_set_quality ( &cinfo, quality, true );
-        }
+        compressor = new Rok4TileCompressor ( compression, rawTileSize, tileWidth, tileHeight );
     }
 
     return true;
@@ -1061,15 +1273,7 @@ bool Rok4Image::writeFinal() {
 bool Rok4Image::cleanBuffers() {
 
     if (! isVector) {
-        delete[] Buffer;
-        if ( compression == Compression::PNG || compression == Compression::DEFLATE ) {
-            delete[] zip_buffer;
-            deflateEnd ( &zstream );
-        }
-        if ( compression == Compression::JPEG ) {
-            delete cinfo.dest;
-            jpeg_destroy_compress ( &cinfo );
-        }
+        delete compressor;
     }
 
     return true;
@@ -1084,31 +1288,37 @@ bool Rok4Image::writeTile( int tileInd, uint8_t* data, bool crop )
         return false;
     }
 
-    size_t size;
+    size_t size = compressTile ( compressor, data, crop );
 
+    return writeCompressedTile ( tileInd, compressor->Buffer, size );
+}
 
+size_t Rok4Image::compressTile ( Rok4TileCompressor* compressor, uint8_t* data, bool crop )
+{
     switch ( compression ) {
     case Compression::NONE:
-        size = computeRawTile ( Buffer, data );
-        break;
+        return computeRawTile ( compressor, data );
     case Compression::LZW :
-        size = computeLzwTile ( Buffer, data );
-        break;
+        return computeLzwTile ( compressor, data );
     case Compression::JPEG:
-        size = computeJpegTile ( Buffer, data, crop );
-        break;
+        return computeJpegTile ( compressor, data, crop );
     case Compression::PNG :
-        size = computePngTile ( Buffer, data );
-        break;
+        return computePngTile ( compressor, data );
     case Compression::PACKBITS :
-        size = computePackbitsTile ( Buffer, data );
-        break;
+        return computePackbitsTile ( compressor, data );
     case Compression::DEFLATE :
-        size = computeDeflateTile ( Buffer, data );
-        break;
+        return computeDeflateTile ( compressor, data );
+    default:
+        return 0;
     }
+}
 
-    if ( size == 0 ) return false;
+bool Rok4Image::writeCompressedTile ( int tileInd, uint8_t* buffer, size_t size )
+{
+    if ( size == 0 ) {
+        LOGGER_ERROR("Error writting tile " << tileInd << " for ROK4 image " << name);
+        return false;
+    }
 
     if ( tilesNumber == 1 ) {
 
@@ -1122,7 +1332,7 @@ bool Rok4Image::writeTile( int tileInd, uint8_t* data, bool crop )
     tilesOffset[tileInd] = position;
     tilesByteCounts[tileInd] = size;
 
-    boolean ret = context->write(Buffer, position, size, std::string(name));
+    boolean ret = context->write(buffer, position, size, std::string(name));
 
     if (! ret) {
         LOGGER_ERROR("Impossible to write the tile " << tileInd);
@@ -1196,30 +1406,30 @@ bool Rok4Image::writeTile( int tileInd, char* pbfpath )
     return true;
 }
 
-size_t Rok4Image::computeRawTile ( uint8_t *buffer, uint8_t *data ) {
-    memcpy ( buffer, data, rawTileSize );
+size_t Rok4Image::computeRawTile ( Rok4TileCompressor* compressor, uint8_t *data ) {
+    memcpy ( compressor->Buffer, data, rawTileSize );
     return rawTileSize;
 }
 
-size_t Rok4Image::computeLzwTile ( uint8_t *buffer, uint8_t *data ) {
+size_t Rok4Image::computeLzwTile ( Rok4TileCompressor* compressor, uint8_t *data ) {
 
     size_t outSize;
 
     lzwEncoder LZWE;
     uint8_t* temp = LZWE.encode ( data, rawTileSize, outSize );
 
-    if ( outSize > BufferSize ) {
-        delete[] Buffer;
-        BufferSize = outSize * 2;
-        Buffer = new uint8_t[BufferSize];
+    if ( outSize > compressor->BufferSize ) {
+        delete[] compressor->Buffer;
+        compressor->BufferSize = outSize * 2;
+        compressor->Buffer = new uint8_t[compressor->BufferSize];
     }
-    memcpy ( buffer,temp,outSize );
+    memcpy ( compressor->Buffer,temp,outSize );
     delete [] temp;
 
     return outSize;
 }
 
-size_t Rok4Image::computePackbitsTile ( uint8_t *buffer, uint8_t *data ) {
+size_t Rok4Image::computePackbitsTile ( Rok4TileCompressor* compressor, uint8_t *data ) {
 
     uint8_t* pkbBuffer = new uint8_t[rawTileLineSize*tileHeight*2];
     size_t pkbBufferSize = 0;
@@ -1236,15 +1446,17 @@ size_t Rok4Image::computePackbitsTile ( uint8_t *buffer, uint8_t *data ) {
         delete[] pkbLine;
     }
 
-    memcpy ( buffer,pkbBuffer,pkbBufferSize );
+    memcpy ( compressor->Buffer,pkbBuffer,pkbBufferSize );
     delete[] pkbBuffer;
     delete[] rawLine;
 
     return pkbBufferSize;
 }
 
-size_t Rok4Image::computePngTile ( uint8_t *buffer, uint8_t *data ) {
-    uint8_t *B = zip_buffer;
+size_t Rok4Image::computePngTile ( Rok4TileCompressor* compressor, uint8_t *data ) {
+    uint8_t *buffer = compressor->Buffer;
+    z_stream& zstream = compressor->zstream;
+    uint8_t *B = compressor->zip_buffer;
     for ( unsigned int h = 0; h < tileHeight; h++ ) {
         *B++ = 0; // on met un 0 devant chaque ligne (spec png -> mode de filtrage simple)
         memcpy ( B, data + h*rawTileLineSize, rawTileLineSize );
@@ -1270,7 +1482,7 @@ size_t Rok4Image::computePngTile ( uint8_t *buffer, uint8_t *data ) {
 
     zstream.next_out  = buffer + sizeof ( PNG_HEADER ) + 8;
     zstream.avail_out = 2*rawTileSize - 12 - sizeof ( PNG_HEADER ) - sizeof ( PNG_IEND );
-    zstream.next_in   = zip_buffer;
+    zstream.next_in   = compressor->zip_buffer;
     zstream.avail_in  = rawTileSize + tileHeight;
 
     if ( deflateReset ( &zstream ) != Z_OK ) return -1;
@@ -1290,15 +1502,17 @@ size_t Rok4Image::computePngTile ( uint8_t *buffer, uint8_t *data ) {
     return zstream.total_out + 12 + sizeof ( PNG_IEND ) + sizeof ( PNG_HEADER );
 }
 
-size_t Rok4Image::computeDeflateTile ( uint8_t *buffer, uint8_t *data ) {
-    uint8_t *B = zip_buffer;
+size_t Rok4Image::computeDeflateTile ( Rok4TileCompressor* compressor, uint8_t *data ) {
+    uint8_t *buffer = compressor->Buffer;
+    z_stream& zstream = compressor->zstream;
+    uint8_t *B = compressor->zip_buffer;
     for ( unsigned int h = 0; h < tileHeight; h++ ) {
         memcpy ( B, data + h*rawTileLineSize, rawTileLineSize );
         B += rawTileLineSize;
     }
     zstream.next_out  = buffer;
     zstream.avail_out = 2*rawTileSize;
-    zstream.next_in   = zip_buffer;
+    zstream.next_in   = compressor->zip_buffer;
     zstream.avail_in  = rawTileSize;
 
     if ( deflateReset ( &zstream ) != Z_OK ) return -1;
@@ -1308,7 +1522,9 @@ size_t Rok4Image::computeDeflateTile ( uint8_t *buffer, uint8_t *data ) {
 }
 
 
-size_t Rok4Image::computeJpegTile ( uint8_t *buffer, uint8_t *data, bool crop ) {
+size_t Rok4Image::computeJpegTile ( Rok4TileCompressor* compressor, uint8_t *data, bool crop ) {
+    uint8_t *buffer = compressor->Buffer;
+    jpeg_compress_struct& cinfo = compressor->cinfo;
 
     cinfo.dest->next_output_byte = buffer;
     cinfo.dest->free_in_buffer = 2*rawTileSize;
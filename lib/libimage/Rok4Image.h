@@ -67,6 +67,84 @@
 #define ROK4_SYMLINK_SIGNATURE "SYMLINK#"
 #define JPEG_BLOC_SIZE 16
 
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Outils de compression des tuiles d'une image ROK4
+ * \details Buffer recevant la tuile compressée et états de la zlib et de la libjpeg. Ces états ne peuvent pas être partagés entre threads : chaque tâche de compression parallèle (voir Rok4Image::writeImage) utilise son propre compresseur.
+ * \~english
+ * \brief Tools to compress ROK4 image's tiles
+ * \details Buffer receiving the compressed tile and zlib and libjpeg states. These states cannot be shared between threads : each parallel compression task (see Rok4Image::writeImage) uses its own compressor.
+ */
+class Rok4TileCompressor {
+
+public:
+
+    /**
+     * \~french \brief Taille du buffer #Buffer temporaire contenant la tuile compressée
+     * \~english \brief Temporary buffer #Buffer size, containing the compressed tile
+     */
+    size_t BufferSize;
+
+    /**
+     * \~french \brief Buffer temporaire contenant la tuile compressée
+     * \~english \brief Temporary buffer, containing the compressed tile
+     */
+    uint8_t* Buffer;
+
+    /**
+     * \~french \brief Buffer utilisé par la zlib
+     * \details Pour les compressions PNG et DEFLATE uniquement
+     * \~english \brief Buffer used by zlib
+     */
+    uint8_t* zip_buffer;
+    /**
+     * \~french \brief Flux utilisé par la zlib
+     * \details Pour les compressions PNG et DEFLATE uniquement
+     * \~english \brief Stream used by zlib
+     */
+    z_stream zstream;
+
+    /**
+     * \~french \brief Structure d'informations, utilisée par la libjpeg
+     * \details Pour la compression JPEG uniquement
+     * \~english \brief Informations structure used by libjpeg
+     */
+    struct jpeg_compress_struct cinfo;
+    /**
+     * \~french \brief Structure d'erreur utilisée par la libjpeg
+     * \details Pour la compression JPEG uniquement
+     * \~english \brief Error structure used by libjpeg
+     */
+    struct jpeg_error_mgr jerr;
+
+    /**
+     * \~french \brief Compression des tuiles
+     * \~english \brief Tiles' compression
+     */
+    Compression::eCompression compression;
+
+    /**
+     * \~french \brief Crée les buffers et initialise les bibliothèques de compression
+     * \param[in] compression compression des tuiles
+     * \param[in] rawTileSize taille d'une tuile brute, en octets
+     * \param[in] tileWidth largeur d'une tuile, en pixels
+     * \param[in] tileHeight hauteur d'une tuile, en pixels
+     * \~english \brief Create buffers and initialize compression libraries
+     * \param[in] compression tiles' compression
+     * \param[in] rawTileSize raw tile size, in bytes
+     * \param[in] tileWidth tile's width, in pixels
+     * \param[in] tileHeight tile's height, in pixels
+     */
+    Rok4TileCompressor ( Compression::eCompression compression, int rawTileSize, int tileWidth, int tileHeight );
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~Rok4TileCompressor();
+};
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -84,9 +162,15 @@
  *
  * Toutes les spécifications sont disponible à [cette adresse](https://github.com/rok4/rok4).
  */
+class TilesRowPrefetchTask;
+class ThreadTaskGroup;
+
 class Rok4Image : public Image {
 
     friend class Rok4ImageFactory;
+    friend class TileCompressionTask;
+    friend class TileDecodingTask;
+    friend class TilesRowPrefetchTask;
 
 private:
 
@@ -265,6 +349,74 @@ private:
      */
     boolean memorizeRawTiles ( int tilesLine );
 
+    /**
+     * \~french \brief Lit et décompresse une ligne de tuiles
+     * \details Les tuiles sont décompressées en parallèle si le groupe de threads partagé est initialisé (ThreadPool::initSharedPool)
+     * \param[in] tilesLine indice de la ligne de tuiles
+     * \param[out] tiles buffer recevant les tuiles brutes
+     * \param[out] png passe à VRAI si les tuiles sont des images PNG
+     * \return VRAI en cas de succès, FAUX sinon
+     * \~english \brief Read and uncompress a tiles line
+     * \details Tiles are uncompressed in parallel if the shared threads pool is initialized (ThreadPool::initSharedPool)
+     * \param[in] tilesLine tiles line indice
+     * \param[out] tiles buffer receiving raw tiles
+     * \param[out] png become TRUE if tiles are PNG images
+     * \return TRUE if success, FALSE otherwise
+     */
+    bool loadTilesRow ( int tilesLine, uint8_t* tiles, bool& png );
+
+    /**
+     * \~french \brief Décompresse une tuile
+     * \param[in] tileIndex indice de la tuile dans l'image
+     * \param[in] encoded données compressées de la tuile
+     * \param[out] raw buffer recevant la tuile brute
+     * \param[out] png passe à VRAI si la tuile est une image PNG
+     * \return VRAI en cas de succès, FAUX sinon
+     * \~english \brief Uncompress a tile
+     * \param[in] tileIndex tile's indice in the image
+     * \param[in] encoded tile's compressed data
+     * \param[out] raw buffer receiving the raw tile
+     * \param[out] png become TRUE if the tile is a PNG image
+     * \return TRUE if success, FALSE otherwise
+     */
+    bool decodeTile ( int tileIndex, const uint8_t* encoded, uint8_t* raw, bool& png );
+
+    /**
+     * \~french \brief Doit-on préparer la ligne de tuiles suivante lors d'une lecture séquentielle
+     * \~english \brief Have we to prepare the next tiles line when reading sequentially
+     */
+    bool prefetch;
+
+    /**
+     * \~french \brief Buffer recevant la ligne de tuiles préparée en tâche de fond
+     * \details Alloué au premier lancement d'une préparation
+     * \~english \brief Buffer receiving the tiles line prepared in background
+     * \details Allocated when first prefetch is launched
+     */
+    uint8_t *prefetchedTiles;
+
+    /**
+     * \~french \brief Préparation en cours de la ligne de tuiles suivante, NULL si aucune
+     * \~english \brief Running next tiles line prefetch, NULL if none
+     */
+    TilesRowPrefetchTask* prefetchTask;
+
+    /**
+     * \~french \brief Ensemble de tâches contenant #prefetchTask
+     * \~english \brief Tasks set containing #prefetchTask
+     */
+    ThreadTaskGroup* prefetchGroup;
+
+    /**
+     * \~french \brief Attend la fin de la préparation en cours, s'il y en a une
+     * \param[out] tilesLine ligne de tuiles préparée, -1 si aucune ou en cas d'échec
+     * \param[out] png passe à VRAI si les tuiles préparées sont des images PNG
+     * \~english \brief Wait for the running prefetch end, if one
+     * \param[out] tilesLine prepared tiles line, -1 if none or failure
+     * \param[out] png become TRUE if prepared tiles are PNG images
+     */
+    void waitPrefetch ( int& tilesLine, bool& png );
+
     /**
      * \~french \brief Charge l'index des tuiles de l'image ROK4 à lire
      * \return VRAI en cas de succès, FAUX sinon
@@ -276,32 +428,32 @@ private:
     /**
      * \~french \brief Compresse les données brutes en RAW
      * \details Consiste en une simple copie.
-     * \param[out] buffer buffer de stockage des données compressées. Doit être alloué.
+     * \param[in,out] compressor compresseur, dont le buffer reçoit les données compressées
      * \param[in] data données brutes (sans compression) à compresser
      * \return taille utile du buffer, 0 si erreur
      * \~english \brief Compress raw data into RAW compression
      * \details A simple copy
-     * \param[out] buffer Storage buffer for compressed data. Have to be allocated.
+     * \param[in,out] compressor compressor, whose buffer receives compressed data
      * \param[in] data raw data (no compression) to write
      * \return data' size in buffer, 0 if failure
      */
-    size_t computeRawTile ( uint8_t *buffer, uint8_t *data );
+    size_t computeRawTile ( Rok4TileCompressor* compressor, uint8_t *data );
 
      /**
      * \~french \brief Compresse les données brutes en JPEG
      * \details Utilise la libjpeg.
-     * \param[out] buffer buffer de stockage des données compressées. Doit être alloué.
+     * \param[in,out] compressor compresseur, dont le buffer reçoit les données compressées
      * \param[in] data données brutes (sans compression) à compresser
      * \param[in] crop option pour le jpeg (voir #writeImage)
      * \return taille utile du buffer, 0 si erreur
      * \~english \brief Compress raw data into JPEG compression
      * \details Use libjpeg
-     * \param[out] buffer Storage buffer for compressed data. Have to be allocated.
+     * \param[in,out] compressor compressor, whose buffer receives compressed data
      * \param[in] data raw data (no compression) to write
      * \param[in] crop jpeg option (see #writeImage)
      * \return data' size in buffer, 0 if failure
      */
-    size_t computeJpegTile ( uint8_t *buffer, uint8_t *data, bool crop );
+    size_t computeJpegTile ( Rok4TileCompressor* compressor, uint8_t *data, bool crop );
 
     /**
      * \~french \brief Remplit les blocs qui contiennent un pixel blanc de blanc
@@ -317,55 +469,55 @@ private:
     /**
      * \~french \brief Compresse les données brutes en LZW
      * \details Utilise la liblzw.
-     * \param[out] buffer buffer de stockage des données compressées. Doit être alloué.
+     * \param[in,out] compressor compresseur, dont le buffer reçoit les données compressées
      * \param[in] data données brutes (sans compression) à compresser
      * \return taille utile du buffer, 0 si erreur
      * \~english \brief Compress raw data into LZW compression
      * \details Use liblzw.
-     * \param[out] buffer Storage buffer for compressed data. Have to be allocated.
+     * \param[in,out] compressor compressor, whose buffer receives compressed data
      * \param[in] data raw data (no compression) to write
      * \return data' size in buffer, 0 if failure
      */
-    size_t computeLzwTile ( uint8_t *buffer, uint8_t *data );
+    size_t computeLzwTile ( Rok4TileCompressor* compressor, uint8_t *data );
     /**
      * \~french \brief Compresse les données brutes en PACKBITS
      * \details Utilise la libpkb.
-     * \param[out] buffer buffer de stockage des données compressées. Doit être alloué.
+     * \param[in,out] compressor compresseur, dont le buffer reçoit les données compressées
      * \param[in] data données brutes (sans compression) à compresser
      * \return taille utile du buffer, 0 si erreur
      * \~english \brief Compress raw data into PACKBITS compression
      * \details Use libpkb.
-     * \param[out] buffer Storage buffer for compressed data. Have to be allocated.
+     * \param[in,out] compressor compressor, whose buffer receives compressed data
      * \param[in] data raw data (no compression) to write
      * \return data' size in buffer, 0 if failure
      */
-    size_t computePackbitsTile ( uint8_t *buffer, uint8_t *data );
+    size_t computePackbitsTile ( Rok4TileCompressor* compressor, uint8_t *data );
     /**
      * \~french \brief Compresse les données brutes en PNG
      * \details Utilise la zlib. Les données retournées contiennent l'en-tête PNG.
-     * \param[out] buffer buffer de stockage des données compressées. Doit être alloué.
+     * \param[in,out] compressor compresseur, dont le buffer reçoit les données compressées
      * \param[in] data données brutes (sans compression) à compresser
      * \return taille utile du buffer, 0 si erreur
      * \~english \brief Compress raw data into PNG compression
      * \details Use zlib. Returned data contains PNG header.
-     * \param[out] buffer Storage buffer for compressed data. Have to be allocated.
+     * \param[in,out] compressor compressor, whose buffer receives compressed data
      * \param[in] data raw data (no compression) to write
      * \return data' size in buffer, 0 if failure
      */
-    size_t computePngTile ( uint8_t *buffer, uint8_t *data );
+    size_t computePngTile ( Rok4TileCompressor* compressor, uint8_t *data );
     /**
      * \~french \brief Compresse les données brutes en DEFLATE
      * \details Utilise la zlib.
-     * \param[out] buffer buffer de stockage des données compressées. Doit être alloué.
+     * \param[in,out] compressor compresseur, dont le buffer reçoit les données compressées
      * \param[in] data données brutes (sans compression) à compresser
      * \return taille utile du buffer, 0 si erreur
      * \~english \brief Compress raw data into DEFLATE compression
      * \details Use zlib.
-     * \param[out] buffer Storage buffer for compressed data. Have to be allocated.
+     * \param[in,out] compressor compressor, whose buffer receives compressed data
      * \param[in] data raw data (no compression) to write
      * \return data' size in buffer, 0 if failure
      */
-    size_t computeDeflateTile ( uint8_t *buffer, uint8_t *data );
+    size_t computeDeflateTile ( Rok4TileCompressor* compressor, uint8_t *data );
     
     template<typename T>
     int _getline ( T* buffer, int line );
@@ -373,43 +525,47 @@ private:
     /******* Pour l'écriture *******/
 
     /**
-     * \~french \brief Taille du buffer #Buffer temporaire contenant la tuile à écrire (dans writeTile), compressée
-     * \~english \brief Temporary buffer #Buffer size, containing the compressed tile to write
-     */
-    size_t BufferSize;
-    
-    /**
-     * \~french \brief Buffer temporaire contenant la tuile à écrire (dans writeTile), compressée
-     * \~english \brief Buffer size, containing the compressed tile to write
+     * \~french \brief Compresseur utilisé par #writeTile
+     * \~english \brief Compressor used by #writeTile
      */
-    uint8_t* Buffer;
+    Rok4TileCompressor* compressor;
 
     /**
-     * \~french \brief Buffer utilisé par la zlib
-     * \details Pour les compressions PNG et DEFLATE uniquement
-     * \~english \brief Buffer used by zlib
-     */
-    uint8_t* zip_buffer;
-    /**
-     * \~french \brief Flux utilisé par la zlib
-     * \details Pour les compressions PNG et DEFLATE uniquement
-     * \~english \brief Stream used by zlib
+     * \~french \brief Compresse une tuile selon la compression #compression
+     * \param[in,out] compressor compresseur, dont le buffer reçoit les données compressées
+     * \param[in] data données brutes (sans compression) à compresser
+     * \param[in] crop option pour le jpeg (voir #emptyWhiteBlock)
+     * \return taille utile du buffer, 0 si erreur
+     * \~english \brief Compress a tile according to #compression
+     * \param[in,out] compressor compressor, whose buffer receives compressed data
+     * \param[in] data raw data (no compression) to compress
+     * \param[in] crop JPEG option to empty white blocks
+     * \return data' size in buffer, 0 if failure
      */
-    z_stream zstream;
-    
+    size_t compressTile ( Rok4TileCompressor* compressor, uint8_t *data, bool crop );
+
     /**
-     * \~french \brief Structure d'informations, utilisée par la libjpeg
-     * \details Pour la compression JPEG uniquement
-     * \~english \brief Informations structure used by libjpeg
+     * \~french \brief Écrit une tuile déjà compressée et renseigne l'index
+     * \details Les tuiles doivent être écrites dans l'ordre (de gauche à droite, de haut en bas).
+     * \param[in] tileInd indice de la tuile à écrire
+     * \param[in] buffer données compressées
+     * \param[in] size taille des données compressées
+     * \return VRAI en cas de succès, FAUX sinon
+     * \~english \brief Write an already compressed tile and fill the index
+     * \param[in] tileInd tile indice
+     * \param[in] buffer compressed data
+     * \param[in] size compressed data size
+     * \return TRUE if success, FALSE otherwise
      */
-    struct jpeg_compress_struct cinfo;
+    bool writeCompressedTile ( int tileInd, uint8_t *buffer, size_t size );
+
     /**
-     * \~french \brief Structure d'erreur utilisée par la libjpeg
-     * \details Pour la compression JPEG uniquement
-     * \~english \brief Error structure used by libjpeg
+     * \~french \brief Écrit toutes les tuiles de l'image, à partir d'une image source de canaux de type T
+     * \details Voir #writeImage
+     * \~english \brief Write all image's tiles, from a source image with T type samples
      */
-    struct jpeg_error_mgr jerr;
-
+    template<typename T>
+    bool _writeImage ( Image* pIn, bool crop );
 
     /**
      * \~french \brief Écrit une tuile de l'image ROK4 raster
@@ -596,6 +752,18 @@ public:
         return rawTileSize;
     }
 
+    /**
+     * \~french
+     * \brief Active ou non la préparation de la ligne de tuiles suivante
+     * \details Lorsque les lignes sont lues dans l'ordre et que le groupe de threads partagé est initialisé, la ligne de tuiles suivante est lue et décompressée en tâche de fond pendant la lecture des lignes de la ligne de tuiles courante. Activée par défaut.
+     * \~english
+     * \brief Enable or not the next tiles line prefetch
+     * \details When lines are read in order and the shared threads pool is initialized, next tiles line is read and uncompressed in background while current tiles line's lines are read. Enabled by default.
+     */
+    void setPrefetch ( bool p ) {
+        prefetch = p;
+    }
+
     /**
      * \~french
      * \brief Destructeur par défaut
@@ -606,7 +774,11 @@ public:
      */
     ~Rok4Image() {
         if (! isVector) {
+            int tilesLine;
+            bool png;
+            waitPrefetch ( tilesLine, png );
             delete[] memorizedTiles;
+            delete[] prefetchedTiles;
         }
         delete[] tilesOffset;
         delete[] tilesByteCounts;
@@ -654,6 +826,8 @@ public:
      * \~french
      * \brief Ecrit une image ROK4, à partir d'une image source
      * \details Toutes les informations nécessaires à l'écriture d'une image sont dans l'objet Rok4Image, sauf les données à écrire. On renseigne cela via une seconde image. Cette méthode permet également de préciser s'il on veut "croper". Dans le cas d'une compression JPEG, on peut vouloir "vider" les blocs (16x16 pixels) contenant un pixel blanc.
+     *
+     * Si le groupe de threads partagé est initialisé (ThreadPool::initSharedPool), les tuiles d'une ligne de tuiles sont compressées en parallèle pendant la lecture de la ligne suivante, puis écrites dans l'ordre : le fichier obtenu est identique à celui d'une écriture séquentielle.
      * \param[in] pIn source des donnée de l'image à écrire
      * \param[in] crop option de cropage, pour le jpeg
      * \return 0 en cas de succes, -1 sinon
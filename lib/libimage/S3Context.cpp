@@ -169,35 +169,25 @@ static const char mon_name[][4] = {
     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
 };
 
-int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
-
-    LOGGER_DEBUG("S3 read : " << size << " bytes (from the " << offset << " one) in the object " << name);
+struct curl_slist* S3Context::setReadOptions(CURL* curl, DataStruct* chunk, int offset, int size, std::string name) {
 
-    // On constitue le moyen de récupération des informations (avec les structures de LibcurlStruct)
-
-    CURLcode res;
     struct curl_slist *list = NULL;
-    DataStruct chunk;
-    chunk.nbPassage = 0;
-    chunk.data = (char*) malloc(1);
-    chunk.size = 0;
 
     int lastBytes = offset + size - 1;
 
-    CURL* curl = CurlPool::getCurlEnv();
-
     std::string fullUrl = url + "/" + bucket_name + "/" + name;
 
     time_t current;
 
     time(&current);
-    struct tm * ptm = gmtime ( &current );
+    struct tm ptm;
+    gmtime_r ( &current, &ptm );
 
-    static char gmt_time[40];
+    char gmt_time[40];
     sprintf(
         gmt_time, "%s, %d %s %d %.2d:%.2d:%.2d GMT",
-        wday_name[ptm->tm_wday], ptm->tm_mday, mon_name[ptm->tm_mon], 1900 + ptm->tm_year,
-        ptm->tm_hour, ptm->tm_min, ptm->tm_sec
+        wday_name[ptm.tm_wday], ptm.tm_mday, mon_name[ptm.tm_mon], 1900 + ptm.tm_year,
+        ptm.tm_hour, ptm.tm_min, ptm.tm_sec
     );
 
     std::string content_type = "application/octet-stream";
@@ -237,15 +227,32 @@ int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
       curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
     }
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) chunk);
+
+    return list;
+}
 
+int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
+
+    LOGGER_DEBUG("S3 read : " << size << " bytes (from the " << offset << " one) in the object " << name);
+
+    // On constitue le moyen de récupération des informations (avec les structures de LibcurlStruct)
+
+    CURLcode res;
+    DataStruct chunk;
+    chunk.nbPassage = 0;
+    chunk.data = (char*) malloc(1);
+    chunk.size = 0;
+
+    CURL* curl = CurlPool::getCurlEnv();
+
+    struct curl_slist *list = setReadOptions(curl, &chunk, offset, size, name);
 
     LOGGER_DEBUG("S3 READ START (" << size << ") " << pthread_self());
     res = curl_easy_perform(curl);
     LOGGER_DEBUG("S3 READ END (" << size << ") " << pthread_self());
     
     curl_slist_free_all(list);
-    //delete[] gmt_time;
 
     if( CURLE_OK != res) {
         LOGGER_ERROR("Cannot read data from S3 : " << size << " bytes (from the " << offset << " one) in the object " << name);
@@ -267,6 +274,54 @@ int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
     return chunk.size;
 }
 
+void S3Context::submitReads(std::vector<ContextRead*>& reads) {
+
+    LOGGER_DEBUG("S3 asynchronous read : " << reads.size() << " readings");
+
+    for (size_t i = 0; i < reads.size(); i++) {
+        ContextRead* r = reads.at(i);
+        CurlRequest* req = new CurlRequest();
+        req->list = setReadOptions(req->curl, &(req->chunk), r->offset, r->size, r->name);
+        r->pending = (void*) req;
+        CurlPool::addRequest(req);
+    }
+}
+
+void S3Context::waitReads(std::vector<ContextRead*>& reads) {
+
+    std::vector<CurlRequest*> reqs;
+    for (size_t i = 0; i < reads.size(); i++) {
+        if (reads.at(i)->pending != NULL) reqs.push_back((CurlRequest*) reads.at(i)->pending);
+    }
+
+    CurlPool::waitRequests(reqs);
+
+    for (size_t i = 0; i < reads.size(); i++) {
+        ContextRead* r = reads.at(i);
+        if (r->pending == NULL) continue;
+        CurlRequest* req = (CurlRequest*) r->pending;
+        r->pending = NULL;
+
+        long http_code = 0;
+        curl_easy_getinfo (req->curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+        if( CURLE_OK != req->code) {
+            LOGGER_ERROR("Cannot read data from S3 : " << r->size << " bytes (from the " << r->offset << " one) in the object " << r->name);
+            LOGGER_ERROR(curl_easy_strerror(req->code));
+            r->result = -1;
+        } else if (http_code < 200 || http_code > 299) {
+            LOGGER_ERROR("Cannot read data from S3 : " << r->size << " bytes (from the " << r->offset << " one) in the object " << r->name);
+            LOGGER_ERROR("Response HTTP code : " << http_code);
+            r->result = -1;
+        } else {
+            memcpy(r->data, req->chunk.data, req->chunk.size);
+            r->result = req->chunk.size;
+        }
+
+        delete req;
+    }
+}
+
 bool S3Context::write(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("S3 write : " << size << " bytes (from the " << offset << " one) in the writing buffer " << name);
 
@@ -112,6 +112,14 @@ private:
      */
     std::string getAuthorizationHeader(std::string toSign);
 
+    /**
+     * \~french \brief Configure un objet curl pour la lecture d'une partie d'un objet S3
+     * \return Les en-têtes de la requête, à libérer une fois la requête terminée
+     * \~english \brief Configure a curl object to read a part of a S3 object
+     * \return Request's headers, to free once request is over
+     */
+    struct curl_slist* setReadOptions(CURL* curl, DataStruct* chunk, int offset, int size, std::string name);
+
 public:
 
     /**
@@ -161,6 +169,30 @@ public:
      */
     int read(uint8_t* data, int offset, int size, std::string name);
 
+    /**
+     * \~french \brief Les lectures S3 peuvent être menées en parallèle
+     * \~english \brief S3 readings can be handled in parallel
+     */
+    bool asyncReads() {
+        return true;
+    }
+
+    /**
+     * \~french
+     * \brief Lance un lot de lectures S3, menées en parallèle par un objet curl multiple
+     * \~english 
+     * \brief Start a batch of S3 readings, handled in parallel by a curl multi object
+     */
+    void submitReads(std::vector<ContextRead*>& reads);
+
+    /**
+     * \~french
+     * \brief Attend la fin d'un lot de lectures S3
+     * \~english 
+     * \brief Wait for a batch of S3 readings
+     */
+    void waitReads(std::vector<ContextRead*>& reads);
+
     /**
      * \~french
      * \brief Écrit de la donnée dans un objet S3
@@ -0,0 +1,584 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file Simd.cpp
+ ** \~french
+ * \brief Implémentation de la classe Simd et des versions AVX2 / AVX-512 des fonctions de Utils.h
+ * \details Les fonctions sont compilées pour leur jeu d'instructions via un attribut, le reste de la bibliothèque restant en SSE2. Elles ne sont appelées que si Simd::getLevel() l'autorise.
+ ** \~english
+ * \brief Implements class Simd and AVX2 / AVX-512 versions of Utils.h functions
+ * \details Functions are compiled for their instruction set thanks to an attribute, the rest of the library staying SSE2. They are called only if Simd::getLevel() allows it.
+ */
+
+#include "Simd.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ROK4_HAS_AVX 1
+#define TARGET_AVX2 __attribute__ ( ( target ( "avx2" ) ) )
+#define TARGET_AVX512 __attribute__ ( ( target ( "avx512f" ) ) )
+#endif
+
+Simd::Level Simd::supported = Simd::detect();
+Simd::Level Simd::level = Simd::supported;
+
+Simd::Level Simd::detect() {
+    Level l = SSE2;
+
+#ifdef ROK4_HAS_AVX
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports ( "avx2" ) ) l = AVX2;
+    if ( __builtin_cpu_supports ( "avx512f" ) ) l = AVX512;
+#endif
+
+    char* cap = getenv ( ROK4_SIMD );
+    if ( cap != NULL ) {
+        if ( strcmp ( cap, "sse2" ) == 0 ) l = SSE2;
+        else if ( strcmp ( cap, "avx2" ) == 0 && l > AVX2 ) l = AVX2;
+    }
+
+    return l;
+}
+
+Simd::Level Simd::setLevel ( Level l ) {
+    level = ( l > supported ) ? supported : l;
+    return level;
+}
+
+const char* Simd::getLevelName ( Level l ) {
+    switch ( l ) {
+    case AVX512 :
+        return "AVX-512";
+    case AVX2 :
+        return "AVX2";
+    default :
+        return "SSE2";
+    }
+}
+
+#ifdef ROK4_HAS_AVX
+
+/* ---------------------------- AVX2 ---------------------------- */
+
+TARGET_AVX2 void avx2_convert ( float* to, const uint8_t* from, int length ) {
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m128i m = _mm_loadu_si128 ( ( const __m128i* ) ( from + i ) );
+        _mm256_storeu_ps ( to + i,     _mm256_cvtepi32_ps ( _mm256_cvtepu8_epi32 ( m ) ) );
+        _mm256_storeu_ps ( to + i + 8, _mm256_cvtepi32_ps ( _mm256_cvtepu8_epi32 ( _mm_srli_si128 ( m, 8 ) ) ) );
+    }
+    for ( ; i < length; i++ ) to[i] = ( float ) from[i];
+}
+
+TARGET_AVX2 void avx2_convert ( float* to, const uint16_t* from, int length ) {
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m256i m = _mm256_loadu_si256 ( ( const __m256i* ) ( from + i ) );
+        _mm256_storeu_ps ( to + i,     _mm256_cvtepi32_ps ( _mm256_cvtepu16_epi32 ( _mm256_castsi256_si128 ( m ) ) ) );
+        _mm256_storeu_ps ( to + i + 8, _mm256_cvtepi32_ps ( _mm256_cvtepu16_epi32 ( _mm256_extracti128_si256 ( m, 1 ) ) ) );
+    }
+    for ( ; i < length; i++ ) to[i] = ( float ) from[i];
+}
+
+TARGET_AVX2 void avx2_convert ( uint16_t* to, const uint8_t* from, int length ) {
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m128i m = _mm_loadu_si128 ( ( const __m128i* ) ( from + i ) );
+        _mm256_storeu_si256 ( ( __m256i* ) ( to + i ), _mm256_cvtepu8_epi16 ( m ) );
+    }
+    for ( ; i < length; i++ ) to[i] = ( uint16_t ) from[i];
+}
+
+/**
+ * \~french
+ * \brief Arrondi au plus proche, avec saturation entre 0 et max, de 8 flottants
+ * \details Donne exactement ( int ) ( f + 0.5 ) saturé, comme la version scalaire : la partie fractionnaire est comparée à 0.5, plutôt que d'ajouter 0.5 en simple précision (0.49999997 donnerait alors 1).
+ * \~english
+ * \brief Round to nearest, with saturation between 0 and max, of 8 floats
+ * \details Gives exactly saturated ( int ) ( f + 0.5 ), like the scalar version : fractional part is compared to 0.5, rather than adding 0.5 in single precision (0.49999997 would then give 1).
+ */
+TARGET_AVX2 static inline __m256i avx2_round ( __m256 f, __m256 max ) {
+    // max_ps retourne son second opérande pour un NaN : NaN donne 0
+    f = _mm256_min_ps ( _mm256_max_ps ( f, _mm256_setzero_ps() ), max );
+    __m256 fl = _mm256_floor_ps ( f );
+    __m256 up = _mm256_and_ps ( _mm256_cmp_ps ( _mm256_sub_ps ( f, fl ), _mm256_set1_ps ( 0.5f ), _CMP_GE_OQ ), _mm256_set1_ps ( 1.f ) );
+    return _mm256_cvttps_epi32 ( _mm256_add_ps ( fl, up ) );
+}
+
+TARGET_AVX2 void avx2_convert ( uint8_t* to, const float* from, int length ) {
+    const __m256 max = _mm256_set1_ps ( 255.f );
+    // packs et packus travaillent par moitié de registre : on remet les groupes de 4 octets dans l'ordre
+    const __m256i order = _mm256_setr_epi32 ( 0, 4, 1, 5, 2, 6, 3, 7 );
+    int i = 0;
+    for ( ; i + 32 <= length; i += 32 ) {
+        __m256i a = avx2_round ( _mm256_loadu_ps ( from + i ), max );
+        __m256i b = avx2_round ( _mm256_loadu_ps ( from + i + 8 ), max );
+        __m256i c = avx2_round ( _mm256_loadu_ps ( from + i + 16 ), max );
+        __m256i d = avx2_round ( _mm256_loadu_ps ( from + i + 24 ), max );
+        __m256i p = _mm256_packus_epi16 ( _mm256_packs_epi32 ( a, b ), _mm256_packs_epi32 ( c, d ) );
+        _mm256_storeu_si256 ( ( __m256i* ) ( to + i ), _mm256_permutevar8x32_epi32 ( p, order ) );
+    }
+    for ( ; i < length; i++ ) {
+        int t = ( int ) ( from[i] + 0.5 );
+        if ( t < 0 ) to[i] = 0;
+        else if ( t > 255 ) to[i] = 255;
+        else to[i] = t;
+    }
+}
+
+TARGET_AVX2 void avx2_convert ( uint16_t* to, const float* from, int length ) {
+    const __m256 max = _mm256_set1_ps ( 65535.f );
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m256i a = avx2_round ( _mm256_loadu_ps ( from + i ), max );
+        __m256i b = avx2_round ( _mm256_loadu_ps ( from + i + 8 ), max );
+        __m256i p = _mm256_packus_epi32 ( a, b );
+        _mm256_storeu_si256 ( ( __m256i* ) ( to + i ), _mm256_permute4x64_epi64 ( p, 0xD8 ) );
+    }
+    for ( ; i < length; i++ ) {
+        int t = ( int ) ( from[i] + 0.5 );
+        if ( t < 0 ) to[i] = 0;
+        else if ( t > 65535 ) to[i] = 65535;
+        else to[i] = t;
+    }
+}
+
+TARGET_AVX2 void avx2_mult ( float* to, const float* from, const float w, int length ) {
+    const __m256 W = _mm256_set1_ps ( w );
+    int i = 0;
+    for ( ; i + 8 <= length; i += 8 ) _mm256_storeu_ps ( to + i, _mm256_mul_ps ( W, _mm256_loadu_ps ( from + i ) ) );
+    for ( ; i < length; i++ ) to[i] = w * from[i];
+}
+
+TARGET_AVX2 void avx2_add_mult ( float* to, const float* from, const float w, int length ) {
+    const __m256 W = _mm256_set1_ps ( w );
+    int i = 0;
+    for ( ; i + 8 <= length; i += 8 ) {
+        _mm256_storeu_ps ( to + i, _mm256_add_ps ( _mm256_loadu_ps ( to + i ), _mm256_mul_ps ( W, _mm256_loadu_ps ( from + i ) ) ) );
+    }
+    for ( ; i < length; i++ ) to[i] += w * from[i];
+}
+
+TARGET_AVX2 void avx2_multiplex ( float* T, const float* F1, const float* F2, const float* F3, const float* F4, int length ) {
+    int i = 0;
+    for ( ; i + 8 <= length; i += 8 ) {
+        __m256 f0 = _mm256_loadu_ps ( F1 + i );
+        __m256 f1 = _mm256_loadu_ps ( F2 + i );
+        __m256 f2 = _mm256_loadu_ps ( F3 + i );
+        __m256 f3 = _mm256_loadu_ps ( F4 + i );
+
+        // Même entrelacement que la version SSE2, dans chaque moitié de registre
+        __m256 L02 = _mm256_unpacklo_ps ( f0, f2 );
+        __m256 H02 = _mm256_unpackhi_ps ( f0, f2 );
+        __m256 L13 = _mm256_unpacklo_ps ( f1, f3 );
+        __m256 H13 = _mm256_unpackhi_ps ( f1, f3 );
+
+        __m256 o0 = _mm256_unpacklo_ps ( L02, L13 ); // pixels i et i+4
+        __m256 o1 = _mm256_unpackhi_ps ( L02, L13 ); // pixels i+1 et i+5
+        __m256 o2 = _mm256_unpacklo_ps ( H02, H13 ); // pixels i+2 et i+6
+        __m256 o3 = _mm256_unpackhi_ps ( H02, H13 ); // pixels i+3 et i+7
+
+        _mm256_storeu_ps ( T + 4*i,      _mm256_permute2f128_ps ( o0, o1, 0x20 ) );
+        _mm256_storeu_ps ( T + 4*i + 8,  _mm256_permute2f128_ps ( o2, o3, 0x20 ) );
+        _mm256_storeu_ps ( T + 4*i + 16, _mm256_permute2f128_ps ( o0, o1, 0x31 ) );
+        _mm256_storeu_ps ( T + 4*i + 24, _mm256_permute2f128_ps ( o2, o3, 0x31 ) );
+    }
+    for ( ; i < length; i++ ) {
+        T[4*i] = F1[i];
+        T[4*i+1] = F2[i];
+        T[4*i+2] = F3[i];
+        T[4*i+3] = F4[i];
+    }
+}
+
+TARGET_AVX2 void avx2_demultiplex ( float* T1, float* T2, float* T3, float* T4, const float* F, int length ) {
+    int i = 0;
+    for ( ; i + 8 <= length; i += 8 ) {
+        __m256 v0 = _mm256_loadu_ps ( F + 4*i );      // pixels i, i+1
+        __m256 v1 = _mm256_loadu_ps ( F + 4*i + 8 );  // pixels i+2, i+3
+        __m256 v2 = _mm256_loadu_ps ( F + 4*i + 16 ); // pixels i+4, i+5
+        __m256 v3 = _mm256_loadu_ps ( F + 4*i + 24 ); // pixels i+6, i+7
+
+        // Chaque moitié de registre reçoit 4 pixels consécutifs, transposés comme dans la version SSE2
+        __m256 F0 = _mm256_permute2f128_ps ( v0, v2, 0x20 );
+        __m256 F1 = _mm256_permute2f128_ps ( v0, v2, 0x31 );
+        __m256 F2 = _mm256_permute2f128_ps ( v1, v3, 0x20 );
+        __m256 F3 = _mm256_permute2f128_ps ( v1, v3, 0x31 );
+
+        __m256 L02 = _mm256_unpacklo_ps ( F0, F2 );
+        __m256 H02 = _mm256_unpackhi_ps ( F0, F2 );
+        __m256 L13 = _mm256_unpacklo_ps ( F1, F3 );
+        __m256 H13 = _mm256_unpackhi_ps ( F1, F3 );
+
+        _mm256_storeu_ps ( T1 + i, _mm256_unpacklo_ps ( L02, L13 ) );
+        _mm256_storeu_ps ( T2 + i, _mm256_unpackhi_ps ( L02, L13 ) );
+        _mm256_storeu_ps ( T3 + i, _mm256_unpacklo_ps ( H02, H13 ) );
+        _mm256_storeu_ps ( T4 + i, _mm256_unpackhi_ps ( H02, H13 ) );
+    }
+    for ( ; i < length; i++ ) {
+        T1[i] = F[4*i];
+        T2[i] = F[4*i+1];
+        T3[i] = F[4*i+2];
+        T4[i] = F[4*i+3];
+    }
+}
+
+/**
+ * \~french
+ * \brief Couleurs d'un tableau de valeurs par la table de correspondance d'une Palette, 8 valeurs à la fois
+ * \details Les indices sont calculés en double précision, comme dans Palette::lookup, puis les couleurs et les marqueurs d'intervalles coupés sont lus par des gather.
+ * \return le nombre de valeurs traitées : on s'arrête au premier groupe de 8 contenant une valeur hors de la table ou dans un intervalle coupé
+ * \~english
+ * \brief Colours of a values array thanks to a Palette's lookup table, 8 values at once
+ * \details Indices are computed in double precision, like in Palette::lookup, then colours and cut intervals' markers are read by gathers.
+ * \return treated values' number : we stop at the first 8-values group containing a value out of the table or in a cut interval
+ */
+TARGET_AVX2 int avx2_lookup ( uint32_t* to, const float* from, int length, const uint32_t* lut, const uint8_t* split, int size, double min, double invStep ) {
+    const __m256d Min = _mm256_set1_pd ( min );
+    const __m256d Inv = _mm256_set1_pd ( invStep );
+    const __m256d Zero = _mm256_setzero_pd();
+    const __m256d Size = _mm256_set1_pd ( size );
+    const __m256i Byte = _mm256_set1_epi32 ( 0xFF );
+    int i = 0;
+    for ( ; i + 8 <= length; i += 8 ) {
+        __m256 v = _mm256_loadu_ps ( from + i );
+        __m256d d0 = _mm256_mul_pd ( _mm256_sub_pd ( _mm256_cvtps_pd ( _mm256_castps256_ps128 ( v ) ), Min ), Inv );
+        __m256d d1 = _mm256_mul_pd ( _mm256_sub_pd ( _mm256_cvtps_pd ( _mm256_extractf128_ps ( v, 1 ) ), Min ), Inv );
+
+        // Un NaN échoue aux deux comparaisons
+        int in0 = _mm256_movemask_pd ( _mm256_and_pd ( _mm256_cmp_pd ( d0, Zero, _CMP_GE_OQ ), _mm256_cmp_pd ( d0, Size, _CMP_LT_OQ ) ) );
+        int in1 = _mm256_movemask_pd ( _mm256_and_pd ( _mm256_cmp_pd ( d1, Zero, _CMP_GE_OQ ), _mm256_cmp_pd ( d1, Size, _CMP_LT_OQ ) ) );
+        if ( ( in0 & in1 ) != 0xF ) break;
+
+        __m256i k = _mm256_set_m128i ( _mm256_cvttpd_epi32 ( d1 ), _mm256_cvttpd_epi32 ( d0 ) );
+        __m256i s = _mm256_and_si256 ( _mm256_i32gather_epi32 ( ( const int* ) split, k, 1 ), Byte );
+        if ( ! _mm256_testz_si256 ( s, s ) ) break;
+
+        _mm256_storeu_si256 ( ( __m256i* ) ( to + i ), _mm256_i32gather_epi32 ( ( const int* ) lut, k, 4 ) );
+    }
+    return i;
+}
+
+/**
+ * \~french
+ * \brief Sommes des 4 valeurs masquées d'un sous-échantillonnage 2 par 2, 32 valeurs 8 bits à la fois
+ * \details to[i] = from1[i] + from1[i + shift] + from2[i] + from2[i + shift], les valeurs de masque nul comptant pour 0
+ * \return le nombre de valeurs traitées
+ * \~english
+ * \brief Sums of the 4 masked values of a 2 by 2 downsampling, 32 8-bit values at once
+ * \return treated values' number
+ */
+TARGET_AVX2 int avx2_downsample_sum ( uint16_t* to, const uint8_t* from1, const uint8_t* from2, const uint8_t* mask1, const uint8_t* mask2, int length, int shift ) {
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m256i a = _mm256_cvtepu8_epi16 ( _mm_and_si128 ( _mm_loadu_si128 ( ( const __m128i* ) ( from1 + i ) ), _mm_loadu_si128 ( ( const __m128i* ) ( mask1 + i ) ) ) );
+        __m256i b = _mm256_cvtepu8_epi16 ( _mm_and_si128 ( _mm_loadu_si128 ( ( const __m128i* ) ( from1 + i + shift ) ), _mm_loadu_si128 ( ( const __m128i* ) ( mask1 + i + shift ) ) ) );
+        __m256i c = _mm256_cvtepu8_epi16 ( _mm_and_si128 ( _mm_loadu_si128 ( ( const __m128i* ) ( from2 + i ) ), _mm_loadu_si128 ( ( const __m128i* ) ( mask2 + i ) ) ) );
+        __m256i d = _mm256_cvtepu8_epi16 ( _mm_and_si128 ( _mm_loadu_si128 ( ( const __m128i* ) ( from2 + i + shift ) ), _mm_loadu_si128 ( ( const __m128i* ) ( mask2 + i + shift ) ) ) );
+        _mm256_storeu_si256 ( ( __m256i* ) ( to + i ), _mm256_add_epi16 ( _mm256_add_epi16 ( a, b ), _mm256_add_epi16 ( c, d ) ) );
+    }
+    return i;
+}
+
+/**
+ * \~french
+ * \brief Moyennes 8 bits d'un sous-échantillonnage 2 par 2, par la table de gamma, 16 valeurs à la fois
+ * \details to[i] = merge[sum[i] * 4 / number[i]] là où number[i] > 1. La division par 3 est une multiplication par 0xAAAB, la table est lue par des gather.
+ * \return le nombre de valeurs traitées
+ * \~english
+ * \brief 8-bit averages of a 2 by 2 downsampling, thanks to the gamma table, 16 values at once
+ * \return treated values' number
+ */
+TARGET_AVX2 int avx2_downsample_mean ( uint8_t* to, const uint16_t* sum, const uint8_t* number, const uint8_t* merge, int length ) {
+    const __m256i Two = _mm256_set1_epi16 ( 2 );
+    const __m256i Three = _mm256_set1_epi16 ( 3 );
+    const __m256i Third = _mm256_set1_epi16 ( ( short ) 0xAAAB );
+    const __m256i One = _mm256_set1_epi16 ( 1 );
+    const __m256i Byte = _mm256_set1_epi32 ( 0xFF );
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m256i s = _mm256_loadu_si256 ( ( const __m256i* ) ( sum + i ) );
+        __m256i n = _mm256_cvtepu8_epi16 ( _mm_loadu_si128 ( ( const __m128i* ) ( number + i ) ) );
+        __m256i is2 = _mm256_cmpeq_epi16 ( n, Two );
+        __m256i is3 = _mm256_cmpeq_epi16 ( n, Three );
+        __m256i s3 = _mm256_srli_epi16 ( _mm256_mulhi_epu16 ( _mm256_slli_epi16 ( s, 2 ), Third ), 1 );
+        __m256i k = _mm256_blendv_epi8 ( s, _mm256_slli_epi16 ( s, 1 ), is2 );
+        k = _mm256_blendv_epi8 ( k, s3, is3 );
+
+        // Pour moins de 2 pixels de donnée, la somme est inférieure à 256 : l'indice lu est valide mais ignoré
+        __m256i v0 = _mm256_and_si256 ( _mm256_i32gather_epi32 ( ( const int* ) merge, _mm256_cvtepu16_epi32 ( _mm256_castsi256_si128 ( k ) ), 1 ), Byte );
+        __m256i v1 = _mm256_and_si256 ( _mm256_i32gather_epi32 ( ( const int* ) merge, _mm256_cvtepu16_epi32 ( _mm256_extracti128_si256 ( k, 1 ) ), 1 ), Byte );
+        __m256i v = _mm256_permute4x64_epi64 ( _mm256_packus_epi32 ( v0, v1 ), 0xD8 );
+
+        __m256i keep = _mm256_cmpgt_epi16 ( n, One );
+        __m256i old = _mm256_cvtepu8_epi16 ( _mm_loadu_si128 ( ( const __m128i* ) ( to + i ) ) );
+        v = _mm256_blendv_epi8 ( old, v, keep );
+        v = _mm256_permute4x64_epi64 ( _mm256_packus_epi16 ( v, v ), 0xD8 );
+        _mm_storeu_si128 ( ( __m128i* ) ( to + i ), _mm256_castsi256_si128 ( v ) );
+    }
+    return i;
+}
+
+/**
+ * \~french
+ * \brief Sous-échantillonnage 2 par 2 d'un canal flottant, 8 pixels en sortie à la fois
+ * \details Même calcul que la version SSE2 de DownsampledImage.cpp : pixels de gauche et de droite séparés par des mélanges, somme dans l'ordre de merge4tiff en partant de 0
+ * \return le nombre de pixels en sortie traités
+ * \~english
+ * \brief 2 by 2 downsampling of a float sample, 8 output pixels at once
+ * \return treated output pixels' number
+ */
+TARGET_AVX2 int avx2_downsample ( float* to, uint8_t* toMask, const float* from1, const float* from2, const uint8_t* mask1, const uint8_t* mask2, int width ) {
+    const __m128i Zero = _mm_setzero_si128();
+    const __m256i Four = _mm256_set1_epi32 ( 4 );
+    const __m256i One = _mm256_set1_epi32 ( 1 );
+    int x = 0;
+    for ( ; x + 8 <= width; x += 8 ) {
+        __m256 a = _mm256_loadu_ps ( from1 + 2 * x );
+        __m256 b = _mm256_loadu_ps ( from1 + 2 * x + 8 );
+        __m256 l1 = _mm256_castpd_ps ( _mm256_permute4x64_pd ( _mm256_castps_pd ( _mm256_shuffle_ps ( a, b, _MM_SHUFFLE ( 2, 0, 2, 0 ) ) ), 0xD8 ) );
+        __m256 r1 = _mm256_castpd_ps ( _mm256_permute4x64_pd ( _mm256_castps_pd ( _mm256_shuffle_ps ( a, b, _MM_SHUFFLE ( 3, 1, 3, 1 ) ) ), 0xD8 ) );
+        a = _mm256_loadu_ps ( from2 + 2 * x );
+        b = _mm256_loadu_ps ( from2 + 2 * x + 8 );
+        __m256 l2 = _mm256_castpd_ps ( _mm256_permute4x64_pd ( _mm256_castps_pd ( _mm256_shuffle_ps ( a, b, _MM_SHUFFLE ( 2, 0, 2, 0 ) ) ), 0xD8 ) );
+        __m256 r2 = _mm256_castpd_ps ( _mm256_permute4x64_pd ( _mm256_castps_pd ( _mm256_shuffle_ps ( a, b, _MM_SHUFFLE ( 3, 1, 3, 1 ) ) ), 0xD8 ) );
+
+        // Masques de non-donnée, sur 32 bits
+        __m128i m = _mm_cmpeq_epi8 ( _mm_loadu_si128 ( ( const __m128i* ) ( mask1 + 2 * x ) ), Zero );
+        a = _mm256_castsi256_ps ( _mm256_cvtepi8_epi32 ( m ) );
+        b = _mm256_castsi256_ps ( _mm256_cvtepi8_epi32 ( _mm_srli_si128 ( m, 8 ) ) );
+        __m256 ml1 = _mm256_castpd_ps ( _mm256_permute4x64_pd ( _mm256_castps_pd ( _mm256_shuffle_ps ( a, b, _MM_SHUFFLE ( 2, 0, 2, 0 ) ) ), 0xD8 ) );
+        __m256 mr1 = _mm256_castpd_ps ( _mm256_permute4x64_pd ( _mm256_castps_pd ( _mm256_shuffle_ps ( a, b, _MM_SHUFFLE ( 3, 1, 3, 1 ) ) ), 0xD8 ) );
+        m = _mm_cmpeq_epi8 ( _mm_loadu_si128 ( ( const __m128i* ) ( mask2 + 2 * x ) ), Zero );
+        a = _mm256_castsi256_ps ( _mm256_cvtepi8_epi32 ( m ) );
+        b = _mm256_castsi256_ps ( _mm256_cvtepi8_epi32 ( _mm_srli_si128 ( m, 8 ) ) );
+        __m256 ml2 = _mm256_castpd_ps ( _mm256_permute4x64_pd ( _mm256_castps_pd ( _mm256_shuffle_ps ( a, b, _MM_SHUFFLE ( 2, 0, 2, 0 ) ) ), 0xD8 ) );
+        __m256 mr2 = _mm256_castpd_ps ( _mm256_permute4x64_pd ( _mm256_castps_pd ( _mm256_shuffle_ps ( a, b, _MM_SHUFFLE ( 3, 1, 3, 1 ) ) ), 0xD8 ) );
+
+        __m256 s = _mm256_add_ps ( _mm256_setzero_ps(), _mm256_andnot_ps ( ml1, l1 ) );
+        s = _mm256_add_ps ( s, _mm256_andnot_ps ( mr1, r1 ) );
+        s = _mm256_add_ps ( s, _mm256_andnot_ps ( ml2, l2 ) );
+        s = _mm256_add_ps ( s, _mm256_andnot_ps ( mr2, r2 ) );
+
+        // Un masque de non-donnée vaut -1 en entier
+        __m256i nb = _mm256_add_epi32 ( _mm256_add_epi32 ( _mm256_castps_si256 ( ml1 ), _mm256_castps_si256 ( mr1 ) ),
+                                        _mm256_add_epi32 ( _mm256_castps_si256 ( ml2 ), _mm256_castps_si256 ( mr2 ) ) );
+        nb = _mm256_add_epi32 ( nb, Four );
+        __m256i keep = _mm256_cmpgt_epi32 ( nb, One );
+        __m256 mean = _mm256_div_ps ( s, _mm256_cvtepi32_ps ( nb ) );
+        _mm256_storeu_ps ( to + x, _mm256_blendv_ps ( _mm256_loadu_ps ( to + x ), mean, _mm256_castsi256_ps ( keep ) ) );
+
+        __m128i k = _mm_packs_epi32 ( _mm256_castsi256_si128 ( keep ), _mm256_extracti128_si256 ( keep, 1 ) );
+        k = _mm_packs_epi16 ( k, k );
+        _mm_storel_epi64 ( ( __m128i* ) ( toMask + x ), _mm_or_si128 ( _mm_loadl_epi64 ( ( const __m128i* ) ( toMask + x ) ), k ) );
+    }
+    return x;
+}
+
+/* --------------------------- AVX-512 -------------------------- */
+
+TARGET_AVX512 void avx512_convert ( float* to, const uint8_t* from, int length ) {
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m128i m = _mm_loadu_si128 ( ( const __m128i* ) ( from + i ) );
+        _mm512_storeu_ps ( to + i, _mm512_cvtepi32_ps ( _mm512_cvtepu8_epi32 ( m ) ) );
+    }
+    for ( ; i < length; i++ ) to[i] = ( float ) from[i];
+}
+
+TARGET_AVX512 void avx512_convert ( float* to, const uint16_t* from, int length ) {
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m256i m = _mm256_loadu_si256 ( ( const __m256i* ) ( from + i ) );
+        _mm512_storeu_ps ( to + i, _mm512_cvtepi32_ps ( _mm512_cvtepu16_epi32 ( m ) ) );
+    }
+    for ( ; i < length; i++ ) to[i] = ( float ) from[i];
+}
+
+/**
+ * \~french \brief Arrondi au plus proche, avec saturation entre 0 et max, de 16 flottants (voir avx2_round)
+ * \~english \brief Round to nearest, with saturation between 0 and max, of 16 floats (see avx2_round)
+ */
+TARGET_AVX512 static inline __m512i avx512_round ( __m512 f, __m512 max ) {
+    f = _mm512_min_ps ( _mm512_max_ps ( f, _mm512_setzero_ps() ), max );
+    __m512 fl = _mm512_roundscale_ps ( f, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC );
+    __mmask16 up = _mm512_cmp_ps_mask ( _mm512_sub_ps ( f, fl ), _mm512_set1_ps ( 0.5f ), _CMP_GE_OQ );
+    return _mm512_cvttps_epi32 ( _mm512_mask_add_ps ( fl, up, fl, _mm512_set1_ps ( 1.f ) ) );
+}
+
+TARGET_AVX512 void avx512_convert ( uint8_t* to, const float* from, int length ) {
+    const __m512 max = _mm512_set1_ps ( 255.f );
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        _mm_storeu_si128 ( ( __m128i* ) ( to + i ), _mm512_cvtepi32_epi8 ( avx512_round ( _mm512_loadu_ps ( from + i ), max ) ) );
+    }
+    for ( ; i < length; i++ ) {
+        int t = ( int ) ( from[i] + 0.5 );
+        if ( t < 0 ) to[i] = 0;
+        else if ( t > 255 ) to[i] = 255;
+        else to[i] = t;
+    }
+}
+
+TARGET_AVX512 void avx512_convert ( uint16_t* to, const float* from, int length ) {
+    const __m512 max = _mm512_set1_ps ( 65535.f );
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        _mm256_storeu_si256 ( ( __m256i* ) ( to + i ), _mm512_cvtepi32_epi16 ( avx512_round ( _mm512_loadu_ps ( from + i ), max ) ) );
+    }
+    for ( ; i < length; i++ ) {
+        int t = ( int ) ( from[i] + 0.5 );
+        if ( t < 0 ) to[i] = 0;
+        else if ( t > 65535 ) to[i] = 65535;
+        else to[i] = t;
+    }
+}
+
+TARGET_AVX512 void avx512_mult ( float* to, const float* from, const float w, int length ) {
+    const __m512 W = _mm512_set1_ps ( w );
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) _mm512_storeu_ps ( to + i, _mm512_mul_ps ( W, _mm512_loadu_ps ( from + i ) ) );
+    for ( ; i < length; i++ ) to[i] = w * from[i];
+}
+
+TARGET_AVX512 void avx512_add_mult ( float* to, const float* from, const float w, int length ) {
+    const __m512 W = _mm512_set1_ps ( w );
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        _mm512_storeu_ps ( to + i, _mm512_add_ps ( _mm512_loadu_ps ( to + i ), _mm512_mul_ps ( W, _mm512_loadu_ps ( from + i ) ) ) );
+    }
+    for ( ; i < length; i++ ) to[i] += w * from[i];
+}
+
+TARGET_AVX512 void avx512_multiplex ( float* T, const float* F1, const float* F2, const float* F3, const float* F4, int length ) {
+    // Entrelacement des flottants puis des paires de flottants
+    const __m512i lo32 = _mm512_setr_epi32 ( 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23 );
+    const __m512i hi32 = _mm512_setr_epi32 ( 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31 );
+    const __m512i lo64 = _mm512_setr_epi64 ( 0, 8, 1, 9, 2, 10, 3, 11 );
+    const __m512i hi64 = _mm512_setr_epi64 ( 4, 12, 5, 13, 6, 14, 7, 15 );
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m512 f0 = _mm512_loadu_ps ( F1 + i );
+        __m512 f1 = _mm512_loadu_ps ( F2 + i );
+        __m512 f2 = _mm512_loadu_ps ( F3 + i );
+        __m512 f3 = _mm512_loadu_ps ( F4 + i );
+
+        __m512d L01 = _mm512_castps_pd ( _mm512_permutex2var_ps ( f0, lo32, f1 ) ); // A0 B0 A1 B1 ... A7 B7
+        __m512d H01 = _mm512_castps_pd ( _mm512_permutex2var_ps ( f0, hi32, f1 ) );
+        __m512d L23 = _mm512_castps_pd ( _mm512_permutex2var_ps ( f2, lo32, f3 ) ); // C0 D0 C1 D1 ... C7 D7
+        __m512d H23 = _mm512_castps_pd ( _mm512_permutex2var_ps ( f2, hi32, f3 ) );
+
+        _mm512_storeu_pd ( ( double* ) ( T + 4*i ),      _mm512_permutex2var_pd ( L01, lo64, L23 ) );
+        _mm512_storeu_pd ( ( double* ) ( T + 4*i + 16 ), _mm512_permutex2var_pd ( L01, hi64, L23 ) );
+        _mm512_storeu_pd ( ( double* ) ( T + 4*i + 32 ), _mm512_permutex2var_pd ( H01, lo64, H23 ) );
+        _mm512_storeu_pd ( ( double* ) ( T + 4*i + 48 ), _mm512_permutex2var_pd ( H01, hi64, H23 ) );
+    }
+    for ( ; i < length; i++ ) {
+        T[4*i] = F1[i];
+        T[4*i+1] = F2[i];
+        T[4*i+2] = F3[i];
+        T[4*i+3] = F4[i];
+    }
+}
+
+TARGET_AVX512 void avx512_demultiplex ( float* T1, float* T2, float* T3, float* T4, const float* F, int length ) {
+    // Séparation des paires de flottants puis des flottants
+    const __m512i even64 = _mm512_setr_epi64 ( 0, 2, 4, 6, 8, 10, 12, 14 );
+    const __m512i odd64 = _mm512_setr_epi64 ( 1, 3, 5, 7, 9, 11, 13, 15 );
+    const __m512i even32 = _mm512_setr_epi32 ( 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30 );
+    const __m512i odd32 = _mm512_setr_epi32 ( 1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31 );
+    int i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m512d v0 = _mm512_loadu_pd ( ( const double* ) ( F + 4*i ) );
+        __m512d v1 = _mm512_loadu_pd ( ( const double* ) ( F + 4*i + 16 ) );
+        __m512d v2 = _mm512_loadu_pd ( ( const double* ) ( F + 4*i + 32 ) );
+        __m512d v3 = _mm512_loadu_pd ( ( const double* ) ( F + 4*i + 48 ) );
+
+        __m512 AB0 = _mm512_castpd_ps ( _mm512_permutex2var_pd ( v0, even64, v1 ) ); // A0 B0 ... A7 B7
+        __m512 CD0 = _mm512_castpd_ps ( _mm512_permutex2var_pd ( v0, odd64, v1 ) );
+        __m512 AB1 = _mm512_castpd_ps ( _mm512_permutex2var_pd ( v2, even64, v3 ) ); // A8 B8 ... A15 B15
+        __m512 CD1 = _mm512_castpd_ps ( _mm512_permutex2var_pd ( v2, odd64, v3 ) );
+
+        _mm512_storeu_ps ( T1 + i, _mm512_permutex2var_ps ( AB0, even32, AB1 ) );
+        _mm512_storeu_ps ( T2 + i, _mm512_permutex2var_ps ( AB0, odd32, AB1 ) );
+        _mm512_storeu_ps ( T3 + i, _mm512_permutex2var_ps ( CD0, even32, CD1 ) );
+        _mm512_storeu_ps ( T4 + i, _mm512_permutex2var_ps ( CD0, odd32, CD1 ) );
+    }
+    for ( ; i < length; i++ ) {
+        T1[i] = F[4*i];
+        T2[i] = F[4*i+1];
+        T3[i] = F[4*i+2];
+        T4[i] = F[4*i+3];
+    }
+}
+
+#else // Pas d'AVX hors x86 : Simd::getLevel() vaut toujours SSE2 et ces fonctions ne sont jamais appelées
+
+void avx2_convert ( float* to, const uint8_t* from, int length ) {}
+void avx2_convert ( float* to, const uint16_t* from, int length ) {}
+void avx2_convert ( uint16_t* to, const uint8_t* from, int length ) {}
+void avx2_convert ( uint8_t* to, const float* from, int length ) {}
+void avx2_convert ( uint16_t* to, const float* from, int length ) {}
+void avx2_mult ( float* to, const float* from, const float w, int length ) {}
+void avx2_add_mult ( float* to, const float* from, const float w, int length ) {}
+void avx2_multiplex ( float* T, const float* F1, const float* F2, const float* F3, const float* F4, int length ) {}
+void avx2_demultiplex ( float* T1, float* T2, float* T3, float* T4, const float* F, int length ) {}
+int avx2_lookup ( uint32_t* to, const float* from, int length, const uint32_t* lut, const uint8_t* split, int size, double min, double invStep ) {
+    return 0;
+}
+int avx2_downsample_sum ( uint16_t* to, const uint8_t* from1, const uint8_t* from2, const uint8_t* mask1, const uint8_t* mask2, int length, int shift ) {
+    return 0;
+}
+int avx2_downsample_mean ( uint8_t* to, const uint16_t* sum, const uint8_t* number, const uint8_t* merge, int length ) {
+    return 0;
+}
+int avx2_downsample ( float* to, uint8_t* toMask, const float* from1, const float* from2, const uint8_t* mask1, const uint8_t* mask2, int width ) {
+    return 0;
+}
+void avx512_convert ( float* to, const uint8_t* from, int length ) {}
+void avx512_convert ( float* to, const uint16_t* from, int length ) {}
+void avx512_convert ( uint8_t* to, const float* from, int length ) {}
+void avx512_convert ( uint16_t* to, const float* from, int length ) {}
+void avx512_mult ( float* to, const float* from, const float w, int length ) {}
+void avx512_add_mult ( float* to, const float* from, const float w, int length ) {}
+void avx512_multiplex ( float* T, const float* F1, const float* F2, const float* F3, const float* F4, int length ) {}
+void avx512_demultiplex ( float* T1, float* T2, float* T3, float* T4, const float* F, int length ) {}
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file Simd.h
+ ** \~french
+ * \brief Définition de la classe Simd et des versions AVX2 / AVX-512 des fonctions de Utils.h
+ ** \~english
+ * \brief Define class Simd and AVX2 / AVX-512 versions of Utils.h functions
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+
+/**
+ * \~french \brief Variable d'environnement permettant de plafonner le jeu d'instructions utilisé ("sse2", "avx2" ou "avx512")
+ * \~english \brief Environment variable to cap the used instruction set ("sse2", "avx2" or "avx512")
+ */
+#define ROK4_SIMD "ROK4_SIMD"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Choix à l'exécution du jeu d'instructions vectorielles
+ * \details Cette classe est prévue pour être utilisée sans instance, à la manière de IndexCache.
+ *
+ * Le processeur est interrogé au chargement : les fonctions de Utils.h utilisent alors les registres de 256 bits (AVX2) ou de 512 bits (AVX-512) quand ils sont disponibles, et les versions SSE2 sinon. Un même binaire s'exécute donc sur toutes les machines.
+ *
+ * Les versions AVX n'utilisent pas d'opérations FMA et gardent l'ordre des calculs des versions SSE2 : le résultat ne dépend pas de la machine.
+ *
+ * Le produit scalaire dot_prod reste en SSE2 : il ne calcule que 4 pixels par appel, et le coût d'un appel non inliné dépasse le gain des registres plus larges.
+ * \~english
+ * \brief Runtime choice of the vector instruction set
+ * \details This class is intended to be used without instance, like IndexCache.
+ *
+ * Processor is queried at load time : Utils.h functions then use 256-bit (AVX2) or 512-bit (AVX-512) registers when available, and SSE2 versions otherwise. A single binary runs on every machine.
+ *
+ * AVX versions do not use FMA operations and keep the SSE2 versions' computation order : result does not depend on the machine.
+ *
+ * Dot product dot_prod stays SSE2 : it computes only 4 pixels per call, and a non inlined call costs more than wider registers save.
+ */
+class Simd {
+
+public:
+
+    /**
+     * \~french \brief Jeux d'instructions gérés, du moins au plus large
+     * \~english \brief Handled instruction sets, from the narrowest to the widest
+     */
+    enum Level {
+        SSE2 = 0,
+        AVX2 = 1,
+        AVX512 = 2
+    };
+
+private:
+
+    /**
+     * \~french \brief Jeu d'instructions le plus large géré par le processeur
+     * \~english \brief Widest instruction set handled by the processor
+     */
+    static Level supported;
+
+    /**
+     * \~french \brief Jeu d'instructions utilisé
+     * \~english \brief Used instruction set
+     */
+    static Level level;
+
+    /**
+     * \~french \brief Interroge le processeur, en tenant compte de la variable d'environnement #ROK4_SIMD
+     * \~english \brief Query the processor, taking into account the environment variable #ROK4_SIMD
+     */
+    static Level detect();
+
+public:
+
+    /**
+     * \~french \brief Retourne le jeu d'instructions utilisé
+     * \~english \brief Return the used instruction set
+     */
+    static Level getLevel() {
+        return level;
+    }
+
+    /**
+     * \~french \brief Retourne le jeu d'instructions le plus large utilisable
+     * \~english \brief Return the widest usable instruction set
+     */
+    static Level getSupportedLevel() {
+        return supported;
+    }
+
+    /**
+     * \~french
+     * \brief Impose le jeu d'instructions utilisé
+     * \details Le niveau demandé est ramené au plus large utilisable. Sert à comparer les versions entre elles.
+     * \param[in] l jeu d'instructions voulu
+     * \return le jeu d'instructions effectivement utilisé
+     * \~english
+     * \brief Force the used instruction set
+     * \details Asked level is brought back to the widest usable one. Used to compare versions.
+     * \param[in] l wanted instruction set
+     * \return the actually used instruction set
+     */
+    static Level setLevel ( Level l );
+
+    /**
+     * \~french \brief Nom d'un jeu d'instructions
+     * \~english \brief Instruction set's name
+     */
+    static const char* getLevelName ( Level l );
+};
+
+/* ---------------------------- AVX2 ---------------------------- */
+
+void avx2_convert ( float* to, const uint8_t* from, int length );
+void avx2_convert ( float* to, const uint16_t* from, int length );
+void avx2_convert ( uint16_t* to, const uint8_t* from, int length );
+void avx2_convert ( uint8_t* to, const float* from, int length );
+void avx2_convert ( uint16_t* to, const float* from, int length );
+void avx2_mult ( float* to, const float* from, const float w, int length );
+void avx2_add_mult ( float* to, const float* from, const float w, int length );
+void avx2_multiplex ( float* T, const float* F1, const float* F2, const float* F3, const float* F4, int length );
+void avx2_demultiplex ( float* T1, float* T2, float* T3, float* T4, const float* F, int length );
+int avx2_lookup ( uint32_t* to, const float* from, int length, const uint32_t* lut, const uint8_t* split, int size, double min, double invStep );
+int avx2_downsample_sum ( uint16_t* to, const uint8_t* from1, const uint8_t* from2, const uint8_t* mask1, const uint8_t* mask2, int length, int shift );
+int avx2_downsample_mean ( uint8_t* to, const uint16_t* sum, const uint8_t* number, const uint8_t* merge, int length );
+int avx2_downsample ( float* to, uint8_t* toMask, const float* from1, const float* from2, const uint8_t* mask1, const uint8_t* mask2, int width );
+
+/* --------------------------- AVX-512 -------------------------- */
+
+void avx512_convert ( float* to, const uint8_t* from, int length );
+void avx512_convert ( float* to, const uint16_t* from, int length );
+void avx512_convert ( uint8_t* to, const float* from, int length );
+void avx512_convert ( uint16_t* to, const float* from, int length );
+void avx512_mult ( float* to, const float* from, const float w, int length );
+void avx512_add_mult ( float* to, const float* from, const float w, int length );
+void avx512_multiplex ( float* T, const float* F1, const float* F2, const float* F3, const float* F4, int length );
+void avx512_demultiplex ( float* T1, float* T2, float* T3, float* T4, const float* F, int length );
+
+#endif
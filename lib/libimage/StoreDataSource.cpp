@@ -55,6 +55,8 @@
 #include <cstdio>
 #include <errno.h>
 #include "Rok4Image.h"
+#include "IndexCache.h"
+#include "TileCache.h"
 
 // Taille maximum d'une tuile WMTS
 #define MAX_TILE_SIZE 1048576
@@ -63,51 +65,55 @@ StoreDataSource::StoreDataSource (std::string n, const uint32_t o, const uint32_
     name ( n ), posoff(o), possize(s), maxsize(0), headerIndexSize(0), type (type), encoding( encoding ), context(c)
 {
     data = NULL;
+    buffer = NULL;
     size = 0;
     readIndex = false;
     alreadyTried = false;
+    located = -1;
+    pendingRead = NULL;
 }
 
 StoreDataSource::StoreDataSource (std::string n, const uint32_t po, const uint32_t ps, const uint32_t hisize, std::string type, Context* c, std::string encoding ) :
     name ( n ), posoff(po), possize(ps), maxsize(0), headerIndexSize(hisize), type (type), encoding( encoding ), context(c)
 {
     data = NULL;
+    buffer = NULL;
     size = 0;
     readIndex = true;
     alreadyTried = false;
+    located = -1;
+    pendingRead = NULL;
 }
 
-/*
- * Fonction retournant les données de la tuile
- * Le fichier/objet ne doit etre lu qu une seule fois
- * Indique la taille de la tuile (inconnue a priori)
- */
-const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
-    if ( alreadyTried) {
-        tile_size = size;
-        return data;
+bool StoreDataSource::locateTile ( uint32_t& tileOffset, uint32_t& tileSize ) {
+    if (located < 0) {
+        located = findTile(locatedOffset, locatedSize) ? 1 : 0;
     }
+    tileOffset = locatedOffset;
+    tileSize = locatedSize;
+    return (located == 1);
+}
 
-    alreadyTried = true;
-
-    // il se peut que le contexte ne soit pas connecté, auquel cas on sort directement sans donnée
-    if (! context->isConnected()) {
-        data = NULL;
-        return NULL;
-    }
+bool StoreDataSource::findTile ( uint32_t& tileOffset, uint32_t& tileSize ) {
 
     if (! readIndex) {
         // On a directement la taille et l'offset
-        data = new uint8_t[possize];
-        int tileSize = context->read(data, posoff, possize, name);
-        if (tileSize < 0) {
-            LOGGER_ERROR ( "Erreur lors de la lecture de la tuile dans l'objet (sans passer par l'index) " << name );
-            delete[] data;
-            data = NULL;
-            return NULL;
-        }
-        tile_size = tileSize;
-        size = tileSize;
+        tileOffset = posoff;
+        tileSize = possize;
+        return true;
+    }
+
+    // On cherche d'abord la position de la tuile dans le cache des index, partagé par tous les threads
+    indexKey = IndexCache::getKey(context, name);
+    int tileNumber = (posoff - ROK4_IMAGE_HEADER_SIZE) / 4;
+
+    // Un index lu sur une version antérieure de la dalle (réécrite depuis) est abandonné par le cache
+    if (tileKey.empty() && IndexCache::isEnabled()) {
+        version = context->getVersion(name);
+    }
+
+    if (IndexCache::getTileIndex(indexKey, tileNumber, name, tileOffset, tileSize, version)) {
+        LOGGER_DEBUG ( "Index de la dalle " << name << " trouvé dans le cache" );
     } else {
 
         uint8_t* indexheader = new uint8_t[headerIndexSize];
@@ -116,7 +122,7 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
         if ( realSize < 0) {
             LOGGER_ERROR ( "Erreur lors de la lecture du header et de l'index dans l'objet/fichier " << name );
             delete[] indexheader;
-            return NULL;
+            return false;
         }
 
         if ( realSize < ROK4_IMAGE_HEADER_SIZE ) {
@@ -125,7 +131,7 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
             if ( strncmp((char*) indexheader, ROK4_SYMLINK_SIGNATURE, ROK4_SYMLINK_SIGNATURE_SIZE) != 0 ) {
                 LOGGER_ERROR ( "Erreur lors de la lecture du header, l'objet " << name << " ne correspond pas à un objet lien " );
                 delete[] indexheader;
-                return NULL;
+                return false;
             }
 
             // On est dans le cas d'un objet symbolique
@@ -142,51 +148,176 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
             if ( realSize < 0) {
                 LOGGER_ERROR ( "Erreur lors de la lecture du header et de l'index dans l'objet/fichier " << name );
                 delete[] indexheader;
-                return NULL;
+                return false;
             }
             if ( realSize < ROK4_IMAGE_HEADER_SIZE ) {
                 LOGGER_ERROR ( "Erreur lors de la lecture : une dalle symbolique " << originalName << " référence une autre dalle symbolique " << name );
                 delete[] indexheader;
-                return NULL;
+                return false;
             }
         }
 
-        // On est dans le cas d'une dalle
-        uint32_t tileOffset = *((uint32_t*) (indexheader + posoff ));
-        uint32_t tileSize = *((uint32_t*) (indexheader + possize ));
+        // On est dans le cas d'une dalle, dont on mémorise l'index (la résolution du lien symbolique est incluse)
+        int tilesNumber = (headerIndexSize - ROK4_IMAGE_HEADER_SIZE) / 8;
+        IndexCache::addSlabIndex(indexKey, name, tilesNumber,
+            (uint32_t*) (indexheader + ROK4_IMAGE_HEADER_SIZE),
+            (uint32_t*) (indexheader + ROK4_IMAGE_HEADER_SIZE + 4 * tilesNumber),
+            version
+        );
 
-        // La taille de la tuile ne doit pas exceder un seuil
-        // Objectif : gerer le cas de fichiers TIFF non conformes aux specs du cache
-        // (et qui pourraient indiquer des tailles de tuiles excessives)
+        tileOffset = *((uint32_t*) (indexheader + posoff ));
+        tileSize = *((uint32_t*) (indexheader + possize ));
 
-        if ( tileSize > MAX_TILE_SIZE ) {
-            LOGGER_ERROR ( "Tuile trop volumineuse dans le fichier/objet " << name ) ;
-            delete[] indexheader;
-            return NULL;
-        }
+        delete[] indexheader;
+    }
 
+    // La taille de la tuile ne doit pas exceder un seuil
+    // Objectif : gerer le cas de fichiers TIFF non conformes aux specs du cache
+    // (et qui pourraient indiquer des tailles de tuiles excessives)
 
-        if ( tileSize == 0 ) {
-            LOGGER_DEBUG ( "Tuile non présente dans la dalle (taille nulle) " << name ) ;
-            delete[] indexheader;
-            return NULL;
-        }
+    if ( tileSize > MAX_TILE_SIZE ) {
+        LOGGER_ERROR ( "Tuile trop volumineuse dans le fichier/objet " << name ) ;
+        return false;
+    }
+
+    if ( tileSize == 0 ) {
+        LOGGER_DEBUG ( "Tuile non présente dans la dalle (taille nulle) " << name ) ;
+        return false;
+    }
+
+    return true;
+}
+
+bool StoreDataSource::endReading ( int realSize ) {
 
-        // Lecture de la tuile
-        data = new uint8_t[tileSize];
-        if (context->read(data, tileOffset, tileSize, name) < 0) {
-            delete[] data;
-            data = NULL;
+    if (realSize < 0) {
+        releaseData();
+        if (! readIndex) {
+            LOGGER_ERROR ( "Erreur lors de la lecture de la tuile dans l'objet (sans passer par l'index) " << name );
+        } else {
             LOGGER_ERROR ( "Erreur lors de la lecture de la tuile dans l'objet " << name );
-            delete[] indexheader;
-            return NULL;
+            // La dalle a pu être réécrite depuis la mise en cache de son index
+            IndexCache::invalidate(indexKey);
         }
-        delete[] indexheader;
+        return false;
+    }
+
+    size = realSize;
 
-        tile_size = tileSize;
-        size = tileSize;
+    if (! tileKey.empty()) {
+        TileCache::addTile(tileKey, buffer, size, getTag(), getModification(), version);
     }
 
+    return true;
+}
+
+/*
+ * Fonction retournant les données de la tuile
+ * Le fichier/objet ne doit etre lu qu une seule fois
+ * Indique la taille de la tuile (inconnue a priori)
+ */
+const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
+    if ( alreadyTried) {
+        tile_size = size;
+        return data;
+    }
+
+    alreadyTried = true;
+
+    // il se peut que le contexte ne soit pas connecté, auquel cas on sort directement sans donnée
+    if (! context->isConnected()) {
+        data = NULL;
+        return NULL;
+    }
+
+    uint32_t tileOffset, tileSize;
+    if (! locateTile(tileOffset, tileSize)) {
+        return NULL;
+    }
+
+    // Lecture de la tuile, dans un tampon réutilisé
+    allocate(tileSize);
+    if (! endReading(context->read(data, tileOffset, tileSize, name))) {
+        return NULL;
+    }
+
+    tile_size = size;
     return data;
+}
+
+PooledBuffer* StoreDataSource::getBuffer ( size_t &tile_size ) {
+    if (getData(tile_size) == NULL) return NULL;
+    return buffer;
+}
+
+std::string StoreDataSource::getTag () {
+    if (! context->isConnected()) return "";
+
+    uint32_t tileOffset, tileSize;
+    if (! locateTile(tileOffset, tileSize)) return "";
+
+    // Empreinte FNV-1a de la dalle : l'index suffit à identifier la tuile, elle n'est pas lue
+    std::string slab = context->getTypeStr() + ":" + context->getTray() + ":" + name;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < slab.size(); i++) {
+        hash ^= (uint8_t) slab[i];
+        hash *= 1099511628211ULL;
+    }
+
+    char tag[48];
+    snprintf(tag, sizeof(tag), "%016llx-%x-%x", (unsigned long long) hash, tileOffset, tileSize);
+    return std::string(tag);
+}
+
+time_t StoreDataSource::getModification () {
+    uint32_t tileOffset, tileSize;
+    if (! context->isConnected() || ! locateTile(tileOffset, tileSize)) return 0;
+    return context->getModification(name);
+}
+
+void StoreDataSource::prepareReads ( std::vector<StoreDataSource*>& sources, std::map<Context*, std::vector<ContextRead*> >& reads ) {
+
+    // Les positions des tuiles sont déterminées (le plus souvent grâce au cache des index)
+    for (size_t i = 0; i < sources.size(); i++) {
+        StoreDataSource* sds = sources.at(i);
+        if (sds == NULL || sds->alreadyTried) continue;
+
+        sds->alreadyTried = true;
+        if (! sds->context->isConnected()) continue;
+
+        uint32_t tileOffset, tileSize;
+        if (! sds->locateTile(tileOffset, tileSize)) continue;
+
+        sds->allocate(tileSize);
+        sds->pendingRead = new ContextRead(sds->data, tileOffset, tileSize, sds->name);
+        reads[sds->context].push_back(sds->pendingRead);
+    }
+}
+
+void StoreDataSource::endReads ( std::vector<StoreDataSource*>& sources ) {
+    for (size_t i = 0; i < sources.size(); i++) {
+        StoreDataSource* sds = sources.at(i);
+        if (sds == NULL || sds->pendingRead == NULL) continue;
+
+        sds->endReading(sds->pendingRead->result);
+        delete sds->pendingRead;
+        sds->pendingRead = NULL;
+    }
+}
+
+void StoreDataSource::prefetch ( std::vector<StoreDataSource*>& sources ) {
+
+    std::map<Context*, std::vector<ContextRead*> > reads;
+    prepareReads(sources, reads);
+
+    // Les tuiles sont lues par lot, toutes les lectures d'un contexte étant en cours en même temps
+    std::map<Context*, std::vector<ContextRead*> >::iterator it;
+    for (it = reads.begin(); it != reads.end(); ++it) {
+        it->first->submitReads(it->second);
+    }
+    for (it = reads.begin(); it != reads.end(); ++it) {
+        it->first->waitReads(it->second);
+    }
 
+    endReads(sources);
 }
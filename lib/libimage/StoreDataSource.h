@@ -54,8 +54,11 @@
 
 #include "Data.h"
 #include "Context.h"
+#include "BufferPool.h"
 #include <stdlib.h>
 #include <string>
+#include <map>
+#include <vector>
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -104,6 +107,21 @@ protected:
      * \details If asked serveral times, data source is read only once
      */
     uint8_t* data;
+    /**
+     * \~french \brief Tampon partagé contenant #data, obtenu auprès de la réserve (BufferPool)
+     * \details Il est partagé sans copie avec le cache des tuiles et la réponse en cours d'envoi
+     * \~english \brief Shared buffer containing #data, got from the pool (BufferPool)
+     * \details It is shared without copy with the tiles cache and the response being sent
+     */
+    PooledBuffer* buffer;
+    /**
+     * \~french \brief Obtient #buffer pour une tuile de la taille donnée
+     * \~english \brief Get #buffer for a tile of the given size
+     */
+    void allocate ( size_t tileSize ) {
+        buffer = BufferPool::acquire ( tileSize );
+        data = buffer->getData();
+    }
     /**
      * \~french \brief A-t-on déjà essayé de lire la donnée
      * \~english \brief Have we already tried to read data
@@ -133,6 +151,67 @@ protected:
 
     const uint32_t headerIndexSize;
 
+    /**
+     * \~french \brief Clé de l'index de la dalle dans le cache des index
+     * \~english \brief Key of the slab's index in the indexes cache
+     */
+    std::string indexKey;
+
+    /**
+     * \~french \brief Clé de la tuile dans le cache des tuiles, vide si la tuile ne doit pas y être ajoutée
+     * \~english \brief Tile's key in the tiles cache, empty if tile must not be added
+     */
+    std::string tileKey;
+
+    /**
+     * \~french \brief Version de la dalle avant sa lecture (Context::getVersion), enregistrée avec l'index et la tuile dans les caches
+     * \~english \brief Slab's version before its reading (Context::getVersion), recorded with index and tile in caches
+     */
+    std::string version;
+
+    /**
+     * \~french \brief Résultat de #locateTile : -1 si pas encore cherché, 0 si la tuile est absente, 1 si elle est trouvée
+     * \~english \brief #locateTile result : -1 if not searched yet, 0 if tile is missing, 1 if found
+     */
+    int located;
+    /**
+     * \~french \brief Position et taille de la tuile trouvées par #locateTile
+     * \~english \brief Tile's position and size found by #locateTile
+     */
+    uint32_t locatedOffset, locatedSize;
+
+    /**
+     * \~french \brief Lecture de la tuile préparée par #prepareReads, NULL si aucune
+     * \~english \brief Tile's reading prepared by #prepareReads, NULL if none
+     */
+    ContextRead* pendingRead;
+
+    /**
+     * \~french \brief Détermine la position et la taille de la tuile dans l'objet
+     * \details Dans le cas d'une lecture partielle, l'index est cherché dans le cache puis lu dans la dalle. Les liens symboliques sont résolus (#name est modifié). Le résultat est mémorisé.
+     * \return Faux si la tuile n'est pas lisible ou absente
+     * \~english \brief Determine the tile's position and size in the object
+     * \details For partially reading, index is searched in the cache then read in the slab. Symbolic links are resolved (#name is modified). Result is memorized.
+     * \return False if tile is not readable or missing
+     */
+    bool locateTile ( uint32_t& tileOffset, uint32_t& tileSize );
+
+    /**
+     * \~french \brief Recherche de la position et de la taille de la tuile, sans mémorisation
+     * \~english \brief Tile's position and size search, without memorization
+     */
+    bool findTile ( uint32_t& tileOffset, uint32_t& tileSize );
+
+    /**
+     * \~french \brief Termine la lecture de la tuile dans #data
+     * \param[in] realSize Taille effectivement lue, négative en cas d'erreur
+     * \return Faux en cas d'erreur, auquel cas #data est supprimé
+     * \~english \brief End the tile's reading in #data
+     * \param[in] realSize Real read size, negative if an error occured
+     * \return False if an error occured, #data is then deleted
+     */
+    bool endReading ( int realSize );
+
 public:
 
     /** \~french
@@ -214,15 +293,91 @@ public:
      */
     virtual const uint8_t* getData ( size_t &tile_size );
 
+    /** \~french
+     * \brief Récupère la donnée depuis la source, dans son tampon partagé
+     * \param[out] tile_size Taille utile dans le tampon
+     * \return Le tampon, NULL si la donnée n'a pu être lue
+     ** \~english
+     * \brief Get the data from the source, in its shared buffer
+     * \param[out] tile_size Real size of data in the buffer
+     * \return The buffer, NULL if data could not be read
+     */
+    virtual PooledBuffer* getBuffer ( size_t &tile_size );
+
+    /** \~french
+     * \brief Identifiant de la tuile, déduit de l'index de la dalle sans lire la tuile
+     * \details Il est composé d'une empreinte du contexte et du nom de la dalle (liens symboliques résolus), de la position et de la taille de la tuile dans la dalle.
+     * \return Identifiant, vide si la tuile est absente
+     ** \~english
+     * \brief Tile's identifier, deduced from the slab's index without reading the tile
+     * \details It is made of a hash of the context and the slab's name (symbolic links resolved), and of the tile's position and size in the slab.
+     * \return Identifier, empty if tile is missing
+     */
+    virtual std::string getTag();
+
+    /** \~french
+     * \brief Date de modification de la dalle, si le contexte la connaît sans requête (Context::getModification)
+     ** \~english
+     * \brief Slab's modification date, if the context knows it without request (Context::getModification)
+     */
+    virtual time_t getModification();
+
+    /** \~french
+     * \brief Lit les données de plusieurs sources en une seule fois
+     * \details Les positions des tuiles sont déterminées une à une, puis les tuiles sont lues par lot (Context::submitReads), en parallèle si le contexte le permet. Les appels suivants à #getData retournent directement la donnée lue.
+     * \param[in] sources Sources à lire, ignorées si NULL ou déjà lues
+     ** \~english
+     * \brief Read data of several sources at once
+     * \details Tiles' positions are determined one by one, then tiles are read as a batch (Context::submitReads), in parallel if context allows it. Following calls to #getData directly return read data.
+     * \param[in] sources Sources to read, ignored if NULL or already read
+     */
+    static void prefetch ( std::vector<StoreDataSource*>& sources );
+
+    /** \~french
+     * \brief Prépare les lectures des données de plusieurs sources, sans les lancer
+     * \details Les positions des tuiles sont déterminées et les tampons obtenus. Les lectures peuvent alors être faites par un autre thread, qui les lance et les attend (Context::submitReads, Context::waitReads), puis elles sont terminées avec #endReads.
+     * \param[in] sources Sources à lire, ignorées si NULL ou déjà lues
+     * \param[out] reads Lectures à faire, par contexte, possédées par les sources
+     ** \~english
+     * \brief Prepare readings of several sources' data, without starting them
+     * \details Tiles' positions are determined and buffers got. Readings can then be done by another thread, which starts and waits for them (Context::submitReads, Context::waitReads), then they are ended with #endReads.
+     * \param[in] sources Sources to read, ignored if NULL or already read
+     * \param[out] reads Readings to do, by context, owned by sources
+     */
+    static void prepareReads ( std::vector<StoreDataSource*>& sources, std::map<Context*, std::vector<ContextRead*> >& reads );
+
+    /** \~french
+     * \brief Termine les lectures préparées par #prepareReads, une fois faites
+     * \details Les appels suivants à #getData retournent directement la donnée lue.
+     ** \~english
+     * \brief End readings prepared by #prepareReads, once done
+     * \details Following calls to #getData directly return read data.
+     */
+    static void endReads ( std::vector<StoreDataSource*>& sources );
+
+    /**
+     * \~french \brief Demande l'ajout de la tuile au cache des tuiles (TileCache) une fois lue
+     * \param[in] key Clé de la tuile, obtenue avec TileCache::getKey
+     * \param[in] v Version de la dalle, obtenue avec Context::getVersion avant la recherche dans le cache des tuiles
+     * \~english \brief Ask to add the tile to the tiles cache (TileCache) once read
+     * \param[in] key Tile's key, from TileCache::getKey
+     * \param[in] v Slab's version, from Context::getVersion before the lookup in the tiles cache
+     */
+    void setTileKey ( std::string key, std::string v ) {
+        tileKey = key;
+        version = v;
+    }
+
 
     /**
-     * \~french \brief Supprime la donnée mémorisée (#data)
-     * \~english \brief Delete memorized data (#data)
+     * \~french \brief Libère la donnée mémorisée (#data), son tampon retourne dans la réserve s'il n'est plus partagé
+     * \~english \brief Release memorized data (#data), its buffer goes back to the pool if no more shared
      */
     bool releaseData() {
-        if (data) {
-            delete[] data;
+        if (buffer) {
+            buffer->release();
         }
+        buffer = 0;
         data = 0;
         return true;
     }
@@ -234,6 +389,7 @@ public:
      * \details Call #releaseData
      */
     ~StoreDataSource(){
+        delete pendingRead;
         releaseData();
     }
 
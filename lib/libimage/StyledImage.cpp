@@ -73,28 +73,10 @@ StyledImage::~StyledImage() {
 int StyledImage::_getline ( uint8_t* buffer, int line ) {
     float* source = new float[origImage->getWidth() *origImage->getChannels()];
     origImage->getline ( source, line );
-    //TODO Optimize It
-    int i = 0;
-    switch ( channels ) {
-    case 4:
-        for ( ; i < origImage->getWidth() ; i++ ) {
-            Colour iColour = palette->getColour ( * ( source+i ) );
-            * ( buffer+i*4 ) = iColour.r;
-            * ( buffer+i*4+1 ) = iColour.g;
-            * ( buffer+i*4+2 ) = iColour.b;
-            * ( buffer+i*4+3 ) = iColour.a;
-        }
-    case 3:
-        for ( ; i < origImage->getWidth() ; i++ ) {
-            Colour iColour = palette->getColour ( * ( source+i ) );
-            * ( buffer+i*3 ) = iColour.r;
-            * ( buffer+i*3+1 ) = iColour.g;
-            * ( buffer+i*3+2 ) = iColour.b;
-        }
-    }
+    palette->apply ( buffer, source, origImage->getWidth(), channels );
 
     delete[] source;
-    return i*sizeof ( uint8_t ) *channels;
+    return origImage->getWidth() * sizeof ( uint8_t ) * channels;
 
 }
 
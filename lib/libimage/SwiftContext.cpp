@@ -286,6 +286,34 @@ bool SwiftContext::connection() {
     return true;
 }
 
+struct curl_slist* SwiftContext::setReadOptions(CURL* curl, DataStruct* chunk, int offset, int size, std::string name) {
+
+    struct curl_slist *list = NULL;
+
+    int lastBytes = offset + size - 1;
+
+    // On constitue le header et le moyen de récupération des informations (avec les structures de LibcurlStruct)
+
+    std::string fullUrl;
+    fullUrl = public_url + "/" + container_name + "/" + name;
+
+    char range[50];
+    sprintf(range, "Range: bytes=%d-%d", offset, lastBytes);
+
+    list = curl_slist_append(list, token.c_str());
+    list = curl_slist_append(list, range);
+
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+    curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
+    if(ssl_no_verify){
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    }
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) chunk);
+
+    return list;
+}
+
 int SwiftContext::read(uint8_t* data, int offset, int size, std::string name) {
 
     if (! connected) {
@@ -300,34 +328,14 @@ int SwiftContext::read(uint8_t* data, int offset, int size, std::string name) {
     while (attempt <= attempts) {
         
         CURLcode res;
-        struct curl_slist *list = NULL;
         DataStruct chunk;
         chunk.nbPassage = 0;
         chunk.data = (char*) malloc(1);
         chunk.size = 0;
 
-        int lastBytes = offset + size - 1;
-
         CURL* curl = CurlPool::getCurlEnv();
 
-        // On constitue le header et le moyen de récupération des informations (avec les structures de LibcurlStruct)
-
-        std::string fullUrl;
-        fullUrl = public_url + "/" + container_name + "/" + name;
-
-        char range[50];
-        sprintf(range, "Range: bytes=%d-%d", offset, lastBytes);
-
-        list = curl_slist_append(list, token.c_str());
-        list = curl_slist_append(list, range);
-
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
-        curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
-        if(ssl_no_verify){
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-        }
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
+        struct curl_slist *list = setReadOptions(curl, &chunk, offset, size, name);
 
         LOGGER_DEBUG("SWIFT READ START (" << size << ") " << pthread_self());
         res = curl_easy_perform(curl);
@@ -375,6 +383,55 @@ int SwiftContext::read(uint8_t* data, int offset, int size, std::string name) {
     return -1;
 }
 
+void SwiftContext::submitReads(std::vector<ContextRead*>& reads) {
+
+    if (! connected) {
+        LOGGER_ERROR("Impossible de lire via un contexte non connecté");
+        return;
+    }
+
+    LOGGER_DEBUG("Swift asynchronous read : " << reads.size() << " readings");
+
+    for (size_t i = 0; i < reads.size(); i++) {
+        ContextRead* r = reads.at(i);
+        CurlRequest* req = new CurlRequest();
+        req->list = setReadOptions(req->curl, &(req->chunk), r->offset, r->size, r->name);
+        r->pending = (void*) req;
+        CurlPool::addRequest(req);
+    }
+}
+
+void SwiftContext::waitReads(std::vector<ContextRead*>& reads) {
+
+    std::vector<CurlRequest*> reqs;
+    for (size_t i = 0; i < reads.size(); i++) {
+        if (reads.at(i)->pending != NULL) reqs.push_back((CurlRequest*) reads.at(i)->pending);
+    }
+
+    CurlPool::waitRequests(reqs);
+
+    for (size_t i = 0; i < reads.size(); i++) {
+        ContextRead* r = reads.at(i);
+        if (r->pending == NULL) continue;
+        CurlRequest* req = (CurlRequest*) r->pending;
+        r->pending = NULL;
+
+        long http_code = 0;
+        curl_easy_getinfo (req->curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+        if( CURLE_OK == req->code && http_code >= 200 && http_code <= 299) {
+            memcpy(r->data, req->chunk.data, req->chunk.size);
+            r->result = req->chunk.size;
+        } else {
+            // Authentification expirée ou échec ponctuel : la lecture synchrone gère la reconnexion et les tentatives
+            LOGGER_DEBUG("Asynchronous Swift read failed (HTTP code " << http_code << "), try again synchronously");
+            r->result = read(r->data, r->offset, r->size, r->name);
+        }
+
+        delete req;
+    }
+}
+
 bool SwiftContext::write(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("Swift write : " << size << " bytes (from the " << offset << " one) in the writing buffer " << name);
 
@@ -147,6 +147,14 @@ private:
      */
     bool ssl_no_verify;
 
+    /**
+     * \~french \brief Configure un objet curl pour la lecture d'une partie d'un objet Swift
+     * \return Les en-têtes de la requête, à libérer une fois la requête terminée
+     * \~english \brief Configure a curl object to read a part of a Swift object
+     * \return Request's headers, to free once request is over
+     */
+    struct curl_slist* setReadOptions(CURL* curl, DataStruct* chunk, int offset, int size, std::string name);
+
 
 public:
 
@@ -191,6 +199,32 @@ public:
      */
     int read(uint8_t* data, int offset, int size, std::string name);
 
+    /**
+     * \~french \brief Les lectures Swift peuvent être menées en parallèle
+     * \~english \brief Swift readings can be handled in parallel
+     */
+    bool asyncReads() {
+        return true;
+    }
+
+    /**
+     * \~french
+     * \brief Lance un lot de lectures Swift, menées en parallèle par un objet curl multiple
+     * \~english
+     * \brief Start a batch of Swift readings, handled in parallel by a curl multi object
+     */
+    void submitReads(std::vector<ContextRead*>& reads);
+
+    /**
+     * \~french
+     * \brief Attend la fin d'un lot de lectures Swift
+     * \details Les lectures en échec sont refaites une à une (#read), avec les tentatives supplémentaires et la réauthentification éventuelle
+     * \~english
+     * \brief Wait for a batch of Swift readings
+     * \details Failed readings are done again one by one (#read), with additional attempts and potential reauthentication
+     */
+    void waitReads(std::vector<ContextRead*>& reads);
+
     /**
      * \~french
      * \brief Écrit de la donnée dans un objet Swift
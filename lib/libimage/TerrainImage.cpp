@@ -0,0 +1,253 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file TerrainImage.cpp
+ ** \~french
+ * \brief Implémentation de la classe TerrainImage
+ ** \~english
+ * \brief Implements class TerrainImage
+ */
+
+#include "TerrainImage.h"
+#include "Utils.h"
+#include <cmath>
+#include <cstring>
+
+TerrainImage::TerrainImage ( int width, int height, int channels, BoundingBox<double> bbox, Image* image ) :
+    Image ( width, height, channels, bbox ), origImage ( image ), windowLine ( -1 ) {
+
+    int origWidth = origImage->getWidth();
+    // 3 lignes d'origine, puis dzdx, dzdy et la ligne calculée. On prévoit 4 flottants de plus par ligne pour les lectures SSE
+    memory = new float[3 * ( origWidth + 4 ) + 3 * ( width + 4 )];
+    window[0] = memory;
+    window[1] = window[0] + origWidth + 4;
+    window[2] = window[1] + origWidth + 4;
+    dzdx = window[2] + origWidth + 4;
+    dzdy = dzdx + width + 4;
+    result = dzdy + width + 4;
+}
+
+TerrainImage::~TerrainImage() {
+    delete origImage;
+    delete[] memory;
+}
+
+void TerrainImage::compute ( int line ) {
+    if ( line == windowLine ) return;
+
+    if ( windowLine >= 0 && line == windowLine + 1 ) {
+        // Lecture dans l'ordre : la fenêtre glisse d'une ligne
+        float* top = window[0];
+        window[0] = window[1];
+        window[1] = window[2];
+        window[2] = top;
+        origImage->getline ( window[2], line + 2 );
+    } else {
+        origImage->getline ( window[0], line );
+        origImage->getline ( window[1], line + 1 );
+        origImage->getline ( window[2], line + 2 );
+    }
+    windowLine = line;
+
+    computeLine();
+}
+
+int TerrainImage::getline ( float* buffer, int line ) {
+    compute ( line );
+    memcpy ( buffer, result, width * sizeof ( float ) );
+    return width;
+}
+
+int TerrainImage::getline ( uint16_t* buffer, int line ) {
+    compute ( line );
+    convert ( buffer, result, width );
+    return width;
+}
+
+int TerrainImage::getline ( uint8_t* buffer, int line ) {
+    compute ( line );
+    convert ( buffer, result, width );
+    return width;
+}
+
+void TerrainImage::hornGradient ( float divx, float divy ) {
+    const float* l1 = window[0];
+    const float* l2 = window[1];
+    const float* l3 = window[2];
+    int j = 0;
+
+#ifdef __SSE2__
+    const __m128 two = _mm_set1_ps ( 2.f );
+    const __m128 DX = _mm_set1_ps ( divx );
+    const __m128 DY = _mm_set1_ps ( divy );
+    for ( ; j + 4 <= width; j += 4 ) {
+        __m128 a = _mm_loadu_ps ( l1 + j ), b = _mm_loadu_ps ( l1 + j + 1 ), c = _mm_loadu_ps ( l1 + j + 2 );
+        __m128 d = _mm_loadu_ps ( l2 + j ),                                  f = _mm_loadu_ps ( l2 + j + 2 );
+        __m128 g = _mm_loadu_ps ( l3 + j ), h = _mm_loadu_ps ( l3 + j + 1 ), i = _mm_loadu_ps ( l3 + j + 2 );
+
+        __m128 right = _mm_add_ps ( _mm_add_ps ( c, _mm_mul_ps ( two, f ) ), i );
+        __m128 left = _mm_add_ps ( _mm_add_ps ( a, _mm_mul_ps ( two, d ) ), g );
+        __m128 bottom = _mm_add_ps ( _mm_add_ps ( g, _mm_mul_ps ( two, h ) ), i );
+        __m128 top = _mm_add_ps ( _mm_add_ps ( a, _mm_mul_ps ( two, b ) ), c );
+
+        _mm_storeu_ps ( dzdx + j, _mm_div_ps ( _mm_sub_ps ( right, left ), DX ) );
+        _mm_storeu_ps ( dzdy + j, _mm_div_ps ( _mm_sub_ps ( bottom, top ), DY ) );
+    }
+#endif
+
+    for ( ; j < width; j++ ) {
+        dzdx[j] = ( ( l1[j+2] + 2 * l2[j+2] + l3[j+2] ) - ( l1[j] + 2 * l2[j] + l3[j] ) ) / divx;
+        dzdy[j] = ( ( l3[j] + 2 * l3[j+1] + l3[j+2] ) - ( l1[j] + 2 * l1[j+1] + l1[j+2] ) ) / divy;
+    }
+}
+
+void TerrainImage::zevenbergenGradient ( float divx, float divy ) {
+    const float* l1 = window[0];
+    const float* l2 = window[1];
+    const float* l3 = window[2];
+    int j = 0;
+
+#ifdef __SSE2__
+    const __m128 DX = _mm_set1_ps ( divx );
+    const __m128 DY = _mm_set1_ps ( divy );
+    for ( ; j + 4 <= width; j += 4 ) {
+        _mm_storeu_ps ( dzdx + j, _mm_div_ps ( _mm_sub_ps ( _mm_loadu_ps ( l2 + j + 2 ), _mm_loadu_ps ( l2 + j ) ), DX ) );
+        _mm_storeu_ps ( dzdy + j, _mm_div_ps ( _mm_sub_ps ( _mm_loadu_ps ( l3 + j + 1 ), _mm_loadu_ps ( l1 + j + 1 ) ), DY ) );
+    }
+#endif
+
+    for ( ; j < width; j++ ) {
+        dzdx[j] = ( l2[j+2] - l2[j] ) / divx;
+        dzdy[j] = ( l3[j+1] - l1[j+1] ) / divy;
+    }
+}
+
+void TerrainImage::applyNoData ( float nodata, float value ) {
+    int j = 0;
+
+#ifdef __SSE2__
+    const __m128 ND = _mm_set1_ps ( nodata );
+    const __m128 V = _mm_set1_ps ( value );
+    for ( ; j + 4 <= width; j += 4 ) {
+        __m128 m = _mm_setzero_ps();
+        for ( int l = 0; l < 3; l++ )
+            for ( int k = 0; k < 3; k++ )
+                m = _mm_or_ps ( m, _mm_cmpeq_ps ( _mm_loadu_ps ( window[l] + j + k ), ND ) );
+        _mm_storeu_ps ( result + j, _mm_or_ps ( _mm_and_ps ( m, V ), _mm_andnot_ps ( m, _mm_loadu_ps ( result + j ) ) ) );
+    }
+#endif
+
+    for ( ; j < width; j++ ) {
+        for ( int l = 0; l < 3; l++ )
+            for ( int k = 0; k < 3; k++ )
+                if ( window[l][j + k] == nodata ) result[j] = value;
+    }
+}
+
+#ifdef __SSE2__
+
+/**
+ * \~french \brief Arc tangente de 4 flottants, d'après l'atanf de Cephes : réduction à [0, tan(pi/8)] puis polynôme
+ * \~english \brief Arc tangent of 4 floats, from Cephes' atanf : reduction to [0, tan(pi/8)] then polynomial
+ */
+static inline __m128 atan4 ( __m128 x ) {
+    const __m128 signMask = _mm_set1_ps ( -0.f );
+    __m128 sign = _mm_and_ps ( x, signMask );
+    x = _mm_andnot_ps ( signMask, x );
+
+    __m128 big = _mm_cmpgt_ps ( x, _mm_set1_ps ( 2.414213562373095f ) );
+    __m128 mid = _mm_andnot_ps ( big, _mm_cmpgt_ps ( x, _mm_set1_ps ( 0.4142135623730950f ) ) );
+
+    __m128 y0 = _mm_or_ps ( _mm_and_ps ( big, _mm_set1_ps ( ( float ) M_PI_2 ) ), _mm_and_ps ( mid, _mm_set1_ps ( ( float ) M_PI_4 ) ) );
+    const __m128 one = _mm_set1_ps ( 1.f );
+    __m128 xBig = _mm_div_ps ( _mm_set1_ps ( -1.f ), x );
+    __m128 xMid = _mm_div_ps ( _mm_sub_ps ( x, one ), _mm_add_ps ( x, one ) );
+    x = _mm_or_ps ( _mm_and_ps ( big, xBig ), _mm_andnot_ps ( big, _mm_or_ps ( _mm_and_ps ( mid, xMid ), _mm_andnot_ps ( mid, x ) ) ) );
+
+    __m128 z = _mm_mul_ps ( x, x );
+    __m128 p = _mm_set1_ps ( 8.05374449538e-2f );
+    p = _mm_sub_ps ( _mm_mul_ps ( p, z ), _mm_set1_ps ( 1.38776856032e-1f ) );
+    p = _mm_add_ps ( _mm_mul_ps ( p, z ), _mm_set1_ps ( 1.99777106478e-1f ) );
+    p = _mm_sub_ps ( _mm_mul_ps ( p, z ), _mm_set1_ps ( 3.33329491539e-1f ) );
+    p = _mm_add_ps ( _mm_mul_ps ( _mm_mul_ps ( p, z ), x ), x );
+
+    return _mm_xor_ps ( _mm_add_ps ( y0, p ), sign );
+}
+
+void atan_ps ( float* to, const float* from, int length ) {
+    int i = 0;
+    for ( ; i + 4 <= length; i += 4 ) _mm_storeu_ps ( to + i, atan4 ( _mm_loadu_ps ( from + i ) ) );
+    for ( ; i < length; i++ ) to[i] = atan ( from[i] );
+}
+
+void atan2_ps ( float* to, const float* y, const float* x, int length ) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_set1_ps ( -0.f );
+    const __m128 pi = _mm_set1_ps ( ( float ) M_PI );
+    const __m128 halfPi = _mm_set1_ps ( ( float ) M_PI_2 );
+    int i = 0;
+    for ( ; i + 4 <= length; i += 4 ) {
+        __m128 Y = _mm_loadu_ps ( y + i );
+        __m128 X = _mm_loadu_ps ( x + i );
+        __m128 a = atan4 ( _mm_div_ps ( Y, X ) );
+
+        // x < 0 : on ajoute pi du signe de y
+        __m128 ySign = _mm_and_ps ( Y, signMask );
+        a = _mm_add_ps ( a, _mm_and_ps ( _mm_cmplt_ps ( X, zero ), _mm_xor_ps ( pi, ySign ) ) );
+
+        // x = 0 : pi/2 du signe de y, 0 si y est nul aussi
+        __m128 xNull = _mm_cmpeq_ps ( X, zero );
+        __m128 onAxis = _mm_andnot_ps ( _mm_cmpeq_ps ( Y, zero ), _mm_xor_ps ( halfPi, ySign ) );
+        a = _mm_or_ps ( _mm_and_ps ( xNull, onAxis ), _mm_andnot_ps ( xNull, a ) );
+
+        _mm_storeu_ps ( to + i, a );
+    }
+    for ( ; i < length; i++ ) to[i] = ( x[i] == 0 && y[i] == 0 ) ? 0 : atan2 ( y[i], x[i] );
+}
+
+#else // Version non SSE
+
+void atan_ps ( float* to, const float* from, int length ) {
+    for ( int i = 0; i < length; i++ ) to[i] = atan ( from[i] );
+}
+
+void atan2_ps ( float* to, const float* y, const float* x, int length ) {
+    for ( int i = 0; i < length; i++ ) to[i] = ( x[i] == 0 && y[i] == 0 ) ? 0 : atan2 ( y[i], x[i] );
+}
+
+#endif
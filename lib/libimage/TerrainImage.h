@@ -0,0 +1,200 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file TerrainImage.h
+ ** \~french
+ * \brief Définition de la classe TerrainImage, base des calculs sur le voisinage 3x3 d'un MNT
+ ** \~english
+ * \brief Define class TerrainImage, base of computations on a DEM's 3x3 neighbourhood
+ */
+
+#ifndef TERRAINIMAGE_H
+#define TERRAINIMAGE_H
+
+#include "Image.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Image calculée ligne à ligne sur une fenêtre glissante de 3 lignes de l'image d'origine
+ * \details L'image d'origine a une ligne et une colonne de plus de chaque côté : la ligne l de l'image calculée utilise les lignes l, l+1 et l+2 de l'image d'origine. Seules ces 3 lignes sont gardées en mémoire, une ligne est calculée à la demande : la mémoire utilisée ne dépend pas de la hauteur et la première ligne est disponible immédiatement.
+ *
+ * Lire les lignes dans l'ordre ne demande qu'une nouvelle ligne d'origine par ligne calculée. Un accès dans le désordre recharge les 3 lignes.
+ *
+ * Les classes filles (EstompageImage, PenteImage, AspectImage) partagent le calcul vectorisé du gradient de Horn et n'implémentent que le calcul par pixel, dans computeLine.
+ * \~english
+ * \brief Image computed line by line over a 3-lines sliding window of the origin image
+ * \details Origin image has one more line and column on each side : line l of the computed image uses lines l, l+1 and l+2 of the origin image. Only these 3 lines are kept in memory, a line is computed on demand : used memory does not depend on the height and the first line is available immediately.
+ *
+ * Reading lines in order needs only one new origin line for each computed line. A random access reloads the 3 lines.
+ *
+ * Children classes (EstompageImage, PenteImage, AspectImage) share the vectorized Horn gradient computation and implement only the per pixel computation, in computeLine.
+ */
+class TerrainImage : public Image {
+
+private:
+
+    /**
+     * \~french \brief Image d'origine, plus large et plus haute de 2 pixels
+     * \~english \brief Origin image, 2 pixels wider and higher
+     */
+    Image* origImage;
+
+    /**
+     * \~french \brief Stockage des 3 lignes d'origine, des 2 composantes du gradient et de la ligne calculée
+     * \~english \brief Storage of the 3 origin lines, the 2 gradient's components and the computed line
+     */
+    float* memory;
+
+    /**
+     * \~french \brief Indice de la ligne calculée correspondant à la fenêtre, -1 si elle est vide
+     * \~english \brief Computed line's indice matching the window, -1 if it is empty
+     */
+    int windowLine;
+
+    /**
+     * \~french \brief Calcule si besoin la ligne demandée dans #result
+     * \~english \brief Compute if needed the asked line in #result
+     */
+    void compute ( int line );
+
+protected:
+
+    /**
+     * \~french \brief Fenêtre : lignes d'origine du haut, du milieu et du bas
+     * \~english \brief Window : top, middle and bottom origin lines
+     */
+    float* window[3];
+
+    /**
+     * \~french \brief Composante du gradient selon X de la ligne courante
+     * \~english \brief Current line's X wise gradient component
+     */
+    float* dzdx;
+
+    /**
+     * \~french \brief Composante du gradient selon Y de la ligne courante
+     * \~english \brief Current line's Y wise gradient component
+     */
+    float* dzdy;
+
+    /**
+     * \~french \brief Ligne calculée
+     * \~english \brief Computed line
+     */
+    float* result;
+
+    /**
+     * \~french
+     * \brief Gradient de Horn de la ligne courante, dans #dzdx et #dzdy
+     * \details dzdx = ((c + 2f + i) - (a + 2d + g)) / divx et dzdy = ((g + 2h + i) - (a + 2b + c)) / divy, avec le voisinage
+     * \code
+     * a b c
+     * d e f
+     * g h i
+     * \endcode
+     * \~english
+     * \brief Horn gradient of the current line, in #dzdx and #dzdy
+     */
+    void hornGradient ( float divx, float divy );
+
+    /**
+     * \~french
+     * \brief Gradient de Zevenbergen et Thorne de la ligne courante, dans #dzdx et #dzdy
+     * \details dzdx = (f - d) / divx et dzdy = (h - b) / divy
+     * \~english
+     * \brief Zevenbergen and Thorne gradient of the current line, in #dzdx and #dzdy
+     */
+    void zevenbergenGradient ( float divx, float divy );
+
+    /**
+     * \~french \brief Remplace dans #result par value les pixels dont un voisin vaut nodata
+     * \~english \brief Replace in #result with value pixels whose a neighbour is nodata
+     */
+    void applyNoData ( float nodata, float value );
+
+    /**
+     * \~french \brief Calcule la ligne courante dans #result, à partir de #window
+     * \~english \brief Compute the current line in #result, from #window
+     */
+    virtual void computeLine() = 0;
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] width largeur de l'image calculée
+     * \param[in] height hauteur de l'image calculée
+     * \param[in] channels nombre de canaux
+     * \param[in] bbox rectangle englobant de l'image calculée
+     * \param[in] image image d'origine, dont on devient propriétaire
+     * \~english
+     * \brief Constructor
+     * \param[in] width computed image's width
+     * \param[in] height computed image's height
+     * \param[in] channels channels' number
+     * \param[in] bbox computed image's bounding box
+     * \param[in] image origin image, we become owner
+     */
+    TerrainImage ( int width, int height, int channels, BoundingBox<double> bbox, Image* image );
+
+public:
+
+    virtual int getline ( float* buffer, int line );
+    virtual int getline ( uint16_t* buffer, int line );
+    virtual int getline ( uint8_t* buffer, int line );
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    virtual ~TerrainImage();
+};
+
+/**
+ * \~french \brief Arc tangente d'un tableau de flottants (approximation polynomiale en SSE2, erreur relative de l'ordre de 1e-7)
+ * \~english \brief Arc tangent of a floats array (polynomial approximation with SSE2, relative error about 1e-7)
+ */
+void atan_ps ( float* to, const float* from, int length );
+
+/**
+ * \~french \brief Arc tangente de y / x, dans ]-pi, pi], nulle pour x = y = 0
+ * \~english \brief Arc tangent of y / x, in ]-pi, pi], null for x = y = 0
+ */
+void atan2_ps ( float* to, const float* y, const float* x, int length );
+
+#endif // TERRAINIMAGE_H
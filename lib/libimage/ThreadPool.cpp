@@ -0,0 +1,184 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file ThreadPool.cpp
+ ** \~french
+ * \brief Implémentation de la classe ThreadPool
+ ** \~english
+ * \brief Implements class ThreadPool
+ */
+
+#include "ThreadPool.h"
+
+ThreadPool* ThreadPool::sharedPool = NULL;
+pthread_mutex_t ThreadPool::sharedMtx = PTHREAD_MUTEX_INITIALIZER;
+
+ThreadPool::ThreadPool ( int nbThreads ) : stopping ( false ) {
+    if ( nbThreads < 1 ) nbThreads = 1;
+
+    pthread_mutex_init ( &mtx, 0 );
+    pthread_cond_init ( &cond, 0 );
+
+    threads = std::vector<pthread_t> ( nbThreads );
+    for ( int i = 0; i < threads.size(); i++ ) {
+        pthread_create ( & ( threads[i] ), NULL, ThreadPool::threadLoop, ( void* ) this );
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    pthread_mutex_lock ( &mtx );
+    stopping = true;
+    pthread_cond_broadcast ( &cond );
+    pthread_mutex_unlock ( &mtx );
+
+    for ( int i = 0; i < threads.size(); i++ ) {
+        pthread_join ( threads[i], NULL );
+    }
+
+    pthread_cond_destroy ( &cond );
+    pthread_mutex_destroy ( &mtx );
+}
+
+void ThreadPool::runTask ( ThreadTask* task ) {
+    // On mémorise l'ensemble avant l'exécution : une fois la fin signalée, la tâche comme l'ensemble peuvent être détruits
+    ThreadTaskGroup* group = task->group;
+
+    task->run();
+
+    pthread_mutex_lock ( &group->mtx );
+    group->pending--;
+    if ( group->pending == 0 ) {
+        pthread_cond_broadcast ( &group->cond );
+    }
+    pthread_mutex_unlock ( &group->mtx );
+}
+
+void* ThreadPool::threadLoop ( void* arg ) {
+    ThreadPool* pool = ( ThreadPool* ) ( arg );
+
+    while ( true ) {
+        pthread_mutex_lock ( &pool->mtx );
+        while ( pool->queue.empty() && ! pool->stopping ) {
+            pthread_cond_wait ( &pool->cond, &pool->mtx );
+        }
+        if ( pool->queue.empty() ) {
+            // Arrêt demandé et plus rien à faire
+            pthread_mutex_unlock ( &pool->mtx );
+            break;
+        }
+        ThreadTask* task = pool->queue.front();
+        pool->queue.pop_front();
+        pthread_mutex_unlock ( &pool->mtx );
+
+        runTask ( task );
+    }
+
+    Logger::stopLogger();
+    return 0;
+}
+
+void ThreadPool::submit ( ThreadTask* task, ThreadTaskGroup* group ) {
+    task->group = group;
+
+    pthread_mutex_lock ( &group->mtx );
+    group->pending++;
+    pthread_mutex_unlock ( &group->mtx );
+
+    pthread_mutex_lock ( &mtx );
+    queue.push_back ( task );
+    pthread_cond_signal ( &cond );
+    pthread_mutex_unlock ( &mtx );
+}
+
+void ThreadPool::wait ( ThreadTaskGroup* group ) {
+
+    // On exécute nous même les tâches de l'ensemble qui n'ont pas encore été prises par un thread du groupe
+    while ( true ) {
+        ThreadTask* task = NULL;
+
+        pthread_mutex_lock ( &mtx );
+        std::deque<ThreadTask*>::iterator it;
+        for ( it = queue.begin(); it != queue.end(); ++it ) {
+            if ( ( *it )->group == group ) {
+                task = *it;
+                queue.erase ( it );
+                break;
+            }
+        }
+        pthread_mutex_unlock ( &mtx );
+
+        if ( task == NULL ) break;
+        runTask ( task );
+    }
+
+    // Il ne reste que des tâches en cours d'exécution dans d'autres threads
+    pthread_mutex_lock ( &group->mtx );
+    while ( group->pending > 0 ) {
+        pthread_cond_wait ( &group->cond, &group->mtx );
+    }
+    pthread_mutex_unlock ( &group->mtx );
+}
+
+void ThreadPool::initSharedPool ( int nbThreads ) {
+    pthread_mutex_lock ( &sharedMtx );
+    if ( sharedPool == NULL ) {
+        if ( nbThreads > 0 ) {
+            LOGGER_INFO ( "Création du groupe partagé de " << nbThreads << " threads" );
+            sharedPool = new ThreadPool ( nbThreads );
+        }
+    } else if ( sharedPool->getThreadsNumber() != nbThreads ) {
+        LOGGER_WARN ( "Le groupe partagé compte déjà " << sharedPool->getThreadsNumber() << " threads, la nouvelle taille (" << nbThreads << ") sera prise en compte au redémarrage" );
+    }
+    pthread_mutex_unlock ( &sharedMtx );
+}
+
+ThreadPool* ThreadPool::getSharedPool() {
+    pthread_mutex_lock ( &sharedMtx );
+    ThreadPool* p = sharedPool;
+    pthread_mutex_unlock ( &sharedMtx );
+    return p;
+}
+
+void ThreadPool::cleanSharedPool() {
+    pthread_mutex_lock ( &sharedMtx );
+    if ( sharedPool != NULL ) {
+        delete sharedPool;
+        sharedPool = NULL;
+    }
+    pthread_mutex_unlock ( &sharedMtx );
+}
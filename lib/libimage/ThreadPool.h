@@ -0,0 +1,302 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file ThreadPool.h
+ ** \~french
+ * \brief Définition des classes ThreadTask, ThreadTaskGroup et ThreadPool
+ * \details
+ * \li ThreadTask : tâche à exécuter par un processus léger du groupe
+ * \li ThreadTaskGroup : ensemble de tâches dont on attend la fin
+ * \li ThreadPool : groupe de processus légers exécutant des tâches
+ ** \~english
+ * \brief Define classes ThreadTask, ThreadTaskGroup and ThreadPool
+ * \details
+ * \li ThreadTask : task to run by a pool's thread
+ * \li ThreadTaskGroup : set of tasks we wait for
+ * \li ThreadPool : pool of threads running tasks
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+#include <deque>
+#include <vector>
+#include "Logger.h"
+
+class ThreadTaskGroup;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Tâche à exécuter dans un ThreadPool
+ * \details Les classes filles implémentent #run. La tâche n'est pas détruite par le groupe de processus, c'est à l'appelant de le faire une fois l'exécution terminée.
+ * \~english
+ * \brief Task to run in a ThreadPool
+ * \details Children classes implement #run. Task is not destroyed by the pool, caller have to do it once execution is over.
+ */
+class ThreadTask {
+
+    friend class ThreadPool;
+
+private:
+
+    /**
+     * \~french \brief Ensemble auquel appartient la tâche
+     * \~english \brief Set the task belongs to
+     */
+    ThreadTaskGroup* group;
+
+public:
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    ThreadTask() : group ( NULL ) {}
+
+    /**
+     * \~french \brief Traitement de la tâche
+     * \~english \brief Task processing
+     */
+    virtual void run() = 0;
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    virtual ~ThreadTask() {}
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Ensemble de tâches soumises à un ThreadPool, dont on peut attendre la fin
+ * \~english
+ * \brief Set of tasks submitted to a ThreadPool, we can wait for
+ */
+class ThreadTaskGroup {
+
+    friend class ThreadPool;
+
+private:
+
+    /**
+     * \~french \brief Exclusion mutuelle pour le compteur de tâches
+     * \~english \brief Mutex for the tasks' counter
+     */
+    pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Signale la fin de toutes les tâches
+     * \~english \brief Signal the end of all tasks
+     */
+    pthread_cond_t cond;
+
+    /**
+     * \~french \brief Nombre de tâches non terminées
+     * \~english \brief Number of unfinished tasks
+     */
+    int pending;
+
+public:
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    ThreadTaskGroup() : pending ( 0 ) {
+        pthread_mutex_init ( &mtx, 0 );
+        pthread_cond_init ( &cond, 0 );
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \details Toutes les tâches doivent être terminées (cf ThreadPool::wait)
+     * \~english \brief Destructor
+     * \details All tasks have to be over (see ThreadPool::wait)
+     */
+    ~ThreadTaskGroup() {
+        pthread_cond_destroy ( &cond );
+        pthread_mutex_destroy ( &mtx );
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Groupe de processus légers exécutant des tâches
+ * \details Les tâches sont exécutées dans l'ordre de soumission. Lorsqu'un thread attend la fin d'un ensemble de tâches (#wait), il exécute lui-même celles qui n'ont pas encore été prises en charge : une attente ne peut donc pas bloquer, même si tous les threads du groupe sont occupés.
+ *
+ * Un groupe partagé par tout le processus est disponible via #getSharedPool, une fois initialisé par #initSharedPool.
+ * \~english
+ * \brief Pool of threads running tasks
+ * \details Tasks are run in submission order. When a thread waits for a set of tasks (#wait), it runs itself those not yet taken in charge : a wait cannot block, even if all pool's threads are busy.
+ *
+ * A pool shared by the whole process is available with #getSharedPool, once initialized by #initSharedPool.
+ */
+class ThreadPool {
+
+private:
+
+    /**
+     * \~french \brief Processus légers du groupe
+     * \~english \brief Pool's threads
+     */
+    std::vector<pthread_t> threads;
+
+    /**
+     * \~french \brief Tâches en attente d'exécution
+     * \~english \brief Tasks waiting for execution
+     */
+    std::deque<ThreadTask*> queue;
+
+    /**
+     * \~french \brief Exclusion mutuelle pour la file des tâches
+     * \~english \brief Mutex for the tasks' queue
+     */
+    pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Signale l'arrivée d'une tâche ou l'arrêt du groupe
+     * \~english \brief Signal a new task or the pool stop
+     */
+    pthread_cond_t cond;
+
+    /**
+     * \~french \brief Le groupe est-il en cours d'arrêt
+     * \~english \brief Is pool stopping
+     */
+    bool stopping;
+
+    /**
+     * \~french \brief Groupe partagé par tout le processus
+     * \~english \brief Pool shared by the whole process
+     */
+    static ThreadPool* sharedPool;
+
+    /**
+     * \~french \brief Exclusion mutuelle pour l'initialisation du groupe partagé
+     * \~english \brief Mutex for the shared pool initialization
+     */
+    static pthread_mutex_t sharedMtx;
+
+    /**
+     * \~french \brief Boucle exécutée par chaque thread du groupe
+     * \param[in] arg pointeur vers le ThreadPool
+     * \~english \brief Loop run by each pool's thread
+     * \param[in] arg pointer to the ThreadPool
+     */
+    static void* threadLoop ( void* arg );
+
+    /**
+     * \~french \brief Exécute une tâche et signale sa fin à son ensemble
+     * \~english \brief Run a task and signal its end to its set
+     */
+    static void runTask ( ThreadTask* task );
+
+public:
+
+    /**
+     * \~french \brief Crée un groupe de processus légers
+     * \param[in] nbThreads Nombre de threads, au moins 1
+     * \~english \brief Create a pool of threads
+     * \param[in] nbThreads Number of threads, at least 1
+     */
+    ThreadPool ( int nbThreads );
+
+    /**
+     * \~french \brief Soumet une tâche au groupe
+     * \param[in] task Tâche à exécuter
+     * \param[in] group Ensemble auquel ajouter la tâche
+     * \~english \brief Submit a task to the pool
+     * \param[in] task Task to run
+     * \param[in] group Set to add the task to
+     */
+    void submit ( ThreadTask* task, ThreadTaskGroup* group );
+
+    /**
+     * \~french \brief Attend la fin de toutes les tâches d'un ensemble
+     * \details Les tâches de l'ensemble pas encore démarrées sont exécutées par le thread appelant
+     * \~english \brief Wait for all tasks of a set
+     * \details Not yet started tasks of the set are run by the calling thread
+     */
+    void wait ( ThreadTaskGroup* group );
+
+    /**
+     * \~french \brief Retourne le nombre de threads du groupe
+     * \~english \brief Return the number of pool's threads
+     */
+    int getThreadsNumber() {
+        return threads.size();
+    }
+
+    /**
+     * \~french \brief Initialise le groupe partagé par tout le processus
+     * \details Le groupe n'est créé qu'une seule fois : un nouvel appel avec une taille différente est ignoré
+     * \param[in] nbThreads Nombre de threads
+     * \~english \brief Initialize the pool shared by the whole process
+     * \details Pool is created only once : a new call with a different size is ignored
+     * \param[in] nbThreads Number of threads
+     */
+    static void initSharedPool ( int nbThreads );
+
+    /**
+     * \~french \brief Retourne le groupe partagé par tout le processus
+     * \return Le groupe partagé, NULL s'il n'a pas été initialisé
+     * \~english \brief Return the pool shared by the whole process
+     * \return Shared pool, NULL if not initialized
+     */
+    static ThreadPool* getSharedPool();
+
+    /**
+     * \~french \brief Arrête et supprime le groupe partagé
+     * \~english \brief Stop and delete the shared pool
+     */
+    static void cleanSharedPool();
+
+    /**
+     * \~french \brief Destructeur
+     * \details Les tâches restant dans la file sont exécutées avant l'arrêt des threads
+     * \~english \brief Destructor
+     * \details Tasks still in the queue are run before threads stop
+     */
+    ~ThreadPool();
+};
+
+#endif
@@ -42,6 +42,13 @@ public:
     inline unsigned int getLength() {
         return dataSize;
     }
+    // L'en-tête ne dépend que du format de la pyramide : la tuile identifie la réponse
+    inline std::string getTag()                 {
+        return dataSource ? dataSource->getTag() : "";
+    }
+    inline time_t getModification()             {
+        return dataSource ? dataSource->getModification() : 0;
+    }
     virtual const uint8_t* getData ( size_t& size );
     virtual ~TiffHeaderDataSource();
 };
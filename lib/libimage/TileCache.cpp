@@ -0,0 +1,372 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file TileCache.cpp
+ ** \~french
+ * \brief Implémentation de la classe TileCache
+ ** \~english
+ * \brief Implements class TileCache
+ */
+
+#include "TileCache.h"
+#include <sstream>
+
+/********************************************** TileCacheSketch */
+
+// Graines distinguant les 4 lignes du sketch
+static const uint64_t SKETCH_SEEDS[4] = { 0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL };
+
+void TileCacheSketch::resize ( size_t expectedElements ) {
+    // Une largeur minimale limite les collisions lorsque le cache est petit
+    width = 256;
+    while ( width < expectedElements && width < ( 1U << 24 ) ) width <<= 1;
+    counters.assign ( 4 * width, 0 );
+    additions = 0;
+    sampleSize = 10 * width;
+}
+
+uint32_t TileCacheSketch::indexOf ( uint64_t hash, int row ) {
+    uint64_t h = ( hash + SKETCH_SEEDS[row] ) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 32;
+    return row * width + ( h & ( width - 1 ) );
+}
+
+void TileCacheSketch::increment ( uint64_t hash ) {
+    bool added = false;
+    for ( int row = 0; row < 4; row++ ) {
+        uint8_t& c = counters[indexOf ( hash, row )];
+        if ( c < 15 ) {
+            c++;
+            added = true;
+        }
+    }
+
+    if ( added && ++additions >= sampleSize ) {
+        // Vieillissement : les accès anciens pèsent de moins en moins
+        for ( int i = 0; i < counters.size(); i++ ) {
+            counters[i] >>= 1;
+        }
+        additions /= 2;
+    }
+}
+
+int TileCacheSketch::estimate ( uint64_t hash ) {
+    int freq = 15;
+    for ( int row = 0; row < 4; row++ ) {
+        int c = counters[indexOf ( hash, row )];
+        if ( c < freq ) freq = c;
+    }
+    return freq;
+}
+
+/********************************************** TileCacheShard */
+
+void TileCacheShard::removeElement ( std::list<TileCacheElement*>::iterator it ) {
+    TileCacheElement* tce = *it;
+    usedMemory -= tce->getMemorySize();
+    book.erase ( tce->key );
+    mru.erase ( it );
+    delete tce;
+}
+
+void TileCacheShard::clear () {
+    std::list<TileCacheElement*>::iterator it;
+    for ( it = mru.begin(); it != mru.end(); ++it ) {
+        delete *it;
+    }
+    mru.clear();
+    book.clear();
+    usedMemory = 0;
+}
+
+/********************************************** TileCache */
+
+TileCacheShard TileCache::shards[TILE_CACHE_SHARDS];
+size_t TileCache::maxMemory = 0;
+int TileCache::validity = 0;
+bool TileCache::admission = true;
+
+uint64_t TileCache::hashKey ( std::string key ) {
+    // FNV-1a 64 bits
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for ( int i = 0; i < key.size(); i++ ) {
+        h ^= ( uint8_t ) key[i];
+        h *= 0x100000001b3ULL;
+    }
+    // Mélange final, les bits de poids faible choisissant la partition
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+std::string TileCache::getKey ( Context* c, std::string level, int col, int row ) {
+    std::ostringstream oss;
+    oss << c->getTypeStr() << ":" << c->getTray() << ":" << level << ":" << col << ":" << row;
+    return oss.str();
+}
+
+void TileCache::setCacheSize ( size_t bytes ) {
+    maxMemory = bytes;
+    for ( int i = 0; i < TILE_CACHE_SHARDS; i++ ) {
+        TileCacheShard* shard = &( shards[i] );
+        pthread_mutex_lock ( &shard->mtx );
+        shard->maxMemory = bytes / TILE_CACHE_SHARDS;
+        shard->sketch.resize ( shard->maxMemory / TILE_CACHE_AVERAGE_TILE_SIZE );
+        while ( shard->usedMemory > shard->maxMemory && ! shard->mru.empty() ) {
+            shard->removeElement ( --shard->mru.end() );
+            shard->evictions++;
+        }
+        pthread_mutex_unlock ( &shard->mtx );
+    }
+}
+
+void TileCache::setValidity ( int seconds ) {
+    if ( seconds < 0 ) seconds = 0;
+    validity = seconds;
+}
+
+void TileCache::setAdmission ( bool enabled ) {
+    admission = enabled;
+}
+
+bool TileCache::isEnabled () {
+    return ( maxMemory != 0 );
+}
+
+DataSource* TileCache::getTile ( std::string key, std::string type, std::string encoding, std::string version ) {
+
+    uint64_t hash = hashKey ( key );
+    TileCacheShard* shard = getShard ( hash );
+
+    pthread_mutex_lock ( &shard->mtx );
+
+    shard->sketch.increment ( hash );
+
+    std::map<std::string, std::list<TileCacheElement*>::iterator>::iterator it = shard->book.find ( key );
+    if ( it == shard->book.end() ) {
+        shard->misses++;
+        pthread_mutex_unlock ( &shard->mtx );
+        return NULL;
+    }
+
+    TileCacheElement* tce = * ( it->second );
+
+    if ( tce->version != version || isOutOfDate ( tce, time ( NULL ) ) ) {
+        // La dalle a été réécrite depuis la lecture de la tuile, ou la tuile est périmée : on la supprime
+        shard->removeElement ( it->second );
+        shard->evictions++;
+        shard->misses++;
+        pthread_mutex_unlock ( &shard->mtx );
+        return NULL;
+    }
+
+    // L'élément devient le plus récemment utilisé
+    shard->mru.splice ( shard->mru.begin(), shard->mru, it->second );
+    shard->hits++;
+
+    // Pas de copie : la source partage le tampon de l'élément, qui reste valide même si l'élément est évincé
+    DataSource* ds = new PooledDataSource ( tce->buffer, tce->size, type, encoding, tce->tag, tce->modification );
+
+    pthread_mutex_unlock ( &shard->mtx );
+    return ds;
+}
+
+bool TileCache::addTile ( std::string key, const uint8_t* data, size_t size ) {
+
+    if ( ! isEnabled() || data == NULL || size == 0 ) return false;
+
+    PooledBuffer* buffer = BufferPool::acquire ( size );
+    memcpy ( buffer->getData(), data, size );
+    bool added = addTile ( key, buffer, size );
+    buffer->release();
+    return added;
+}
+
+bool TileCache::addTile ( std::string key, PooledBuffer* buffer, size_t size, std::string tag, time_t modification, std::string version ) {
+
+    if ( ! isEnabled() || buffer == NULL || size == 0 ) return false;
+
+    uint64_t hash = hashKey ( key );
+    TileCacheShard* shard = getShard ( hash );
+
+    TileCacheElement* tce = new TileCacheElement ( key, hash, buffer, size, tag, modification, version );
+    size_t needed = tce->getMemorySize();
+
+    pthread_mutex_lock ( &shard->mtx );
+
+    if ( needed > shard->maxMemory ) {
+        shard->rejections++;
+        pthread_mutex_unlock ( &shard->mtx );
+        delete tce;
+        return false;
+    }
+
+    std::map<std::string, std::list<TileCacheElement*>::iterator>::iterator it = shard->book.find ( key );
+    if ( it != shard->book.end() ) {
+        // Un autre thread a pu ajouter cette tuile entre temps : on remplace par la plus récente
+        shard->removeElement ( it->second );
+    }
+
+    time_t now = time ( NULL );
+    int candidateFrequency = shard->sketch.estimate ( hash );
+
+    while ( shard->usedMemory + needed > shard->maxMemory && ! shard->mru.empty() ) {
+        TileCacheElement* victim = shard->mru.back();
+        if ( admission && ! isOutOfDate ( victim, now ) && candidateFrequency <= shard->sketch.estimate ( victim->hash ) ) {
+            // La tuile candidate n'est pas plus populaire que celle qu'elle remplacerait : on la refuse
+            shard->rejections++;
+            pthread_mutex_unlock ( &shard->mtx );
+            delete tce;
+            return false;
+        }
+        shard->removeElement ( --shard->mru.end() );
+        shard->evictions++;
+    }
+
+    shard->mru.push_front ( tce );
+    shard->book.insert ( std::pair<std::string, std::list<TileCacheElement*>::iterator> ( key, shard->mru.begin() ) );
+    shard->usedMemory += needed;
+
+    pthread_mutex_unlock ( &shard->mtx );
+    return true;
+}
+
+void TileCache::invalidate ( std::string key ) {
+    TileCacheShard* shard = getShard ( hashKey ( key ) );
+    pthread_mutex_lock ( &shard->mtx );
+    std::map<std::string, std::list<TileCacheElement*>::iterator>::iterator it = shard->book.find ( key );
+    if ( it != shard->book.end() ) {
+        shard->removeElement ( it->second );
+    }
+    pthread_mutex_unlock ( &shard->mtx );
+}
+
+uint64_t TileCache::getHits () {
+    uint64_t h = 0;
+    for ( int i = 0; i < TILE_CACHE_SHARDS; i++ ) {
+        pthread_mutex_lock ( &shards[i].mtx );
+        h += shards[i].hits;
+        pthread_mutex_unlock ( &shards[i].mtx );
+    }
+    return h;
+}
+
+uint64_t TileCache::getMisses () {
+    uint64_t m = 0;
+    for ( int i = 0; i < TILE_CACHE_SHARDS; i++ ) {
+        pthread_mutex_lock ( &shards[i].mtx );
+        m += shards[i].misses;
+        pthread_mutex_unlock ( &shards[i].mtx );
+    }
+    return m;
+}
+
+uint64_t TileCache::getEvictions () {
+    uint64_t e = 0;
+    for ( int i = 0; i < TILE_CACHE_SHARDS; i++ ) {
+        pthread_mutex_lock ( &shards[i].mtx );
+        e += shards[i].evictions;
+        pthread_mutex_unlock ( &shards[i].mtx );
+    }
+    return e;
+}
+
+uint64_t TileCache::getRejections () {
+    uint64_t r = 0;
+    for ( int i = 0; i < TILE_CACHE_SHARDS; i++ ) {
+        pthread_mutex_lock ( &shards[i].mtx );
+        r += shards[i].rejections;
+        pthread_mutex_unlock ( &shards[i].mtx );
+    }
+    return r;
+}
+
+int TileCache::getTilesNumber () {
+    int n = 0;
+    for ( int i = 0; i < TILE_CACHE_SHARDS; i++ ) {
+        pthread_mutex_lock ( &shards[i].mtx );
+        n += shards[i].mru.size();
+        pthread_mutex_unlock ( &shards[i].mtx );
+    }
+    return n;
+}
+
+size_t TileCache::getUsedMemory () {
+    size_t u = 0;
+    for ( int i = 0; i < TILE_CACHE_SHARDS; i++ ) {
+        pthread_mutex_lock ( &shards[i].mtx );
+        u += shards[i].usedMemory;
+        pthread_mutex_unlock ( &shards[i].mtx );
+    }
+    return u;
+}
+
+void TileCache::printStats () {
+    int n = 0;
+    size_t u = 0;
+    uint64_t h = 0, m = 0, e = 0, r = 0;
+    for ( int i = 0; i < TILE_CACHE_SHARDS; i++ ) {
+        pthread_mutex_lock ( &shards[i].mtx );
+        n += shards[i].mru.size();
+        u += shards[i].usedMemory;
+        h += shards[i].hits;
+        m += shards[i].misses;
+        e += shards[i].evictions;
+        r += shards[i].rejections;
+        pthread_mutex_unlock ( &shards[i].mtx );
+    }
+    LOGGER_INFO ( "Cache des tuiles : " << n << " tuiles, " << u << " / " << maxMemory << " octets" );
+    LOGGER_INFO ( "\t- succès = " << h << ", échecs = " << m << ", évictions = " << e << ", refus = " << r );
+}
+
+void TileCache::cleanCache () {
+    for ( int i = 0; i < TILE_CACHE_SHARDS; i++ ) {
+        TileCacheShard* shard = &( shards[i] );
+        pthread_mutex_lock ( &shard->mtx );
+        shard->clear();
+        shard->sketch.resize ( shard->maxMemory / TILE_CACHE_AVERAGE_TILE_SIZE );
+        shard->hits = 0;
+        shard->misses = 0;
+        shard->evictions = 0;
+        shard->rejections = 0;
+        pthread_mutex_unlock ( &shard->mtx );
+    }
+}
@@ -0,0 +1,603 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file TileCache.h
+ ** \~french
+ * \brief Définition de la classe TileCache
+ ** \~english
+ * \brief Define class TileCache
+ */
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <stdint.h>// pour uint8_t
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "Logger.h"
+#include "Context.h"
+#include "Data.h"
+#include "BufferPool.h"
+
+/**
+ * \~french \brief Nombre de partitions du cache des tuiles, chacune protégée par son propre verrou
+ * \~english \brief Number of tiles cache's shards, each one protected by its own lock
+ */
+#define TILE_CACHE_SHARDS 16
+
+/**
+ * \~french \brief Taille moyenne estimée d'une tuile encodée, pour dimensionner l'estimateur de fréquences
+ * \~english \brief Estimated average encoded tile's size, to size the frequency estimator
+ */
+#define TILE_CACHE_AVERAGE_TILE_SIZE 16384
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Tuile encodée mémorisée dans le cache
+ * \~english
+ * \brief Encoded tile stored in the cache
+ */
+class TileCacheElement {
+
+public:
+
+    /**
+     * \~french \brief Clé de l'élément dans le cache
+     * \~english \brief Element's key in the cache
+     */
+    std::string key;
+
+    /**
+     * \~french \brief Empreinte de la clé
+     * \~english \brief Key's hash
+     */
+    uint64_t hash;
+
+    /**
+     * \~french \brief Tampon partagé contenant les données encodées de la tuile, dont l'élément détient une référence
+     * \~english \brief Shared buffer containing tile's encoded data, whose the element holds a reference
+     */
+    PooledBuffer* buffer;
+
+    /**
+     * \~french \brief Taille des données
+     * \~english \brief Data size
+     */
+    size_t size;
+
+    /**
+     * \~french \brief Identifiant et date de modification de la tuile (DataSource::getTag, DataSource::getModification)
+     * \~english \brief Tile's identifier and modification date (DataSource::getTag, DataSource::getModification)
+     */
+    std::string tag;
+    time_t modification;
+
+    /**
+     * \~french \brief Version de la dalle lorsque la tuile a été lue (Context::getVersion)
+     * \~english \brief Slab's version when tile was read (Context::getVersion)
+     */
+    std::string version;
+
+    /**
+     * \~french \brief Date d'ajout dans le cache
+     * \~english \brief Date of insertion in the cache
+     */
+    time_t date;
+
+    /**
+     * \~french \brief Constructeur
+     * \details Les données ne sont pas copiées, une référence au tampon est ajoutée
+     * \param[in] k Clé de l'élément
+     * \param[in] h Empreinte de la clé
+     * \param[in] b Tampon contenant les données de la tuile
+     * \param[in] s Taille des données
+     * \param[in] t Identifiant de la tuile
+     * \param[in] m Date de modification de la tuile
+     * \param[in] v Version de la dalle
+     * \~english \brief Constructor
+     * \details Data are not copied, a reference to the buffer is added
+     * \param[in] k Element's key
+     * \param[in] h Key's hash
+     * \param[in] b Buffer containing tile's data
+     * \param[in] s Data size
+     * \param[in] t Tile's identifier
+     * \param[in] m Tile's modification date
+     * \param[in] v Slab's version
+     */
+    TileCacheElement ( std::string k, uint64_t h, PooledBuffer* b, size_t s, std::string t, time_t m, std::string v ) :
+        key ( k ), hash ( h ), buffer ( b ), size ( s ), tag ( t ), modification ( m ), version ( v ) {
+        buffer->retain();
+        date = time ( NULL );
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \details La référence au tampon est supprimée
+     * \~english \brief Destructor
+     * \details Reference to the buffer is removed
+     */
+    ~TileCacheElement() {
+        buffer->release();
+    }
+
+    /**
+     * \~french \brief Estimation de l'occupation mémoire de l'élément, en octets
+     * \~english \brief Estimated memory used by the element, in bytes
+     */
+    size_t getMemorySize() {
+        return sizeof ( TileCacheElement ) + key.size() + tag.size() + version.size() + buffer->getCapacity();
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Estimateur compact des fréquences d'accès aux tuiles
+ * \details Sketch Count-Min à 4 lignes de compteurs saturant à 15. Tous les compteurs sont divisés par deux après un nombre d'incréments proportionnel à la taille du sketch, afin que les fréquences reflètent les accès récents.
+ * \~english
+ * \brief Compact estimator of tiles' access frequencies
+ * \details 4 rows Count-Min sketch, with counters saturating at 15. All counters are halved after a number of increments proportional to the sketch's size, so that frequencies reflect recent accesses.
+ */
+class TileCacheSketch {
+
+private:
+
+    /**
+     * \~french \brief Compteurs, ligne après ligne
+     * \~english \brief Counters, row after row
+     */
+    std::vector<uint8_t> counters;
+
+    /**
+     * \~french \brief Nombre de compteurs par ligne (puissance de 2)
+     * \~english \brief Counters number per row (power of 2)
+     */
+    uint32_t width;
+
+    /**
+     * \~french \brief Nombre d'incréments depuis la dernière division
+     * \~english \brief Increments number since the last halving
+     */
+    uint32_t additions;
+
+    /**
+     * \~french \brief Nombre d'incréments déclenchant la division des compteurs
+     * \~english \brief Increments number triggering counters halving
+     */
+    uint32_t sampleSize;
+
+    /**
+     * \~french \brief Indice du compteur d'une empreinte dans une ligne
+     * \~english \brief Counter's indice of a hash in a row
+     */
+    uint32_t indexOf ( uint64_t hash, int row );
+
+public:
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    TileCacheSketch() {
+        resize ( 0 );
+    }
+
+    /**
+     * \~french \brief Dimensionne et remet à zéro le sketch
+     * \param[in] expectedElements Nombre d'éléments attendus dans le cache
+     * \~english \brief Size and reset the sketch
+     * \param[in] expectedElements Expected elements number in the cache
+     */
+    void resize ( size_t expectedElements );
+
+    /**
+     * \~french \brief Enregistre un accès
+     * \~english \brief Record an access
+     */
+    void increment ( uint64_t hash );
+
+    /**
+     * \~french \brief Estime la fréquence d'accès récente
+     * \~english \brief Estimate the recent access frequency
+     */
+    int estimate ( uint64_t hash );
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Partition du cache des tuiles
+ * \details Chaque partition a son propre verrou, sa propre liste LRU et son propre budget mémoire : des threads accédant à des tuiles de partitions différentes ne se bloquent pas.
+ * \~english
+ * \brief Tiles cache's shard
+ * \details Each shard has its own lock, its own LRU list and its own memory budget : threads accessing tiles of different shards don't block each other.
+ */
+class TileCacheShard {
+
+public:
+
+    /**
+     * \~french \brief Exclusion mutuelle pour l'accès à la partition
+     * \~english \brief Mutex for the shard access
+     */
+    pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Liste des éléments, du plus récemment utilisé au plus ancien
+     * \~english \brief Elements list, from the most recently used to the oldest
+     */
+    std::list<TileCacheElement*> mru;
+
+    /**
+     * \~french \brief Annuaire des éléments, pour un accès par clé
+     * \~english \brief Elements book, for an access by key
+     */
+    std::map<std::string, std::list<TileCacheElement*>::iterator> book;
+
+    /**
+     * \~french \brief Fréquences d'accès, pour la politique d'admission
+     * \~english \brief Access frequencies, for admission policy
+     */
+    TileCacheSketch sketch;
+
+    /**
+     * \~french \brief Occupation mémoire maximale de la partition, en octets
+     * \~english \brief Max memory used by the shard, in bytes
+     */
+    size_t maxMemory;
+
+    /**
+     * \~french \brief Occupation mémoire courante de la partition, en octets
+     * \~english \brief Current memory used by the shard, in bytes
+     */
+    size_t usedMemory;
+
+    /**
+     * \~french \brief Nombre de recherches fructueuses
+     * \~english \brief Number of successful lookups
+     */
+    uint64_t hits;
+
+    /**
+     * \~french \brief Nombre de recherches infructueuses
+     * \~english \brief Number of unsuccessful lookups
+     */
+    uint64_t misses;
+
+    /**
+     * \~french \brief Nombre d'éléments supprimés pour libérer de la mémoire ou car périmés
+     * \~english \brief Number of elements removed to free memory or because out of date
+     */
+    uint64_t evictions;
+
+    /**
+     * \~french \brief Nombre de tuiles refusées par la politique d'admission
+     * \~english \brief Number of tiles refused by the admission policy
+     */
+    uint64_t rejections;
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    TileCacheShard() : maxMemory ( 0 ), usedMemory ( 0 ), hits ( 0 ), misses ( 0 ), evictions ( 0 ), rejections ( 0 ) {
+        pthread_mutex_init ( &mtx, NULL );
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~TileCacheShard() {
+        clear();
+        pthread_mutex_destroy ( &mtx );
+    }
+
+    /**
+     * \~french \brief Supprime un élément de la partition
+     * \details L'appelant doit avoir verrouillé #mtx
+     * \~english \brief Remove an element from the shard
+     * \details Caller have to lock #mtx
+     */
+    void removeElement ( std::list<TileCacheElement*>::iterator it );
+
+    /**
+     * \~french \brief Supprime tous les éléments de la partition
+     * \details L'appelant doit avoir verrouillé #mtx
+     * \~english \brief Remove all shard's elements
+     * \details Caller have to lock #mtx
+     */
+    void clear();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Cache des tuiles encodées, partagé par tous les threads
+ * \details Cette classe est prévue pour être utilisée sans instance, à la manière de IndexCache.
+ *
+ * Les tuiles les plus demandées sont gardées en mémoire, telles que lues dans les dalles, afin de ne plus solliciter le stockage. Le cache est réparti en #TILE_CACHE_SHARDS partitions selon l'empreinte de la clé, chacune avec son verrou et son budget mémoire.
+ *
+ * Dans une partition pleine, une nouvelle tuile n'est admise que si elle a été demandée plus souvent récemment que la tuile la moins récemment utilisée qu'elle remplacerait (politique TinyLFU). Cela évite qu'un parcours ponctuel de nombreuses tuiles ne vide le cache des tuiles populaires. Chaque tuile a une durée de validité, afin de prendre en compte les dalles réécrites. Une taille nulle désactive le cache.
+ *
+ * Seules les couches l'ayant demandé (Layer) passent par ce cache.
+ * \~english
+ * \brief Encoded tiles cache, shared by all threads
+ * \details This class is intended to be used without instance, like IndexCache.
+ *
+ * Most requested tiles are kept in memory, as read in slabs, so that storage is no more requested. Cache is split in #TILE_CACHE_SHARDS shards according to the key's hash, each one with its lock and its memory budget.
+ *
+ * In a full shard, a new tile is admitted only if it has been recently requested more often than the least recently used tile it would replace (TinyLFU policy). It avoids that a punctual browsing of many tiles empties the cache of popular tiles. Each tile has a validity period, to take into account rewritten slabs. A null size disables the cache.
+ *
+ * Only layers asking for it (Layer) use this cache.
+ */
+class TileCache {
+
+private:
+
+    /**
+     * \~french \brief Partitions du cache
+     * \~english \brief Cache's shards
+     */
+    static TileCacheShard shards[TILE_CACHE_SHARDS];
+
+    /**
+     * \~french \brief Occupation mémoire maximale du cache, en octets
+     * \~english \brief Max memory used by the cache, in bytes
+     */
+    static size_t maxMemory;
+
+    /**
+     * \~french \brief Durée de validité d'un élément, en secondes
+     * \~english \brief Element's validity period, in seconds
+     */
+    static int validity;
+
+    /**
+     * \~french \brief Active la politique d'admission
+     * \details Sinon, une nouvelle tuile remplace toujours la moins récemment utilisée (LRU pure)
+     * \~english \brief Enable admission policy
+     * \details Otherwise, a new tile always replaces the least recently used one (pure LRU)
+     */
+    static bool admission;
+
+    /**
+     * \~french \brief Calcule l'empreinte d'une clé
+     * \~english \brief Compute a key's hash
+     */
+    static uint64_t hashKey ( std::string key );
+
+    /**
+     * \~french \brief Partition contenant une empreinte
+     * \~english \brief Shard containing a hash
+     */
+    static TileCacheShard* getShard ( uint64_t hash ) {
+        return &( shards[hash % TILE_CACHE_SHARDS] );
+    }
+
+    /**
+     * \~french \brief Précise si un élément est périmé
+     * \~english \brief Precise if an element is out of date
+     */
+    static bool isOutOfDate ( TileCacheElement* tce, time_t now ) {
+        return ( validity != 0 && now - tce->date > validity );
+    }
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \~english
+     * \brief Constructeur
+     */
+    TileCache(){};
+
+public:
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \~english
+     * \brief Destructor
+     */
+    ~TileCache(){};
+
+    /**
+     * \~french \brief Calcule la clé d'une tuile dans le cache
+     * \param[in] c Contexte de stockage de la pyramide
+     * \param[in] level Racine du niveau de la pyramide, identifiant pyramide et niveau
+     * \param[in] col Colonne de la tuile
+     * \param[in] row Ligne de la tuile
+     * \~english \brief Compute the tile's key in the cache
+     * \param[in] c Pyramid's storage context
+     * \param[in] level Pyramid's level root, identifying pyramid and level
+     * \param[in] col Tile's column
+     * \param[in] row Tile's row
+     */
+    static std::string getKey ( Context* c, std::string level, int col, int row );
+
+    /**
+     * \~french \brief Définit l'occupation mémoire maximale du cache
+     * \details Le budget est réparti équitablement entre les partitions. Les éléments en trop sont supprimés. Une taille nulle vide et désactive le cache.
+     * \param[in] bytes Taille maximale, en octets
+     * \~english \brief Define max memory used by the cache
+     * \details Budget is fairly split between shards. Elements in excess are removed. A null size empties and disables the cache.
+     * \param[in] bytes Max size, in bytes
+     */
+    static void setCacheSize ( size_t bytes );
+
+    /**
+     * \~french \brief Définit la durée de validité des éléments
+     * \param[in] seconds Durée en secondes, 0 pour une validité illimitée
+     * \~english \brief Define elements' validity period
+     * \param[in] seconds Period in seconds, 0 for unlimited validity
+     */
+    static void setValidity ( int seconds );
+
+    /**
+     * \~french \brief Active ou désactive la politique d'admission
+     * \~english \brief Enable or disable admission policy
+     */
+    static void setAdmission ( bool enabled );
+
+    /**
+     * \~french \brief Précise si le cache est actif
+     * \~english \brief Precise if cache is enabled
+     */
+    static bool isEnabled ();
+
+    /**
+     * \~french \brief Récupère une tuile depuis le cache
+     * \details L'accès est comptabilisé pour la politique d'admission, que la tuile soit présente ou non.
+     * \param[in] key Clé de la tuile, obtenue avec #getKey
+     * \param[in] type Mime-type de la tuile
+     * \param[in] encoding Encodage de la tuile
+     * \param[in] version Version courante de la dalle (Context::getVersion) : une tuile lue sur une autre version est supprimée
+     * \return Une source partageant le tampon de la tuile (PooledDataSource), NULL si elle est absente ou périmée
+     * \~english \brief Get a tile from the cache
+     * \details Access is recorded for admission policy, whether the tile is present or not.
+     * \param[in] key Tile's key, from #getKey
+     * \param[in] type Tile's mime-type
+     * \param[in] encoding Tile's encoding
+     * \param[in] version Slab's current version (Context::getVersion) : a tile read on another version is removed
+     * \return A source sharing tile's buffer (PooledDataSource), NULL if missing or out of date
+     */
+    static DataSource* getTile ( std::string key, std::string type, std::string encoding, std::string version = "" );
+
+    /**
+     * \~french \brief Propose une tuile au cache
+     * \details La tuile peut être refusée par la politique d'admission. Si elle est déjà présente, elle est remplacée.
+     * \param[in] key Clé de la tuile, obtenue avec #getKey
+     * \param[in] data Données encodées de la tuile, copiées
+     * \param[in] size Taille des données
+     * \return Vrai si la tuile a été ajoutée
+     * \~english \brief Offer a tile to the cache
+     * \details Tile can be refused by the admission policy. If already present, it is replaced.
+     * \param[in] key Tile's key, from #getKey
+     * \param[in] data Tile's encoded data, copied
+     * \param[in] size Data size
+     * \return True if tile has been added
+     */
+    static bool addTile ( std::string key, const uint8_t* data, size_t size );
+
+    /**
+     * \~french \brief Propose une tuile au cache, sans copie
+     * \details Le tampon est partagé avec le cache, qui en détient une référence : son contenu ne doit plus être modifié.
+     * \param[in] key Clé de la tuile, obtenue avec #getKey
+     * \param[in] buffer Tampon contenant les données encodées de la tuile
+     * \param[in] size Taille des données
+     * \param[in] tag Identifiant de la tuile, rendu avec elle
+     * \param[in] modification Date de modification de la tuile, rendue avec elle
+     * \param[in] version Version de la dalle avant la lecture de la tuile (Context::getVersion)
+     * \return Vrai si la tuile a été ajoutée
+     * \~english \brief Offer a tile to the cache, without copy
+     * \details Buffer is shared with the cache, which holds a reference : its content must not be modified anymore.
+     * \param[in] key Tile's key, from #getKey
+     * \param[in] buffer Buffer containing tile's encoded data
+     * \param[in] size Data size
+     * \param[in] tag Tile's identifier, returned with it
+     * \param[in] modification Tile's modification date, returned with it
+     * \param[in] version Slab's version before tile reading (Context::getVersion)
+     * \return True if tile has been added
+     */
+    static bool addTile ( std::string key, PooledBuffer* buffer, size_t size, std::string tag = "", time_t modification = 0, std::string version = "" );
+
+    /**
+     * \~french \brief Supprime une tuile du cache
+     * \param[in] key Clé de la tuile, obtenue avec #getKey
+     * \~english \brief Remove a tile from the cache
+     * \param[in] key Tile's key, from #getKey
+     */
+    static void invalidate ( std::string key );
+
+    /**
+     * \~french \brief Retourne le nombre de recherches fructueuses
+     * \~english \brief Return the number of successful lookups
+     */
+    static uint64_t getHits ();
+
+    /**
+     * \~french \brief Retourne le nombre de recherches infructueuses
+     * \~english \brief Return the number of unsuccessful lookups
+     */
+    static uint64_t getMisses ();
+
+    /**
+     * \~french \brief Retourne le nombre d'éléments supprimés pour libérer de la mémoire ou car périmés
+     * \~english \brief Return the number of elements removed to free memory or because out of date
+     */
+    static uint64_t getEvictions ();
+
+    /**
+     * \~french \brief Retourne le nombre de tuiles refusées par la politique d'admission
+     * \~english \brief Return the number of tiles refused by the admission policy
+     */
+    static uint64_t getRejections ();
+
+    /**
+     * \~french \brief Retourne le nombre de tuiles dans le cache
+     * \~english \brief Return the number of tiles in the cache
+     */
+    static int getTilesNumber ();
+
+    /**
+     * \~french \brief Retourne l'occupation mémoire courante du cache, en octets
+     * \~english \brief Return the current memory used by the cache, in bytes
+     */
+    static size_t getUsedMemory ();
+
+    /**
+     * \~french \brief Affiche les statistiques du cache
+     * \~english \brief Print cache's statistics
+     */
+    static void printStats ();
+
+    /**
+     * \~french \brief Vide le cache et remet les statistiques à zéro
+     * \~english \brief Empty the cache and reset statistics
+     */
+    static void cleanCache ();
+
+};
+
+#endif
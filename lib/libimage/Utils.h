@@ -39,7 +39,7 @@
  * \file Utils.h
  ** \~french
  * \brief Définition de fonctions de conversion et calculs sur des tableaux. Chaque fonctions est définie avec et sans instructions SSE2.
- * \details
+ * \details Quand les instructions SSE2 sont disponibles, les fonctions principales passent la main à leur version AVX2 ou AVX-512 si le processeur le permet (voir Simd).
  * \li Conversions disponibles
  * \image html conversions.png
  */
@@ -53,6 +53,7 @@
 
 #ifdef __SSE2__
 #include <emmintrin.h>
+#include "Simd.h"
 #endif
 
 
@@ -77,6 +78,8 @@ inline void convert ( T* to, const T* from, size_t length ) {
  */
 #ifdef __SSE2__
 inline void convert ( float* to, const uint8_t* from, int length ) {
+    if ( Simd::getLevel() == Simd::AVX512 ) return avx512_convert ( to, from, length );
+    if ( Simd::getLevel() == Simd::AVX2 ) return avx2_convert ( to, from, length );
     while ( ( intptr_t ) to & 0x0f && length ) {
         --length;
         *to++ = ( float ) *from++;
@@ -142,6 +145,8 @@ inline void convert ( float* to, const uint8_t* from, int length ) {
  */
 #ifdef __SSE2__
 inline void convert ( float* to, const uint16_t* from, int length ) {
+    if ( Simd::getLevel() == Simd::AVX512 ) return avx512_convert ( to, from, length );
+    if ( Simd::getLevel() == Simd::AVX2 ) return avx2_convert ( to, from, length );
     for ( int i = 0; i < length; ++i ) to[i] = ( float ) from[i];
 }
 #else // Version non SSE 
@@ -158,6 +163,7 @@ inline void convert ( float* to, const uint16_t* from, int length ) {
  */
 #ifdef __SSE2__
 inline void convert ( uint16_t* to, const uint8_t* from, int length ) {
+    if ( Simd::getLevel() >= Simd::AVX2 ) return avx2_convert ( to, from, length );
     for ( int i = 0; i < length; ++i ) to[i] = ( uint16_t ) from[i];
 }
 #else // Version non SSE 
@@ -181,6 +187,8 @@ inline void convert ( uint16_t* to, const uint8_t* from, int length ) {
 #ifdef __SSE2__
 
 inline void convert ( uint8_t* to, const float* from, int length ) {
+    if ( Simd::getLevel() == Simd::AVX512 ) return avx512_convert ( to, from, length );
+    if ( Simd::getLevel() == Simd::AVX2 ) return avx2_convert ( to, from, length );
     for ( int i = 0; i < length; i++ ) {
         int t = ( int ) ( from[i] + 0.5 );
         if ( t < 0 ) to[i] = 0;
@@ -260,6 +268,8 @@ inline void convert ( uint8_t* to, const float* from, int length ) {
 #ifdef __SSE2__
 
 inline void convert ( uint16_t* to, const float* from, int length ) {
+    if ( Simd::getLevel() == Simd::AVX512 ) return avx512_convert ( to, from, length );
+    if ( Simd::getLevel() == Simd::AVX2 ) return avx2_convert ( to, from, length );
     for ( int i = 0; i < length; i++ ) {
         int t = ( int ) ( from[i] + 0.5 );
         if ( t < 0 ) to[i] = 0;
@@ -293,6 +303,8 @@ inline void convert ( uint16_t* to, const float* from, int length ) {
 
 // Sans masque
 inline void mult ( float* to, const float* from, const float w, int length ) {
+    if ( Simd::getLevel() == Simd::AVX512 ) return avx512_mult ( to, from, w, length );
+    if ( Simd::getLevel() == Simd::AVX2 ) return avx2_mult ( to, from, w, length );
     while ( ( intptr_t ) to & 0x0f && length ) {
         --length;    // On aligne to sur 128bits
         *to++ = w * *from++;
@@ -364,6 +376,8 @@ inline void mult ( float* outImg,float* weightSum, const float* inImg, const flo
 
 // Sans masque
 inline void add_mult ( float* to, const float* from, const float w, int length ) {
+    if ( Simd::getLevel() == Simd::AVX512 ) return avx512_add_mult ( to, from, w, length );
+    if ( Simd::getLevel() == Simd::AVX2 ) return avx2_add_mult ( to, from, w, length );
     while ( ( intptr_t ) to & 0x0f && length ) {
         --length;    // On aligne to sur 128bits
         *to++ += w * *from++;
@@ -465,6 +479,8 @@ inline void multiplex_unaligned ( float* T, const float* F1, const float* F2, co
 
 #ifdef __SSE2__
 inline void multiplex ( float* T, const float* F1, const float* F2, const float* F3, const float* F4, int length ) {
+    if ( Simd::getLevel() == Simd::AVX512 ) return avx512_multiplex ( T, F1, F2, F3, F4, length );
+    if ( Simd::getLevel() == Simd::AVX2 ) return avx2_multiplex ( T, F1, F2, F3, F4, length );
     while ( length & 0x03 ) { // On s'arrange pour avoir un multiple de 4 d'éléments à traiter.
         --length;
         T[4*length] = F1[length];
@@ -511,6 +527,8 @@ inline void multiplex ( float* T, const float* F1, const float* F2, const float*
 
 #ifdef __SSE2__
 inline void demultiplex ( float* T1, float* T2, float* T3, float* T4, const float* F, int length ) {
+    if ( Simd::getLevel() == Simd::AVX512 ) return avx512_demultiplex ( T1, T2, T3, T4, F, length );
+    if ( Simd::getLevel() == Simd::AVX2 ) return avx2_demultiplex ( T1, T2, T3, T4, F, length );
 
     while ( length & 0x03 ) { // On s'arrange pour avoir un multiple de 4 d'éléments à traiter.
         --length;
@@ -0,0 +1,179 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <pthread.h>
+#include <vector>
+#include "BufferPool.h"
+
+class CppUnitBufferPool : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitBufferPool );
+    CPPUNIT_TEST ( reuse );
+    CPPUNIT_TEST ( sizeClasses );
+    CPPUNIT_TEST ( sharedSource );
+    CPPUNIT_TEST ( steadyState );
+    CPPUNIT_TEST ( poolSize );
+    CPPUNIT_TEST ( concurrency );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    static void* acquireMany ( void* arg ) {
+        for ( int i = 0; i < 10000; i++ ) {
+            PooledBuffer* b = BufferPool::acquire ( 1000 + ( i % 50 ) * 1000 );
+            b->getData() [0] = i;
+            b->retain();
+            b->release();
+            b->release();
+        }
+        return NULL;
+    }
+
+public:
+
+    void setUp() {
+        BufferPool::cleanPool();
+        BufferPool::setPoolSize ( 64 * 1024 * 1024 );
+        BufferPool::resetThreadCounters();
+    }
+
+    void tearDown() {
+        BufferPool::cleanPool();
+    }
+
+    void reuse() {
+        PooledBuffer* b = BufferPool::acquire ( 10000 );
+        uint8_t* data = b->getData();
+        b->release();
+        CPPUNIT_ASSERT_EQUAL ( b->getCapacity(), BufferPool::getUsedMemory() );
+
+        // Le même tampon est rendu pour une taille voisine
+        PooledBuffer* c = BufferPool::acquire ( 12000 );
+        CPPUNIT_ASSERT ( c->getData() == data );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 0, BufferPool::getUsedMemory() );
+        c->release();
+
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 2, BufferPool::getAcquisitions() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, BufferPool::getAllocations() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 2, BufferPool::getThreadAcquisitions() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, BufferPool::getThreadAllocations() );
+    }
+
+    void sizeClasses() {
+        size_t sizes[5] = { 1, 4096, 4097, 70000, 2097152 };
+        for ( int i = 0; i < 5; i++ ) {
+            PooledBuffer* b = BufferPool::acquire ( sizes[i] );
+            CPPUNIT_ASSERT ( b->getCapacity() >= sizes[i] );
+            // Au plus 50 % de perte
+            CPPUNIT_ASSERT ( b->getCapacity() <= 4096 || b->getCapacity() < sizes[i] * 3 / 2 );
+            b->release();
+        }
+
+        // Un tampon trop grand n'est pas gardé
+        PooledBuffer* big = BufferPool::acquire ( 3000000 );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 3000000, big->getCapacity() );
+        size_t before = BufferPool::getUsedMemory();
+        big->release();
+        CPPUNIT_ASSERT_EQUAL ( before, BufferPool::getUsedMemory() );
+    }
+
+    void sharedSource() {
+        PooledBuffer* b = BufferPool::acquire ( 5000 );
+        memset ( b->getData(), 7, 5000 );
+
+        DataSource* source = new PooledDataSource ( b, 5000, "image/png", "" );
+        b->release();
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 0, BufferPool::getUsedMemory() );
+
+        size_t size;
+        CPPUNIT_ASSERT ( source->getBuffer ( size ) == b );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 5000, size );
+        CPPUNIT_ASSERT_EQUAL ( 7, ( int ) source->getData ( size ) [4999] );
+
+        // Le tampon revient dans la réserve à la destruction de la dernière référence
+        delete source;
+        CPPUNIT_ASSERT_EQUAL ( b->getCapacity(), BufferPool::getUsedMemory() );
+    }
+
+    void steadyState() {
+        // Première vague : les tampons sont alloués
+        for ( int i = 0; i < 100; i++ ) {
+            std::vector<PooledBuffer*> buffers;
+            for ( int j = 0; j < 10; j++ ) buffers.push_back ( BufferPool::acquire ( 2000 + j * 20000 ) );
+            for ( int j = 0; j < 10; j++ ) buffers.at ( j )->release();
+        }
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 10, BufferPool::getAllocations() );
+
+        // Régime établi : plus aucune allocation
+        BufferPool::resetThreadCounters();
+        for ( int i = 0; i < 100; i++ ) {
+            PooledBuffer* b = BufferPool::acquire ( 2000 + ( i % 10 ) * 20000 );
+            b->release();
+        }
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 100, BufferPool::getThreadAcquisitions() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 0, BufferPool::getThreadAllocations() );
+    }
+
+    void poolSize() {
+        BufferPool::setPoolSize ( 100000 );
+        std::vector<PooledBuffer*> buffers;
+        for ( int j = 0; j < 10; j++ ) buffers.push_back ( BufferPool::acquire ( 30000 ) );
+        for ( int j = 0; j < 10; j++ ) buffers.at ( j )->release();
+        CPPUNIT_ASSERT ( BufferPool::getUsedMemory() <= 100000 );
+        CPPUNIT_ASSERT ( BufferPool::getUsedMemory() > 0 );
+
+        BufferPool::setPoolSize ( 0 );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 0, BufferPool::getUsedMemory() );
+    }
+
+    void concurrency() {
+        pthread_t threads[8];
+        for ( int i = 0; i < 8; i++ ) pthread_create ( &threads[i], NULL, acquireMany, NULL );
+        for ( int i = 0; i < 8; i++ ) pthread_join ( threads[i], NULL );
+
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 80000, BufferPool::getAcquisitions() );
+        CPPUNIT_ASSERT ( BufferPool::getAllocations() <= 8 * 50 );
+        // Les compteurs du thread principal ne voient pas les autres threads
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 0, BufferPool::getThreadAcquisitions() );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitBufferPool );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitBufferPool, "CppUnitBufferPool" );
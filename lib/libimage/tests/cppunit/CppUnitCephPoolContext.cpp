@@ -0,0 +1,312 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "../../../../rok4version.h"
+
+#if BUILD_OBJECT
+
+#include <sys/time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+#include <iostream>
+#include "CephPoolContext.h"
+
+using namespace std;
+
+/*
+ * Remplaçant en mémoire de librados : ces définitions prennent le pas sur celles de la bibliothèque partagée.
+ * Chaque lecture, synchrone ou non, subit une latence fixe simulant un aller-retour vers un OSD. Les lectures asynchrones
+ * sont servies en parallèle. L'octet i de tout objet vaut i % 251, l'objet "missing" n'existe pas.
+ */
+
+static const int radosLatency = 1000; // microsecondes
+
+struct FakeExtent {
+    uint64_t offset;
+    size_t len;
+    char* buffer;
+    size_t* bytesRead;
+    int* prval;
+};
+
+struct FakeCompletion {
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    bool done;
+    int ret;
+    std::string oid;
+    std::vector<FakeExtent> extents;
+};
+
+static int fakeRead ( const char* oid, char* buf, size_t len, uint64_t off ) {
+    if ( strcmp ( oid, "missing" ) == 0 ) return -ENOENT;
+    for ( size_t i = 0; i < len; i++ ) buf[i] = ( char ) ( ( off + i ) % 251 );
+    return len;
+}
+
+static void* fakeOperate ( void* arg ) {
+    FakeCompletion* c = ( FakeCompletion* ) arg;
+    usleep ( radosLatency );
+
+    int ret = 0;
+    for ( int i = 0; i < c->extents.size(); i++ ) {
+        FakeExtent& e = c->extents.at ( i );
+        int r = fakeRead ( c->oid.c_str(), e.buffer, e.len, e.offset );
+        if ( e.prval ) *e.prval = ( r < 0 ) ? r : 0;
+        if ( e.bytesRead && r >= 0 ) *e.bytesRead = r;
+        ret = ( r < 0 ) ? r : ( e.prval ? 0 : r );
+    }
+
+    pthread_mutex_lock ( &c->mtx );
+    c->ret = ret;
+    c->done = true;
+    pthread_cond_broadcast ( &c->cond );
+    pthread_mutex_unlock ( &c->mtx );
+    return 0;
+}
+
+static int fakeStart ( FakeCompletion* c, const char* oid ) {
+    c->oid = oid;
+    pthread_t t;
+    pthread_create ( &t, NULL, fakeOperate, c );
+    pthread_detach ( t );
+    return 0;
+}
+
+int rados_create2 ( rados_t* cluster, const char* const clustername, const char* const name, uint64_t flags ) { *cluster = ( rados_t ) 1; return 0; }
+int rados_conf_read_file ( rados_t cluster, const char* path ) { return 0; }
+int rados_conf_set ( rados_t cluster, const char* option, const char* value ) { return 0; }
+int rados_connect ( rados_t cluster ) { return 0; }
+void rados_shutdown ( rados_t cluster ) { }
+int rados_ioctx_create ( rados_t cluster, const char* pool_name, rados_ioctx_t* ioctx ) { *ioctx = ( rados_ioctx_t ) 1; return 0; }
+void rados_ioctx_destroy ( rados_ioctx_t io ) { }
+int rados_aio_flush ( rados_ioctx_t io ) { return 0; }
+int rados_write_full ( rados_ioctx_t io, const char* oid, const char* buf, size_t len ) { return 0; }
+
+int rados_read ( rados_ioctx_t io, const char* oid, char* buf, size_t len, uint64_t off ) {
+    usleep ( radosLatency );
+    return fakeRead ( oid, buf, len, off );
+}
+
+int rados_aio_create_completion ( void* cb_arg, rados_callback_t cb_complete, rados_callback_t cb_safe, rados_completion_t* pc ) {
+    FakeCompletion* c = new FakeCompletion();
+    pthread_mutex_init ( &c->mtx, 0 );
+    pthread_cond_init ( &c->cond, 0 );
+    c->done = false;
+    c->ret = 0;
+    *pc = ( rados_completion_t ) c;
+    return 0;
+}
+
+int rados_aio_read ( rados_ioctx_t io, const char* oid, rados_completion_t completion, char* buf, size_t len, uint64_t off ) {
+    FakeCompletion* c = ( FakeCompletion* ) completion;
+    FakeExtent e = { off, len, buf, NULL, NULL };
+    c->extents.push_back ( e );
+    return fakeStart ( c, oid );
+}
+
+rados_read_op_t rados_create_read_op() {
+    return ( rados_read_op_t ) new std::vector<FakeExtent>();
+}
+
+void rados_release_read_op ( rados_read_op_t read_op ) {
+    delete ( std::vector<FakeExtent>* ) read_op;
+}
+
+void rados_read_op_read ( rados_read_op_t read_op, uint64_t offset, size_t len, char* buffer, size_t* bytes_read, int* prval ) {
+    FakeExtent e = { offset, len, buffer, bytes_read, prval };
+    ( ( std::vector<FakeExtent>* ) read_op )->push_back ( e );
+}
+
+int rados_aio_read_op_operate ( rados_read_op_t read_op, rados_ioctx_t io, rados_completion_t completion, const char* oid, int flags ) {
+    FakeCompletion* c = ( FakeCompletion* ) completion;
+    c->extents = * ( ( std::vector<FakeExtent>* ) read_op );
+    return fakeStart ( c, oid );
+}
+
+int rados_aio_wait_for_complete ( rados_completion_t completion ) {
+    FakeCompletion* c = ( FakeCompletion* ) completion;
+    pthread_mutex_lock ( &c->mtx );
+    while ( ! c->done ) pthread_cond_wait ( &c->cond, &c->mtx );
+    pthread_mutex_unlock ( &c->mtx );
+    return 0;
+}
+
+int rados_aio_get_return_value ( rados_completion_t completion ) {
+    return ( ( FakeCompletion* ) completion )->ret;
+}
+
+void rados_aio_release ( rados_completion_t completion ) {
+    FakeCompletion* c = ( FakeCompletion* ) completion;
+    pthread_cond_destroy ( &c->cond );
+    pthread_mutex_destroy ( &c->mtx );
+    delete c;
+}
+
+class CppUnitCephPoolContext : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitCephPoolContext );
+    CPPUNIT_TEST ( asyncReads );
+    CPPUNIT_TEST ( groupedReads );
+    CPPUNIT_TEST ( failedReads );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    CephPoolContext* context;
+
+    bool checkData ( uint8_t* data, int offset, int size ) {
+        for ( int i = 0; i < size; i++ ) {
+            if ( data[i] != ( uint8_t ) ( ( offset + i ) % 251 ) ) return false;
+        }
+        return true;
+    }
+
+    double chrono() {
+        struct timeval tv;
+        gettimeofday ( &tv, NULL );
+        return tv.tv_sec + tv.tv_usec / 1000000.;
+    }
+
+    void cleanReads ( std::vector<ContextRead*>& reads ) {
+        for ( int i = 0; i < reads.size(); i++ ) {
+            delete[] reads.at ( i )->data;
+            delete reads.at ( i );
+        }
+        reads.clear();
+    }
+
+public:
+
+    void setUp() {
+        context = new CephPoolContext ( "pool" );
+        context->connection();
+    }
+
+    void tearDown() {
+        delete context;
+    }
+
+    void asyncReads() {
+        // Un extrait par objet : rados_aio_read
+        std::vector<ContextRead*> reads;
+        for ( int i = 0; i < 32; i++ ) {
+            char name[32];
+            sprintf ( name, "slab_%d", i );
+            reads.push_back ( new ContextRead ( new uint8_t[100 + i], 2048 + i, 100 + i, name ) );
+        }
+        context->readAll ( reads );
+        for ( int i = 0; i < reads.size(); i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 100 + i, reads.at ( i )->result );
+            CPPUNIT_ASSERT ( checkData ( reads.at ( i )->data, 2048 + i, 100 + i ) );
+            CPPUNIT_ASSERT ( reads.at ( i )->pending == NULL );
+        }
+        cleanReads ( reads );
+    }
+
+    void groupedReads() {
+        // Plusieurs extraits du même objet : une seule opération
+        std::vector<ContextRead*> reads;
+        for ( int i = 0; i < 16; i++ ) {
+            reads.push_back ( new ContextRead ( new uint8_t[500], i * 500, 500, "slab" ) );
+        }
+        context->readAll ( reads );
+        for ( int i = 0; i < reads.size(); i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 500, reads.at ( i )->result );
+            CPPUNIT_ASSERT ( checkData ( reads.at ( i )->data, i * 500, 500 ) );
+        }
+        cleanReads ( reads );
+    }
+
+    void failedReads() {
+        std::vector<ContextRead*> reads;
+        reads.push_back ( new ContextRead ( new uint8_t[10], 0, 10, "missing" ) );
+        reads.push_back ( new ContextRead ( new uint8_t[10], 0, 10, "missing" ) );
+        reads.push_back ( new ContextRead ( new uint8_t[10], 0, 10, "slab" ) );
+        context->readAll ( reads );
+        CPPUNIT_ASSERT ( reads.at ( 0 )->result < 0 );
+        CPPUNIT_ASSERT ( reads.at ( 1 )->result < 0 );
+        CPPUNIT_ASSERT_EQUAL ( 10, reads.at ( 2 )->result );
+        cleanReads ( reads );
+    }
+
+    void performance() {
+        int nb = 256;
+        int size = 16384;
+        uint8_t* buffer = new uint8_t[size];
+
+        double t = chrono();
+        for ( int i = 0; i < nb; i++ ) {
+            char name[32];
+            sprintf ( name, "slab_%d", i % 16 );
+            context->read ( buffer, i * size, size, name );
+        }
+        double tSync = chrono() - t;
+        delete[] buffer;
+
+        std::vector<ContextRead*> reads;
+        for ( int i = 0; i < nb; i++ ) {
+            char name[32];
+            sprintf ( name, "slab_%d", i % 16 );
+            reads.push_back ( new ContextRead ( new uint8_t[size], i * size, size, name ) );
+        }
+        t = chrono();
+        context->readAll ( reads );
+        double tAsync = chrono() - t;
+
+        for ( int i = 0; i < nb; i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( size, reads.at ( i )->result );
+        }
+        cleanReads ( reads );
+
+        cerr << " -= Lectures Ceph (librados simulé, latence " << radosLatency << " µs) =-" << endl;
+        cerr << tSync << "s : " << nb << " lectures de " << size << " octets (16 objets) une à une" << endl;
+        cerr << tAsync << "s : " << nb << " lectures de " << size << " octets (16 objets) en un lot" << endl;
+        cerr << endl;
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitCephPoolContext );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitCephPoolContext, "CppUnitCephPoolContext" );
+
+#endif
@@ -41,12 +41,16 @@
 #include <cstdlib>
 
 #include <iostream>
+#include <string>
 using namespace std;
 
 template<typename T> inline const char* name();
 template<> inline const char* name<uint8_t>() {
     return "uint8";
 }
+template<> inline const char* name<uint16_t>() {
+    return "uint16";
+}
 template<> inline const char* name<float>() {
     return "float";
 }
@@ -56,6 +60,7 @@ class CppUnitConvert : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST_SUITE ( CppUnitConvert );
     // enregistrement des methodes de tests à jouer :
     CPPUNIT_TEST ( uint8_to_float );
+    CPPUNIT_TEST ( variants );
     CPPUNIT_TEST ( performance );
     CPPUNIT_TEST_SUITE_END();
 
@@ -85,10 +90,11 @@ protected:
         T to[2048]    __attribute__ ( ( aligned ( 32 ) ) );
         memset ( from, 0, sizeof ( from ) );
 
-        cerr << " -= Conversion " << name<F>() << " -> " << name<T>() << " =-" << endl;
+        cerr << " -= Conversion " << name<F>() << " -> " << name<T>() << " (" << Simd::getLevelName ( Simd::getLevel() ) << ") =-" << endl;
 
         double t = chrono ( to, from, length, nb_iteration );
-        cerr << t << "s : " << nb_iteration << " (x" << length << ") conversions " << name<F>() << " (aligned) -> " << name<T>() << " (aligned)" << endl;
+        cerr << t << "s : " << nb_iteration << " (x" << length << ") conversions " << name<F>() << " (aligned) -> " << name<T>() << " (aligned), "
+             << nb_iteration * ( double ) length / t / 1000000. << " M/s" << endl;
 
         t = chrono ( to, from+1, length, nb_iteration );
         cerr << t << "s : " << nb_iteration << " (x" << length << ") conversions " << name<F>() << " (non aligned) -> " << name<T>() << " (aligned)" << endl;
@@ -103,14 +109,27 @@ protected:
     }
 
     void performance() {
-        performance<uint8_t,float>();
-        performance<float,uint8_t>();
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            performance<uint8_t,float>();
+            performance<float,uint8_t>();
+            performance<uint16_t,float>();
+            performance<float,uint16_t>();
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
         performance<uint8_t,uint8_t>();
     }
 
 
     void uint8_to_float() {
-        double t = 0;
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            uint8_to_float_level();
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+    }
+
+    void uint8_to_float_level() {
 
         uint8_t FROM8[32768]   __attribute__ ( ( aligned ( 32 ) ) );;
         float  FLOAT[32768]   __attribute__ ( ( aligned ( 32 ) ) );;
@@ -144,6 +163,67 @@ protected:
         for ( int i = 0; i < 50; i++ ) CPPUNIT_ASSERT_EQUAL ( 1, (int) UINT8_1_OR_2[i] );
         for ( int i = 50; i < 101; i++ ) CPPUNIT_ASSERT_EQUAL ( 2, (int) UINT8_1_OR_2[i] );
     }
+
+    // Chaque version doit donner exactement le résultat de la version scalaire, arrondis et saturations compris
+    void variants() {
+        float FROM[4096]     __attribute__ ( ( aligned ( 32 ) ) );
+        uint8_t FROM8[4096]  __attribute__ ( ( aligned ( 32 ) ) );
+        uint16_t FROM16[4096] __attribute__ ( ( aligned ( 32 ) ) );
+        uint8_t TO8[4096]    __attribute__ ( ( aligned ( 32 ) ) );
+        uint16_t TO16[4096]  __attribute__ ( ( aligned ( 32 ) ) );
+        float TOF[4096]      __attribute__ ( ( aligned ( 32 ) ) );
+
+        for ( int i = 0; i < 4096; i++ ) {
+            FROM[i] = ( float ) ( rand() % 140000 - 70000 ) / ( float ) ( 1 + rand() % 200 );
+            FROM8[i] = rand() % 256;
+            FROM16[i] = rand() % 65536;
+        }
+        // Valeurs à la limite de l'arrondi
+        FROM[0] = 0.49999997f;
+        FROM[1] = 0.5f;
+        FROM[2] = 254.49998f;
+        FROM[3] = 254.5f;
+        FROM[4] = 255.5f;
+        FROM[5] = -0.5f;
+        FROM[6] = 65534.5f;
+        FROM[7] = 1e6f;
+        for ( int i = 8; i < 64; i++ ) FROM[i] = ( i - 8 ) + 0.5f;
+
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            std::string level = Simd::getLevelName ( ( Simd::Level ) l );
+
+            for ( int k = 0; k < 200; k++ ) {
+                int i1 = rand() % 64;
+                int i2 = rand() % 64;
+                int length = ( k < 64 ) ? k : rand() % 4000;
+
+                convert ( TO8 + i2, FROM + i1, length );
+                for ( int i = 0; i < length; i++ ) {
+                    int t = ( int ) ( FROM[i1+i] + 0.5 );
+                    t = ( t < 0 ) ? 0 : ( ( t > 255 ) ? 255 : t );
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE ( level + " float -> uint8", t, ( int ) TO8[i2+i] );
+                }
+
+                convert ( TO16 + i2, FROM + i1, length );
+                for ( int i = 0; i < length; i++ ) {
+                    int t = ( int ) ( FROM[i1+i] + 0.5 );
+                    t = ( t < 0 ) ? 0 : ( ( t > 65535 ) ? 65535 : t );
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE ( level + " float -> uint16", t, ( int ) TO16[i2+i] );
+                }
+
+                convert ( TOF + i2, FROM16 + i1, length );
+                for ( int i = 0; i < length; i++ ) CPPUNIT_ASSERT_EQUAL_MESSAGE ( level + " uint16 -> float", ( float ) FROM16[i1+i], TOF[i2+i] );
+
+                convert ( TOF + i2, FROM8 + i1, length );
+                for ( int i = 0; i < length; i++ ) CPPUNIT_ASSERT_EQUAL_MESSAGE ( level + " uint8 -> float", ( float ) FROM8[i1+i], TOF[i2+i] );
+
+                convert ( TO16 + i2, FROM8 + i1, length );
+                for ( int i = 0; i < length; i++ ) CPPUNIT_ASSERT_EQUAL_MESSAGE ( level + " uint8 -> uint16", ( int ) FROM8[i1+i], ( int ) TO16[i2+i] );
+            }
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+    }
     
 };
 
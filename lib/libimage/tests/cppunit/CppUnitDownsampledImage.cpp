@@ -0,0 +1,344 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "DownsampledImage.h"
+#include "Simd.h"
+#include <sys/time.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <iostream>
+using namespace std;
+
+/**
+ * Image en mémoire, avec un éventuel masque
+ */
+template <typename T>
+class BufferImage : public Image {
+public:
+    T* data;
+
+    BufferImage ( int width, int height, int channels, T* data, double resx, double resy, BoundingBox<double> bbox ) :
+        Image ( width, height, channels, resx, resy, bbox ), data ( data ) {}
+
+    template <typename U>
+    int copy ( U* buffer, int line ) {
+        for ( int i = 0; i < width * channels; i++ ) buffer[i] = ( U ) data[line * width * channels + i];
+        return width * channels;
+    }
+
+    virtual int getline ( uint8_t* buffer, int line ) {
+        return copy ( buffer, line );
+    }
+    virtual int getline ( uint16_t* buffer, int line ) {
+        return copy ( buffer, line );
+    }
+    virtual int getline ( float* buffer, int line ) {
+        return copy ( buffer, line );
+    }
+
+    virtual ~BufferImage() {
+        delete[] data;
+    }
+};
+
+class CppUnitDownsampledImage : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitDownsampledImage );
+    CPPUNIT_TEST ( uint8LikeMerge4tiff );
+    CPPUNIT_TEST ( floatLikeMerge4tiff );
+    CPPUNIT_TEST ( uint16Rounded );
+    CPPUNIT_TEST ( image );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    // Boucle de merge4tiff avant son passage sur downsample, pour un type de canal. Les sorties de l'outil sont comparées à ses références dans rok4generation/tools/merge4tiff/tests
+    template <typename T>
+    void merge4tiff ( T* to, uint8_t* toMask, const T* from1, const T* from2, const uint8_t* mask1, const uint8_t* mask2, int width, int channels, const uint8_t* merge ) {
+        float pix[channels];
+        for ( int x = 0; x < width; x++ ) {
+            int nbData = 0;
+            memset ( pix, 0, channels * sizeof ( float ) );
+            if ( mask1[2 * x] ) {
+                nbData++;
+                for ( int c = 0; c < channels; c++ ) pix[c] += from1[2 * x * channels + c];
+            }
+            if ( mask1[2 * x + 1] ) {
+                nbData++;
+                for ( int c = 0; c < channels; c++ ) pix[c] += from1[ ( 2 * x + 1 ) * channels + c];
+            }
+            if ( mask2[2 * x] ) {
+                nbData++;
+                for ( int c = 0; c < channels; c++ ) pix[c] += from2[2 * x * channels + c];
+            }
+            if ( mask2[2 * x + 1] ) {
+                nbData++;
+                for ( int c = 0; c < channels; c++ ) pix[c] += from2[ ( 2 * x + 1 ) * channels + c];
+            }
+            if ( nbData > 1 ) {
+                toMask[x] = 255;
+                for ( int c = 0; c < channels; c++ ) {
+                    if ( sizeof ( T ) == 1 ) to[x * channels + c] = merge[ ( int ) pix[c] * 4 / nbData];
+                    else if ( sizeof ( T ) == 2 ) to[x * channels + c] = ( T ) ( pix[c] / ( float ) nbData + 0.5 );
+                    else to[x * channels + c] = pix[c] / ( float ) nbData;
+                }
+            }
+        }
+    }
+
+    uint8_t randomMask() {
+        return ( rand() % 3 ) ? ( uint8_t ) ( 1 + rand() % 255 ) : 0;
+    }
+
+    // Compare downsample et la boucle de merge4tiff, pour toutes les largeurs jusqu'à 40, de 1 à 5 canaux, et à tous les niveaux SIMD
+    template <typename T>
+    void compare ( T ( *random ) (), const uint8_t* merge ) {
+        for ( int channels = 1; channels <= 5; channels++ ) {
+            for ( int width = 1; width <= 40; width++ ) {
+                int in = 2 * width * channels, out = width * channels;
+                T from1[in], from2[in], background[out], expected[out], to[out];
+                uint8_t mask1[2 * width], mask2[2 * width], backgroundMask[width], expectedMask[width], toMask[width];
+
+                for ( int i = 0; i < in; i++ ) {
+                    from1[i] = random();
+                    from2[i] = random();
+                }
+                for ( int i = 0; i < 2 * width; i++ ) {
+                    mask1[i] = randomMask();
+                    mask2[i] = randomMask();
+                }
+                for ( int i = 0; i < out; i++ ) background[i] = random();
+                for ( int i = 0; i < width; i++ ) backgroundMask[i] = rand() % 2 ? 255 : 0;
+
+                memcpy ( expected, background, sizeof ( background ) );
+                memcpy ( expectedMask, backgroundMask, sizeof ( backgroundMask ) );
+                merge4tiff ( expected, expectedMask, from1, from2, mask1, mask2, width, channels, merge );
+
+                for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+                    Simd::setLevel ( ( Simd::Level ) l );
+                    memcpy ( to, background, sizeof ( background ) );
+                    memcpy ( toMask, backgroundMask, sizeof ( backgroundMask ) );
+                    downsample ( to, toMask, from1, from2, mask1, mask2, width, channels, merge );
+                    CPPUNIT_ASSERT ( memcmp ( expected, to, sizeof ( to ) ) == 0 );
+                    CPPUNIT_ASSERT ( memcmp ( expectedMask, toMask, sizeof ( toMask ) ) == 0 );
+                }
+            }
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+    }
+
+    static uint8_t random8() {
+        return rand() % 256;
+    }
+
+    static uint16_t random16() {
+        return rand() % 65536;
+    }
+
+    // Valeurs négatives, zéros signés et non représentables exactement
+    static float randomFloat() {
+        switch ( rand() % 8 ) {
+        case 0:
+            return 0.f;
+        case 1:
+            return -0.f;
+        default:
+            return ( float ) ( ( double ) rand() / RAND_MAX * 8000. - 1000. ) / 3.f;
+        }
+    }
+
+    void uint8LikeMerge4tiff() {
+        uint8_t merge[1024];
+        double gammas[4] = { 1., 0.5, 2.2, 3. };
+        for ( int g = 0; g < 4; g++ ) {
+            DownsampledImage::fillMergeTable ( merge, gammas[g] );
+            compare<uint8_t> ( random8, merge );
+        }
+    }
+
+    void floatLikeMerge4tiff() {
+        compare<float> ( randomFloat, NULL );
+    }
+
+    void uint16Rounded() {
+        compare<uint16_t> ( random16, NULL );
+    }
+
+    // Image sous-échantillonnée à partir de 3 sources sur 4 et d'un fond
+    void image() {
+        int width = 16, height = 8, channels = 3;
+        double res = 2.;
+        BufferImage<uint8_t>* sources[4];
+        uint8_t* masks[4];
+        for ( int i = 0; i < 4; i++ ) {
+            uint8_t* data = new uint8_t[width * height * channels];
+            for ( int j = 0; j < width * height * channels; j++ ) data[j] = random8();
+            double xmin = 1000. + ( i % 2 ) * width * res;
+            double ymax = 5000. - ( i / 2 ) * height * res;
+            sources[i] = new BufferImage<uint8_t> ( width, height, channels, data, res, res, BoundingBox<double> ( xmin, ymax - height * res, xmin + width * res, ymax ) );
+            masks[i] = new uint8_t[width * height];
+            for ( int j = 0; j < width * height; j++ ) masks[i][j] = randomMask();
+            sources[i]->setMask ( new BufferImage<uint8_t> ( width, height, 1, masks[i], res, res, sources[i]->getBbox() ) );
+        }
+        delete sources[0];
+        sources[0] = NULL;
+
+        uint8_t* bgData = new uint8_t[width * height * channels];
+        for ( int j = 0; j < width * height * channels; j++ ) bgData[j] = random8();
+        BufferImage<uint8_t>* background = new BufferImage<uint8_t> ( width, height, channels, bgData, 2 * res, 2 * res, BoundingBox<double> ( 1000., 5000. - 2 * height * res, 1000. + 2 * width * res, 5000. ) );
+
+        int nodata[3] = { 255, 255, 255 };
+        Image* images[4] = { sources[0], sources[1], sources[2], sources[3] };
+
+        DownsampledImageFactory DIF;
+
+        // Dimensions impaires refusées
+        BufferImage<uint8_t> odd ( width - 1, height, channels, new uint8_t[ ( width - 1 ) * height * channels], res, res, BoundingBox<double> ( 0., 0., ( width - 1 ) * res, height * res ) );
+        Image* oddImages[4] = { &odd, NULL, NULL, NULL };
+        CPPUNIT_ASSERT ( DIF.createDownsampledImage ( oddImages, NULL, nodata ) == NULL );
+
+        DownsampledImage* DI = DIF.createDownsampledImage ( images, background, nodata, 2.2 );
+        CPPUNIT_ASSERT ( DI != NULL );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2 * res, DI->getResX(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 1000., DI->getXmin(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 5000., DI->getYmax(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 1000. + 2 * width * res, DI->getXmax(), 1e-9 );
+
+        uint8_t merge[1024];
+        DownsampledImage::fillMergeTable ( merge, 2.2 );
+
+        uint8_t empty[2 * width * channels];
+        uint8_t emptyMask[2 * width];
+        memset ( empty, 0, sizeof ( empty ) );
+        memset ( emptyMask, 0, sizeof ( emptyMask ) );
+
+        for ( int line = 0; line < height; line++ ) {
+            int y = line / ( height / 2 ), h = line % ( height / 2 );
+            uint8_t from[2][2 * width * channels];
+            uint8_t fromMask[2][2 * width];
+            for ( int r = 0; r < 2; r++ ) {
+                for ( int x = 0; x < 2; x++ ) {
+                    BufferImage<uint8_t>* s = sources[2 * y + x];
+                    if ( s == NULL ) {
+                        memset ( from[r] + x * width * channels, 0, width * channels );
+                        memset ( fromMask[r] + x * width, 0, width );
+                    } else {
+                        memcpy ( from[r] + x * width * channels, s->data + ( 2 * h + r ) * width * channels, width * channels );
+                        memcpy ( fromMask[r] + x * width, masks[2 * y + x] + ( 2 * h + r ) * width, width );
+                    }
+                }
+            }
+            uint8_t expected[width * channels], expectedMask[width];
+            memcpy ( expected, bgData + line * width * channels, width * channels );
+            memset ( expectedMask, 255, width );
+            merge4tiff ( expected, expectedMask, from[0], from[1], fromMask[0], fromMask[1], width, channels, merge );
+
+            uint8_t got[width * channels], gotMask[width];
+            CPPUNIT_ASSERT_EQUAL ( width * channels, DI->getline ( got, line ) );
+            CPPUNIT_ASSERT_EQUAL ( width, DI->getMask()->getline ( gotMask, line ) );
+            CPPUNIT_ASSERT ( memcmp ( expected, got, sizeof ( got ) ) == 0 );
+            CPPUNIT_ASSERT ( memcmp ( expectedMask, gotMask, sizeof ( gotMask ) ) == 0 );
+        }
+
+        delete DI;
+    }
+
+    double chrono ( timeval& BEGIN ) {
+        timeval NOW;
+        gettimeofday ( &NOW, NULL );
+        return NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+    }
+
+    template <typename T>
+    void measure ( const char* name, int channels, const uint8_t* merge ) {
+        int nb_tiles = 5, width = 2048, lines = 2048;
+        T* from1 = new T[2 * width * channels];
+        T* from2 = new T[2 * width * channels];
+        T* to = new T[width * channels];
+        uint8_t mask1[2 * width], mask2[2 * width], toMask[width];
+        for ( int i = 0; i < 2 * width * channels; i++ ) {
+            from1[i] = ( T ) ( rand() % 256 );
+            from2[i] = ( T ) ( rand() % 256 );
+        }
+        for ( int i = 0; i < 2 * width; i++ ) {
+            mask1[i] = ( rand() % 16 ) ? 255 : 0;
+            mask2[i] = ( rand() % 16 ) ? 255 : 0;
+        }
+        timeval BEGIN;
+
+        gettimeofday ( &BEGIN, NULL );
+        for ( int t = 0; t < nb_tiles; t++ ) {
+            for ( int line = 0; line < lines; line++ ) merge4tiff ( to, toMask, from1, from2, mask1, mask2, width, channels, merge );
+        }
+        double time = chrono ( BEGIN );
+        cerr << time << "s : " << nb_tiles << " dalles " << name << ", boucle merge4tiff : " << nb_tiles / time << " dalles/s" << endl;
+
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            gettimeofday ( &BEGIN, NULL );
+            for ( int t = 0; t < nb_tiles; t++ ) {
+                for ( int line = 0; line < lines; line++ ) downsample ( to, toMask, from1, from2, mask1, mask2, width, channels, merge );
+            }
+            time = chrono ( BEGIN );
+            cerr << time << "s : " << nb_tiles << " dalles " << name << ", downsample (" << Simd::getLevelName ( Simd::getLevel() ) << ") : " << nb_tiles / time << " dalles/s" << endl;
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+
+        delete[] from1;
+        delete[] from2;
+        delete[] to;
+    }
+
+    void performance() {
+        uint8_t merge[1024];
+        DownsampledImage::fillMergeTable ( merge, 1. );
+
+        cerr << " -= Sous-échantillonnage 2x2 : dalles 4096x4096 vers 2048x2048 =-" << endl;
+        measure<uint8_t> ( "RGB 8 bits", 3, merge );
+        measure<uint8_t> ( "gris 8 bits", 1, merge );
+        measure<uint16_t> ( "gris 16 bits", 1, merge );
+        measure<float> ( "MNT flottant", 1, merge );
+        cerr << endl;
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitDownsampledImage );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitDownsampledImage, "CppUnitDownsampledImage" );
@@ -0,0 +1,191 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <string>
+#include "FileDescriptorCache.h"
+#include "FileContext.h"
+
+class CppUnitFileDescriptorCache : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitFileDescriptorCache );
+    CPPUNIT_TEST ( reuse );
+    CPPUNIT_TEST ( maxSize );
+    CPPUNIT_TEST ( usedWhileEvicted );
+    CPPUNIT_TEST ( rewrittenFile );
+    CPPUNIT_TEST ( disabled );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    std::string dir;
+
+    std::string writeFile ( std::string name, const char* content ) {
+        std::string path = dir + name;
+        FILE* f = fopen ( path.c_str(), "w" );
+        fputs ( content, f );
+        fclose ( f );
+        return path;
+    }
+
+public:
+
+    void setUp() {
+        char tmpl[] = "/tmp/rok4fdcacheXXXXXX";
+        dir = std::string ( mkdtemp ( tmpl ) ) + "/";
+        FileDescriptorCache::cleanCache();
+        FileDescriptorCache::setValidity ( 0 );
+        FileDescriptorCache::setCacheSize ( 2 );
+    }
+
+    void tearDown() {
+        FileDescriptorCache::setCacheSize ( 0 );
+        FileDescriptorCache::cleanCache();
+        unlink ( ( dir + "a" ).c_str() );
+        unlink ( ( dir + "b" ).c_str() );
+        unlink ( ( dir + "c" ).c_str() );
+        rmdir ( dir.c_str() );
+    }
+
+    void reuse() {
+        writeFile ( "a", "0123456789" );
+        FileContext ctx ( dir );
+        uint8_t data[4];
+
+        CPPUNIT_ASSERT_EQUAL ( 4, ctx.read ( data, 2, 4, "a" ) );
+        CPPUNIT_ASSERT ( memcmp ( data, "2345", 4 ) == 0 );
+        CPPUNIT_ASSERT_EQUAL ( 4, ctx.read ( data, 6, 4, "a" ) );
+        CPPUNIT_ASSERT ( memcmp ( data, "6789", 4 ) == 0 );
+
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, FileDescriptorCache::getMisses() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, FileDescriptorCache::getHits() );
+        CPPUNIT_ASSERT_EQUAL ( 1, FileDescriptorCache::getSize() );
+
+        // La date de modification du fichier ouvert est connue sans accès au système de fichiers
+        struct stat st;
+        stat ( ( dir + "a" ).c_str(), &st );
+        CPPUNIT_ASSERT_EQUAL ( st.st_mtime, ctx.getModification ( "a" ) );
+        CPPUNIT_ASSERT_EQUAL ( ( time_t ) 0, ctx.getModification ( "b" ) );
+
+        // Lecture en échec : le descripteur est abandonné
+        CPPUNIT_ASSERT ( ctx.read ( data, 8, 4, "a" ) < 0 );
+        CPPUNIT_ASSERT_EQUAL ( 0, FileDescriptorCache::getSize() );
+    }
+
+    void maxSize() {
+        FileDescriptorCacheElement* fdce;
+        std::string a = writeFile ( "a", "a" );
+        std::string b = writeFile ( "b", "b" );
+        std::string c = writeFile ( "c", "c" );
+
+        FileDescriptorCache::getFileDescriptor ( a, fdce );
+        FileDescriptorCache::release ( fdce );
+        FileDescriptorCache::getFileDescriptor ( b, fdce );
+        FileDescriptorCache::release ( fdce );
+        FileDescriptorCache::getFileDescriptor ( a, fdce );
+        FileDescriptorCache::release ( fdce );
+        FileDescriptorCache::getFileDescriptor ( c, fdce );
+        FileDescriptorCache::release ( fdce );
+
+        // b est le moins récemment utilisé
+        CPPUNIT_ASSERT_EQUAL ( 2, FileDescriptorCache::getSize() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, FileDescriptorCache::getEvictions() );
+        FileDescriptorCache::getFileDescriptor ( a, fdce );
+        FileDescriptorCache::release ( fdce );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 2, FileDescriptorCache::getHits() );
+
+        CPPUNIT_ASSERT ( FileDescriptorCache::getFileDescriptor ( dir + "missing", fdce ) < 0 );
+    }
+
+    void usedWhileEvicted() {
+        FileDescriptorCacheElement* fdce;
+        std::string a = writeFile ( "a", "abc" );
+
+        int fd = FileDescriptorCache::getFileDescriptor ( a, fdce );
+        FileDescriptorCache::invalidate ( a );
+        CPPUNIT_ASSERT_EQUAL ( 0, FileDescriptorCache::getSize() );
+
+        // Le descripteur reste utilisable jusqu'à ce qu'il soit rendu
+        char buf[3];
+        CPPUNIT_ASSERT_EQUAL ( ( ssize_t ) 3, pread ( fd, buf, 3, 0 ) );
+        FileDescriptorCache::release ( fdce );
+    }
+
+    void rewrittenFile() {
+        FileDescriptorCache::setValidity ( 1 );
+        writeFile ( "a", "old content" );
+        FileContext ctx ( dir );
+        uint8_t data[3];
+
+        CPPUNIT_ASSERT_EQUAL ( 3, ctx.read ( data, 0, 3, "a" ) );
+        CPPUNIT_ASSERT ( memcmp ( data, "old", 3 ) == 0 );
+        std::string oldVersion = ctx.getVersion ( "a" );
+        CPPUNIT_ASSERT ( ! oldVersion.empty() );
+
+        // Remplacement du fichier, comme le font les outils de génération
+        std::string tmp = writeFile ( "b", "new content, longer" );
+        rename ( tmp.c_str(), ( dir + "a" ).c_str() );
+        sleep ( 2 );
+
+        CPPUNIT_ASSERT_EQUAL ( 3, ctx.read ( data, 0, 3, "a" ) );
+        CPPUNIT_ASSERT ( memcmp ( data, "new", 3 ) == 0 );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 2, FileDescriptorCache::getMisses() );
+
+        // Les caches des index et des tuiles s'appuient sur ce changement de version
+        CPPUNIT_ASSERT ( ctx.getVersion ( "a" ) != oldVersion );
+    }
+
+    void disabled() {
+        FileDescriptorCache::setCacheSize ( 0 );
+        writeFile ( "a", "0123456789" );
+        FileContext ctx ( dir );
+        uint8_t data[4];
+
+        CPPUNIT_ASSERT_EQUAL ( 4, ctx.read ( data, 0, 4, "a" ) );
+        CPPUNIT_ASSERT_EQUAL ( 0, FileDescriptorCache::getSize() );
+        CPPUNIT_ASSERT ( ! FileDescriptorCache::isEnabled() );
+        CPPUNIT_ASSERT_EQUAL ( ( time_t ) 0, ctx.getModification ( "a" ) );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitFileDescriptorCache );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitFileDescriptorCache, "CppUnitFileDescriptorCache" );
@@ -0,0 +1,187 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sys/time.h>
+#include <cmath>
+#include <string>
+#include "Grid.h"
+
+class CppUnitGrid : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitGrid );
+    CPPUNIT_TEST ( nearlyAffine );
+    CPPUNIT_TEST ( curved );
+    CPPUNIT_TEST ( borders );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    static double chrono() {
+        struct timeval tv;
+        gettimeofday ( &tv, NULL );
+        return tv.tv_sec + tv.tv_usec / 1000000.;
+    }
+
+    /**
+     * Écart maximal entre les lignes des deux grilles, une fois ramenées en pixels de résolution res
+     */
+    static double maxGap ( Grid& g1, Grid& g2, double res ) {
+        double xmin = g1.bbox.xmin, ymax = g1.bbox.ymax;
+        g1.affine_transform ( 1./res, -xmin/res, -1./res, ymax/res );
+        g2.affine_transform ( 1./res, -xmin/res, -1./res, ymax/res );
+
+        float X1[g1.width], Y1[g1.width], X2[g2.width], Y2[g2.width];
+        double gap = 0.;
+        for ( int l = 0; l < g1.height; l++ ) {
+            g1.getline ( l, X1, Y1 );
+            g2.getline ( l, X2, Y2 );
+            for ( int i = 0; i < g1.width; i++ ) {
+                gap = std::max ( gap, ( double ) hypot ( X1[i] - X2[i], Y1[i] - Y2[i] ) );
+            }
+        }
+        return gap;
+    }
+
+    /**
+     * Compare la reprojection adaptative à la reprojection de tous les points
+     */
+    void compare ( int width, int height, BoundingBox<double> bbox, std::string from, std::string to, double res, double tolerance, int& points, double& gap ) {
+        Grid full ( width, height, bbox );
+        Grid adaptive ( width, height, bbox );
+        CPPUNIT_ASSERT ( full.reproject ( from, to ) );
+        CPPUNIT_ASSERT ( adaptive.reproject ( from, to, tolerance * res ) );
+
+        // La bbox, reprojetée avec moins de points par côté, reste à moins d'un pixel
+        CPPUNIT_ASSERT ( fabs ( full.bbox.xmin - adaptive.bbox.xmin ) < res );
+        CPPUNIT_ASSERT ( fabs ( full.bbox.ymax - adaptive.bbox.ymax ) < res );
+
+        points = adaptive.getTransformedPoints();
+        CPPUNIT_ASSERT ( points <= full.getTransformedPoints() );
+        gap = maxGap ( full, adaptive, res );
+    }
+
+public:
+
+    void nearlyAffine() {
+        int points;
+        double gap;
+
+        // Tuile de 256 pixels à 50 cm, du Lambert 93 vers le WGS84 géographique
+        compare ( 256, 256, BoundingBox<double> ( 650000., 6860000., 650128., 6860128. ), "IGNF:LAMB93", "epsg:4326", 0.5 / 111000., 0.1, points, gap );
+        CPPUNIT_ASSERT ( points <= 9 );
+        CPPUNIT_ASSERT ( gap <= 0.1 );
+
+        // Tuile de 256 pixels à 20 m, du Web Mercator vers le Lambert 93
+        compare ( 256, 256, BoundingBox<double> ( 250000., 5600000., 255120., 5605120. ), "epsg:3857", "IGNF:LAMB93", 20., 0.1, points, gap );
+        CPPUNIT_ASSERT ( points <= 9 );
+        CPPUNIT_ASSERT ( gap <= 0.1 );
+    }
+
+    void curved() {
+        int points;
+        double gap;
+
+        // France entière en géographique vers le Lambert 93 : subdivision partielle
+        compare ( 1024, 1024, BoundingBox<double> ( -5., 41., 10., 52. ), "epsg:4326", "IGNF:LAMB93", 1200., 0.1, points, gap );
+        CPPUNIT_ASSERT ( points > 9 );
+        CPPUNIT_ASSERT ( points < 65 * 65 / 2 );
+        CPPUNIT_ASSERT ( gap <= 0.2 );
+
+        // Monde entier en géographique vers le Web Mercator : forte déformation en latitude, tous les points sont convertis
+        compare ( 1024, 512, BoundingBox<double> ( -180., -85., 180., 85. ), "epsg:4326", "epsg:3857", 40000., 0.1, points, gap );
+        CPPUNIT_ASSERT_EQUAL ( 65 * 33, points );
+        CPPUNIT_ASSERT ( gap <= 0.2 );
+
+        // Région polaire vers une stéréographique polaire
+        compare ( 512, 512, BoundingBox<double> ( -180., 60., 180., 90. ), "epsg:4326", "epsg:3413", 10000., 0.1, points, gap );
+        CPPUNIT_ASSERT ( points > 9 );
+        CPPUNIT_ASSERT ( gap <= 0.2 );
+    }
+
+    void borders() {
+        int points;
+        double gap;
+
+        // Dimensions non multiples du pas, et dernier point confondu avec le dernier point régulier
+        compare ( 300, 17, BoundingBox<double> ( 2., 45., 5., 45.17 ), "epsg:4326", "IGNF:LAMB93", 100., 0.1, points, gap );
+        CPPUNIT_ASSERT ( gap <= 0.2 );
+        compare ( 1, 1, BoundingBox<double> ( 2., 45., 2.01, 45.01 ), "epsg:4326", "IGNF:LAMB93", 100., 0.1, points, gap );
+        CPPUNIT_ASSERT ( gap <= 0.2 );
+
+        // Coordonnées hors du domaine de définition
+        Grid grid ( 64, 64, BoundingBox<double> ( -180., 80., 180., 100. ) );
+        CPPUNIT_ASSERT ( ! grid.reproject ( "epsg:4326", "epsg:3857", 1. ) );
+    }
+
+    void _chrono ( std::string label, int nb, int width, int height, BoundingBox<double> bbox, std::string from, std::string to, double res ) {
+        int pointsFull, pointsAdaptive;
+        double gap;
+
+        double t = chrono();
+        for ( int i = 0; i < nb; i++ ) {
+            Grid grid ( width, height, bbox );
+            grid.reproject ( from, to );
+            pointsFull = grid.getTransformedPoints();
+        }
+        double tFull = ( chrono() - t ) / nb;
+
+        t = chrono();
+        for ( int i = 0; i < nb; i++ ) {
+            Grid grid ( width, height, bbox );
+            grid.reproject ( from, to, 0.1 * res );
+        }
+        double tAdaptive = ( chrono() - t ) / nb;
+
+        compare ( width, height, bbox, from, to, res, 0.1, pointsAdaptive, gap );
+
+        std::cerr << label << " : " << pointsFull << " points en " << tFull * 1000000 << " us (pas fixe), "
+                  << pointsAdaptive << " points en " << tAdaptive * 1000000 << " us (adaptatif, tolerance 0.1 px, ecart max " << gap << " px)" << std::endl;
+    }
+
+    void performance() {
+        std::cerr << std::endl;
+        _chrono ( "Tuile 256x256, Lambert 93 -> WGS84", 200, 256, 256, BoundingBox<double> ( 650000., 6860000., 650128., 6860128. ), "IGNF:LAMB93", "epsg:4326", 0.5 / 111000. );
+        _chrono ( "Tuile 256x256, Web Mercator -> Lambert 93", 200, 256, 256, BoundingBox<double> ( 250000., 5600000., 255120., 5605120. ), "epsg:3857", "IGNF:LAMB93", 20. );
+        _chrono ( "Image 1024x1024, France WGS84 -> Lambert 93", 20, 1024, 1024, BoundingBox<double> ( -5., 41., 10., 52. ), "epsg:4326", "IGNF:LAMB93", 1200. );
+        _chrono ( "Image 1024x512, monde WGS84 -> Web Mercator", 20, 1024, 512, BoundingBox<double> ( -180., -85., 180., 85. ), "epsg:4326", "epsg:3857", 40000. );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitGrid );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitGrid, "CppUnitGrid" );
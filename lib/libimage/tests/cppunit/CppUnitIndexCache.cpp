@@ -0,0 +1,169 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include "IndexCache.h"
+
+class CppUnitIndexCache : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitIndexCache );
+    CPPUNIT_TEST ( hitAndMiss );
+    CPPUNIT_TEST ( symlinkResolution );
+    CPPUNIT_TEST ( memoryBudget );
+    CPPUNIT_TEST ( invalidation );
+    CPPUNIT_TEST ( disabled );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    uint32_t offsets[256];
+    uint32_t sizes[256];
+
+public:
+
+    void setUp() {
+        for ( int i = 0; i < 256; i++ ) {
+            offsets[i] = 2048 + 2048 + i * 1000;
+            sizes[i] = 1000 + i;
+        }
+        IndexCache::cleanCache();
+        IndexCache::setValidity ( 0 );
+        IndexCache::setCacheSize ( 1024 * 1024 );
+    }
+
+    void tearDown() {
+        IndexCache::setCacheSize ( 0 );
+        IndexCache::cleanCache();
+    }
+
+    void hitAndMiss() {
+        std::string name;
+        uint32_t off, size;
+
+        CPPUNIT_ASSERT ( ! IndexCache::getTileIndex ( "FILE::/pyr/00/00.tif", 5, name, off, size ) );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, IndexCache::getMisses() );
+
+        IndexCache::addSlabIndex ( "FILE::/pyr/00/00.tif", "/pyr/00/00.tif", 256, offsets, sizes );
+        CPPUNIT_ASSERT_EQUAL ( 1, IndexCache::getSlabsNumber() );
+
+        CPPUNIT_ASSERT ( IndexCache::getTileIndex ( "FILE::/pyr/00/00.tif", 5, name, off, size ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "/pyr/00/00.tif" ), name );
+        CPPUNIT_ASSERT_EQUAL ( offsets[5], off );
+        CPPUNIT_ASSERT_EQUAL ( sizes[5], size );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, IndexCache::getHits() );
+
+        // Indice de tuile hors de la dalle
+        CPPUNIT_ASSERT ( ! IndexCache::getTileIndex ( "FILE::/pyr/00/00.tif", 256, name, off, size ) );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 2, IndexCache::getMisses() );
+    }
+
+    void symlinkResolution() {
+        std::string name = "/pyr/00/01.tif";
+        uint32_t off, size;
+
+        IndexCache::addSlabIndex ( "FILE::/pyr/00/01.tif", "/other/00/01.tif", 256, offsets, sizes );
+        CPPUNIT_ASSERT ( IndexCache::getTileIndex ( "FILE::/pyr/00/01.tif", 255, name, off, size ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "/other/00/01.tif" ), name );
+        CPPUNIT_ASSERT_EQUAL ( offsets[255], off );
+        CPPUNIT_ASSERT_EQUAL ( sizes[255], size );
+    }
+
+    void memoryBudget() {
+        std::string name;
+        uint32_t off, size;
+
+        IndexCache::addSlabIndex ( "A", "A", 256, offsets, sizes );
+        size_t elementSize = IndexCache::getUsedMemory();
+        CPPUNIT_ASSERT ( elementSize > 2 * 4 * 256 );
+
+        // Place pour deux éléments seulement
+        IndexCache::setCacheSize ( 2 * elementSize + elementSize / 2 );
+        IndexCache::addSlabIndex ( "B", "B", 256, offsets, sizes );
+
+        // A devient le plus récemment utilisé, B doit être évincé au prochain ajout
+        CPPUNIT_ASSERT ( IndexCache::getTileIndex ( "A", 0, name, off, size ) );
+        IndexCache::addSlabIndex ( "C", "C", 256, offsets, sizes );
+
+        CPPUNIT_ASSERT_EQUAL ( 2, IndexCache::getSlabsNumber() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, IndexCache::getEvictions() );
+        CPPUNIT_ASSERT ( IndexCache::getTileIndex ( "A", 0, name, off, size ) );
+        CPPUNIT_ASSERT ( IndexCache::getTileIndex ( "C", 0, name, off, size ) );
+        CPPUNIT_ASSERT ( ! IndexCache::getTileIndex ( "B", 0, name, off, size ) );
+        CPPUNIT_ASSERT ( IndexCache::getUsedMemory() <= 2 * elementSize + elementSize / 2 );
+    }
+
+    void invalidation() {
+        std::string name;
+        uint32_t off, size;
+
+        IndexCache::addSlabIndex ( "A", "A", 256, offsets, sizes );
+        IndexCache::invalidate ( "A" );
+        CPPUNIT_ASSERT ( ! IndexCache::getTileIndex ( "A", 0, name, off, size ) );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 0, IndexCache::getUsedMemory() );
+
+        // Remplacement d'un index existant
+        IndexCache::addSlabIndex ( "A", "A", 256, offsets, sizes );
+        sizes[0] = 42;
+        IndexCache::addSlabIndex ( "A", "A", 256, offsets, sizes );
+        CPPUNIT_ASSERT_EQUAL ( 1, IndexCache::getSlabsNumber() );
+        CPPUNIT_ASSERT ( IndexCache::getTileIndex ( "A", 0, name, off, size ) );
+        CPPUNIT_ASSERT_EQUAL ( ( uint32_t ) 42, size );
+
+        // Dalle réécrite depuis la lecture de son index
+        IndexCache::addSlabIndex ( "V", "V", 256, offsets, sizes, "1:10:1500000000:4096" );
+        CPPUNIT_ASSERT ( IndexCache::getTileIndex ( "V", 0, name, off, size, "1:10:1500000000:4096" ) );
+        CPPUNIT_ASSERT ( ! IndexCache::getTileIndex ( "V", 0, name, off, size, "1:11:1500000060:4096" ) );
+        CPPUNIT_ASSERT_EQUAL ( 1, IndexCache::getSlabsNumber() );
+    }
+
+    void disabled() {
+        std::string name;
+        uint32_t off, size;
+
+        IndexCache::addSlabIndex ( "A", "A", 256, offsets, sizes );
+        IndexCache::setCacheSize ( 0 );
+        CPPUNIT_ASSERT ( ! IndexCache::isEnabled() );
+        CPPUNIT_ASSERT_EQUAL ( 0, IndexCache::getSlabsNumber() );
+
+        IndexCache::addSlabIndex ( "A", "A", 256, offsets, sizes );
+        CPPUNIT_ASSERT ( ! IndexCache::getTileIndex ( "A", 0, name, off, size ) );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitIndexCache );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitIndexCache, "CppUnitIndexCache" );
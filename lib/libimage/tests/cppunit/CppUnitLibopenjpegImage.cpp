@@ -0,0 +1,252 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "Jpeg2000_library_config.h"
+
+// Sans kakadu, les JPEG2000 sont lus avec openjpeg
+#ifndef KDU_USE
+
+#include "LibopenjpegImage.h"
+#include "ThreadPool.h"
+#include "openjpeg.h"
+#include <unistd.h>
+#include <string.h>
+#include <sstream>
+#include <vector>
+
+// Image 300 x 203, tuiles de 64 : la dernière colonne et la dernière ligne de tuiles sont partielles, la hauteur est impaire
+static const int WIDTH = 300;
+static const int HEIGHT = 203;
+static const int TILE = 64;
+static const int CHANNELS = 3;
+static const int RESOLUTIONS = 4;
+
+/**
+ * Valeur synthétique d'un échantillon
+ */
+static int sampleValue ( int x, int y, int c ) {
+    return ( x * ( 2 + c ) + y * 5 + ( ( x * 11 + y * 7 ) % 13 ) * 9 ) & 0xFF;
+}
+
+class CppUnitLibopenjpegImage : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitLibopenjpegImage );
+    CPPUNIT_TEST ( stripsAsFullDecode );
+    CPPUNIT_TEST ( reducedDimensions );
+    CPPUNIT_TEST ( reducedAsFullDecode );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    std::string file;
+
+public:
+
+    // Codestream J2K tuilé, sans perte, avec RESOLUTIONS niveaux de résolution
+    void setUp() {
+        ThreadPool::cleanSharedPool();
+
+        std::ostringstream oss;
+        oss << "/tmp/CppUnitLibopenjpegImage_" << getpid() << ".j2k";
+        file = oss.str();
+
+        opj_image_cmptparm_t cmptparm[CHANNELS];
+        memset ( cmptparm, 0, sizeof ( cmptparm ) );
+        for ( int c = 0; c < CHANNELS; c++ ) {
+            cmptparm[c].dx = 1;
+            cmptparm[c].dy = 1;
+            cmptparm[c].w = WIDTH;
+            cmptparm[c].h = HEIGHT;
+            cmptparm[c].prec = 8;
+            cmptparm[c].sgnd = 0;
+        }
+        opj_image_t* image = opj_image_create ( CHANNELS, cmptparm, OPJ_CLRSPC_SRGB );
+        CPPUNIT_ASSERT ( image != NULL );
+        image->x0 = 0;
+        image->y0 = 0;
+        image->x1 = WIDTH;
+        image->y1 = HEIGHT;
+        for ( int c = 0; c < CHANNELS; c++ ) {
+            for ( int y = 0; y < HEIGHT; y++ ) {
+                for ( int x = 0; x < WIDTH; x++ ) image->comps[c].data[y * WIDTH + x] = sampleValue ( x, y, c );
+            }
+        }
+
+        opj_cparameters_t parameters;
+        opj_set_default_encoder_parameters ( &parameters );
+        parameters.tcp_numlayers = 1;
+        parameters.tcp_rates[0] = 0;
+        parameters.cp_disto_alloc = 1;
+        parameters.numresolution = RESOLUTIONS;
+        parameters.tile_size_on = OPJ_TRUE;
+        parameters.cp_tdx = TILE;
+        parameters.cp_tdy = TILE;
+
+        opj_codec_t* codec = opj_create_compress ( OPJ_CODEC_J2K );
+        CPPUNIT_ASSERT ( opj_setup_encoder ( codec, &parameters, image ) );
+        opj_stream_t* stream = opj_stream_create_default_file_stream ( file.c_str(), OPJ_FALSE );
+        CPPUNIT_ASSERT ( stream != NULL );
+        CPPUNIT_ASSERT ( opj_start_compress ( codec, image, stream ) );
+        CPPUNIT_ASSERT ( opj_encode ( codec, stream ) );
+        CPPUNIT_ASSERT ( opj_end_compress ( codec, stream ) );
+        opj_stream_destroy ( stream );
+        opj_destroy_codec ( codec );
+        opj_image_destroy ( image );
+    }
+
+    void tearDown() {
+        ThreadPool::cleanSharedPool();
+        unlink ( file.c_str() );
+    }
+
+protected:
+
+    LibopenjpegImage* open () {
+        LibopenjpegImageFactory LOIF;
+        LibopenjpegImage* image = LOIF.createLibopenjpegImageToRead ( ( char* ) file.c_str(), BoundingBox<double> ( 1000., 2000., 1000. + WIDTH, 2000. + HEIGHT ), 1., 1. );
+        CPPUNIT_ASSERT ( image != NULL );
+        return image;
+    }
+
+    // Décodage complet de l'image par openjpeg, sans restriction de zone, en ignorant les reduce niveaux les plus fins
+    opj_image_t* fullDecode ( int reduce ) {
+        opj_dparameters_t parameters;
+        opj_set_default_decoder_parameters ( &parameters );
+        parameters.cp_reduce = reduce;
+        opj_codec_t* codec = opj_create_decompress ( OPJ_CODEC_J2K );
+        CPPUNIT_ASSERT ( opj_setup_decoder ( codec, &parameters ) );
+        opj_stream_t* stream = opj_stream_create_default_file_stream ( file.c_str(), OPJ_TRUE );
+        CPPUNIT_ASSERT ( stream != NULL );
+        opj_image_t* image = NULL;
+        CPPUNIT_ASSERT ( opj_read_header ( stream, codec, &image ) );
+        CPPUNIT_ASSERT ( opj_decode ( codec, stream, image ) );
+        CPPUNIT_ASSERT ( opj_end_decompress ( codec, stream ) );
+        opj_stream_destroy ( stream );
+        opj_destroy_codec ( codec );
+        return image;
+    }
+
+    // Les lignes lues bande par bande, dans un ordre non séquentiel, sont celles du décodage complet
+    void compareLines ( LibopenjpegImage* image, int reduce ) {
+        opj_image_t* reference = fullDecode ( reduce );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) reference->comps[0].w, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) reference->comps[0].h, image->getHeight() );
+
+        int width = image->getWidth();
+        std::vector<uint8_t> line ( width * CHANNELS );
+        for ( int i = 0; i < image->getHeight(); i++ ) {
+            int l = ( i * 37 ) % image->getHeight();
+            CPPUNIT_ASSERT_EQUAL ( width * CHANNELS, image->getline ( &line[0], l ) );
+            for ( int x = 0; x < width; x++ ) {
+                for ( int c = 0; c < CHANNELS; c++ ) {
+                    CPPUNIT_ASSERT_EQUAL ( reference->comps[c].data[l * width + x], ( OPJ_INT32 ) line[x * CHANNELS + c] );
+                }
+            }
+        }
+        opj_image_destroy ( reference );
+    }
+
+    // Pleine résolution, avec ou sans décodage parallèle : les bandes reconstituent l'image, sans perte
+    void stripsAsFullDecode() {
+        for ( int threads = 0; threads <= 4; threads += 4 ) {
+            if ( threads ) ThreadPool::initSharedPool ( threads );
+            LibopenjpegImage* image = open();
+            compareLines ( image, 0 );
+
+            std::vector<uint8_t> line ( WIDTH * CHANNELS );
+            image->getline ( &line[0], HEIGHT - 1 );
+            for ( int c = 0; c < CHANNELS; c++ ) {
+                CPPUNIT_ASSERT_EQUAL ( sampleValue ( WIDTH - 1, HEIGHT - 1, c ), ( int ) line[ ( WIDTH - 1 ) * CHANNELS + c] );
+            }
+            delete image;
+        }
+    }
+
+    // Dimensions, résolutions et emprise au niveau réduit : le dernier pixel réduit peut déborder de l'image pleine résolution
+    void reducedDimensions() {
+        LibopenjpegImage* image = open();
+        CPPUNIT_ASSERT ( ! image->reduceResolution ( 1.5, 1.5 ) );
+        CPPUNIT_ASSERT_EQUAL ( WIDTH, image->getWidth() );
+        delete image;
+
+        image = open();
+        CPPUNIT_ASSERT ( image->reduceResolution ( 2.5, 2.5 ) );
+        CPPUNIT_ASSERT_EQUAL ( 150, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( 102, image->getHeight() );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2., image->getResX(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2., image->getResY(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 1000., image->getXmin(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 1300., image->getXmax(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2000. + HEIGHT, image->getYmax(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2000. + HEIGHT - 204., image->getYmin(), 1e-9 );
+        // Une image déjà réduite ne l'est plus
+        CPPUNIT_ASSERT ( ! image->reduceResolution ( 8., 8. ) );
+        delete image;
+
+        image = open();
+        CPPUNIT_ASSERT ( image->reduceResolution ( 5., 5. ) );
+        CPPUNIT_ASSERT_EQUAL ( 75, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( 51, image->getHeight() );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 4., image->getResX(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2000. + HEIGHT - 204., image->getYmin(), 1e-9 );
+        delete image;
+
+        // Pas plus de niveaux réduits que n'en contient le codestream
+        image = open();
+        CPPUNIT_ASSERT ( image->reduceResolution ( 100., 100. ) );
+        CPPUNIT_ASSERT_EQUAL ( ( WIDTH + 7 ) / 8, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( ( HEIGHT + 7 ) / 8, image->getHeight() );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 8., image->getResX(), 1e-9 );
+        delete image;
+    }
+
+    // Au niveau réduit, les bandes sont celles du décodage complet au même niveau
+    void reducedAsFullDecode() {
+        for ( int reduce = 1; reduce < RESOLUTIONS; reduce++ ) {
+            LibopenjpegImage* image = open();
+            double res = 1 << reduce;
+            CPPUNIT_ASSERT ( image->reduceResolution ( res, res ) );
+            compareLines ( image, reduce );
+            delete image;
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitLibopenjpegImage );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitLibopenjpegImage, "CppUnitLibopenjpegImage" );
+
+#endif
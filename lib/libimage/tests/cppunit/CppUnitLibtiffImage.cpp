@@ -0,0 +1,371 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "LibtiffImage.h"
+#include "ThreadPool.h"
+#include "tiffio.h"
+#include <unistd.h>
+#include <string.h>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+// Image pleine résolution : 300 x 200, tuiles de 64, la dernière colonne et la dernière ligne de tuiles sont partielles
+static const int WIDTH = 300;
+static const int HEIGHT = 200;
+static const int TILE = 64;
+static const int CHANNELS = 3;
+
+/**
+ * Valeur synthétique d'un échantillon, différente pour chaque niveau de résolution
+ */
+static uint8_t sampleValue ( int level, int x, int y, int c ) {
+    return ( uint8_t ) ( ( x * ( 3 + c ) + y * 7 + level * 50 + ( ( x * 13 + y * 5 ) % 11 ) ) & 0xFF );
+}
+
+/**
+ * Pixel 1 bit synthétique
+ */
+static bool bitValue ( int x, int y ) {
+    return ( ( x / 3 + y / 5 ) % 2 ) == ( ( x * y ) % 7 == 0 ? 0 : 1 );
+}
+
+class CppUnitLibtiffImage : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitLibtiffImage );
+    CPPUNIT_TEST ( tiledAsStriped );
+    CPPUNIT_TEST ( overviews );
+    CPPUNIT_TEST ( lruEviction );
+    CPPUNIT_TEST ( oneBitTiled );
+    CPPUNIT_TEST ( readArea );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    std::vector<std::string> files;
+
+public:
+
+    void setUp() {
+        ThreadPool::cleanSharedPool();
+    }
+
+    void tearDown() {
+        ThreadPool::cleanSharedPool();
+        for ( size_t i = 0; i < files.size(); i++ ) unlink ( files.at(i).c_str() );
+        files.clear();
+    }
+
+protected:
+
+    std::string path ( std::string name ) {
+        std::ostringstream oss;
+        oss << "/tmp/CppUnitLibtiffImage_" << getpid() << "_" << name << ".tif";
+        files.push_back ( oss.str() );
+        return oss.str();
+    }
+
+    // Écrit le répertoire courant, tuilé ou en strips, avec les échantillons du niveau donné
+    void writeDirectory ( TIFF* tif, int level, int width, int height, bool tiled ) {
+        TIFFSetField ( tif, TIFFTAG_IMAGEWIDTH, width );
+        TIFFSetField ( tif, TIFFTAG_IMAGELENGTH, height );
+        TIFFSetField ( tif, TIFFTAG_BITSPERSAMPLE, 8 );
+        TIFFSetField ( tif, TIFFTAG_SAMPLESPERPIXEL, CHANNELS );
+        TIFFSetField ( tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB );
+        TIFFSetField ( tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG );
+        TIFFSetField ( tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE );
+        if ( level > 0 ) TIFFSetField ( tif, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE );
+
+        if ( tiled ) {
+            TIFFSetField ( tif, TIFFTAG_TILEWIDTH, TILE );
+            TIFFSetField ( tif, TIFFTAG_TILELENGTH, TILE );
+            std::vector<uint8_t> tile ( TILE * TILE * CHANNELS );
+            for ( int ty = 0; ty < height; ty += TILE ) {
+                for ( int tx = 0; tx < width; tx += TILE ) {
+                    for ( int y = 0; y < TILE; y++ ) {
+                        for ( int x = 0; x < TILE; x++ ) {
+                            for ( int c = 0; c < CHANNELS; c++ ) {
+                                // Hors de l'image, la tuile est remplie avec une valeur qui ne doit jamais être lue
+                                bool inside = ( tx + x < width && ty + y < height );
+                                tile[ ( y * TILE + x ) * CHANNELS + c ] = inside ? sampleValue ( level, tx + x, ty + y, c ) : 77;
+                            }
+                        }
+                    }
+                    CPPUNIT_ASSERT ( TIFFWriteTile ( tif, &tile[0], tx, ty, 0, 0 ) >= 0 );
+                }
+            }
+        } else {
+            TIFFSetField ( tif, TIFFTAG_ROWSPERSTRIP, 16 );
+            std::vector<uint8_t> line ( width * CHANNELS );
+            for ( int y = 0; y < height; y++ ) {
+                for ( int x = 0; x < width; x++ ) {
+                    for ( int c = 0; c < CHANNELS; c++ ) line[x * CHANNELS + c] = sampleValue ( level, x, y, c );
+                }
+                CPPUNIT_ASSERT ( TIFFWriteScanline ( tif, &line[0], y, 0 ) >= 0 );
+            }
+        }
+        CPPUNIT_ASSERT ( TIFFWriteDirectory ( tif ) );
+    }
+
+    // Image et ses deux vues d'ensemble (150 x 100 et 75 x 50)
+    std::string writePyramid ( std::string name, bool tiled ) {
+        std::string file = path ( name );
+        TIFF* tif = TIFFOpen ( file.c_str(), "w" );
+        CPPUNIT_ASSERT ( tif != NULL );
+        writeDirectory ( tif, 0, WIDTH, HEIGHT, tiled );
+        writeDirectory ( tif, 1, WIDTH / 2, HEIGHT / 2, tiled );
+        writeDirectory ( tif, 2, WIDTH / 4, HEIGHT / 4, tiled );
+        TIFFClose ( tif );
+        return file;
+    }
+
+    // Un seul niveau, stocké en strips : référence d'un niveau donné
+    std::string writeLevel ( std::string name, int level, int width, int height ) {
+        std::string file = path ( name );
+        TIFF* tif = TIFFOpen ( file.c_str(), "w" );
+        CPPUNIT_ASSERT ( tif != NULL );
+        writeDirectory ( tif, level, width, height, false );
+        TIFFClose ( tif );
+        return file;
+    }
+
+    LibtiffImage* open ( std::string file ) {
+        LibtiffImageFactory LTIF;
+        LibtiffImage* image = LTIF.createLibtiffImageToRead ( ( char* ) file.c_str(), BoundingBox<double> ( 0., 0., WIDTH, HEIGHT ), 1., 1. );
+        CPPUNIT_ASSERT ( image != NULL );
+        return image;
+    }
+
+    // Compare toutes les lignes de deux images, dans un ordre non séquentiel
+    void compareLines ( LibtiffImage* image, LibtiffImage* reference ) {
+        CPPUNIT_ASSERT_EQUAL ( reference->getWidth(), image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( reference->getHeight(), image->getHeight() );
+        int size = image->getWidth() * image->getChannels();
+        std::vector<uint8_t> a ( size ), b ( size );
+        for ( int i = 0; i < image->getHeight(); i++ ) {
+            int l = ( i * 37 ) % image->getHeight();
+            CPPUNIT_ASSERT_EQUAL ( size, image->getline ( &a[0], l ) );
+            CPPUNIT_ASSERT_EQUAL ( size, reference->getline ( &b[0], l ) );
+            CPPUNIT_ASSERT_MESSAGE ( "line differs", memcmp ( &a[0], &b[0], size ) == 0 );
+        }
+    }
+
+    // Les lignes d'une image tuilée, lues à travers le cache des tuiles, sont celles de sa copie en strips, avec ou sans décodage parallèle
+    void tiledAsStriped() {
+        std::string tiledFile = writePyramid ( "tiled", true );
+        std::string stripedFile = writePyramid ( "striped", false );
+
+        for ( int threads = 0; threads <= 4; threads += 4 ) {
+            if ( threads ) ThreadPool::initSharedPool ( threads );
+            LibtiffImage* tiled = open ( tiledFile );
+            LibtiffImage* striped = open ( stripedFile );
+            compareLines ( tiled, striped );
+
+            // Dernière colonne de tuiles partielle : le dernier pixel est celui de l'image, pas le remplissage de la tuile
+            std::vector<uint8_t> line ( WIDTH * CHANNELS );
+            tiled->getline ( &line[0], HEIGHT - 1 );
+            for ( int c = 0; c < CHANNELS; c++ ) {
+                CPPUNIT_ASSERT_EQUAL ( ( int ) sampleValue ( 0, WIDTH - 1, HEIGHT - 1, c ), ( int ) line[ ( WIDTH - 1 ) * CHANNELS + c ] );
+            }
+            delete tiled;
+            delete striped;
+        }
+    }
+
+    // Le répertoire lu est la vue d'ensemble la plus grossière restant aussi fine que la résolution demandée
+    void overviews() {
+        std::string tiledFile = writePyramid ( "tiled", true );
+        std::string level1 = writeLevel ( "level1", 1, WIDTH / 2, HEIGHT / 2 );
+        std::string level2 = writeLevel ( "level2", 2, WIDTH / 4, HEIGHT / 4 );
+
+        // Résolution demandée plus fine que la première vue d'ensemble : pleine résolution
+        LibtiffImage* image = open ( tiledFile );
+        CPPUNIT_ASSERT ( ! image->reduceResolution ( 1.5, 1.5 ) );
+        CPPUNIT_ASSERT_EQUAL ( WIDTH, image->getWidth() );
+        delete image;
+
+        // Entre les deux vues d'ensemble : la première
+        image = open ( tiledFile );
+        CPPUNIT_ASSERT ( image->reduceResolution ( 3., 3. ) );
+        CPPUNIT_ASSERT_EQUAL ( WIDTH / 2, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( HEIGHT / 2, image->getHeight() );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2., image->getResX(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2., image->getResY(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( ( double ) WIDTH, image->getXmax(), 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( ( double ) HEIGHT, image->getYmax(), 1e-9 );
+        LibtiffImageFactory LTIF;
+        LibtiffImage* reference = LTIF.createLibtiffImageToRead ( ( char* ) level1.c_str(), BoundingBox<double> ( 0., 0., WIDTH, HEIGHT ), 2., 2. );
+        compareLines ( image, reference );
+        // Une fois lue, l'image n'est plus réduite
+        CPPUNIT_ASSERT ( ! image->reduceResolution ( 4., 4. ) );
+        delete reference;
+        delete image;
+
+        // Plus grossière que toutes les vues d'ensemble : la dernière
+        image = open ( tiledFile );
+        CPPUNIT_ASSERT ( image->reduceResolution ( 10., 10. ) );
+        CPPUNIT_ASSERT_EQUAL ( WIDTH / 4, image->getWidth() );
+        reference = LTIF.createLibtiffImageToRead ( ( char* ) level2.c_str(), BoundingBox<double> ( 0., 0., WIDTH, HEIGHT ), 4., 4. );
+        compareLines ( image, reference );
+        delete reference;
+        delete image;
+    }
+
+    // Le cache garde deux lignes de tuiles, et remplace la moins récemment utilisée
+    void lruEviction() {
+        std::string tiledFile = writePyramid ( "tiled", true );
+        LibtiffImage* image = open ( tiledFile );
+        int tilesPerRow = ( WIDTH + TILE - 1 ) / TILE;
+        std::vector<uint8_t> line ( WIDTH * CHANNELS );
+
+        image->getline ( &line[0], 0 );
+        CPPUNIT_ASSERT_EQUAL ( ( unsigned long ) tilesPerRow, image->getDecodedTiles() );
+        image->getline ( &line[0], TILE );
+        CPPUNIT_ASSERT_EQUAL ( ( unsigned long ) 2 * tilesPerRow, image->getDecodedTiles() );
+        // Retour sur la première ligne de tuiles : déjà dans le cache
+        image->getline ( &line[0], 5 );
+        CPPUNIT_ASSERT_EQUAL ( ( unsigned long ) 2 * tilesPerRow, image->getDecodedTiles() );
+        // Troisième ligne de tuiles : elle remplace la deuxième, moins récemment utilisée
+        image->getline ( &line[0], 2 * TILE );
+        CPPUNIT_ASSERT_EQUAL ( ( unsigned long ) 3 * tilesPerRow, image->getDecodedTiles() );
+        image->getline ( &line[0], 10 );
+        CPPUNIT_ASSERT_EQUAL ( ( unsigned long ) 3 * tilesPerRow, image->getDecodedTiles() );
+        image->getline ( &line[0], TILE + 1 );
+        CPPUNIT_ASSERT_EQUAL ( ( unsigned long ) 4 * tilesPerRow, image->getDecodedTiles() );
+        for ( int c = 0; c < CHANNELS; c++ ) {
+            CPPUNIT_ASSERT_EQUAL ( ( int ) sampleValue ( 0, 130, TILE + 1, c ), ( int ) line[130 * CHANNELS + c] );
+        }
+        delete image;
+    }
+
+    // Image 1 bit tuilée, convertie sur 8 bits à la lecture comme sa copie en strips
+    void oneBitTiled() {
+        const int width = 200, height = 90;
+        std::string tiledFile = path ( "bit_tiled" );
+        std::string stripedFile = path ( "bit_striped" );
+
+        for ( int t = 0; t < 2; t++ ) {
+            TIFF* tif = TIFFOpen ( ( t ? stripedFile : tiledFile ).c_str(), "w" );
+            CPPUNIT_ASSERT ( tif != NULL );
+            TIFFSetField ( tif, TIFFTAG_IMAGEWIDTH, width );
+            TIFFSetField ( tif, TIFFTAG_IMAGELENGTH, height );
+            TIFFSetField ( tif, TIFFTAG_BITSPERSAMPLE, 1 );
+            TIFFSetField ( tif, TIFFTAG_SAMPLESPERPIXEL, 1 );
+            TIFFSetField ( tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISWHITE );
+            TIFFSetField ( tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG );
+            TIFFSetField ( tif, TIFFTAG_COMPRESSION, COMPRESSION_PACKBITS );
+            if ( t == 0 ) {
+                TIFFSetField ( tif, TIFFTAG_TILEWIDTH, TILE );
+                TIFFSetField ( tif, TIFFTAG_TILELENGTH, TILE );
+                std::vector<uint8_t> tile ( TILE * TILE / 8 );
+                for ( int ty = 0; ty < height; ty += TILE ) {
+                    for ( int tx = 0; tx < width; tx += TILE ) {
+                        std::fill ( tile.begin(), tile.end(), 0 );
+                        for ( int y = 0; y < TILE; y++ ) {
+                            for ( int x = 0; x < TILE; x++ ) {
+                                if ( tx + x < width && ty + y < height && bitValue ( tx + x, ty + y ) ) tile[ ( y * TILE + x ) / 8] |= 0x80 >> ( x % 8 );
+                            }
+                        }
+                        CPPUNIT_ASSERT ( TIFFWriteTile ( tif, &tile[0], tx, ty, 0, 0 ) >= 0 );
+                    }
+                }
+            } else {
+                TIFFSetField ( tif, TIFFTAG_ROWSPERSTRIP, 16 );
+                std::vector<uint8_t> line ( width / 8 );
+                for ( int y = 0; y < height; y++ ) {
+                    std::fill ( line.begin(), line.end(), 0 );
+                    for ( int x = 0; x < width; x++ ) {
+                        if ( bitValue ( x, y ) ) line[x / 8] |= 0x80 >> ( x % 8 );
+                    }
+                    CPPUNIT_ASSERT ( TIFFWriteScanline ( tif, &line[0], y, 0 ) >= 0 );
+                }
+            }
+            TIFFClose ( tif );
+        }
+
+        LibtiffImageFactory LTIF;
+        LibtiffImage* tiled = LTIF.createLibtiffImageToRead ( ( char* ) tiledFile.c_str(), BoundingBox<double> ( 0., 0., width, height ), 1., 1. );
+        LibtiffImage* striped = LTIF.createLibtiffImageToRead ( ( char* ) stripedFile.c_str(), BoundingBox<double> ( 0., 0., width, height ), 1., 1. );
+        CPPUNIT_ASSERT ( tiled != NULL && striped != NULL );
+        CPPUNIT_ASSERT_EQUAL ( 8, tiled->getBitsPerSample() );
+        compareLines ( tiled, striped );
+
+        // En min-is-white, un bit à 1 est noir
+        std::vector<uint8_t> line ( width );
+        tiled->getline ( &line[0], height - 1 );
+        for ( int x = 0; x < width; x++ ) {
+            CPPUNIT_ASSERT_EQUAL ( bitValue ( x, height - 1 ) ? 0 : 255, ( int ) line[x] );
+        }
+        delete tiled;
+        delete striped;
+    }
+
+    // Seules les colonnes de tuiles couvrant l'emprise utile sont décodées
+    void readArea() {
+        std::string tiledFile = writePyramid ( "tiled", true );
+        std::string stripedFile = writeLevel ( "level0", 0, WIDTH, HEIGHT );
+        LibtiffImage* image = open ( tiledFile );
+        LibtiffImage* reference = open ( stripedFile );
+
+        // Colonnes 70 à 129 : deuxième et troisième colonnes de tuiles
+        image->setReadArea ( BoundingBox<double> ( 70., 0., 130., HEIGHT ) );
+
+        int size = WIDTH * CHANNELS;
+        std::vector<uint8_t> a ( size ), b ( size );
+        for ( int l = 0; l < HEIGHT; l++ ) {
+            CPPUNIT_ASSERT_EQUAL ( size, image->getline ( &a[0], l ) );
+            reference->getline ( &b[0], l );
+            CPPUNIT_ASSERT ( memcmp ( &a[TILE * CHANNELS], &b[TILE * CHANNELS], 2 * TILE * CHANNELS ) == 0 );
+            CPPUNIT_ASSERT_EQUAL ( 0, ( int ) a[0] );
+            CPPUNIT_ASSERT_EQUAL ( 0, ( int ) a[size - 1] );
+        }
+        int tileRows = ( HEIGHT + TILE - 1 ) / TILE;
+        CPPUNIT_ASSERT_EQUAL ( ( unsigned long ) 2 * tileRows, image->getDecodedTiles() );
+        delete image;
+        delete reference;
+
+        // Emprise hors de l'image : rien n'est décodé
+        image = open ( tiledFile );
+        image->setReadArea ( BoundingBox<double> ( 400., 0., 500., HEIGHT ) );
+        image->getline ( &a[0], 0 );
+        CPPUNIT_ASSERT_EQUAL ( ( unsigned long ) 0, image->getDecodedTiles() );
+        delete image;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitLibtiffImage );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitLibtiffImage, "CppUnitLibtiffImage" );
@@ -87,24 +87,36 @@ protected:
         float w = 1.23;
         memset ( from, 0, sizeof ( from ) );
 
-        cerr << " -= Multiplications =-" << endl;
-        for ( int d1 = 0; d1 < 4; d1++ )
-            for ( int d2 = 0; d2 < 4; d2++ ) {
-                double t = chrono_mult ( to + d1, from + d2, w, length, nb_iteration );
-                cerr << t << "s : " << nb_iteration << " (x" << length << ") mult (aligned+" << d1 << ") -> (aligned+" << d2 << ")" << endl;
-            }
-        cerr << endl;
-
-        cerr << " -= Addition-Multiplications =-" << endl;
-        for ( int d1 = 0; d1 < 4; d1++ )
-            for ( int d2 = 0; d2 < 4; d2++ ) {
-                double t = chrono_add_mult ( to + d1, from + d2, w, length, nb_iteration );
-                cerr << t << "s : " << nb_iteration << " (x" << length << ") add_mult (aligned+" << d1 << ") -> (aligned+" << d2 << ")" << endl;
-            }
-        cerr << endl;
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            cerr << " -= Multiplications (" << Simd::getLevelName ( Simd::getLevel() ) << ") =-" << endl;
+            for ( int d1 = 0; d1 < 4; d1++ )
+                for ( int d2 = 0; d2 < 4; d2++ ) {
+                    double t = chrono_mult ( to + d1, from + d2, w, length, nb_iteration );
+                    cerr << t << "s : " << nb_iteration << " (x" << length << ") mult (aligned+" << d1 << ") -> (aligned+" << d2 << ")" << endl;
+                }
+            cerr << endl;
+
+            cerr << " -= Addition-Multiplications (" << Simd::getLevelName ( Simd::getLevel() ) << ") =-" << endl;
+            for ( int d1 = 0; d1 < 4; d1++ )
+                for ( int d2 = 0; d2 < 4; d2++ ) {
+                    double t = chrono_add_mult ( to + d1, from + d2, w, length, nb_iteration );
+                    cerr << t << "s : " << nb_iteration << " (x" << length << ") add_mult (aligned+" << d1 << ") -> (aligned+" << d2 << ")" << endl;
+                }
+            cerr << endl;
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
     }
 
     void test_mult() {
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            test_mult_level();
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+    }
+
+    void test_mult_level() {
         float from[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float to[2000]    __attribute__ ( ( aligned ( 32 ) ) );
         for ( int k = 0; k < 2000; k++ ) from[k] = k;
@@ -125,6 +137,14 @@ protected:
     }
 
     void test_add_mult() {
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            test_add_mult_level();
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+    }
+
+    void test_add_mult_level() {
         float from[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float to[2000]    __attribute__ ( ( aligned ( 32 ) ) );
         for ( int k = 0; k < 2000; k++ ) from[k] = float ( k );
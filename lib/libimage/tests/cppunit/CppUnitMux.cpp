@@ -59,46 +59,71 @@ public:
 protected:
 
     void performance() {
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            performance_level();
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+    }
+
+    void performance_level() {
         timeval BEGIN, NOW;
         int nb_iteration = 10000;
         int length = 1000;
+        const char* level = Simd::getLevelName ( Simd::getLevel() );
 
         float T1[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float T2[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float T3[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float T4[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float T[10000]  __attribute__ ( ( aligned ( 32 ) ) );
+        memset ( T1, 0, sizeof ( T1 ) );
+        memset ( T2, 0, sizeof ( T2 ) );
+        memset ( T3, 0, sizeof ( T3 ) );
+        memset ( T4, 0, sizeof ( T4 ) );
 
-        cerr << " -= Multiplex =-" << endl;
+        cerr << " -= Multiplex (" << level << ") =-" << endl;
 
         gettimeofday ( &BEGIN, NULL );
         for ( int i = 0; i < nb_iteration; i++ ) multiplex ( T, T1, T2, T3, T4, length );
         gettimeofday ( &NOW, NULL );
         double t = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
-        cerr << t << "s : " << nb_iteration << " (x" << length << ") multiplex (aligned)" << endl;
+        cerr << t << "s : " << nb_iteration << " (x" << length << ") multiplex (aligned), "
+             << nb_iteration * ( double ) length / t / 1000000. << " Mpixels/s" << endl;
         cerr << endl;
 
-        cerr << " -= Multiplex unaligned =-" << endl;
+        if ( Simd::getLevel() == Simd::SSE2 ) {
+            cerr << " -= Multiplex unaligned =-" << endl;
 
-        gettimeofday ( &BEGIN, NULL );
-        for ( int i = 0; i < nb_iteration; i++ ) multiplex_unaligned ( T, T1, T2+1, T3+2, T4+3, length );
-        gettimeofday ( &NOW, NULL );
-        t = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
-        cerr << t << "s : " << nb_iteration << " (x" << length << ") multiplex (aligned)" << endl;
-        cerr << endl;
+            gettimeofday ( &BEGIN, NULL );
+            for ( int i = 0; i < nb_iteration; i++ ) multiplex_unaligned ( T, T1, T2+1, T3+2, T4+3, length );
+            gettimeofday ( &NOW, NULL );
+            t = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+            cerr << t << "s : " << nb_iteration << " (x" << length << ") multiplex (aligned)" << endl;
+            cerr << endl;
+        }
 
-        cerr << " -= DeMultiplex =-" << endl;
+        cerr << " -= DeMultiplex (" << level << ") =-" << endl;
 
         gettimeofday ( &BEGIN, NULL );
         for ( int i = 0; i < nb_iteration; i++ ) demultiplex ( T1, T2, T3, T4, T, length );
         gettimeofday ( &NOW, NULL );
         t = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
-        cerr << t << "s : " << nb_iteration << " (x" << length << ") demultiplex (aligned)" << endl;
+        cerr << t << "s : " << nb_iteration << " (x" << length << ") demultiplex (aligned), "
+             << nb_iteration * ( double ) length / t / 1000000. << " Mpixels/s" << endl;
         cerr << endl;
 
     }
 
     void test_multiplex() {
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            test_multiplex_level();
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+    }
+
+    void test_multiplex_level() {
         float T1[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float T2[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float T3[2000]  __attribute__ ( ( aligned ( 32 ) ) );
@@ -129,6 +154,14 @@ protected:
     }
 
     void test_demultiplex() {
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            test_demultiplex_level();
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+    }
+
+    void test_demultiplex_level() {
         float T1[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float T2[2000]  __attribute__ ( ( aligned ( 32 ) ) );
         float T3[2000]  __attribute__ ( ( aligned ( 32 ) ) );
@@ -0,0 +1,267 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "Palette.h"
+#include "StyledImage.h"
+#include "Simd.h"
+#include <sys/time.h>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include <iostream>
+using namespace std;
+
+/**
+ * Image flottante en pente douce, comme un MNT
+ */
+class RampImage : public Image {
+public:
+    RampImage ( int width, int height ) : Image ( width, height, 1 ) {}
+
+    virtual int getline ( uint8_t* buffer, int line ) {
+        return 0;
+    }
+    virtual int getline ( uint16_t* buffer, int line ) {
+        return 0;
+    }
+    virtual int getline ( float* buffer, int line ) {
+        for ( int i = 0; i < width; i++ ) buffer[i] = 12.3456f * line + 3.21f * i + 0.37f * ( ( i * 7 + line * 13 ) % 11 );
+        return width;
+    }
+};
+
+class CppUnitPalette : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitPalette );
+    CPPUNIT_TEST ( integerExact );
+    CPPUNIT_TEST ( floatBounded );
+    CPPUNIT_TEST ( cutIntervals );
+    CPPUNIT_TEST ( outOfTable );
+    CPPUNIT_TEST ( styledImage );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    static uint32_t pack ( Colour c ) {
+        return ( uint32_t ) c.r | ( ( uint32_t ) c.g << 8 ) | ( ( uint32_t ) c.b << 16 ) | ( ( uint32_t ) ( uint8_t ) c.a << 24 );
+    }
+
+    // Palette continue de MNT, de 0 à 4000 m
+    Palette* demPalette() {
+        std::map<double, Colour> colours;
+        colours.insert ( std::pair<double, Colour> ( 0, Colour ( 0, 100, 0, 255 ) ) );
+        colours.insert ( std::pair<double, Colour> ( 500, Colour ( 120, 200, 60, 255 ) ) );
+        colours.insert ( std::pair<double, Colour> ( 1500, Colour ( 230, 220, 120, 200 ) ) );
+        colours.insert ( std::pair<double, Colour> ( 2500, Colour ( 150, 90, 40, 150 ) ) );
+        colours.insert ( std::pair<double, Colour> ( 4000, Colour ( 255, 255, 255, 100 ) ) );
+        return new Palette ( colours, true, true, false );
+    }
+
+    // Palette discrète dont les valeurs ne sont pas entières
+    Palette* classPalette() {
+        std::map<double, Colour> colours;
+        colours.insert ( std::pair<double, Colour> ( -0.5, Colour ( 10, 20, 30, 255 ) ) );
+        colours.insert ( std::pair<double, Colour> ( 0.1, Colour ( 200, 0, 0, 255 ) ) );
+        colours.insert ( std::pair<double, Colour> ( 0.3, Colour ( 0, 200, 0, 255 ) ) );
+        colours.insert ( std::pair<double, Colour> ( 17.25, Colour ( 0, 0, 200, 128 ) ) );
+        colours.insert ( std::pair<double, Colour> ( 1000.7, Colour ( 255, 255, 0, 0 ) ) );
+        return new Palette ( colours, false, false, false );
+    }
+
+    void checkExact ( Palette* p, const float* values, int n ) {
+        uint32_t colours[n];
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            p->lookup ( colours, values, n );
+            for ( int i = 0; i < n; i++ ) CPPUNIT_ASSERT_EQUAL ( pack ( p->getColour ( values[i] ) ), colours[i] );
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+    }
+
+    void integerExact() {
+        Palette* p = demPalette();
+        CPPUNIT_ASSERT ( p->getLUTSize() > 0 );
+        CPPUNIT_ASSERT ( p->getLUTStep() <= 1. );
+
+        // Données 16 bits : toutes les valeurs entières de la table, et au-delà
+        float values[5000];
+        for ( int i = 0; i < 5000; i++ ) values[i] = i - 500;
+        checkExact ( p, values, 5000 );
+        delete p;
+
+        p = classPalette();
+        checkExact ( p, values, 5000 );
+        delete p;
+    }
+
+    void floatBounded() {
+        Palette* p = demPalette();
+        CPPUNIT_ASSERT ( p->getLUTError() <= PALETTE_LUT_MAX_ERROR );
+        int bound = ( int ) std::ceil ( p->getLUTError() );
+
+        float values[4096];
+        uint32_t colours[4096];
+        for ( int i = 0; i < 4096; i++ ) values[i] = 4000. * double ( rand() ) / double ( RAND_MAX );
+
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            p->lookup ( colours, values, 4096 );
+            for ( int i = 0; i < 4096; i++ ) {
+                uint32_t exact = pack ( p->getColour ( values[i] ) );
+                for ( int c = 0; c < 4; c++ ) {
+                    int e = ( exact >> ( 8*c ) ) & 0xFF;
+                    int t = ( colours[i] >> ( 8*c ) ) & 0xFF;
+                    CPPUNIT_ASSERT ( std::abs ( e - t ) <= bound );
+                }
+            }
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+        delete p;
+    }
+
+    // Palette discrète : la classe doit être exacte, y compris juste autour des valeurs non entières
+    void cutIntervals() {
+        Palette* p = classPalette();
+        CPPUNIT_ASSERT_EQUAL ( 0., p->getLUTError() );
+
+        float keys[5] = { -0.5f, 0.1f, 0.3f, 17.25f, 1000.7f };
+        float values[4000];
+        int n = 0;
+        for ( int k = 0; k < 5; k++ ) {
+            float v = keys[k];
+            float below = keys[k], above = keys[k];
+            for ( int j = 0; j < 100; j++ ) {
+                below = nextafterf ( below, -1e9f );
+                above = nextafterf ( above, 1e9f );
+                values[n++] = below;
+                values[n++] = above;
+            }
+            values[n++] = v;
+        }
+        for ( ; n < 4000; n++ ) values[n] = -2. + 1004. * double ( rand() ) / double ( RAND_MAX );
+        checkExact ( p, values, 4000 );
+        delete p;
+    }
+
+    void outOfTable() {
+        Palette* p = demPalette();
+        float values[64];
+        for ( int i = 0; i < 64; i++ ) values[i] = 100.f * i;
+        values[3] = -99999.f;
+        values[17] = 1e9f;
+        values[40] = std::numeric_limits<float>::quiet_NaN();
+        values[63] = -1e30f;
+        checkExact ( p, values, 64 );
+        delete p;
+    }
+
+    void styledImage() {
+        Palette* p = demPalette();
+        StyledImage* styled = new StyledImage ( new RampImage ( 200, 10 ), 3, p );
+        RampImage ramp ( 200, 10 );
+        uint8_t rgb[600];
+        float values[200];
+        for ( int line = 0; line < 10; line++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 600, styled->getline ( rgb, line ) );
+            ramp.getline ( values, line );
+            uint32_t colours[200];
+            p->lookup ( colours, values, 200 );
+            for ( int i = 0; i < 200; i++ ) {
+                CPPUNIT_ASSERT_EQUAL ( ( int ) ( colours[i] & 0xFF ), ( int ) rgb[3*i] );
+                CPPUNIT_ASSERT_EQUAL ( ( int ) ( ( colours[i] >> 8 ) & 0xFF ), ( int ) rgb[3*i+1] );
+                CPPUNIT_ASSERT_EQUAL ( ( int ) ( ( colours[i] >> 16 ) & 0xFF ), ( int ) rgb[3*i+2] );
+            }
+        }
+        delete styled;
+        delete p;
+    }
+
+    double chrono ( timeval& BEGIN ) {
+        timeval NOW;
+        gettimeofday ( &NOW, NULL );
+        return NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+    }
+
+    void performance() {
+        int nb_tiles = 200;
+        Palette* p = demPalette();
+        uint8_t rgba[256*4];
+        float values[256];
+        timeval BEGIN;
+
+        cerr << " -= Palette : tuiles flottantes 256x256 colorisées =-" << endl;
+        cerr << "Table de " << p->getLUTSize() << " entrées, pas " << p->getLUTStep() << ", erreur maximale " << p->getLUTError() << endl;
+
+        // Ancienne méthode : getColour pour chaque pixel
+        RampImage ramp ( 256, 256 );
+        gettimeofday ( &BEGIN, NULL );
+        for ( int t = 0; t < nb_tiles; t++ ) {
+            for ( int line = 0; line < 256; line++ ) {
+                ramp.getline ( values, line );
+                for ( int i = 0; i < 256; i++ ) {
+                    Colour c = p->getColour ( values[i] );
+                    rgba[4*i] = c.r;
+                    rgba[4*i+1] = c.g;
+                    rgba[4*i+2] = c.b;
+                    rgba[4*i+3] = c.a;
+                }
+            }
+        }
+        double time = chrono ( BEGIN );
+        cerr << time << "s : " << nb_tiles << " tuiles, getColour : " << nb_tiles / time << " tuiles/s" << endl;
+
+        for ( int l = Simd::SSE2; l <= Simd::getSupportedLevel(); l++ ) {
+            Simd::setLevel ( ( Simd::Level ) l );
+            gettimeofday ( &BEGIN, NULL );
+            for ( int t = 0; t < nb_tiles; t++ ) {
+                StyledImage styled ( new RampImage ( 256, 256 ), 4, p );
+                for ( int line = 0; line < 256; line++ ) styled.getline ( rgba, line );
+            }
+            time = chrono ( BEGIN );
+            cerr << time << "s : " << nb_tiles << " tuiles, StyledImage (" << Simd::getLevelName ( Simd::getLevel() ) << ") : " << nb_tiles / time << " tuiles/s" << endl;
+        }
+        Simd::setLevel ( Simd::getSupportedLevel() );
+        cerr << endl;
+        delete p;
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitPalette );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitPalette, "CppUnitPalette" );
@@ -0,0 +1,235 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sys/time.h>
+#include <pthread.h>
+#include <string>
+#include "ProjCache.h"
+#include "BoundingBox.h"
+#include "Grid.h"
+#include "CRS.h"
+
+class CppUnitProjCache : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitProjCache );
+    CPPUNIT_TEST ( reuse );
+    CPPUNIT_TEST ( sameResults );
+    CPPUNIT_TEST ( invalidCode );
+    CPPUNIT_TEST ( sizeLimit );
+    CPPUNIT_TEST ( concurrency );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    static double chrono() {
+        struct timeval tv;
+        gettimeofday ( &tv, NULL );
+        return tv.tv_sec + tv.tv_usec / 1000000.;
+    }
+
+    static void* reprojectBboxes ( void* arg ) {
+        int* errors = ( int* ) arg;
+        for ( int i = 0; i < 200; i++ ) {
+            BoundingBox<double> bbox ( 2., 45., 3., 46. );
+            if ( bbox.reproject ( "epsg:4326", "epsg:3857", 16 ) != 0 ) ( *errors )++;
+            else if ( bbox.xmin < 222000. || bbox.xmin > 223000. ) ( *errors )++;
+        }
+        return NULL;
+    }
+
+public:
+
+    void setUp() {
+        ProjCache::setCacheSize ( PROJ_CACHE_DEFAULT_SIZE );
+        ProjCache::cleanCache();
+    }
+
+    void tearDown() {
+        ProjCache::setCacheSize ( PROJ_CACHE_DEFAULT_SIZE );
+        ProjCache::cleanCache();
+    }
+
+    void reuse() {
+        ProjCacheElement* p1 = ProjCache::acquire ( "epsg:4326", "epsg:3857" );
+        CPPUNIT_ASSERT ( p1 != NULL );
+        CPPUNIT_ASSERT ( p1->src != NULL && p1->dst != NULL );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, ProjCache::getMisses() );
+
+        // Utilisé par un autre thread : une seconde transformation est initialisée
+        ProjCacheElement* p2 = ProjCache::acquire ( "epsg:4326", "epsg:3857" );
+        CPPUNIT_ASSERT ( p2 != NULL && p2 != p1 );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 2, ProjCache::getMisses() );
+
+        ProjCache::release ( p1 );
+        ProjCache::release ( p2 );
+        CPPUNIT_ASSERT_EQUAL ( 2, ProjCache::getElementsNumber() );
+
+        ProjCacheElement* p3 = ProjCache::acquire ( "epsg:4326", "epsg:3857" );
+        CPPUNIT_ASSERT ( p3 == p1 || p3 == p2 );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, ProjCache::getHits() );
+        ProjCache::release ( p3 );
+
+        // Le sens de la transformation fait partie de la clé
+        ProjCacheElement* p4 = ProjCache::acquire ( "epsg:3857", "epsg:4326" );
+        CPPUNIT_ASSERT ( p4 != p1 && p4 != p2 );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 3, ProjCache::getMisses() );
+        ProjCache::release ( p4 );
+
+        // Système seul
+        ProjCacheElement* p5 = ProjCache::acquire ( "epsg:4326" );
+        CPPUNIT_ASSERT ( p5 != NULL && p5->dst == NULL );
+        CPPUNIT_ASSERT ( pj_is_latlong ( p5->src ) );
+        ProjCache::release ( p5 );
+
+        CPPUNIT_ASSERT ( ProjCache::warm ( "epsg:4326" ) );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 4, ProjCache::getMisses() );
+        CPPUNIT_ASSERT_EQUAL ( 4, ProjCache::getElementsNumber() );
+    }
+
+    void sameResults() {
+        BoundingBox<double> cached ( 600000., 6600000., 700000., 6700000. );
+        BoundingBox<double> fresh ( 600000., 6600000., 700000., 6700000. );
+
+        CPPUNIT_ASSERT ( ProjCache::warm ( "IGNF:LAMB93", "epsg:4326" ) );
+        CPPUNIT_ASSERT_EQUAL ( 0, cached.reproject ( "IGNF:LAMB93", "epsg:4326" ) );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, ProjCache::getHits() );
+
+        ProjCache::setCacheSize ( 0 );
+        CPPUNIT_ASSERT_EQUAL ( 0, fresh.reproject ( "IGNF:LAMB93", "epsg:4326" ) );
+        CPPUNIT_ASSERT_EQUAL ( 0, ProjCache::getElementsNumber() );
+
+        CPPUNIT_ASSERT_EQUAL ( fresh.xmin, cached.xmin );
+        CPPUNIT_ASSERT_EQUAL ( fresh.ymin, cached.ymin );
+        CPPUNIT_ASSERT_EQUAL ( fresh.xmax, cached.xmax );
+        CPPUNIT_ASSERT_EQUAL ( fresh.ymax, cached.ymax );
+
+        // Les grilles utilisent les mêmes transformations
+        ProjCache::setCacheSize ( PROJ_CACHE_DEFAULT_SIZE );
+        Grid g1 ( 64, 64, BoundingBox<double> ( 600000., 6600000., 700000., 6700000. ) );
+        Grid g2 ( 64, 64, BoundingBox<double> ( 600000., 6600000., 700000., 6700000. ) );
+        CPPUNIT_ASSERT ( g1.reproject ( "IGNF:LAMB93", "epsg:4326" ) );
+        CPPUNIT_ASSERT ( g2.reproject ( "IGNF:LAMB93", "epsg:4326" ) );
+        CPPUNIT_ASSERT_EQUAL ( g1.bbox.xmin, g2.bbox.xmin );
+        CPPUNIT_ASSERT_EQUAL ( g1.bbox.ymax, g2.bbox.ymax );
+        CPPUNIT_ASSERT_EQUAL ( 1, ProjCache::getElementsNumber() );
+    }
+
+    void invalidCode() {
+        CPPUNIT_ASSERT ( ProjCache::acquire ( "epsg:4326", "ESPG:3857", false ) == NULL );
+        CPPUNIT_ASSERT ( ! ProjCache::warm ( "ESPG:3857" ) );
+        CPPUNIT_ASSERT_EQUAL ( 0, ProjCache::getElementsNumber() );
+
+        BoundingBox<double> bbox ( 2., 45., 3., 46. );
+        CPPUNIT_ASSERT_EQUAL ( 1, bbox.reproject ( "epsg:4326", "ESPG:3857" ) );
+        CPPUNIT_ASSERT_EQUAL ( 2., bbox.xmin );
+
+        CRS crs ( "ESPG:3857" );
+        CPPUNIT_ASSERT ( ! crs.isProj4Compatible() );
+    }
+
+    void sizeLimit() {
+        ProjCache::setCacheSize ( 2 );
+        CPPUNIT_ASSERT ( ProjCache::warm ( "epsg:4326" ) );
+        CPPUNIT_ASSERT ( ProjCache::warm ( "epsg:3857" ) );
+        CPPUNIT_ASSERT ( ProjCache::warm ( "epsg:2154" ) );
+        CPPUNIT_ASSERT_EQUAL ( 2, ProjCache::getElementsNumber() );
+
+        // Le plus ancien a été supprimé
+        ProjCacheElement* p = ProjCache::acquire ( "epsg:4326" );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 0, ProjCache::getHits() );
+        ProjCache::release ( p );
+        p = ProjCache::acquire ( "epsg:2154" );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, ProjCache::getHits() );
+        ProjCache::release ( p );
+
+        ProjCache::setCacheSize ( 1 );
+        CPPUNIT_ASSERT_EQUAL ( 1, ProjCache::getElementsNumber() );
+    }
+
+    void concurrency() {
+        int nbThreads = 8;
+        pthread_t threads[8];
+        int errors[8];
+        for ( int i = 0; i < nbThreads; i++ ) {
+            errors[i] = 0;
+            pthread_create ( &threads[i], NULL, reprojectBboxes, &errors[i] );
+        }
+        for ( int i = 0; i < nbThreads; i++ ) {
+            pthread_join ( threads[i], NULL );
+            CPPUNIT_ASSERT_EQUAL ( 0, errors[i] );
+        }
+        CPPUNIT_ASSERT ( ProjCache::getElementsNumber() <= nbThreads );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) nbThreads * 200, ProjCache::getHits() + ProjCache::getMisses() );
+    }
+
+    double setupCost ( int nb ) {
+        // Préparation des reprojections d'une requête WMS : CRS demandé, transformations vers la géographie et vers la pyramide
+        double t = chrono();
+        for ( int i = 0; i < nb; i++ ) {
+            CRS crs ( "EPSG:3857" );
+            ProjCacheElement* toGeo = ProjCache::acquire ( crs.getProj4Code(), "epsg:4326" );
+            ProjCacheElement* toPyr = ProjCache::acquire ( crs.getProj4Code(), "IGNF:LAMB93" );
+            CPPUNIT_ASSERT ( toGeo != NULL && toPyr != NULL );
+            ProjCache::release ( toGeo );
+            ProjCache::release ( toPyr );
+        }
+        return ( chrono() - t ) / nb;
+    }
+
+    void performance() {
+        int nb = 500;
+
+        ProjCache::setCacheSize ( 0 );
+        double tWithout = setupCost ( nb );
+
+        ProjCache::setCacheSize ( PROJ_CACHE_DEFAULT_SIZE );
+        CPPUNIT_ASSERT ( ProjCache::warm ( "epsg:3857" ) );
+        CPPUNIT_ASSERT ( ProjCache::warm ( "epsg:3857", "epsg:4326" ) );
+        CPPUNIT_ASSERT ( ProjCache::warm ( "epsg:3857", "IGNF:LAMB93" ) );
+        double tWith = setupCost ( nb );
+
+        std::cerr << std::endl << "Preparation des reprojections d'une requete : "
+                  << tWithout * 1000000 << " us sans cache, " << tWith * 1000000 << " us avec cache" << std::endl;
+
+        CPPUNIT_ASSERT ( tWith < tWithout );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitProjCache );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitProjCache, "CppUnitProjCache" );
@@ -0,0 +1,290 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "Rok4Image.h"
+#include "FileContext.h"
+#include "ThreadPool.h"
+#include <sys/time.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+#include <iostream>
+using namespace std;
+
+/**
+ * Image synthétique : dégradés et motifs, compressible mais pas triviale
+ */
+class PatternImage : public Image {
+public:
+    PatternImage ( int width, int height, int channels ) : Image ( width, height, channels ) {}
+
+    virtual int getline ( uint8_t* buffer, int line ) {
+        for ( int i = 0; i < width * channels; i++ ) {
+            int x = i / channels;
+            buffer[i] = ( uint8_t ) ( ( x * ( 1 + i % channels ) + line * 3 + ( ( x * 7 + line * 13 ) % 17 ) * ( ( x / 64 + line / 64 ) % 3 ) ) & 0xFF );
+        }
+        return width * channels;
+    }
+    virtual int getline ( uint16_t* buffer, int line ) {
+        return 0;
+    }
+    virtual int getline ( float* buffer, int line ) {
+        for ( int i = 0; i < width * channels; i++ ) buffer[i] = 100.f + 0.37f * ( i / channels ) - 1.3f * line + ( ( i * 7 + line * 13 ) % 5 );
+        return width * channels;
+    }
+};
+
+class CppUnitRok4Image : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitRok4Image );
+    CPPUNIT_TEST ( parallelIdentical );
+    CPPUNIT_TEST ( singleTile );
+    CPPUNIT_TEST ( parallelRead );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST ( readPerformance );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    FileContext* context;
+
+public:
+
+    void setUp() {
+        context = new FileContext ( "" );
+        context->connection();
+        ThreadPool::cleanSharedPool();
+    }
+
+    void tearDown() {
+        ThreadPool::cleanSharedPool();
+        delete context;
+    }
+
+protected:
+
+    std::string path ( std::string name ) {
+        std::ostringstream oss;
+        oss << "/tmp/CppUnitRok4Image_" << getpid() << "_" << name << ".tif";
+        return oss.str();
+    }
+
+    std::string content ( std::string file ) {
+        std::ifstream ifs ( file.c_str(), std::ios::binary );
+        std::ostringstream oss;
+        oss << ifs.rdbuf();
+        return oss.str();
+    }
+
+    bool write ( std::string file, Image* source, SampleFormat::eSampleFormat sf, int bps, Photometric::ePhotometric ph, Compression::eCompression compression, int tileSize, bool crop = false ) {
+        Rok4ImageFactory R4IF;
+        Rok4Image* image = R4IF.createRok4ImageToWrite (
+            file, BoundingBox<double> ( 0.,0.,0.,0. ), -1, -1, source->getWidth(), source->getHeight(), source->getChannels(),
+            sf, bps, ph, compression, tileSize, tileSize, context
+        );
+        if ( image == NULL ) return false;
+        bool ok = ( image->writeImage ( source, crop ) == 0 );
+        delete image;
+        return ok;
+    }
+
+    // Écriture séquentielle puis avec 4 threads : les fichiers doivent être identiques
+    void compare ( std::string name, int channels, SampleFormat::eSampleFormat sf, int bps, Photometric::ePhotometric ph, Compression::eCompression compression, bool crop = false ) {
+        PatternImage source ( 1024, 768, channels );
+        std::string seq = path ( name + "_seq" );
+        std::string par = path ( name + "_par" );
+
+        ThreadPool::cleanSharedPool();
+        CPPUNIT_ASSERT ( write ( seq, &source, sf, bps, ph, compression, 256, crop ) );
+        ThreadPool::initSharedPool ( 4 );
+        CPPUNIT_ASSERT ( write ( par, &source, sf, bps, ph, compression, 256, crop ) );
+        ThreadPool::cleanSharedPool();
+
+        std::string s = content ( seq );
+        CPPUNIT_ASSERT ( s.size() > ROK4_IMAGE_HEADER_SIZE );
+        CPPUNIT_ASSERT_MESSAGE ( name, s == content ( par ) );
+        unlink ( seq.c_str() );
+        unlink ( par.c_str() );
+    }
+
+    void parallelIdentical() {
+        compare ( "raw", 3, SampleFormat::UINT, 8, Photometric::RGB, Compression::NONE );
+        compare ( "lzw", 3, SampleFormat::UINT, 8, Photometric::RGB, Compression::LZW );
+        compare ( "pkb", 1, SampleFormat::UINT, 8, Photometric::GRAY, Compression::PACKBITS );
+        compare ( "zip", 4, SampleFormat::UINT, 8, Photometric::RGB, Compression::DEFLATE );
+        compare ( "png", 3, SampleFormat::UINT, 8, Photometric::RGB, Compression::PNG );
+        compare ( "jpg", 3, SampleFormat::UINT, 8, Photometric::RGB, Compression::JPEG );
+        compare ( "jpgcrop", 3, SampleFormat::UINT, 8, Photometric::RGB, Compression::JPEG, true );
+        compare ( "float", 1, SampleFormat::FLOAT, 32, Photometric::GRAY, Compression::DEFLATE );
+    }
+
+    void singleTile() {
+        PatternImage source ( 256, 256, 3 );
+        std::string seq = path ( "single_seq" );
+        std::string par = path ( "single_par" );
+        CPPUNIT_ASSERT ( write ( seq, &source, SampleFormat::UINT, 8, Photometric::RGB, Compression::PNG, 256 ) );
+        ThreadPool::initSharedPool ( 4 );
+        CPPUNIT_ASSERT ( write ( par, &source, SampleFormat::UINT, 8, Photometric::RGB, Compression::PNG, 256 ) );
+        CPPUNIT_ASSERT ( content ( seq ) == content ( par ) );
+        unlink ( seq.c_str() );
+        unlink ( par.c_str() );
+    }
+
+    // Relecture d'une dalle lignes à lignes, dans l'ordre ou non, avec ou sans décompression parallèle
+    void checkRead ( std::string file, Image* source, int threads, bool sequential, bool prefetch ) {
+        ThreadPool::cleanSharedPool();
+        if ( threads > 1 ) ThreadPool::initSharedPool ( threads );
+
+        Rok4ImageFactory R4IF;
+        Rok4Image* image = R4IF.createRok4ImageToRead ( file, BoundingBox<double> ( 0.,0.,0.,0. ), -1., -1., context );
+        CPPUNIT_ASSERT ( image != NULL );
+        image->setPrefetch ( prefetch );
+
+        int size = source->getWidth() * source->getChannels();
+        uint8_t expected[size];
+        uint8_t line[size];
+        for ( int k = 0; k < source->getHeight(); k++ ) {
+            int l = sequential ? k : ( k * 37 ) % source->getHeight();
+            source->getline ( expected, l );
+            CPPUNIT_ASSERT_EQUAL ( size, image->getline ( line, l ) );
+            CPPUNIT_ASSERT ( memcmp ( expected, line, size ) == 0 );
+        }
+
+        delete image;
+        ThreadPool::cleanSharedPool();
+    }
+
+    void parallelRead() {
+        PatternImage source ( 2048, 1024, 3 );
+        Compression::eCompression compressions[4] = { Compression::PNG, Compression::DEFLATE, Compression::PACKBITS, Compression::LZW };
+        std::string file = path ( "read" );
+
+        for ( int c = 0; c < 4; c++ ) {
+            CPPUNIT_ASSERT ( write ( file, &source, SampleFormat::UINT, 8, Photometric::RGB, compressions[c], 256 ) );
+            checkRead ( file, &source, 1, true, true );
+            checkRead ( file, &source, 4, true, true );
+            checkRead ( file, &source, 4, true, false );
+            checkRead ( file, &source, 4, false, true );
+        }
+
+        // Image détruite avant la fin de la lecture, préparation en cours
+        ThreadPool::initSharedPool ( 4 );
+        Rok4ImageFactory R4IF;
+        Rok4Image* image = R4IF.createRok4ImageToRead ( file, BoundingBox<double> ( 0.,0.,0.,0. ), -1., -1., context );
+        CPPUNIT_ASSERT ( image != NULL );
+        uint8_t line[2048*3];
+        image->getline ( line, 0 );
+        delete image;
+        ThreadPool::cleanSharedPool();
+
+        unlink ( file.c_str() );
+    }
+
+    double chrono ( timeval& BEGIN ) {
+        timeval NOW;
+        gettimeofday ( &NOW, NULL );
+        return NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+    }
+
+    void performance() {
+        int size = 4096;
+        // Au moins 4 threads, pour voir le surcoût sur une machine avec peu de coeurs
+        int maxThreads = std::max ( 4, ( int ) sysconf ( _SC_NPROCESSORS_ONLN ) );
+        Compression::eCompression compressions[3] = { Compression::JPEG, Compression::PNG, Compression::DEFLATE };
+        PatternImage source ( size, size, 3 );
+        std::string file = path ( "perf" );
+        timeval BEGIN;
+
+        cerr << " -= Rok4Image : écriture d'une dalle " << size << "x" << size << " RGB, tuiles 256x256 =-" << endl;
+        for ( int c = 0; c < 3; c++ ) {
+            double reference = 0;
+            for ( int threads = 1; threads <= maxThreads; threads *= 2 ) {
+                ThreadPool::cleanSharedPool();
+                if ( threads > 1 ) ThreadPool::initSharedPool ( threads );
+                gettimeofday ( &BEGIN, NULL );
+                write ( file, &source, SampleFormat::UINT, 8, Photometric::RGB, compressions[c], 256 );
+                double time = chrono ( BEGIN );
+                if ( threads == 1 ) reference = time;
+                cerr << time << "s : " << Compression::toString ( compressions[c] ) << ", " << threads << " thread(s) : accélération x" << reference / time << endl;
+            }
+        }
+        ThreadPool::cleanSharedPool();
+        unlink ( file.c_str() );
+        cerr << endl;
+    }
+
+    void readPerformance() {
+        int size = 4096;
+        int maxThreads = std::max ( 4, ( int ) sysconf ( _SC_NPROCESSORS_ONLN ) );
+        Compression::eCompression compressions[2] = { Compression::PNG, Compression::JPEG };
+        PatternImage source ( size, size, 3 );
+        std::string file = path ( "readperf" );
+        uint8_t* line = new uint8_t[size * 3];
+        timeval BEGIN;
+
+        cerr << " -= Rok4Image : lecture d'une dalle " << size << "x" << size << " RGB, tuiles 256x256 =-" << endl;
+        for ( int c = 0; c < 2; c++ ) {
+            ThreadPool::cleanSharedPool();
+            write ( file, &source, SampleFormat::UINT, 8, Photometric::RGB, compressions[c], 256 );
+            double reference = 0;
+            for ( int threads = 1; threads <= maxThreads; threads *= 2 ) {
+                ThreadPool::cleanSharedPool();
+                if ( threads > 1 ) ThreadPool::initSharedPool ( threads );
+                Rok4ImageFactory R4IF;
+                Rok4Image* image = R4IF.createRok4ImageToRead ( file, BoundingBox<double> ( 0.,0.,0.,0. ), -1., -1., context );
+                CPPUNIT_ASSERT ( image != NULL );
+                gettimeofday ( &BEGIN, NULL );
+                for ( int l = 0; l < size; l++ ) image->getline ( line, l );
+                double time = chrono ( BEGIN );
+                delete image;
+                if ( threads == 1 ) reference = time;
+                cerr << time << "s : " << Compression::toString ( compressions[c] ) << ", " << threads << " thread(s) : accélération x" << reference / time << endl;
+            }
+        }
+        ThreadPool::cleanSharedPool();
+        unlink ( file.c_str() );
+        delete[] line;
+        cerr << endl;
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRok4Image );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitRok4Image, "CppUnitRok4Image" );
@@ -0,0 +1,237 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "../../../../rok4version.h"
+
+#if BUILD_OBJECT
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "S3Context.h"
+#include "CurlPool.h"
+
+using namespace std;
+
+/**
+ * Serveur S3 simulé : répond à toute requête GET avec Range par les octets demandés (octet i = i % 251),
+ * après une latence fixe simulant le réseau. Les connexions sont conservées (keep-alive).
+ */
+static int mockPort = 0;
+static const int mockLatency = 2000; // microsecondes
+
+static void* mockConnection ( void* arg ) {
+    int sock = ( int ) ( intptr_t ) arg;
+    std::string buffer;
+    char tmp[4096];
+
+    while ( true ) {
+        size_t end = buffer.find ( "\r\n\r\n" );
+        if ( end == std::string::npos ) {
+            ssize_t n = recv ( sock, tmp, sizeof ( tmp ), 0 );
+            if ( n <= 0 ) break;
+            buffer.append ( tmp, n );
+            continue;
+        }
+
+        std::string request = buffer.substr ( 0, end );
+        buffer.erase ( 0, end + 4 );
+
+        int first = 0, last = 0;
+        size_t r = request.find ( "Range: bytes=" );
+        if ( r != std::string::npos ) sscanf ( request.c_str() + r + 13, "%d-%d", &first, &last );
+        int length = last - first + 1;
+
+        usleep ( mockLatency );
+
+        char header[256];
+        int hl = sprintf ( header, "HTTP/1.1 206 Partial Content\r\nContent-Length: %d\r\nContent-Type: application/octet-stream\r\n\r\n", length );
+        std::string response ( header, hl );
+        for ( int i = first; i <= last; i++ ) response.push_back ( ( char ) ( i % 251 ) );
+        send ( sock, response.data(), response.size(), 0 );
+    }
+
+    close ( sock );
+    return 0;
+}
+
+static void* mockServer ( void* arg ) {
+    int listener = ( int ) ( intptr_t ) arg;
+    while ( true ) {
+        int sock = accept ( listener, NULL, NULL );
+        if ( sock < 0 ) break;
+        pthread_t t;
+        pthread_create ( &t, NULL, mockConnection, ( void* ) ( intptr_t ) sock );
+        pthread_detach ( t );
+    }
+    return 0;
+}
+
+static void startMockServer() {
+    if ( mockPort != 0 ) return;
+
+    int listener = socket ( AF_INET, SOCK_STREAM, 0 );
+    struct sockaddr_in addr;
+    memset ( &addr, 0, sizeof ( addr ) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+    addr.sin_port = 0;
+    bind ( listener, ( struct sockaddr* ) &addr, sizeof ( addr ) );
+    listen ( listener, 128 );
+
+    socklen_t len = sizeof ( addr );
+    getsockname ( listener, ( struct sockaddr* ) &addr, &len );
+    mockPort = ntohs ( addr.sin_port );
+
+    pthread_t t;
+    pthread_create ( &t, NULL, mockServer, ( void* ) ( intptr_t ) listener );
+    pthread_detach ( t );
+
+    char url[64];
+    sprintf ( url, "http://127.0.0.1:%d", mockPort );
+    setenv ( ROK4_S3_URL, url, 1 );
+}
+
+class CppUnitS3Context : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitS3Context );
+    CPPUNIT_TEST ( syncRead );
+    CPPUNIT_TEST ( asyncReads );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    S3Context* context;
+
+    bool checkData ( uint8_t* data, int offset, int size ) {
+        for ( int i = 0; i < size; i++ ) {
+            if ( data[i] != ( uint8_t ) ( ( offset + i ) % 251 ) ) return false;
+        }
+        return true;
+    }
+
+    double chrono() {
+        struct timeval tv;
+        gettimeofday ( &tv, NULL );
+        return tv.tv_sec + tv.tv_usec / 1000000.;
+    }
+
+public:
+
+    void setUp() {
+        startMockServer();
+        context = new S3Context ( "bucket" );
+        context->connection();
+    }
+
+    void tearDown() {
+        delete context;
+    }
+
+    void syncRead() {
+        uint8_t data[1000];
+        CPPUNIT_ASSERT_EQUAL ( 1000, context->read ( data, 4096, 1000, "slab" ) );
+        CPPUNIT_ASSERT ( checkData ( data, 4096, 1000 ) );
+    }
+
+    void asyncReads() {
+        int nb = 64;
+        std::vector<ContextRead*> reads;
+        for ( int i = 0; i < nb; i++ ) {
+            reads.push_back ( new ContextRead ( new uint8_t[500 + i], i * 1000, 500 + i, "slab" ) );
+        }
+
+        context->submitReads ( reads );
+        context->waitReads ( reads );
+
+        for ( int i = 0; i < nb; i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 500 + i, reads.at ( i )->result );
+            CPPUNIT_ASSERT ( checkData ( reads.at ( i )->data, i * 1000, 500 + i ) );
+            CPPUNIT_ASSERT ( reads.at ( i )->pending == NULL );
+            delete[] reads.at ( i )->data;
+            delete reads.at ( i );
+        }
+    }
+
+    void performance() {
+        int nb = 256;
+        int size = 16384;
+        uint8_t* buffer = new uint8_t[nb * size];
+
+        double t = chrono();
+        for ( int i = 0; i < nb; i++ ) {
+            context->read ( buffer + i * size, i * size, size, "slab" );
+        }
+        double tSync = chrono() - t;
+
+        std::vector<ContextRead*> reads;
+        for ( int i = 0; i < nb; i++ ) {
+            reads.push_back ( new ContextRead ( buffer + i * size, i * size, size, "slab" ) );
+        }
+        t = chrono();
+        context->readAll ( reads );
+        double tAsync = chrono() - t;
+
+        for ( int i = 0; i < nb; i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( size, reads.at ( i )->result );
+            delete reads.at ( i );
+        }
+        CPPUNIT_ASSERT ( checkData ( buffer, 0, nb * size ) );
+        delete[] buffer;
+
+        cerr << " -= Lectures S3 (serveur simulé, latence " << mockLatency << " µs) =-" << endl;
+        cerr << tSync << "s : " << nb << " lectures de " << size << " octets une à une (" << nb * size / tSync / 1048576 << " Mo/s)" << endl;
+        cerr << tAsync << "s : " << nb << " lectures de " << size << " octets en un lot (" << nb * size / tAsync / 1048576 << " Mo/s)" << endl;
+        cerr << endl;
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitS3Context );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitS3Context, "CppUnitS3Context" );
+
+#endif
@@ -0,0 +1,313 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "EstompageImage.h"
+#include "PenteImage.h"
+#include "AspectImage.h"
+#include <sys/time.h>
+#include <cmath>
+#include <cstdlib>
+
+#include <iostream>
+using namespace std;
+
+#define NODATA -99999.f
+#define W 300
+#define H 200
+
+/**
+ * MNT synthétique : collines, bruit et quelques pixels de non-donnée
+ */
+class DemImage : public Image {
+public:
+    int reads;
+    bool withNoData;
+
+    DemImage ( int width, int height, bool withNoData = false ) : Image ( width, height, 1 ), reads ( 0 ), withNoData ( withNoData ) {}
+
+    virtual int getline ( uint8_t* buffer, int line ) {
+        return 0;
+    }
+    virtual int getline ( uint16_t* buffer, int line ) {
+        return 0;
+    }
+    virtual int getline ( float* buffer, int line ) {
+        reads++;
+        for ( int i = 0; i < width; i++ ) {
+            buffer[i] = 800.f + 300.f * sin ( i * 0.031 ) * cos ( line * 0.047 ) + 40.f * sin ( i * 0.23 + line * 0.11 ) + ( ( i * 7 + line * 13 ) % 5 );
+            if ( withNoData && ( i * 31 + line * 17 ) % 97 == 0 ) buffer[i] = NODATA;
+        }
+        return width;
+    }
+};
+
+class CppUnitTerrainImage : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitTerrainImage );
+    CPPUNIT_TEST ( arcTangent );
+    CPPUNIT_TEST ( estompage );
+    CPPUNIT_TEST ( pente );
+    CPPUNIT_TEST ( aspect );
+    CPPUNIT_TEST ( randomAccess );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    // Lecture des 3 lignes d'origine nécessaires à la ligne calculée
+    void window ( Image* dem, int line, float* l1, float* l2, float* l3 ) {
+        dem->getline ( l1, line );
+        dem->getline ( l2, line + 1 );
+        dem->getline ( l3, line + 2 );
+    }
+
+    // Calculs de référence, pixel par pixel, en double et avec la trigonométrie
+    uint8_t refEstompage ( float* l1, float* l2, float* l3, int col, float zenith, float azimuth, float zFactor, float resx, float resy ) {
+        float a = l1[col], b = l1[col+1], c = l1[col+2], d = l2[col], f = l2[col+2], g = l3[col], h = l3[col+1], i = l3[col+2];
+        float dzdx = ( ( c + 2*f + i ) - ( a + 2*d + g ) ) / ( 8 * resx );
+        float dzdy = ( ( g + 2*h + i ) - ( a + 2*b + c ) ) / ( 8 * resy );
+        float slope = atan ( zFactor * sqrt ( dzdx*dzdx+dzdy*dzdy ) );
+        float aspect;
+        if ( dzdx != 0 ) {
+            aspect = atan2 ( dzdy,-dzdx );
+            if ( aspect < 0 ) aspect = 2 * M_PI + aspect;
+        } else {
+            aspect = ( dzdy > 0 ) ? M_PI_2 : 2 * M_PI - M_PI_2;
+        }
+        double value = 255.0 * ( ( cos ( zenith ) * cos ( slope ) ) + ( sin ( zenith ) * sin ( slope ) * cos ( azimuth - aspect ) ) );
+        if ( value < 0 ) value = 0;
+        return ( int ) value;
+    }
+
+    uint8_t refPente ( float* l1, float* l2, float* l3, int col, float resX, float resY, std::string algo, std::string unit, int slopeNoData, int maxSlope ) {
+        float a = l1[col], b = l1[col+1], c = l1[col+2], d = l2[col], e = l2[col+1], f = l2[col+2], g = l3[col], h = l3[col+1], i = l3[col+2];
+        if ( a == NODATA || b == NODATA || c == NODATA || d == NODATA || e == NODATA || f == NODATA || g == NODATA || h == NODATA || i == NODATA )
+            return slopeNoData;
+        double dzdx, dzdy, slope;
+        if ( algo == "H" ) {
+            dzdx = ( ( c + 2.0 * f + i ) - ( a + 2.0 * d + g ) ) / ( 8.0 * resX );
+            dzdy = ( ( g + 2.0 * h + i ) - ( a + 2.0 * b + c ) ) / ( 8.0 * resY );
+        } else {
+            dzdx = ( f - d ) / ( 2.0 * resX );
+            dzdy = ( h - b ) / ( 2.0 * resY );
+        }
+        if ( unit == "pourcent" ) slope = sqrt ( dzdx*dzdx + dzdy*dzdy ) * 100.0;
+        else slope = atan ( sqrt ( dzdx*dzdx + dzdy*dzdy ) ) * 180.0 / M_PI;
+        if ( slope > maxSlope ) slope = maxSlope;
+        return ( int ) slope;
+    }
+
+    float refAspect ( float* l1, float* l2, float* l3, int col, float resolution, float minSlope ) {
+        double m1 = 1 / ( 8.0*resolution ), m2 = 2 / ( 8.0*resolution );
+        double value1 = m1 * l1[col+2] + m2 * l2[col+2] + m1 * l3[col+2] - m1 * l1[col] - m2 * l2[col] - m1 * l3[col];
+        double value2 = m1 * l1[col] + m2 * l1[col+1] + m1 * l1[col+2] - m1 * l3[col] - m2 * l3[col+1] - m1 * l3[col+2];
+        if ( sqrt ( value1*value1 + value2*value2 ) < minSlope ) return -1.0;
+        return ( atan2 ( value1,value2 ) + M_PI ) * 180 / M_PI;
+    }
+
+    void arcTangent() {
+        float x[1000], y[1000], to[1000];
+        for ( int i = 0; i < 1000; i++ ) {
+            x[i] = ( i - 500 ) * 0.0731f;
+            y[i] = ( ( i * 37 ) % 1000 - 500 ) * 0.0137f;
+        }
+        x[3] = 0.f;
+        y[3] = 0.f;
+        x[4] = 0.f;
+        y[5] = 0.f;
+        x[6] = 1e30f;
+
+        atan_ps ( to, x, 1000 );
+        for ( int i = 0; i < 1000; i++ ) CPPUNIT_ASSERT_DOUBLES_EQUAL ( atan ( x[i] ), to[i], 1e-6 );
+
+        atan2_ps ( to, y, x, 1000 );
+        CPPUNIT_ASSERT_EQUAL ( 0.f, to[3] );
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( i == 3 ) continue;
+            CPPUNIT_ASSERT_DOUBLES_EQUAL ( atan2 ( y[i], x[i] ), to[i], 1e-6 );
+        }
+    }
+
+    void estompage() {
+        float l1[W], l2[W], l3[W];
+        uint8_t line[W-2];
+        float zenith = 90.0 - 45 * M_PI / 180.;
+        float azimuth = ( 360.0 - 315 ) * M_PI / 180.;
+        DemImage dem ( W, H );
+        EstompageImage image ( W-2, H-2, 1, BoundingBox<double> ( 0, 0, W-2, H-2 ), new DemImage ( W, H ), 45, 315, 2.5, 5., 5. );
+
+        int diff = 0;
+        for ( int l = 0; l < H-2; l++ ) {
+            CPPUNIT_ASSERT_EQUAL ( W-2, image.getline ( line, l ) );
+            window ( &dem, l, l1, l2, l3 );
+            for ( int c = 0; c < W-2; c++ ) {
+                int ref = refEstompage ( l1, l2, l3, c, zenith, azimuth, 2.5, 5., 5. );
+                CPPUNIT_ASSERT ( abs ( ref - line[c] ) <= 1 );
+                if ( ref != line[c] ) diff++;
+            }
+        }
+        // Écarts uniquement sur les troncatures de valeurs quasi entières
+        CPPUNIT_ASSERT ( diff < ( W-2 ) * ( H-2 ) / 100 );
+    }
+
+    void pente() {
+        float l1[W], l2[W], l3[W];
+        uint8_t line[W-2];
+        DemImage dem ( W, H, true );
+        const char* algos[2] = { "H", "Z" };
+        const char* units[2] = { "degree", "pourcent" };
+
+        for ( int a = 0; a < 2; a++ ) {
+            for ( int u = 0; u < 2; u++ ) {
+                PenteImage image ( W-2, H-2, 1, BoundingBox<double> ( 0, 0, W-2, H-2 ), new DemImage ( W, H, true ), 5., 5., algos[a], units[u], 255, NODATA, 200 );
+                for ( int l = 0; l < H-2; l++ ) {
+                    image.getline ( line, l );
+                    window ( &dem, l, l1, l2, l3 );
+                    for ( int c = 0; c < W-2; c++ ) {
+                        int ref = refPente ( l1, l2, l3, c, 5., 5., algos[a], units[u], 255, 200 );
+                        if ( ref == 255 ) CPPUNIT_ASSERT_EQUAL ( 255, ( int ) line[c] );
+                        else CPPUNIT_ASSERT ( abs ( ref - line[c] ) <= 1 );
+                    }
+                }
+            }
+        }
+    }
+
+    void aspect() {
+        float l1[W], l2[W], l3[W];
+        float line[W-2];
+        uint8_t line8[W-2];
+        DemImage dem ( W, H );
+        AspectImage image ( W-2, H-2, 1, BoundingBox<double> ( 0, 0, W-2, H-2 ), new DemImage ( W, H ), 5., "H", 0.5 );
+
+        for ( int l = 0; l < H-2; l++ ) {
+            image.getline ( line, l );
+            image.getline ( line8, l );
+            window ( &dem, l, l1, l2, l3 );
+            for ( int c = 0; c < W-2; c++ ) {
+                float ref = refAspect ( l1, l2, l3, c, 5., 0.5 );
+                if ( ref == -1.0 ) {
+                    CPPUNIT_ASSERT_EQUAL ( -1.f, line[c] );
+                    continue;
+                }
+                double delta = fabs ( ref - line[c] );
+                if ( delta > 180 ) delta = 360 - delta;
+                CPPUNIT_ASSERT ( delta < 1e-2 );
+                // En 8 bits, l'exposition est arrondie et saturée
+                int expected = ( line[c] > 255 ) ? 255 : ( int ) ( line[c] + 0.5 );
+                CPPUNIT_ASSERT_EQUAL ( expected, ( int ) line8[c] );
+            }
+        }
+    }
+
+    void randomAccess() {
+        float sequential[H-2][W-2];
+        float line[W-2];
+        DemImage* dem = new DemImage ( W, H );
+        EstompageImage image ( W-2, H-2, 1, BoundingBox<double> ( 0, 0, W-2, H-2 ), dem, 45, 315, 2.5, 5., 5. );
+
+        // Lecture dans l'ordre : une seule ligne d'origine lue par ligne calculée
+        for ( int l = 0; l < H-2; l++ ) image.getline ( sequential[l], l );
+        CPPUNIT_ASSERT_EQUAL ( H, dem->reads );
+
+        // Relecture de la même ligne : rien n'est relu
+        image.getline ( line, H-3 );
+        CPPUNIT_ASSERT_EQUAL ( H, dem->reads );
+
+        // Lecture dans le désordre : même résultat
+        for ( int k = 0; k < H-2; k++ ) {
+            int l = ( k * 73 ) % ( H-2 );
+            image.getline ( line, l );
+            for ( int c = 0; c < W-2; c++ ) CPPUNIT_ASSERT_EQUAL ( sequential[l][c], line[c] );
+        }
+    }
+
+    double chrono ( timeval& BEGIN ) {
+        timeval NOW;
+        gettimeofday ( &NOW, NULL );
+        return NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+    }
+
+    void performance() {
+        int size = 2048;
+        float zenith = 90.0 - 45 * M_PI / 180.;
+        float azimuth = ( 360.0 - 315 ) * M_PI / 180.;
+        float* lines = new float[3 * ( size+2 )];
+        uint8_t* out = new uint8_t[size];
+        timeval BEGIN;
+
+        cerr << " -= Estompage, pente et exposition : MNT " << size << "x" << size << " =-" << endl;
+
+        // Ancienne méthode : trigonométrie en double pour chaque pixel
+        DemImage dem ( size+2, size+2 );
+        gettimeofday ( &BEGIN, NULL );
+        for ( int l = 0; l < size; l++ ) {
+            window ( &dem, l, lines, lines + size+2, lines + 2 * ( size+2 ) );
+            for ( int c = 0; c < size; c++ ) out[c] = refEstompage ( lines, lines + size+2, lines + 2 * ( size+2 ), c, zenith, azimuth, 2.5, 5., 5. );
+        }
+        double time = chrono ( BEGIN );
+        cerr << time << "s : estompage pixel par pixel : " << size / time << " lignes/s" << endl;
+
+        // Temps de lecture seul du MNT, commun à toutes les méthodes
+        gettimeofday ( &BEGIN, NULL );
+        for ( int l = 0; l < size+2; l++ ) dem.getline ( lines, l );
+        cerr << chrono ( BEGIN ) << "s : lecture du MNT" << endl;
+
+        Image* images[3];
+        const char* names[3] = { "estompage", "pente", "exposition" };
+        images[0] = new EstompageImage ( size, size, 1, BoundingBox<double> ( 0, 0, size, size ), new DemImage ( size+2, size+2 ), 45, 315, 2.5, 5., 5. );
+        images[1] = new PenteImage ( size, size, 1, BoundingBox<double> ( 0, 0, size, size ), new DemImage ( size+2, size+2 ), 5., 5., "H", "degree", 255, NODATA, 90 );
+        images[2] = new AspectImage ( size, size, 1, BoundingBox<double> ( 0, 0, size, size ), new DemImage ( size+2, size+2 ), 5., "H", 0.5 );
+        for ( int i = 0; i < 3; i++ ) {
+            gettimeofday ( &BEGIN, NULL );
+            images[i]->getline ( out, 0 );
+            double first = chrono ( BEGIN );
+            for ( int l = 1; l < size; l++ ) images[i]->getline ( out, l );
+            time = chrono ( BEGIN );
+            cerr << time << "s : " << names[i] << " en fenêtre glissante : " << size / time << " lignes/s, première ligne en " << first * 1000 << " ms" << endl;
+            delete images[i];
+        }
+        cerr << endl;
+
+        delete[] lines;
+        delete[] out;
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitTerrainImage );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitTerrainImage, "CppUnitTerrainImage" );
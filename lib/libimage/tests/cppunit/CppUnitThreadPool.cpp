@@ -0,0 +1,137 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <vector>
+#include "ThreadPool.h"
+
+class CountTask : public ThreadTask {
+public:
+    int* cells;
+    int index;
+    CountTask ( int* cells, int index ) : cells ( cells ), index ( index ) {}
+    void run() {
+        cells[index]++;
+    }
+};
+
+class NestedTask : public ThreadTask {
+public:
+    ThreadPool* pool;
+    int* cells;
+    int first;
+    NestedTask ( ThreadPool* pool, int* cells, int first ) : pool ( pool ), cells ( cells ), first ( first ) {}
+    void run() {
+        // Attente d'un ensemble depuis un thread du groupe : ne doit pas bloquer
+        ThreadTaskGroup group;
+        std::vector<CountTask*> tasks;
+        for ( int i = 0; i < 10; i++ ) {
+            tasks.push_back ( new CountTask ( cells, first + i ) );
+            pool->submit ( tasks.back(), &group );
+        }
+        pool->wait ( &group );
+        for ( int i = 0; i < tasks.size(); i++ ) delete tasks.at ( i );
+    }
+};
+
+class CppUnitThreadPool : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitThreadPool );
+    CPPUNIT_TEST ( allTasksRun );
+    CPPUNIT_TEST ( nestedWait );
+    CPPUNIT_TEST ( sharedPool );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+
+    void allTasksRun() {
+        ThreadPool pool ( 4 );
+        int cells[1000];
+        memset ( cells, 0, sizeof ( cells ) );
+
+        ThreadTaskGroup group;
+        std::vector<CountTask*> tasks;
+        for ( int i = 0; i < 1000; i++ ) {
+            tasks.push_back ( new CountTask ( cells, i ) );
+            pool.submit ( tasks.back(), &group );
+        }
+        pool.wait ( &group );
+
+        for ( int i = 0; i < 1000; i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 1, cells[i] );
+            delete tasks.at ( i );
+        }
+    }
+
+    void nestedWait() {
+        // Un seul thread : les tâches imbriquées sont exécutées par le thread qui attend
+        ThreadPool pool ( 1 );
+        int cells[40];
+        memset ( cells, 0, sizeof ( cells ) );
+
+        ThreadTaskGroup group;
+        std::vector<NestedTask*> tasks;
+        for ( int i = 0; i < 4; i++ ) {
+            tasks.push_back ( new NestedTask ( &pool, cells, i * 10 ) );
+            pool.submit ( tasks.back(), &group );
+        }
+        pool.wait ( &group );
+
+        for ( int i = 0; i < 40; i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 1, cells[i] );
+        }
+        for ( int i = 0; i < 4; i++ ) delete tasks.at ( i );
+    }
+
+    void sharedPool() {
+        CPPUNIT_ASSERT ( ThreadPool::getSharedPool() == NULL );
+        ThreadPool::initSharedPool ( 0 );
+        CPPUNIT_ASSERT ( ThreadPool::getSharedPool() == NULL );
+        ThreadPool::initSharedPool ( 3 );
+        CPPUNIT_ASSERT ( ThreadPool::getSharedPool() != NULL );
+        CPPUNIT_ASSERT_EQUAL ( 3, ThreadPool::getSharedPool()->getThreadsNumber() );
+        ThreadPool::initSharedPool ( 5 );
+        CPPUNIT_ASSERT_EQUAL ( 3, ThreadPool::getSharedPool()->getThreadsNumber() );
+        ThreadPool::cleanSharedPool();
+        CPPUNIT_ASSERT ( ThreadPool::getSharedPool() == NULL );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitThreadPool );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitThreadPool, "CppUnitThreadPool" );
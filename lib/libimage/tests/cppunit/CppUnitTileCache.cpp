@@ -0,0 +1,228 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <sstream>
+#include "TileCache.h"
+
+class CppUnitTileCache : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitTileCache );
+    CPPUNIT_TEST ( hitAndMiss );
+    CPPUNIT_TEST ( validators );
+    CPPUNIT_TEST ( memoryBudget );
+    CPPUNIT_TEST ( admission );
+    CPPUNIT_TEST ( validity );
+    CPPUNIT_TEST ( disabled );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    uint8_t tile[16384];
+
+    std::string key ( std::string level, int i ) {
+        std::ostringstream oss;
+        oss << "FILE::" << level << ":" << i << ":" << i;
+        return oss.str();
+    }
+
+    bool isCached ( std::string k ) {
+        DataSource* ds = TileCache::getTile ( k, "image/png", "" );
+        if ( ds == NULL ) return false;
+        delete ds;
+        return true;
+    }
+
+public:
+
+    void setUp() {
+        for ( int i = 0; i < 16384; i++ ) {
+            tile[i] = i % 251;
+        }
+        TileCache::cleanCache();
+        TileCache::setValidity ( 0 );
+        TileCache::setAdmission ( true );
+        TileCache::setCacheSize ( 64 * 1024 * 1024 );
+    }
+
+    void tearDown() {
+        TileCache::setCacheSize ( 0 );
+        TileCache::cleanCache();
+    }
+
+    void hitAndMiss() {
+        CPPUNIT_ASSERT ( TileCache::getTile ( "FILE::/pyr/12:5:7", "image/png", "" ) == NULL );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, TileCache::getMisses() );
+
+        CPPUNIT_ASSERT ( TileCache::addTile ( "FILE::/pyr/12:5:7", tile, 1000 ) );
+        CPPUNIT_ASSERT_EQUAL ( 1, TileCache::getTilesNumber() );
+
+        DataSource* ds = TileCache::getTile ( "FILE::/pyr/12:5:7", "image/png", "" );
+        CPPUNIT_ASSERT ( ds != NULL );
+        size_t size;
+        const uint8_t* data = ds->getData ( size );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 1000, size );
+        CPPUNIT_ASSERT ( memcmp ( data, tile, 1000 ) == 0 );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "image/png" ), ds->getType() );
+        CPPUNIT_ASSERT_EQUAL ( 1000U, ds->getLength() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, TileCache::getHits() );
+
+        // La tuile rendue partage le tampon du cache, qui reste valide tant que la source existe
+        TileCache::invalidate ( "FILE::/pyr/12:5:7" );
+        CPPUNIT_ASSERT ( ! isCached ( "FILE::/pyr/12:5:7" ) );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 0, TileCache::getUsedMemory() );
+        CPPUNIT_ASSERT ( ds->getBuffer ( size ) != NULL );
+        CPPUNIT_ASSERT ( memcmp ( data, tile, 1000 ) == 0 );
+        delete ds;
+    }
+
+    void validators() {
+        PooledBuffer* buffer = BufferPool::acquire ( 1000 );
+        memcpy ( buffer->getData(), tile, 1000 );
+        CPPUNIT_ASSERT ( TileCache::addTile ( "A", buffer, 1000, "0123abcd-800-3e8", 1500000000 ) );
+        buffer->release();
+
+        // Les validateurs de la tuile sont rendus avec elle, sans accès au stockage
+        DataSource* ds = TileCache::getTile ( "A", "image/png", "" );
+        CPPUNIT_ASSERT ( ds != NULL );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "0123abcd-800-3e8" ), ds->getTag() );
+        CPPUNIT_ASSERT_EQUAL ( ( time_t ) 1500000000, ds->getModification() );
+        delete ds;
+
+        TileCache::addTile ( "B", tile, 1000 );
+        ds = TileCache::getTile ( "B", "image/png", "" );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "" ), ds->getTag() );
+        CPPUNIT_ASSERT_EQUAL ( ( time_t ) 0, ds->getModification() );
+        delete ds;
+
+        // Dalle réécrite depuis la lecture de la tuile
+        buffer = BufferPool::acquire ( 1000 );
+        memcpy ( buffer->getData(), tile, 1000 );
+        CPPUNIT_ASSERT ( TileCache::addTile ( "C", buffer, 1000, "", 0, "1:10:1500000000:4096" ) );
+        buffer->release();
+        ds = TileCache::getTile ( "C", "image/png", "", "1:10:1500000000:4096" );
+        CPPUNIT_ASSERT ( ds != NULL );
+        delete ds;
+        CPPUNIT_ASSERT ( TileCache::getTile ( "C", "image/png", "", "1:11:1500000060:4096" ) == NULL );
+        CPPUNIT_ASSERT ( ! isCached ( "C" ) );
+    }
+
+    void memoryBudget() {
+        TileCache::setAdmission ( false );
+        TileCache::addTile ( key ( "/pyr/0", 0 ), tile, 16384 );
+        size_t elementSize = TileCache::getUsedMemory();
+
+        // Place pour trois tuiles par partition
+        size_t budget = TILE_CACHE_SHARDS * ( 3 * elementSize + elementSize / 2 );
+        TileCache::setCacheSize ( budget );
+        for ( int i = 1; i < 1000; i++ ) {
+            CPPUNIT_ASSERT ( TileCache::addTile ( key ( "/pyr/0", i ), tile, 16384 ) );
+        }
+
+        CPPUNIT_ASSERT ( TileCache::getUsedMemory() <= budget );
+        CPPUNIT_ASSERT_EQUAL ( 3 * TILE_CACHE_SHARDS, TileCache::getTilesNumber() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) ( 1000 - 3 * TILE_CACHE_SHARDS ), TileCache::getEvictions() );
+
+        // Les tuiles les plus récentes sont gardées
+        CPPUNIT_ASSERT ( isCached ( key ( "/pyr/0", 999 ) ) );
+        CPPUNIT_ASSERT ( ! isCached ( key ( "/pyr/0", 0 ) ) );
+
+        // Une tuile plus grande qu'une partition n'est jamais ajoutée
+        uint8_t* big = new uint8_t[budget];
+        CPPUNIT_ASSERT ( ! TileCache::addTile ( "big", big, budget ) );
+        delete[] big;
+    }
+
+    void admission() {
+        TileCache::addTile ( key ( "/pyr/1", 0 ), tile, 16384 );
+        size_t elementSize = TileCache::getUsedMemory();
+        TileCache::invalidate ( key ( "/pyr/1", 0 ) );
+
+        // Place pour huit tuiles par partition : les tuiles populaires tiennent même si elles sont toutes dans la même
+        TileCache::setCacheSize ( TILE_CACHE_SHARDS * ( 8 * elementSize + elementSize / 2 ) );
+
+        for ( int access = 0; access < 5; access++ ) {
+            for ( int i = 0; i < 8; i++ ) {
+                if ( ! isCached ( key ( "/hot", i ) ) ) TileCache::addTile ( key ( "/hot", i ), tile, 16384 );
+            }
+        }
+
+        // Parcours ponctuel de nombreuses tuiles
+        for ( int i = 0; i < 2000; i++ ) {
+            if ( ! isCached ( key ( "/cold", i ) ) ) TileCache::addTile ( key ( "/cold", i ), tile, 16384 );
+        }
+
+        CPPUNIT_ASSERT ( TileCache::getRejections() > 0 );
+        for ( int i = 0; i < 8; i++ ) {
+            CPPUNIT_ASSERT ( isCached ( key ( "/hot", i ) ) );
+        }
+
+        // Sans politique d'admission, le parcours évince les tuiles populaires
+        TileCache::setAdmission ( false );
+        for ( int i = 2000; i < 4000; i++ ) {
+            if ( ! isCached ( key ( "/cold", i ) ) ) TileCache::addTile ( key ( "/cold", i ), tile, 16384 );
+        }
+        for ( int i = 0; i < 8; i++ ) {
+            CPPUNIT_ASSERT ( ! isCached ( key ( "/hot", i ) ) );
+        }
+    }
+
+    void validity() {
+        TileCache::setValidity ( 1 );
+        TileCache::addTile ( "A", tile, 1000 );
+        CPPUNIT_ASSERT ( isCached ( "A" ) );
+        sleep ( 2 );
+        CPPUNIT_ASSERT ( ! isCached ( "A" ) );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, TileCache::getEvictions() );
+        CPPUNIT_ASSERT_EQUAL ( 0, TileCache::getTilesNumber() );
+    }
+
+    void disabled() {
+        TileCache::addTile ( "A", tile, 1000 );
+        TileCache::setCacheSize ( 0 );
+        CPPUNIT_ASSERT ( ! TileCache::isEnabled() );
+        CPPUNIT_ASSERT_EQUAL ( 0, TileCache::getTilesNumber() );
+
+        CPPUNIT_ASSERT ( ! TileCache::addTile ( "A", tile, 1000 ) );
+        CPPUNIT_ASSERT ( ! isCached ( "A" ) );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitTileCache );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitTileCache, "CppUnitTileCache" );
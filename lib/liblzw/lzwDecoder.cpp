@@ -85,7 +85,7 @@ void lzwDecoder::clearDict() {
     firstPass = true;
 }
 
-/** \warning Accès à un emplacement dans dict impossible. Des sortie ont été mises, pour pointer le problème. Le plantage n'est pas systématique pour une même image.
+/** \warning Un flux corrompu (code inconnu du dictionnaire) arrête le décodage : seules les données décodées jusque là sont retournées.
  ** \warning Performance de décodage assez mauvaises.
  */
 uint8_t* lzwDecoder::decode ( const uint8_t* in, size_t inSize, size_t& outPos )
@@ -102,6 +102,7 @@ uint8_t* lzwDecoder::decode ( const uint8_t* in, size_t inSize, size_t& outPos )
                 if ( inSize > 0) {
                     buffer = (buffer << 8) | *(in++);
                     nReadbits += 8;
+                    inSize--;
                 } else { // Not enough data in the current buffer. Return current state
                     return out;
                 }
@@ -148,9 +149,10 @@ uint8_t* lzwDecoder::decode ( const uint8_t* in, size_t inSize, size_t& outPos )
         if ( code == M_CLR ) { // Reset Dictionary
             this->clearDict();
         } else {
-            if (code > dict.size() - 1) { // Code Not found
-                //itCode = dict.find(lastCode);
-                if (lastCode >= dict.size()) std::cout << "1 lastCode = " << lastCode << " et dict size = " << dict.size() << std::endl;
+            if (code > dict.size() || lastCode >= dict.size()) { // Corrupted stream
+                return out;
+            }
+            if (code == dict.size()) { // Code Not found
                 lzwWord oldstring = dict.at(lastCode);
                 outString.assign(oldstring.begin(),oldstring.end());
                 outString.push_back(lastChar);
@@ -176,7 +178,6 @@ uint8_t* lzwDecoder::decode ( const uint8_t* in, size_t inSize, size_t& outPos )
                 out[outPos++]= *it;
             }
 
-            if (lastCode >= dict.size()) std::cout << "2 lastCode = " << lastCode << " et dict size = " << dict.size() << std::endl;
             lzwWord newEntry = dict.at(lastCode);
             newEntry.push_back(lastChar);
             dict.push_back(newEntry);
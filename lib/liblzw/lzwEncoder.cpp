@@ -138,12 +138,18 @@ uint8_t* lzwEncoder::encode(const uint8_t* in, size_t inSize, size_t& outSize)
 
     }
     writeBits(lastCode,out, outPos);
+    // The decoder appends an entry to its dictionary when reading lastCode: EOD must use the code size it switches to
+    if (dict.size() == size_t(maxCode - 1) && bitSize < maxBit) {
+        bitSize++;
+    }
     //Should be triggered at the end
     writeBits(M_EOD,out, outPos);
 
 
-    if (buffer) { // Flush the remaining data
-        writeBits(buffer,out, outPos);
+    if (nWriteBits) { // Flush the remaining bits, padded with zeros
+        out[outPos++] = buffer << (8 - nWriteBits);
+        buffer = 0;
+        nWriteBits = 0;
     }
     outSize = outPos;
     return out;
@@ -205,12 +211,18 @@ uint8_t* lzwEncoder::streamEncode(const uint8_t* in, size_t inSize, uint8_t* out
 void lzwEncoder::streamEnd(uint8_t* out, size_t& outPos)
 {
     writeBits(lastCode,out, outPos);
+    // The decoder appends an entry to its dictionary when reading lastCode: EOD must use the code size it switches to
+    if (dict.size() == size_t(maxCode - 1) && bitSize < maxBit) {
+        bitSize++;
+    }
     //Should be triggered at the end
     writeBits(M_EOD,out, outPos);
 
 
-    if (buffer) { // Flush the remaining data
-        writeBits(buffer,out, outPos);
+    if (nWriteBits) { // Flush the remaining bits, padded with zeros
+        out[outPos++] = buffer << (8 - nWriteBits);
+        buffer = 0;
+        nWriteBits = 0;
     }
 
 }
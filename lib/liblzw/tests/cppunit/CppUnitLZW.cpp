@@ -57,6 +57,7 @@ class CppUnitLZW : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST ( randomData );
 
     CPPUNIT_TEST ( whiteData );
+    CPPUNIT_TEST ( endOfData );
 
    /* CPPUNIT_TEST ( smallStringStream ); 
 
@@ -85,6 +86,7 @@ public:
     void veryLargeString();
     void randomData();
     void whiteData();
+    void endOfData();
     
 /*    void smallStringStream();
     void largeStringStream();
@@ -251,6 +253,32 @@ void CppUnitLZW::whiteData()
     delete[] rawBuffer;
 }
 
+// Le dernier code peut faire changer la taille des codes lue par le décodeur : la fin de données doit suivre ce changement
+void CppUnitLZW::endOfData()
+{
+    srand(1);
+    for (size_t rawBufferSize = 1; rawBufferSize <= 2048; rawBufferSize++) {
+        uint8_t* rawBuffer = new uint8_t[rawBufferSize];
+        for (size_t pos = 0; pos < rawBufferSize; pos++) {
+            rawBuffer[pos] = 256 * (rand() / (RAND_MAX +1.0));
+        }
+
+        lzwEncoder encoder;
+        size_t lzwBufferSize = 0;
+        uint8_t* lzwBuffer = encoder.encode(rawBuffer, rawBufferSize, lzwBufferSize);
+        lzwDecoder decoder(12);
+        size_t decodedBufferSize = 0;
+        uint8_t* decodedBuffer = decoder.decode(lzwBuffer, lzwBufferSize, decodedBufferSize);
+
+        CPPUNIT_ASSERT_EQUAL_MESSAGE ( "Decompression failed", rawBufferSize, decodedBufferSize );
+        CPPUNIT_ASSERT_MESSAGE ( "Information altered", memcmp(rawBuffer, decodedBuffer, rawBufferSize) == 0 );
+
+        delete[] lzwBuffer;
+        delete[] decodedBuffer;
+        delete[] rawBuffer;
+    }
+}
+
 /*
 void CppUnitLZW::smallStringStream() {
     compressStreamUncompress ( "LLLZW compression Algorithm implementation test" );
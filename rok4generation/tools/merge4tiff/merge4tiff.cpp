@@ -47,6 +47,7 @@
 #include "Image.h"
 #include "Format.h"
 #include "FileImage.h"
+#include "DownsampledImage.h"
 #include "Logger.h"
 #include <cstdlib>
 #include <cmath>
@@ -593,8 +594,8 @@ int fillBgLine ( FileImage* BGI, T* image, uint8_t* mask, int line, T* nodata )
 template <typename T>
 int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileImage* OUTPUTM, T* nodata ) {
     
-    uint8 MERGE[1024];
-    for ( int i = 0; i <= 1020; i++ ) MERGE[i] = 255 - ( uint8 ) round ( pow ( double ( 1020 - i ) /1020., gammaM4t ) * 255. );
+    uint8_t MERGE[1024];
+    DownsampledImage::fillMergeTable ( MERGE, gammaM4t );
 
     int nbsamples = width * samplesperpixel;
     int left,right;
@@ -602,9 +603,6 @@ int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileIma
     T line_bgI[nbsamples];
     uint8_t line_bgM[width];
 
-    int nbData;
-    float pix[samplesperpixel];
-
     T line_1I[2*nbsamples];
     uint8_t line_1M[2*width];
 
@@ -707,42 +705,10 @@ int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileIma
             }
 
             // ----------------- la moyenne ----------------
-            for ( int pixIn = left, sampleIn = left * samplesperpixel; pixIn < right;
-                    pixIn += 2, sampleIn += 2*samplesperpixel ) {
-
-                memset ( pix,0,samplesperpixel*sizeof ( float ) );
-                nbData = 0;
-
-                if ( line_1M[pixIn] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_1I[sampleIn+c];
-                }
-
-                if ( line_1M[pixIn+1] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_1I[sampleIn+samplesperpixel+c];
-                }
-
-                if ( line_2M[pixIn] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_2I[sampleIn+c];
-                }
-
-                if ( line_2M[pixIn+1] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_2I[sampleIn+samplesperpixel+c];
-                }
-
-                if ( nbData > 1 ) {
-                    line_outM[pixIn/2] = 255;
-                    if ( sizeof ( T ) == 1 ) {
-                        // Cas entier : utilisation d'un gamma
-                        for ( int c = 0; c < samplesperpixel; c++ ) line_outI[sampleIn/2+c] = MERGE[ ( int ) pix[c]*4/nbData];
-                    } else if ( sizeof ( T ) == 4 ) {
-                        for ( int c = 0; c < samplesperpixel; c++ ) line_outI[sampleIn/2+c] = pix[c]/ ( float ) nbData;
-                    }
-                }
-            }
+            // Cas entier : utilisation d'un gamma, via la table MERGE
+            downsample ( line_outI + left/2 * samplesperpixel, line_outM + left/2,
+                         line_1I + left * samplesperpixel, line_2I + left * samplesperpixel,
+                         line_1M + left, line_2M + left, ( right - left ) / 2, samplesperpixel, MERGE );
 
             if ( OUTPUTI->writeLine( line_outI, line ) == -1 ) {
                 LOGGER_ERROR ( "Unable to write image" );
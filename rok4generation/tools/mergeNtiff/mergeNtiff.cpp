@@ -72,6 +72,8 @@
 #include "PixelConverter.h"
 
 #include "CRS.h"
+#include "ProjCache.h"
+#include "ThreadPool.h"
 #include "Interpolation.h"
 #include "Format.h"
 #include "math.h"
@@ -110,6 +112,9 @@ Compression::eCompression compression = Compression::NONE;
 /** \~french Interpolation utilisée pour le réechantillonnage ou la reprojection */
 Interpolation::KernelType interpolation = Interpolation::CUBIC;
 
+/** \~french Nombre de threads utilisés pour décoder les tuiles des images sources. 1 par défaut */
+int threads = 1;
+
 /** \~french Activation du niveau de log debug. Faux par défaut */
 bool debugLogger=false;
 
@@ -118,7 +123,7 @@ std::string help = std::string("\nmergeNtiff version ") + std::string(ROK4_VERSI
 
     "Create one georeferenced TIFF image from several georeferenced TIFF images.\n\n"
 
-    "Usage: mergeNtiff -f <FILE> [-r <DIR>] -c <VAL> -i <VAL> -n <VAL> [-a <VAL> -s <VAL> -b <VAL>]\n"
+    "Usage: mergeNtiff -f <FILE> [-r <DIR>] -c <VAL> -i <VAL> -n <VAL> [-a <VAL> -s <VAL> -b <VAL>] [-j <VAL>]\n"
 
     "Parameters:\n"
     "    -f configuration file : list of output and source images and masks\n"
@@ -141,6 +146,7 @@ std::string help = std::string("\nmergeNtiff version ") + std::string(ROK4_VERSI
     "    -a sample format : (float or uint)\n"
     "    -b bits per sample : (8 or 32)\n"
     "    -s samples per pixel : (1, 2, 3 or 4)\n"
+    "    -j threads number used to decode source images' tiles (1 by default). Output image is the same, whatever the threads number\n"
     "    -d debug logger activation\n\n"
 
     "If bitspersample, sampleformat or samplesperpixel are not provided, those 3 informations are read from the image sources (all have to own the same). If 3 are provided, conversion may be done.\n\n"
@@ -283,6 +289,17 @@ int parseCommandLine ( int argc, char** argv ) {
                     return -1;
                 }
                 break;
+            case 'j': // threads
+                if ( i++ >= argc ) {
+                    LOGGER_ERROR ( "Error in option -j" );
+                    return -1;
+                }
+                threads = atoi ( argv[i] );
+                if ( threads < 1 ) {
+                    LOGGER_ERROR ( "Threads number have to be positive : " << argv[i] );
+                    return -1;
+                }
+                break;
             /*******************************************************************************/
 
             default:
@@ -470,6 +487,28 @@ int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<File
         }
         pImage->setCRS ( crs );
         delete paths.at(i);
+
+        /* Une image sans masque, dans le SRS de sortie et plus fine que la sortie, est lue directement au niveau
+         * de résolution réduit le plus grossier suffisant (vue d'ensemble TIFF, niveau d'ondelettes JPEG2000) :
+         * on ne décode pas les détails que le réechantillonnage jetterait */
+        if ( ! ( ( size_t ) ( i+1 ) < masks.size() && masks.at(i+1) ) && srss.at(i) == srss.at(0) ) {
+            if ( pImage->reduceResolution ( resxs.at(0), resys.at(0) ) ) {
+                LOGGER_DEBUG ( "Input " << nbImgsIn << " is read at resolutions " << pImage->getResX() << " x " << pImage->getResY() );
+            }
+        }
+
+        /* Une image dans le SRS de sortie n'est utile que sur l'emprise de la sortie, élargie du rayon du noyau
+         * d'interpolation : les tuiles hors de cette emprise ne sont pas décodées */
+        bool restricted = ( srss.at(i) == srss.at(0) );
+        BoundingBox<double> readArea = bboxes.at(0);
+        if ( restricted ) {
+            const Kernel& K = Kernel::getInstance ( interpolation );
+            double marginX = ( ceil ( K.size ( resxs.at(0) / pImage->getResX() ) ) + 2 ) * pImage->getResX();
+            double marginY = ( ceil ( K.size ( resys.at(0) / pImage->getResY() ) ) + 2 ) * pImage->getResY();
+            readArea = BoundingBox<double> ( bboxes.at(0).xmin - marginX, bboxes.at(0).ymin - marginY,
+                                             bboxes.at(0).xmax + marginX, bboxes.at(0).ymax + marginY );
+            pImage->setReadArea ( readArea );
+        }
         
         if ( i+1 < masks.size() && masks.at(i+1) ) {
             
@@ -479,6 +518,7 @@ int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<File
                 return -1;
             }
             pMask->setCRS ( crs );
+            if ( restricted ) pMask->setReadArea ( readArea );
 
             if ( ! pImage->setMask ( pMask ) ) {
                 LOGGER_ERROR ( "Cannot add mask to the input FileImage" );
@@ -1165,6 +1205,11 @@ int main ( int argc, char **argv ) {
         error ( "Echec fusion des paquets d images",-1 );
     }
 
+    // Décodage des tuiles des images sources en parallèle
+    if ( threads > 1 ) {
+        ThreadPool::initSharedPool ( threads );
+    }
+
     LOGGER_DEBUG ( "Save image" );
     // Enregistrement de l'image fusionnée
     if ( pImageOut->writeImage ( pECI ) < 0 ) {
@@ -1181,6 +1226,8 @@ int main ( int argc, char **argv ) {
 
     LOGGER_DEBUG ( "Clean" );
     // Nettoyage
+    ThreadPool::cleanSharedPool();
+    ProjCache::cleanCache();
     pj_clear_initcache();
     // Suppression du nettoyage du logger jusqu'à sa refonte
     // Logger::stopLogger();
@@ -56,6 +56,7 @@
 #include "FileImage.h"
 #include "CurlPool.h"
 #include "Rok4Image.h"
+#include "ThreadPool.h"
 #include "TiffNodataManager.h"
 #include "../../../rok4version.h"
 
@@ -76,7 +77,7 @@ std::string help = std::string("\nwork2cache version ") + std::string(ROK4_VERSI
 
     "Make image tiled and compressed, in TIFF format, respecting ROK4 specifications.\n\n"
 
-    "Usage: work2cache -c <VAL> -t <VAL> <VAL> <INPUT FILE> <OUTPUT FILE> [-crop]\n\n"
+    "Usage: work2cache -c <VAL> -t <VAL> <VAL> <INPUT FILE> <OUTPUT FILE> [-crop] [-j <VAL>]\n\n"
 
     "Parameters:\n"
     "     -c output compression :\n"
@@ -92,6 +93,7 @@ std::string help = std::string("\nwork2cache version ") + std::string(ROK4_VERSI
     "     -container Swift container where data is. Then OUTPUT FILE is interpreted as a Swift object name (ONLY IF OBJECT COMPILATION)\n"
     "     -bucket S3 bucket where data is. Then OUTPUT FILE is interpreted as a S3 object name (ONLY IF OBJECT COMPILATION)\n"
     "     -crop : blocks (used by JPEG compression) wich contain a white pixel are filled with white\n"
+    "     -j threads number used to decode source tiles and compress output tiles (1 by default). Output image is the same, whatever the threads number\n"
     "     -a sample format : (float or uint)\n"
     "     -b bits per sample : (8 or 32)\n"
     "     -s samples per pixel : (1, 2, 3 or 4)\n"
@@ -156,6 +158,7 @@ int main ( int argc, char **argv ) {
 
     bool crop = false;
     bool debugLogger=false;
+    int threads = 1;
 
 #if BUILD_OBJECT
     char *pool = 0, *container = 0, *bucket = 0;
@@ -239,6 +242,11 @@ int main ( int argc, char **argv ) {
                     tileWidth = atoi ( argv[++i] );
                     tileHeight = atoi ( argv[++i] );
                     break;
+                case 'j': // threads
+                    if ( ++i == argc ) { error ( "Error in -j option", -1 ); }
+                    threads = atoi ( argv[i] );
+                    if ( threads < 1 ) { error ( "Threads number have to be positive : " + string(argv[i]), -1 ); }
+                    break;
 
                 /****************** OPTIONNEL, POUR FORCER DES CONVERSIONS **********************/
                 case 's': // samplesperpixel
@@ -415,10 +423,17 @@ int main ( int argc, char **argv ) {
 
     LOGGER_DEBUG ( "Write" );
 
+    // Compression des tuiles en parallèle
+    if ( threads > 1 ) {
+        ThreadPool::initSharedPool ( threads );
+    }
+
     if (rok4Image->writeImage(sourceImage, crop) < 0) {
         error("Cannot write ROK4 image", -1);
     }
 
+    ThreadPool::cleanSharedPool();
+
 #if BUILD_OBJECT
 
     if (onSwift || onS3) {
@@ -391,7 +391,7 @@ WebService *ConfLoader::parseWebService(TiXmlElement* sWeb, CRS pyrCRS, Rok4Form
     WebService * ws = NULL;
     std::string url, user, pwd, referer, userAgent, version, layers, styles, format, crs;
     std::map<std::string,std::string> options;
-    int timeout, retry, interval, channels;
+    int timeout, retry, interval, maxConnections, channels;
     std::string name,ndValuesStr,value;
     BoundingBox<double> bbox = BoundingBox<double> (0.,0.,0.,0.);
     std::vector<int> noDataValues;
@@ -443,6 +443,17 @@ WebService *ConfLoader::parseWebService(TiXmlElement* sWeb, CRS pyrCRS, Rok4Form
         interval = DEFAULT_INTERVAL;
     }
 
+    TiXmlElement* sMaxConnections = sWeb->FirstChildElement("maxConnections");
+    if (sMaxConnections && sMaxConnections->GetText()) {
+        maxConnections = atoi(sMaxConnections->GetText());
+        if (maxConnections <= 0) {
+            LOGGER_ERROR("Le nombre maximal de requetes simultanees vers un WebService doit etre strictement positif");
+            return NULL;
+        }
+    } else {
+        maxConnections = DEFAULT_MAX_CONNECTIONS;
+    }
+
     TiXmlElement* sUser = sWeb->FirstChildElement("user");
     if (sUser && sUser->GetText()) {
         user = DocumentXML::getTextStrFromElem(sUser);
@@ -636,6 +647,7 @@ WebService *ConfLoader::parseWebService(TiXmlElement* sWeb, CRS pyrCRS, Rok4Form
 
         ws = new WebMapService(url, retry, interval, timeout, version, layers, styles, format, channels, crs, bbox, noDataValues,options);
         ws->setResponseType(format);
+        ws->setMaxConnections(maxConnections);
     } else {
          //On retourne une erreur car le WMS est le seul WebService disponible pour le moment
         LOGGER_ERROR("Un WebService doit contenir un WMS pour être utilisé");
@@ -0,0 +1,1388 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file FcgiDispatcher.cpp
+ ** \~french
+ * \brief Implémentation des classes FcgiDispatcher et FcgiJob
+ ** \~english
+ * \brief Implements classes FcgiDispatcher and FcgiJob
+ */
+
+#include "FcgiDispatcher.h"
+#include "fastcgi.h"
+#include "Logger.h"
+#include <algorithm>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// Identifiants réservés dans epoll
+#define EPOLL_LISTEN_ID 0
+#define EPOLL_WAKE_ID 1
+#define EPOLL_HTTP_LISTEN_ID 2
+
+// Nombre maximal de morceaux envoyés par une même écriture groupée
+#define OUTPUT_IOV_MAX 64
+
+/********************************************** FcgiJob */
+
+// Lit une longueur de paire nom-valeur, sur 1 ou 4 octets
+static bool readLength ( const std::string& raw, size_t& pos, size_t& length ) {
+    if ( pos >= raw.size() ) return false;
+    unsigned char b = raw[pos];
+    if ( ( b >> 7 ) == 0 ) {
+        length = b;
+        pos += 1;
+        return true;
+    }
+    if ( pos + 4 > raw.size() ) return false;
+    length = ( ( size_t ) ( b & 0x7f ) << 24 ) | ( ( size_t ) ( unsigned char ) raw[pos + 1] << 16 )
+        | ( ( size_t ) ( unsigned char ) raw[pos + 2] << 8 ) | ( size_t ) ( unsigned char ) raw[pos + 3];
+    pos += 4;
+    return true;
+}
+
+bool FcgiJob::prepare ( int listenSock, bool keepConnection ) {
+
+    size_t pos = 0;
+    while ( pos < rawParams.size() ) {
+        size_t nameLength, valueLength;
+        if ( ! readLength ( rawParams, pos, nameLength ) || ! readLength ( rawParams, pos, valueLength ) ) return false;
+        if ( pos + nameLength + valueLength > rawParams.size() ) return false;
+        env.push_back ( rawParams.substr ( pos, nameLength ) + "=" + rawParams.substr ( pos + nameLength, valueLength ) );
+        pos += nameLength + valueLength;
+    }
+    rawParams.clear();
+
+    for ( int i = 0; i < env.size(); i++ ) {
+        envp.push_back ( ( char* ) env.at ( i ).c_str() );
+    }
+    envp.push_back ( NULL );
+
+    // Flux d'entrée : tout le corps est déjà disponible, la demande de remplissage marque la fin
+    memset ( &in, 0, sizeof ( FCGX_Stream ) );
+    in.rdNext = ( unsigned char* ) content.data();
+    in.stop = in.rdNext + content.size();
+    in.stopUnget = in.rdNext;
+    in.isReader = 1;
+    in.fillBuffProc = FcgiDispatcher::fillStream;
+    in.data = this;
+
+    // Flux de sortie : à chaque remplissage du tampon, le contenu est transmis à la boucle d'évènements
+    memset ( &out, 0, sizeof ( FCGX_Stream ) );
+    out.wrNext = out.stopUnget = outBuffer;
+    out.stop = outBuffer + sizeof ( outBuffer );
+    out.emptyBuffProc = FcgiDispatcher::emptyStream;
+    out.data = this;
+
+    memset ( &err, 0, sizeof ( FCGX_Stream ) );
+    err.wrNext = err.stopUnget = errBuffer;
+    err.stop = errBuffer + sizeof ( errBuffer );
+    err.emptyBuffProc = FcgiDispatcher::emptyStream;
+    err.data = this;
+
+    memset ( &fcgx, 0, sizeof ( FCGX_Request ) );
+    fcgx.requestId = requestId;
+    fcgx.role = FCGI_RESPONDER;
+    fcgx.in = &in;
+    fcgx.out = &out;
+    fcgx.err = &err;
+    fcgx.envp = &( envp[0] );
+    fcgx.ipcFd = -1;
+    fcgx.isBeginProcessed = 1;
+    fcgx.keepConnection = keepConnection;
+    fcgx.nWriters = 2;
+    fcgx.listen_sock = listenSock;
+
+    return true;
+}
+
+/********************************************** FcgiDispatcher */
+
+FcgiDispatcher::FcgiDispatcher ( int sock, int nbWorkers, FcgiHandler h, void* arg ) :
+    listenSock ( sock ), httpListenSock ( -1 ), epollFd ( -1 ), wakeFd ( -1 ), handler ( h ), handlerArg ( arg ), workers ( nbWorkers > 0 ? nbWorkers : 1 ),
+    stopping ( 0 ), workersStop ( false ), storageStop ( false ), parkedJobs ( 0 ), nextConnection ( 3 ), inFlight ( 0 ),
+    acceptedConnections ( 0 ), processedRequests ( 0 ), abortedRequests ( 0 ), httpRequests ( 0 ), maxInFlight ( 0 ), parkedRequests ( 0 ),
+    idleTimeout ( FCGI_DISPATCHER_HTTP_IDLE_TIMEOUT ), headerTimeout ( FCGI_DISPATCHER_HTTP_HEADER_TIMEOUT ), bodyTimeout ( FCGI_DISPATCHER_HTTP_BODY_TIMEOUT ),
+    acceptPause ( 0 )
+{
+    pthread_mutex_init ( &mtx, NULL );
+    pthread_cond_init ( &cond, NULL );
+    pthread_cond_init ( &storageCond, NULL );
+
+    // Le réveil doit être possible dès la construction, un arrêt pouvant être demandé avant le lancement
+    wakeFd = eventfd ( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+    // Même restriction que la libfcgi sur les adresses des serveurs web
+    char* addrs = getenv ( "FCGI_WEB_SERVER_ADDRS" );
+    if ( addrs != NULL ) {
+        std::string list ( addrs );
+        size_t begin = 0;
+        while ( begin <= list.size() ) {
+            size_t end = list.find ( ',', begin );
+            if ( end == std::string::npos ) end = list.size();
+            std::string addr = list.substr ( begin, end - begin );
+            if ( ! addr.empty() ) allowedAddresses.insert ( addr );
+            begin = end + 1;
+        }
+    }
+}
+
+FcgiDispatcher::~FcgiDispatcher() {
+    std::map<uint64_t, FcgiConnection*>::iterator it;
+    while ( ! connections.empty() ) {
+        closeConnection ( connections.begin()->second );
+    }
+    if ( wakeFd >= 0 ) close ( wakeFd );
+    pthread_mutex_destroy ( &mtx );
+    pthread_cond_destroy ( &cond );
+    pthread_cond_destroy ( &storageCond );
+}
+
+void FcgiDispatcher::setHttpSocket ( int sock ) {
+    httpListenSock = sock;
+}
+
+void FcgiDispatcher::setHttpTimeouts ( int idle, int header, int body ) {
+    idleTimeout = idle;
+    headerTimeout = header;
+    bodyTimeout = body;
+}
+
+void FcgiDispatcher::appendRecord ( std::string& buffer, int type, int requestId, const char* content, size_t length ) {
+    size_t done = 0;
+    do {
+        // Contenu limité à 65535 octets par enregistrement, complété pour être aligné sur 8 octets
+        size_t part = std::min ( length - done, ( size_t ) FCGI_DISPATCHER_BUFFER_SIZE );
+        unsigned char padding = ( 8 - part % 8 ) % 8;
+        unsigned char header[FCGI_HEADER_LEN] = {
+            FCGI_VERSION_1, ( unsigned char ) type,
+            ( unsigned char ) ( ( requestId >> 8 ) & 0xff ), ( unsigned char ) ( requestId & 0xff ),
+            ( unsigned char ) ( ( part >> 8 ) & 0xff ), ( unsigned char ) ( part & 0xff ),
+            padding, 0
+        };
+        buffer.append ( ( char* ) header, FCGI_HEADER_LEN );
+        if ( part > 0 ) buffer.append ( content + done, part );
+        buffer.append ( padding, '\0' );
+        done += part;
+    } while ( done < length );
+}
+
+void FcgiDispatcher::appendEndRequest ( std::string& buffer, int requestId, int appStatus, int protocolStatus ) {
+    unsigned char body[8] = {
+        ( unsigned char ) ( ( appStatus >> 24 ) & 0xff ), ( unsigned char ) ( ( appStatus >> 16 ) & 0xff ),
+        ( unsigned char ) ( ( appStatus >> 8 ) & 0xff ), ( unsigned char ) ( appStatus & 0xff ),
+        ( unsigned char ) protocolStatus, 0, 0, 0
+    };
+    appendRecord ( buffer, FCGI_END_REQUEST, requestId, ( char* ) body, 8 );
+}
+
+void FcgiDispatcher::fillStream ( FCGX_Stream* stream ) {
+    stream->isClosed = 1;
+}
+
+void FcgiDispatcher::emptyStream ( FCGX_Stream* stream, int doClose ) {
+    FcgiJob* job = ( FcgiJob* ) stream->data;
+    bool isOut = ( stream == &( job->out ) );
+    unsigned char* buffer = isOut ? job->outBuffer : job->errBuffer;
+
+    size_t length = stream->wrNext - buffer;
+    stream->wrNext = buffer;
+    if ( length == 0 ) return;
+
+    std::string records;
+    if ( job->http ) {
+        // Pas de flux d'erreur en HTTP, la sortie standard est convertie par la boucle d'évènements
+        if ( ! isOut ) {
+            LOGGER_DEBUG ( "Sortie d'erreur ignorée : " << std::string ( ( char* ) buffer, length ) );
+            return;
+        }
+        records.assign ( ( char* ) buffer, length );
+    } else {
+        appendRecord ( records, isOut ? FCGI_STDOUT : FCGI_STDERR, job->requestId, ( char* ) buffer, length );
+    }
+    if ( job->dispatcher->post ( job, records, false ) ) {
+        // Plus personne n'attend la réponse : le traitement est prévenu par une erreur d'écriture
+        stream->isClosed = 1;
+        stream->FCGI_errno = EPIPE;
+    }
+}
+
+bool FcgiDispatcher::post ( FcgiJob* job, std::string& records, bool done ) {
+    pthread_mutex_lock ( &mtx );
+    bool aborted = job->aborted;
+    // Une requête interrompue doit tout de même être terminée auprès du serveur web
+    if ( ! aborted || done ) {
+        outputs.push_back ( std::pair<FcgiJob*, std::pair<OutputPart, bool> > ( job, std::pair<OutputPart, bool> ( OutputPart(), done ) ) );
+        outputs.back().second.first.data.swap ( records );
+    }
+    pthread_mutex_unlock ( &mtx );
+    wake();
+    return aborted;
+}
+
+bool FcgiDispatcher::post ( FcgiJob* job, std::vector<OutputPart>& parts ) {
+    pthread_mutex_lock ( &mtx );
+    bool aborted = job->aborted;
+    if ( ! aborted ) {
+        for ( int i = 0; i < parts.size(); i++ ) {
+            outputs.push_back ( std::pair<FcgiJob*, std::pair<OutputPart, bool> > ( job, std::pair<OutputPart, bool> ( OutputPart(), false ) ) );
+            outputs.back().second.first.swap ( parts.at ( i ) );
+        }
+    }
+    pthread_mutex_unlock ( &mtx );
+    parts.clear();
+    wake();
+    return aborted;
+}
+
+int FcgiDispatcher::putBuffer ( FCGX_Stream* stream, PooledBuffer* buffer, size_t offset, size_t length ) {
+    if ( stream->emptyBuffProc != FcgiDispatcher::emptyStream ) return 0;
+    FcgiJob* job = ( FcgiJob* ) stream->data;
+    if ( stream != &( job->out ) ) return 0;
+
+    // Ce qui a déjà été écrit dans le flux (les en-têtes) part en premier
+    emptyStream ( stream, 0 );
+    if ( stream->isClosed ) return -1;
+    if ( length == 0 ) return 1;
+
+    std::vector<OutputPart> parts;
+    if ( job->http ) {
+        parts.push_back ( OutputPart ( buffer, offset, length ) );
+    } else {
+        // Enregistrements FastCGI dont le contenu est une portion du tampon, seuls les en-têtes sont créés
+        size_t done = 0;
+        while ( done < length ) {
+            size_t part = std::min ( length - done, ( size_t ) FCGI_DISPATCHER_BUFFER_SIZE );
+            unsigned char padding = ( 8 - part % 8 ) % 8;
+            unsigned char header[FCGI_HEADER_LEN] = {
+                FCGI_VERSION_1, FCGI_STDOUT,
+                ( unsigned char ) ( ( job->requestId >> 8 ) & 0xff ), ( unsigned char ) ( job->requestId & 0xff ),
+                ( unsigned char ) ( ( part >> 8 ) & 0xff ), ( unsigned char ) ( part & 0xff ),
+                padding, 0
+            };
+            parts.push_back ( OutputPart() );
+            parts.back().data.assign ( ( char* ) header, FCGI_HEADER_LEN );
+            parts.push_back ( OutputPart ( buffer, offset + done, part ) );
+            if ( padding > 0 ) {
+                parts.push_back ( OutputPart() );
+                parts.back().data.assign ( padding, '\0' );
+            }
+            done += part;
+        }
+    }
+
+    if ( job->dispatcher->post ( job, parts ) ) {
+        stream->isClosed = 1;
+        stream->FCGI_errno = EPIPE;
+        return -1;
+    }
+    return 1;
+}
+
+int FcgiDispatcher::parkReads ( FCGX_Request* request, std::map<Context*, std::vector<ContextRead*> >& reads, FcgiResume resume, void* state ) {
+    FCGX_Stream* stream = request->out;
+    if ( stream->emptyBuffProc != FcgiDispatcher::emptyStream || stream != &( ( ( FcgiJob* ) stream->data )->out ) ) {
+        // Requête hors répartiteur : les lectures sont faites tout de suite
+        std::map<Context*, std::vector<ContextRead*> >::iterator it;
+        for ( it = reads.begin(); it != reads.end(); ++it ) {
+            it->first->readAll ( it->second );
+        }
+        resume ( request, state );
+        return 0;
+    }
+
+    // Le thread de traitement transmettra la requête au thread des lectures une fois la main rendue
+    FcgiJob* job = ( FcgiJob* ) stream->data;
+    job->reads = reads;
+    job->resume = resume;
+    job->resumeState = state;
+    return 1;
+}
+
+void FcgiDispatcher::wake() {
+    uint64_t one = 1;
+    if ( write ( wakeFd, &one, sizeof ( one ) ) < 0 && errno != EAGAIN ) {
+        // Le compteur est saturé ou le descripteur invalide : la boucle se réveillera à son prochain évènement
+    }
+}
+
+void FcgiDispatcher::stop() {
+    stopping = 1;
+    wake();
+}
+
+void* FcgiDispatcher::workerLoop ( void* arg ) {
+    FcgiDispatcher* d = ( FcgiDispatcher* ) arg;
+
+    while ( true ) {
+        pthread_mutex_lock ( &d->mtx );
+        // Les requêtes en attente de lectures reviendront dans la file : les threads ne s'arrêtent pas avant
+        while ( d->jobs.empty() && ! ( d->workersStop && d->parkedJobs == 0 ) ) {
+            pthread_cond_wait ( &d->cond, &d->mtx );
+        }
+        if ( d->jobs.empty() ) {
+            pthread_mutex_unlock ( &d->mtx );
+            break;
+        }
+        FcgiJob* job = d->jobs.front();
+        d->jobs.pop_front();
+        bool aborted = job->aborted;
+        pthread_mutex_unlock ( &d->mtx );
+
+        if ( job->resume != NULL ) {
+            // Reprise après les lectures, même pour une requête interrompue, dont l'état doit être libéré
+            FcgiResume resume = job->resume;
+            job->resume = NULL;
+            job->reads.clear();
+            LOGGER_DEBUG ( "Thread " << pthread_self() << " reprend une requete" );
+            resume ( &( job->fcgx ), job->resumeState );
+        } else if ( ! aborted ) {
+            LOGGER_DEBUG ( "Thread " << pthread_self() << " traite une requete" );
+            d->handler ( &( job->fcgx ), d->handlerArg );
+        }
+
+        if ( job->resume != NULL ) {
+            // Le traitement a mis la requête en attente de lectures : le thread passe à la suivante
+            LOGGER_DEBUG ( "Thread " << pthread_self() << " met une requete en attente de lectures" );
+            pthread_mutex_lock ( &d->mtx );
+            d->storageJobs.push_back ( job );
+            d->parkedJobs++;
+            pthread_cond_signal ( &d->storageCond );
+            pthread_mutex_unlock ( &d->mtx );
+            continue;
+        }
+
+        if ( ! aborted ) {
+            emptyStream ( &( job->err ), 1 );
+            // En HTTP, la fin de la sortie accompagne la fin du traitement : une réponse tenant dans le tampon a une longueur connue
+            if ( ! job->http ) emptyStream ( &( job->out ), 1 );
+            LOGGER_DEBUG ( "Thread " << pthread_self() << " en a fini avec la requete" );
+        }
+
+        // Fin des flux et de la requête
+        std::string end;
+        if ( job->http ) {
+            end.assign ( ( char* ) job->outBuffer, job->out.wrNext - job->outBuffer );
+            job->out.wrNext = job->outBuffer;
+        } else {
+            appendRecord ( end, FCGI_STDOUT, job->requestId, NULL, 0 );
+            appendEndRequest ( end, job->requestId, 0, FCGI_REQUEST_COMPLETE );
+        }
+        d->post ( job, end, true );
+    }
+
+    LOGGER_DEBUG ( "Extinction du thread" );
+    Logger::stopLogger();
+    return 0;
+}
+
+void* FcgiDispatcher::storageLoop ( void* arg ) {
+    FcgiDispatcher* d = ( FcgiDispatcher* ) arg;
+
+    while ( true ) {
+        std::deque<FcgiJob*> batch;
+        pthread_mutex_lock ( &d->mtx );
+        while ( d->storageJobs.empty() && ! d->storageStop ) {
+            pthread_cond_wait ( &d->storageCond, &d->mtx );
+        }
+        if ( d->storageJobs.empty() ) {
+            pthread_mutex_unlock ( &d->mtx );
+            break;
+        }
+        batch.swap ( d->storageJobs );
+        pthread_mutex_unlock ( &d->mtx );
+
+        // Les lectures de toutes les requêtes en attente sont regroupées par contexte, et toutes en cours en même temps
+        std::map<Context*, std::vector<ContextRead*> > reads;
+        std::map<Context*, std::vector<ContextRead*> >::iterator it;
+        for ( size_t i = 0; i < batch.size(); i++ ) {
+            for ( it = batch.at ( i )->reads.begin(); it != batch.at ( i )->reads.end(); ++it ) {
+                reads[it->first].insert ( reads[it->first].end(), it->second.begin(), it->second.end() );
+            }
+        }
+        LOGGER_DEBUG ( "Lectures de " << batch.size() << " requete(s) en attente" );
+        for ( it = reads.begin(); it != reads.end(); ++it ) {
+            it->first->submitReads ( it->second );
+        }
+        for ( it = reads.begin(); it != reads.end(); ++it ) {
+            it->first->waitReads ( it->second );
+        }
+
+        pthread_mutex_lock ( &d->mtx );
+        for ( size_t i = 0; i < batch.size(); i++ ) {
+            d->jobs.push_back ( batch.at ( i ) );
+        }
+        d->parkedJobs -= batch.size();
+        d->parkedRequests += batch.size();
+        pthread_cond_broadcast ( &d->cond );
+        pthread_mutex_unlock ( &d->mtx );
+    }
+
+    Logger::stopLogger();
+    return 0;
+}
+
+void FcgiDispatcher::watchOutput ( FcgiConnection* conn, bool watch ) {
+    if ( conn->watchingOutput == watch ) return;
+    conn->watchingOutput = watch;
+    updateEvents ( conn );
+}
+
+void FcgiDispatcher::updateEvents ( FcgiConnection* conn ) {
+    struct epoll_event ev;
+    memset ( &ev, 0, sizeof ( ev ) );
+    ev.events = ( conn->inputClosed ? 0 : EPOLLIN ) | ( conn->watchingOutput ? EPOLLOUT : 0 );
+    ev.data.u64 = conn->id;
+    epoll_ctl ( epollFd, EPOLL_CTL_MOD, conn->fd, &ev );
+}
+
+void FcgiDispatcher::queueOutput ( std::deque<OutputPart>& target, std::string& data ) {
+    if ( data.empty() ) return;
+    target.push_back ( OutputPart() );
+    target.back().data.swap ( data );
+}
+
+void FcgiDispatcher::queueOutput ( std::deque<OutputPart>& target, OutputPart& part ) {
+    if ( part.size() == 0 ) return;
+    target.push_back ( OutputPart() );
+    target.back().swap ( part );
+}
+
+void FcgiDispatcher::acceptConnections ( int sock, bool http ) {
+    while ( true ) {
+        struct sockaddr_storage addr;
+        socklen_t addrLen = sizeof ( addr );
+        int fd = accept ( sock, ( struct sockaddr* ) &addr, &addrLen );
+        if ( fd < 0 ) {
+            if ( errno == EINTR ) continue;
+            if ( errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM ) {
+                // Les sockets d'écoute sont surveillées en mode niveau : la connexion restant en attente, elles seraient signalées
+                // à chaque tour de boucle. On ne les écoute plus le temps que des descripteurs se libèrent.
+                LOGGER_ERROR ( "Impossible d'accepter une connexion " << ( http ? "HTTP" : "FastCGI" ) << " : " << strerror ( errno )
+                               << ", nouvel essai dans " << FCGI_DISPATCHER_ACCEPT_BACKOFF << " s" );
+                watchListeners ( false );
+                acceptPause = time ( NULL ) + FCGI_DISPATCHER_ACCEPT_BACKOFF;
+                return;
+            }
+            if ( errno != EAGAIN && errno != EWOULDBLOCK ) {
+                LOGGER_ERROR ( "Impossible d'accepter une connexion " << ( http ? "HTTP" : "FastCGI" ) << " : " << strerror ( errno ) );
+            }
+            return;
+        }
+
+        if ( ! http && ! allowedAddresses.empty() && addr.ss_family == AF_INET ) {
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop ( AF_INET, & ( ( ( struct sockaddr_in* ) &addr )->sin_addr ), ip, sizeof ( ip ) );
+            if ( allowedAddresses.find ( ip ) == allowedAddresses.end() ) {
+                LOGGER_WARN ( "Connexion FastCGI refusée depuis " << ip );
+                close ( fd );
+                continue;
+            }
+        }
+
+        fcntl ( fd, F_SETFL, fcntl ( fd, F_GETFL ) | O_NONBLOCK );
+        fcntl ( fd, F_SETFD, FD_CLOEXEC );
+
+        FcgiConnection* conn = new FcgiConnection ( nextConnection++, fd );
+        if ( http ) {
+            conn->http = true;
+            char ip[INET6_ADDRSTRLEN] = "";
+            if ( addr.ss_family == AF_INET ) {
+                inet_ntop ( AF_INET, & ( ( ( struct sockaddr_in* ) &addr )->sin_addr ), ip, sizeof ( ip ) );
+            } else if ( addr.ss_family == AF_INET6 ) {
+                inet_ntop ( AF_INET6, & ( ( ( struct sockaddr_in6* ) &addr )->sin6_addr ), ip, sizeof ( ip ) );
+            }
+            conn->remoteAddr = ip;
+            // Les réponses sont envoyées d'un bloc, inutile de les retarder
+            int one = 1;
+            setsockopt ( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof ( one ) );
+        }
+
+        struct epoll_event ev;
+        memset ( &ev, 0, sizeof ( ev ) );
+        ev.events = EPOLLIN;
+        ev.data.u64 = conn->id;
+        if ( epoll_ctl ( epollFd, EPOLL_CTL_ADD, fd, &ev ) != 0 ) {
+            LOGGER_ERROR ( "Impossible de surveiller une connexion : " << strerror ( errno ) );
+            close ( fd );
+            delete conn;
+            continue;
+        }
+        connections.insert ( std::pair<uint64_t, FcgiConnection*> ( conn->id, conn ) );
+        acceptedConnections++;
+    }
+}
+
+void FcgiDispatcher::watchListeners ( bool watch ) {
+    struct epoll_event ev;
+    memset ( &ev, 0, sizeof ( ev ) );
+    ev.events = EPOLLIN;
+    ev.data.u64 = EPOLL_LISTEN_ID;
+    epoll_ctl ( epollFd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, listenSock, &ev );
+    if ( httpListenSock >= 0 ) {
+        ev.data.u64 = EPOLL_HTTP_LISTEN_ID;
+        epoll_ctl ( epollFd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, httpListenSock, &ev );
+    }
+}
+
+void FcgiDispatcher::checkDeadlines ( time_t now ) {
+    std::vector<FcgiConnection*> idle, late;
+    std::map<uint64_t, FcgiConnection*>::iterator it;
+    for ( it = connections.begin(); it != connections.end(); ++it ) {
+        FcgiConnection* conn = it->second;
+        // Les serveurs web gèrent eux-mêmes leurs connexions FastCGI
+        if ( ! conn->http ) continue;
+        // La connexion attend le serveur, pas le client
+        if ( ! conn->processing.empty() || ! conn->httpQueue.empty() || ! conn->output.empty() ) continue;
+
+        if ( conn->requestDeadline != 0 ) {
+            if ( now > conn->requestDeadline ) late.push_back ( conn );
+        } else if ( now - conn->lastActivity > idleTimeout ) {
+            idle.push_back ( conn );
+        }
+    }
+
+    for ( int i = 0; i < idle.size(); i++ ) {
+        LOGGER_DEBUG ( "Connexion HTTP inactive fermée" );
+        closeConnection ( idle.at ( i ) );
+    }
+    for ( int i = 0; i < late.size(); i++ ) {
+        FcgiConnection* conn = late.at ( i );
+        conn->requestDeadline = 0;
+        conn->input.clear();
+        // Le client n'est plus écouté, la réponse est envoyée puis la connexion fermée
+        conn->inputClosed = true;
+        updateEvents ( conn );
+        httpError ( conn, "408 Request Timeout" );
+        writeConnection ( conn );
+    }
+}
+
+void FcgiDispatcher::closeConnection ( FcgiConnection* conn ) {
+    if ( epollFd >= 0 ) epoll_ctl ( epollFd, EPOLL_CTL_DEL, conn->fd, NULL );
+    close ( conn->fd );
+
+    // Les requêtes en cours de traitement seront supprimées à leur fin
+    pthread_mutex_lock ( &mtx );
+    std::set<FcgiJob*>::iterator itp;
+    for ( itp = conn->processing.begin(); itp != conn->processing.end(); ++itp ) {
+        if ( ! ( *itp )->aborted ) abortedRequests++;
+        ( *itp )->aborted = true;
+    }
+    pthread_mutex_unlock ( &mtx );
+
+    std::map<int, FcgiJob*>::iterator itr;
+    for ( itr = conn->receiving.begin(); itr != conn->receiving.end(); ++itr ) {
+        delete itr->second;
+    }
+
+    // Les réponses HTTP terminées mais pas encore envoyées sont abandonnées
+    for ( int i = 0; i < conn->httpQueue.size(); i++ ) {
+        if ( conn->processing.find ( conn->httpQueue.at ( i ) ) == conn->processing.end() ) delete conn->httpQueue.at ( i );
+    }
+
+    connections.erase ( conn->id );
+    delete conn;
+}
+
+bool FcgiDispatcher::writeConnection ( FcgiConnection* conn ) {
+    while ( ! conn->output.empty() ) {
+        // Écriture groupée : les en-têtes et le corps des réponses ne sont jamais recopiés dans un même tampon
+        struct iovec iov[OUTPUT_IOV_MAX];
+        int n = 0;
+        size_t offset = conn->outputOffset;
+        std::deque<OutputPart>::iterator it;
+        for ( it = conn->output.begin(); it != conn->output.end() && n < OUTPUT_IOV_MAX; ++it ) {
+            iov[n].iov_base = ( void* ) ( it->begin() + offset );
+            iov[n].iov_len = it->size() - offset;
+            offset = 0;
+            n++;
+        }
+        struct msghdr msg;
+        memset ( &msg, 0, sizeof ( msg ) );
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+
+        ssize_t w = sendmsg ( conn->fd, &msg, MSG_NOSIGNAL );
+        if ( w < 0 ) {
+            if ( errno == EINTR ) continue;
+            if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                // La suite sera envoyée quand la socket sera de nouveau disponible
+                watchOutput ( conn, true );
+                return true;
+            }
+            LOGGER_DEBUG ( "Connexion interrompue en écriture : " << strerror ( errno ) );
+            closeConnection ( conn );
+            return false;
+        }
+
+        conn->lastActivity = time ( NULL );
+        size_t sent = w;
+        while ( sent > 0 ) {
+            size_t remaining = conn->output.front().size() - conn->outputOffset;
+            if ( sent < remaining ) {
+                conn->outputOffset += sent;
+                break;
+            }
+            sent -= remaining;
+            conn->output.pop_front();
+            conn->outputOffset = 0;
+        }
+    }
+
+    conn->outputOffset = 0;
+    watchOutput ( conn, false );
+
+    if ( conn->closing && conn->processing.empty() && conn->httpQueue.empty() ) {
+        closeConnection ( conn );
+        return false;
+    }
+    return true;
+}
+
+void FcgiDispatcher::readConnection ( FcgiConnection* conn ) {
+    char buffer[65536];
+    bool eof = false;
+    while ( true ) {
+        ssize_t r = recv ( conn->fd, buffer, sizeof ( buffer ), 0 );
+        if ( r < 0 ) {
+            if ( errno == EINTR ) continue;
+            if ( errno == EAGAIN || errno == EWOULDBLOCK ) break;
+            closeConnection ( conn );
+            return;
+        }
+        if ( r == 0 ) {
+            eof = true;
+            break;
+        }
+        conn->input.append ( buffer, r );
+        conn->lastActivity = time ( NULL );
+    }
+
+    if ( conn->http ) {
+        readHttpRequests ( conn );
+        if ( eof ) {
+            // Le client n'enverra plus rien, mais peut encore attendre les réponses à ses requêtes
+            if ( conn->httpQueue.empty() && conn->output.empty() ) {
+                closeConnection ( conn );
+                return;
+            }
+            conn->closing = true;
+            conn->inputClosed = true;
+            updateEvents ( conn );
+        }
+        if ( ! conn->output.empty() ) writeConnection ( conn );
+        return;
+    }
+
+    if ( eof ) {
+        // Le serveur web a fermé la connexion
+        closeConnection ( conn );
+        return;
+    }
+
+    size_t pos = 0;
+    while ( conn->input.size() - pos >= FCGI_HEADER_LEN ) {
+        const unsigned char* header = ( const unsigned char* ) conn->input.data() + pos;
+        int length = ( header[4] << 8 ) | header[5];
+        int padding = header[6];
+        if ( conn->input.size() - pos < FCGI_HEADER_LEN + length + padding ) break;
+
+        if ( header[0] != FCGI_VERSION_1 ) {
+            LOGGER_ERROR ( "Version du protocole FastCGI non gérée : " << ( int ) header[0] );
+            closeConnection ( conn );
+            return;
+        }
+
+        if ( ! handleRecord ( conn, header[1], ( header[2] << 8 ) | header[3], header + FCGI_HEADER_LEN, length ) ) {
+            closeConnection ( conn );
+            return;
+        }
+        pos += FCGI_HEADER_LEN + length + padding;
+    }
+    conn->input.erase ( 0, pos );
+
+    if ( ! conn->output.empty() ) writeConnection ( conn );
+}
+
+bool FcgiDispatcher::handleRecord ( FcgiConnection* conn, int type, int requestId, const unsigned char* content, int length ) {
+
+    if ( requestId == FCGI_NULL_REQUEST_ID ) {
+        if ( type == FCGI_GET_VALUES ) {
+            // Le serveur web s'informe de nos capacités : multiplexage possible
+            std::string values;
+            const char* names[3] = { FCGI_MAX_CONNS, FCGI_MAX_REQS, FCGI_MPXS_CONNS };
+            const char* answers[3] = { "10000", "10000", "1" };
+            for ( int i = 0; i < 3; i++ ) {
+                values.push_back ( ( char ) strlen ( names[i] ) );
+                values.push_back ( ( char ) strlen ( answers[i] ) );
+                values.append ( names[i] );
+                values.append ( answers[i] );
+            }
+            std::string result;
+            appendRecord ( result, FCGI_GET_VALUES_RESULT, 0, values.data(), values.size() );
+            queueOutput ( conn->output, result );
+        } else {
+            unsigned char body[8] = { ( unsigned char ) type, 0, 0, 0, 0, 0, 0, 0 };
+            std::string unknown;
+            appendRecord ( unknown, FCGI_UNKNOWN_TYPE, 0, ( char* ) body, 8 );
+            queueOutput ( conn->output, unknown );
+        }
+        return true;
+    }
+
+    if ( type == FCGI_BEGIN_REQUEST ) {
+        if ( length < 8 ) return false;
+        int role = ( content[0] << 8 ) | content[1];
+        conn->keepConnection = ( content[2] & FCGI_KEEP_CONN );
+        if ( role != FCGI_RESPONDER ) {
+            std::string end;
+            appendEndRequest ( end, requestId, 0, FCGI_UNKNOWN_ROLE );
+            queueOutput ( conn->output, end );
+            return true;
+        }
+        if ( conn->receiving.find ( requestId ) != conn->receiving.end() ) return false;
+        conn->receiving.insert ( std::pair<int, FcgiJob*> ( requestId, new FcgiJob ( conn->id, requestId, this ) ) );
+        return true;
+    }
+
+    std::map<int, FcgiJob*>::iterator it = conn->receiving.find ( requestId );
+
+    if ( type == FCGI_ABORT_REQUEST ) {
+        if ( it != conn->receiving.end() ) {
+            delete it->second;
+            conn->receiving.erase ( it );
+            abortedRequests++;
+            std::string end;
+            appendEndRequest ( end, requestId, 0, FCGI_REQUEST_COMPLETE );
+            queueOutput ( conn->output, end );
+        } else {
+            pthread_mutex_lock ( &mtx );
+            std::set<FcgiJob*>::iterator itp;
+            for ( itp = conn->processing.begin(); itp != conn->processing.end(); ++itp ) {
+                if ( ( *itp )->requestId == requestId && ! ( *itp )->aborted ) {
+                    ( *itp )->aborted = true;
+                    abortedRequests++;
+                }
+            }
+            pthread_mutex_unlock ( &mtx );
+        }
+        return true;
+    }
+
+    // Enregistrement d'une requête inconnue ou déjà complète : ignoré
+    if ( it == conn->receiving.end() ) return true;
+    FcgiJob* job = it->second;
+
+    if ( type == FCGI_PARAMS ) {
+        if ( length == 0 ) job->paramsDone = true;
+        else job->rawParams.append ( ( const char* ) content, length );
+    } else if ( type == FCGI_STDIN ) {
+        if ( length == 0 ) {
+            if ( ! job->paramsDone || ! job->prepare ( listenSock, conn->keepConnection ) ) {
+                LOGGER_ERROR ( "Requête FastCGI mal formée" );
+                return false;
+            }
+            conn->receiving.erase ( it );
+            dispatch ( conn, job );
+        } else {
+            job->content.append ( ( const char* ) content, length );
+        }
+    }
+    // Les enregistrements FCGI_DATA ne concernent que le rôle filtre
+
+    return true;
+}
+
+void FcgiDispatcher::dispatch ( FcgiConnection* conn, FcgiJob* job ) {
+    if ( workersStop ) {
+        // Arrêt en cours : les threads de traitement ne prennent plus de nouvelle requête
+        if ( conn->http ) {
+            delete job;
+            httpError ( conn, "503 Service Unavailable" );
+        } else {
+            std::string end;
+            appendEndRequest ( end, job->requestId, 0, FCGI_OVERLOADED );
+            queueOutput ( conn->output, end );
+            delete job;
+        }
+        return;
+    }
+
+    if ( conn->http ) conn->httpQueue.push_back ( job );
+    conn->processing.insert ( job );
+    inFlight++;
+    if ( inFlight > maxInFlight ) maxInFlight = inFlight;
+
+    pthread_mutex_lock ( &mtx );
+    jobs.push_back ( job );
+    pthread_cond_signal ( &cond );
+    pthread_mutex_unlock ( &mtx );
+}
+
+void FcgiDispatcher::processOutputs() {
+    std::deque<std::pair<FcgiJob*, std::pair<OutputPart, bool> > > pending;
+    pthread_mutex_lock ( &mtx );
+    pending.swap ( outputs );
+    pthread_mutex_unlock ( &mtx );
+
+    std::set<uint64_t> touched;
+    for ( int i = 0; i < pending.size(); i++ ) {
+        FcgiJob* job = pending.at ( i ).first;
+        std::map<uint64_t, FcgiConnection*>::iterator it = connections.find ( job->connection );
+
+        if ( it != connections.end() && it->second->http ) {
+            // Seule la réponse à la plus ancienne requête est envoyée au fil de l'eau, les suivantes attendent leur tour
+            FcgiConnection* conn = it->second;
+            bool current = ( conn->httpQueue.front() == job );
+            translateHttp ( job, pending.at ( i ).second.first, pending.at ( i ).second.second, current ? conn->output : job->pending );
+            if ( pending.at ( i ).second.second ) {
+                conn->processing.erase ( job );
+                job->finished = true;
+                inFlight--;
+                processedRequests++;
+                if ( current ) flushHttpQueue ( conn );
+            }
+            touched.insert ( conn->id );
+            continue;
+        }
+
+        if ( it != connections.end() ) {
+            FcgiConnection* conn = it->second;
+            queueOutput ( conn->output, pending.at ( i ).second.first );
+            if ( pending.at ( i ).second.second ) {
+                conn->processing.erase ( job );
+                if ( ! conn->keepConnection ) conn->closing = true;
+            }
+            touched.insert ( conn->id );
+        }
+
+        if ( pending.at ( i ).second.second ) {
+            // Fin du traitement : la requête n'est plus référencée par aucun thread
+            inFlight--;
+            processedRequests++;
+            delete job;
+        }
+    }
+
+    std::set<uint64_t>::iterator itt;
+    for ( itt = touched.begin(); itt != touched.end(); ++itt ) {
+        std::map<uint64_t, FcgiConnection*>::iterator it = connections.find ( *itt );
+        if ( it == connections.end() ) continue;
+        // Des requêtes HTTP attendaient peut-être de la place dans la file
+        if ( it->second->http ) readHttpRequests ( it->second );
+        writeConnection ( it->second );
+    }
+}
+
+/********************************************** HTTP */
+
+// Date au format HTTP (RFC 7231)
+static std::string httpDate() {
+    char date[64];
+    time_t now = time ( NULL );
+    struct tm gmt;
+    gmtime_r ( &now, &gmt );
+    strftime ( date, sizeof ( date ), "%a, %d %b %Y %H:%M:%S GMT", &gmt );
+    return std::string ( date );
+}
+
+static std::string toLower ( std::string s ) {
+    for ( int i = 0; i < s.size(); i++ ) s[i] = tolower ( s[i] );
+    return s;
+}
+
+static std::string trim ( const std::string& s ) {
+    size_t begin = s.find_first_not_of ( " \t" );
+    if ( begin == std::string::npos ) return "";
+    size_t end = s.find_last_not_of ( " \t\r" );
+    return s.substr ( begin, end - begin + 1 );
+}
+
+void FcgiDispatcher::httpError ( FcgiConnection* conn, std::string status ) {
+    LOGGER_DEBUG ( "Requête HTTP refusée : " << status );
+
+    // Réponse sans traitement, envoyée à son tour après celles des requêtes précédentes
+    FcgiJob* job = new FcgiJob ( conn->id, 0, this );
+    job->http = true;
+    job->finished = true;
+    std::string response = "HTTP/1.1 " + status + "\r\nDate: " + httpDate() + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    queueOutput ( job->pending, response );
+
+    conn->httpQueue.push_back ( job );
+    conn->closing = true;
+    flushHttpQueue ( conn );
+}
+
+void FcgiDispatcher::readHttpRequests ( FcgiConnection* conn ) {
+
+    // Une requête HTTP/1.0 ou demandant la fermeture est la dernière de la connexion : pas de pipelining au-delà
+    while ( ! conn->closing && conn->httpQueue.size() < FCGI_DISPATCHER_HTTP_PIPELINE
+            && ( conn->httpQueue.empty() || conn->httpQueue.back()->http11 ) ) {
+
+        // Lignes vides tolérées avant la ligne de requête
+        size_t start = conn->input.find_first_not_of ( "\r\n" );
+        if ( start == std::string::npos ) {
+            conn->input.clear();
+            return;
+        }
+        if ( start > 0 ) conn->input.erase ( 0, start );
+
+        size_t headerEnd = conn->input.find ( "\r\n\r\n" );
+        if ( headerEnd == std::string::npos ) {
+            if ( conn->input.size() > FCGI_DISPATCHER_HTTP_MAX_HEADER ) httpError ( conn, "431 Request Header Fields Too Large" );
+            // Le délai court depuis le premier octet de la requête, un client envoyant son en-tête au compte-gouttes ne le repousse pas
+            else if ( conn->requestDeadline == 0 ) conn->requestDeadline = time ( NULL ) + headerTimeout;
+            return;
+        }
+        if ( headerEnd > FCGI_DISPATCHER_HTTP_MAX_HEADER ) {
+            httpError ( conn, "431 Request Header Fields Too Large" );
+            return;
+        }
+
+        // Ligne de requête
+        size_t lineEnd = conn->input.find ( "\r\n" );
+        std::string requestLine = conn->input.substr ( 0, lineEnd );
+        size_t sp1 = requestLine.find ( ' ' );
+        size_t sp2 = requestLine.rfind ( ' ' );
+        if ( sp1 == std::string::npos || sp2 == sp1 ) {
+            httpError ( conn, "400 Bad Request" );
+            return;
+        }
+        std::string method = requestLine.substr ( 0, sp1 );
+        std::string target = trim ( requestLine.substr ( sp1 + 1, sp2 - sp1 - 1 ) );
+        std::string version = requestLine.substr ( sp2 + 1 );
+        if ( version.compare ( 0, 7, "HTTP/1." ) != 0 || target.empty() ) {
+            httpError ( conn, version.compare ( 0, 5, "HTTP/" ) == 0 ? "505 HTTP Version Not Supported" : "400 Bad Request" );
+            return;
+        }
+
+        FcgiJob* job = new FcgiJob ( conn->id, 1, this );
+        job->http = true;
+        job->http11 = ( version != "HTTP/1.0" );
+        job->head = ( method == "HEAD" );
+
+        // En-têtes, transmis au traitement comme le ferait un serveur web
+        bool hasHost = false, closeAsked = false, keepAliveAsked = false, expectContinue = false, unsupportedEncoding = false;
+        size_t contentLength = 0;
+        size_t pos = lineEnd + 2;
+        while ( pos < headerEnd ) {
+            size_t end = conn->input.find ( "\r\n", pos );
+            std::string line = conn->input.substr ( pos, end - pos );
+            pos = end + 2;
+
+            size_t colon = line.find ( ':' );
+            if ( colon == std::string::npos || colon == 0 ) {
+                delete job;
+                httpError ( conn, "400 Bad Request" );
+                return;
+            }
+            std::string name = line.substr ( 0, colon );
+            std::string value = trim ( line.substr ( colon + 1 ) );
+            std::string lname = toLower ( name );
+
+            if ( lname == "content-length" ) {
+                contentLength = strtoull ( value.c_str(), NULL, 10 );
+                job->env.push_back ( "CONTENT_LENGTH=" + value );
+                continue;
+            }
+            if ( lname == "content-type" ) {
+                job->env.push_back ( "CONTENT_TYPE=" + value );
+                continue;
+            }
+            if ( lname == "host" ) hasHost = true;
+            if ( lname == "transfer-encoding" && toLower ( value ) != "identity" ) unsupportedEncoding = true;
+            if ( lname == "connection" ) {
+                std::string lvalue = toLower ( value );
+                if ( lvalue.find ( "close" ) != std::string::npos ) closeAsked = true;
+                if ( lvalue.find ( "keep-alive" ) != std::string::npos ) keepAliveAsked = true;
+            }
+            if ( lname == "expect" && toLower ( value ) == "100-continue" ) expectContinue = true;
+
+            std::string envName = "HTTP_";
+            for ( int i = 0; i < name.size(); i++ ) envName.push_back ( name[i] == '-' ? '_' : toupper ( name[i] ) );
+            job->env.push_back ( envName + "=" + value );
+        }
+
+        if ( unsupportedEncoding ) {
+            delete job;
+            httpError ( conn, "501 Not Implemented" );
+            return;
+        }
+        if ( job->http11 && ! hasHost ) {
+            delete job;
+            httpError ( conn, "400 Bad Request" );
+            return;
+        }
+        if ( contentLength > FCGI_DISPATCHER_HTTP_MAX_BODY ) {
+            delete job;
+            httpError ( conn, "413 Payload Too Large" );
+            return;
+        }
+
+        if ( conn->input.size() < headerEnd + 4 + contentLength ) {
+            // Corps incomplet : la requête sera de nouveau interprétée à la réception de la suite
+            if ( expectContinue && job->http11 && ! conn->continueSent && conn->httpQueue.empty() ) {
+                std::string interim = "HTTP/1.1 100 Continue\r\n\r\n";
+                queueOutput ( conn->output, interim );
+                conn->continueSent = true;
+            }
+            if ( ! conn->readingBody ) {
+                conn->readingBody = true;
+                conn->requestDeadline = time ( NULL ) + bodyTimeout;
+            }
+            delete job;
+            return;
+        }
+
+        job->content = conn->input.substr ( headerEnd + 4, contentLength );
+        conn->input.erase ( 0, headerEnd + 4 + contentLength );
+        conn->continueSent = false;
+        conn->requestDeadline = 0;
+        conn->readingBody = false;
+
+        job->keepAlive = job->http11 ? ! closeAsked : keepAliveAsked;
+        if ( ! job->keepAlive ) conn->closing = true;
+
+        // Forme absolue (http://hote/chemin?requete) ou usuelle (/chemin?requete)
+        std::string path = target;
+        if ( path.compare ( 0, 7, "http://" ) == 0 || path.compare ( 0, 8, "https://" ) == 0 ) {
+            size_t slash = path.find ( '/', path.find ( "//" ) + 2 );
+            path = ( slash == std::string::npos ) ? "/" : path.substr ( slash );
+        }
+        std::string query;
+        size_t question = path.find ( '?' );
+        if ( question != std::string::npos ) {
+            query = path.substr ( question + 1 );
+            path = path.substr ( 0, question );
+        }
+
+        job->env.push_back ( "GATEWAY_INTERFACE=CGI/1.1" );
+        job->env.push_back ( "SERVER_PROTOCOL=" + version );
+        job->env.push_back ( "REQUEST_METHOD=" + method );
+        job->env.push_back ( "REQUEST_URI=" + target );
+        job->env.push_back ( "SCRIPT_NAME=" + path );
+        job->env.push_back ( "QUERY_STRING=" + query );
+        job->env.push_back ( "REMOTE_ADDR=" + conn->remoteAddr );
+
+        job->prepare ( httpListenSock, job->keepAlive );
+        httpRequests++;
+        dispatch ( conn, job );
+    }
+}
+
+void FcgiDispatcher::translateHttp ( FcgiJob* job, OutputPart& part, bool done, std::deque<OutputPart>& target ) {
+
+    if ( ! job->headersDone ) {
+        // Les en-têtes sont transmis avant tout tampon partagé : une portion de tampon n'est recopiée ici que par exception
+        job->cgiHeaders.append ( part.begin(), part.size() );
+        OutputPart consumed;
+        part.swap ( consumed );
+
+        size_t end = job->cgiHeaders.find ( "\r\n\r\n" );
+        size_t separator = 4;
+        if ( end == std::string::npos ) {
+            end = job->cgiHeaders.find ( "\n\n" );
+            separator = 2;
+        }
+        if ( end == std::string::npos ) {
+            if ( ! done ) return;
+            end = job->cgiHeaders.size();
+            separator = 0;
+        }
+        std::string body = job->cgiHeaders.substr ( end + separator );
+
+        // En-têtes CGI : Status devient la ligne de statut, les autres sont recopiés
+        std::string status, headers;
+        bool hasLength = false, hasLocation = false;
+        size_t pos = 0;
+        while ( pos < end ) {
+            size_t lineEnd = job->cgiHeaders.find ( '\n', pos );
+            if ( lineEnd == std::string::npos || lineEnd > end ) lineEnd = end;
+            std::string line = job->cgiHeaders.substr ( pos, lineEnd - pos );
+            pos = lineEnd + 1;
+            if ( ! line.empty() && line[line.size() - 1] == '\r' ) line.erase ( line.size() - 1 );
+
+            size_t colon = line.find ( ':' );
+            if ( colon == std::string::npos ) continue;
+            std::string name = line.substr ( 0, colon );
+            std::string value = trim ( line.substr ( colon + 1 ) );
+            std::string lname = toLower ( name );
+
+            if ( lname == "status" ) {
+                status = value;
+                continue;
+            }
+            // La connexion et le découpage sont gérés ici
+            if ( lname == "connection" || lname == "transfer-encoding" ) continue;
+            if ( lname == "content-length" ) hasLength = true;
+            if ( lname == "location" ) hasLocation = true;
+            headers.append ( name + ": " + value + "\r\n" );
+        }
+        if ( status.empty() ) {
+            if ( end == 0 && done ) status = "500 Internal Server Error";
+            else status = hasLocation ? "302 Found" : "200 OK";
+        }
+        job->cgiHeaders.clear();
+
+        int code = atoi ( status.c_str() );
+        job->bodyless = job->head || code == 204 || code == 304 || ( code >= 100 && code < 200 );
+        if ( ( ! job->bodyless || job->head ) && ! hasLength ) {
+            if ( done ) {
+                // Tout le corps est connu (pour HEAD, la longueur est celle qu'aurait eu le corps)
+                char length[32];
+                snprintf ( length, sizeof ( length ), "%lu", ( unsigned long ) body.size() );
+                headers.append ( std::string ( "Content-Length: " ) + length + "\r\n" );
+            } else if ( job->bodyless ) {
+                // HEAD dont le corps aurait été envoyé par morceaux : aucune longueur annoncée
+            } else if ( job->http11 ) {
+                headers.append ( "Transfer-Encoding: chunked\r\n" );
+                job->chunked = true;
+            } else {
+                // HTTP/1.0 : la fin du corps est signalée par la fermeture de la connexion
+                job->keepAlive = false;
+            }
+        }
+        if ( ! job->keepAlive ) headers.append ( "Connection: close\r\n" );
+        else if ( ! job->http11 ) headers.append ( "Connection: keep-alive\r\n" );
+
+        std::string response = ( job->http11 ? "HTTP/1.1 " : "HTTP/1.0 " ) + status + "\r\nDate: " + httpDate() + "\r\n" + headers + "\r\n";
+        queueOutput ( target, response );
+        job->headersDone = true;
+        part.data.swap ( body );
+    }
+
+    if ( ! job->bodyless && part.size() > 0 ) {
+        if ( job->chunked ) {
+            char size[32];
+            snprintf ( size, sizeof ( size ), "%lx\r\n", ( unsigned long ) part.size() );
+            std::string chunkHeader ( size ), chunkEnd ( "\r\n" );
+            queueOutput ( target, chunkHeader );
+            queueOutput ( target, part );
+            queueOutput ( target, chunkEnd );
+        } else {
+            queueOutput ( target, part );
+        }
+    }
+    OutputPart consumed;
+    part.swap ( consumed );
+
+    if ( done && job->chunked ) {
+        std::string last ( "0\r\n\r\n" );
+        queueOutput ( target, last );
+    }
+}
+
+void FcgiDispatcher::flushHttpQueue ( FcgiConnection* conn ) {
+    while ( ! conn->httpQueue.empty() ) {
+        FcgiJob* job = conn->httpQueue.front();
+        while ( ! job->pending.empty() ) {
+            queueOutput ( conn->output, job->pending.front() );
+            job->pending.pop_front();
+        }
+        if ( ! job->finished ) break;
+
+        // Réponse complète : au tour de la requête suivante
+        conn->httpQueue.pop_front();
+        if ( ! job->keepAlive ) conn->closing = true;
+        delete job;
+    }
+}
+
+void FcgiDispatcher::run() {
+
+    epollFd = epoll_create1 ( EPOLL_CLOEXEC );
+    if ( epollFd < 0 || wakeFd < 0 ) {
+        LOGGER_FATAL ( "Impossible d'initialiser la boucle d'évènements FastCGI : " << strerror ( errno ) );
+        return;
+    }
+
+    fcntl ( listenSock, F_SETFL, fcntl ( listenSock, F_GETFL ) | O_NONBLOCK );
+
+    struct epoll_event ev;
+    memset ( &ev, 0, sizeof ( ev ) );
+    ev.events = EPOLLIN;
+    ev.data.u64 = EPOLL_LISTEN_ID;
+    if ( epoll_ctl ( epollFd, EPOLL_CTL_ADD, listenSock, &ev ) != 0 ) {
+        LOGGER_FATAL ( "Le listener FCGI ne peut etre initialise : " << strerror ( errno ) );
+        close ( epollFd );
+        epollFd = -1;
+        return;
+    }
+    ev.data.u64 = EPOLL_WAKE_ID;
+    epoll_ctl ( epollFd, EPOLL_CTL_ADD, wakeFd, &ev );
+
+    if ( httpListenSock >= 0 ) {
+        fcntl ( httpListenSock, F_SETFL, fcntl ( httpListenSock, F_GETFL ) | O_NONBLOCK );
+        ev.data.u64 = EPOLL_HTTP_LISTEN_ID;
+        if ( epoll_ctl ( epollFd, EPOLL_CTL_ADD, httpListenSock, &ev ) != 0 ) {
+            LOGGER_ERROR ( "Le listener HTTP ne peut etre initialise : " << strerror ( errno ) );
+        }
+    }
+
+    for ( int i = 0; i < workers.size(); i++ ) {
+        pthread_create ( & ( workers[i] ), NULL, FcgiDispatcher::workerLoop, ( void* ) this );
+    }
+    pthread_create ( &storageThread, NULL, FcgiDispatcher::storageLoop, ( void* ) this );
+
+    bool accepting = true;
+    time_t stopDate = 0, lastCheck = 0;
+    struct epoll_event events[256];
+
+    while ( true ) {
+
+        if ( stopping && accepting ) {
+            // Plus de nouvelle connexion, les requêtes déjà reçues sont traitées et leurs réponses envoyées
+            LOGGER_DEBUG ( "Arrêt de la boucle d'évènements FastCGI" );
+            if ( acceptPause == 0 ) watchListeners ( false );
+            acceptPause = 0;
+            accepting = false;
+            stopDate = time ( NULL );
+
+            pthread_mutex_lock ( &mtx );
+            workersStop = true;
+            pthread_cond_broadcast ( &cond );
+            pthread_mutex_unlock ( &mtx );
+
+            std::vector<FcgiConnection*> idle;
+            std::map<uint64_t, FcgiConnection*>::iterator it;
+            for ( it = connections.begin(); it != connections.end(); ++it ) {
+                it->second->closing = true;
+                if ( it->second->processing.empty() && it->second->httpQueue.empty() && it->second->output.empty() ) idle.push_back ( it->second );
+            }
+            for ( int i = 0; i < idle.size(); i++ ) closeConnection ( idle.at ( i ) );
+        }
+
+        if ( ! accepting ) {
+            if ( inFlight == 0 && ( connections.empty() || time ( NULL ) - stopDate > FCGI_DISPATCHER_SHUTDOWN_DELAY ) ) break;
+        }
+
+        // Réveil au moins chaque seconde pour vérifier les délais des connexions
+        int n = epoll_wait ( epollFd, events, 256, 1000 );
+        if ( n < 0 ) {
+            if ( errno == EINTR ) continue;
+            LOGGER_ERROR ( "Erreur de la boucle d'évènements FastCGI : " << strerror ( errno ) );
+            break;
+        }
+
+        time_t now = time ( NULL );
+        if ( now != lastCheck ) {
+            lastCheck = now;
+            checkDeadlines ( now );
+            if ( acceptPause != 0 && now >= acceptPause ) {
+                acceptPause = 0;
+                watchListeners ( true );
+            }
+        }
+
+        for ( int i = 0; i < n; i++ ) {
+            uint64_t id = events[i].data.u64;
+
+            if ( id == EPOLL_LISTEN_ID || id == EPOLL_HTTP_LISTEN_ID ) {
+                if ( accepting && acceptPause == 0 ) {
+                    if ( id == EPOLL_LISTEN_ID ) acceptConnections ( listenSock, false );
+                    else acceptConnections ( httpListenSock, true );
+                }
+                continue;
+            }
+
+            if ( id == EPOLL_WAKE_ID ) {
+                uint64_t count;
+                while ( read ( wakeFd, &count, sizeof ( count ) ) > 0 );
+                processOutputs();
+                continue;
+            }
+
+            // La connexion a pu être fermée par un évènement précédent
+            std::map<uint64_t, FcgiConnection*>::iterator it = connections.find ( id );
+            if ( it == connections.end() ) continue;
+            FcgiConnection* conn = it->second;
+
+            if ( conn->inputClosed && ( events[i].events & ( EPOLLHUP | EPOLLERR ) ) ) {
+                // Le client a complètement fermé la connexion
+                closeConnection ( conn );
+                continue;
+            }
+            if ( events[i].events & EPOLLOUT ) {
+                if ( ! writeConnection ( conn ) ) continue;
+            }
+            if ( events[i].events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) {
+                readConnection ( conn );
+            }
+        }
+    }
+
+    // Les threads de traitement ont terminé la file
+    pthread_mutex_lock ( &mtx );
+    workersStop = true;
+    pthread_cond_broadcast ( &cond );
+    pthread_mutex_unlock ( &mtx );
+    for ( int i = 0; i < workers.size(); i++ ) {
+        pthread_join ( workers[i], NULL );
+    }
+    // Plus aucune requête ne peut être mise en attente
+    pthread_mutex_lock ( &mtx );
+    storageStop = true;
+    pthread_cond_signal ( &storageCond );
+    pthread_mutex_unlock ( &mtx );
+    pthread_join ( storageThread, NULL );
+    processOutputs();
+
+    while ( ! connections.empty() ) {
+        closeConnection ( connections.begin()->second );
+    }
+    close ( epollFd );
+    epollFd = -1;
+}
+
+void FcgiDispatcher::printStats() {
+    LOGGER_INFO ( "Frontal FastCGI : " << acceptedConnections << " connexions acceptées, " << processedRequests << " requêtes traitées (dont "
+        << httpRequests << " reçues en HTTP), " << abortedRequests << " requêtes interrompues, " << parkedRequests << " mises en attente de lectures, " << maxInFlight << " requêtes simultanées au maximum" );
+}
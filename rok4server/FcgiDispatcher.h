@@ -0,0 +1,1060 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file FcgiDispatcher.h
+ ** \~french
+ * \brief Définition des classes FcgiDispatcher, FcgiConnection et FcgiJob
+ * \details Le répartiteur reçoit les requêtes en FastCGI et, optionnellement, directement en HTTP/1.1.
+ ** \~english
+ * \brief Define classes FcgiDispatcher, FcgiConnection and FcgiJob
+ * \details Dispatcher receives requests through FastCGI and, optionally, directly through HTTP/1.1.
+ */
+
+#ifndef FCGIDISPATCHER_H
+#define FCGIDISPATCHER_H
+
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "fcgiapp.h"
+#include "BufferPool.h"
+#include "Context.h"
+
+/**
+ * \~french \brief Taille des tampons de sortie d'une requête, en octets
+ * \~english \brief Request's output buffers size, in bytes
+ */
+#define FCGI_DISPATCHER_BUFFER_SIZE 65528
+
+/**
+ * \~french \brief Délai maximal d'envoi des réponses en cours lors de l'arrêt, en secondes
+ * \~english \brief Max delay to send pending responses during shutdown, in seconds
+ */
+#define FCGI_DISPATCHER_SHUTDOWN_DELAY 30
+
+/**
+ * \~french \brief Taille maximale de l'en-tête d'une requête HTTP, en octets
+ * \~english \brief Max HTTP request's header size, in bytes
+ */
+#define FCGI_DISPATCHER_HTTP_MAX_HEADER 65536
+
+/**
+ * \~french \brief Taille maximale du corps d'une requête HTTP, en octets
+ * \~english \brief Max HTTP request's body size, in bytes
+ */
+#define FCGI_DISPATCHER_HTTP_MAX_BODY 16777216
+
+/**
+ * \~french \brief Nombre maximal de requêtes HTTP en attente de réponse sur une même connexion (pipelining)
+ * \~english \brief Max number of HTTP requests waiting for their response on the same connection (pipelining)
+ */
+#define FCGI_DISPATCHER_HTTP_PIPELINE 32
+
+/**
+ * \~french \brief Durée maximale d'inactivité d'une connexion HTTP gardée entre deux requêtes, en secondes
+ * \~english \brief Max idle duration of an HTTP connection kept between two requests, in seconds
+ */
+#define FCGI_DISPATCHER_HTTP_IDLE_TIMEOUT 60
+
+/**
+ * \~french \brief Délai maximal de réception de l'en-tête d'une requête HTTP, depuis son premier octet, en secondes
+ * \~english \brief Max delay to receive an HTTP request's header, from its first byte, in seconds
+ */
+#define FCGI_DISPATCHER_HTTP_HEADER_TIMEOUT 20
+
+/**
+ * \~french \brief Délai maximal de réception du corps d'une requête HTTP, depuis la fin de son en-tête, en secondes
+ * \~english \brief Max delay to receive an HTTP request's body, from its header's end, in seconds
+ */
+#define FCGI_DISPATCHER_HTTP_BODY_TIMEOUT 60
+
+/**
+ * \~french \brief Durée pendant laquelle les sockets d'écoute ne sont plus surveillées après un manque de descripteurs, en secondes
+ * \~english \brief Duration while listening sockets are not watched anymore after a lack of descriptors, in seconds
+ */
+#define FCGI_DISPATCHER_ACCEPT_BACKOFF 1
+
+/**
+ * \~french \brief Fonction traitant une requête FastCGI complète
+ * \details Les paramètres et le corps de la requête sont lisibles avec les fonctions de la libfcgi (FCGX_GetParam, FCGX_GetLine...), la réponse est écrite avec FCGX_PutStr.
+ * \~english \brief Function processing a complete FastCGI request
+ * \details Request's parameters and body are readable with libfcgi functions (FCGX_GetParam, FCGX_GetLine...), response is written with FCGX_PutStr.
+ */
+typedef void ( *FcgiHandler ) ( FCGX_Request* fcgxRequest, void* arg );
+
+/**
+ * \~french \brief Fonction reprenant une requête mise en attente de lectures (cf FcgiDispatcher::parkReads)
+ * \details Les lectures sont terminées. La fonction termine le traitement de la requête, ou la remet en attente, et libère son état.
+ * \~english \brief Function resuming a request parked waiting for readings (see FcgiDispatcher::parkReads)
+ * \details Readings are done. Function ends the request's processing, or parks it again, and frees its state.
+ */
+typedef void ( *FcgiResume ) ( FCGX_Request* fcgxRequest, void* state );
+
+class FcgiDispatcher;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Morceau de réponse à envoyer : octets possédés, ou portion d'un tampon partagé
+ * \details Une portion de tampon partagé (PooledBuffer) est envoyée sans copie, le morceau détenant une référence au tampon jusqu'à sa destruction.
+ * \~english
+ * \brief Response's part to send : owned bytes, or portion of a shared buffer
+ * \details A shared buffer's (PooledBuffer) portion is sent without copy, the part holding a reference to the buffer until its destruction.
+ */
+class OutputPart {
+
+public:
+
+    /**
+     * \~french \brief Octets possédés, utilisés en l'absence de tampon
+     * \~english \brief Owned bytes, used without buffer
+     */
+    std::string data;
+
+    /**
+     * \~french \brief Tampon partagé, NULL si absent
+     * \~english \brief Shared buffer, NULL if missing
+     */
+    PooledBuffer* buffer;
+
+    /**
+     * \~french \brief Début et taille de la portion du tampon
+     * \~english \brief Buffer's portion start and size
+     */
+    size_t offset, length;
+
+    /**
+     * \~french \brief Constructeur d'un morceau vide
+     * \~english \brief Empty part constructor
+     */
+    OutputPart() : buffer ( NULL ), offset ( 0 ), length ( 0 ) {}
+
+    /**
+     * \~french \brief Constructeur d'une portion de tampon partagé
+     * \~english \brief Shared buffer's portion constructor
+     */
+    OutputPart ( PooledBuffer* b, size_t o, size_t l ) : buffer ( b ), offset ( o ), length ( l ) {
+        buffer->retain();
+    }
+
+    OutputPart ( const OutputPart& other ) : data ( other.data ), buffer ( other.buffer ), offset ( other.offset ), length ( other.length ) {
+        if ( buffer ) buffer->retain();
+    }
+
+    OutputPart& operator= ( const OutputPart& other ) {
+        if ( other.buffer ) other.buffer->retain();
+        if ( buffer ) buffer->release();
+        data = other.data;
+        buffer = other.buffer;
+        offset = other.offset;
+        length = other.length;
+        return *this;
+    }
+
+    ~OutputPart() {
+        if ( buffer ) buffer->release();
+    }
+
+    /**
+     * \~french \brief Échange le contenu de deux morceaux, sans copie
+     * \~english \brief Swap two parts' content, without copy
+     */
+    void swap ( OutputPart& other ) {
+        data.swap ( other.data );
+        std::swap ( buffer, other.buffer );
+        std::swap ( offset, other.offset );
+        std::swap ( length, other.length );
+    }
+
+    /**
+     * \~french \brief Premier octet du morceau
+     * \~english \brief Part's first byte
+     */
+    const char* begin() const {
+        return buffer ? ( const char* ) buffer->getData() + offset : data.data();
+    }
+
+    /**
+     * \~french \brief Taille du morceau
+     * \~english \brief Part's size
+     */
+    size_t size() const {
+        return buffer ? length : data.size();
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Requête FastCGI, de sa réception à la fin de son traitement
+ * \details Les flux d'entrée et de sortie sont des FCGX_Stream en mémoire : le traitement n'accède jamais à la connexion.
+ * \~english
+ * \brief FastCGI request, from its reception to the end of its processing
+ * \details Input and output streams are in-memory FCGX_Stream : processing never accesses the connection.
+ */
+class FcgiJob {
+
+public:
+
+    /**
+     * \~french \brief Identifiant de la connexion de la requête
+     * \~english \brief Request's connection identifier
+     */
+    uint64_t connection;
+
+    /**
+     * \~french \brief Identifiant FastCGI de la requête sur sa connexion
+     * \~english \brief FastCGI request identifier on its connection
+     */
+    int requestId;
+
+    /**
+     * \~french \brief Répartiteur gérant la requête
+     * \~english \brief Dispatcher managing the request
+     */
+    FcgiDispatcher* dispatcher;
+
+    /**
+     * \~french \brief Paramètres encodés, en cours de réception
+     * \~english \brief Encoded parameters, being received
+     */
+    std::string rawParams;
+
+    /**
+     * \~french \brief Tous les paramètres ont été reçus
+     * \~english \brief All parameters have been received
+     */
+    bool paramsDone;
+
+    /**
+     * \~french \brief Corps de la requête
+     * \~english \brief Request's body
+     */
+    std::string content;
+
+    /**
+     * \~french \brief Paramètres décodés, sous la forme NOM=valeur
+     * \~english \brief Decoded parameters, as NAME=value
+     */
+    std::vector<std::string> env;
+
+    /**
+     * \~french \brief Tableau des paramètres, terminé par NULL, tel qu'attendu par FCGX_GetParam
+     * \~english \brief Parameters array, NULL terminated, as expected by FCGX_GetParam
+     */
+    std::vector<char*> envp;
+
+    /**
+     * \~french \brief Requête transmise au traitement
+     * \~english \brief Request given to processing
+     */
+    FCGX_Request fcgx;
+
+    /**
+     * \~french \brief Flux d'entrée, lisant #content
+     * \~english \brief Input stream, reading #content
+     */
+    FCGX_Stream in;
+
+    /**
+     * \~french \brief Flux de sortie standard
+     * \~english \brief Standard output stream
+     */
+    FCGX_Stream out;
+
+    /**
+     * \~french \brief Flux d'erreur
+     * \~english \brief Error stream
+     */
+    FCGX_Stream err;
+
+    /**
+     * \~french \brief Tampon du flux de sortie standard
+     * \~english \brief Standard output stream's buffer
+     */
+    unsigned char outBuffer[FCGI_DISPATCHER_BUFFER_SIZE];
+
+    /**
+     * \~french \brief Tampon du flux d'erreur
+     * \~english \brief Error stream's buffer
+     */
+    unsigned char errBuffer[1024];
+
+    /**
+     * \~french \brief La requête a été interrompue (par le serveur web ou par la fermeture de la connexion)
+     * \details Protégé par le verrou du répartiteur
+     * \~english \brief Request has been aborted (by the web server or by connection closing)
+     * \details Protected by dispatcher's lock
+     */
+    bool aborted;
+
+    /**
+     * \~french \brief La requête a été reçue en HTTP, et non en FastCGI
+     * \~english \brief Request has been received through HTTP, not FastCGI
+     */
+    bool http;
+
+    /**
+     * \~french \brief Requête HTTP/1.1 (sinon HTTP/1.0)
+     * \~english \brief HTTP/1.1 request (HTTP/1.0 otherwise)
+     */
+    bool http11;
+
+    /**
+     * \~french \brief Requête HTTP HEAD : le corps de la réponse n'est pas envoyé
+     * \~english \brief HTTP HEAD request : response's body is not sent
+     */
+    bool head;
+
+    /**
+     * \~french \brief La connexion HTTP est gardée après la réponse
+     * \~english \brief HTTP connection is kept after the response
+     */
+    bool keepAlive;
+
+    /**
+     * \~french \brief Les en-têtes CGI produits par le traitement ont été convertis en en-têtes HTTP
+     * \~english \brief CGI headers produced by processing have been converted to HTTP headers
+     */
+    bool headersDone;
+
+    /**
+     * \~french \brief La réponse HTTP est envoyée par morceaux (Transfer-Encoding: chunked)
+     * \~english \brief HTTP response is sent in chunks (Transfer-Encoding: chunked)
+     */
+    bool chunked;
+
+    /**
+     * \~french \brief La réponse HTTP n'a pas de corps (HEAD, 204, 304)
+     * \~english \brief HTTP response has no body (HEAD, 204, 304)
+     */
+    bool bodyless;
+
+    /**
+     * \~french \brief Le traitement est terminé
+     * \details Une réponse HTTP terminée attend que les réponses aux requêtes précédentes de la connexion soient envoyées.
+     * \~english \brief Processing is done
+     * \details A done HTTP response waits for responses to the connection's previous requests to be sent.
+     */
+    bool finished;
+
+    /**
+     * \~french \brief En-têtes CGI reçus du traitement, pas encore convertis
+     * \~english \brief CGI headers received from processing, not yet converted
+     */
+    std::string cgiHeaders;
+
+    /**
+     * \~french \brief Morceaux de la réponse HTTP en attente de leur tour
+     * \~english \brief HTTP response's parts waiting for their turn
+     */
+    std::deque<OutputPart> pending;
+
+    /**
+     * \~french \brief Reprise de la requête, non NULL si le traitement l'a mise en attente de lectures
+     * \~english \brief Request's resumption, not NULL if processing parked it waiting for readings
+     */
+    FcgiResume resume;
+
+    /**
+     * \~french \brief État passé à la reprise
+     * \~english \brief State given to resumption
+     */
+    void* resumeState;
+
+    /**
+     * \~french \brief Lectures attendues par la requête mise en attente, par contexte
+     * \~english \brief Readings waited for by the parked request, by context
+     */
+    std::map<Context*, std::vector<ContextRead*> > reads;
+
+    /**
+     * \~french \brief Constructeur
+     * \param[in] c Identifiant de la connexion
+     * \param[in] id Identifiant FastCGI de la requête
+     * \param[in] d Répartiteur
+     * \~english \brief Constructor
+     * \param[in] c Connection's identifier
+     * \param[in] id FastCGI request identifier
+     * \param[in] d Dispatcher
+     */
+    FcgiJob ( uint64_t c, int id, FcgiDispatcher* d ) : connection ( c ), requestId ( id ), dispatcher ( d ), paramsDone ( false ), aborted ( false ),
+        http ( false ), http11 ( false ), head ( false ), keepAlive ( false ), headersDone ( false ), chunked ( false ), bodyless ( false ), finished ( false ),
+        resume ( NULL ), resumeState ( NULL ) {}
+
+    /**
+     * \~french \brief Décode les paramètres reçus et prépare les flux
+     * \param[in] listenSock Socket d'écoute
+     * \param[in] keepConnection La connexion est gardée après la requête
+     * \return Faux si les paramètres sont mal encodés
+     * \~english \brief Decode received parameters and prepare streams
+     * \param[in] listenSock Listening socket
+     * \param[in] keepConnection Connection is kept after the request
+     * \return False if parameters are badly encoded
+     */
+    bool prepare ( int listenSock, bool keepConnection );
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Connexion d'un serveur web (FastCGI) ou d'un client HTTP, manipulée uniquement par la boucle d'évènements
+ * \~english
+ * \brief Web server's (FastCGI) or HTTP client's connection, handled only by the event loop
+ */
+class FcgiConnection {
+
+public:
+
+    /**
+     * \~french \brief Identifiant de la connexion, jamais réutilisé
+     * \~english \brief Connection's identifier, never reused
+     */
+    uint64_t id;
+
+    /**
+     * \~french \brief Descripteur de la socket
+     * \~english \brief Socket descriptor
+     */
+    int fd;
+
+    /**
+     * \~french \brief Octets reçus, pas encore interprétés
+     * \~english \brief Received bytes, not yet interpreted
+     */
+    std::string input;
+
+    /**
+     * \~french \brief Morceaux à envoyer, en une seule écriture groupée
+     * \~english \brief Parts to send, with a single gathering write
+     */
+    std::deque<OutputPart> output;
+
+    /**
+     * \~french \brief Nombre d'octets du premier morceau de #output déjà envoyés
+     * \~english \brief Number of already sent bytes of #output's first part
+     */
+    size_t outputOffset;
+
+    /**
+     * \~french \brief Connexion HTTP, et non FastCGI
+     * \~english \brief HTTP connection, not FastCGI
+     */
+    bool http;
+
+    /**
+     * \~french \brief Adresse du client HTTP
+     * \~english \brief HTTP client's address
+     */
+    std::string remoteAddr;
+
+    /**
+     * \~french \brief Requêtes HTTP dans l'ordre de réception, les réponses devant être envoyées dans cet ordre
+     * \~english \brief HTTP requests in reception order, responses having to be sent in this order
+     */
+    std::deque<FcgiJob*> httpQueue;
+
+    /**
+     * \~french \brief La réponse intermédiaire 100 Continue a été envoyée pour la requête HTTP en cours de réception
+     * \~english \brief Interim response 100 Continue has been sent for the HTTP request being received
+     */
+    bool continueSent;
+
+    /**
+     * \~french \brief Le client HTTP a fermé son sens d'émission, les réponses en cours sont tout de même envoyées
+     * \~english \brief HTTP client closed its sending way, pending responses are sent anyway
+     */
+    bool inputClosed;
+
+    /**
+     * \~french \brief Requêtes en cours de réception
+     * \~english \brief Requests being received
+     */
+    std::map<int, FcgiJob*> receiving;
+
+    /**
+     * \~french \brief Requêtes confiées aux threads de traitement
+     * \~english \brief Requests given to processing threads
+     */
+    std::set<FcgiJob*> processing;
+
+    /**
+     * \~french \brief La connexion est gardée après la fin d'une requête
+     * \~english \brief Connection is kept after a request's end
+     */
+    bool keepConnection;
+
+    /**
+     * \~french \brief La connexion est à fermer une fois les réponses envoyées
+     * \~english \brief Connection has to be closed once responses are sent
+     */
+    bool closing;
+
+    /**
+     * \~french \brief La socket est surveillée en écriture
+     * \~english \brief Socket is watched for writing
+     */
+    bool watchingOutput;
+
+    /**
+     * \~french \brief Date du dernier octet reçu ou envoyé
+     * \~english \brief Date of the last received or sent byte
+     */
+    time_t lastActivity;
+
+    /**
+     * \~french \brief Date limite de réception de la requête HTTP en cours de réception, 0 si aucune
+     * \~english \brief Deadline to receive the HTTP request being received, 0 if none
+     */
+    time_t requestDeadline;
+
+    /**
+     * \~french \brief L'en-tête de la requête HTTP en cours de réception est complet, #requestDeadline porte sur le corps
+     * \~english \brief Header of the HTTP request being received is complete, #requestDeadline concerns the body
+     */
+    bool readingBody;
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    FcgiConnection ( uint64_t i, int f ) : id ( i ), fd ( f ), outputOffset ( 0 ), http ( false ), continueSent ( false ), inputClosed ( false ),
+        keepConnection ( false ), closing ( false ), watchingOutput ( false ), lastActivity ( time ( NULL ) ), requestDeadline ( 0 ), readingBody ( false ) {}
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Frontal FastCGI piloté par les évènements
+ * \details Une unique boucle d'évènements (epoll) accepte les connexions des serveurs web, reçoit les requêtes FastCGI (éventuellement multiplexées sur une même connexion) et envoie les réponses, sans jamais bloquer. Seules les requêtes complètes sont confiées à un nombre fixe de threads de traitement, qui écrivent leur réponse en mémoire.
+ *
+ * Ainsi, une requête ne mobilise un thread que pendant son traitement : les connexions lentes, les requêtes en cours de réception et les réponses en cours d'envoi restent en attente dans la boucle d'évènements, qui peut en gérer des milliers.
+ *
+ * Un traitement attendant des lectures sur un stockage objet peut mettre sa requête en attente (#parkReads) : un thread dédié lance et attend les lectures de toutes les requêtes en attente à la fois, puis chaque requête est reprise par un thread de traitement.
+ * Les traitements utilisent les fonctions habituelles de la libfcgi (FCGX_GetParam, FCGX_GetLine, FCGX_PutStr...) sur des flux en mémoire.
+ *
+ * Une seconde socket d'écoute peut recevoir directement des requêtes HTTP/1.1 (connexions persistantes, pipelining, réponses par morceaux), sans serveur web frontal. Les en-têtes de la requête sont transmis au traitement comme le ferait un serveur web (HTTP_HOST, HTTP_IF_NONE_MATCH...) et les en-têtes CGI de la réponse (Status...) sont convertis en en-têtes HTTP.
+ * \~english
+ * \brief Event-driven FastCGI front end
+ * \details A single event loop (epoll) accepts web servers' connections, receives FastCGI requests (possibly multiplexed on the same connection) and sends responses, never blocking. Only complete requests are given to a fixed number of processing threads, which write their response in memory.
+ *
+ * Thus, a request uses a thread only during its processing : slow connections, requests being received and responses being sent wait in the event loop, which can handle thousands of them.
+ *
+ * A processing waiting for readings on an object storage can park its request (#parkReads) : a dedicated thread starts and waits for readings of all parked requests at once, then each request is resumed by a processing thread.
+ * Processing uses usual libfcgi functions (FCGX_GetParam, FCGX_GetLine, FCGX_PutStr...) on in-memory streams.
+ *
+ * A second listening socket can directly receive HTTP/1.1 requests (persistent connections, pipelining, chunked responses), without front web server. Request's headers are given to processing as a web server would do (HTTP_HOST, HTTP_IF_NONE_MATCH...) and response's CGI headers (Status...) are converted to HTTP headers.
+ */
+class FcgiDispatcher {
+
+    friend class FcgiJob;
+
+private:
+
+    /**
+     * \~french \brief Socket d'écoute
+     * \~english \brief Listening socket
+     */
+    int listenSock;
+
+    /**
+     * \~french \brief Socket d'écoute HTTP, négative si absente
+     * \~english \brief HTTP listening socket, negative if missing
+     */
+    int httpListenSock;
+
+    /**
+     * \~french \brief Descripteur epoll
+     * \~english \brief Epoll descriptor
+     */
+    int epollFd;
+
+    /**
+     * \~french \brief Descripteur de réveil de la boucle d'évènements (eventfd)
+     * \~english \brief Event loop's wake up descriptor (eventfd)
+     */
+    int wakeFd;
+
+    /**
+     * \~french \brief Traitement des requêtes
+     * \~english \brief Requests processing
+     */
+    FcgiHandler handler;
+
+    /**
+     * \~french \brief Argument passé au traitement
+     * \~english \brief Argument given to processing
+     */
+    void* handlerArg;
+
+    /**
+     * \~french \brief Threads de traitement
+     * \~english \brief Processing threads
+     */
+    std::vector<pthread_t> workers;
+
+    /**
+     * \~french \brief Arrêt demandé
+     * \~english \brief Shutdown asked
+     */
+    volatile sig_atomic_t stopping;
+
+    /**
+     * \~french \brief Les threads de traitement doivent s'arrêter une fois la file vide
+     * \~english \brief Processing threads have to stop once the queue is empty
+     */
+    bool workersStop;
+
+    /**
+     * \~french \brief Exclusion mutuelle entre la boucle d'évènements et les threads de traitement
+     * \~english \brief Mutex between event loop and processing threads
+     */
+    pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Signale une nouvelle requête à traiter
+     * \~english \brief Signal a new request to process
+     */
+    pthread_cond_t cond;
+
+    /**
+     * \~french \brief Requêtes complètes, en attente d'un thread de traitement
+     * \~english \brief Complete requests, waiting for a processing thread
+     */
+    std::deque<FcgiJob*> jobs;
+
+    /**
+     * \~french \brief Thread des lectures des requêtes en attente
+     * \~english \brief Parked requests' readings thread
+     */
+    pthread_t storageThread;
+
+    /**
+     * \~french \brief Le thread des lectures doit s'arrêter
+     * \~english \brief Readings thread has to stop
+     */
+    bool storageStop;
+
+    /**
+     * \~french \brief Signale une nouvelle requête mise en attente de lectures
+     * \~english \brief Signal a new request parked waiting for readings
+     */
+    pthread_cond_t storageCond;
+
+    /**
+     * \~french \brief Requêtes mises en attente, dont les lectures ne sont pas encore lancées
+     * \~english \brief Parked requests, whose readings are not yet started
+     */
+    std::deque<FcgiJob*> storageJobs;
+
+    /**
+     * \~french \brief Nombre de requêtes en attente de lectures, pas encore rendues aux threads de traitement
+     * \details Les threads de traitement ne s'arrêtent pas tant qu'il en reste
+     * \~english \brief Number of requests waiting for readings, not yet given back to processing threads
+     * \details Processing threads do not stop while there are some
+     */
+    int parkedJobs;
+
+    /**
+     * \~french \brief Enregistrements produits par les traitements, à envoyer par la boucle d'évènements
+     * \details Le booléen indique la fin du traitement de la requête
+     * \~english \brief Records produced by processing, to send by the event loop
+     * \details Boolean indicates the end of the request's processing
+     */
+    std::deque<std::pair<FcgiJob*, std::pair<OutputPart, bool> > > outputs;
+
+    /**
+     * \~french \brief Connexions ouvertes, par identifiant
+     * \~english \brief Opened connections, by identifier
+     */
+    std::map<uint64_t, FcgiConnection*> connections;
+
+    /**
+     * \~french \brief Identifiant de la prochaine connexion
+     * \~english \brief Next connection's identifier
+     */
+    uint64_t nextConnection;
+
+    /**
+     * \~french \brief Nombre de requêtes confiées aux threads de traitement et pas encore terminées
+     * \~english \brief Number of requests given to processing threads and not yet ended
+     */
+    int inFlight;
+
+    /**
+     * \~french \brief Adresses des serveurs web autorisés (variable FCGI_WEB_SERVER_ADDRS), vide pour tous les autoriser
+     * \~english \brief Allowed web servers' addresses (FCGI_WEB_SERVER_ADDRS variable), empty to allow all
+     */
+    std::set<std::string> allowedAddresses;
+
+    /**
+     * \~french \brief Statistiques : connexions acceptées, requêtes traitées, requêtes interrompues
+     * \~english \brief Statistics : accepted connections, processed requests, aborted requests
+     */
+    uint64_t acceptedConnections, processedRequests, abortedRequests;
+
+    /**
+     * \~french \brief Statistiques : requêtes reçues en HTTP
+     * \~english \brief Statistics : requests received through HTTP
+     */
+    uint64_t httpRequests;
+
+    /**
+     * \~french \brief Statistiques : nombre maximal de requêtes traitées simultanément
+     * \~english \brief Statistics : max number of simultaneously processed requests
+     */
+    int maxInFlight;
+
+    /**
+     * \~french \brief Statistiques : mises en attente de lectures
+     * \~english \brief Statistics : parkings waiting for readings
+     */
+    uint64_t parkedRequests;
+
+    /**
+     * \~french \brief Délais maximaux d'inactivité, de réception de l'en-tête et de réception du corps des connexions HTTP, en secondes
+     * \~english \brief Max delays of inactivity, header reception and body reception of HTTP connections, in seconds
+     */
+    int idleTimeout, headerTimeout, bodyTimeout;
+
+    /**
+     * \~french \brief Date de reprise de la surveillance des sockets d'écoute, 0 si elles sont surveillées
+     * \~english \brief Date to resume listening sockets' watch, 0 if they are watched
+     */
+    time_t acceptPause;
+
+    /**
+     * \~french \brief Boucle des threads de traitement
+     * \~english \brief Processing threads' loop
+     */
+    static void* workerLoop ( void* arg );
+
+    /**
+     * \~french \brief Boucle du thread des lectures
+     * \details Les lectures de toutes les requêtes en attente sont lancées (Context::submitReads), puis attendues (Context::waitReads), depuis ce même thread. Les requêtes sont ensuite rendues aux threads de traitement.
+     * \~english \brief Readings thread's loop
+     * \details Readings of all parked requests are started (Context::submitReads), then waited for (Context::waitReads), from this same thread. Requests are then given back to processing threads.
+     */
+    static void* storageLoop ( void* arg );
+
+    /**
+     * \~french \brief Vide le tampon d'un flux de sortie sous forme d'enregistrements FastCGI (ou tel quel pour une requête HTTP)
+     * \~english \brief Empty an output stream's buffer as FastCGI records (or as is for an HTTP request)
+     */
+    static void emptyStream ( FCGX_Stream* stream, int doClose );
+
+    /**
+     * \~french \brief Marque la fin du flux d'entrée
+     * \~english \brief Mark input stream's end
+     */
+    static void fillStream ( FCGX_Stream* stream );
+
+    /**
+     * \~french \brief Transmet des enregistrements à la boucle d'évènements
+     * \return Vrai si la requête a été interrompue
+     * \~english \brief Give records to the event loop
+     * \return True if request has been aborted
+     */
+    bool post ( FcgiJob* job, std::string& records, bool done );
+
+    /**
+     * \~french \brief Transmet des morceaux de réponse à la boucle d'évènements, sans copie
+     * \param[in,out] parts Morceaux, vidés
+     * \return Vrai si la requête a été interrompue
+     * \~english \brief Give response's parts to the event loop, without copy
+     * \param[in,out] parts Parts, emptied
+     * \return True if request has been aborted
+     */
+    bool post ( FcgiJob* job, std::vector<OutputPart>& parts );
+
+    /**
+     * \~french \brief Réveille la boucle d'évènements
+     * \~english \brief Wake up the event loop
+     */
+    void wake();
+
+    /**
+     * \~french \brief Accepte toutes les connexions en attente
+     * \param[in] sock Socket d'écoute
+     * \param[in] http Connexions HTTP
+     * \~english \brief Accept all pending connections
+     * \param[in] sock Listening socket
+     * \param[in] http HTTP connections
+     */
+    void acceptConnections ( int sock, bool http );
+
+    /**
+     * \~french \brief Active ou désactive la surveillance des sockets d'écoute
+     * \~english \brief Enable or disable listening sockets' watch
+     */
+    void watchListeners ( bool watch );
+
+    /**
+     * \~french \brief Ferme les connexions HTTP inactives depuis trop longtemps et celles dont la requête n'est pas reçue à temps
+     * \details Une requête HTTP incomplète à temps reçoit une réponse 408. Le délai n'est pas vérifié tant que la connexion attend le traitement ou l'envoi de réponses.
+     * \~english \brief Close HTTP connections idle for too long and those whose request is not received in time
+     * \details An HTTP request not complete in time gets a 408 response. Deadline is not checked while connection waits for processing or sending of responses.
+     */
+    void checkDeadlines ( time_t now );
+
+    /**
+     * \~french \brief Lit les octets disponibles sur une connexion et interprète les enregistrements ou requêtes HTTP complets
+     * \~english \brief Read available bytes on a connection and interpret complete records or HTTP requests
+     */
+    void readConnection ( FcgiConnection* conn );
+
+    /**
+     * \~french \brief Interprète les requêtes HTTP complètes d'une connexion et les confie aux threads de traitement
+     * \~english \brief Interpret a connection's complete HTTP requests and give them to processing threads
+     */
+    void readHttpRequests ( FcgiConnection* conn );
+
+    /**
+     * \~french \brief Répond à une requête HTTP invalide ou refusée, puis ferme la connexion
+     * \param[in] status Code et message, par exemple "400 Bad Request"
+     * \~english \brief Answer an invalid or refused HTTP request, then close the connection
+     * \param[in] status Code and message, for example "400 Bad Request"
+     */
+    void httpError ( FcgiConnection* conn, std::string status );
+
+    /**
+     * \~french \brief Convertit une partie de la sortie CGI d'un traitement en réponse HTTP
+     * \param[in,out] part Sortie du traitement, vidée
+     * \param[in] done Fin du traitement
+     * \param[out] target Morceaux à envoyer
+     * \~english \brief Convert a part of a processing's CGI output into HTTP response
+     * \param[in,out] part Processing's output, emptied
+     * \param[in] done Processing's end
+     * \param[out] target Parts to send
+     */
+    static void translateHttp ( FcgiJob* job, OutputPart& part, bool done, std::deque<OutputPart>& target );
+
+    /**
+     * \~french \brief Envoie les réponses HTTP dont c'est le tour, dans l'ordre des requêtes
+     * \~english \brief Send HTTP responses whose turn it is, in requests' order
+     */
+    void flushHttpQueue ( FcgiConnection* conn );
+
+    /**
+     * \~french \brief Ajoute un morceau à envoyer, sans copie
+     * \param[in,out] data Morceau, vidé
+     * \~english \brief Add a part to send, without copy
+     * \param[in,out] data Part, emptied
+     */
+    static void queueOutput ( std::deque<OutputPart>& target, std::string& data );
+
+    /**
+     * \~french \brief Ajoute un morceau à envoyer, sans copie
+     * \param[in,out] part Morceau, vidé
+     * \~english \brief Add a part to send, without copy
+     * \param[in,out] part Part, emptied
+     */
+    static void queueOutput ( std::deque<OutputPart>& target, OutputPart& part );
+
+    /**
+     * \~french \brief Envoie autant d'octets que possible sur une connexion
+     * \return Faux si la connexion a été fermée
+     * \~english \brief Send as many bytes as possible on a connection
+     * \return False if connection has been closed
+     */
+    bool writeConnection ( FcgiConnection* conn );
+
+    /**
+     * \~french \brief Ferme une connexion, ses requêtes en cours de traitement sont interrompues
+     * \~english \brief Close a connection, its requests being processed are aborted
+     */
+    void closeConnection ( FcgiConnection* conn );
+
+    /**
+     * \~french \brief Interprète un enregistrement FastCGI
+     * \return Faux en cas d'erreur de protocole
+     * \~english \brief Interpret a FastCGI record
+     * \return False if protocol error
+     */
+    bool handleRecord ( FcgiConnection* conn, int type, int requestId, const unsigned char* content, int length );
+
+    /**
+     * \~french \brief Confie une requête complète aux threads de traitement
+     * \~english \brief Give a complete request to processing threads
+     */
+    void dispatch ( FcgiConnection* conn, FcgiJob* job );
+
+    /**
+     * \~french \brief Ajoute les enregistrements produits par les traitements aux connexions et les envoie
+     * \~english \brief Add records produced by processing to connections and send them
+     */
+    void processOutputs();
+
+    /**
+     * \~french \brief Active ou désactive la surveillance en écriture d'une connexion
+     * \~english \brief Enable or disable writing watch of a connection
+     */
+    void watchOutput ( FcgiConnection* conn, bool watch );
+
+    /**
+     * \~french \brief Met à jour les évènements surveillés d'une connexion
+     * \~english \brief Update a connection's watched events
+     */
+    void updateEvents ( FcgiConnection* conn );
+
+public:
+
+    /**
+     * \~french \brief Ajoute un enregistrement FastCGI à un tampon, découpé si besoin
+     * \~english \brief Add a FastCGI record to a buffer, split if needed
+     */
+    static void appendRecord ( std::string& buffer, int type, int requestId, const char* content, size_t length );
+
+    /**
+     * \~french \brief Ajoute un enregistrement de fin de requête à un tampon
+     * \~english \brief Add an end of request record to a buffer
+     */
+    static void appendEndRequest ( std::string& buffer, int requestId, int appStatus, int protocolStatus );
+
+    /**
+     * \~french \brief Écrit une portion d'un tampon partagé dans le flux de sortie d'une requête, sans copie
+     * \details Le contenu déjà écrit dans le flux est d'abord transmis, puis le tampon est envoyé tel quel par la boucle d'évènements, qui en détient une référence jusqu'à l'envoi. Son contenu ne doit plus être modifié.
+     * \param[in] stream Flux de sortie de la requête
+     * \param[in] buffer Tampon partagé
+     * \param[in] offset Début de la portion
+     * \param[in] length Taille de la portion
+     * \return 1 si la portion a été transmise, 0 si le flux n'est pas géré par un répartiteur (le contenu doit alors être écrit avec FCGX_PutStr), -1 si la requête a été interrompue
+     * \~english \brief Write a shared buffer's portion into a request's output stream, without copy
+     * \details Content already written in the stream is first given, then the buffer is sent as is by the event loop, which holds a reference until sending. Its content must not be modified anymore.
+     * \param[in] stream Request's output stream
+     * \param[in] buffer Shared buffer
+     * \param[in] offset Portion's start
+     * \param[in] length Portion's size
+     * \return 1 if portion has been given, 0 if stream is not managed by a dispatcher (content then has to be written with FCGX_PutStr), -1 if request has been aborted
+     */
+    static int putBuffer ( FCGX_Stream* stream, PooledBuffer* buffer, size_t offset, size_t length );
+
+    /**
+     * \~french \brief Met une requête en attente de lectures
+     * \details Le traitement doit rendre la main juste après l'appel, sans plus utiliser la requête : elle ne mobilise plus de thread de traitement pendant les lectures. Une fois les lectures terminées, la fonction de reprise est appelée depuis un thread de traitement.
+     * Si la requête n'est pas gérée par un répartiteur, les lectures sont faites et la reprise appelée immédiatement.
+     * \param[in] request Requête à mettre en attente
+     * \param[in] reads Lectures à faire, par contexte. Elles restent la propriété de l'appelant, qui les libère à la reprise.
+     * \param[in] resume Reprise de la requête
+     * \param[in] state État passé à la reprise
+     * \return 1 si la requête a été mise en attente, 0 si la reprise a déjà été appelée
+     * \~english \brief Park a request waiting for readings
+     * \details Processing has to return just after the call, without using the request anymore : it does not use a processing thread anymore during readings. Once readings are done, resumption function is called from a processing thread.
+     * If request is not managed by a dispatcher, readings are done and resumption called immediately.
+     * \param[in] request Request to park
+     * \param[in] reads Readings to do, by context. They stay owned by the caller, which frees them on resumption.
+     * \param[in] resume Request's resumption
+     * \param[in] state State given to resumption
+     * \return 1 if request has been parked, 0 if resumption has already been called
+     */
+    static int parkReads ( FCGX_Request* request, std::map<Context*, std::vector<ContextRead*> >& reads, FcgiResume resume, void* state );
+
+    /**
+     * \~french \brief Constructeur
+     * \param[in] sock Socket d'écoute, telle que retournée par FCGX_OpenSocket
+     * \param[in] nbWorkers Nombre de threads de traitement
+     * \param[in] h Traitement des requêtes
+     * \param[in] arg Argument passé au traitement
+     * \~english \brief Constructor
+     * \param[in] sock Listening socket, as returned by FCGX_OpenSocket
+     * \param[in] nbWorkers Number of processing threads
+     * \param[in] h Requests processing
+     * \param[in] arg Argument given to processing
+     */
+    FcgiDispatcher ( int sock, int nbWorkers, FcgiHandler h, void* arg );
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~FcgiDispatcher();
+
+    /**
+     * \~french \brief Ajoute une socket d'écoute recevant directement des requêtes HTTP
+     * \details Doit être appelée avant #run
+     * \param[in] sock Socket d'écoute, telle que retournée par FCGX_OpenSocket
+     * \~english \brief Add a listening socket directly receiving HTTP requests
+     * \details Has to be called before #run
+     * \param[in] sock Listening socket, as returned by FCGX_OpenSocket
+     */
+    void setHttpSocket ( int sock );
+
+    /**
+     * \~french \brief Modifie les délais des connexions HTTP
+     * \details Doit être appelée avant #run. Par défaut : FCGI_DISPATCHER_HTTP_IDLE_TIMEOUT, FCGI_DISPATCHER_HTTP_HEADER_TIMEOUT et FCGI_DISPATCHER_HTTP_BODY_TIMEOUT.
+     * \param[in] idle Durée maximale d'inactivité d'une connexion gardée entre deux requêtes, en secondes
+     * \param[in] header Délai maximal de réception d'un en-tête, en secondes
+     * \param[in] body Délai maximal de réception d'un corps, en secondes
+     * \~english \brief Modify HTTP connections' delays
+     * \details Has to be called before #run. Default : FCGI_DISPATCHER_HTTP_IDLE_TIMEOUT, FCGI_DISPATCHER_HTTP_HEADER_TIMEOUT and FCGI_DISPATCHER_HTTP_BODY_TIMEOUT.
+     * \param[in] idle Max idle duration of a connection kept between two requests, in seconds
+     * \param[in] header Max delay to receive a header, in seconds
+     * \param[in] body Max delay to receive a body, in seconds
+     */
+    void setHttpTimeouts ( int idle, int header, int body );
+
+    /**
+     * \~french \brief Lance les threads de traitement et la boucle d'évènements
+     * \details Ne rend la main qu'après un appel à #stop, une fois les requêtes en cours traitées et leurs réponses envoyées.
+     * \~english \brief Start processing threads and event loop
+     * \details Returns only after a call to #stop, once pending requests are processed and their responses sent.
+     */
+    void run();
+
+    /**
+     * \~french \brief Demande l'arrêt
+     * \details Peut être appelée depuis un gestionnaire de signal. Plus aucune connexion n'est acceptée.
+     * \~english \brief Ask for shutdown
+     * \details Can be called from a signal handler. No more connection is accepted.
+     */
+    void stop();
+
+    /**
+     * \~french \brief Affiche les statistiques
+     * \~english \brief Print statistics
+     */
+    void printStats();
+};
+
+#endif
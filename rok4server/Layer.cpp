@@ -65,6 +65,12 @@ Layer::Layer ( const LayerXML& l ) {
     this->boundingBox = l.boundingBox;
     this->metadataURLs = l.metadataURLs;
 
+    // Les tuiles de la couche passent par le cache des tuiles si elle l'a demandé
+    std::map<std::string, Level*>::iterator itLevel;
+    for ( itLevel = this->dataPyramid->getLevels().begin(); itLevel != this->dataPyramid->getLevels().end(); itLevel++ ) {
+        itLevel->second->setTileCache ( l.tileCache );
+    }
+
     if (Rok4Format::isRaster(this->dataPyramid->getFormat())) {
 
         // Si la pyramide raster contient un niveau à la demande ou à la volée, on n'authorize pas le WMS 
@@ -66,6 +66,7 @@ LayerXML::LayerXML(std::string path, ServerXML* serverXML, ServicesXML* services
     WMSauth = true;
     WMTSauth = true;
     TMSauth = true;
+    tileCache = false;
 
     getFeatureInfoAvailability = false;
     getFeatureInfoType = "";
@@ -127,6 +128,9 @@ LayerXML::LayerXML(std::string path, ServerXML* serverXML, ServicesXML* services
     pElem=hRoot.FirstChild ( "WMTSAuthorized" ).Element();
     if ( pElem && pElem->GetText() && DocumentXML::getTextStrFromElem(pElem)=="false") WMTSauth= false;
 
+    pElem=hRoot.FirstChild ( "tileCache" ).Element();
+    if ( pElem && pElem->GetText() && DocumentXML::getTextStrFromElem(pElem)=="true") tileCache= true;
+
 
     for ( pElem=hRoot.FirstChild ( "keywordList" ).FirstChild ( "keyword" ).Element(); pElem; pElem=pElem->NextSiblingElement ( "keyword" ) ) {
         if ( ! ( pElem->GetText() ) )
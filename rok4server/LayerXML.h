@@ -78,6 +78,7 @@ class LayerXML : public DocumentXML
         bool WMSauth;
         bool WMTSauth;
         bool TMSauth;
+        bool tileCache;
         std::vector<MetadataURL> metadataURLs;
 
         /******************* PYRAMIDE RASTER *********************/
@@ -45,10 +45,13 @@
 #include "Decoder.h"
 #include "TiffEncoder.h"
 #include "TiffHeaderDataSource.h"
+#include "ThreadPool.h"
+#include "TileCache.h"
 #include <cmath>
 #include "Logger.h"
 #include "Kernel.h"
 #include <vector>
+#include <algorithm>
 #include "Pyramid.h"
 #include "Context.h"
 #include "FileContext.h"
@@ -69,6 +72,9 @@
 //        Il faudra la changer lorsqu'on aura des images non 8bits.
 
 
+int Level::parallelFetch = DEFAULT_TILE_FETCH_PER_REQUEST;
+double Level::reprojectionTolerance = DEFAULT_REPROJECTION_TOLERANCE;
+
 Level::Level ( LevelXML* l, PyramidXML* p ) {
     tm = l->tm;
     format = p->getFormat();
@@ -85,6 +91,7 @@ Level::Level ( LevelXML* l, PyramidXML* p ) {
     maxTileCol = l->maxTileCol;
     minTileCol = l->minTileCol;
 
+    tileCache = false;
 
     if (Rok4Format::isRaster(format)) {
         onDemand = l->onDemand;
@@ -152,6 +159,7 @@ Level::Level ( Level* obj, ServerXML* sxml, TileMatrixSet* tms) {
     minTileCol = obj->minTileCol;
     onDemand = obj->onDemand;
     onFly = obj->onFly;
+    tileCache = obj->tileCache;
 
 
     pathDepth = obj->pathDepth;
@@ -207,7 +215,7 @@ Image* Level::getbbox ( ServicesXML* servicesConf, BoundingBox< double > bbox, i
 
     grid->bbox.print();
 
-    if ( ! ( grid->reproject ( dst_crs.getProj4Code(), src_crs.getProj4Code() ) ) ) {
+    if ( ! ( grid->reproject ( dst_crs.getProj4Code(), src_crs.getProj4Code(), reprojectionTolerance * tm->getRes() ) ) ) {
         LOGGER_DEBUG("Impossible de reprojeter la grid");
         error = 1; // BBox invalid
         delete grid;
@@ -322,6 +330,37 @@ int euclideanDivisionRemainder ( int64_t i, int n ) {
     return r;
 }
 
+/**
+ * \~french \brief Tâche de lecture et de décodage d'une partie des tuiles d'une fenêtre
+ * \~english \brief Task reading and decoding a part of a window's tiles
+ */
+class TileFetchTask : public ThreadTask {
+private:
+    Level* level;
+    std::vector<std::vector<Image*> >* T;
+    int tile_xmin, tile_ymin;
+    int *left, *top, *right, *bottom;
+    int first, step;
+    std::vector<DataSource*>* encoded;
+
+public:
+    TileFetchTask ( Level* level, std::vector<std::vector<Image*> >* T, int tile_xmin, int tile_ymin,
+                    int* left, int* top, int* right, int* bottom, int first, int step, std::vector<DataSource*>* encoded ) :
+        level ( level ), T ( T ), tile_xmin ( tile_xmin ), tile_ymin ( tile_ymin ),
+        left ( left ), top ( top ), right ( right ), bottom ( bottom ), first ( first ), step ( step ), encoded ( encoded ) {}
+
+    void run() {
+        int nbx = T->at(0).size();
+        int nbTiles = T->size() * nbx;
+        for ( int i = first; i < nbTiles; i += step ) {
+            int x = i % nbx;
+            int y = i / nbx;
+            DataSource* encData = encoded->empty() ? NULL : encoded->at ( i );
+            ( *T ) [y][x] = level->getTile ( tile_xmin + x, tile_ymin + y, left[x], top[y], right[x], bottom[y], true, encData );
+        }
+    }
+};
+
 Image* Level::getwindow ( ServicesXML* servicesConf, BoundingBox< int64_t > bbox, int& error ) { 
     int tile_xmin=euclideanDivisionQuotient ( bbox.xmin,tm->getTileW() );
     int tile_xmax=euclideanDivisionQuotient ( bbox.xmax -1,tm->getTileW() );
@@ -365,9 +404,44 @@ Image* Level::getwindow ( ServicesXML* servicesConf, BoundingBox< int64_t > bbox
     bottom[nby- 1] = tm->getTileH() - euclideanDivisionRemainder ( bbox.ymax -1,tm->getTileH() ) - 1;
 
     std::vector<std::vector<Image*> > T ( nby, std::vector<Image*> ( nbx ) );
-    for ( int y = 0; y < nby; y++ ) {
-        for ( int x = 0; x < nbx; x++ ) {
-            T[y][x] = getTile ( tile_xmin + x, tile_ymin + y, left[x], top[y], right[x], bottom[y] );
+
+    int nbTiles = nbx * nby;
+    ThreadPool* pool = ThreadPool::getSharedPool();
+
+    // Si le stockage sait mener plusieurs lectures en même temps (stockage objet), toutes les tuiles sont lues d'un coup
+    std::vector<DataSource*> encoded;
+    if ( nbTiles > 1 && context->asyncReads() ) {
+        std::vector<StoreDataSource*> sources;
+        for ( int i = 0; i < nbTiles; i++ ) {
+            DataSource* ds = getEncodedTile ( tile_xmin + i % nbx, tile_ymin + i / nbx );
+            encoded.push_back ( ds );
+            StoreDataSource* sds = dynamic_cast<StoreDataSource*> ( ds );
+            if ( sds ) sources.push_back ( sds );
+        }
+        StoreDataSource::prefetch ( sources );
+    }
+
+    if ( pool == NULL || parallelFetch <= 1 || nbTiles == 1 ) {
+        for ( int y = 0; y < nby; y++ ) {
+            for ( int x = 0; x < nbx; x++ ) {
+                DataSource* encData = encoded.empty() ? NULL : encoded.at ( y * nbx + x );
+                T[y][x] = getTile ( tile_xmin + x, tile_ymin + y, left[x], top[y], right[x], bottom[y], false, encData );
+            }
+        }
+    } else {
+        // Lecture et décodage des tuiles répartis entre plusieurs tâches. La tâche i traite les tuiles i, i + nbTasks, i + 2*nbTasks...
+        // Le nombre de tâches borne le parallélisme de cette requête, la taille du groupe partagé borne celui du serveur
+        int nbTasks = std::min ( nbTiles, parallelFetch );
+        std::vector<TileFetchTask*> tasks;
+        ThreadTaskGroup group;
+        for ( int i = 0; i < nbTasks; i++ ) {
+            TileFetchTask* task = new TileFetchTask ( this, &T, tile_xmin, tile_ymin, left, top, right, bottom, i, nbTasks, &encoded );
+            tasks.push_back ( task );
+            pool->submit ( task, &group );
+        }
+        pool->wait ( &group );
+        for ( int i = 0; i < nbTasks; i++ ) {
+            delete tasks.at(i);
         }
     }
 
@@ -445,12 +519,27 @@ DataSource* Level::getEncodedTile ( int x, int y ) { // TODO: return 0 sur des c
     uint32_t posoff=ROK4_IMAGE_HEADER_SIZE+4*n, possize=ROK4_IMAGE_HEADER_SIZE+tilesPerWidth*tilesPerHeight*4+4*n;
     std::string path=getPath ( x, y);
     LOGGER_DEBUG ( path );
-    return new StoreDataSource ( path, posoff, possize, ROK4_IMAGE_HEADER_SIZE + 2*4*tilesPerWidth*tilesPerHeight, Rok4Format::toMimeType ( format ), context, Rok4Format::toEncoding( format ) );
+
+    std::string tileKey, version;
+    if ( tileCache && TileCache::isEnabled() ) {
+        // La tuile est peut-être déjà en mémoire, auquel cas le stockage n'est pas sollicité (sauf pour connaître la version de la dalle)
+        tileKey = TileCache::getKey ( context, racine, x, y );
+        version = context->getVersion ( path );
+        DataSource* cached = TileCache::getTile ( tileKey, Rok4Format::toMimeType ( format ), Rok4Format::toEncoding( format ), version );
+        if ( cached ) {
+            LOGGER_DEBUG ( "Tuile trouvée dans le cache des tuiles" );
+            return cached;
+        }
+    }
+
+    StoreDataSource* sds = new StoreDataSource ( path, posoff, possize, ROK4_IMAGE_HEADER_SIZE + 2*4*tilesPerWidth*tilesPerHeight, Rok4Format::toMimeType ( format ), context, Rok4Format::toEncoding( format ) );
+    if ( ! tileKey.empty() ) sds->setTileKey ( tileKey, version );
+    return sds;
 }
 
-DataSource* Level::getDecodedTile ( int x, int y ) {
+DataSource* Level::getDecodedTile ( int x, int y, DataSource* encData ) {
 
-    DataSource* encData = getEncodedTile ( x, y );
+    if (encData == NULL) encData = getEncodedTile ( x, y );
     if (encData == NULL) return 0;
 
     size_t size;
@@ -476,13 +565,16 @@ DataSource* Level::getDecodedTile ( int x, int y ) {
 }
 
 
-DataSource* Level::getTile (int x, int y) {
+DataSource* Level::getTile (int x, int y, DataSource* encData) {
 
-    DataSource* source = getEncodedTile ( x, y );
+    DataSource* source = encData ? encData : getEncodedTile ( x, y );
     if (source == NULL) return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
 
     size_t size;
-    if (source->getData ( size ) == NULL) return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
+    if (source->getData ( size ) == NULL) {
+        delete source;
+        return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
+    }
 
     if ( format == Rok4Format::TIFF_RAW_INT8 || format == Rok4Format::TIFF_LZW_INT8 ||
          format == Rok4Format::TIFF_LZW_FLOAT32 || format == Rok4Format::TIFF_ZIP_INT8 ||
@@ -497,13 +589,22 @@ DataSource* Level::getTile (int x, int y) {
     return source;
 }
 
-Image* Level::getTile ( int x, int y, int left, int top, int right, int bottom ) {
+Image* Level::getTile ( int x, int y, int left, int top, int right, int bottom, bool decode, DataSource* encData ) {
     int pixel_size=1;
     LOGGER_DEBUG ( _ ( "GetTile Image" ) );
     if ( format==Rok4Format::TIFF_RAW_FLOAT32 || format == Rok4Format::TIFF_LZW_FLOAT32 || format == Rok4Format::TIFF_ZIP_FLOAT32 || format == Rok4Format::TIFF_PKB_FLOAT32 )
         pixel_size=4;
 
-    DataSource* ds = getDecodedTile ( x,y );
+    DataSource* ds = getDecodedTile ( x, y, encData );
+
+    if ( ds != 0 && decode ) {
+        // Le décodage est fait maintenant, dans le thread appelant
+        size_t size;
+        if ( ds->getData ( size ) == NULL ) {
+            delete ds;
+            ds = 0;
+        }
+    }
 
     BoundingBox<double> bb ( 
         tm->getX0() + x * tm->getTileW() * tm->getRes() + left * tm->getRes(),
@@ -60,6 +60,9 @@ class Level;
  */
 
 class Level {
+#ifdef UNITTEST
+    friend class CppUnitRok4Server;
+#endif //UNITTEST
 private:
 
     std::string racine;
@@ -88,9 +91,32 @@ private:
 
     int* nodataValue;
 
+    /**
+     * \~french \brief Les tuiles lues sont gardées dans le cache des tuiles (TileCache)
+     * \details Activé par les couches l'ayant demandé
+     * \~english \brief Read tiles are kept in the tiles cache (TileCache)
+     * \details Enabled by layers asking for it
+     */
+    bool tileCache;
+
+    /**
+     * \~french \brief Nombre maximal de tâches de lecture de tuiles lancées en parallèle pour une même requête
+     * \details Les tâches sont exécutées par le groupe de threads partagé (ThreadPool::getSharedPool). 1 ou moins désactive la parallélisation.
+     * \~english \brief Maximal number of tile reading tasks run in parallel for one request
+     * \details Tasks are run by the shared thread pool (ThreadPool::getSharedPool). 1 or less disable parallelism.
+     */
+    static int parallelFetch;
+
+    /**
+     * \~french \brief Écart maximal toléré, en pixels sources, entre un point interpolé de la grille de reprojection et sa reprojection exacte
+     * \details La grille est alors reprojetée de manière adaptative (voir Grid::reproject). 0 pour reprojeter tous les points de la grille.
+     * \~english \brief Maximal gap allowed, in source pixels, between an interpolated point of the reprojection grid and its exact reprojection
+     * \details Grid is then adaptively reprojected (see Grid::reproject). 0 to reproject all grid's points.
+     */
+    static double reprojectionTolerance;
 
-    DataSource* getEncodedTile ( int x, int y );
-    DataSource* getDecodedTile ( int x, int y );
+
+    DataSource* getDecodedTile ( int x, int y, DataSource* encData = NULL );
 
 protected:
     /**
@@ -128,6 +154,14 @@ public:
     bool isOnDemand();
     bool isOnFly();
 
+    /**
+     * \~french \brief Active ou désactive l'utilisation du cache des tuiles pour ce niveau
+     * \~english \brief Enable or disable tiles cache use for this level
+     */
+    void setTileCache ( bool enabled ) {
+        tileCache = enabled;
+    }
+
     Image* getbbox ( ServicesXML* servicesConf, BoundingBox<double> bbox, int width, int height, Interpolation::KernelType interpolation, int& error );
 
     Image* getbbox ( ServicesXML* servicesConf, BoundingBox<double> bbox, int width, int height, CRS src_crs, CRS dst_crs, Interpolation::KernelType interpolation, int& error );
@@ -142,9 +176,49 @@ public:
      * y = floor((Y - Y0) / (tile_height * resolution_y))
      */
 
-    DataSource* getTile (int x, int y);
+    DataSource* getTile (int x, int y, DataSource* encData = NULL);
+
+    /**
+     * \~french \brief Renvoie la tuile x, y encodée, sans la lire
+     * \details Son identifiant et sa date de modification (DataSource::getTag) sont connus par l'index de la dalle ou le cache des tuiles.
+     * \~english \brief Return encoded tile x, y, without reading it
+     * \details Its identifier and its modification date (DataSource::getTag) are known from the slab's index or the tiles cache.
+     */
+    DataSource* getEncodedTile ( int x, int y );
+
+    /**
+     * \~french \brief Renvoie la tuile x, y sous forme d'image, rognée des marges fournies
+     * \param[in] decode Lit et décode la tuile dès maintenant, plutôt qu'à la première lecture de ligne
+     * \param[in] encData Tuile encodée déjà récupérée, NULL pour la récupérer ici
+     * \~english \brief Return tile x, y as an image, cropped by given margins
+     * \param[in] decode Read and decode tile now, rather than on first line reading
+     * \param[in] encData Already got encoded tile, NULL to get it here
+     */
+    Image* getTile ( int x, int y, int left, int top, int right, int bottom, bool decode = false, DataSource* encData = NULL );
+
+    /**
+     * \~french \brief Définit le nombre maximal de tâches de lecture de tuiles parallèles par requête
+     * \~english \brief Define the maximal number of parallel tile reading tasks per request
+     */
+    static void setParallelFetch ( int n ) {
+        parallelFetch = n;
+    }
 
-    Image* getTile ( int x, int y, int left, int top, int right, int bottom );
+    /**
+     * \~french \brief Définit l'écart maximal toléré lors de la reprojection adaptative des grilles, en pixels sources
+     * \~english \brief Define the maximal gap allowed during grids' adaptive reprojection, in source pixels
+     */
+    static void setReprojectionTolerance ( double pixels ) {
+        reprojectionTolerance = pixels;
+    }
+
+    /**
+     * \~french \brief Retourne l'écart maximal toléré lors de la reprojection adaptative des grilles, en pixels sources
+     * \~english \brief Return the maximal gap allowed during grids' adaptive reprojection, in source pixels
+     */
+    static double getReprojectionTolerance () {
+        return reprojectionTolerance;
+    }
 
     BoundingBox<double> tileIndicesToSlabBbox(int tileCol, int tileRow);
     BoundingBox<double> tileIndicesToTileBbox(int tileCol, int tileRow);
@@ -172,6 +172,33 @@ public:
     }
 };
 
+/**
+ * @class NotModifiedDataSource
+ * Réponse vide (304) à une requête conditionnelle dont le client détient déjà la donnée
+ */
+class NotModifiedDataSource : public MessageDataSource {
+private:
+    std::string tag;
+    time_t modification;
+public:
+    /**
+     * Constructeur
+     * @param tag identifiant de la donnée, rappelé dans la réponse
+     * @param modification date de modification de la donnée, rappelée dans la réponse
+     */
+    NotModifiedDataSource ( std::string tag, time_t modification ) : MessageDataSource ( "", "" ), tag ( tag ), modification ( modification ) {}
+
+    int getHttpStatus() {
+        return 304;
+    }
+    std::string getTag() {
+        return tag;
+    }
+    time_t getModification() {
+        return modification;
+    }
+};
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
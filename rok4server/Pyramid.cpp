@@ -208,7 +208,8 @@ Image* Pyramid::getbbox ( ServicesXML* servicesXML, BoundingBox<double> bbox, in
 
 
         LOGGER_DEBUG ( _ ( "debut pyramide" ) );
-        if ( !grid->reproject ( dst_crs.getProj4Code(),tms->getCrs().getProj4Code() ) ) {
+        // Seule la bbox reprojetée est utilisée : la tolérance est exprimée dans la résolution la plus fine de la pyramide
+        if ( !grid->reproject ( dst_crs.getProj4Code(),tms->getCrs().getProj4Code(), Level::getReprojectionTolerance() * lowestLevel->getRes() ) ) {
             // BBOX invalide
             delete grid;
             error=1;
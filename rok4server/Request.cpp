@@ -762,7 +762,7 @@ void Request::determineServiceAndRequest() {
 }
 
 Request::Request ( char* strquery, char* hostName, char* path, char* https ) : 
-    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING)
+    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING), ifModifiedSince ( 0 )
 {
     LOGGER_DEBUG ( "QUERY="<<strquery );
     if ( https && (strcmp ( https,"on" ) == 0 || strcmp ( https,"ON" ) ==0) ){
@@ -791,7 +791,7 @@ Request::Request ( char* strquery, char* hostName, char* path, char* https ) :
 
 
 Request::Request ( char* strquery, char* hostName, char* path, char* https, std::string postContent ) : 
-    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING)
+    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING), ifModifiedSince ( 0 )
 {
     LOGGER_DEBUG ( "QUERY="<<strquery );
     if ( https && (strcmp ( https,"on" ) == 0 || strcmp ( https,"ON" ) ==0) ){
@@ -811,6 +811,58 @@ Request::Request ( char* strquery, char* hostName, char* path, char* https, std:
 
 Request::~Request() {}
 
+/*
+ * Date HTTP au format IMF-fixdate (RFC 7231), seul format produit par les clients actuels
+ * Les noms anglais des mois sont comparés explicitement, indépendamment de la locale du serveur
+ */
+time_t parseHttpDate ( const char* date ) {
+    static const char* months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    char day[4], month[4], zone[4];
+    struct tm t;
+    memset ( &t, 0, sizeof ( t ) );
+    if ( sscanf ( date, "%3[A-Za-z], %d %3s %d %d:%d:%d %3s", day, &t.tm_mday, month, &t.tm_year, &t.tm_hour, &t.tm_min, &t.tm_sec, zone ) != 8 ) {
+        return 0;
+    }
+    if ( strcmp ( zone, "GMT" ) != 0 ) return 0;
+    t.tm_mon = -1;
+    for ( int i = 0; i < 12; i++ ) {
+        if ( strcmp ( month, months[i] ) == 0 ) t.tm_mon = i;
+    }
+    if ( t.tm_mon < 0 ) return 0;
+    t.tm_year -= 1900;
+    return timegm ( &t );
+}
+
+void Request::setConditions ( char* noneMatch, char* modifiedSince ) {
+    ifNoneMatch = noneMatch ? noneMatch : "";
+    ifModifiedSince = modifiedSince ? parseHttpDate ( modifiedSince ) : 0;
+}
+
+bool Request::isNotModified ( std::string tag, time_t modification ) {
+    if ( ! ifNoneMatch.empty() ) {
+        if ( tag.empty() ) return false;
+        // Liste d'identifiants séparés par des virgules, comparaison faible (le préfixe W/ est ignoré)
+        size_t start = 0;
+        while ( start <= ifNoneMatch.size() ) {
+            size_t end = ifNoneMatch.find ( ',', start );
+            if ( end == std::string::npos ) end = ifNoneMatch.size();
+            std::string candidate = ifNoneMatch.substr ( start, end - start );
+            start = end + 1;
+            candidate.erase ( 0, candidate.find_first_not_of ( " \t" ) );
+            candidate.erase ( candidate.find_last_not_of ( " \t" ) + 1 );
+            if ( candidate == "*" ) return true;
+            if ( candidate.compare ( 0, 2, "W/" ) == 0 ) candidate.erase ( 0, 2 );
+            if ( candidate.size() >= 2 && candidate[0] == '"' && candidate[candidate.size() - 1] == '"' ) {
+                candidate = candidate.substr ( 1, candidate.size() - 2 );
+            }
+            if ( candidate == tag ) return true;
+        }
+        return false;
+    }
+
+    return ( ifModifiedSince != 0 && modification != 0 && modification <= ifModifiedSince );
+}
+
 bool Request::hasParam ( std::string paramName ) {
     std::map<std::string, std::string>::iterator it = params.find ( paramName );
     if ( it == params.end() ) {
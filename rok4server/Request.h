@@ -245,6 +245,55 @@ public:
      */
     std::map<std::string, std::string> params;
 
+    /**
+     * \~french \brief Identifiants acceptés par le client (en-tête If-None-Match), vide si absent
+     * \~english \brief Identifiers accepted by the client (If-None-Match header), empty if missing
+     */
+    std::string ifNoneMatch;
+    /**
+     * \~french \brief Date de la version détenue par le client (en-tête If-Modified-Since), 0 si absente ou invalide
+     * \~english \brief Date of the client's version (If-Modified-Since header), 0 if missing or invalid
+     */
+    time_t ifModifiedSince;
+
+    /**
+     * \~french
+     * \brief Mémorise les en-têtes de requête conditionnelle
+     * \param[in] noneMatch valeur de l'en-tête If-None-Match, peut être nulle
+     * \param[in] modifiedSince valeur de l'en-tête If-Modified-Since, peut être nulle
+     * \~english
+     * \brief Memorize conditional request headers
+     * \param[in] noneMatch If-None-Match header value, can be null
+     * \param[in] modifiedSince If-Modified-Since header value, can be null
+     */
+    void setConditions ( char* noneMatch, char* modifiedSince );
+
+    /**
+     * \~french
+     * \brief La requête est-elle conditionnelle
+     * \~english
+     * \brief Is the request conditional
+     */
+    bool hasConditions() {
+        return ( ! ifNoneMatch.empty() || ifModifiedSince != 0 );
+    }
+
+    /**
+     * \~french
+     * \brief Évalue les conditions de la requête (RFC 7232)
+     * \details If-None-Match est prioritaire : If-Modified-Since n'est évalué qu'en son absence.
+     * \param[in] tag identifiant de la donnée, vide s'il n'est pas connu
+     * \param[in] modification date de modification de la donnée, 0 si elle n'est pas connue
+     * \return true si le client détient déjà la donnée (réponse 304)
+     * \~english
+     * \brief Evaluate request's conditions (RFC 7232)
+     * \details If-None-Match has precedence : If-Modified-Since is evaluated only without it.
+     * \param[in] tag data identifier, empty if unknown
+     * \param[in] modification data modification date, 0 if unknown
+     * \return true if client already has the data (304 response)
+     */
+    bool isNotModified ( std::string tag, time_t modification );
+
     void print() {
         LOGGER_INFO("hostName = " << hostName);
         LOGGER_INFO("path = " << path);
@@ -44,6 +44,8 @@
  */
 
 #include "ResponseSender.h"
+#include "FcgiDispatcher.h"
+#include "BufferPool.h"
 #include "ServiceException.h"
 #include "Message.h"
 #include <iostream>
@@ -101,6 +103,50 @@ std::string genFileName ( std::string mime ) {
     return "file";
 }
 
+/**
+ * \~french
+ * \brief Méthode commune pour générer une date HTTP (IMF-fixdate), indépendamment de la locale
+ * \param[in] date date à formater
+ * \return date au format HTTP
+ * \~english
+ * \brief Common function to generate an HTTP date (IMF-fixdate), regardless of locale
+ * \param[in] date date to format
+ * \return date with HTTP format
+ */
+std::string genHttpDate ( time_t date ) {
+    static const char* days[7] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static const char* months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    struct tm t;
+    gmtime_r ( &date, &t );
+    char out[32];
+    snprintf ( out, sizeof ( out ), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+               days[t.tm_wday], t.tm_mday, months[t.tm_mon], t.tm_year + 1900, t.tm_hour, t.tm_min, t.tm_sec );
+    return std::string ( out );
+}
+
+/**
+ * \~french
+ * \brief Méthode commune pour générer les en-têtes de validation (ETag, Last-Modified) d'une source
+ * \param[in] source source de données
+ * \return en-têtes, chacun précédé d'un retour à la ligne
+ * \~english
+ * \brief Common function to generate a source's validation headers (ETag, Last-Modified)
+ * \param[in] source data source
+ * \return headers, each preceded by a line break
+ */
+std::string genValidators ( DataSource* source ) {
+    std::string validators;
+    std::string tag = source->getTag();
+    if ( ! tag.empty() ) {
+        validators += "\r\nETag: \"" + tag + "\"";
+    }
+    time_t modification = source->getModification();
+    if ( modification != 0 ) {
+        validators += "\r\nLast-Modified: " + genHttpDate ( modification );
+    }
+    return validators;
+}
+
 /**
  * \~french
  * \brief Méthode commune pour afficher les codes d'erreur FCGI
@@ -127,6 +173,18 @@ void displayFCGIError ( int error ) {
 int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
     // Creation de l'en-tete
     std::string statusHeader = genStatusHeader ( source->getHttpStatus() );
+
+    if ( source->getHttpStatus() == 304 ) {
+        // Le client détient déjà la donnée : seuls ses validateurs sont rappelés, sans corps
+        std::string validators = genValidators ( source );
+        FCGX_PutStr ( statusHeader.data(),statusHeader.size() - 2,request->out );
+        FCGX_PutStr ( validators.data(),validators.size(),request->out );
+        FCGX_PutStr ( "\r\n\r\n",4,request->out );
+        delete source;
+        LOGGER_DEBUG ( _ ( "End of Response" ) );
+        return 0;
+    }
+
     std::string filename = genFileName ( source->getType() );
     LOGGER_DEBUG ( filename );
     FCGX_PutStr ( statusHeader.data(),statusHeader.size(),request->out );
@@ -143,19 +201,37 @@ int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
         FCGX_PutStr ( "\r\nContent-Length: ",18,request->out );
         FCGX_PutStr ( lengthStr.c_str(), strlen ( lengthStr.c_str() ),request->out );
     }
+    std::string validators = genValidators ( source );
+    FCGX_PutStr ( validators.data(),validators.size(),request->out );
     FCGX_PutStr ( "\r\nContent-Disposition: filename=\"",33,request->out );
     FCGX_PutStr ( filename.data(),filename.size(), request->out );
     FCGX_PutStr ( "\"",1,request->out );
     FCGX_PutStr ( "\r\n\r\n",4,request->out );
 
-    // Copie dans le flux de sortie
+    // Tampon partagé : transmis au répartiteur sans recopie dans le flux de sortie
     size_t buffer_size;
+    PooledBuffer* pooled = source->getBuffer ( buffer_size );
+    if ( pooled ) {
+        int handed = FcgiDispatcher::putBuffer ( request->out, pooled, 0, buffer_size );
+        if ( handed < 0 ) {
+            LOGGER_ERROR ( _ ( "Echec d'ecriture dans le flux de sortie de la requete FCGI " ) << request->requestId );
+            delete source;
+            return -1;
+        }
+        if ( handed > 0 ) {
+            delete source;
+            LOGGER_DEBUG ( _ ( "End of Response" ) );
+            return 0;
+        }
+    }
+
+    // Copie dans le flux de sortie
     const uint8_t *buffer = source->getData ( buffer_size );
     int wr = 0;
     // Ecriture iterative de la source de donnees dans le flux de sortie
     while ( wr < buffer_size ) {
         // Taille ecrite dans le flux de sortie
-        int w = FCGX_PutStr ( ( char* ) ( buffer + wr ), buffer_size,request->out );
+        int w = FCGX_PutStr ( ( char* ) ( buffer + wr ), buffer_size - wr,request->out );
         if ( w < 0 ) {
             LOGGER_ERROR ( _ ( "Echec d'ecriture dans le flux de sortie de la requete FCGI " ) << request->requestId );
             displayFCGIError ( FCGX_GetError ( request->out ) );
@@ -190,7 +266,8 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
     FCGX_PutStr ( "\"",1,request->out );
     FCGX_PutStr ( "\r\n\r\n",4,request->out );
     // Copie dans le flux de sortie
-    uint8_t *buffer = new uint8_t[2 << 20];
+    PooledBuffer* pooled = BufferPool::acquire ( 2 << 20 );
+    uint8_t *buffer = pooled->getData();
     size_t size_to_read = 2 << 20;
     int pos = 0;
 
@@ -205,12 +282,12 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
         // Ecriture iterative de la portion du flux d'entree dans le flux de sortie
         while ( wr < read_size ) {
             // Taille ecrite dans le flux de sortie
-            int w = FCGX_PutStr ( ( char* ) ( buffer + wr ), read_size,request->out );
+            int w = FCGX_PutStr ( ( char* ) ( buffer + wr ), read_size - wr,request->out );
             if ( w < 0 ) {
                 LOGGER_ERROR ( _ ( "Echec d'ecriture dans le flux de sortie de la requete FCGI " ) << request->requestId );
                 displayFCGIError ( FCGX_GetError ( request->out ) );
                 delete stream;
-                delete[] buffer;
+                pooled->release();
                 return -1;
             }
             wr += w;
@@ -219,8 +296,6 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
             LOGGER_DEBUG ( _ ( "Nombre incorrect d'octets ecrits dans le flux de sortie" ) );
             delete stream;
             stream = 0;
-            delete[] buffer;
-            buffer = 0;
             break;
         }
         pos += read_size;
@@ -228,9 +303,7 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
     if ( stream ) {
         delete stream;
     }
-    if ( buffer ) {
-        delete[] buffer;
-    }
+    pooled->release();
     LOGGER_DEBUG ( _ ( "End of Response" ) );
     return 0;
 }
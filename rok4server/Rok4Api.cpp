@@ -43,6 +43,8 @@
 #include "Rok4Api.h"
 #include "config.h"
 #include <proj_api.h>
+#include "ProjCache.h"
+#include "CurlPool.h"
 #include "ConfLoader.h"
 #include "Message.h"
 #include "Request.h"
@@ -475,10 +477,15 @@ Rok4Server* rok4ReloadServer (const char* serverConfigFile, Rok4Server* oldServe
 void rok4KillServer ( Rok4Server* server ) {
     LOGGER_INFO ( _ ( "Extinction du serveur ROK4" ) );
 
+    // Arrêt des générations de dalles à la volée, avant de libérer ce qu'elles utilisent
+    delete server;
+
     //Clear proj4 cache
+    ProjCache::cleanCache();
     pj_clear_initcache();
 
-    delete server;
+    // Plus aucun thread du serveur n'utilise ses objets curl
+    CurlPool::cleanCurlPool();
 }
 
 /**
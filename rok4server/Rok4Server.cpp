@@ -69,6 +69,13 @@
 #include "intl.h"
 #include "TiffEncoder.h"
 #include "CurlPool.h"
+#include "IndexCache.h"
+#include "TileCache.h"
+#include "WebServiceCache.h"
+#include "BufferPool.h"
+#include "ProjCache.h"
+#include "FileDescriptorCache.h"
+#include "ThreadPool.h"
 #include "PNGEncoder.h"
 #include "JPEGEncoder.h"
 #include "BilEncoder.h"
@@ -84,10 +91,10 @@
 #include "PaletteDataSource.h"
 #include "EstompageImage.h"
 #include "MergeImage.h"
-#include "ProcessFactory.h"
 #include "Rok4Image.h"
 #include "EmptyImage.h"
 #include "FileContext.h"
+#include "StoreDataSource.h"
 #include "PenteImage.h"
 #include "Pente.h"
 #include "AspectImage.h"
@@ -96,97 +103,108 @@
 #include <thread>         // std::this_thread::sleep_for
 #include <chrono>         // std::chrono::second
 
-void hangleSIGALARM(int id) {
-    if(id==SIGALRM) {
-         exit(0) ; /* exit on receiving SIGALRM signal */
-    }
-    signal(SIGALRM, hangleSIGALARM) ;
+/**
+ * \~french \brief Requête GetTile en attente de la lecture de sa tuile
+ * \~english \brief GetTile request waiting for its tile's reading
+ */
+struct ParkedTileRequest {
+    Rok4Server* server;
+    Request* request;
+    std::vector<StoreDataSource*> tiles;
+};
+
+void Rok4Server::resumeTileRequest ( FCGX_Request* fcgxRequest, void* state ) {
+    ParkedTileRequest* parked = ( ParkedTileRequest* ) state;
+    StoreDataSource::endReads ( parked->tiles );
+    parked->server->S.sendresponse ( parked->server->getTile ( parked->request, parked->tiles.at ( 0 ) ), fcgxRequest );
+    delete parked->request;
+    delete parked;
 }
 
-void* Rok4Server::thread_loop ( void* arg ) {
+void Rok4Server::processFcgiRequest ( FCGX_Request* fcgxRequest, void* arg ) {
     Rok4Server* server = ( Rok4Server* ) ( arg );
-    FCGX_Request fcgxRequest;
-    if ( FCGX_InitRequest ( &fcgxRequest, server->sock, FCGI_FAIL_ACCEPT_ON_INTR ) != 0 ) {
-        LOGGER_FATAL ( _ ( "Le listener FCGI ne peut etre initialise" ) );
-    }
-
-    while ( server->isRunning() ) {
-        std::string content;
-
-        int rc;
-        if ( ( rc=FCGX_Accept_r ( &fcgxRequest ) ) < 0 ) {
-            if ( rc == -4 ) { // Cas du redémarrage
-                LOGGER_DEBUG ( _ ( "Redémarrage : FCGX_InitRequest renvoie le code d'erreur " ) << rc );
-            } else {
-                LOGGER_ERROR ( _ ( "FCGX_InitRequest renvoie le code d'erreur " ) << rc );
-                std::cerr <<"FCGX_InitRequest renvoie le code d'erreur " << rc << std::endl;
-            }
-            
-            break;
-        }
+    std::string content;
 
-        LOGGER_DEBUG("Thread " << pthread_self() << " traite une requete");
+    // Compteurs d'allocations propres à la requête traitée par ce thread
+    BufferPool::resetThreadCounters();
 
-        bool postRequest = false;
-        if (server->servicesConf->isPostEnabled() && strcmp ( FCGX_GetParam ( "REQUEST_METHOD",fcgxRequest.envp ),"POST" ) == 0) {
-            postRequest = true;
-        }
+    bool postRequest = false;
+    if (server->servicesConf->isPostEnabled() && strcmp ( FCGX_GetParam ( "REQUEST_METHOD",fcgxRequest->envp ),"POST" ) == 0) {
+        postRequest = true;
+    }
 
-        Request* request;
-        if ( postRequest ) { // Post Request
-            char* contentBuffer = ( char* ) malloc ( sizeof ( char ) *200 );
-            while ( FCGX_GetLine ( contentBuffer,200,fcgxRequest.in ) ) {
-                content.append ( contentBuffer );
-            }
-            free ( contentBuffer );
-            contentBuffer= NULL;
-            LOGGER_DEBUG ( _ ( "Request Content :" ) << std::endl << content );
-            request = new Request (
-                FCGX_GetParam ( "QUERY_STRING", fcgxRequest.envp ),
-                FCGX_GetParam ( "HTTP_HOST", fcgxRequest.envp ),
-                FCGX_GetParam ( "SCRIPT_NAME", fcgxRequest.envp ),
-                FCGX_GetParam ( "HTTPS", fcgxRequest.envp ),
-                content
-            );
-        } else { // Get Request
-
-            /* On espère récupérer le nom du host tel qu'il est exprimé dans la requete avec HTTP_HOST.
-             * De même, on espère récupérer le path tel qu'exprimé dans la requête avec SCRIPT_NAME.
-             */
-
-            request = new Request ( 
-                FCGX_GetParam ( "QUERY_STRING", fcgxRequest.envp ),
-                FCGX_GetParam ( "HTTP_HOST", fcgxRequest.envp ),
-                FCGX_GetParam ( "SCRIPT_NAME", fcgxRequest.envp ),
-                FCGX_GetParam ( "HTTPS", fcgxRequest.envp )
-            );
+    Request* request;
+    if ( postRequest ) { // Post Request
+        char* contentBuffer = ( char* ) malloc ( sizeof ( char ) *200 );
+        while ( FCGX_GetLine ( contentBuffer,200,fcgxRequest->in ) ) {
+            content.append ( contentBuffer );
         }
+        free ( contentBuffer );
+        contentBuffer= NULL;
+        LOGGER_DEBUG ( _ ( "Request Content :" ) << std::endl << content );
+        request = new Request (
+            FCGX_GetParam ( "QUERY_STRING", fcgxRequest->envp ),
+            FCGX_GetParam ( "HTTP_HOST", fcgxRequest->envp ),
+            FCGX_GetParam ( "SCRIPT_NAME", fcgxRequest->envp ),
+            FCGX_GetParam ( "HTTPS", fcgxRequest->envp ),
+            content
+        );
+    } else { // Get Request
+
+        /* On espère récupérer le nom du host tel qu'il est exprimé dans la requete avec HTTP_HOST.
+         * De même, on espère récupérer le path tel qu'exprimé dans la requête avec SCRIPT_NAME.
+         */
+
+        request = new Request ( 
+            FCGX_GetParam ( "QUERY_STRING", fcgxRequest->envp ),
+            FCGX_GetParam ( "HTTP_HOST", fcgxRequest->envp ),
+            FCGX_GetParam ( "SCRIPT_NAME", fcgxRequest->envp ),
+            FCGX_GetParam ( "HTTPS", fcgxRequest->envp )
+        );
+    }
 
-        server->processRequest ( request, fcgxRequest );
-        delete request;
-
-        FCGX_Finish_r ( &fcgxRequest );
-        FCGX_Free ( &fcgxRequest,1 );
-
-        LOGGER_DEBUG("Thread " << pthread_self() << " en a fini avec la requete");
+    // En-têtes des requêtes conditionnelles, évalués avant la lecture des tuiles
+    request->setConditions (
+        FCGX_GetParam ( "HTTP_IF_NONE_MATCH", fcgxRequest->envp ),
+        FCGX_GetParam ( "HTTP_IF_MODIFIED_SINCE", fcgxRequest->envp )
+    );
 
-        server->parallelProcess->checkCurrentPid();
+    // Tuile lue sur un stockage objet : la requête attend la lecture sans occuper le thread de traitement
+    DataSource* encData = server->getStoredTile ( request );
+    StoreDataSource* tile = dynamic_cast<StoreDataSource*> ( encData );
+    if ( tile != NULL ) {
+        ParkedTileRequest* parked = new ParkedTileRequest();
+        parked->server = server;
+        parked->request = request;
+        parked->tiles.push_back ( tile );
+        std::map<Context*, std::vector<ContextRead*> > reads;
+        StoreDataSource::prepareReads ( parked->tiles, reads );
+        if ( reads.empty() ) resumeTileRequest ( fcgxRequest, parked );
+        else FcgiDispatcher::parkReads ( fcgxRequest, reads, resumeTileRequest, parked );
+        return;
+    }
 
+    if ( encData != NULL ) {
+        // Tuile trouvée dans le cache des tuiles
+        server->S.sendresponse ( server->getTile ( request, encData ), fcgxRequest );
+    } else {
+        server->processRequest ( request, *fcgxRequest );
     }
+    delete request;
+
+    LOGGER_DEBUG ( "Tampons utilisés par la requête : " << BufferPool::getThreadAcquisitions() << " dont " << BufferPool::getThreadAllocations() << " alloués" );
 
-    LOGGER_DEBUG ( _ ( "Extinction du thread" ) );
-    Logger::stopLogger();
-    return 0;
 }
 
 Rok4Server::Rok4Server (  ServerXML* serverXML, ServicesXML* servicesXML) {
     
 
     sock = 0;
+    httpSock = -1;
     servicesConf = servicesXML;
     serverConf = serverXML;
 
-    threads = std::vector<pthread_t>(serverConf->getNbThreads());
+    dispatcher = NULL;
 
     running = false;
 
@@ -206,23 +224,87 @@ Rok4Server::Rok4Server (  ServerXML* serverXML, ServicesXML* servicesXML) {
         LOGGER_DEBUG ( _ ( "Build TMS Capabilities" ) );
         buildTMSCapabilities();
     }
-    //initialize processFactory
+    // Génération des dalles à la volée, par des threads du serveur
     if (serverConf->nbProcess > MAX_NB_PROCESS) {
         serverConf->nbProcess = MAX_NB_PROCESS;
     }
     if (serverConf->nbProcess < 0) {
         serverConf->nbProcess = DEFAULT_NB_PROCESS;
     }
-    parallelProcess = new ProcessFactory(serverConf->nbProcess, "", serverConf->timeKill);
+    slabQueue = new SlabQueue(serverConf->nbProcess, serverConf->slabQueueSize, serverConf->timeKill, Rok4Server::buildSlab, this);
+
+    // Cache des index de dalles, partagé par tous les threads
+    IndexCache::setValidity(serverConf->indexCacheValidity);
+    IndexCache::setCacheSize((size_t) serverConf->indexCacheSize * 1024 * 1024);
+
+    // Cache des descripteurs des fichiers de dalles, partagé par tous les threads
+    FileDescriptorCache::setValidity(serverConf->fdCacheValidity);
+    FileDescriptorCache::setRandomAccess(serverConf->fdRandomAccess);
+    FileDescriptorCache::setCacheSize(serverConf->fdCacheSize);
+
+    // Cache des tuiles encodées des couches l'ayant demandé, partagé par tous les threads
+    TileCache::setValidity(serverConf->tileCacheValidity);
+    TileCache::setAdmission(serverConf->tileCacheAdmission);
+    TileCache::setCacheSize((size_t) serverConf->tileCacheSize * 1024 * 1024);
+
+    // Cache des réponses des WMS moissonnés par les niveaux à la demande ou à la volée, partagé par tous les threads
+    WebServiceCache::setValidity(serverConf->webCacheValidity);
+    WebServiceCache::setCacheSize((size_t) serverConf->webCacheSize * 1024 * 1024);
+    WebServiceCache::setDirectory(serverConf->webCacheDirectory, (size_t) serverConf->webCacheDiskSize * 1024 * 1024);
+
+    // Tampons des tuiles et des réponses, réutilisés d'une requête à l'autre
+    BufferPool::setPoolSize((size_t) serverConf->bufferPoolSize * 1024 * 1024);
+
+    // Transformations PROJ, initialisées au démarrage pour les CRS déclarés par les couches
+    ProjCache::setCacheSize(serverConf->projCacheSize);
+    if ( serverConf->supportWMS && serverConf->reprojectionCapability ) {
+        warmProjCache();
+    }
+
+    // Lecture parallèle des tuiles : le groupe partagé borne le nombre total de lectures simultanées
+    ThreadPool::initSharedPool(serverConf->tileFetchThreads);
+    Level::setParallelFetch(serverConf->tileFetchPerRequest);
+
+    // Reprojection adaptative des grilles : seuls les points nécessaires sont convertis par PROJ
+    Level::setReprojectionTolerance(serverConf->reprojectionTolerance);
+}
+
+void Rok4Server::warmProjCache() {
+
+    std::vector<CRS>* globalCRSList = servicesConf->getGlobalCRSList();
+
+    std::map<std::string, Layer*>::iterator itLay = serverConf->layersList.begin();
+    for ( ; itLay != serverConf->layersList.end(); itLay++ ) {
+        std::string pyrCrs = itLay->second->getDataPyramid()->getTms()->getCrs().getProj4Code();
+
+        std::vector<CRS> crsList = itLay->second->getWMSCRSList();
+        crsList.insert ( crsList.end(), globalCRSList->begin(), globalCRSList->end() );
+
+        ProjCache::warm ( pyrCrs );
+        ProjCache::warm ( pyrCrs, "epsg:4326" );
+
+        for ( unsigned int i = 0; i < crsList.size(); i++ ) {
+            if ( ! crsList.at ( i ).isProj4Compatible() ) continue;
+            std::string crs = crsList.at ( i ).getProj4Code();
+            if ( crs == pyrCrs ) continue;
+            // Grille de la requête vers la pyramide, et comparaison des emprises en géographique
+            ProjCache::warm ( crs, pyrCrs );
+            ProjCache::warm ( crs, "epsg:4326" );
+            ProjCache::warm ( "epsg:4326", crs );
+        }
+    }
+
+    LOGGER_INFO ( _ ( "Transformations PROJ preparees : " ) << ProjCache::getElementsNumber() );
 }
 
 Rok4Server::~Rok4Server() {
 
+    // Les générations en cours utilisent la configuration
+    delete slabQueue;
+    slabQueue = NULL;
+
     delete serverConf;
     delete servicesConf;
-
-    delete parallelProcess;
-    parallelProcess = NULL;
 }
 
 void Rok4Server::initFCGI() {
@@ -233,30 +315,54 @@ void Rok4Server::initFCGI() {
     }
 }
 
+void Rok4Server::initHTTP() {
+    if ( ! serverConf->httpSocket.empty() ) {
+        LOGGER_INFO ( _ ( "Listening HTTP on " ) << serverConf->httpSocket );
+        // Même syntaxe d'adresse que pour FastCGI, la socket obtenue est une simple socket d'écoute
+        httpSock = FCGX_OpenSocket ( serverConf->httpSocket.c_str(), serverConf->backlog );
+        if ( httpSock < 0 ) {
+            LOGGER_ERROR ( _ ( "Impossible d'ecouter en HTTP sur " ) << serverConf->httpSocket );
+        }
+    }
+}
+
 void Rok4Server::run(sig_atomic_t signal_pending) {
     running = true;
 
-    for ( int i = 0; i < threads.size(); i++ ) {
-        pthread_create ( & ( threads[i] ), NULL, Rok4Server::thread_loop, ( void* ) this );
+    // Une boucle d'évènements reçoit les requêtes, les threads de traitement (nbThread) ne font que les traiter
+    dispatcher = new FcgiDispatcher ( sock, serverConf->getNbThreads(), Rok4Server::processFcgiRequest, ( void* ) this );
+    if ( httpSock >= 0 ) {
+        dispatcher->setHttpSocket ( httpSock );
     }
-    
+
     if (signal_pending != 0 ) {
         raise( signal_pending );
     }
-    
-    for ( int i = 0; i < threads.size(); i++ )
-        pthread_join ( threads[i], NULL );
+
+    dispatcher->run();
+    dispatcher->printStats();
+
+    FcgiDispatcher* d = dispatcher;
+    dispatcher = NULL;
+    delete d;
+
+    // Les threads de traitement sont arrêtés : les compteurs des caches sont complets
+    IndexCache::printStats();
+    FileDescriptorCache::printStats();
+    TileCache::printStats();
+    WebServiceCache::printStats();
+    BufferPool::printStats();
+    ProjCache::printStats();
 }
 
 void Rok4Server::terminate() {
+    // Appelée depuis un gestionnaire de signal : ni verrou, ni log, ni libération
     running = false;
 
-    // Terminate FCGI Thread
-    for ( int i = 0; i < threads.size(); i++ ) {
-        pthread_kill ( threads[i], SIGQUIT );
+    // Arrêt de la boucle d'évènements, les requêtes en cours sont terminées
+    if ( dispatcher ) {
+        dispatcher->stop();
     }
-
-    CurlPool::cleanCurlPool();
 }
 
 
@@ -282,7 +388,18 @@ DataStream* Rok4Server::getMap ( Request* request ) {
     Image* image;
     for ( int i = 0 ; i < layers.size(); i ++ ) {
 
-            Image* curImage = layers.at ( i )->getbbox ( servicesConf, bbox, width, height, crs, dpi, error );
+            Rok4Format::eformat_data pyrType = layers.at ( i )->getDataPyramid()->getFormat();
+            Style* style = styles.at(i);
+
+            // Un style de terrain a besoin d'une marge : l'image est lue une seule fois, élargie
+            bool terrain = isTerrainStyle ( style, layers.at(i)->getDataPyramid(), pyrType, format, layers.size() );
+
+            Image* curImage;
+            if ( terrain ) {
+                curImage = getTerrainImage ( layers.at(i)->getDataPyramid(), style, bbox, width, height, crs, error );
+            } else {
+                curImage = layers.at ( i )->getbbox ( servicesConf, bbox, width, height, crs, dpi, error );
+            }
 
             if ( curImage == 0 ) {
                 switch ( error ) {
@@ -299,10 +416,10 @@ DataStream* Rok4Server::getMap ( Request* request ) {
                 }
             }
 
-            curImage->setBbox(bbox);
-            curImage->setCRS(crs);
-            Rok4Format::eformat_data pyrType = layers.at ( i )->getDataPyramid()->getFormat();
-            Style* style = styles.at(i);
+            if ( ! terrain ) {
+                curImage->setBbox(bbox);
+                curImage->setCRS(crs);
+            }
             LOGGER_DEBUG ( _ ( "GetMap de Style : " ) << styles.at ( i )->getId() << _ ( " pal size : " ) <<styles.at ( i )->getPalette()->getPalettePNGSize() );
 
 
@@ -327,119 +444,109 @@ DataStream* Rok4Server::getMap ( Request* request ) {
     return stream;
 }
 
-Image *Rok4Server::styleImage(Image *curImage, Rok4Format::eformat_data pyrType, Style *style, std::string format, int size, Pyramid* pyr) {
+bool Rok4Server::isTerrainStyle(Style *style, Pyramid *pyr, Rok4Format::eformat_data pyrType, std::string format, int size) {
 
-    Image * expandedImage = curImage;
+    if ( ! servicesConf->isFullStyleCapable() || ! style ) {
+        return false;
+    }
 
-    if ( servicesConf->isFullStyleCapable() ) {
-        if ( style->isEstompage() ) {
-            LOGGER_DEBUG ( _ ( "Estompage" ) );
+    if ( style->isEstompage() ) {
+        return true;
+    }
 
-            int error=0;
-            BoundingBox<double> expandedBbox = curImage->getBbox().expand(curImage->getResX(),curImage->getResY(),1);
-            expandedImage = pyr->getbbox(servicesConf,expandedBbox,curImage->getWidth()+2,curImage->getHeight()+2,curImage->getCRS(),style->getInterpolationOfEstompage(),0,error);
+    if ( pyr->getChannels() != 1 || ! ( style->isPente() || style->isAspect() ) ) {
+        return false;
+    }
 
-            if (expandedImage == 0) {
-                LOGGER_ERROR("expanded Image is NULL");
-                delete curImage;
-                return NULL;
-            }
+    if ( format == "image/png" && size == 1 ) {
+        // Pente et exposition ne sont calculées en PNG seul que sur des données flottantes
+        switch ( pyrType ) {
+        case Rok4Format::TIFF_RAW_FLOAT32 :
+        case Rok4Format::TIFF_ZIP_FLOAT32 :
+        case Rok4Format::TIFF_LZW_FLOAT32 :
+        case Rok4Format::TIFF_PKB_FLOAT32 :
+            return true;
+        default:
+            return false;
+        }
+    }
 
-            expandedImage->setBbox(expandedBbox);
-            expandedImage->setCRS(curImage->getCRS());
+    return true;
+}
 
-            expandedImage = new EstompageImage ( curImage->getWidth(), curImage->getHeight(), curImage->getChannels(),
-                                                 curImage->getBbox(), expandedImage, style->getZenith(), style->getAzimuth(),
-                                                 style->getZFactor(), expandedImage->getResXmeter(),expandedImage->getResYmeter() );
-            switch ( pyrType ) {
-                //Only use int8 output whith estompage
-            case Rok4Format::TIFF_RAW_FLOAT32 :
-                pyrType = Rok4Format::TIFF_RAW_INT8;
-                break;
-            case Rok4Format::TIFF_ZIP_FLOAT32 :
-                pyrType = Rok4Format::TIFF_ZIP_INT8;
-                break;
-            case Rok4Format::TIFF_LZW_FLOAT32 :
-                pyrType = Rok4Format::TIFF_LZW_INT8;
-                break;
-            case Rok4Format::TIFF_PKB_FLOAT32 :
-                pyrType = Rok4Format::TIFF_PKB_INT8;
-                break;
-            default:
-                break;
-            }
+Image *Rok4Server::getTerrainImage(Pyramid *pyr, Style *style, BoundingBox<double> bbox, int width, int height, CRS crs, int &error) {
 
-            delete curImage;
-        }
+    Interpolation::KernelType interpolation = Interpolation::LINEAR;
+    if ( style->isEstompage() ) {
+        interpolation = style->getInterpolationOfEstompage();
+    } else if ( style->isPente() ) {
+        interpolation = style->getInterpolationOfPente();
+    }
 
-        if (expandedImage->getChannels() == 1 && style->isPente()){
+    error = 0;
+    BoundingBox<double> expandedBbox = bbox.expand ( ( bbox.xmax - bbox.xmin ) / width, ( bbox.ymax - bbox.ymin ) / height, 1 );
+    Image* expandedImage = pyr->getbbox ( servicesConf, expandedBbox, width + 2, height + 2, crs, interpolation, 0, error );
 
-            int error=0;
-            BoundingBox<double> expandedBbox = curImage->getBbox().expand(curImage->getResX(),curImage->getResY(),1);
-            expandedImage = pyr->getbbox(servicesConf,expandedBbox,curImage->getWidth()+2,curImage->getHeight()+2,curImage->getCRS(),style->getInterpolationOfPente(),0,error);
+    if ( expandedImage == 0 ) {
+        LOGGER_ERROR ( "expanded Image is NULL" );
+        return NULL;
+    }
 
-            if (expandedImage == 0) {
-                LOGGER_ERROR("expanded Image is NULL");
-                delete curImage;
-                return NULL;
-            }
+    expandedImage->setBbox ( expandedBbox );
+    expandedImage->setCRS ( crs );
 
-            expandedImage->setBbox(expandedBbox);
-            expandedImage->setCRS(curImage->getCRS());
+    return expandedImage;
+}
 
-			if ( format == "image/png" && size == 1 ) {
-				switch ( pyrType ) {
-                case Rok4Format::TIFF_RAW_FLOAT32 :
-                case Rok4Format::TIFF_ZIP_FLOAT32 :
-                case Rok4Format::TIFF_LZW_FLOAT32 :
-                case Rok4Format::TIFF_PKB_FLOAT32 :
-                    expandedImage = new PenteImage ( curImage->getWidth(), curImage->getHeight(), curImage->getChannels(),
-                                                                         curImage->getBbox(),expandedImage, expandedImage->getResXmeter(),
-                                                                         expandedImage->getResYmeter(), style->getAlgoOfPente(), style->getUnitOfPente(),
-                                                                         style->getSlopeNoDataOfPente(),pyr->getFirstNdValues(),
-                                                                         style->getMaxSlopeOfPente());
-                default:
-					break;
-				}
-			} else {
-                expandedImage = new PenteImage ( curImage->getWidth(), curImage->getHeight(), curImage->getChannels(),
-                                                                     curImage->getBbox(),expandedImage, expandedImage->getResXmeter(),
-                                                                     expandedImage->getResYmeter(), style->getAlgoOfPente(), style->getUnitOfPente(),
-                                                                     style->getSlopeNoDataOfPente(),pyr->getFirstNdValues(),
-                                                                     style->getMaxSlopeOfPente());
-            }
-            delete curImage;
-		}
+Image *Rok4Server::styleImage(Image *curImage, Rok4Format::eformat_data pyrType, Style *style, std::string format, int size, Pyramid* pyr) {
 
-        if (expandedImage->getChannels() == 1 && style->isAspect()){
+    Image * expandedImage = curImage;
 
-            int error=0;
-            BoundingBox<double> expandedBbox = curImage->getBbox().expand(curImage->getResX(),curImage->getResY(),1);
-            expandedImage = pyr->getbbox(servicesConf,expandedBbox,curImage->getWidth()+2,curImage->getHeight()+2,curImage->getCRS(),Interpolation::LINEAR,0,error);
+    if ( servicesConf->isFullStyleCapable() ) {
 
-            if (expandedImage == 0) {
-                LOGGER_ERROR("expanded Image is NULL");
-                delete curImage;
-                return NULL;
-            }
+        if ( isTerrainStyle ( style, pyr, pyrType, format, size ) ) {
+            // L'image fournie est déjà élargie d'un pixel de chaque côté (cf getTerrainImage) : on en déduit le cœur
+            int coreWidth = curImage->getWidth() - 2;
+            int coreHeight = curImage->getHeight() - 2;
+            BoundingBox<double> coreBbox = curImage->getBbox().expand ( curImage->getResX(), curImage->getResY(), -1 );
 
-            expandedImage->setBbox(expandedBbox);
-            expandedImage->setCRS(curImage->getCRS());
+            if ( style->isEstompage() ) {
+                LOGGER_DEBUG ( _ ( "Estompage" ) );
 
-            if ( format == "image/png" && size == 1 ) {
+                expandedImage = new EstompageImage ( coreWidth, coreHeight, curImage->getChannels(),
+                                                     coreBbox, curImage, style->getZenith(), style->getAzimuth(),
+                                                     style->getZFactor(), curImage->getResXmeter(), curImage->getResYmeter() );
                 switch ( pyrType ) {
+                    //Only use int8 output whith estompage
                 case Rok4Format::TIFF_RAW_FLOAT32 :
+                    pyrType = Rok4Format::TIFF_RAW_INT8;
+                    break;
                 case Rok4Format::TIFF_ZIP_FLOAT32 :
+                    pyrType = Rok4Format::TIFF_ZIP_INT8;
+                    break;
                 case Rok4Format::TIFF_LZW_FLOAT32 :
+                    pyrType = Rok4Format::TIFF_LZW_INT8;
+                    break;
                 case Rok4Format::TIFF_PKB_FLOAT32 :
-                    expandedImage = new AspectImage ( curImage->getWidth(), curImage->getHeight(), curImage->getChannels(), curImage->getBbox(),expandedImage, expandedImage->computeMeanResolution(),  style->getAlgoOfAspect(), style->getMinSlopeOfAspect());
+                    pyrType = Rok4Format::TIFF_PKB_INT8;
+                    break;
                 default:
                     break;
                 }
-            } else {
-                expandedImage = new AspectImage ( curImage->getWidth(), curImage->getHeight(), curImage->getChannels(), curImage->getBbox(),expandedImage, expandedImage->computeMeanResolution(),  style->getAlgoOfAspect(), style->getMinSlopeOfAspect());
+
+            } else if ( style->isPente() ) {
+
+                expandedImage = new PenteImage ( coreWidth, coreHeight, curImage->getChannels(),
+                                                 coreBbox, curImage, curImage->getResXmeter(),
+                                                 curImage->getResYmeter(), style->getAlgoOfPente(), style->getUnitOfPente(),
+                                                 style->getSlopeNoDataOfPente(), pyr->getFirstNdValues(),
+                                                 style->getMaxSlopeOfPente() );
+
+            } else if ( style->isAspect() ) {
+
+                expandedImage = new AspectImage ( coreWidth, coreHeight, curImage->getChannels(), coreBbox, curImage,
+                                                  curImage->computeMeanResolution(), style->getAlgoOfAspect(), style->getMinSlopeOfAspect() );
             }
-            delete curImage;
         }
 
         if ( style && expandedImage->getChannels() == 1 && ! ( style->getPalette()->getColoursMap()->empty() ) ) {
@@ -643,7 +750,39 @@ DataStream * Rok4Server::formatImage(Image *image, std::string format, Rok4Forma
 
 }
 
-DataSource* Rok4Server::getTile ( Request* request ) {
+DataSource* Rok4Server::getStoredTile ( Request* request ) {
+    if ( request->request != RequestType::GETTILE || request->hasConditions() ) return NULL;
+
+    Layer* L;
+    std::string tileMatrix,format;
+    int tileCol,tileRow;
+    Style* style=0;
+
+    DataSource* errorResp;
+    if ( serverConf->supportWMTS && request->service == ServiceType::WMTS ) {
+        errorResp = getTileParamWMTS ( request, L, tileMatrix, tileCol, tileRow, format, style );
+    } else if ( serverConf->supportTMS && request->service == ServiceType::TMS ) {
+        errorResp = getTileParamTMS ( request, L, tileMatrix, tileCol, tileRow, format, style );
+    } else {
+        return NULL;
+    }
+
+    if ( errorResp ) {
+        // L'erreur sera renvoyée par le traitement habituel
+        delete errorResp;
+        return NULL;
+    }
+
+    Level* level = L->getDataPyramid()->getLevel(tileMatrix);
+    if ( level == NULL || level->isOnFly() || level->isOnDemand() ) return NULL;
+    if ( tileRow < level->getMinTileRow() || tileRow > level->getMaxTileRow()
+            || tileCol < level->getMinTileCol() || tileCol > level->getMaxTileCol() ) return NULL;
+    if ( ! level->getContext()->asyncReads() ) return NULL;
+
+    return level->getEncodedTile ( tileCol, tileRow );
+}
+
+DataSource* Rok4Server::getTile ( Request* request, DataSource* encData ) {
     Layer* L;
     std::string tileMatrix,format;
     int tileCol,tileRow;
@@ -659,6 +798,7 @@ DataSource* Rok4Server::getTile ( Request* request ) {
     }
 
     if ( errorResp ) {
+        delete encData;
         return errorResp;
     }
     errorResp = NULL;
@@ -666,6 +806,7 @@ DataSource* Rok4Server::getTile ( Request* request ) {
     Level* level = L->getDataPyramid()->getLevel(tileMatrix);
     if (level == NULL) {
         // On est hors niveau -> erreur
+        delete encData;
         return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
     }
 
@@ -674,6 +815,7 @@ DataSource* Rok4Server::getTile ( Request* request ) {
     if (tileRow < level->getMinTileRow() || tileRow > level->getMaxTileRow()
             || tileCol < level->getMinTileCol() || tileCol > level->getMaxTileCol()) {
         // On est hors tuiles -> erreur
+        delete encData;
         return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
     }
 
@@ -684,7 +826,18 @@ DataSource* Rok4Server::getTile ( Request* request ) {
         tileSource = getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
     }
     else {
-        tileSource = getTileUsual(L, tileMatrix, tileCol, tileRow, style, format) ;
+        // Les validateurs de la tuile sont connus par l'index de la dalle ou le cache des tuiles : elle n'est lue que si le client ne la détient pas déjà
+        if ( encData == NULL ) encData = level->getEncodedTile ( tileCol, tileRow );
+        if ( request->hasConditions() ) {
+            std::string tag = encData->getTag();
+            if ( format == "image/png" ) tag = PaletteDataSource::buildTag ( tag, style->getPalette() );
+            time_t modification = encData->getModification();
+            if ( request->isNotModified ( tag, modification ) ) {
+                delete encData;
+                return new NotModifiedDataSource ( tag, modification );
+            }
+        }
+        tileSource = getTileUsual(L, tileMatrix, tileCol, tileRow, style, format, encData) ;
     }
 
     return tileSource;
@@ -693,14 +846,14 @@ DataSource* Rok4Server::getTile ( Request* request ) {
 
 
 
-DataSource *Rok4Server::getTileUsual(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style,std::string format) {
+DataSource *Rok4Server::getTileUsual(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style,std::string format, DataSource* encData) {
 
     DataSource* tileSource;
     // Avoid using unnecessary palette
     if ( format == "image/png" ) {
-        tileSource = new PaletteDataSource ( L->getDataPyramid()->getLevel(tileMatrix)->getTile ( tileCol, tileRow ), style->getPalette() );
+        tileSource = new PaletteDataSource ( L->getDataPyramid()->getLevel(tileMatrix)->getTile ( tileCol, tileRow, encData ), style->getPalette() );
     } else {
-        tileSource = L->getDataPyramid()->getLevel(tileMatrix)->getTile ( tileCol, tileRow );
+        tileSource = L->getDataPyramid()->getLevel(tileMatrix)->getTile ( tileCol, tileRow, encData );
     }
     return tileSource;
 
@@ -775,7 +928,11 @@ DataSource *Rok4Server::getTileOnDemand(Layer* L, std::string tileMatrix, int ti
 
                 if (childBBox.containsInside(motherBbox) || motherBbox.containsInside(childBBox) || motherBbox.intersects(childBBox)) {
 
-                    curImage = bPyr->createReprojectedImage(bLevel, bbox, dst_crs, servicesConf, width, height, interpolation, error);
+                    if ( isTerrainStyle ( bStyle, bPyr, pyrType, format, bSize ) ) {
+                        curImage = getTerrainImage ( bPyr, bStyle, bbox, width, height, dst_crs, error );
+                    } else {
+                        curImage = bPyr->createReprojectedImage(bLevel, bbox, dst_crs, servicesConf, width, height, interpolation, error);
+                    }
 
                     if (curImage != NULL) {
                         //On applique un style à l'image
@@ -860,160 +1017,95 @@ DataSource *Rok4Server::getTileOnFly(Layer* L, std::string tileMatrix, int tileC
     //On va créer la tuile sur demande et stocker la dalle qui la contient
 
     //variables
-    std::string Spath, SpathTmp, SpathErr, SpathDir;
-    DataSource *tile;
+    std::string Spath, SpathTmp, SpathErr;
     Pyramid * pyr = L->getDataPyramid();
-    struct stat bufferS;
-    struct stat bufferT;
-    struct stat bufferE;
+    struct stat buffer;
 
     LOGGER_INFO("GetTileOnFly");
 
-    //---- on verifie certains paramètres pour ne pas effectuer des calculs inutiles
     Level* lev = pyr->getLevel(tileMatrix);
 
     Spath = lev->getPath(tileCol, tileRow);
-    SpathDir = lev->getDirPath(tileCol,tileRow);
     SpathTmp = Spath + ".tmp";
     SpathErr = Spath + ".err";
 
-    if (stat (Spath.c_str(), &bufferS) == 0) {
-        //la dalle existe ou est en cours de création
-        if (stat (SpathTmp.c_str(), &bufferT) == -1) {
-            // il n'y a pas de tmp donc la dalle existe mais une erreur peut subsister
-            if (stat (SpathErr.c_str(), &bufferE) == -1) {
-                // il n'y a pas d'erreurs donc la dalle existe
-                //Usual
-                tile = getTileUsual(L, tileMatrix, tileCol, tileRow, style, format);
-            } else {
-                //il y a une erreur
-                //onDemand
-                tile = getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
-            }
-        } else {
-            //il y a un fichier tmp donc la dalle est en cours de génération
-            //onDemand
-            tile = getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
-        }
-    } else {
-        //la dalle n'existe pas mais peut être en cours de création
-        if (stat (SpathTmp.c_str(), &bufferT) == 0) {
-            //la dalle est en cours de création
-            //onDemand
-            tile = getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
-        } else {
-            //la dalle n'est pas en cours de création, il peut y avoir une erreur
-            if (stat (SpathErr.c_str(), &bufferE) == 0) {
-                //il y a une erreur
-                //onDemand
-                tile = getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
-            } else {
-                //il n'y a pas d'erreurs, on peut générer la dalle
-
-                //on cree un processus qui va creer la dalle en parallele
-                if (parallelProcess->createProcess()) {
-
-                    //---------------------------------------------------------------------------------------------------
-
-                    if (parallelProcess->getLastPid() == 0) {
-                        //PROCESSUS FILS
-
-                        // on va créer un fichier tmp, générer la dalle et supprimer le fichier tmp
-                        //on met en place une alarme qui va eteindre le processus au bout d'un certain temps
-                        signal(SIGALRM, hangleSIGALARM);
-                        alarm(parallelProcess->getTimeBeforeAutoKill());
-
-                        //on cree un fichier temporaire pour indiquer que la dalle va etre creer
-                        //on commence par créer le dossier
-                        int directory = lev->createDirPath(SpathDir.c_str());
-                        if (directory == -1) {
-                            if (errno != EEXIST) {
-                                std::cerr << "Impossible de creer le dossier contenant la dalle " << SpathDir.c_str() << std::endl;
-                                std::cerr << "errno: " << errno << " " << strerror(errno) << std::endl;
-                                exit(0);
-                            }
-                        }
-
-                        //on vient de creer le dossier donc on essaye de creer le fichier tmp
-                        int fileTmp = open(SpathTmp.c_str(),O_CREAT|O_EXCL,S_IWRITE);
-                        if (fileTmp != -1) {
-                            //on a pu creer un fichier temporaire
-                            close(fileTmp);
-                        } else {
-                            //impossible de creer le fichier tmp, il est potentiellement déjà existant
-                            exit(0);
-                        }
-
-                        //on cree un logger et supprime l'ancien pour ne pas mélanger les sorties
-                        // il sera écrit dans SpathErr et supprimé si la dalle a été généré correctement
-                        parallelProcess->initializeLogger(SpathErr);
-
-                        //on cree la dalle
-                        int state = createSlabOnFly(L, tileMatrix, tileCol, tileRow, style, format, Spath);
-                        if (!state) {
-                            //la generation s'est bien déroulé
-                            //on supprime le logger qui ne contient en théorie pas ou peu
-                            //d'erreurs. Du moins, aucune ayant empéchée la génération
-
-                            //vide du logger
-                            sleep(1);
-
-                            int fileErr = remove(SpathErr.c_str());
-                            if (fileErr != 0) {
-                                //Impossible de supprimer le fichier erreur
-                                //std::cerr << "Impossible de supprimer le fichier de log .err " << SpathErr.c_str() << std::endl;
-                                //std::cerr << "errno: " << errno << " " << strerror(errno) << std::endl;
-                            }
-                        } else {
-                            //la generation n'a pas fonctionne
-                            //on essaye de supprimer le fichier de dalle potentiellement existant
-                            //mais contenant des erreurs
-
-                            if (stat (Spath.c_str(), &bufferS) == 0) {
-                                //le fichier existe mais il faut le supprimer
-                                int file = remove(Spath.c_str());
-                                if (file != 0) {
-                                    //std::cerr << "Impossible de supprimer la dalle contenant des erreurs " << Spath.c_str() << std::endl;
-                                    //std::cerr << "errno: " << errno << " " << strerror(errno) << std::endl;
-                                }
-                            }
-                        }
-
-                        //on nettoie
-                        fileTmp = remove(SpathTmp.c_str());
-                        if (fileTmp != 0) {
-                            //Impossible de supprimer le fichier temporaire
-                            //std::cerr << "Impossible de supprimer le fichier de temporaire " << SpathTmp.c_str() << std::endl;
-                            //std::cerr << "errno: " << errno << " " << strerror(errno) << std::endl;
-                        }
-
-                        parallelProcess->destroyLogger();
-                        //on arrete le processus
-                        exit(0);
+    if (stat (SpathErr.c_str(), &buffer) == 0) {
+        //la génération de la dalle a échoué : on ne réessaye pas
+        return getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
+    }
 
-                    } else {
-                        //PROCESSUS PERE
-                        //on va répondre a la requête
-                        LOGGER_DEBUG("Processus parallele lance ");
-                        LOGGER_DEBUG("Création de la dalle "+Spath);
-                        LOGGER_DEBUG("Log dans le fichier "+SpathErr);
+    if (stat (Spath.c_str(), &buffer) == 0 && stat (SpathTmp.c_str(), &buffer) == -1) {
+        //la dalle existe et n'est pas en cours d'écriture
+        return getTileUsual(L, tileMatrix, tileCol, tileRow, style, format);
+    }
 
-                        tile = getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
-                    }
+    //la dalle n'existe pas ou est en cours de génération : on la demande à la file, qui regroupe les requêtes sur une même dalle
+    SlabJob* job = slabQueue->request(Spath, L, tileMatrix, tileCol, tileRow, style, format);
+    if (job == NULL) {
+        LOGGER_WARN("File de génération des dalles pleine, pas de génération de la dalle " << Spath);
+        return getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
+    }
+
+    //on attend la dalle, pendant un temps borné
+    SlabJob::State state = slabQueue->wait(job, serverConf->slabWaitTime);
+    slabQueue->release(job);
 
-                    //-------------------------------------------------------------------------------------------------
+    if (state == SlabJob::DONE) {
+        LOGGER_DEBUG("Dalle générée, lecture de la tuile dans " << Spath);
+        return getTileUsual(L, tileMatrix, tileCol, tileRow, style, format);
+    }
 
+    //la dalle n'est pas encore générée, ou ne peut pas l'être
+    return getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
 
-                } else {
-                    LOGGER_WARN("Impossible de créer un processus parallele donc pas de génération de dalle");
-                    tile = getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
-                }
-            }
+}
+
+bool Rok4Server::buildSlab(SlabJob* job, void* arg) {
+    Rok4Server* server = (Rok4Server*) arg;
+
+    Level* lev = job->getLayer()->getDataPyramid()->getLevel(job->getTileMatrix());
+    std::string Spath = job->getPath();
+    std::string SpathTmp = Spath + ".tmp";
+    std::string SpathErr = Spath + ".err";
+    std::string SpathDir = lev->getDirPath(job->getTileCol(), job->getTileRow());
+    struct stat buffer;
+
+    //on commence par créer le dossier
+    if (lev->createDirPath(SpathDir.c_str()) == -1 && errno != EEXIST) {
+        LOGGER_ERROR("Impossible de creer le dossier contenant la dalle " << SpathDir << " : " << strerror(errno));
+        return false;
+    }
+
+    //un fichier temporaire indique aux autres serveurs que la dalle est en cours de création
+    int fileTmp = open(SpathTmp.c_str(), O_CREAT|O_EXCL, S_IWRITE);
+    if (fileTmp == -1) {
+        //la dalle est déjà en cours de création par un autre serveur
+        LOGGER_DEBUG("Dalle déjà en cours de création : " << Spath);
+        return false;
+    }
+    close(fileTmp);
+
+    bool ok = (server->createSlabOnFly(job->getLayer(), job->getTileMatrix(), job->getTileCol(), job->getTileRow(), job->getStyle(), job->getFormat(), Spath) == 0);
+
+    if (! ok) {
+        LOGGER_ERROR("Echec de la génération de la dalle " << Spath);
+
+        //on supprime la dalle potentiellement existante mais contenant des erreurs
+        if (stat (Spath.c_str(), &buffer) == 0 && remove(Spath.c_str()) != 0) {
+            LOGGER_ERROR("Impossible de supprimer la dalle contenant des erreurs " << Spath << " : " << strerror(errno));
         }
+
+        //le fichier d'erreur empêche de nouvelles tentatives
+        std::ofstream err(SpathErr.c_str());
+        err << "Echec de la generation de la dalle, cf les logs du serveur" << std::endl;
+        err.close();
     }
 
-    return tile;
+    if (remove(SpathTmp.c_str()) != 0) {
+        LOGGER_ERROR("Impossible de supprimer le fichier temporaire " << SpathTmp << " : " << strerror(errno));
+    }
 
+    return ok;
 }
 
 int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format, std::string path) {
@@ -1083,13 +1175,19 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
             bLevel = bPyr->getLevels().begin()->second->getId();
 
             LOGGER_DEBUG("Create reprojected image");
-            curImage = bPyr->createBasedSlab(bLevel, bbox, dst_crs, servicesConf, width, height, interpolation, error);
+            if ( isTerrainStyle ( bStyle, bPyr, pyrType, format, bSize ) ) {
+                curImage = getTerrainImage ( bPyr, bStyle, bbox, width, height, dst_crs, error );
+            } else {
+                curImage = bPyr->createBasedSlab(bLevel, bbox, dst_crs, servicesConf, width, height, interpolation, error);
+            }
             LOGGER_DEBUG("Created");
             if (curImage != NULL) {
                 //On applique un style à l'image
                 image = styleImage(curImage, pyrType, bStyle, format, bSize, bPyr);
                 if (!image) {
                      LOGGER_ERROR("Impossible d'appliquer le style");
+                     delete curImage;
+                     for (unsigned int j = 0; j < images.size(); j++) delete images.at(j);
                      state = 1;
                      return state;
                 } else {
@@ -1098,13 +1196,11 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
                 }
             } else {
                 LOGGER_ERROR("Impossible de générer la dalle car l'une des basedPyramid du layer "+L->getTitle()+" ne renvoit pas de tuile");
+                for (unsigned int j = 0; j < images.size(); j++) delete images.at(j);
                 state = 1;
-                delete bStyle;
                 return state;
             }
 
-            delete bStyle;
-
         } else {
 
             if (type == WEBSERVICE) {
@@ -1119,6 +1215,7 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
                     images.push_back(image);
                 } else {
                     LOGGER_ERROR("Impossible de generer la tuile car l'un des WebServices du layer "+L->getTitle()+" ne renvoit pas de tuile");
+                    for (unsigned int j = 0; j < images.size(); j++) delete images.at(j);
                     state = 1;
                     return state;
                 }
@@ -1137,6 +1234,7 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
         LOGGER_DEBUG("Merged differents basedImages");
         if (mergeImage == NULL) {
             LOGGER_ERROR("Impossible de générer la dalle car l'opération de merge n'a pas fonctionné");
+            for (unsigned int j = 0; j < images.size(); j++) delete images.at(j);
             state = 1;
             return state;
         }
@@ -1166,14 +1264,15 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
     char * pathToWrite = (char *)path.c_str();
     LOGGER_DEBUG("Create Rok4Image");
 
-    FileContext* fc = new FileContext("");
-    fc->connection();
+    // La Rok4Image ne possède pas son contexte : il ne doit vivre que le temps de l'écriture
+    FileContext fc("");
+    fc.connection();
 
     Rok4Image * finalImage = R4IF.createRok4ImageToWrite(
         pathToWrite,bbox,lastImage->getResX(),lastImage->getResY(),
         lastImage->getWidth(),lastImage->getHeight(),pyr->getChannels(),
         pyr->getSampleFormat(),pyr->getBitsPerSample(),
-        pyr->getPhotometric(),pyr->getSampleCompression(),tileW, tileH, fc
+        pyr->getPhotometric(),pyr->getSampleCompression(),tileW, tileH, &fc
     );
 
     LOGGER_DEBUG("Created");
@@ -1485,6 +1584,8 @@ ContextBook* Rok4Server::getObjectBook() {return serverConf->getContextBook();}
 
 int Rok4Server::getFCGISocket() { return sock; }
 void Rok4Server::setFCGISocket ( int sockFCGI ) { sock = sockFCGI; }
+int Rok4Server::getHTTPSocket() { return httpSock; }
+void Rok4Server::setHTTPSocket ( int sockHTTP ) { httpSock = sockHTTP; }
 bool Rok4Server::isRunning() { return running ; }
 bool Rok4Server::isWMTSSupported(){ return serverConf->supportWMTS ; }
 bool Rok4Server::isWMSSupported(){ return serverConf->supportWMS ; }
@@ -57,7 +57,8 @@
 #include <stdio.h>
 #include "TileMatrixSet.h"
 #include "DocumentXML.h"
-#include "ProcessFactory.h"
+#include "SlabQueue.h"
+#include "FcgiDispatcher.h"
 #include "fcgiapp.h"
 #include <csignal>
 #include "ServerXML.h"
@@ -78,12 +79,15 @@
  * \brief Handle the main program (event loop) and links
  */
 class Rok4Server {
+#ifdef UNITTEST
+    friend class CppUnitRok4Server;
+#endif //UNITTEST
 private:
     /**
-     * \~french \brief Liste des processus léger
-     * \~english \brief Threads liste
+     * \~french \brief Frontal FastCGI, recevant les requêtes et les répartissant entre les threads de traitement
+     * \~english \brief FastCGI front end, receiving requests and dispatching them between processing threads
      */
-    std::vector<pthread_t> threads;
+    FcgiDispatcher* dispatcher;
 
     /**
      * \~french \brief Connecteur sur le flux FCGI
@@ -103,6 +107,12 @@ private:
      */
     int sock;
 
+    /**
+     * \~french \brief Identifiant du socket HTTP, négatif si absent
+     * \~english \brief HTTP socket identifier, negative if missing
+     */
+    int httpSock;
+
     /**
      * \~french \brief Configurations globales des services
      * \~english \brief Global services configuration
@@ -133,22 +143,50 @@ private:
 
 
     /**
-     * \~french \brief Gestion des processus créés
-     * \~english \brief Management of created process
+     * \~french \brief File de génération des dalles des pyramides à la volée
+     * \~english \brief Generation queue of on fly pyramids' slabs
      */
-    ProcessFactory *parallelProcess;
+    SlabQueue *slabQueue;
 
     /**
      * \~french
-     * \brief Boucle principale exécutée par chaque thread à l'écoute des requêtes des utilisateurs.
+     * \brief Génération d'une dalle demandée, exécutée par les threads de la file des dalles
+     * \details Un fichier .tmp signale la génération aux autres serveurs partageant le stockage. En cas d'échec, un fichier .err empêche de nouvelles tentatives.
+     * \param[in] job demande de génération
      * \param[in] arg pointeur vers l'instance de Rok4Server
-     * \return true si présent
+     * \return VRAI si la dalle a été écrite
      * \~english
-     * \brief Main event loop executed by each thread, listening to user request
+     * \brief Requested slab generation, executed by slabs' queue threads
+     * \details A .tmp file signals generation to other servers sharing the storage. If failure, a .err file prevents new attempts.
+     * \param[in] job generation request
      * \param[in] arg pointer to the Rok4Server instance
-     * \return true if present
+     * \return TRUE if the slab has been written
+     */
+    static bool buildSlab ( SlabJob* job, void* arg );
+
+    /**
+     * \~french
+     * \brief Traitement d'une requête FastCGI complète, exécuté par les threads de traitement
+     * \param[in] fcgxRequest requête FastCGI, dont la réponse est écrite dans le flux de sortie
+     * \param[in] arg pointeur vers l'instance de Rok4Server
+     * \~english
+     * \brief Complete FastCGI request processing, executed by processing threads
+     * \param[in] fcgxRequest FastCGI request, whose response is written in the output stream
+     * \param[in] arg pointer to the Rok4Server instance
+     */
+    static void processFcgiRequest ( FCGX_Request* fcgxRequest, void* arg );
+
+    /**
+     * \~french
+     * \brief Reprise d'une requête GetTile mise en attente de la lecture de sa tuile (cf FcgiDispatcher::parkReads)
+     * \param[in] fcgxRequest requête FastCGI
+     * \param[in] state requête et tuile lue
+     * \~english
+     * \brief Resumption of a GetTile request parked waiting for its tile's reading (see FcgiDispatcher::parkReads)
+     * \param[in] fcgxRequest FastCGI request
+     * \param[in] state request and read tile
      */
-    static void* thread_loop ( void* arg );
+    static void resumeTileRequest ( FCGX_Request* fcgxRequest, void* state );
     
     /**
      * \~french
@@ -195,6 +233,16 @@ private:
      */
     void buildTMSCapabilities();
 
+    /**
+     * \~french
+     * \brief Prépare les transformations PROJ utilisées par les requêtes WMS
+     * \details Pour chaque couche, les transformations entre les CRS autorisés (de la couche et globaux) et celui de la pyramide, ainsi que vers et depuis la géographie, sont initialisées dans le ProjCache.
+     * \~english
+     * \brief Prepare PROJ transformations used by WMS requests
+     * \details For each layer, transformations between allowed CRS (layer's and global ones) and pyramid's one, as well as to and from geographic, are initialized in the ProjCache.
+     */
+    void warmProjCache();
+
     /**
      * \~french
      * \brief Récuperation et vérifications des paramètres d'une requête GetTile
@@ -280,6 +328,7 @@ private:
     /**
      * \~french
      * \brief Applique un style à une image
+     * \details Pour un style de terrain (cf #isTerrainStyle), l'image fournie doit être celle de #getTerrainImage, élargie d'un pixel de chaque côté : l'image stylisée est calculée sur le cœur de cette image, sans nouvelle lecture de la pyramide.
      * \param[in] image à styliser
      * \param[in] pyrType format des tuiles de la pyramide
      * \param[in] style style demandé par le client
@@ -288,6 +337,7 @@ private:
      * \return image stylisée
      * \~english
      * \brief Apply a style to an image
+     * \details For a terrain style (see #isTerrainStyle), provided image have to be the #getTerrainImage one, expanded by one pixel on each side : styled image is computed on this image's core, without reading the pyramid again.
      * \param[in] image
      * \param[in] pyrType tile format of the pyramid
      * \param[in] style asked style by the client
@@ -296,6 +346,50 @@ private:
      * \return requested and styled image
      */
     Image *styleImage(Image *curImage, Rok4Format::eformat_data pyrType, Style *style, std::string format, int size, Pyramid *pyr);
+    /**
+     * \~french
+     * \brief Indique si le style calcule chaque pixel à partir de ses voisins (estompage, pente ou exposition)
+     * \details L'image source doit alors être lue avec une marge d'un pixel, avec #getTerrainImage. Les conditions sont celles de la création des images de terrain dans #styleImage.
+     * \param[in] style style demandé par le client
+     * \param[in] pyr pyramide source
+     * \param[in] pyrType format des tuiles de la pyramide
+     * \param[in] format demandé par le client
+     * \param[in] size nombre d'images concernées par le processus global
+     * \~english
+     * \brief Tell if style computes each pixel from its neighbours (hillshade, slope or aspect)
+     * \details Source image have then to be read with a one pixel margin, with #getTerrainImage. Conditions are the terrain images' creation ones in #styleImage.
+     * \param[in] style asked style by the client
+     * \param[in] pyr source pyramid
+     * \param[in] pyrType tile format of the pyramid
+     * \param[in] format asked format by the client
+     * \param[in] size number of images used in the global process
+     */
+    bool isTerrainStyle(Style *style, Pyramid *pyr, Rok4Format::eformat_data pyrType, std::string format, int size);
+    /**
+     * \~french
+     * \brief Lit en une seule fois l'image source d'un style de terrain, élargie d'un pixel de chaque côté
+     * \details La marge et le cœur de l'image sont ensuite tous deux tirés de cette unique lecture par #styleImage. L'interpolation utilisée est celle du style.
+     * \param[in] pyr pyramide source
+     * \param[in] style style de terrain demandé par le client
+     * \param[in] bbox emprise de l'image demandée, sans marge
+     * \param[in] width largeur de l'image demandée, sans marge
+     * \param[in] height hauteur de l'image demandée, sans marge
+     * \param[in] crs système de coordonnées de l'image demandée
+     * \param[out] error code d'erreur de la lecture
+     * \return image élargie, NULL en cas d'erreur
+     * \~english
+     * \brief Read once the terrain style's source image, expanded by one pixel on each side
+     * \details Margin and core are then both taken from this single read by #styleImage. Interpolation is the style's one.
+     * \param[in] pyr source pyramid
+     * \param[in] style asked terrain style
+     * \param[in] bbox asked image's bounding box, without margin
+     * \param[in] width asked image's width, without margin
+     * \param[in] height asked image's height, without margin
+     * \param[in] crs asked image's CRS
+     * \param[out] error read error code
+     * \return expanded image, NULL if error
+     */
+    Image *getTerrainImage(Pyramid *pyr, Style *style, BoundingBox<double> bbox, int width, int height, CRS crs, int &error);
     /**
      * \~french
      * \brief Fond un groupe d'image en une seule
@@ -346,6 +440,7 @@ private:
      * \param[in] tileMatrix tilematrix de la requête
      * \param[in] errorResp paramètre d'erreur
      * \param[in] style style de la requête
+     * \param[in] encData tuile encodée déjà obtenue, NULL pour l'obtenir ici
      * \return image demandé ou un message d'erreur
      * \~english
      * \brief Give a tile computed before
@@ -356,9 +451,10 @@ private:
      * \param[in] tileMatrix tilematrix of the request
      * \param[in] errorResp error parameter
      * \param[in] style style of the resquest
+     * \param[in] encData already got encoded tile, NULL to get it here
      * \return requested tile
      */
-    DataSource *getTileUsual(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format);
+    DataSource *getTileUsual(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format, DataSource* encData = NULL);
     /**
      * \~french
      * \brief Renvoit une tuile qui vient d'être calculée
@@ -512,13 +608,29 @@ private:
      * \~french
      * \brief Traitement d'une requête GetTile
      * \param[in] request représentation de la requête
+     * \param[in] encData tuile déjà obtenue avec #getStoredTile, NULL sinon
      * \return image demandé ou un message d'erreur
      * \~english
      * \brief Process a GetTile request
      * \param[in] request request representation
+     * \param[in] encData tile already got with #getStoredTile, NULL otherwise
      * \return requested image or an error message
      */
-    DataSource* getTile ( Request* request );
+    DataSource* getTile ( Request* request, DataSource* encData = NULL );
+
+    /**
+     * \~french
+     * \brief Tuile d'une requête GetTile valide, lue dans une dalle d'un contexte sachant mener plusieurs lectures en parallèle
+     * \details Seules les tuiles d'un niveau classique (ni à la volée, ni à la demande) sont concernées, et pas les requêtes conditionnelles, dont la réponse peut ne pas nécessiter la tuile. La tuile n'est pas encore lue (sauf si elle vient du cache des tuiles).
+     * \param[in] request représentation de la requête
+     * \return tuile encodée, NULL si la requête n'est pas concernée
+     * \~english
+     * \brief Tile of a valid GetTile request, read in a slab from a context able to handle several readings in parallel
+     * \details Only tiles from a usual level (neither on fly nor on demand) are concerned, and not conditional requests, whose response may not need the tile. Tile is not read yet (except if it comes from the tiles cache).
+     * \param[in] request request representation
+     * \return encoded tile, NULL if request is not concerned
+     */
+    DataSource* getStoredTile ( Request* request );
 
     /**
      * \~french
@@ -729,12 +841,42 @@ public:
      * \param sockFCGI the internal FastCGI socket representation
      */
     void setFCGISocket ( int sockFCGI ) ;
+
+    /**
+     * \~french
+     * \brief Initialise le socket HTTP, si une adresse d'écoute HTTP est configurée
+     * \details Les requêtes HTTP sont reçues directement, sans serveur web frontal, et traitées comme les requêtes FastCGI.
+     * \~english
+     * \brief Initialize the HTTP socket, if an HTTP listening address is configured
+     * \details HTTP requests are directly received, without front web server, and processed as FastCGI requests.
+     */
+    void initHTTP();
+
+    /**
+     * \~french
+     * Utilisé pour le rechargement de la configuration du serveur
+     * \brief Retourne la représentation interne du socket HTTP
+     * \~english
+     * \brief Get the internal HTTP socket representation, usefull for configuration reloading.
+     */
+    int getHTTPSocket() ;
+
+    /**
+     * \~french
+     * Utilisé pour le rechargement de la configuration du serveur
+     * \brief Restaure le socket HTTP
+     * \~english
+     * \brief Set the internal HTTP socket representation, usefull for configuration reloading.
+     */
+    void setHTTPSocket ( int sockHTTP ) ;
     
      /**
      * \~french
      * \brief Demande l'arrêt du serveur
+     * \details Appelée par les gestionnaires de signaux : seul l'arrêt de la boucle d'évènements est demandé, #run rend la main une fois les requêtes en cours terminées.
      * \~english
      * \brief Ask for server shutdown
+     * \details Called by signal handlers : only the event loop stop is requested, #run returns once pending requests are done.
      */
     void terminate();
 
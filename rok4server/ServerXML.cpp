@@ -150,6 +150,24 @@ ServerXML::ServerXML(std::string path ) : DocumentXML(path) {
         timeKill = DEFAULT_MAX_TIME_PROCESS;
     }
 
+    pElem=hRoot.FirstChild ( "slabQueueSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de slabQueueSize => slabQueueSize = " ) << DEFAULT_SLAB_QUEUE_SIZE <<std::endl;
+        slabQueueSize = DEFAULT_SLAB_QUEUE_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&slabQueueSize ) || slabQueueSize < 0 ) {
+        std::cerr<<_ ( "Le slabQueueSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "slabWaitTime" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de slabWaitTime => slabWaitTime = " ) << DEFAULT_SLAB_WAIT_TIME <<std::endl;
+        slabWaitTime = DEFAULT_SLAB_WAIT_TIME;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&slabWaitTime ) || slabWaitTime < 0 ) {
+        std::cerr<<_ ( "Le slabWaitTime [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
     pElem=hRoot.FirstChild ( "WMTSSupport" ).Element();
     if ( !pElem || ! ( pElem->GetText() ) ) {
         std::cerr<<_ ( "Pas de WMTSSupport => supportWMTS = true" ) <<std::endl;
@@ -287,6 +305,14 @@ ServerXML::ServerXML(std::string path ) : DocumentXML(path) {
         socket = DocumentXML::getTextStrFromElem(pElem);
     }
 
+    pElem=hRoot.FirstChild ( "httpPort" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <httpPort> : pas de reception directe des requetes HTTP" ) <<std::endl;
+        httpSocket = "";
+    } else {
+        httpSocket = DocumentXML::getTextStrFromElem(pElem);
+    }
+
     pElem=hRoot.FirstChild ( "serverBackLog" ).Element();
     if ( !pElem || ! ( pElem->GetText() ) ) {
         std::clog<<_ ( "Pas d'element <serverBackLog> valeur par defaut : 0" ) <<std::endl;
@@ -296,6 +322,168 @@ ServerXML::ServerXML(std::string path ) : DocumentXML(path) {
         backlog = 0;
     }
 
+    pElem=hRoot.FirstChild ( "indexCacheSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de indexCacheSize => indexCacheSize = " ) << DEFAULT_INDEX_CACHE_SIZE <<std::endl;
+        indexCacheSize = DEFAULT_INDEX_CACHE_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&indexCacheSize ) || indexCacheSize < 0 ) {
+        std::cerr<<_ ( "Le indexCacheSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "indexCacheValidity" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de indexCacheValidity => indexCacheValidity = " ) << DEFAULT_INDEX_CACHE_VALIDITY <<std::endl;
+        indexCacheValidity = DEFAULT_INDEX_CACHE_VALIDITY;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&indexCacheValidity ) || indexCacheValidity < 0 ) {
+        std::cerr<<_ ( "Le indexCacheValidity [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "tileFetchThreads" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de tileFetchThreads => tileFetchThreads = " ) << DEFAULT_TILE_FETCH_THREADS <<std::endl;
+        tileFetchThreads = DEFAULT_TILE_FETCH_THREADS;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&tileFetchThreads ) || tileFetchThreads < 0 ) {
+        std::cerr<<_ ( "Le tileFetchThreads [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "tileFetchPerRequest" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de tileFetchPerRequest => tileFetchPerRequest = " ) << DEFAULT_TILE_FETCH_PER_REQUEST <<std::endl;
+        tileFetchPerRequest = DEFAULT_TILE_FETCH_PER_REQUEST;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&tileFetchPerRequest ) || tileFetchPerRequest < 1 ) {
+        std::cerr<<_ ( "Le tileFetchPerRequest [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a strictly positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "fdCacheSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de fdCacheSize => fdCacheSize = " ) << DEFAULT_FD_CACHE_SIZE <<std::endl;
+        fdCacheSize = DEFAULT_FD_CACHE_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&fdCacheSize ) || fdCacheSize < 0 ) {
+        std::cerr<<_ ( "Le fdCacheSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "fdCacheValidity" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de fdCacheValidity => fdCacheValidity = " ) << DEFAULT_FD_CACHE_VALIDITY <<std::endl;
+        fdCacheValidity = DEFAULT_FD_CACHE_VALIDITY;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&fdCacheValidity ) || fdCacheValidity < 0 ) {
+        std::cerr<<_ ( "Le fdCacheValidity [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "fdRandomAccess" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de fdRandomAccess => fdRandomAccess = false" ) <<std::endl;
+        fdRandomAccess = false;
+    } else {
+        std::string strRandom ( pElem->GetText() );
+        if ( strRandom=="true" ) fdRandomAccess=true;
+        else if ( strRandom=="false" ) fdRandomAccess=false;
+        else {
+            std::cerr<<_ ( "Le fdRandomAccess [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] n'est pas un booleen." ) <<std::endl;
+            return;
+        }
+    }
+
+    pElem=hRoot.FirstChild ( "tileCacheSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de tileCacheSize => tileCacheSize = " ) << DEFAULT_TILE_CACHE_SIZE <<std::endl;
+        tileCacheSize = DEFAULT_TILE_CACHE_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&tileCacheSize ) || tileCacheSize < 0 ) {
+        std::cerr<<_ ( "Le tileCacheSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "tileCacheValidity" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de tileCacheValidity => tileCacheValidity = " ) << DEFAULT_TILE_CACHE_VALIDITY <<std::endl;
+        tileCacheValidity = DEFAULT_TILE_CACHE_VALIDITY;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&tileCacheValidity ) || tileCacheValidity < 0 ) {
+        std::cerr<<_ ( "Le tileCacheValidity [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "tileCacheAdmission" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de tileCacheAdmission => tileCacheAdmission = true" ) <<std::endl;
+        tileCacheAdmission = true;
+    } else {
+        std::string strAdmission ( pElem->GetText() );
+        if ( strAdmission=="true" ) tileCacheAdmission=true;
+        else if ( strAdmission=="false" ) tileCacheAdmission=false;
+        else {
+            std::cerr<<_ ( "Le tileCacheAdmission [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] n'est pas un booleen." ) <<std::endl;
+            return;
+        }
+    }
+
+    pElem=hRoot.FirstChild ( "webCacheSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de webCacheSize => webCacheSize = " ) << DEFAULT_WEB_CACHE_SIZE <<std::endl;
+        webCacheSize = DEFAULT_WEB_CACHE_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&webCacheSize ) || webCacheSize < 0 ) {
+        std::cerr<<_ ( "Le webCacheSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "webCacheValidity" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de webCacheValidity => webCacheValidity = " ) << DEFAULT_WEB_CACHE_VALIDITY <<std::endl;
+        webCacheValidity = DEFAULT_WEB_CACHE_VALIDITY;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&webCacheValidity ) || webCacheValidity < 0 ) {
+        std::cerr<<_ ( "Le webCacheValidity [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "webCacheDirectory" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de webCacheDirectory : pas de cache des services distants sur disque" ) <<std::endl;
+        webCacheDirectory = "";
+    } else {
+        webCacheDirectory = DocumentXML::getTextStrFromElem(pElem);
+    }
+
+    pElem=hRoot.FirstChild ( "webCacheDiskSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de webCacheDiskSize => webCacheDiskSize = " ) << DEFAULT_WEB_CACHE_DISK_SIZE <<std::endl;
+        webCacheDiskSize = DEFAULT_WEB_CACHE_DISK_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&webCacheDiskSize ) || webCacheDiskSize < 0 ) {
+        std::cerr<<_ ( "Le webCacheDiskSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "bufferPoolSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de bufferPoolSize => bufferPoolSize = " ) << DEFAULT_BUFFER_POOL_SIZE <<std::endl;
+        bufferPoolSize = DEFAULT_BUFFER_POOL_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&bufferPoolSize ) || bufferPoolSize < 0 ) {
+        std::cerr<<_ ( "Le bufferPoolSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "projCacheSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de projCacheSize => projCacheSize = " ) << DEFAULT_PROJ_CACHE_SIZE <<std::endl;
+        projCacheSize = DEFAULT_PROJ_CACHE_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&projCacheSize ) || projCacheSize < 0 ) {
+        std::cerr<<_ ( "Le projCacheSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "reprojectionTolerance" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas de reprojectionTolerance => reprojectionTolerance = " ) << DEFAULT_REPROJECTION_TOLERANCE <<std::endl;
+        reprojectionTolerance = DEFAULT_REPROJECTION_TOLERANCE;
+    } else if ( !sscanf ( pElem->GetText(),"%lf",&reprojectionTolerance ) || reprojectionTolerance < 0 ) {
+        std::cerr<<_ ( "Le reprojectionTolerance [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive number." ) <<std::endl;
+        return;
+    }
+
     //on créé systématiquement le contextbook()
     objectBook = new ContextBook();
 
@@ -466,9 +654,29 @@ int ServerXML::getReconnectionFrequency() {return reconnectionFrequency;}
 
 int ServerXML::getNbThreads() {return nbThread;}
 std::string ServerXML::getSocket() {return socket;}
+std::string ServerXML::getHttpSocket() {return httpSocket;}
 bool ServerXML::getSupportWMTS() {return supportWMTS;}
 bool ServerXML::getSupportTMS() {return supportTMS;}
 bool ServerXML::getSupportWMS() {return supportWMS;}
 int ServerXML::getBacklog() {return backlog;}
 int ServerXML::getTimeKill() {return timeKill;}
+int ServerXML::getSlabQueueSize() {return slabQueueSize;}
+int ServerXML::getSlabWaitTime() {return slabWaitTime;}
+int ServerXML::getIndexCacheSize() {return indexCacheSize;}
+int ServerXML::getIndexCacheValidity() {return indexCacheValidity;}
+int ServerXML::getTileFetchThreads() {return tileFetchThreads;}
+int ServerXML::getTileFetchPerRequest() {return tileFetchPerRequest;}
+int ServerXML::getFdCacheSize() {return fdCacheSize;}
+int ServerXML::getFdCacheValidity() {return fdCacheValidity;}
+bool ServerXML::getFdRandomAccess() {return fdRandomAccess;}
+int ServerXML::getTileCacheSize() {return tileCacheSize;}
+int ServerXML::getTileCacheValidity() {return tileCacheValidity;}
+bool ServerXML::getTileCacheAdmission() {return tileCacheAdmission;}
+int ServerXML::getWebCacheSize() {return webCacheSize;}
+int ServerXML::getWebCacheValidity() {return webCacheValidity;}
+std::string ServerXML::getWebCacheDirectory() {return webCacheDirectory;}
+int ServerXML::getWebCacheDiskSize() {return webCacheDiskSize;}
+int ServerXML::getBufferPoolSize() {return bufferPoolSize;}
+int ServerXML::getProjCacheSize() {return projCacheSize;}
+double ServerXML::getReprojectionTolerance() {return reprojectionTolerance;}
 bool ServerXML::getReprojectionCapability() { return reprojectionCapability; }
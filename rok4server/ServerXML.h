@@ -101,12 +101,32 @@ class ServerXML : public DocumentXML
         
         int getNbThreads() ;
         std::string getSocket() ;
+        std::string getHttpSocket() ;
         bool getSupportWMTS() ;
         bool getSupportTMS() ;
         bool getSupportWMS() ;
         bool getReprojectionCapability() ;
         int getBacklog() ;
         int getTimeKill() ;
+        int getSlabQueueSize() ;
+        int getSlabWaitTime() ;
+        int getIndexCacheSize() ;
+        int getIndexCacheValidity() ;
+        int getTileFetchThreads() ;
+        int getTileFetchPerRequest() ;
+        int getFdCacheSize() ;
+        int getFdCacheValidity() ;
+        bool getFdRandomAccess() ;
+        int getTileCacheSize() ;
+        int getTileCacheValidity() ;
+        bool getTileCacheAdmission() ;
+        int getWebCacheSize() ;
+        int getWebCacheValidity() ;
+        std::string getWebCacheDirectory() ;
+        int getWebCacheDiskSize() ;
+        int getBufferPoolSize() ;
+        int getProjCacheSize() ;
+        double getReprojectionTolerance() ;
 
     protected:
 
@@ -165,13 +185,123 @@ class ServerXML : public DocumentXML
          * \~english \brief Listening socket address (empty if lauched in managed mode)
          */
         std::string socket;
+        /**
+         * \~french \brief Adresse du socket d'écoute HTTP (vide pour ne pas recevoir directement de requêtes HTTP)
+         * \~english \brief HTTP listening socket address (empty not to directly receive HTTP requests)
+         */
+        std::string httpSocket;
         /**
          * \~french \brief Profondeur de la file d'attente du socket
          * \~english \brief Socket listen queue depth
          */
         int backlog;
 
+        /**
+         * \~french \brief Délai, en secondes, au-delà duquel une dalle à la volée en attente de génération est abandonnée
+         * \~english \brief Delay, in seconds, beyond which an on fly slab waiting for generation is abandoned
+         */
         int timeKill;
+        /**
+         * \~french \brief Nombre maximal de dalles à la volée en attente de génération
+         * \~english \brief Max number of on fly slabs waiting for generation
+         */
+        int slabQueueSize;
+        /**
+         * \~french \brief Durée maximale, en millisecondes, pendant laquelle une requête attend la génération de sa dalle
+         * \~english \brief Max time, in milliseconds, a request waits for its slab's generation
+         */
+        int slabWaitTime;
+
+        /**
+         * \~french \brief Taille maximale du cache des index de dalles, en mégaoctets (0 pour le désactiver)
+         * \~english \brief Max size of the slabs' indexes cache, in megabytes (0 to disable it)
+         */
+        int indexCacheSize;
+        /**
+         * \~french \brief Durée de validité d'un index dans le cache, en secondes (0 pour une validité illimitée)
+         * \~english \brief Validity period of an index in the cache, in seconds (0 for unlimited validity)
+         */
+        int indexCacheValidity;
+
+        /**
+         * \~french \brief Nombre de threads du groupe partagé lisant et décodant les tuiles (0 pour une lecture séquentielle)
+         * \~english \brief Number of threads in the shared pool reading and decoding tiles (0 for sequential reading)
+         */
+        int tileFetchThreads;
+        /**
+         * \~french \brief Nombre maximal de lectures de tuiles parallèles pour une même requête
+         * \~english \brief Maximal number of parallel tile readings for one request
+         */
+        int tileFetchPerRequest;
+
+        /**
+         * \~french \brief Nombre maximal de fichiers de dalles gardés ouverts (0 pour les fermer après chaque lecture)
+         * \~english \brief Max number of slab files kept open (0 to close them after each reading)
+         */
+        int fdCacheSize;
+        /**
+         * \~french \brief Durée entre deux vérifications qu'un fichier ouvert n'a pas été réécrit, en secondes (0 pour ne jamais vérifier)
+         * \~english \brief Duration between two checks that an open file has not been rewritten, in seconds (0 to never check)
+         */
+        int fdCacheValidity;
+        /**
+         * \~french \brief Indique au noyau que les dalles sont lues de manière aléatoire (pas de lecture anticipée)
+         * \~english \brief Tell the kernel slabs are randomly read (no readahead)
+         */
+        bool fdRandomAccess;
+
+        /**
+         * \~french \brief Taille maximale du cache des tuiles, en mégaoctets (0 pour le désactiver)
+         * \details Seules les couches l'ayant demandé utilisent ce cache
+         * \~english \brief Max size of the tiles cache, in megabytes (0 to disable it)
+         * \details Only layers asking for it use this cache
+         */
+        int tileCacheSize;
+        /**
+         * \~french \brief Durée de validité d'une tuile dans le cache, en secondes (0 pour une validité illimitée)
+         * \~english \brief Validity period of a tile in the cache, in seconds (0 for unlimited validity)
+         */
+        int tileCacheValidity;
+        /**
+         * \~french \brief N'admet une tuile dans le cache plein que si elle est plus demandée que celle qu'elle remplace
+         * \~english \brief Admit a tile in the full cache only if it is more requested than the replaced one
+         */
+        bool tileCacheAdmission;
+        /**
+         * \~french \brief Taille maximale en mémoire du cache des réponses des services distants moissonnés, en mégaoctets (0 pour le désactiver)
+         * \~english \brief Max in memory size of the harvested remote services' answers cache, in megabytes (0 to disable it)
+         */
+        int webCacheSize;
+        /**
+         * \~french \brief Durée de validité d'une réponse dans le cache des services distants, en secondes (0 pour une validité illimitée)
+         * \~english \brief Validity period of an answer in the remote services cache, in seconds (0 for unlimited validity)
+         */
+        int webCacheValidity;
+        /**
+         * \~french \brief Répertoire du cache des services distants sur disque (vide pour ne pas l'utiliser)
+         * \~english \brief Directory of the on disk remote services cache (empty not to use it)
+         */
+        std::string webCacheDirectory;
+        /**
+         * \~french \brief Volume maximal du cache des services distants sur disque, en mégaoctets
+         * \~english \brief Max volume of the on disk remote services cache, in megabytes
+         */
+        int webCacheDiskSize;
+        /**
+         * \~french \brief Mémoire maximale gardée par le pool de tampons entre deux requêtes, en mégaoctets
+         * \~english \brief Max memory kept by the buffers pool between two requests, in megabytes
+         */
+        int bufferPoolSize;
+        /**
+         * \~french \brief Nombre maximal de transformations PROJ initialisées gardées entre deux requêtes
+         * \~english \brief Max number of initialized PROJ transformations kept between two requests
+         */
+        int projCacheSize;
+        /**
+         * \~french \brief Écart maximal toléré, en pixels sources, lors de la reprojection adaptative des grilles
+         * \~english \brief Maximal gap allowed, in source pixels, during grids' adaptive reprojection
+         */
+        double reprojectionTolerance;
 
 
         /**
@@ -187,6 +317,10 @@ class ServerXML : public DocumentXML
 
 #endif
 
+        /**
+         * \~french \brief Nombre de threads générant les dalles des pyramides à la volée
+         * \~english \brief Number of threads generating on fly pyramids' slabs
+         */
         int nbProcess;
 
     private:
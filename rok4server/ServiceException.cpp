@@ -126,6 +126,8 @@ std::string ServiceException::getStatusCodeAsReasonPhrase ( int statusCode ) {
     switch ( statusCode ) {
     case 200 :
         return "OK" ;
+    case 304 :
+        return "Not Modified" ;
     case 400 :
         return "BadRequest" ;
     case 404 :
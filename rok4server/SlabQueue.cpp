@@ -0,0 +1,207 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file SlabQueue.cpp
+ ** \~french
+ * \brief Implémentation de la classe SlabQueue
+ ** \~english
+ * \brief Implement class SlabQueue
+ */
+
+#include "SlabQueue.h"
+#include "Logger.h"
+#include <sys/time.h>
+#include <cerrno>
+
+SlabQueue::SlabQueue ( int nbThreads, int maxPending, int timeout, SlabBuilder builder, void* arg ) :
+    maxPending ( maxPending ), pending ( 0 ), timeout ( timeout ), counter ( 0 ), stopping ( false ), builder ( builder ), builderArg ( arg ) {
+
+    pthread_mutex_init ( &mtx, 0 );
+    pthread_cond_init ( &workCond, 0 );
+    pthread_cond_init ( &doneCond, 0 );
+
+    for ( int i = 0; i < nbThreads; i++ ) {
+        pthread_t thread;
+        if ( pthread_create ( &thread, NULL, SlabQueue::threadLoop, ( void* ) this ) != 0 ) {
+            LOGGER_ERROR ( "Impossible de lancer un thread de génération de dalles" );
+            continue;
+        }
+        threads.push_back ( thread );
+    }
+}
+
+SlabJob* SlabQueue::request ( std::string path, Layer* layer, std::string tileMatrix, int tileCol, int tileRow, Style* style, std::string format ) {
+    SlabJob* job = NULL;
+
+    pthread_mutex_lock ( &mtx );
+
+    std::map<std::string, SlabJob*>::iterator it = jobs.find ( path );
+    if ( it != jobs.end() ) {
+        job = it->second;
+    } else if ( ! stopping && ! threads.empty() && pending < maxPending ) {
+        job = new SlabJob ( path, layer, tileMatrix, tileCol, tileRow, style, format, counter++ );
+        jobs.insert ( std::pair<std::string, SlabJob*> ( path, job ) );
+        pending++;
+        pthread_cond_signal ( &workCond );
+    }
+
+    if ( job ) {
+        job->demand++;
+        job->holders++;
+    }
+
+    pthread_mutex_unlock ( &mtx );
+
+    return job;
+}
+
+SlabJob::State SlabQueue::wait ( SlabJob* job, int milliseconds ) {
+    timeval now;
+    gettimeofday ( &now, NULL );
+    long usec = now.tv_usec + ( long ) ( milliseconds % 1000 ) * 1000;
+    timespec deadline;
+    deadline.tv_sec = now.tv_sec + milliseconds / 1000 + usec / 1000000;
+    deadline.tv_nsec = ( usec % 1000000 ) * 1000;
+
+    pthread_mutex_lock ( &mtx );
+    while ( job->state == SlabJob::PENDING || job->state == SlabJob::RUNNING ) {
+        if ( pthread_cond_timedwait ( &doneCond, &mtx, &deadline ) == ETIMEDOUT ) break;
+    }
+    SlabJob::State state = job->state;
+    pthread_mutex_unlock ( &mtx );
+
+    return state;
+}
+
+void SlabQueue::release ( SlabJob* job ) {
+    pthread_mutex_lock ( &mtx );
+    job->holders--;
+    bool remove = ( job->holders == 0 && ! job->queued );
+    pthread_mutex_unlock ( &mtx );
+
+    if ( remove ) delete job;
+}
+
+int SlabQueue::getPendingNumber() {
+    pthread_mutex_lock ( &mtx );
+    int n = pending;
+    pthread_mutex_unlock ( &mtx );
+    return n;
+}
+
+SlabJob* SlabQueue::pick() {
+    SlabJob* best = NULL;
+    time_t now = time ( NULL );
+
+    std::map<std::string, SlabJob*>::iterator it = jobs.begin();
+    while ( it != jobs.end() ) {
+        SlabJob* job = it->second;
+        it++;
+        if ( job->state != SlabJob::PENDING ) continue;
+
+        if ( timeout > 0 && now - job->submission > timeout ) {
+            LOGGER_WARN ( "Dalle en attente depuis plus de " << timeout << "s, abandonnée : " << job->path );
+            finish ( job, SlabJob::FAILED );
+            continue;
+        }
+
+        if ( best == NULL || job->demand > best->demand || ( job->demand == best->demand && job->order < best->order ) ) {
+            best = job;
+        }
+    }
+
+    return best;
+}
+
+void SlabQueue::finish ( SlabJob* job, SlabJob::State state ) {
+    if ( job->state == SlabJob::PENDING ) pending--;
+    job->state = state;
+    job->queued = false;
+    jobs.erase ( job->path );
+    pthread_cond_broadcast ( &doneCond );
+    if ( job->holders == 0 ) delete job;
+}
+
+void* SlabQueue::threadLoop ( void* arg ) {
+    SlabQueue* queue = ( SlabQueue* ) arg;
+
+    pthread_mutex_lock ( &queue->mtx );
+    while ( true ) {
+        SlabJob* job = NULL;
+        while ( ! queue->stopping && ( job = queue->pick() ) == NULL ) {
+            pthread_cond_wait ( &queue->workCond, &queue->mtx );
+        }
+        if ( queue->stopping ) break;
+
+        job->state = SlabJob::RUNNING;
+        queue->pending--;
+        pthread_mutex_unlock ( &queue->mtx );
+
+        LOGGER_DEBUG ( "Génération de la dalle " << job->path << " (demandée " << job->demand << " fois)" );
+        bool ok = queue->builder ( job, queue->builderArg );
+
+        pthread_mutex_lock ( &queue->mtx );
+        // L'état n'est plus PENDING : finish ne décompte pas la dalle une seconde fois
+        queue->finish ( job, ok ? SlabJob::DONE : SlabJob::FAILED );
+    }
+    pthread_mutex_unlock ( &queue->mtx );
+
+    return NULL;
+}
+
+SlabQueue::~SlabQueue() {
+    pthread_mutex_lock ( &mtx );
+    stopping = true;
+    pthread_cond_broadcast ( &workCond );
+    pthread_mutex_unlock ( &mtx );
+
+    for ( unsigned int i = 0; i < threads.size(); i++ ) {
+        pthread_join ( threads.at ( i ), NULL );
+    }
+
+    // Les dalles encore en attente ne sont pas générées
+    pthread_mutex_lock ( &mtx );
+    while ( ! jobs.empty() ) {
+        finish ( jobs.begin()->second, SlabJob::FAILED );
+    }
+    pthread_mutex_unlock ( &mtx );
+
+    pthread_cond_destroy ( &doneCond );
+    pthread_cond_destroy ( &workCond );
+    pthread_mutex_destroy ( &mtx );
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file SlabQueue.h
+ ** \~french
+ * \brief Définition des classes SlabQueue et SlabJob
+ * \details
+ * \li SlabJob : demande de génération d'une dalle d'une pyramide à la volée
+ * \li SlabQueue : file bornée de génération de dalles, traitée par des threads du serveur
+ ** \~english
+ * \brief Define classes SlabQueue and SlabJob
+ * \details
+ * \li SlabJob : generation request of an on fly pyramid's slab
+ * \li SlabQueue : bounded slabs' generation queue, processed by server's threads
+ */
+
+#ifndef SLABQUEUE_H
+#define SLABQUEUE_H
+
+#include <pthread.h>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+class Layer;
+class Style;
+class SlabJob;
+
+/**
+ * \~french \brief Fonction de génération d'une dalle, retourne VRAI si la dalle a été écrite
+ * \~english \brief Slab generation function, return TRUE if the slab has been written
+ */
+typedef bool ( *SlabBuilder ) ( SlabJob* job, void* arg );
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Demande de génération d'une dalle
+ * \details Une demande est identifiée par le chemin de la dalle. Elle est partagée par toutes les requêtes portant sur cette dalle, qui en augmentent la demande.
+ * \~english
+ * \brief Slab generation request
+ * \details A request is identified by the slab's path. It is shared by all requests about this slab, which increase its demand.
+ */
+class SlabJob {
+
+    friend class SlabQueue;
+
+public:
+
+    /**
+     * \~french \brief États d'une demande
+     * \~english \brief Request's states
+     */
+    enum State {
+        PENDING,
+        RUNNING,
+        DONE,
+        FAILED
+    };
+
+private:
+
+    std::string path;
+    Layer* layer;
+    std::string tileMatrix;
+    int tileCol;
+    int tileRow;
+    Style* style;
+    std::string format;
+
+    /**
+     * \~french \brief Nombre de requêtes ayant demandé la dalle
+     * \~english \brief Number of requests which asked for the slab
+     */
+    int demand;
+
+    /**
+     * \~french \brief Numéro d'arrivée, pour départager les demandes égales
+     * \~english \brief Arrival number, to separate equal demands
+     */
+    unsigned long order;
+
+    /**
+     * \~french \brief Date de la première demande
+     * \~english \brief First request's date
+     */
+    time_t submission;
+
+    /**
+     * \~french \brief Nombre de requêtes détenant la demande (cf SlabQueue::release)
+     * \~english \brief Number of requests holding the request (see SlabQueue::release)
+     */
+    int holders;
+
+    /**
+     * \~french \brief Vrai tant que la demande est dans la file (en attente ou en cours)
+     * \~english \brief True while the request is in the queue (pending or running)
+     */
+    bool queued;
+
+    State state;
+
+    SlabJob ( std::string path, Layer* layer, std::string tileMatrix, int tileCol, int tileRow, Style* style, std::string format, unsigned long order ) :
+        path ( path ), layer ( layer ), tileMatrix ( tileMatrix ), tileCol ( tileCol ), tileRow ( tileRow ), style ( style ), format ( format ),
+        demand ( 0 ), order ( order ), submission ( time ( NULL ) ), holders ( 0 ), queued ( true ), state ( PENDING ) {}
+
+public:
+
+    std::string getPath() {
+        return path;
+    }
+    Layer* getLayer() {
+        return layer;
+    }
+    std::string getTileMatrix() {
+        return tileMatrix;
+    }
+    int getTileCol() {
+        return tileCol;
+    }
+    int getTileRow() {
+        return tileRow;
+    }
+    Style* getStyle() {
+        return style;
+    }
+    std::string getFormat() {
+        return format;
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief File bornée de génération de dalles
+ * \details Les dalles des pyramides à la volée sont générées dans le processus du serveur, par un nombre fixe de threads, et non plus par des processus fils.
+ *
+ * \li Plusieurs requêtes sur une même dalle partagent la même demande : la dalle n'est générée qu'une fois.
+ * \li Les threads traitent d'abord la dalle la plus demandée, puis la plus ancienne.
+ * \li Le nombre de dalles en attente est borné : au-delà, la demande est refusée et la requête calcule sa tuile à la demande.
+ * \li Une dalle en attente depuis plus que le délai d'abandon n'est pas générée.
+ *
+ * Une requête peut attendre, pendant une durée bornée, la fin de la génération de sa dalle pour y lire sa tuile.
+ * \~english
+ * \brief Bounded slabs' generation queue
+ * \details On fly pyramids' slabs are generated in the server process, by a fixed number of threads, and no longer by child processes.
+ *
+ * \li Several requests about the same slab share the same request : the slab is generated once.
+ * \li Threads process the most requested slab first, then the oldest.
+ * \li Pending slabs' number is bounded : beyond, the request is refused and the tile is computed on demand.
+ * \li A slab pending for more than the abandonment delay is not generated.
+ *
+ * A request can wait, for a bounded time, its slab's generation end to read its tile in it.
+ */
+class SlabQueue {
+
+private:
+
+    /**
+     * \~french \brief Demandes en attente ou en cours, par chemin de dalle
+     * \~english \brief Pending or running requests, by slab's path
+     */
+    std::map<std::string, SlabJob*> jobs;
+
+    std::vector<pthread_t> threads;
+
+    pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Signale une nouvelle demande aux threads
+     * \~english \brief Signal a new request to threads
+     */
+    pthread_cond_t workCond;
+
+    /**
+     * \~french \brief Signale la fin d'une génération aux requêtes en attente
+     * \~english \brief Signal a generation end to waiting requests
+     */
+    pthread_cond_t doneCond;
+
+    /**
+     * \~french \brief Nombre maximal de dalles en attente
+     * \~english \brief Max number of pending slabs
+     */
+    int maxPending;
+
+    int pending;
+
+    /**
+     * \~french \brief Délai, en secondes, au-delà duquel une dalle en attente est abandonnée (0 pour aucun)
+     * \~english \brief Delay, in seconds, beyond which a pending slab is abandoned (0 for none)
+     */
+    int timeout;
+
+    unsigned long counter;
+
+    bool stopping;
+
+    SlabBuilder builder;
+
+    void* builderArg;
+
+    static void* threadLoop ( void* arg );
+
+    /**
+     * \~french \brief Choisit la prochaine dalle à générer, abandonne les dalles trop anciennes
+     * \details Appelée sous l'exclusion mutuelle
+     * \return NULL si aucune dalle n'est en attente
+     * \~english \brief Choose the next slab to generate, abandon too old slabs
+     */
+    SlabJob* pick();
+
+    /**
+     * \~french \brief Sort une demande de la file, avec son état final
+     * \details Appelée sous l'exclusion mutuelle
+     * \~english \brief Remove a request from the queue, with its final state
+     */
+    void finish ( SlabJob* job, SlabJob::State state );
+
+public:
+
+    /**
+     * \~french
+     * \brief Crée la file et lance ses threads
+     * \param[in] nbThreads nombre de dalles générées simultanément
+     * \param[in] maxPending nombre maximal de dalles en attente
+     * \param[in] timeout délai d'abandon d'une dalle en attente, en secondes (0 pour aucun)
+     * \param[in] builder fonction de génération d'une dalle
+     * \param[in] arg argument passé à la fonction de génération
+     * \~english
+     * \brief Create the queue and start its threads
+     * \param[in] nbThreads number of simultaneously generated slabs
+     * \param[in] maxPending max number of pending slabs
+     * \param[in] timeout pending slab's abandonment delay, in seconds (0 for none)
+     * \param[in] builder slab generation function
+     * \param[in] arg argument given to the generation function
+     */
+    SlabQueue ( int nbThreads, int maxPending, int timeout, SlabBuilder builder, void* arg );
+
+    /**
+     * \~french
+     * \brief Demande la génération d'une dalle
+     * \details Si la dalle est déjà en attente ou en cours de génération, on retourne la même demande, dont la demande augmente. La demande retournée doit être libérée par #release.
+     * \return la demande, NULL si la file est pleine
+     * \~english
+     * \brief Ask for a slab generation
+     * \details If the slab is already pending or running, we return the same request, whose demand increases. Returned request have to be released with #release.
+     * \return the request, NULL if the queue is full
+     */
+    SlabJob* request ( std::string path, Layer* layer, std::string tileMatrix, int tileCol, int tileRow, Style* style, std::string format );
+
+    /**
+     * \~french
+     * \brief Attend la fin de la génération d'une dalle
+     * \param[in] job demande détenue
+     * \param[in] milliseconds durée maximale d'attente
+     * \return l'état de la demande : DONE ou FAILED si elle est terminée, PENDING ou RUNNING si le délai est dépassé
+     * \~english
+     * \brief Wait for a slab generation end
+     * \param[in] job held request
+     * \param[in] milliseconds max waiting time
+     * \return request's state : DONE or FAILED if it is finished, PENDING or RUNNING if the delay is exceeded
+     */
+    SlabJob::State wait ( SlabJob* job, int milliseconds );
+
+    /**
+     * \~french \brief Libère une demande obtenue par #request
+     * \~english \brief Release a request obtained with #request
+     */
+    void release ( SlabJob* job );
+
+    /**
+     * \~french \brief Nombre de dalles en attente
+     * \~english \brief Pending slabs' number
+     */
+    int getPendingNumber();
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \details Les générations en cours sont terminées, les dalles en attente sont abandonnées
+     * \~english
+     * \brief Destructor
+     * \details Running generations are finished, pending slabs are abandoned
+     */
+    ~SlabQueue();
+};
+
+#endif
@@ -39,12 +39,15 @@
 #define WEBSERVICE_H
 #include <string>
 #include <map>
+#include <pthread.h>
 #include "BoundingBox.h"
 #include "curl/curl.h"
 #include "Image.h"
 #include "Data.h"
 #include "Source.h"
 
+struct CurlRequest;
+
 struct MemoryStruct {
   uint8_t *memory;
   size_t size;
@@ -136,6 +139,84 @@ protected:
      */
     std::string responseType;
 
+    /**
+     * \~french \brief Nombre maximal de requêtes simultanées vers le serveur
+     * \~english \brief Maximal number of simultaneous requests to the server
+     */
+    int maxConnections;
+
+    /**
+     * \~french \brief Nombre de requêtes en cours, par serveur (hôte et port)
+     * \details Partagé par toutes les instances : les niveaux clonés (Level) moissonnant le même serveur se partagent ses connexions
+     * \~english \brief Number of running requests, per server (host and port)
+     * \details Shared by all instances : cloned levels (Level) harvesting the same server share its connections
+     */
+    static std::map<std::string, int> activeConnections;
+
+    /**
+     * \~french \brief Protège les compteurs de requêtes en cours
+     * \~english \brief Protect the running requests counters
+     */
+    static pthread_mutex_t connectionsMutex;
+
+    /**
+     * \~french \brief Serveur (hôte et port) de l'URL, clé de #activeConnections
+     * \~english \brief URL's server (host and port), #activeConnections key
+     */
+    std::string getServer();
+
+    /**
+     * \~french
+     * \brief Réserve une connexion vers le serveur, sans attendre
+     * \return faux si #maxConnections requêtes sont déjà en cours vers ce serveur, toutes instances confondues
+     * \~english
+     * \brief Reserve a connection to the server, without waiting
+     * \return false if #maxConnections requests are already running to this server, all instances included
+     */
+    bool acquireConnection();
+
+    /**
+     * \~french \brief Libère une connexion réservée par #acquireConnection
+     * \~english \brief Release a connection reserved with #acquireConnection
+     */
+    void releaseConnection();
+
+    /**
+     * \~french
+     * \brief Prépare une requête asynchrone, à démarrer avec CurlPool::addRequest
+     * \~english
+     * \brief Prepare an asynchronous request, to start with CurlPool::addRequest
+     */
+    CurlRequest * prepareRequest(std::string request);
+
+    /**
+     * \~french
+     * \brief Contrôle le code retour et le type de la réponse
+     * \param[in] curl Objet curl ayant exécuté la requête
+     * \param[in] content Contenu de la réponse, affiché en cas d'erreur s'il est textuel
+     * \param[out] type Type de la réponse
+     * \~english
+     * \brief Check response code and type
+     * \param[in] curl Curl object which performed the request
+     * \param[in] content Answer content, logged on error if textual
+     * \param[out] type Answer type
+     */
+    bool checkResponse(CURL* curl, const char* content, std::string& type);
+
+    /**
+     * \~french
+     * \brief Délai avant un nouvel essai, en millisecondes
+     * \details Le délai double à chaque essai à partir de #interval, et est tiré aléatoirement dans sa moitié haute pour que les requêtes en échec ne reviennent pas toutes en même temps
+     * \param[in] attempt Nombre d'essais déjà effectués
+     * \param[in,out] seed Graine du tirage aléatoire
+     * \~english
+     * \brief Delay before a new try, in milliseconds
+     * \details Delay doubles with each try from #interval, and is randomly drawn in its upper half so that failed requests do not come back all together
+     * \param[in] attempt Number of tries already done
+     * \param[in,out] seed Random draw seed
+     */
+    int getRetryDelay(int attempt, unsigned int* seed);
+
 public:
 
     /**
@@ -298,6 +379,26 @@ public:
         interval = u;
     }
 
+    /**
+     * \~french \brief Récupère le nombre maximal de requêtes simultanées
+     * \return maxConnections
+     * \~english \brief Get the maximal number of simultaneous requests
+     * \return maxConnections
+     */
+    int getMaxConnections(){
+        return maxConnections;
+    }
+
+    /**
+     * \~french \brief Modifie le nombre maximal de requêtes simultanées
+     * \param[in] maxConnections
+     * \~english \brief Set the maximal number of simultaneous requests
+     * \param[in] maxConnections
+     */
+    void setMaxConnections (int u) {
+        maxConnections = u;
+    }
+
     /**
      * \~french \brief Récupère le responseType
      * \return interval
@@ -321,10 +422,24 @@ public:
     /**
      * \~french
      * \brief Récupération des données à partir d'une URL
+     * \details Si \b cached est vrai, la réponse est cherchée dans le cache des services distants (WebServiceCache) avant d'être demandée au serveur. Seules les images moissonnées pour les niveaux à la demande ou à la volée sont concernées : les autres réponses (GetFeatureInfo, flux relayés) ne sont pas mises en cache.
+     * \param[in] request URL de la requête
+     * \param[in] cached Passer par le cache des services distants
      * \~english
      * \brief Taking Data from an URL
+     * \details If \b cached is true, answer is looked for in the remote services cache (WebServiceCache) before being asked to the server. Only images harvested for on demand or on fly levels are concerned : other answers (GetFeatureInfo, relayed streams) are not cached.
+     * \param[in] request Request URL
+     * \param[in] cached Use the remote services cache
      */
-    RawDataSource * performRequest(std::string request);
+    RawDataSource * performRequest(std::string request, bool cached = false);
+
+    /**
+     * \~french
+     * \brief Récupération des données à partir d'une URL, auprès du serveur
+     * \~english
+     * \brief Taking Data from an URL, from the server
+     */
+    RawDataSource * fetchRequest(std::string request);
     
     /**
      * \~french
@@ -639,6 +754,18 @@ public:
      */
     Image * createSlabFromRequest(int width, int height, BoundingBox<double> askBbox);
 
+    /**
+     * \~french
+     * \brief Décode la réponse à une requête GetMap
+     * \details Le JPEG est décodé immédiatement, pour que le décodage se fasse pendant le téléchargement des autres requêtes
+     * \return NULL si la donnée n'est pas décodable
+     * \~english
+     * \brief Decode the answer of a GetMap request
+     * \details JPEG is decoded immediatly, so that decoding happens while other requests are downloaded
+     * \return NULL if data cannot be decoded
+     */
+    Image * decodeImage(RawDataSource* rawData, BoundingBox<double> requestBbox, int width, int height);
+
     /**
      * \~french \brief Constructeur
      * \~english \brief Constructor
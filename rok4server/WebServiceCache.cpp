@@ -0,0 +1,493 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file WebServiceCache.cpp
+ ** \~french
+ * \brief Implémentation de la classe WebServiceCache
+ ** \~english
+ * \brief Implements class WebServiceCache
+ */
+
+#include "WebServiceCache.h"
+#include <stdio.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <vector>
+
+std::list<WebServiceCacheElement*> WebServiceCache::mru;
+std::map<std::string, std::list<WebServiceCacheElement*>::iterator> WebServiceCache::book;
+std::map<std::string, WebServiceCacheFlight*> WebServiceCache::flights;
+std::list<std::string> WebServiceCache::files;
+std::map<std::string, std::pair<size_t, std::list<std::string>::iterator> > WebServiceCache::fileBook;
+pthread_mutex_t WebServiceCache::mtx = PTHREAD_MUTEX_INITIALIZER;
+size_t WebServiceCache::maxMemory = 0;
+size_t WebServiceCache::usedMemory = 0;
+std::string WebServiceCache::directory = "";
+size_t WebServiceCache::maxDiskSize = 0;
+size_t WebServiceCache::usedDiskSize = 0;
+int WebServiceCache::validity = 0;
+uint64_t WebServiceCache::hits = 0;
+uint64_t WebServiceCache::diskHits = 0;
+uint64_t WebServiceCache::misses = 0;
+uint64_t WebServiceCache::shared = 0;
+
+std::string WebServiceCache::normalize ( std::string request ) {
+
+    size_t question = request.find ( '?' );
+    if ( question == std::string::npos ) return request;
+
+    std::vector<std::string> params;
+    size_t start = question + 1;
+    while ( start <= request.size() ) {
+        size_t end = request.find ( '&', start );
+        if ( end == std::string::npos ) end = request.size();
+        std::string param = request.substr ( start, end - start );
+        start = end + 1;
+        if ( param == "" ) continue;
+
+        // Les noms des paramètres WMS ne sont pas sensibles à la casse, les valeurs si
+        size_t equal = param.find ( '=' );
+        if ( equal == std::string::npos ) equal = param.size();
+        for ( size_t i = 0; i < equal; i++ ) {
+            param[i] = toupper ( param[i] );
+        }
+        params.push_back ( param );
+    }
+
+    std::sort ( params.begin(), params.end() );
+
+    std::string key = request.substr ( 0, question + 1 );
+    for ( int i = 0; i < params.size(); i++ ) {
+        if ( i > 0 ) key += "&";
+        key += params.at ( i );
+    }
+    return key;
+}
+
+std::string WebServiceCache::getFileName ( std::string key ) {
+    // FNV-1a 64 bits, les collisions sont détectées à la lecture grâce à la clé écrite dans le fichier
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for ( int i = 0; i < key.size(); i++ ) {
+        h ^= ( uint8_t ) key[i];
+        h *= 0x100000001b3ULL;
+    }
+    char name[17];
+    snprintf ( name, sizeof ( name ), "%016llx", ( unsigned long long ) h );
+    return std::string ( name );
+}
+
+void WebServiceCache::removeElement ( std::list<WebServiceCacheElement*>::iterator it ) {
+    WebServiceCacheElement* wce = *it;
+    book.erase ( wce->key );
+    mru.erase ( it );
+    usedMemory -= wce->getMemorySize();
+    delete wce;
+}
+
+void WebServiceCache::insertElement ( WebServiceCacheElement* wce ) {
+
+    if ( wce->getMemorySize() > maxMemory ) {
+        delete wce;
+        return;
+    }
+
+    std::map<std::string, std::list<WebServiceCacheElement*>::iterator>::iterator it = book.find ( wce->key );
+    if ( it != book.end() ) {
+        removeElement ( it->second );
+    }
+
+    mru.push_front ( wce );
+    book.insert ( std::pair<std::string, std::list<WebServiceCacheElement*>::iterator> ( wce->key, mru.begin() ) );
+    usedMemory += wce->getMemorySize();
+
+    while ( usedMemory > maxMemory ) {
+        removeElement ( --mru.end() );
+    }
+}
+
+void WebServiceCache::insertFile ( std::string name, size_t size ) {
+
+    std::map<std::string, std::pair<size_t, std::list<std::string>::iterator> >::iterator it = fileBook.find ( name );
+    if ( it != fileBook.end() ) {
+        usedDiskSize -= it->second.first;
+        files.erase ( it->second.second );
+        fileBook.erase ( it );
+    }
+
+    files.push_back ( name );
+    fileBook.insert ( std::pair<std::string, std::pair<size_t, std::list<std::string>::iterator> > (
+        name, std::pair<size_t, std::list<std::string>::iterator> ( size, --files.end() ) ) );
+    usedDiskSize += size;
+
+    // Les fichiers les plus anciens sont supprimés en premier
+    while ( usedDiskSize > maxDiskSize && ! files.empty() ) {
+        std::string oldest = files.front();
+        it = fileBook.find ( oldest );
+        usedDiskSize -= it->second.first;
+        fileBook.erase ( it );
+        files.pop_front();
+        unlink ( ( directory + "/" + oldest ).c_str() );
+    }
+}
+
+WebServiceCacheElement* WebServiceCache::readFile ( std::string key ) {
+
+    pthread_mutex_lock ( &mtx );
+    std::string path = directory + "/" + getFileName ( key );
+    pthread_mutex_unlock ( &mtx );
+
+    FILE* file = fopen ( path.c_str(), "rb" );
+    if ( file == NULL ) return NULL;
+
+    struct stat bufferStat;
+    if ( fstat ( fileno ( file ), &bufferStat ) != 0 || isOutdated ( bufferStat.st_mtime, time ( NULL ) ) ) {
+        fclose ( file );
+        return NULL;
+    }
+
+    size_t fileSize = bufferStat.st_size;
+    char* buffer = new char[fileSize];
+    if ( fread ( buffer, 1, fileSize, file ) != fileSize ) {
+        LOGGER_ERROR ( "Impossible de lire le fichier du cache des services distants " << path );
+        delete[] buffer;
+        fclose ( file );
+        return NULL;
+    }
+    fclose ( file );
+
+    // En-tête : la clé, puis le type de la réponse, chacun sur une ligne
+    char* endKey = ( char* ) memchr ( buffer, '\n', fileSize );
+    char* endType = endKey ? ( char* ) memchr ( endKey + 1, '\n', fileSize - ( endKey + 1 - buffer ) ) : NULL;
+    if ( endType == NULL || std::string ( buffer, endKey - buffer ) != key ) {
+        delete[] buffer;
+        return NULL;
+    }
+
+    std::string type ( endKey + 1, endType - endKey - 1 );
+    size_t offset = endType + 1 - buffer;
+    WebServiceCacheElement* wce = new WebServiceCacheElement ( key, ( uint8_t* ) buffer + offset, fileSize - offset, type, bufferStat.st_mtime );
+    delete[] buffer;
+
+    return wce;
+}
+
+void WebServiceCache::writeFile ( WebServiceCacheElement* wce ) {
+
+    pthread_mutex_lock ( &mtx );
+    std::string dir = directory;
+    pthread_mutex_unlock ( &mtx );
+    if ( dir == "" ) return;
+
+    std::string name = getFileName ( wce->key );
+    std::string path = dir + "/" + name;
+
+    // Écriture dans un fichier temporaire puis renommage, pour que les lecteurs ne voient jamais un fichier partiel
+    // Le nom est propre au processus et au thread, le répertoire pouvant être partagé par plusieurs serveurs
+    char suffix[64];
+    snprintf ( suffix, sizeof ( suffix ), ".%ld.%lx.tmp", ( long ) getpid(), ( unsigned long ) pthread_self() );
+    std::string tmpPath = path + suffix;
+
+    FILE* file = fopen ( tmpPath.c_str(), "wb" );
+    if ( file == NULL ) {
+        LOGGER_ERROR ( "Impossible de creer le fichier du cache des services distants " << tmpPath << " : " << strerror ( errno ) );
+        return;
+    }
+
+    std::string header = wce->key + "\n" + wce->type + "\n";
+    bool ok = ( fwrite ( header.c_str(), 1, header.size(), file ) == header.size() );
+    ok = ok && ( fwrite ( wce->data, 1, wce->size, file ) == wce->size );
+    ok = ( fclose ( file ) == 0 ) && ok;
+
+    if ( ! ok || rename ( tmpPath.c_str(), path.c_str() ) != 0 ) {
+        LOGGER_ERROR ( "Impossible d'ecrire le fichier du cache des services distants " << path );
+        unlink ( tmpPath.c_str() );
+        return;
+    }
+
+    pthread_mutex_lock ( &mtx );
+    if ( directory == dir ) {
+        insertFile ( name, header.size() + wce->size );
+    }
+    pthread_mutex_unlock ( &mtx );
+}
+
+void WebServiceCache::land ( std::string key, bool success ) {
+
+    std::map<std::string, WebServiceCacheFlight*>::iterator it = flights.find ( key );
+    if ( it == flights.end() ) return;
+
+    WebServiceCacheFlight* flight = it->second;
+    flights.erase ( it );
+
+    flight->finished = true;
+    flight->success = success;
+    if ( flight->waiters == 0 ) {
+        delete flight;
+    } else {
+        // Le dernier thread réveillé supprimera l'objet
+        pthread_cond_broadcast ( &flight->cond );
+    }
+}
+
+bool WebServiceCache::isEnabled () {
+    pthread_mutex_lock ( &mtx );
+    bool enabled = ( maxMemory > 0 || directory != "" );
+    pthread_mutex_unlock ( &mtx );
+    return enabled;
+}
+
+WebServiceCache::eLookup WebServiceCache::lookup ( std::string key, RawDataSource** data, int wait ) {
+
+    *data = NULL;
+    bool waited = false;
+
+    pthread_mutex_lock ( &mtx );
+
+    while ( true ) {
+
+        std::map<std::string, std::list<WebServiceCacheElement*>::iterator>::iterator it = book.find ( key );
+        if ( it != book.end() ) {
+            WebServiceCacheElement* wce = * ( it->second );
+            if ( ! isOutdated ( wce->date, time ( NULL ) ) ) {
+                mru.splice ( mru.begin(), mru, it->second );
+                *data = new RawDataSource ( wce->data, wce->size, wce->type, "" );
+                if ( ! waited ) hits++;
+                pthread_mutex_unlock ( &mtx );
+                return HIT;
+            }
+            removeElement ( it->second );
+        }
+
+        std::map<std::string, WebServiceCacheFlight*>::iterator itf = flights.find ( key );
+        if ( itf == flights.end() ) break;
+
+        if ( wait <= 0 ) {
+            pthread_mutex_unlock ( &mtx );
+            return BUSY;
+        }
+
+        // Un autre thread a envoyé la même requête : on attend sa réponse, pas plus longtemps que la requête elle-même
+        WebServiceCacheFlight* flight = itf->second;
+        if ( ! waited ) shared++;
+        waited = true;
+        struct timespec deadline;
+        clock_gettime ( CLOCK_REALTIME, &deadline );
+        deadline.tv_sec += wait;
+        flight->waiters++;
+        int rc = 0;
+        while ( ! flight->finished && rc != ETIMEDOUT ) {
+            rc = pthread_cond_timedwait ( &flight->cond, &mtx, &deadline );
+        }
+        flight->waiters--;
+        bool finished = flight->finished;
+        bool success = flight->success;
+        // Une requête toujours en cours garde son objet, supprimé par land
+        if ( finished && flight->waiters == 0 ) delete flight;
+
+        if ( ! finished ) {
+            pthread_mutex_unlock ( &mtx );
+            return TIMEOUT;
+        }
+
+        if ( ! success ) {
+            pthread_mutex_unlock ( &mtx );
+            return FAILED;
+        }
+        // La réponse a été mémorisée : on la cherche de nouveau, en mémoire puis sur disque
+    }
+
+    // Personne n'a envoyé cette requête : l'appelant s'en charge, sauf si la réponse est sur disque
+    flights.insert ( std::pair<std::string, WebServiceCacheFlight*> ( key, new WebServiceCacheFlight() ) );
+    bool onDisk = ( directory != "" );
+    pthread_mutex_unlock ( &mtx );
+
+    if ( onDisk ) {
+        WebServiceCacheElement* wce = readFile ( key );
+        if ( wce ) {
+            *data = new RawDataSource ( wce->data, wce->size, wce->type, "" );
+            pthread_mutex_lock ( &mtx );
+            diskHits++;
+            insertElement ( wce );
+            land ( key, true );
+            pthread_mutex_unlock ( &mtx );
+            return HIT;
+        }
+    }
+
+    pthread_mutex_lock ( &mtx );
+    misses++;
+    pthread_mutex_unlock ( &mtx );
+    return MISS;
+}
+
+void WebServiceCache::store ( std::string key, const uint8_t* data, size_t size, std::string type ) {
+
+    WebServiceCacheElement* wce = new WebServiceCacheElement ( key, data, size, type, time ( NULL ) );
+
+    // Le fichier est écrit avant le réveil des threads en attente, qui peuvent le relire si la réponse n'est pas gardée en mémoire
+    writeFile ( wce );
+
+    pthread_mutex_lock ( &mtx );
+    insertElement ( wce );
+    land ( key, true );
+    pthread_mutex_unlock ( &mtx );
+}
+
+void WebServiceCache::abandon ( std::string key ) {
+    pthread_mutex_lock ( &mtx );
+    land ( key, false );
+    pthread_mutex_unlock ( &mtx );
+}
+
+void WebServiceCache::setCacheSize ( size_t size ) {
+    pthread_mutex_lock ( &mtx );
+    maxMemory = size;
+    while ( usedMemory > maxMemory ) {
+        removeElement ( --mru.end() );
+    }
+    pthread_mutex_unlock ( &mtx );
+}
+
+bool WebServiceCache::setDirectory ( std::string dir, size_t size ) {
+
+    pthread_mutex_lock ( &mtx );
+    files.clear();
+    fileBook.clear();
+    usedDiskSize = 0;
+    maxDiskSize = size;
+    directory = "";
+    pthread_mutex_unlock ( &mtx );
+
+    if ( dir == "" || size == 0 ) return true;
+
+    if ( mkdir ( dir.c_str(), 0755 ) != 0 && errno != EEXIST ) {
+        LOGGER_ERROR ( "Impossible de creer le repertoire du cache des services distants " << dir << " : " << strerror ( errno ) );
+        return false;
+    }
+
+    DIR* dp = opendir ( dir.c_str() );
+    if ( dp == NULL ) {
+        LOGGER_ERROR ( "Impossible d'ouvrir le repertoire du cache des services distants " << dir << " : " << strerror ( errno ) );
+        return false;
+    }
+
+    // Reprise des fichiers existants, du plus ancien au plus récent
+    std::vector<std::pair<time_t, std::pair<std::string, size_t> > > existing;
+    struct dirent* entry;
+    time_t now = time ( NULL );
+    while ( ( entry = readdir ( dp ) ) != NULL ) {
+        std::string name ( entry->d_name );
+        if ( name[0] == '.' ) continue;
+        std::string path = dir + "/" + name;
+        struct stat bufferStat;
+        if ( stat ( path.c_str(), &bufferStat ) != 0 || ! S_ISREG ( bufferStat.st_mode ) ) continue;
+        if ( name.size() > 4 && name.substr ( name.size() - 4 ) == ".tmp" ) {
+            // Fichier temporaire : écriture interrompue s'il est ancien, sinon peut-être en cours dans un autre processus
+            if ( now - bufferStat.st_mtime > WEBSERVICE_CACHE_TMP_GRACE ) {
+                unlink ( path.c_str() );
+            }
+            continue;
+        }
+        existing.push_back ( std::pair<time_t, std::pair<std::string, size_t> > (
+            bufferStat.st_mtime, std::pair<std::string, size_t> ( name, bufferStat.st_size ) ) );
+    }
+    closedir ( dp );
+    std::sort ( existing.begin(), existing.end() );
+
+    pthread_mutex_lock ( &mtx );
+    directory = dir;
+    for ( int i = 0; i < existing.size(); i++ ) {
+        insertFile ( existing.at ( i ).second.first, existing.at ( i ).second.second );
+    }
+    LOGGER_INFO ( "Cache des services distants sur disque : " << files.size() << " reponses reprises dans " << dir );
+    pthread_mutex_unlock ( &mtx );
+
+    return true;
+}
+
+uint64_t WebServiceCache::getHits () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t h = hits;
+    pthread_mutex_unlock ( &mtx );
+    return h;
+}
+
+uint64_t WebServiceCache::getDiskHits () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t h = diskHits;
+    pthread_mutex_unlock ( &mtx );
+    return h;
+}
+
+uint64_t WebServiceCache::getMisses () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t m = misses;
+    pthread_mutex_unlock ( &mtx );
+    return m;
+}
+
+uint64_t WebServiceCache::getShared () {
+    pthread_mutex_lock ( &mtx );
+    uint64_t s = shared;
+    pthread_mutex_unlock ( &mtx );
+    return s;
+}
+
+void WebServiceCache::printStats () {
+    pthread_mutex_lock ( &mtx );
+    LOGGER_INFO ( "Cache des services distants : " << mru.size() << " reponses, " << usedMemory << " / " << maxMemory << " octets en memoire, "
+                  << files.size() << " reponses, " << usedDiskSize << " / " << maxDiskSize << " octets sur disque" );
+    LOGGER_INFO ( "\t- succès mémoire = " << hits << ", succès disque = " << diskHits << ", échecs = " << misses << ", partagées = " << shared );
+    pthread_mutex_unlock ( &mtx );
+}
+
+void WebServiceCache::cleanCache () {
+    pthread_mutex_lock ( &mtx );
+    while ( ! mru.empty() ) {
+        removeElement ( --mru.end() );
+    }
+    hits = 0;
+    diskHits = 0;
+    misses = 0;
+    shared = 0;
+    pthread_mutex_unlock ( &mtx );
+}
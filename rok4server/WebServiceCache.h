@@ -0,0 +1,484 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file WebServiceCache.h
+ ** \~french
+ * \brief Définition de la classe WebServiceCache
+ ** \~english
+ * \brief Define class WebServiceCache
+ */
+
+#ifndef WEBSERVICECACHE_H
+#define WEBSERVICECACHE_H
+
+#include <stdint.h>// pour uint8_t
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <list>
+#include <map>
+#include <string>
+#include "Logger.h"
+#include "Data.h"
+
+/**
+ * \~french \brief Âge à partir duquel un fichier temporaire du cache sur disque est considéré abandonné, en secondes
+ * \details Un fichier plus récent peut être en cours d'écriture par un autre processus partageant le répertoire
+ * \~english \brief Age from which a temporary file of the on disk cache is considered abandoned, in seconds
+ * \details A more recent file may be being written by another process sharing the directory
+ */
+#define WEBSERVICE_CACHE_TMP_GRACE 3600
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Réponse d'un service distant mémorisée dans le cache
+ * \~english
+ * \brief Remote service's answer stored in the cache
+ */
+class WebServiceCacheElement {
+
+public:
+
+    /**
+     * \~french \brief Clé de l'élément : requête normalisée
+     * \~english \brief Element's key : normalized request
+     */
+    std::string key;
+
+    /**
+     * \~french \brief Type de la réponse
+     * \~english \brief Answer type
+     */
+    std::string type;
+
+    /**
+     * \~french \brief Contenu de la réponse
+     * \~english \brief Answer content
+     */
+    uint8_t* data;
+
+    /**
+     * \~french \brief Taille du contenu
+     * \~english \brief Content size
+     */
+    size_t size;
+
+    /**
+     * \~french \brief Date de récupération de la réponse
+     * \~english \brief Date of answer retrieval
+     */
+    time_t date;
+
+    /**
+     * \~french \brief Constructeur
+     * \details Le contenu est copié
+     * \~english \brief Constructor
+     * \details Content is copied
+     */
+    WebServiceCacheElement ( std::string k, const uint8_t* d, size_t s, std::string t, time_t dt ) : key ( k ), type ( t ), size ( s ), date ( dt ) {
+        data = new uint8_t[size];
+        memcpy ( data, d, size );
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~WebServiceCacheElement() {
+        delete[] data;
+    }
+
+    /**
+     * \~french \brief Estimation de l'occupation mémoire de l'élément, en octets
+     * \~english \brief Estimated memory used by the element, in bytes
+     */
+    size_t getMemorySize() {
+        return sizeof ( WebServiceCacheElement ) + key.size() + type.size() + size;
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Requête en cours vers un service distant, attendue par d'autres threads
+ * \~english
+ * \brief Running request to a remote service, waited by other threads
+ */
+class WebServiceCacheFlight {
+
+public:
+
+    /**
+     * \~french \brief Signale la fin de la requête
+     * \~english \brief Signal the request's end
+     */
+    pthread_cond_t cond;
+
+    /**
+     * \~french \brief La requête est terminée
+     * \~english \brief Request is over
+     */
+    bool finished;
+
+    /**
+     * \~french \brief La requête a abouti et sa réponse est dans le cache
+     * \~english \brief Request succeeded and its answer is in the cache
+     */
+    bool success;
+
+    /**
+     * \~french \brief Nombre de threads attendant la fin de la requête
+     * \~english \brief Number of threads waiting for the request's end
+     */
+    int waiters;
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    WebServiceCacheFlight() : finished ( false ), success ( false ), waiters ( 0 ) {
+        pthread_cond_init ( &cond, NULL );
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~WebServiceCacheFlight() {
+        pthread_cond_destroy ( &cond );
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Cache des réponses des services distants moissonnés, partagé par tous les threads
+ * \details Cette classe est prévue pour être utilisée sans instance, à la manière de TileCache.
+ *
+ * Les niveaux à la demande ou à la volée moissonnant un WMS (WebService) redemandent souvent exactement la même image, pour des tuiles voisines ou des requêtes répétées. Les réponses sont gardées en mémoire dans une liste LRU bornée, et éventuellement sur disque dans un répertoire au volume borné, les fichiers les plus anciens étant supprimés en premier. Elles sont identifiées par la requête normalisée (#normalize) et ont une durée de validité.
+ *
+ * Quand plusieurs threads demandent en même temps une même réponse absente du cache, un seul l'envoie au service distant, les autres attendent sa réponse.
+ * \~english
+ * \brief Harvested remote services' answers cache, shared by all threads
+ * \details This class is intended to be used without instance, like TileCache.
+ *
+ * On demand or on the fly levels harvesting a WMS (WebService) often ask again exactly the same image, for neighbouring tiles or repeated requests. Answers are kept in memory in a bounded LRU list, and optionally on disk in a directory with a bounded volume, oldest files being removed first. They are identified by the normalized request (#normalize) and have a validity period.
+ *
+ * When several threads ask at the same time for the same answer missing from the cache, only one sends it to the remote service, others wait for its answer.
+ */
+class WebServiceCache {
+
+public:
+
+    /**
+     * \~french \brief Résultat d'une recherche dans le cache
+     * \~english \brief Cache lookup result
+     */
+    enum eLookup {
+        /** \~french La réponse est fournie \~english Answer is provided */
+        HIT,
+        /** \~french L'appelant doit envoyer la requête, puis appeler #store ou #abandon \~english Caller have to send the request, then call #store or #abandon */
+        MISS,
+        /** \~french Un autre thread envoie la requête (recherche sans attente) \~english Another thread sends the request (lookup without waiting) */
+        BUSY,
+        /** \~french La requête envoyée par un autre thread a échoué \~english Request sent by another thread failed */
+        FAILED,
+        /** \~french La requête envoyée par un autre thread n'a pas abouti dans le délai d'attente \~english Request sent by another thread did not end within the waiting delay */
+        TIMEOUT
+    };
+
+private:
+
+    /**
+     * \~french \brief Liste des éléments en mémoire, du plus récemment utilisé au plus ancien
+     * \~english \brief In memory elements list, from the most recently used to the oldest
+     */
+    static std::list<WebServiceCacheElement*> mru;
+
+    /**
+     * \~french \brief Annuaire des éléments en mémoire, pour un accès par clé
+     * \~english \brief In memory elements book, for an access by key
+     */
+    static std::map<std::string, std::list<WebServiceCacheElement*>::iterator> book;
+
+    /**
+     * \~french \brief Requêtes en cours, par clé
+     * \~english \brief Running requests, by key
+     */
+    static std::map<std::string, WebServiceCacheFlight*> flights;
+
+    /**
+     * \~french \brief Fichiers du cache sur disque, du plus ancien au plus récent
+     * \~english \brief On disk cache's files, from the oldest to the most recent
+     */
+    static std::list<std::string> files;
+
+    /**
+     * \~french \brief Annuaire des fichiers du cache sur disque, avec leur taille
+     * \~english \brief On disk cache's files book, with their size
+     */
+    static std::map<std::string, std::pair<size_t, std::list<std::string>::iterator> > fileBook;
+
+    /**
+     * \~french \brief Exclusion mutuelle pour l'accès au cache
+     * \~english \brief Mutex for the cache access
+     */
+    static pthread_mutex_t mtx;
+
+    /**
+     * \~french \brief Occupation mémoire maximale et courante, en octets
+     * \~english \brief Max and current memory used, in bytes
+     */
+    static size_t maxMemory;
+    static size_t usedMemory;
+
+    /**
+     * \~french \brief Répertoire du cache sur disque (vide si pas de cache sur disque)
+     * \~english \brief On disk cache's directory (empty if no on disk cache)
+     */
+    static std::string directory;
+
+    /**
+     * \~french \brief Volume maximal et courant du cache sur disque, en octets
+     * \~english \brief Max and current volume of the on disk cache, in bytes
+     */
+    static size_t maxDiskSize;
+    static size_t usedDiskSize;
+
+    /**
+     * \~french \brief Durée de validité d'une réponse, en secondes (0 pour une validité illimitée)
+     * \~english \brief Answer's validity period, in seconds (0 for unlimited validity)
+     */
+    static int validity;
+
+    /**
+     * \~french \brief Statistiques : réponses trouvées en mémoire, sur disque, absentes, partagées avec une requête en cours
+     * \~english \brief Statistics : answers found in memory, on disk, missing, shared with a running request
+     */
+    static uint64_t hits;
+    static uint64_t diskHits;
+    static uint64_t misses;
+    static uint64_t shared;
+
+    /**
+     * \~french \brief Nom du fichier d'une clé dans le répertoire du cache
+     * \~english \brief File name of a key in the cache directory
+     */
+    static std::string getFileName ( std::string key );
+
+    /**
+     * \~french \brief Indique si une réponse récupérée à cette date est périmée
+     * \~english \brief Tell if an answer retrieved at this date is out of date
+     */
+    static bool isOutdated ( time_t date, time_t now ) {
+        return validity > 0 && now - date > validity;
+    }
+
+    /**
+     * \~french \brief Supprime un élément en mémoire
+     * \details L'appelant doit avoir verrouillé #mtx
+     * \~english \brief Remove an in memory element
+     * \details Caller have to lock #mtx
+     */
+    static void removeElement ( std::list<WebServiceCacheElement*>::iterator it );
+
+    /**
+     * \~french \brief Ajoute un élément en mémoire, en supprimant les plus anciens si nécessaire
+     * \details L'appelant doit avoir verrouillé #mtx. L'élément est supprimé s'il n'est pas ajouté
+     * \~english \brief Add an in memory element, removing oldest ones if necessary
+     * \details Caller have to lock #mtx. Element is deleted if not added
+     */
+    static void insertElement ( WebServiceCacheElement* wce );
+
+    /**
+     * \~french \brief Enregistre un fichier dans l'annuaire, en supprimant les plus anciens si nécessaire
+     * \details L'appelant doit avoir verrouillé #mtx
+     * \~english \brief Record a file in the book, removing oldest ones if necessary
+     * \details Caller have to lock #mtx
+     */
+    static void insertFile ( std::string name, size_t size );
+
+    /**
+     * \~french \brief Lit une réponse dans le cache sur disque
+     * \return NULL si la réponse est absente ou périmée
+     * \~english \brief Read an answer in the on disk cache
+     * \return NULL if answer is missing or out of date
+     */
+    static WebServiceCacheElement* readFile ( std::string key );
+
+    /**
+     * \~french \brief Écrit une réponse dans le cache sur disque
+     * \~english \brief Write an answer in the on disk cache
+     */
+    static void writeFile ( WebServiceCacheElement* wce );
+
+    /**
+     * \~french \brief Termine une requête en cours et réveille les threads l'attendant
+     * \details L'appelant doit avoir verrouillé #mtx
+     * \~english \brief End a running request and wake threads waiting for it
+     * \details Caller have to lock #mtx
+     */
+    static void land ( std::string key, bool success );
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    WebServiceCache() {};
+
+public:
+
+    /**
+     * \~french \brief Normalise une requête, pour que deux requêtes équivalentes aient la même clé
+     * \details Les paramètres sont triés, leurs noms mis en majuscules et les séparateurs superflus supprimés
+     * \~english \brief Normalize a request, so that two equivalent requests have the same key
+     * \details Parameters are sorted, their names upper cased and useless separators removed
+     */
+    static std::string normalize ( std::string request );
+
+    /**
+     * \~french \brief Indique si le cache est actif, en mémoire ou sur disque
+     * \~english \brief Tell if the cache is enabled, in memory or on disk
+     */
+    static bool isEnabled ();
+
+    /**
+     * \~french \brief Recherche une réponse dans le cache
+     * \details Si la réponse est absente et qu'aucun thread ne l'a demandée, l'appelant est chargé d'envoyer la requête (#MISS). Si un autre thread l'a déjà demandée, on attend sa réponse au plus \b wait secondes (#TIMEOUT), ou on rend la main tout de suite si \b wait est nul (#BUSY).
+     * \param[in] key Requête normalisée
+     * \param[out] data Réponse trouvée, à supprimer par l'appelant
+     * \param[in] wait Attente maximale de la réponse d'une requête en cours, en secondes
+     * \~english \brief Look for an answer in the cache
+     * \details If answer is missing and no thread asked for it, caller is in charge of sending the request (#MISS). If another thread already asked for it, we wait for its answer at most \b wait seconds (#TIMEOUT), or return immediatly if \b wait is null (#BUSY).
+     * \param[in] key Normalized request
+     * \param[out] data Found answer, to delete by caller
+     * \param[in] wait Max wait for a running request's answer, in seconds
+     */
+    static eLookup lookup ( std::string key, RawDataSource** data, int wait );
+
+    /**
+     * \~french \brief Mémorise la réponse d'une requête pour laquelle #lookup a rendu #MISS
+     * \details Le contenu est copié. Les threads attendant cette réponse sont réveillés
+     * \~english \brief Store the answer of a request for which #lookup returned #MISS
+     * \details Content is copied. Threads waiting for this answer are woken up
+     */
+    static void store ( std::string key, const uint8_t* data, size_t size, std::string type );
+
+    /**
+     * \~french \brief Signale l'échec d'une requête pour laquelle #lookup a rendu #MISS
+     * \details Les threads attendant cette réponse sont réveillés, et leur recherche rend #FAILED
+     * \~english \brief Signal the failure of a request for which #lookup returned #MISS
+     * \details Threads waiting for this answer are woken up, and their lookup returns #FAILED
+     */
+    static void abandon ( std::string key );
+
+    /**
+     * \~french \brief Définit l'occupation mémoire maximale du cache, en octets (0 pour désactiver le cache en mémoire)
+     * \~english \brief Define the max memory used by the cache, in bytes (0 to disable in memory cache)
+     */
+    static void setCacheSize ( size_t size );
+
+    /**
+     * \~french \brief Définit le répertoire et le volume maximal du cache sur disque
+     * \details Les fichiers déjà présents dans le répertoire sont repris, les fichiers temporaires plus vieux que WEBSERVICE_CACHE_TMP_GRACE sont supprimés. Un répertoire vide ou un volume nul désactive le cache sur disque
+     * \param[in] dir Répertoire du cache, créé si nécessaire
+     * \param[in] size Volume maximal, en octets
+     * \~english \brief Define the directory and the max volume of the on disk cache
+     * \details Files already in the directory are taken over, temporary files older than WEBSERVICE_CACHE_TMP_GRACE are removed. An empty directory or a null volume disables the on disk cache
+     * \param[in] dir Cache directory, created if necessary
+     * \param[in] size Max volume, in bytes
+     */
+    static bool setDirectory ( std::string dir, size_t size );
+
+    /**
+     * \~french \brief Définit la durée de validité d'une réponse, en secondes (0 pour une validité illimitée)
+     * \~english \brief Define an answer's validity period, in seconds (0 for unlimited validity)
+     */
+    static void setValidity ( int v ) {
+        pthread_mutex_lock ( &mtx );
+        validity = v;
+        pthread_mutex_unlock ( &mtx );
+    }
+
+    /**
+     * \~french \brief Nombre de réponses trouvées en mémoire
+     * \~english \brief Number of answers found in memory
+     */
+    static uint64_t getHits ();
+
+    /**
+     * \~french \brief Nombre de réponses trouvées sur disque
+     * \~english \brief Number of answers found on disk
+     */
+    static uint64_t getDiskHits ();
+
+    /**
+     * \~french \brief Nombre de réponses absentes, demandées au service distant
+     * \~english \brief Number of missing answers, asked to the remote service
+     */
+    static uint64_t getMisses ();
+
+    /**
+     * \~french \brief Nombre de recherches ayant attendu une requête en cours
+     * \~english \brief Number of lookups which waited for a running request
+     */
+    static uint64_t getShared ();
+
+    /**
+     * \~french \brief Affiche les statistiques d'utilisation du cache
+     * \~english \brief Print the cache usage statistics
+     */
+    static void printStats ();
+
+    /**
+     * \~french \brief Vide le cache en mémoire et remet à zéro les statistiques
+     * \details Le cache sur disque est conservé, pour être repris au prochain démarrage
+     * \~english \brief Empty the in memory cache and reset statistics
+     * \details On disk cache is kept, to be taken over at next start
+     */
+    static void cleanCache ();
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~WebServiceCache() {};
+};
+
+#endif
@@ -68,6 +68,11 @@
 #include "ConfLoader.h"
 #include <proj_api.h>
 #include "Rok4Api.h"
+#include "ThreadPool.h"
+#include "FileDescriptorCache.h"
+#include "TileCache.h"
+#include "WebServiceCache.h"
+#include "BufferPool.h"
 #include <csignal>
 #include <bits/signum.h>
 #include <sys/time.h>
@@ -185,6 +190,7 @@ int main ( int argc, char** argv ) {
 
     bool firstStart = true;
     int sock = 0;
+    int httpSock = -1;
     reload = true;
     defer_signal = 1;
     /* install Signal Handler for Conf Reloadind and Server Shutdown*/
@@ -252,6 +258,7 @@ int main ( int argc, char** argv ) {
                 return 1;
             }
             W->initFCGI();
+            W->initHTTP();
             firstStart = false;
         } else {
             std::cout<< _ ( "Mise a jour de la configuration" ) << "["<< getpid() <<"]" <<std::endl;
@@ -261,6 +268,7 @@ int main ( int argc, char** argv ) {
                 Wtmp = 0;
             }
             W->setFCGISocket ( sock );
+            W->setHTTPSocket ( httpSock );
         }
 
         // Remove Event Lock
@@ -272,6 +280,7 @@ int main ( int argc, char** argv ) {
             // Rechargement du serveur
             LOGGER_INFO ( _ ( "Rechargement de la configuration" ) );
             sock = W->getFCGISocket();
+            httpSock = W->getHTTPSocket();
         } else {
             // Extinction du serveur
             LOGGER_INFO ( _ ( "Extinction du serveur ROK4" ) );
@@ -281,6 +290,17 @@ int main ( int argc, char** argv ) {
         rok4ReloadLogger();
     }
 
+    // Arrêt des threads de lecture des tuiles, partagés par les serveurs successifs
+    ThreadPool::cleanSharedPool();
+    // Fermeture des fichiers de dalles restés ouverts
+    FileDescriptorCache::cleanCache();
+    // Libération des tuiles gardées en mémoire
+    TileCache::cleanCache();
+    // Libération des réponses des services distants gardées en mémoire
+    WebServiceCache::cleanCache();
+    // Libération des tampons gardés par le pool
+    BufferPool::cleanPool();
+
     //CURL clean - one time for the whole program
     curl_global_cleanup();
 
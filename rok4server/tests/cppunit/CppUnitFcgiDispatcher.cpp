@@ -0,0 +1,786 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include "fastcgi.h"
+#include "FcgiDispatcher.h"
+#include "BufferPool.h"
+
+// Paramètre de test, transmis en FastCGI ou en en-tête HTTP (X-...)
+static char* testParam ( std::string name, FCGX_Request* fcgxRequest ) {
+    char* value = FCGX_GetParam ( name.c_str(), fcgxRequest->envp );
+    if ( value == NULL ) value = FCGX_GetParam ( ( "HTTP_X_" + name ).c_str(), fcgxRequest->envp );
+    return value;
+}
+
+// Contexte de test lisant de manière asynchrone : l'attente ne se termine qu'une fois une requête non mise en attente traitée (ou au bout de 2 secondes)
+class ParkingContext : public Context {
+public:
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    bool plainDone, plainSeen;
+    int submitted;
+
+    ParkingContext() : plainDone ( false ), plainSeen ( false ), submitted ( 0 ) {
+        pthread_mutex_init ( &mtx, NULL );
+        pthread_cond_init ( &cond, NULL );
+    }
+    ~ParkingContext() {
+        pthread_mutex_destroy ( &mtx );
+        pthread_cond_destroy ( &cond );
+    }
+
+    bool asyncReads() { return true; }
+    void submitReads ( std::vector<ContextRead*>& reads ) {
+        submitted += reads.size();
+    }
+    void waitReads ( std::vector<ContextRead*>& reads ) {
+        struct timespec deadline;
+        clock_gettime ( CLOCK_REALTIME, &deadline );
+        deadline.tv_sec += 2;
+        pthread_mutex_lock ( &mtx );
+        while ( ! plainDone && pthread_cond_timedwait ( &cond, &mtx, &deadline ) == 0 );
+        plainSeen = plainDone;
+        pthread_mutex_unlock ( &mtx );
+        for ( size_t i = 0; i < reads.size(); i++ ) reads.at ( i )->result = read ( reads.at ( i )->data, reads.at ( i )->offset, reads.at ( i )->size, reads.at ( i )->name );
+    }
+    void plainProcessed() {
+        pthread_mutex_lock ( &mtx );
+        plainDone = true;
+        pthread_cond_broadcast ( &cond );
+        pthread_mutex_unlock ( &mtx );
+    }
+
+    int read ( uint8_t* data, int offset, int size, std::string name ) {
+        for ( int i = 0; i < size; i++ ) data[i] = name.at ( ( offset + i ) % name.size() );
+        return size;
+    }
+    bool connection() { return true; }
+    bool write ( uint8_t* data, int offset, int size, std::string name ) { return false; }
+    bool writeFull ( uint8_t* data, int size, std::string name ) { return false; }
+    bool openToWrite ( std::string name ) { return false; }
+    bool closeToWrite ( std::string name ) { return false; }
+    ContextType::eContextType getType() { return ContextType::CEPHCONTEXT; }
+    std::string getTypeStr() { return "TEST"; }
+    std::string getTray() { return ""; }
+    std::string getPath ( std::string racine, int x, int y, int pathDepth = 2 ) { return racine; }
+    void print() {}
+    std::string toString() { return "TEST"; }
+    void closeConnection() {}
+};
+
+static ParkingContext* parkingContext = NULL;
+
+// Requête mise en attente de lectures : la reprise renvoie la donnée lue
+struct ParkedEcho {
+    uint8_t data[16];
+    ContextRead* read;
+};
+
+static void resumeEcho ( FCGX_Request* fcgxRequest, void* state ) {
+    ParkedEcho* parked = ( ParkedEcho* ) state;
+    std::string response = "Status: 200 OK\r\nContent-Type: text/plain\r\n\r\n";
+    if ( parked->read->result > 0 ) response.append ( ( char* ) parked->data, parked->read->result );
+    FCGX_PutStr ( response.data(), response.size(), fcgxRequest->out );
+    delete parked->read;
+    delete parked;
+}
+
+// Traitement de test : renvoie la requête et le corps, après une éventuelle attente (paramètre WAIT, en millisecondes)
+static void echoHandler ( FCGX_Request* fcgxRequest, void* arg ) {
+    // Lecture de l'objet nommé par le paramètre PARK, sans occuper le thread de traitement
+    char* park = testParam ( "PARK", fcgxRequest );
+    if ( park && parkingContext ) {
+        ParkedEcho* parked = new ParkedEcho();
+        parked->read = new ContextRead ( parked->data, 0, 16, park );
+        std::map<Context*, std::vector<ContextRead*> > reads;
+        reads[parkingContext].push_back ( parked->read );
+        FcgiDispatcher::parkReads ( fcgxRequest, reads, resumeEcho, parked );
+        return;
+    }
+
+    char* wait = testParam ( "WAIT", fcgxRequest );
+    if ( wait ) usleep ( atoi ( wait ) * 1000 );
+
+    std::string body;
+    char line[200];
+    while ( FCGX_GetLine ( line, 200, fcgxRequest->in ) ) body.append ( line );
+
+    char* status = testParam ( "STATUS", fcgxRequest );
+    std::string response = std::string ( "Status: " ) + ( status ? status : "200 OK" ) + "\r\nContent-Type: text/plain\r\n\r\n";
+    char* query = FCGX_GetParam ( "QUERY_STRING", fcgxRequest->envp );
+    response.append ( query ? query : "" );
+    response.append ( "|" );
+    response.append ( body );
+
+    char* size = testParam ( "SIZE", fcgxRequest );
+    if ( size ) response.append ( atoi ( size ), 'x' );
+
+    FCGX_PutStr ( response.data(), response.size(), fcgxRequest->out );
+
+    // Suite du corps transmise depuis un tampon partagé (paramètre POOLED, en octets)
+    char* pooled = testParam ( "POOLED", fcgxRequest );
+    if ( pooled ) {
+        size_t length = atoi ( pooled );
+        PooledBuffer* buffer = BufferPool::acquire ( length );
+        for ( size_t i = 0; i < length; i++ ) buffer->getData() [i] = 'a' + i % 26;
+        FcgiDispatcher::putBuffer ( fcgxRequest->out, buffer, 0, length );
+        buffer->release();
+    }
+
+    if ( parkingContext ) parkingContext->plainProcessed();
+}
+
+static void* runDispatcher ( void* arg ) {
+    ( ( FcgiDispatcher* ) arg )->run();
+    return NULL;
+}
+
+class CppUnitFcgiDispatcher : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitFcgiDispatcher );
+    CPPUNIT_TEST ( simpleRequest );
+    CPPUNIT_TEST ( multiplexedRequests );
+    CPPUNIT_TEST ( manyConnections );
+    CPPUNIT_TEST ( managementRecords );
+    CPPUNIT_TEST ( gracefulStop );
+    CPPUNIT_TEST ( httpPipelining );
+    CPPUNIT_TEST ( httpResponses );
+    CPPUNIT_TEST ( httpErrors );
+    CPPUNIT_TEST ( pooledBuffers );
+    CPPUNIT_TEST ( httpTimeouts );
+    CPPUNIT_TEST ( parkedReads );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    std::string path, httpPath;
+    int listenSock, httpSock;
+    FcgiDispatcher* dispatcher;
+    pthread_t loop;
+
+    int connectClient ( bool http = false ) {
+        int fd = socket ( AF_UNIX, SOCK_STREAM, 0 );
+        struct sockaddr_un addr;
+        memset ( &addr, 0, sizeof ( addr ) );
+        addr.sun_family = AF_UNIX;
+        strncpy ( addr.sun_path, ( http ? httpPath : path ).c_str(), sizeof ( addr.sun_path ) - 1 );
+        CPPUNIT_ASSERT ( connect ( fd, ( struct sockaddr* ) &addr, sizeof ( addr ) ) == 0 );
+        return fd;
+    }
+
+    std::string encodeParams ( std::map<std::string, std::string> params ) {
+        std::string raw;
+        std::map<std::string, std::string>::iterator it;
+        for ( it = params.begin(); it != params.end(); ++it ) {
+            raw.push_back ( ( char ) it->first.size() );
+            // Longueur sur 4 octets pour tester les deux encodages
+            size_t l = it->second.size();
+            raw.push_back ( ( char ) ( 0x80 | ( ( l >> 24 ) & 0x7f ) ) );
+            raw.push_back ( ( char ) ( ( l >> 16 ) & 0xff ) );
+            raw.push_back ( ( char ) ( ( l >> 8 ) & 0xff ) );
+            raw.push_back ( ( char ) ( l & 0xff ) );
+            raw.append ( it->first );
+            raw.append ( it->second );
+        }
+        return raw;
+    }
+
+    std::string buildRequest ( int id, bool keep, std::map<std::string, std::string> params, std::string body ) {
+        std::string out;
+        unsigned char begin[8] = { 0, FCGI_RESPONDER, ( unsigned char ) ( keep ? FCGI_KEEP_CONN : 0 ), 0, 0, 0, 0, 0 };
+        FcgiDispatcher::appendRecord ( out, FCGI_BEGIN_REQUEST, id, ( char* ) begin, 8 );
+        std::string raw = encodeParams ( params );
+        FcgiDispatcher::appendRecord ( out, FCGI_PARAMS, id, raw.data(), raw.size() );
+        FcgiDispatcher::appendRecord ( out, FCGI_PARAMS, id, NULL, 0 );
+        if ( ! body.empty() ) FcgiDispatcher::appendRecord ( out, FCGI_STDIN, id, body.data(), body.size() );
+        FcgiDispatcher::appendRecord ( out, FCGI_STDIN, id, NULL, 0 );
+        return out;
+    }
+
+    void sendAll ( int fd, std::string data ) {
+        size_t done = 0;
+        while ( done < data.size() ) {
+            ssize_t w = write ( fd, data.data() + done, data.size() - done );
+            CPPUNIT_ASSERT ( w > 0 );
+            done += w;
+        }
+    }
+
+    // Lit les réponses jusqu'à avoir reçu "expected" fins de requête (ou la fermeture), renvoie les sorties standard par requête
+    std::map<int, std::string> readResponses ( int fd, int expected, std::map<int, int>* status = NULL, std::vector<int>* types = NULL ) {
+        std::map<int, std::string> stdouts;
+        std::string buffer;
+        int ended = 0;
+        char chunk[4096];
+        while ( ended < expected ) {
+            ssize_t r = read ( fd, chunk, sizeof ( chunk ) );
+            if ( r <= 0 ) break;
+            buffer.append ( chunk, r );
+            while ( buffer.size() >= 8 ) {
+                const unsigned char* h = ( const unsigned char* ) buffer.data();
+                int length = ( h[4] << 8 ) | h[5];
+                if ( buffer.size() < 8 + length + h[6] ) break;
+                int id = ( h[2] << 8 ) | h[3];
+                if ( types ) types->push_back ( h[1] );
+                if ( h[1] == FCGI_STDOUT ) stdouts[id].append ( buffer.data() + 8, length );
+                if ( h[1] == FCGI_END_REQUEST ) {
+                    if ( status ) ( *status ) [id] = h[8 + 4];
+                    ended++;
+                }
+                if ( h[1] == FCGI_GET_VALUES_RESULT ) {
+                    stdouts[0].append ( buffer.data() + 8, length );
+                    ended++;
+                }
+                buffer.erase ( 0, 8 + length + h[6] );
+            }
+        }
+        return stdouts;
+    }
+
+    std::string body ( std::string stdout ) {
+        size_t pos = stdout.find ( "\r\n\r\n" );
+        if ( pos == std::string::npos ) return "";
+        return stdout.substr ( pos + 4 );
+    }
+
+    int listenOn ( std::string p ) {
+        unlink ( p.c_str() );
+        int s = socket ( AF_UNIX, SOCK_STREAM, 0 );
+        struct sockaddr_un addr;
+        memset ( &addr, 0, sizeof ( addr ) );
+        addr.sun_family = AF_UNIX;
+        strncpy ( addr.sun_path, p.c_str(), sizeof ( addr.sun_path ) - 1 );
+        CPPUNIT_ASSERT ( bind ( s, ( struct sockaddr* ) &addr, sizeof ( addr ) ) == 0 );
+        CPPUNIT_ASSERT ( listen ( s, 1024 ) == 0 );
+        return s;
+    }
+
+    struct HttpResponse {
+        int status;
+        std::map<std::string, std::string> headers;
+        std::string body;
+    };
+
+    // Lit une réponse HTTP complète, "buffer" garde les octets reçus au-delà
+    bool readHttpResponse ( int fd, std::string& buffer, HttpResponse& response, bool head = false ) {
+        char chunk[4096];
+        size_t end;
+        while ( ( end = buffer.find ( "\r\n\r\n" ) ) == std::string::npos ) {
+            ssize_t r = read ( fd, chunk, sizeof ( chunk ) );
+            if ( r <= 0 ) return false;
+            buffer.append ( chunk, r );
+        }
+        response.status = atoi ( buffer.c_str() + 9 );
+        response.headers.clear();
+        response.body.clear();
+        size_t pos = buffer.find ( "\r\n" ) + 2;
+        while ( pos < end ) {
+            size_t lineEnd = buffer.find ( "\r\n", pos );
+            std::string line = buffer.substr ( pos, lineEnd - pos );
+            size_t colon = line.find ( ':' );
+            std::string name = line.substr ( 0, colon );
+            for ( int i = 0; i < name.size(); i++ ) name[i] = tolower ( name[i] );
+            response.headers[name] = line.substr ( colon + 2 );
+            pos = lineEnd + 2;
+        }
+        buffer.erase ( 0, end + 4 );
+
+        if ( head || response.status == 304 ) return true;
+
+        if ( response.headers.count ( "content-length" ) ) {
+            size_t length = atoi ( response.headers["content-length"].c_str() );
+            while ( buffer.size() < length ) {
+                ssize_t r = read ( fd, chunk, sizeof ( chunk ) );
+                if ( r <= 0 ) return false;
+                buffer.append ( chunk, r );
+            }
+            response.body = buffer.substr ( 0, length );
+            buffer.erase ( 0, length );
+        } else if ( response.headers["transfer-encoding"] == "chunked" ) {
+            while ( true ) {
+                size_t lineEnd;
+                while ( ( lineEnd = buffer.find ( "\r\n" ) ) == std::string::npos ) {
+                    ssize_t r = read ( fd, chunk, sizeof ( chunk ) );
+                    if ( r <= 0 ) return false;
+                    buffer.append ( chunk, r );
+                }
+                size_t length = strtoul ( buffer.c_str(), NULL, 16 );
+                while ( buffer.size() < lineEnd + 2 + length + 2 ) {
+                    ssize_t r = read ( fd, chunk, sizeof ( chunk ) );
+                    if ( r <= 0 ) return false;
+                    buffer.append ( chunk, r );
+                }
+                response.body.append ( buffer, lineEnd + 2, length );
+                buffer.erase ( 0, lineEnd + 2 + length + 2 );
+                if ( length == 0 ) break;
+            }
+        } else {
+            // Corps délimité par la fermeture de la connexion
+            response.body = buffer;
+            buffer.clear();
+            ssize_t r;
+            while ( ( r = read ( fd, chunk, sizeof ( chunk ) ) ) > 0 ) response.body.append ( chunk, r );
+        }
+        return true;
+    }
+
+    void startDispatcher ( int workers, bool http = false, int timeout = 0 ) {
+        dispatcher = new FcgiDispatcher ( listenSock, workers, echoHandler, NULL );
+        if ( http ) dispatcher->setHttpSocket ( httpSock );
+        if ( timeout ) dispatcher->setHttpTimeouts ( timeout, timeout, timeout );
+        pthread_create ( &loop, NULL, runDispatcher, dispatcher );
+    }
+
+    void stopDispatcher() {
+        if ( dispatcher == NULL ) return;
+        dispatcher->stop();
+        pthread_join ( loop, NULL );
+        delete dispatcher;
+        dispatcher = NULL;
+    }
+
+public:
+
+    void setUp() {
+        char tmp[64];
+        sprintf ( tmp, "/tmp/rok4-fcgi-%d.sock", getpid() );
+        path = tmp;
+        sprintf ( tmp, "/tmp/rok4-http-%d.sock", getpid() );
+        httpPath = tmp;
+
+        listenSock = listenOn ( path );
+        httpSock = listenOn ( httpPath );
+        dispatcher = NULL;
+    }
+
+    void tearDown() {
+        stopDispatcher();
+        close ( listenSock );
+        close ( httpSock );
+        unlink ( path.c_str() );
+        unlink ( httpPath.c_str() );
+    }
+
+    void simpleRequest() {
+        startDispatcher ( 2 );
+
+        std::map<std::string, std::string> params;
+        params["QUERY_STRING"] = "SERVICE=WMTS&REQUEST=GetTile";
+        params["SIZE"] = "200000";
+        int fd = connectClient();
+        sendAll ( fd, buildRequest ( 1, false, params, "ligne 1\nligne 2\n" ) );
+
+        std::map<int, int> status;
+        std::map<int, std::string> out = readResponses ( fd, 1, &status );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "SERVICE=WMTS&REQUEST=GetTile|ligne 1\nligne 2\n" ) + std::string ( 200000, 'x' ), body ( out[1] ) );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) FCGI_REQUEST_COMPLETE, status[1] );
+
+        // Sans FCGI_KEEP_CONN, la connexion est fermée après la réponse
+        char c;
+        CPPUNIT_ASSERT_EQUAL ( ( ssize_t ) 0, read ( fd, &c, 1 ) );
+        close ( fd );
+    }
+
+    void multiplexedRequests() {
+        startDispatcher ( 4 );
+
+        int fd = connectClient();
+        std::string all;
+        for ( int id = 1; id <= 3; id++ ) {
+            std::map<std::string, std::string> params;
+            params["QUERY_STRING"] = std::string ( "id=" ) + ( char ) ( '0' + id );
+            // La première requête est la plus longue : les réponses arrivent dans le désordre
+            params["WAIT"] = id == 1 ? "200" : "0";
+            all.append ( buildRequest ( id, true, params, "" ) );
+        }
+        sendAll ( fd, all );
+
+        std::map<int, std::string> out = readResponses ( fd, 3 );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "id=1|" ), body ( out[1] ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "id=2|" ), body ( out[2] ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "id=3|" ), body ( out[3] ) );
+
+        // La connexion est gardée pour une requête suivante
+        std::map<std::string, std::string> params;
+        params["QUERY_STRING"] = "id=4";
+        sendAll ( fd, buildRequest ( 4, true, params, "" ) );
+        out = readResponses ( fd, 1 );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "id=4|" ), body ( out[4] ) );
+        close ( fd );
+    }
+
+    void manyConnections() {
+        startDispatcher ( 4 );
+
+        // Une connexion lente, qui n'envoie jamais la fin de sa requête, ne bloque aucun thread
+        int slow = connectClient();
+        std::string partial = buildRequest ( 1, false, std::map<std::string, std::string>(), "" );
+        sendAll ( slow, partial.substr ( 0, 20 ) );
+
+        const int nb = 500;
+        std::vector<int> fds;
+        for ( int i = 0; i < nb; i++ ) {
+            fds.push_back ( connectClient() );
+            std::map<std::string, std::string> params;
+            params["QUERY_STRING"] = "ok";
+            sendAll ( fds.back(), buildRequest ( 1, false, params, "" ) );
+        }
+
+        int answered = 0;
+        for ( int i = 0; i < nb; i++ ) {
+            std::map<int, std::string> out = readResponses ( fds.at ( i ), 1 );
+            if ( body ( out[1] ) == "ok|" ) answered++;
+            close ( fds.at ( i ) );
+        }
+        CPPUNIT_ASSERT_EQUAL ( nb, answered );
+        close ( slow );
+    }
+
+    void managementRecords() {
+        startDispatcher ( 1 );
+        int fd = connectClient();
+
+        // Le serveur web s'informe des capacités
+        std::string query;
+        const char* names[3] = { FCGI_MAX_CONNS, FCGI_MAX_REQS, FCGI_MPXS_CONNS };
+        for ( int i = 0; i < 3; i++ ) {
+            query.push_back ( ( char ) strlen ( names[i] ) );
+            query.push_back ( 0 );
+            query.append ( names[i] );
+        }
+        std::string records;
+        FcgiDispatcher::appendRecord ( records, FCGI_GET_VALUES, 0, query.data(), query.size() );
+        sendAll ( fd, records );
+        std::map<int, std::string> out = readResponses ( fd, 1 );
+        CPPUNIT_ASSERT ( out[0].find ( std::string ( FCGI_MPXS_CONNS ) + "1" ) != std::string::npos );
+
+        // Requête interrompue avant d'être complète
+        records.clear();
+        unsigned char begin[8] = { 0, FCGI_RESPONDER, FCGI_KEEP_CONN, 0, 0, 0, 0, 0 };
+        FcgiDispatcher::appendRecord ( records, FCGI_BEGIN_REQUEST, 7, ( char* ) begin, 8 );
+        FcgiDispatcher::appendRecord ( records, FCGI_ABORT_REQUEST, 7, NULL, 0 );
+        // Rôle non géré
+        unsigned char filter[8] = { 0, FCGI_FILTER, FCGI_KEEP_CONN, 0, 0, 0, 0, 0 };
+        FcgiDispatcher::appendRecord ( records, FCGI_BEGIN_REQUEST, 8, ( char* ) filter, 8 );
+        sendAll ( fd, records );
+
+        std::map<int, int> status;
+        std::vector<int> types;
+        readResponses ( fd, 2, &status, &types );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) FCGI_REQUEST_COMPLETE, status[7] );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) FCGI_UNKNOWN_ROLE, status[8] );
+        close ( fd );
+    }
+
+    void gracefulStop() {
+        startDispatcher ( 2 );
+
+        std::vector<int> fds;
+        for ( int i = 0; i < 4; i++ ) {
+            fds.push_back ( connectClient() );
+            std::map<std::string, std::string> params;
+            params["QUERY_STRING"] = "late";
+            params["WAIT"] = "300";
+            sendAll ( fds.back(), buildRequest ( 1, false, params, "" ) );
+        }
+        usleep ( 100000 );
+
+        // L'arrêt attend la fin des requêtes reçues
+        struct timeval start, end;
+        gettimeofday ( &start, NULL );
+        stopDispatcher();
+        gettimeofday ( &end, NULL );
+        double elapsed = ( end.tv_sec - start.tv_sec ) + ( end.tv_usec - start.tv_usec ) / 1e6;
+        CPPUNIT_ASSERT ( elapsed >= 0.2 );
+
+        for ( int i = 0; i < 4; i++ ) {
+            std::map<int, std::string> out = readResponses ( fds.at ( i ), 1 );
+            CPPUNIT_ASSERT_EQUAL ( std::string ( "late|" ), body ( out[1] ) );
+            close ( fds.at ( i ) );
+        }
+    }
+
+    void httpPipelining() {
+        startDispatcher ( 4, true );
+
+        // Trois requêtes envoyées d'un coup, la première étant la plus longue : les réponses restent dans l'ordre
+        int fd = connectClient ( true );
+        sendAll ( fd, "GET /wmts?id=1 HTTP/1.1\r\nHost: localhost\r\nX-Wait: 200\r\n\r\n"
+                  "GET /wmts?id=2 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                  "POST /wmts?id=3 HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\ncorps" );
+
+        std::string buffer;
+        HttpResponse response;
+        const char* expected[3] = { "id=1|", "id=2|", "id=3|corps" };
+        for ( int i = 0; i < 3; i++ ) {
+            CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+            CPPUNIT_ASSERT_EQUAL ( 200, response.status );
+            CPPUNIT_ASSERT_EQUAL ( std::string ( "text/plain" ), response.headers["content-type"] );
+            CPPUNIT_ASSERT_EQUAL ( std::string ( expected[i] ), response.body );
+            CPPUNIT_ASSERT ( response.headers.count ( "content-length" ) == 1 );
+            CPPUNIT_ASSERT ( response.headers.count ( "connection" ) == 0 );
+        }
+
+        // Connexion persistante, avec une requête reçue en plusieurs fois
+        sendAll ( fd, "GET /wmts?id=4 HTTP/1.1\r\nHo" );
+        usleep ( 50000 );
+        sendAll ( fd, "st: localhost\r\nConnection: close\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "id=4|" ), response.body );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "close" ), response.headers["connection"] );
+        char c;
+        CPPUNIT_ASSERT_EQUAL ( ( ssize_t ) 0, read ( fd, &c, 1 ) );
+        close ( fd );
+    }
+
+    void httpResponses() {
+        startDispatcher ( 2, true );
+        int fd = connectClient ( true );
+        std::string buffer;
+        HttpResponse response;
+
+        // Réponse plus grande que le tampon de sortie : envoyée par morceaux au fil du traitement
+        sendAll ( fd, "GET /big HTTP/1.1\r\nHost: localhost\r\nX-Size: 300000\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "chunked" ), response.headers["transfer-encoding"] );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "|" ) + std::string ( 300000, 'x' ), response.body );
+
+        // Réponse conditionnelle : statut transmis, pas de corps
+        sendAll ( fd, "GET /tile HTTP/1.1\r\nHost: localhost\r\nIf-None-Match: \"abc\"\r\nX-Status: 304 Not Modified\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( 304, response.status );
+
+        // HEAD : en-têtes seuls
+        sendAll ( fd, "HEAD /tile?x=1 HTTP/1.1\r\nHost: localhost\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response, true ) );
+        CPPUNIT_ASSERT_EQUAL ( 200, response.status );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "4" ), response.headers["content-length"] );
+
+        // Corps attendu après une réponse intermédiaire
+        sendAll ( fd, "POST /wms HTTP/1.1\r\nHost: localhost\r\nContent-Length: 4\r\nExpect: 100-continue\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response, true ) );
+        CPPUNIT_ASSERT_EQUAL ( 100, response.status );
+        sendAll ( fd, "data" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "|data" ), response.body );
+        CPPUNIT_ASSERT ( buffer.empty() );
+        close ( fd );
+
+        // HTTP/1.0 : fermeture après la réponse, y compris quand le client a fermé son sens d'émission
+        fd = connectClient ( true );
+        sendAll ( fd, "GET /old?v=10 HTTP/1.0\r\n\r\n" );
+        shutdown ( fd, SHUT_WR );
+        buffer.clear();
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "v=10|" ), response.body );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "close" ), response.headers["connection"] );
+        close ( fd );
+    }
+
+    void httpErrors() {
+        startDispatcher ( 1, true );
+        std::string buffer;
+        HttpResponse response;
+
+        int fd = connectClient ( true );
+        sendAll ( fd, "GET /wmts HTTP/1.1\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( 400, response.status );
+        close ( fd );
+
+        fd = connectClient ( true );
+        buffer.clear();
+        sendAll ( fd, "POST /wms HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( 501, response.status );
+        close ( fd );
+
+        // Une requête valide pipelinée avant une requête invalide reçoit sa réponse
+        fd = connectClient ( true );
+        buffer.clear();
+        sendAll ( fd, "GET /ok?a HTTP/1.1\r\nHost: localhost\r\nX-Wait: 100\r\n\r\nNIMPORTE QUOI\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "a|" ), response.body );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( 400, response.status );
+        close ( fd );
+
+        // Le frontal FastCGI fonctionne toujours à côté
+        std::map<std::string, std::string> params;
+        params["QUERY_STRING"] = "fcgi";
+        fd = connectClient();
+        sendAll ( fd, buildRequest ( 1, false, params, "" ) );
+        std::map<int, std::string> out = readResponses ( fd, 1 );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "fcgi|" ), body ( out[1] ) );
+        close ( fd );
+    }
+
+    void pooledBuffers() {
+        BufferPool::cleanPool();
+        startDispatcher ( 2, true );
+
+        std::string expected;
+        for ( size_t i = 0; i < 200000; i++ ) expected.push_back ( 'a' + i % 26 );
+
+        // FastCGI : le tampon est découpé en plusieurs enregistrements
+        std::map<std::string, std::string> params;
+        params["QUERY_STRING"] = "fcgi";
+        params["POOLED"] = "200000";
+        int fd = connectClient();
+        sendAll ( fd, buildRequest ( 1, false, params, "" ) );
+        std::map<int, std::string> out = readResponses ( fd, 1 );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "fcgi|" ) + expected, body ( out[1] ) );
+        close ( fd );
+
+        // HTTP, avec deux requêtes pipelinées
+        fd = connectClient ( true );
+        sendAll ( fd, "GET /wmts?http HTTP/1.1\r\nHost: localhost\r\nX-Pooled: 200000\r\n\r\n"
+                  "GET /wmts?head HTTP/1.1\r\nHost: localhost\r\nX-Pooled: 5000\r\n\r\n" );
+        std::string buffer;
+        HttpResponse response;
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( 200, response.status );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "http|" ) + expected, response.body );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "head|" ) + expected.substr ( 0, 5000 ), response.body );
+        close ( fd );
+
+        stopDispatcher();
+        // Une fois envoyés, les tampons sont rendus à la réserve
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 3, BufferPool::getAcquisitions() );
+        CPPUNIT_ASSERT ( BufferPool::getAllocations() <= 3 );
+        CPPUNIT_ASSERT ( BufferPool::getUsedMemory() > 200000 + 5000 );
+        BufferPool::cleanPool();
+    }
+
+    void httpTimeouts() {
+        startDispatcher ( 1, true, 1 );
+        std::string buffer;
+        HttpResponse response;
+        char chunk[64];
+
+        // Connexion gardée puis inactive : fermée sans réponse
+        int fd = connectClient ( true );
+        sendAll ( fd, "GET /wmts?keep HTTP/1.1\r\nHost: localhost\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "keep|" ), response.body );
+        CPPUNIT_ASSERT_EQUAL ( ( ssize_t ) 0, read ( fd, chunk, sizeof ( chunk ) ) );
+        close ( fd );
+
+        // En-tête envoyé au compte-gouttes : la réception de quelques octets ne repousse pas le délai
+        fd = connectClient ( true );
+        buffer.clear();
+        sendAll ( fd, "GET /wmts HTTP/1.1\r\n" );
+        for ( int i = 0; i < 6; i++ ) {
+            usleep ( 500000 );
+            if ( send ( fd, "X", 1, MSG_NOSIGNAL ) != 1 ) break;
+        }
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( 408, response.status );
+        close ( fd );
+
+        // Corps incomplet
+        fd = connectClient ( true );
+        buffer.clear();
+        sendAll ( fd, "POST /wms HTTP/1.1\r\nHost: localhost\r\nContent-Length: 10\r\n\r\n012" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( 408, response.status );
+        close ( fd );
+
+        // Une requête lente à traiter n'est pas concernée par les délais
+        fd = connectClient ( true );
+        buffer.clear();
+        sendAll ( fd, "GET /wmts?slow HTTP/1.1\r\nHost: localhost\r\nX-Wait: 3000\r\n\r\n" );
+        CPPUNIT_ASSERT ( readHttpResponse ( fd, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "slow|" ), response.body );
+        close ( fd );
+    }
+
+
+    void parkedReads() {
+        parkingContext = new ParkingContext();
+        // Un seul thread de traitement : il doit traiter la seconde requête pendant les lectures de la première
+        startDispatcher ( 1, true );
+
+        std::map<std::string, std::string> params;
+        params["QUERY_STRING"] = "parked";
+        params["PARK"] = "objet";
+        int fd1 = connectClient();
+        sendAll ( fd1, buildRequest ( 1, false, params, "" ) );
+
+        int fd2 = connectClient ( true );
+        sendAll ( fd2, "GET /wmts?plain HTTP/1.1\r\nHost: localhost\r\n\r\n" );
+        std::string buffer;
+        HttpResponse response;
+        CPPUNIT_ASSERT ( readHttpResponse ( fd2, buffer, response ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "plain|" ), response.body );
+        close ( fd2 );
+
+        std::map<int, int> status;
+        std::map<int, std::string> out = readResponses ( fd1, 1, &status );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "objetobjetobjeto" ), body ( out[1] ) );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) FCGI_REQUEST_COMPLETE, status[1] );
+        close ( fd1 );
+
+        CPPUNIT_ASSERT ( parkingContext->plainSeen );
+        CPPUNIT_ASSERT_EQUAL ( 1, parkingContext->submitted );
+
+        // Requête en attente pendant l'arrêt : elle est reprise et terminée avant la fin
+        fd1 = connectClient();
+        sendAll ( fd1, buildRequest ( 2, false, params, "" ) );
+        usleep ( 100000 );
+        dispatcher->stop();
+        out = readResponses ( fd1, 1 );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "objetobjetobjeto" ), body ( out[2] ) );
+        close ( fd1 );
+
+        stopDispatcher();
+        delete parkingContext;
+        parkingContext = NULL;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitFcgiDispatcher );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitFcgiDispatcher, "CppUnitFcgiDispatcher" );
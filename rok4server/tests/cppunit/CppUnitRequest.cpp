@@ -60,6 +60,7 @@ class CppUnitRequest : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST ( testgetParam );
     CPPUNIT_TEST ( testgetCapWMSParam );
     CPPUNIT_TEST ( testgetCapWMTSParam );
+    CPPUNIT_TEST ( testConditions );
     CPPUNIT_TEST_SUITE_END();
 
 protected:
@@ -128,6 +129,7 @@ protected:
     void testgetParam();
     void testgetCapWMSParam();
     void testgetCapWMTSParam();
+    void testConditions();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRequest );
@@ -440,3 +442,42 @@ void CppUnitRequest::testgetCapWMTSParam() {
 void CppUnitRequest::tearDown() {
     delete services_conf;
 }
+
+void CppUnitRequest::testConditions() {
+    char query[] = "service=wmts&request=gettile";
+    char host[] = "127.0.0.1";
+    char path[] = "/wmts";
+    Request* marequete = new Request ( query, host, path, NULL );
+    CPPUNIT_ASSERT_MESSAGE ( "no conditions :\n", ! marequete->hasConditions() );
+    CPPUNIT_ASSERT_MESSAGE ( "no conditions :\n", ! marequete->isNotModified ( "abc-0-10", 1000 ) );
+
+    // Dates HTTP
+    CPPUNIT_ASSERT_EQUAL ( ( time_t ) 784111777, parseHttpDate ( "Sun, 06 Nov 1994 08:49:37 GMT" ) );
+    CPPUNIT_ASSERT_EQUAL ( ( time_t ) 0, parseHttpDate ( "Sunday, 06-Nov-94 08:49:37 GMT" ) );
+    CPPUNIT_ASSERT_EQUAL ( ( time_t ) 0, parseHttpDate ( "n'importe quoi" ) );
+
+    // If-None-Match : liste d'identifiants, faibles ou non
+    char noneMatch[] = "\"xyz-0-1\", W/\"abc-0-10\"";
+    marequete->setConditions ( noneMatch, NULL );
+    CPPUNIT_ASSERT_MESSAGE ( "If-None-Match :\n", marequete->hasConditions() );
+    CPPUNIT_ASSERT_MESSAGE ( "If-None-Match :\n", marequete->isNotModified ( "abc-0-10", 0 ) );
+    CPPUNIT_ASSERT_MESSAGE ( "If-None-Match :\n", marequete->isNotModified ( "xyz-0-1", 0 ) );
+    CPPUNIT_ASSERT_MESSAGE ( "If-None-Match :\n", ! marequete->isNotModified ( "abc-0-11", 0 ) );
+    CPPUNIT_ASSERT_MESSAGE ( "If-None-Match :\n", ! marequete->isNotModified ( "", 0 ) );
+
+    char any[] = "*";
+    marequete->setConditions ( any, NULL );
+    CPPUNIT_ASSERT_MESSAGE ( "If-None-Match * :\n", marequete->isNotModified ( "abc-0-10", 0 ) );
+
+    // If-Modified-Since, ignoré en présence de If-None-Match
+    char modifiedSince[] = "Sun, 06 Nov 1994 08:49:37 GMT";
+    marequete->setConditions ( NULL, modifiedSince );
+    CPPUNIT_ASSERT_MESSAGE ( "If-Modified-Since :\n", marequete->isNotModified ( "abc-0-10", 784111777 ) );
+    CPPUNIT_ASSERT_MESSAGE ( "If-Modified-Since :\n", ! marequete->isNotModified ( "abc-0-10", 784111778 ) );
+    CPPUNIT_ASSERT_MESSAGE ( "If-Modified-Since :\n", ! marequete->isNotModified ( "abc-0-10", 0 ) );
+    char other[] = "\"xyz-0-1\"";
+    marequete->setConditions ( other, modifiedSince );
+    CPPUNIT_ASSERT_MESSAGE ( "If-None-Match first :\n", ! marequete->isNotModified ( "abc-0-10", 784111777 ) );
+
+    delete marequete;
+}
@@ -0,0 +1,288 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "Rok4Server.h"
+#include "ConfLoader.h"
+#include "EmptyImage.h"
+#include "Rok4Image.h"
+#include "FileContext.h"
+
+// Contexte fichier comptant ses lectures, éventuellement faites depuis plusieurs tâches
+class CountingContext : public FileContext {
+public:
+    int reads;
+    pthread_mutex_t mutex;
+
+    CountingContext ( std::string root ) : FileContext ( root ), reads ( 0 ) {
+        pthread_mutex_init ( &mutex, NULL );
+    }
+
+    int read ( uint8_t* data, int offset, int size, std::string name ) {
+        pthread_mutex_lock ( &mutex );
+        reads++;
+        pthread_mutex_unlock ( &mutex );
+        return FileContext::read ( data, offset, size, name );
+    }
+
+    ~CountingContext() {
+        pthread_mutex_destroy ( &mutex );
+    }
+};
+
+// Couche à la volée sur une pyramide de base, dans un répertoire temporaire
+class CppUnitRok4Server : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitRok4Server );
+    CPPUNIT_TEST ( twoSlabsOnFly );
+    CPPUNIT_TEST ( terrainReadOnce );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    std::string dir;
+    Rok4Server* server;
+    ServerXML* serverXML;
+
+    void writeFile ( std::string path, std::string content ) {
+        std::ofstream f ( path.c_str() );
+        f << content;
+        f.close();
+    }
+
+    std::string pyramid ( std::string level ) {
+        return "<?xml version='1.0' encoding='UTF-8'?>\n<Pyramid>\n"
+               "<tileMatrixSet>TEST</tileMatrixSet>\n<format>TIFF_RAW_INT8</format>\n"
+               "<channels>1</channels>\n<nodataValue>0</nodataValue>\n<interpolation>nn</interpolation>\n<photometric>gray</photometric>\n"
+               "<level>\n<tileMatrix>0</tileMatrix>\n<tilesPerWidth>2</tilesPerWidth>\n<tilesPerHeight>2</tilesPerHeight>\n"
+               "<TMSLimits><minTileRow>0</minTileRow><maxTileRow>3</maxTileRow><minTileCol>0</minTileCol><maxTileCol>3</maxTileCol></TMSLimits>\n"
+               + level + "</level>\n</Pyramid>\n";
+    }
+
+    // Dalle de la pyramide de base, d'une seule valeur
+    void writeBasedSlab ( Level* level, int tileCol, int value ) {
+        std::string path = level->getPath ( tileCol, 0 );
+        level->createDirPath ( level->getDirPath ( tileCol, 0 ) );
+
+        int color[1] = { value };
+        EmptyImage* empty = new EmptyImage ( 512, 512, 1, color );
+        FileContext fc ( "" );
+        fc.connection();
+        Rok4ImageFactory R4IF;
+        Rok4Image* slab = R4IF.createRok4ImageToWrite (
+            path, level->tileIndicesToSlabBbox ( tileCol, 0 ), 1., 1., 512, 512, 1,
+            SampleFormat::UINT, 8, Photometric::GRAY, Compression::NONE, 256, 256, &fc
+        );
+        CPPUNIT_ASSERT ( slab != NULL );
+        CPPUNIT_ASSERT_EQUAL ( 0, slab->writeImage ( empty ) );
+        delete slab;
+        delete empty;
+    }
+
+    // Valeur d'un pixel de la dalle écrite
+    int readPixel ( std::string path, BoundingBox<double> bbox ) {
+        FileContext fc ( "" );
+        fc.connection();
+        Rok4ImageFactory R4IF;
+        Rok4Image* slab = R4IF.createRok4ImageToRead ( path, bbox, 1., 1., &fc );
+        CPPUNIT_ASSERT ( slab != NULL );
+        uint8_t line[512];
+        slab->getline ( line, 300 );
+        delete slab;
+        return line[300];
+    }
+
+public:
+
+    void setUp() {
+        char tmp[] = "/tmp/rok4serverXXXXXX";
+        CPPUNIT_ASSERT ( mkdtemp ( tmp ) != NULL );
+        dir = tmp;
+        mkdir ( ( dir + "/tms" ).c_str(), 0755 );
+        mkdir ( ( dir + "/styles" ).c_str(), 0755 );
+        mkdir ( ( dir + "/layers" ).c_str(), 0755 );
+
+        std::ostringstream conf;
+        conf << "<?xml version='1.0' encoding='UTF-8'?>\n<serverConf>\n"
+             << "<logOutput>standard_output_stream_for_errors</logOutput>\n<logLevel>fatal</logLevel>\n"
+             << "<nbThread>1</nbThread>\n<nbProcess>1</nbProcess>\n"
+             << "<WMTSSupport>true</WMTSSupport>\n<TMSSupport>false</TMSSupport>\n<WMSSupport>false</WMSSupport>\n"
+             << "<servicesConfigFile>" << dir << "/services.conf</servicesConfigFile>\n"
+             << "<layerDir>" << dir << "/layers</layerDir>\n"
+             << "<styleDir>" << dir << "/styles</styleDir>\n"
+             << "<tileMatrixSetDir>" << dir << "/tms</tileMatrixSetDir>\n";
+        // Le serveur redéfinit PROJ_LIB : on garde celui de l'environnement des tests
+        if ( getenv ( "PROJ_LIB" ) ) {
+            conf << "<projConfigDir>" << getenv ( "PROJ_LIB" ) << "</projConfigDir>\n";
+        }
+        conf << "</serverConf>\n";
+        writeFile ( dir + "/server.conf", conf.str() );
+
+        writeFile ( dir + "/services.conf", "<?xml version='1.0' encoding='UTF-8'?>\n<servicesConf>\n<fullStylingCapability>true</fullStylingCapability>\n</servicesConf>\n" );
+
+        writeFile ( dir + "/tms/TEST.tms",
+            "<tileMatrixSet>\n<crs>IGNF:LAMB93</crs>\n<tileMatrix>\n<id>0</id>\n<resolution>1</resolution>\n"
+            "<topLeftCornerX>700000</topLeftCornerX>\n<topLeftCornerY>6601024</topLeftCornerY>\n"
+            "<tileWidth>256</tileWidth>\n<tileHeight>256</tileHeight>\n<matrixWidth>4</matrixWidth>\n<matrixHeight>4</matrixHeight>\n"
+            "</tileMatrix>\n</tileMatrixSet>\n" );
+
+        writeFile ( dir + "/styles/normal.stl",
+            "<?xml version='1.0' encoding='UTF-8'?>\n<style>\n<Identifier>normal</Identifier>\n"
+            "<Title>normal</Title>\n<Abstract>normal</Abstract>\n</style>\n" );
+
+        writeFile ( dir + "/styles/relief.stl",
+            "<?xml version='1.0' encoding='UTF-8'?>\n<style>\n<Identifier>relief</Identifier>\n"
+            "<Title>relief</Title>\n<Abstract>relief</Abstract>\n"
+            "<estompage zenith='45' azimuth='315' zFactor='1' interpolation='linear'/>\n</style>\n" );
+
+        writeFile ( dir + "/based.pyr", pyramid ( "<baseDir>" + dir + "/based</baseDir>\n<pathDepth>1</pathDepth>\n" ) );
+
+        writeFile ( dir + "/onfly.pyr", pyramid (
+            "<baseDir>" + dir + "/onfly</baseDir>\n<pathDepth>1</pathDepth>\n<onFly>true</onFly>\n"
+            "<sources>\n<basedPyramid>\n<file>" + dir + "/based.pyr</file>\n<style>normal</style>\n<transparent>false</transparent>\n</basedPyramid>\n</sources>\n" ) );
+
+        writeFile ( dir + "/layers/ONFLY.lay",
+            "<?xml version='1.0' encoding='UTF-8'?>\n<layer>\n<title>onfly</title>\n<abstract>onfly</abstract>\n<style>normal</style>\n"
+            "<EX_GeographicBoundingBox>\n<westBoundLongitude>-5</westBoundLongitude>\n<eastBoundLongitude>10</eastBoundLongitude>\n"
+            "<southBoundLatitude>40</southBoundLatitude>\n<northBoundLatitude>52</northBoundLatitude>\n</EX_GeographicBoundingBox>\n"
+            "<resampling>nn</resampling>\n<pyramid>" + dir + "/onfly.pyr</pyramid>\n</layer>\n" );
+
+        serverXML = ConfLoader::buildServerConf ( dir + "/server.conf" );
+        CPPUNIT_ASSERT ( serverXML->isOk() );
+        ServicesXML* servicesXML = ConfLoader::buildServicesConf ( serverXML->getServicesConfigFile() );
+        CPPUNIT_ASSERT ( servicesXML->isOk() );
+        CPPUNIT_ASSERT ( ConfLoader::buildTMSList ( serverXML ) );
+        CPPUNIT_ASSERT ( ConfLoader::buildStylesList ( serverXML, servicesXML ) );
+        CPPUNIT_ASSERT ( ConfLoader::buildLayersList ( serverXML, servicesXML ) );
+
+        server = new Rok4Server ( serverXML, servicesXML );
+    }
+
+    void tearDown() {
+        delete server;
+        std::string cmd = std::string ( "rm -rf " ) + dir;
+        system ( cmd.c_str() );
+    }
+
+    // Deux dalles successives à partir de la même pyramide de base, dont le style est partagé avec la configuration
+    void twoSlabsOnFly() {
+        Layer* layer = serverXML->getLayer ( "ONFLY" );
+        CPPUNIT_ASSERT ( layer != NULL );
+        Level* level = layer->getDataPyramid()->getLevel ( "0" );
+        CPPUNIT_ASSERT ( level != NULL );
+        Pyramid* based = reinterpret_cast<Pyramid*> ( level->getSources().at ( 0 ) );
+        Level* basedLevel = based->getLevels().begin()->second;
+        Style* style = serverXML->getStyle ( "normal" );
+        CPPUNIT_ASSERT ( based->getStyle() == style );
+
+        writeBasedSlab ( basedLevel, 0, 100 );
+        writeBasedSlab ( basedLevel, 2, 200 );
+
+        for ( int i = 0; i < 2; i++ ) {
+            std::ostringstream path;
+            path << dir << "/slab" << i << ".tif";
+            CPPUNIT_ASSERT_EQUAL ( 0, server->createSlabOnFly ( layer, "0", 2 * i, 0, style, "image/tiff", path.str() ) );
+            CPPUNIT_ASSERT_EQUAL ( 100 * ( i + 1 ), readPixel ( path.str(), level->tileIndicesToSlabBbox ( 2 * i, 0 ) ) );
+        }
+
+        // Le style de la pyramide de base est toujours celui de la configuration
+        CPPUNIT_ASSERT ( based->getStyle() == serverXML->getStyle ( "normal" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "normal" ), based->getStyle()->getId() );
+    }
+
+    // Un estompage lit la pyramide une seule fois, marge comprise, là où l'on lisait l'image puis l'image élargie
+    void terrainReadOnce() {
+        Level* level = serverXML->getLayer ( "ONFLY" )->getDataPyramid()->getLevel ( "0" );
+        Pyramid* based = reinterpret_cast<Pyramid*> ( level->getSources().at ( 0 ) );
+        Level* basedLevel = based->getLevels().begin()->second;
+        Style* style = serverXML->getStyle ( "relief" );
+        CPPUNIT_ASSERT ( style != NULL );
+        CPPUNIT_ASSERT ( server->isTerrainStyle ( style, based, based->getFormat(), "image/png", 1 ) );
+
+        writeBasedSlab ( basedLevel, 0, 100 );
+
+        CountingContext counting ( "" );
+        counting.connection();
+        Context* context = basedLevel->context;
+        basedLevel->context = &counting;
+
+        // À cheval sur les quatre tuiles de la première dalle : la marge d'un pixel n'en ajoute pas
+        BoundingBox<double> bbox ( 700128, 6600640, 700384, 6600896 );
+        CRS crs = based->getTms()->getCrs();
+        int error = 0;
+
+        // Ancien chemin : l'image demandée puis l'image élargie pour le style
+        Image* plain = based->getbbox ( server->servicesConf, bbox, 256, 256, crs, Interpolation::LINEAR, 0, error );
+        Image* expanded = based->getbbox ( server->servicesConf, bbox.expand ( 1, 1, 1 ), 258, 258, crs, Interpolation::LINEAR, 0, error );
+        CPPUNIT_ASSERT ( plain != NULL && expanded != NULL );
+        int baselineReads = counting.reads;
+        delete plain;
+        delete expanded;
+
+        counting.reads = 0;
+        Image* terrain = server->getTerrainImage ( based, style, bbox, 256, 256, crs, error );
+        CPPUNIT_ASSERT ( terrain != NULL );
+        CPPUNIT_ASSERT_EQUAL ( 258, terrain->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( 258, terrain->getHeight() );
+
+        Image* styled = server->styleImage ( terrain, based->getFormat(), style, "image/png", 1, based );
+        CPPUNIT_ASSERT ( styled != NULL && styled != terrain );
+        CPPUNIT_ASSERT_EQUAL ( 256, styled->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( 256, styled->getHeight() );
+        uint8_t line[256];
+        for ( int l = 0; l < 256; l++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 256, styled->getline ( line, l ) );
+        }
+
+        basedLevel->context = context;
+
+        CPPUNIT_ASSERT ( counting.reads > 0 );
+        CPPUNIT_ASSERT_EQUAL ( baselineReads, 2 * counting.reads );
+
+        delete styled;
+        delete terrain;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRok4Server );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitRok4Server, "CppUnitRok4Server" );
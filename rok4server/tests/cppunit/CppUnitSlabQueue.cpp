@@ -0,0 +1,235 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include "SlabQueue.h"
+
+// Génération de test : note l'ordre des dalles, attend l'ouverture de la barrière, échoue pour les dalles "*.ko"
+struct TestBuilder {
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    bool open;
+    std::vector<std::string> built;
+
+    TestBuilder() : open ( true ) {
+        pthread_mutex_init ( &mtx, 0 );
+        pthread_cond_init ( &cond, 0 );
+    }
+
+    ~TestBuilder() {
+        pthread_cond_destroy ( &cond );
+        pthread_mutex_destroy ( &mtx );
+    }
+
+    void setOpen ( bool o ) {
+        pthread_mutex_lock ( &mtx );
+        open = o;
+        pthread_cond_broadcast ( &cond );
+        pthread_mutex_unlock ( &mtx );
+    }
+
+    int getBuiltNumber() {
+        pthread_mutex_lock ( &mtx );
+        int n = built.size();
+        pthread_mutex_unlock ( &mtx );
+        return n;
+    }
+};
+
+static bool testBuild ( SlabJob* job, void* arg ) {
+    TestBuilder* tb = ( TestBuilder* ) arg;
+    pthread_mutex_lock ( &tb->mtx );
+    tb->built.push_back ( job->getPath() );
+    while ( ! tb->open ) pthread_cond_wait ( &tb->cond, &tb->mtx );
+    pthread_mutex_unlock ( &tb->mtx );
+    std::string path = job->getPath();
+    return path.size() < 3 || path.substr ( path.size() - 3 ) != ".ko";
+}
+
+struct Requester {
+    SlabQueue* queue;
+    std::string path;
+    SlabJob::State state;
+};
+
+static void* requestAndWait ( void* arg ) {
+    Requester* r = ( Requester* ) arg;
+    SlabJob* job = r->queue->request ( r->path, NULL, "0", 0, 0, NULL, "image/png" );
+    if ( job == NULL ) {
+        r->state = SlabJob::FAILED;
+        return NULL;
+    }
+    r->state = r->queue->wait ( job, 5000 );
+    r->queue->release ( job );
+    return NULL;
+}
+
+class CppUnitSlabQueue : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitSlabQueue );
+    CPPUNIT_TEST ( sharedRequest );
+    CPPUNIT_TEST ( demandPriority );
+    CPPUNIT_TEST ( bounded );
+    CPPUNIT_TEST ( failureAndTimeout );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    // Attend que le thread de génération ait commencé n dalles
+    void waitBuilt ( TestBuilder& tb, int n ) {
+        for ( int i = 0; i < 500 && tb.getBuiltNumber() < n; i++ ) usleep ( 2000 );
+        CPPUNIT_ASSERT_EQUAL ( n, tb.getBuiltNumber() );
+    }
+
+public:
+
+    // 8 requêtes simultanées sur la même dalle : une seule génération, toutes les requêtes en voient la fin
+    void sharedRequest() {
+        TestBuilder tb;
+        tb.setOpen ( false );
+        SlabQueue queue ( 2, 16, 0, testBuild, &tb );
+
+        Requester requesters[8];
+        pthread_t threads[8];
+        for ( int i = 0; i < 8; i++ ) {
+            requesters[i].queue = &queue;
+            requesters[i].path = "/pyr/00/01.tif";
+            requesters[i].state = SlabJob::PENDING;
+            pthread_create ( &threads[i], NULL, requestAndWait, &requesters[i] );
+        }
+        waitBuilt ( tb, 1 );
+        usleep ( 20000 );
+        tb.setOpen ( true );
+        for ( int i = 0; i < 8; i++ ) {
+            pthread_join ( threads[i], NULL );
+            CPPUNIT_ASSERT_EQUAL ( ( int ) SlabJob::DONE, ( int ) requesters[i].state );
+        }
+        CPPUNIT_ASSERT_EQUAL ( 1, tb.getBuiltNumber() );
+        CPPUNIT_ASSERT_EQUAL ( 0, queue.getPendingNumber() );
+    }
+
+    // Un seul thread, occupé : la dalle la plus demandée passe avant les plus anciennes
+    void demandPriority() {
+        TestBuilder tb;
+        tb.setOpen ( false );
+        SlabQueue queue ( 1, 16, 0, testBuild, &tb );
+
+        SlabJob* busy = queue.request ( "busy", NULL, "0", 0, 0, NULL, "image/png" );
+        waitBuilt ( tb, 1 );
+
+        std::vector<SlabJob*> held;
+        held.push_back ( queue.request ( "a", NULL, "0", 0, 0, NULL, "image/png" ) );
+        held.push_back ( queue.request ( "b", NULL, "0", 0, 0, NULL, "image/png" ) );
+        held.push_back ( queue.request ( "c", NULL, "0", 0, 0, NULL, "image/png" ) );
+        held.push_back ( queue.request ( "c", NULL, "0", 0, 0, NULL, "image/png" ) );
+        held.push_back ( queue.request ( "b", NULL, "0", 0, 0, NULL, "image/png" ) );
+        held.push_back ( queue.request ( "c", NULL, "0", 0, 0, NULL, "image/png" ) );
+        CPPUNIT_ASSERT ( held.at ( 2 ) == held.at ( 3 ) );
+        CPPUNIT_ASSERT_EQUAL ( 3, queue.getPendingNumber() );
+
+        tb.setOpen ( true );
+        for ( unsigned int i = 0; i < held.size(); i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( ( int ) SlabJob::DONE, ( int ) queue.wait ( held.at ( i ), 5000 ) );
+            queue.release ( held.at ( i ) );
+        }
+        queue.release ( busy );
+
+        CPPUNIT_ASSERT_EQUAL ( 4, tb.getBuiltNumber() );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "c" ), tb.built.at ( 1 ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "b" ), tb.built.at ( 2 ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "a" ), tb.built.at ( 3 ) );
+    }
+
+    // File pleine : une nouvelle dalle est refusée, une dalle déjà en attente est toujours partagée
+    void bounded() {
+        TestBuilder tb;
+        tb.setOpen ( false );
+        SlabQueue queue ( 1, 2, 0, testBuild, &tb );
+
+        SlabJob* busy = queue.request ( "busy", NULL, "0", 0, 0, NULL, "image/png" );
+        waitBuilt ( tb, 1 );
+        SlabJob* a = queue.request ( "a", NULL, "0", 0, 0, NULL, "image/png" );
+        SlabJob* b = queue.request ( "b", NULL, "0", 0, 0, NULL, "image/png" );
+        CPPUNIT_ASSERT ( a != NULL && b != NULL );
+        CPPUNIT_ASSERT ( queue.request ( "c", NULL, "0", 0, 0, NULL, "image/png" ) == NULL );
+        SlabJob* a2 = queue.request ( "a", NULL, "0", 0, 0, NULL, "image/png" );
+        CPPUNIT_ASSERT ( a2 == a );
+
+        tb.setOpen ( true );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) SlabJob::DONE, ( int ) queue.wait ( b, 5000 ) );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) SlabJob::DONE, ( int ) queue.wait ( a, 5000 ) );
+        queue.release ( a );
+        queue.release ( a2 );
+        queue.release ( b );
+        queue.release ( busy );
+    }
+
+    // Échec de génération, attente bornée, abandon des dalles trop anciennes
+    void failureAndTimeout() {
+        TestBuilder tb;
+        SlabQueue queue ( 1, 16, 1, testBuild, &tb );
+
+        SlabJob* ko = queue.request ( "slab.ko", NULL, "0", 0, 0, NULL, "image/png" );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) SlabJob::FAILED, ( int ) queue.wait ( ko, 5000 ) );
+        queue.release ( ko );
+
+        tb.setOpen ( false );
+        SlabJob* busy = queue.request ( "busy", NULL, "0", 0, 0, NULL, "image/png" );
+        waitBuilt ( tb, 2 );
+        SlabJob* old = queue.request ( "old", NULL, "0", 0, 0, NULL, "image/png" );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) SlabJob::PENDING, ( int ) queue.wait ( old, 50 ) );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) SlabJob::RUNNING, ( int ) queue.wait ( busy, 0 ) );
+
+        // Au-delà du délai d'abandon, la dalle en attente n'est pas générée
+        sleep ( 2 );
+        tb.setOpen ( true );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) SlabJob::DONE, ( int ) queue.wait ( busy, 5000 ) );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) SlabJob::FAILED, ( int ) queue.wait ( old, 5000 ) );
+        CPPUNIT_ASSERT_EQUAL ( 2, tb.getBuiltNumber() );
+        queue.release ( busy );
+        queue.release ( old );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitSlabQueue );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitSlabQueue, "CppUnitSlabQueue" );
@@ -0,0 +1,411 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <string.h>
+#include <sstream>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "WebService.h"
+#include "WebServiceCache.h"
+#include "EmptyImage.h"
+#include "JPEGEncoder.h"
+
+// Serveur WMS bouchon : répond une image JPEG unie dont la teinte dépend de la BBOX demandée, après un délai,
+// et peut échouer sur les premiers essais de chaque requête ou renvoyer une donnée non décodable
+struct StubWms {
+    int sock;
+    int port;
+    pthread_t acceptThread;
+    pthread_mutex_t mtx;
+
+    int delay;
+    int failures;
+    bool corrupt;
+
+    int running;
+    int maxRunning;
+    int received;
+    std::vector<std::string> seen;
+
+    StubWms() : delay ( 0 ), failures ( 0 ), corrupt ( false ), running ( 0 ), maxRunning ( 0 ), received ( 0 ) {
+        pthread_mutex_init ( &mtx, 0 );
+        sock = socket ( AF_INET, SOCK_STREAM, 0 );
+        int one = 1;
+        setsockopt ( sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof ( one ) );
+        struct sockaddr_in addr;
+        memset ( &addr, 0, sizeof ( addr ) );
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+        addr.sin_port = 0;
+        bind ( sock, ( struct sockaddr* ) &addr, sizeof ( addr ) );
+        socklen_t len = sizeof ( addr );
+        getsockname ( sock, ( struct sockaddr* ) &addr, &len );
+        port = ntohs ( addr.sin_port );
+        listen ( sock, 64 );
+        pthread_create ( &acceptThread, NULL, acceptLoop, this );
+    }
+
+    ~StubWms() {
+        shutdown ( sock, SHUT_RDWR );
+        close ( sock );
+        pthread_join ( acceptThread, NULL );
+        // On laisse les connexions en cours se terminer
+        while ( getRunning() > 0 ) usleep ( 1000 );
+        pthread_mutex_destroy ( &mtx );
+    }
+
+    std::string getUrl() {
+        std::ostringstream oss;
+        oss << "http://127.0.0.1:" << port << "/wms?";
+        return oss.str();
+    }
+
+    int getRunning() {
+        pthread_mutex_lock ( &mtx );
+        int r = running;
+        pthread_mutex_unlock ( &mtx );
+        return r;
+    }
+
+    struct Connection {
+        StubWms* server;
+        int fd;
+    };
+
+    static void* acceptLoop ( void* arg ) {
+        StubWms* server = ( StubWms* ) arg;
+        while ( true ) {
+            int fd = accept ( server->sock, NULL, NULL );
+            if ( fd < 0 ) break;
+            Connection* c = new Connection;
+            c->server = server;
+            c->fd = fd;
+            pthread_mutex_lock ( &server->mtx );
+            server->running++;
+            pthread_mutex_unlock ( &server->mtx );
+            pthread_t t;
+            pthread_create ( &t, NULL, answer, c );
+            pthread_detach ( t );
+        }
+        return NULL;
+    }
+
+    static void sendAll ( int fd, const char* data, size_t size ) {
+        while ( size > 0 ) {
+            ssize_t n = send ( fd, data, size, MSG_NOSIGNAL );
+            if ( n <= 0 ) return;
+            data += n;
+            size -= n;
+        }
+    }
+
+    static void* answer ( void* arg ) {
+        Connection* c = ( Connection* ) arg;
+        StubWms* server = c->server;
+
+        std::string request;
+        char buf[4096];
+        while ( request.find ( "\r\n\r\n" ) == std::string::npos ) {
+            ssize_t n = recv ( c->fd, buf, sizeof ( buf ), 0 );
+            if ( n <= 0 ) break;
+            request.append ( buf, n );
+        }
+        std::string line = request.substr ( 0, request.find ( "\r\n" ) );
+
+        int width = 0, height = 0;
+        double minx = 0;
+        size_t pos;
+        if ( ( pos = line.find ( "WIDTH=" ) ) != std::string::npos ) width = atoi ( line.c_str() + pos + 6 );
+        if ( ( pos = line.find ( "HEIGHT=" ) ) != std::string::npos ) height = atoi ( line.c_str() + pos + 7 );
+        if ( ( pos = line.find ( "BBOX=" ) ) != std::string::npos ) minx = atof ( line.c_str() + pos + 5 );
+
+        pthread_mutex_lock ( &server->mtx );
+        if ( server->running > server->maxRunning ) server->maxRunning = server->running;
+        server->received++;
+        int attempt = 0;
+        for ( unsigned int i = 0; i < server->seen.size(); i++ ) {
+            if ( server->seen.at ( i ) == line ) attempt++;
+        }
+        server->seen.push_back ( line );
+        bool fail = attempt < server->failures;
+        bool corrupt = server->corrupt;
+        int delay = server->delay;
+        pthread_mutex_unlock ( &server->mtx );
+
+        usleep ( delay * 1000 );
+
+        std::string body;
+        std::string type = "image/jpeg";
+        int code = 200;
+        if ( fail ) {
+            code = 503;
+            type = "text/plain";
+            body = "Service temporairement indisponible";
+        } else if ( corrupt || width <= 0 || height <= 0 ) {
+            body = "pas du jpeg";
+        } else {
+            int color[3] = { ( int ) ( minx / 200 ) * 10, 128, 255 - ( int ) ( minx / 200 ) * 10 };
+            JPEGEncoder encoder ( new EmptyImage ( width, height, 3, color ) );
+            uint8_t* out = new uint8_t[1 << 16];
+            while ( ! encoder.eof() ) {
+                size_t n = encoder.read ( out, 1 << 16 );
+                body.append ( ( char* ) out, n );
+            }
+            delete[] out;
+        }
+
+        std::ostringstream oss;
+        oss << "HTTP/1.1 " << code << " " << ( code == 200 ? "OK" : "Service Unavailable" ) << "\r\n"
+            << "Content-Type: " << type << "\r\n"
+            << "Content-Length: " << body.size() << "\r\n"
+            << "Connection: close\r\n\r\n";
+        std::string header = oss.str();
+        sendAll ( c->fd, header.c_str(), header.size() );
+        sendAll ( c->fd, body.c_str(), body.size() );
+        close ( c->fd );
+
+        pthread_mutex_lock ( &server->mtx );
+        server->running--;
+        pthread_mutex_unlock ( &server->mtx );
+        delete c;
+        return NULL;
+    }
+};
+
+struct Harvest {
+    WebMapService* wms;
+    Image* slab;
+};
+
+static void* harvest ( void* arg ) {
+    Harvest* h = ( Harvest* ) arg;
+    h->slab = h->wms->createSlabFromRequest ( 4000, 1000, BoundingBox<double> ( 0, 0, 4000, 1000 ) );
+    return NULL;
+}
+
+class CppUnitWebService : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitWebService );
+    CPPUNIT_TEST ( concurrentHarvest );
+    CPPUNIT_TEST ( retryWithBackoff );
+    CPPUNIT_TEST ( retryExhausted );
+    CPPUNIT_TEST ( undecodableAnswer );
+    CPPUNIT_TEST ( cachedHarvest );
+    CPPUNIT_TEST ( sharedConnections );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    // Une dalle de 4000 x 1000 est découpée en 20 sous-requêtes de 200 x 1000
+    WebMapService* createService ( StubWms& server, int retry, int interval, int maxConnections ) {
+        std::vector<int> ndValues ( 3, 255 );
+        std::map<std::string,std::string> options;
+        WebMapService* wms = new WebMapService ( server.getUrl(), retry, interval, 30, "1.3.0", "ORTHO", "normal", "image/jpeg", 3,
+                                                 "EPSG:3857", BoundingBox<double> ( 0, 0, 4000, 1000 ), ndValues, options );
+        wms->setResponseType ( "image/jpeg" );
+        wms->setMaxConnections ( maxConnections );
+        return wms;
+    }
+
+    void checkSlab ( Image* slab ) {
+        CPPUNIT_ASSERT ( slab != NULL );
+        CPPUNIT_ASSERT_EQUAL ( 4000, slab->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( 1000, slab->getHeight() );
+        uint8_t* line = new uint8_t[4000 * 3];
+        for ( int l = 0; l < 1000; l += 333 ) {
+            slab->getline ( line, l );
+            for ( int c = 0; c < 20; c++ ) {
+                int expected = c * 10;
+                int value = line[ ( c * 200 + 100 ) * 3 ];
+                CPPUNIT_ASSERT ( abs ( value - expected ) <= 2 );
+            }
+        }
+        delete[] line;
+    }
+
+    long long now() {
+        struct timeval tv;
+        gettimeofday ( &tv, NULL );
+        return ( long long ) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    }
+
+public:
+
+    // Les sous-requêtes partent en parallèle, sans dépasser la limite de connexions
+    void concurrentHarvest() {
+        StubWms server;
+        server.delay = 100;
+        WebMapService* wms = createService ( server, 0, 1, 4 );
+
+        long long start = now();
+        Image* slab = wms->createSlabFromRequest ( 4000, 1000, BoundingBox<double> ( 0, 0, 4000, 1000 ) );
+        long long elapsed = now() - start;
+
+        checkSlab ( slab );
+        CPPUNIT_ASSERT_EQUAL ( 20, server.received );
+        CPPUNIT_ASSERT ( server.maxRunning > 1 );
+        CPPUNIT_ASSERT ( server.maxRunning <= 4 );
+        // En séquentiel, 20 x 100 ms
+        CPPUNIT_ASSERT ( elapsed < 1500 );
+
+        delete slab;
+        delete wms;
+    }
+
+    // Chaque sous-requête échoue une fois puis est relancée après un délai, sans bloquer les autres
+    void retryWithBackoff() {
+        StubWms server;
+        server.failures = 1;
+        WebMapService* wms = createService ( server, 2, 1, 8 );
+
+        long long start = now();
+        Image* slab = wms->createSlabFromRequest ( 4000, 1000, BoundingBox<double> ( 0, 0, 4000, 1000 ) );
+        long long elapsed = now() - start;
+
+        checkSlab ( slab );
+        CPPUNIT_ASSERT_EQUAL ( 40, server.received );
+        // Premier délai tiré entre 500 et 1000 ms, les relances se font en parallèle
+        CPPUNIT_ASSERT ( elapsed >= 500 );
+        CPPUNIT_ASSERT ( elapsed < 3000 );
+
+        delete slab;
+        delete wms;
+    }
+
+    // Les essais épuisés, la dalle n'est pas construite, et les connexions sont rendues
+    void retryExhausted() {
+        StubWms server;
+        server.failures = 100;
+        WebMapService* wms = createService ( server, 0, 1, 4 );
+
+        Image* slab = wms->createSlabFromRequest ( 4000, 1000, BoundingBox<double> ( 0, 0, 4000, 1000 ) );
+        CPPUNIT_ASSERT ( slab == NULL );
+        CPPUNIT_ASSERT ( server.received <= 4 );
+
+        server.failures = 0;
+        server.seen.clear();
+        slab = wms->createSlabFromRequest ( 4000, 1000, BoundingBox<double> ( 0, 0, 4000, 1000 ) );
+        checkSlab ( slab );
+
+        delete slab;
+        delete wms;
+    }
+
+    // Une réponse non décodable donne une image de nodata
+    void undecodableAnswer() {
+        StubWms server;
+        server.corrupt = true;
+        WebMapService* wms = createService ( server, 0, 1, 4 );
+
+        Image* slab = wms->createSlabFromRequest ( 4000, 1000, BoundingBox<double> ( 0, 0, 4000, 1000 ) );
+        CPPUNIT_ASSERT ( slab != NULL );
+        uint8_t* line = new uint8_t[4000 * 3];
+        slab->getline ( line, 0 );
+        CPPUNIT_ASSERT_EQUAL ( 255, ( int ) line[0] );
+        delete[] line;
+
+        delete slab;
+        delete wms;
+    }
+
+    // Avec le cache des services distants, deux moissons simultanées de la même dalle n'envoient chaque sous-requête
+    // qu'une fois, et une moisson suivante n'envoie plus rien
+    void cachedHarvest() {
+        StubWms server;
+        server.delay = 100;
+        WebMapService* wms = createService ( server, 0, 1, 8 );
+        WebServiceCache::setValidity ( 0 );
+        WebServiceCache::setCacheSize ( 64 * 1024 * 1024 );
+
+        Harvest harvests[2];
+        pthread_t threads[2];
+        for ( int i = 0; i < 2; i++ ) {
+            harvests[i].wms = wms;
+            pthread_create ( &threads[i], NULL, harvest, &harvests[i] );
+        }
+        for ( int i = 0; i < 2; i++ ) {
+            pthread_join ( threads[i], NULL );
+            checkSlab ( harvests[i].slab );
+            delete harvests[i].slab;
+        }
+        CPPUNIT_ASSERT_EQUAL ( 20, server.received );
+
+        Image* slab = wms->createSlabFromRequest ( 4000, 1000, BoundingBox<double> ( 0, 0, 4000, 1000 ) );
+        checkSlab ( slab );
+        CPPUNIT_ASSERT_EQUAL ( 20, server.received );
+
+        WebServiceCache::setCacheSize ( 0 );
+        WebServiceCache::cleanCache();
+        delete slab;
+        delete wms;
+    }
+
+    // Deux instances moissonnant le même serveur (niveaux clonés) se partagent sa limite de connexions
+    void sharedConnections() {
+        StubWms server;
+        server.delay = 100;
+
+        Harvest harvests[2];
+        pthread_t threads[2];
+        for ( int i = 0; i < 2; i++ ) {
+            harvests[i].wms = createService ( server, 0, 1, 4 );
+            pthread_create ( &threads[i], NULL, harvest, &harvests[i] );
+        }
+        for ( int i = 0; i < 2; i++ ) {
+            pthread_join ( threads[i], NULL );
+            checkSlab ( harvests[i].slab );
+            delete harvests[i].slab;
+            delete harvests[i].wms;
+        }
+        CPPUNIT_ASSERT_EQUAL ( 40, server.received );
+        CPPUNIT_ASSERT ( server.maxRunning > 1 );
+        CPPUNIT_ASSERT ( server.maxRunning <= 4 );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitWebService );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitWebService, "CppUnitWebService" );
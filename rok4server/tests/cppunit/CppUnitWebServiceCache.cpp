@@ -0,0 +1,256 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <string.h>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <utime.h>
+#include "WebServiceCache.h"
+
+struct Waiter {
+    std::string key;
+    WebServiceCache::eLookup status;
+    std::string content;
+};
+
+static void* lookupAndWait ( void* arg ) {
+    Waiter* w = ( Waiter* ) arg;
+    RawDataSource* data = NULL;
+    w->status = WebServiceCache::lookup ( w->key, &data, 10 );
+    if ( data ) {
+        size_t size = data->getSize();
+        const uint8_t* d = data->getData ( size );
+        w->content = std::string ( ( const char* ) d, size );
+        delete data;
+    }
+    return NULL;
+}
+
+class CppUnitWebServiceCache : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitWebServiceCache );
+    CPPUNIT_TEST ( normalize );
+    CPPUNIT_TEST ( memoryCache );
+    CPPUNIT_TEST ( diskCache );
+    CPPUNIT_TEST ( singleFlight );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    std::string content ( RawDataSource* data ) {
+        size_t size = data->getSize();
+        const uint8_t* d = data->getData ( size );
+        return std::string ( ( const char* ) d, size );
+    }
+
+    void store ( std::string key, std::string value ) {
+        WebServiceCache::store ( key, ( const uint8_t* ) value.c_str(), value.size(), "image/png" );
+    }
+
+public:
+
+    void setUp() {
+        WebServiceCache::setDirectory ( "", 0 );
+        WebServiceCache::setValidity ( 0 );
+        WebServiceCache::setCacheSize ( 1024 * 1024 );
+        WebServiceCache::cleanCache();
+    }
+
+    void tearDown() {
+        WebServiceCache::setDirectory ( "", 0 );
+        WebServiceCache::setCacheSize ( 0 );
+        WebServiceCache::cleanCache();
+    }
+
+    // Deux requêtes équivalentes ont la même clé
+    void normalize() {
+        std::string a = WebServiceCache::normalize ( "http://wms/?VERSION=1.3.0&REQUEST=GetMap&bbox=0,0,1,1&&width=256" );
+        std::string b = WebServiceCache::normalize ( "http://wms/?BBOX=0,0,1,1&WIDTH=256&request=GetMap&VERSION=1.3.0" );
+        CPPUNIT_ASSERT_EQUAL ( a, b );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "http://wms/?BBOX=0,0,1,1&REQUEST=GetMap&VERSION=1.3.0&WIDTH=256" ), a );
+        // Les valeurs restent sensibles à la casse
+        CPPUNIT_ASSERT ( WebServiceCache::normalize ( "http://wms/?LAYERS=a" ) != WebServiceCache::normalize ( "http://wms/?LAYERS=A" ) );
+    }
+
+    // Succès, échec, éviction de la réponse la moins récemment utilisée, péremption
+    void memoryCache() {
+        RawDataSource* data = NULL;
+        std::string big ( 400 * 1024, 'x' );
+
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "a", &data, 10 ) );
+        store ( "a", big );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "b", &data, 10 ) );
+        store ( "b", big );
+
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::HIT, ( int ) WebServiceCache::lookup ( "a", &data, 10 ) );
+        CPPUNIT_ASSERT ( content ( data ) == big );
+        delete data;
+
+        // "b" est la moins récemment utilisée : c'est elle qui laisse la place à "c"
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "c", &data, 10 ) );
+        store ( "c", big );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "b", &data, 10 ) );
+        WebServiceCache::abandon ( "b" );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::HIT, ( int ) WebServiceCache::lookup ( "a", &data, 10 ) );
+        delete data;
+
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 2, WebServiceCache::getHits() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 4, WebServiceCache::getMisses() );
+
+        // Au-delà de la durée de validité, la réponse est redemandée
+        WebServiceCache::setValidity ( 1 );
+        sleep ( 2 );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "a", &data, 10 ) );
+        WebServiceCache::abandon ( "a" );
+    }
+
+    // Les réponses sur disque survivent au vidage de la mémoire et sont reprises au redémarrage, dans la limite du volume
+    void diskCache() {
+        char dir[] = "/tmp/rok4webcacheXXXXXX";
+        CPPUNIT_ASSERT ( mkdtemp ( dir ) != NULL );
+        RawDataSource* data = NULL;
+
+        WebServiceCache::setCacheSize ( 0 );
+        CPPUNIT_ASSERT ( WebServiceCache::setDirectory ( dir, 1024 * 1024 ) );
+
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "a", &data, 10 ) );
+        store ( "a", "reponse a" );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::HIT, ( int ) WebServiceCache::lookup ( "a", &data, 10 ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "reponse a" ), content ( data ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "image/png" ), data->getType() );
+        delete data;
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, WebServiceCache::getDiskHits() );
+
+        // Redémarrage : le fichier est repris
+        WebServiceCache::cleanCache();
+        CPPUNIT_ASSERT ( WebServiceCache::setDirectory ( dir, 1024 * 1024 ) );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::HIT, ( int ) WebServiceCache::lookup ( "a", &data, 10 ) );
+        delete data;
+
+        // Volume dépassé : le fichier le plus ancien est supprimé
+        std::string big ( 600 * 1024, 'x' );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "b", &data, 10 ) );
+        store ( "b", big );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "c", &data, 10 ) );
+        store ( "c", big );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "a", &data, 10 ) );
+        WebServiceCache::abandon ( "a" );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "b", &data, 10 ) );
+        WebServiceCache::abandon ( "b" );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::HIT, ( int ) WebServiceCache::lookup ( "c", &data, 10 ) );
+        delete data;
+
+        // Fichiers temporaires : seuls ceux plus vieux que le délai de grâce sont supprimés à la reprise
+        std::string recentTmp = std::string ( dir ) + "/recent.1.1.tmp";
+        std::string oldTmp = std::string ( dir ) + "/old.1.1.tmp";
+        fclose ( fopen ( recentTmp.c_str(), "w" ) );
+        fclose ( fopen ( oldTmp.c_str(), "w" ) );
+        struct utimbuf old;
+        old.actime = old.modtime = time ( NULL ) - WEBSERVICE_CACHE_TMP_GRACE - 10;
+        CPPUNIT_ASSERT_EQUAL ( 0, utime ( oldTmp.c_str(), &old ) );
+        WebServiceCache::cleanCache();
+        CPPUNIT_ASSERT ( WebServiceCache::setDirectory ( dir, 1024 * 1024 ) );
+        CPPUNIT_ASSERT_EQUAL ( 0, access ( recentTmp.c_str(), F_OK ) );
+        CPPUNIT_ASSERT ( access ( oldTmp.c_str(), F_OK ) != 0 );
+
+        WebServiceCache::setDirectory ( "", 0 );
+        std::string cmd = std::string ( "rm -rf " ) + dir;
+        CPPUNIT_ASSERT_EQUAL ( 0, system ( cmd.c_str() ) );
+    }
+
+    // Une seule requête part pour plusieurs demandes simultanées, les autres attendent sa réponse ou son échec
+    void singleFlight() {
+        RawDataSource* data = NULL;
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "a", &data, 10 ) );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::BUSY, ( int ) WebServiceCache::lookup ( "a", &data, 0 ) );
+
+        Waiter waiters[4];
+        pthread_t threads[4];
+        for ( int i = 0; i < 4; i++ ) {
+            waiters[i].key = "a";
+            pthread_create ( &threads[i], NULL, lookupAndWait, &waiters[i] );
+        }
+        while ( WebServiceCache::getShared() < 4 ) usleep ( 1000 );
+        store ( "a", "reponse a" );
+        for ( int i = 0; i < 4; i++ ) {
+            pthread_join ( threads[i], NULL );
+            CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::HIT, ( int ) waiters[i].status );
+            CPPUNIT_ASSERT_EQUAL ( std::string ( "reponse a" ), waiters[i].content );
+        }
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 1, WebServiceCache::getMisses() );
+
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "b", &data, 10 ) );
+        for ( int i = 0; i < 4; i++ ) {
+            waiters[i].key = "b";
+            pthread_create ( &threads[i], NULL, lookupAndWait, &waiters[i] );
+        }
+        while ( WebServiceCache::getShared() < 8 ) usleep ( 1000 );
+        WebServiceCache::abandon ( "b" );
+        for ( int i = 0; i < 4; i++ ) {
+            pthread_join ( threads[i], NULL );
+            CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::FAILED, ( int ) waiters[i].status );
+        }
+
+        // L'échec n'est pas mémorisé
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "b", &data, 10 ) );
+        WebServiceCache::abandon ( "b" );
+
+        // L'attente d'une requête trop longue est bornée, la requête reste partagée avec les suivants
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::MISS, ( int ) WebServiceCache::lookup ( "c", &data, 10 ) );
+        time_t start = time ( NULL );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::TIMEOUT, ( int ) WebServiceCache::lookup ( "c", &data, 1 ) );
+        CPPUNIT_ASSERT ( time ( NULL ) - start <= 2 );
+        CPPUNIT_ASSERT ( data == NULL );
+        waiters[0].key = "c";
+        pthread_create ( &threads[0], NULL, lookupAndWait, &waiters[0] );
+        while ( WebServiceCache::getShared() < 10 ) usleep ( 1000 );
+        store ( "c", "reponse c" );
+        pthread_join ( threads[0], NULL );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) WebServiceCache::HIT, ( int ) waiters[0].status );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "reponse c" ), waiters[0].content );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitWebServiceCache );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitWebServiceCache, "CppUnitWebServiceCache" );